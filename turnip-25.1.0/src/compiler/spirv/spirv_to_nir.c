@@ -2317,7 +2317,7 @@ vtn_handle_type(struct vtn_builder *b, SpvOp opcode,
 static nir_constant *
 vtn_null_constant(struct vtn_builder *b, struct vtn_type *type)
 {
-   nir_constant *c = rzalloc(b, nir_constant);
+   nir_constant *c = vtn_zalloc(b, nir_constant);
 
    switch (type->base_type) {
    case vtn_base_type_scalar:
@@ -2352,7 +2352,7 @@ vtn_null_constant(struct vtn_builder *b, struct vtn_type *type)
       vtn_assert(type->length > 0);
       c->is_null_constant = true;
       c->num_elements = type->length;
-      c->elements = ralloc_array(b, nir_constant *, c->num_elements);
+      c->elements = vtn_alloc_array(b, nir_constant *, c->num_elements);
 
       c->elements[0] = vtn_null_constant(b, type->array_element);
       for (unsigned i = 1; i < c->num_elements; i++)
@@ -2362,7 +2362,7 @@ vtn_null_constant(struct vtn_builder *b, struct vtn_type *type)
    case vtn_base_type_struct:
       c->is_null_constant = true;
       c->num_elements = type->length;
-      c->elements = ralloc_array(b, nir_constant *, c->num_elements);
+      c->elements = vtn_alloc_array(b, nir_constant *, c->num_elements);
       for (unsigned i = 0; i < c->num_elements; i++)
          c->elements[i] = vtn_null_constant(b, type->members[i]);
       break;
@@ -2413,7 +2413,7 @@ vtn_handle_constant(struct vtn_builder *b, SpvOp opcode,
                     const uint32_t *w, unsigned count)
 {
    struct vtn_value *val = vtn_push_value(b, w[2], vtn_value_type_constant);
-   val->constant = rzalloc(b, nir_constant);
+   val->constant = vtn_zalloc(b, nir_constant);
    switch (opcode) {
    case SpvOpConstantTrue:
    case SpvOpConstantFalse:
@@ -2473,7 +2473,7 @@ vtn_handle_constant(struct vtn_builder *b, SpvOp opcode,
          val->type->base_type == vtn_base_type_cooperative_matrix ?
          1 : val->type->length;
 
-      nir_constant **elems = ralloc_array(b, nir_constant *, elem_count);
+      nir_constant **elems = vtn_alloc_array(b, nir_constant *, elem_count);
       if (opcode == SpvOpConstantCompositeReplicateEXT ||
           opcode == SpvOpSpecConstantCompositeReplicateEXT) {
          struct vtn_value *elem_val = vtn_untyped_value(b, w[3]);
@@ -2526,7 +2526,6 @@ vtn_handle_constant(struct vtn_builder *b, SpvOp opcode,
       case vtn_base_type_matrix:
       case vtn_base_type_struct:
       case vtn_base_type_array:
-         ralloc_steal(val->constant, elems);
          val->constant->num_elements = elem_count;
          val->constant->elements = elems;
          break;
@@ -12,11 +12,14 @@
 
 enum fd6_ubwc_compat_type {
    FD6_UBWC_UNKNOWN_COMPAT,
+   FD6_UBWC_R8_UNORM,
+   FD6_UBWC_R8_INT,
    FD6_UBWC_R8G8_UNORM,
    FD6_UBWC_R8G8_INT,
    FD6_UBWC_R8G8B8A8_UNORM,
    FD6_UBWC_R8G8B8A8_INT,
    FD6_UBWC_B8G8R8A8_UNORM,
+   FD6_UBWC_R16_INT,
    FD6_UBWC_R16G16_UNORM,
    FD6_UBWC_R16G16_INT,
    FD6_UBWC_R16G16B16A16_UNORM,
@@ -31,6 +34,20 @@ static inline enum fd6_ubwc_compat_type
 fd6_ubwc_compat_mode(const struct fd_dev_info *info, enum pipe_format format)
 {
    switch (format) {
+   /* sRGB is only applied when sampling or blending, and signedness only
+    * changes how the values are interpreted, so neither changes the
+    * compressed data.  The blob agrees for the formats with more components
+    * below.
+    */
+   case PIPE_FORMAT_R8_UNORM:
+   case PIPE_FORMAT_R8_SRGB:
+      return info->a7xx.ubwc_unorm_snorm_int_compatible ?
+         FD6_UBWC_R8_INT : FD6_UBWC_R8_UNORM;
+
+   case PIPE_FORMAT_R8_UINT:
+   case PIPE_FORMAT_R8_SINT:
+      return FD6_UBWC_R8_INT;
+
    case PIPE_FORMAT_R8G8_UNORM:
    case PIPE_FORMAT_R8G8_SRGB:
       return info->a7xx.ubwc_unorm_snorm_int_compatible ?
@@ -57,6 +74,10 @@ fd6_ubwc_compat_mode(const struct fd_dev_info *info, enum pipe_format format)
    case PIPE_FORMAT_R8G8B8A8_SINT:
       return FD6_UBWC_R8G8B8A8_INT;
 
+   case PIPE_FORMAT_R16_UINT:
+   case PIPE_FORMAT_R16_SINT:
+      return FD6_UBWC_R16_INT;
+
    case PIPE_FORMAT_R16G16_UNORM:
       return info->a7xx.ubwc_unorm_snorm_int_compatible ?
          FD6_UBWC_R16G16_INT : FD6_UBWC_R16G16_UNORM;
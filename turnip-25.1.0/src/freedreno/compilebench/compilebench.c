@@ -0,0 +1,992 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures shader compile throughput on the shaders of a Fossilize archive:
+ *
+ *    compilebench [-d libvulkan_freedreno.so] [-j threads] app.foz
+ *
+ * Every shader module in the archive is compiled once per entry point, on
+ * its own: compute shaders as compute pipelines, vertex and fragment shaders
+ * as graphics pipeline libraries of the matching stage.  Descriptor set
+ * layouts are made up from the bindings the shader declares.  The pipeline
+ * state recorded next to the modules isn't replayed, so shader keys that
+ * depend on it (vertex formats, blending, ...) are left at their defaults.
+ *
+ * For each thread count, a fresh device compiles everything twice into the
+ * same VkPipelineCache: once cold and once again with all pipelines in the
+ * cache.  The disk cache is disabled unless --disk-cache is given.  The
+ * per-stage times reported by VK_EXT_pipeline_creation_feedback for the
+ * single-threaded cold pass are printed at the end.
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+#include "c11/threads.h"
+#include "util/fossilize_db.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+#include "util/u_dynarray.h"
+
+#define MAX_SETS     8
+#define MAX_BINDINGS 64
+
+#define INSTANCE_FUNCS(X)                                                     \
+   X(vkDestroyInstance)                                                       \
+   X(vkEnumeratePhysicalDevices)                                              \
+   X(vkEnumerateDeviceExtensionProperties)                                    \
+   X(vkGetPhysicalDeviceProperties)                                           \
+   X(vkGetDeviceProcAddr)                                                     \
+   X(vkCreateDevice)
+
+#define DEVICE_FUNCS(X)                                                       \
+   X(vkDestroyDevice)                                                         \
+   X(vkCreateShaderModule)                                                    \
+   X(vkDestroyShaderModule)                                                   \
+   X(vkCreateDescriptorSetLayout)                                             \
+   X(vkDestroyDescriptorSetLayout)                                            \
+   X(vkCreatePipelineLayout)                                                  \
+   X(vkDestroyPipelineLayout)                                                 \
+   X(vkCreatePipelineCache)                                                   \
+   X(vkDestroyPipelineCache)                                                  \
+   X(vkCreateComputePipelines)                                                \
+   X(vkCreateGraphicsPipelines)                                               \
+   X(vkDestroyPipeline)
+
+#define DECLARE_FUNC(name) static PFN_##name name;
+INSTANCE_FUNCS(DECLARE_FUNC)
+DEVICE_FUNCS(DECLARE_FUNC)
+
+static PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+
+#define VK_CHECK(call)                                                        \
+   do {                                                                       \
+      VkResult _result = (call);                                              \
+      if (_result != VK_SUCCESS) {                                            \
+         fprintf(stderr, "%s:%d: %s failed: %d\n", __FILE__, __LINE__, #call, \
+                 _result);                                                    \
+         exit(EXIT_FAILURE);                                                  \
+      }                                                                       \
+   } while (0)
+
+struct binding {
+   uint32_t set;
+   uint32_t binding;
+   VkDescriptorType type;
+   uint32_t count;
+};
+
+/* One entry point of one shader module. */
+struct job {
+   const uint32_t *spirv;
+   size_t spirv_size;
+   const char *entry;
+   VkShaderStageFlagBits stage;
+
+   struct binding bindings[MAX_BINDINGS];
+   unsigned num_bindings;
+   unsigned num_sets;
+   bool push_constants;
+
+   /* Created for each device, before timing starts. */
+   VkShaderModule module;
+   VkDescriptorSetLayout set_layouts[MAX_SETS];
+   VkPipelineLayout layout;
+};
+
+struct stage_stats {
+   unsigned count;
+   uint64_t duration;
+};
+
+struct bench {
+   VkInstance instance;
+   VkPhysicalDevice physical_device;
+   uint32_t max_push_constants_size;
+   bool has_gpl;
+   bool disk_cache;
+
+   VkDevice device;
+   VkPipelineCache cache;
+
+   struct util_dynarray blobs;
+   struct job *jobs;
+   unsigned num_jobs;
+   unsigned num_skipped;
+   unsigned num_failed;
+
+   /* Per pass. */
+   unsigned next_job;
+   struct stage_stats stats[3];
+   simple_mtx_t stats_mtx;
+};
+
+static const char *stage_names[] = { "vertex", "fragment", "compute" };
+
+static unsigned
+stage_index(VkShaderStageFlagBits stage)
+{
+   switch (stage) {
+   case VK_SHADER_STAGE_VERTEX_BIT:
+      return 0;
+   case VK_SHADER_STAGE_FRAGMENT_BIT:
+      return 1;
+   default:
+      return 2;
+   }
+}
+
+/* SPIR-V reflection: just enough to find the entry points and build layouts
+ * matching the resources the shader declares.
+ */
+enum {
+   SpvOpEntryPoint = 15,
+   SpvOpTypeImage = 25,
+   SpvOpTypeSampler = 26,
+   SpvOpTypeSampledImage = 27,
+   SpvOpTypeArray = 28,
+   SpvOpTypeRuntimeArray = 29,
+   SpvOpTypeStruct = 30,
+   SpvOpTypePointer = 32,
+   SpvOpConstant = 43,
+   SpvOpVariable = 59,
+   SpvOpDecorate = 71,
+   SpvOpTypeAccelerationStructureKHR = 5341,
+
+   SpvDecorationBlock = 2,
+   SpvDecorationBufferBlock = 3,
+   SpvDecorationBinding = 33,
+   SpvDecorationDescriptorSet = 34,
+
+   SpvStorageClassUniformConstant = 0,
+   SpvStorageClassUniform = 2,
+   SpvStorageClassPushConstant = 9,
+   SpvStorageClassStorageBuffer = 12,
+
+   SpvDimBuffer = 5,
+   SpvDimSubpassData = 6,
+
+   SpvExecutionModelVertex = 0,
+   SpvExecutionModelFragment = 4,
+   SpvExecutionModelGLCompute = 5,
+};
+
+struct spirv_id {
+   uint16_t opcode;
+   const uint32_t *words;
+   uint32_t set, binding;
+   bool has_set, has_binding, block, buffer_block;
+};
+
+static const struct spirv_id *
+spirv_resolve_type(const struct spirv_id *ids, uint32_t bound, uint32_t id,
+                   uint32_t *count)
+{
+   *count = 1;
+   while (id < bound) {
+      const struct spirv_id *type = &ids[id];
+      if (type->opcode == SpvOpTypeArray) {
+         uint32_t len_id = type->words[3];
+         if (len_id < bound && ids[len_id].opcode == SpvOpConstant)
+            *count *= ids[len_id].words[3];
+         id = type->words[2];
+      } else if (type->opcode == SpvOpTypeRuntimeArray) {
+         id = type->words[2];
+      } else {
+         return type;
+      }
+   }
+   return NULL;
+}
+
+static bool
+spirv_descriptor_type(uint32_t storage_class, const struct spirv_id *type,
+                      VkDescriptorType *desc_type)
+{
+   switch (storage_class) {
+   case SpvStorageClassUniform:
+      if (type->opcode != SpvOpTypeStruct)
+         return false;
+      *desc_type = type->buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+                                      : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      return true;
+   case SpvStorageClassStorageBuffer:
+      *desc_type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      return true;
+   case SpvStorageClassUniformConstant:
+      break;
+   default:
+      return false;
+   }
+
+   switch (type->opcode) {
+   case SpvOpTypeSampler:
+      *desc_type = VK_DESCRIPTOR_TYPE_SAMPLER;
+      return true;
+   case SpvOpTypeSampledImage:
+      *desc_type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+      return true;
+   case SpvOpTypeImage: {
+      uint32_t dim = type->words[3];
+      uint32_t sampled = type->words[7];
+      if (dim == SpvDimSubpassData)
+         *desc_type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+      else if (dim == SpvDimBuffer)
+         *desc_type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER
+                                   : VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+      else
+         *desc_type = sampled == 2 ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+                                   : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+      return true;
+   }
+   case SpvOpTypeAccelerationStructureKHR:
+      *desc_type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+      return true;
+   default:
+      return false;
+   }
+}
+
+/* Reflects the module and appends one job per entry point we can compile.
+ * Returns the number of entry points skipped.
+ */
+static unsigned
+reflect_module(struct util_dynarray *jobs, const uint32_t *spirv,
+               size_t size)
+{
+   uint32_t num_words = size / 4;
+   if (num_words < 5 || spirv[0] != 0x07230203)
+      return 1;
+
+   uint32_t bound = spirv[3];
+   struct spirv_id *ids = calloc(bound, sizeof(*ids));
+   if (!ids)
+      return 1;
+
+   struct job proto = {
+      .spirv = spirv,
+      .spirv_size = size,
+   };
+   bool unsupported = false;
+   unsigned skipped = 0;
+
+   for (uint32_t pos = 5; pos < num_words;) {
+      const uint32_t *w = &spirv[pos];
+      uint32_t len = w[0] >> 16, opcode = w[0] & 0xffff;
+      if (len == 0 || pos + len > num_words)
+         break;
+
+      switch (opcode) {
+      case SpvOpTypeImage:
+      case SpvOpTypeSampler:
+      case SpvOpTypeSampledImage:
+      case SpvOpTypeArray:
+      case SpvOpTypeRuntimeArray:
+      case SpvOpTypeStruct:
+      case SpvOpTypePointer:
+      case SpvOpTypeAccelerationStructureKHR:
+         if (len >= 2 && w[1] < bound) {
+            ids[w[1]].opcode = opcode;
+            ids[w[1]].words = w;
+         }
+         break;
+      case SpvOpConstant:
+      case SpvOpVariable:
+         if (len >= 4 && w[2] < bound) {
+            ids[w[2]].opcode = opcode;
+            ids[w[2]].words = w;
+         }
+         break;
+      case SpvOpDecorate:
+         if (len >= 3 && w[1] < bound) {
+            struct spirv_id *id = &ids[w[1]];
+            if (w[2] == SpvDecorationBlock)
+               id->block = true;
+            else if (w[2] == SpvDecorationBufferBlock)
+               id->buffer_block = true;
+            else if (w[2] == SpvDecorationDescriptorSet && len >= 4)
+               id->has_set = true, id->set = w[3];
+            else if (w[2] == SpvDecorationBinding && len >= 4)
+               id->has_binding = true, id->binding = w[3];
+         }
+         break;
+      default:
+         break;
+      }
+
+      pos += len;
+   }
+
+   for (uint32_t i = 0; i < bound; i++) {
+      const struct spirv_id *var = &ids[i];
+      if (var->opcode != SpvOpVariable)
+         continue;
+
+      uint32_t storage_class = var->words[3];
+      if (storage_class == SpvStorageClassPushConstant) {
+         proto.push_constants = true;
+         continue;
+      }
+
+      if (!var->has_set || !var->has_binding)
+         continue;
+
+      uint32_t ptr_id = var->words[1];
+      if (ptr_id >= bound || ids[ptr_id].opcode != SpvOpTypePointer)
+         continue;
+
+      uint32_t count;
+      const struct spirv_id *type =
+         spirv_resolve_type(ids, bound, ids[ptr_id].words[3], &count);
+      VkDescriptorType desc_type;
+      if (!type ||
+          !spirv_descriptor_type(storage_class, type, &desc_type))
+         continue;
+
+      /* Input attachments would need a real render pass, and acceleration
+       * structures a device with ray queries.
+       */
+      if (desc_type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ||
+          desc_type == VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR ||
+          var->set >= MAX_SETS || proto.num_bindings == MAX_BINDINGS) {
+         unsupported = true;
+         break;
+      }
+
+      bool duplicate = false;
+      for (unsigned b = 0; b < proto.num_bindings; b++) {
+         if (proto.bindings[b].set == var->set &&
+             proto.bindings[b].binding == var->binding)
+            duplicate = true;
+      }
+      if (duplicate)
+         continue;
+
+      proto.bindings[proto.num_bindings++] = (struct binding) {
+         .set = var->set,
+         .binding = var->binding,
+         .type = desc_type,
+         .count = count,
+      };
+      proto.num_sets = MAX2(proto.num_sets, var->set + 1);
+   }
+
+   for (uint32_t pos = 5; pos < num_words;) {
+      const uint32_t *w = &spirv[pos];
+      uint32_t len = w[0] >> 16, opcode = w[0] & 0xffff;
+      if (len == 0 || pos + len > num_words)
+         break;
+
+      if (opcode == SpvOpEntryPoint && len >= 4) {
+         VkShaderStageFlagBits stage = 0;
+         if (w[1] == SpvExecutionModelVertex)
+            stage = VK_SHADER_STAGE_VERTEX_BIT;
+         else if (w[1] == SpvExecutionModelFragment)
+            stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+         else if (w[1] == SpvExecutionModelGLCompute)
+            stage = VK_SHADER_STAGE_COMPUTE_BIT;
+
+         if (!stage || unsupported) {
+            skipped++;
+         } else {
+            struct job *job = util_dynarray_grow(jobs, struct job, 1);
+            *job = proto;
+            job->stage = stage;
+            job->entry = (const char *)&w[3];
+         }
+      }
+
+      pos += len;
+   }
+
+   free(ids);
+   return skipped;
+}
+
+/* Looks up an unsigned value in the JSON header of a shader module entry.
+ * The header is simple enough that a full JSON parser isn't needed.
+ */
+static bool
+json_get_uint(const char *json, const char *key, uint64_t *value)
+{
+   const char *p = strstr(json, key);
+   if (!p)
+      return false;
+   p = strchr(p + strlen(key), ':');
+   if (!p)
+      return false;
+
+   char *end;
+   *value = strtoull(p + 1, &end, 10);
+   return end != p + 1;
+}
+
+/* Fossilize stores every SPIR-V word as a little endian base 128 varint. */
+static bool
+decode_varint(const uint8_t *data, size_t size, uint32_t *words,
+              size_t num_words)
+{
+   size_t pos = 0;
+   for (size_t i = 0; i < num_words; i++) {
+      uint32_t word = 0;
+      unsigned shift = 0;
+      for (;;) {
+         if (pos == size || shift > 28)
+            return false;
+         uint8_t byte = data[pos++];
+         word |= (uint32_t)(byte & 0x7f) << shift;
+         shift += 7;
+         if (!(byte & 0x80))
+            break;
+      }
+      words[i] = word;
+   }
+   return pos == size;
+}
+
+struct load_state {
+   struct bench *b;
+   struct util_dynarray jobs;
+   unsigned num_modules;
+   unsigned num_compressed_skipped;
+};
+
+static void
+load_entry(const char *hash_str, const struct foz_payload_header *header,
+           const void *payload, void *data)
+{
+   struct load_state *state = data;
+   const uint8_t *blob = payload;
+   size_t blob_size = header->payload_size;
+   uint8_t *inflated = NULL;
+
+   if (header->format == FOSSILIZE_COMPRESSION_DEFLATE) {
+#ifdef HAVE_ZLIB
+      uLongf inflated_size = header->uncompressed_size;
+      inflated = malloc(MAX2(inflated_size, 1));
+      if (!inflated ||
+          uncompress(inflated, &inflated_size, blob, blob_size) != Z_OK) {
+         free(inflated);
+         return;
+      }
+      blob = inflated;
+      blob_size = inflated_size;
+#else
+      state->num_compressed_skipped++;
+      return;
+#endif
+   } else if (header->format != FOSSILIZE_COMPRESSION_NONE) {
+      return;
+   }
+
+   /* Shader modules are a JSON header, a NUL and the varint encoded code. */
+   const uint8_t *nul = memchr(blob, 0, blob_size);
+   uint64_t offset, varint_size, code_size;
+   if (!nul || !strstr((const char *)blob, "\"shaderModules\"") ||
+       !json_get_uint((const char *)blob, "\"varintOffset\"", &offset) ||
+       !json_get_uint((const char *)blob, "\"varintSize\"", &varint_size) ||
+       !json_get_uint((const char *)blob, "\"codeSize\"", &code_size)) {
+      free(inflated);
+      return;
+   }
+
+   const uint8_t *varint = nul + 1;
+   size_t varint_avail = blob_size - (varint - blob);
+   if (offset > varint_avail || varint_size > varint_avail - offset ||
+       code_size % 4) {
+      free(inflated);
+      return;
+   }
+
+   uint32_t *spirv = malloc(MAX2(code_size, 4));
+   if (!spirv ||
+       !decode_varint(varint + offset, varint_size, spirv, code_size / 4)) {
+      free(spirv);
+      free(inflated);
+      return;
+   }
+
+   util_dynarray_append(&state->b->blobs, uint32_t *, spirv);
+   state->b->num_skipped += reflect_module(&state->jobs, spirv, code_size);
+   state->num_modules++;
+
+   free(inflated);
+}
+
+static void
+load_archive(struct bench *b, const char *filename)
+{
+   struct load_state state = { .b = b };
+   util_dynarray_init(&state.jobs, NULL);
+
+   int num_entries = foz_foreach_entry(filename, load_entry, &state);
+   if (num_entries < 0) {
+      fprintf(stderr, "failed to read fossilize archive %s\n", filename);
+      exit(EXIT_FAILURE);
+   }
+
+   if (state.num_compressed_skipped) {
+      fprintf(stderr, "warning: %u compressed entries skipped, built without "
+              "zlib\n", state.num_compressed_skipped);
+   }
+
+   b->jobs = state.jobs.data;
+   b->num_jobs = util_dynarray_num_elements(&state.jobs, struct job);
+
+   printf("archive: %d entries, %u shader modules, %u entry points, "
+          "%u skipped\n", num_entries, state.num_modules, b->num_jobs,
+          b->num_skipped);
+}
+
+static void
+load_vulkan(const char *driver)
+{
+   const char *name = driver ? driver : "libvulkan.so.1";
+   void *lib = dlopen(name, RTLD_NOW | RTLD_LOCAL);
+   if (!lib) {
+      fprintf(stderr, "failed to load %s: %s\n", name, dlerror());
+      exit(EXIT_FAILURE);
+   }
+
+   get_instance_proc_addr = (PFN_vkGetInstanceProcAddr)
+      dlsym(lib, driver ? "vk_icdGetInstanceProcAddr" : "vkGetInstanceProcAddr");
+   if (!get_instance_proc_addr) {
+      fprintf(stderr, "no vkGetInstanceProcAddr in %s\n", name);
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void
+create_instance(struct bench *b)
+{
+   PFN_vkCreateInstance create_instance = (PFN_vkCreateInstance)
+      get_instance_proc_addr(NULL, "vkCreateInstance");
+
+   const VkApplicationInfo app_info = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName = "compilebench",
+      .apiVersion = VK_API_VERSION_1_1,
+   };
+   const VkInstanceCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &app_info,
+   };
+   VK_CHECK(create_instance(&info, NULL, &b->instance));
+
+#define LOAD_INSTANCE_FUNC(name)                                              \
+   name = (PFN_##name)get_instance_proc_addr(b->instance, #name);
+   INSTANCE_FUNCS(LOAD_INSTANCE_FUNC)
+
+   uint32_t count = 1;
+   VkResult result =
+      vkEnumeratePhysicalDevices(b->instance, &count, &b->physical_device);
+   if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+      fprintf(stderr, "no physical device\n");
+      exit(EXIT_FAILURE);
+   }
+
+   VkPhysicalDeviceProperties props;
+   vkGetPhysicalDeviceProperties(b->physical_device, &props);
+   b->max_push_constants_size = props.limits.maxPushConstantsSize;
+   printf("device: %s\n", props.deviceName);
+
+   VK_CHECK(vkEnumerateDeviceExtensionProperties(b->physical_device, NULL,
+                                                 &count, NULL));
+   VkExtensionProperties *exts = calloc(count, sizeof(*exts));
+   VK_CHECK(vkEnumerateDeviceExtensionProperties(b->physical_device, NULL,
+                                                 &count, exts));
+   for (uint32_t i = 0; i < count; i++) {
+      if (!strcmp(exts[i].extensionName,
+                  VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+         b->has_gpl = true;
+   }
+   free(exts);
+
+   if (!b->has_gpl) {
+      fprintf(stderr, "warning: no %s, only compute shaders are compiled\n",
+              VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+   }
+}
+
+static void
+create_device(struct bench *b)
+{
+   const float priority = 1.0f;
+   const VkDeviceQueueCreateInfo queue_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = 0,
+      .queueCount = 1,
+      .pQueuePriorities = &priority,
+   };
+   const char *exts[] = {
+      VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME,
+      VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME,
+   };
+   const VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT gpl_features = {
+      .sType =
+         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+      .graphicsPipelineLibrary = VK_TRUE,
+   };
+   const VkDeviceCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = b->has_gpl ? &gpl_features : NULL,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+      .enabledExtensionCount = b->has_gpl ? ARRAY_SIZE(exts) : 0,
+      .ppEnabledExtensionNames = exts,
+   };
+   VK_CHECK(vkCreateDevice(b->physical_device, &info, NULL, &b->device));
+
+#define LOAD_DEVICE_FUNC(name)                                                \
+   name = (PFN_##name)vkGetDeviceProcAddr(b->device, #name);
+   DEVICE_FUNCS(LOAD_DEVICE_FUNC)
+
+   const VkPipelineCacheCreateInfo cache_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+   };
+   VK_CHECK(vkCreatePipelineCache(b->device, &cache_info, NULL, &b->cache));
+
+   for (unsigned i = 0; i < b->num_jobs; i++) {
+      struct job *job = &b->jobs[i];
+
+      const VkShaderModuleCreateInfo module_info = {
+         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+         .codeSize = job->spirv_size,
+         .pCode = job->spirv,
+      };
+      VK_CHECK(vkCreateShaderModule(b->device, &module_info, NULL,
+                                    &job->module));
+
+      for (unsigned s = 0; s < job->num_sets; s++) {
+         VkDescriptorSetLayoutBinding bindings[MAX_BINDINGS];
+         unsigned num_bindings = 0;
+         for (unsigned j = 0; j < job->num_bindings; j++) {
+            if (job->bindings[j].set != s)
+               continue;
+            bindings[num_bindings++] = (VkDescriptorSetLayoutBinding) {
+               .binding = job->bindings[j].binding,
+               .descriptorType = job->bindings[j].type,
+               .descriptorCount = job->bindings[j].count,
+               .stageFlags = job->stage,
+            };
+         }
+
+         const VkDescriptorSetLayoutCreateInfo set_info = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+            .bindingCount = num_bindings,
+            .pBindings = bindings,
+         };
+         VK_CHECK(vkCreateDescriptorSetLayout(b->device, &set_info, NULL,
+                                              &job->set_layouts[s]));
+      }
+
+      const VkPushConstantRange push_range = {
+         .stageFlags = job->stage,
+         .size = b->max_push_constants_size,
+      };
+      const VkPipelineLayoutCreateInfo layout_info = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+         .flags = job->stage == VK_SHADER_STAGE_COMPUTE_BIT ? 0 :
+                  VK_PIPELINE_LAYOUT_CREATE_INDEPENDENT_SETS_BIT_EXT,
+         .setLayoutCount = job->num_sets,
+         .pSetLayouts = job->set_layouts,
+         .pushConstantRangeCount = job->push_constants ? 1 : 0,
+         .pPushConstantRanges = &push_range,
+      };
+      VK_CHECK(vkCreatePipelineLayout(b->device, &layout_info, NULL,
+                                      &job->layout));
+   }
+}
+
+static void
+destroy_device(struct bench *b)
+{
+   for (unsigned i = 0; i < b->num_jobs; i++) {
+      struct job *job = &b->jobs[i];
+      vkDestroyPipelineLayout(b->device, job->layout, NULL);
+      for (unsigned s = 0; s < job->num_sets; s++)
+         vkDestroyDescriptorSetLayout(b->device, job->set_layouts[s], NULL);
+      vkDestroyShaderModule(b->device, job->module, NULL);
+   }
+
+   vkDestroyPipelineCache(b->device, b->cache, NULL);
+   vkDestroyDevice(b->device, NULL);
+}
+
+static VkResult
+compile_job(struct bench *b, struct job *job,
+            VkPipelineCreationFeedback *stage_feedback)
+{
+   VkPipelineCreationFeedback pipeline_feedback;
+   VkPipelineCreationFeedbackCreateInfo feedback_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO,
+      .pPipelineCreationFeedback = &pipeline_feedback,
+      .pipelineStageCreationFeedbackCount = 1,
+      .pPipelineStageCreationFeedbacks = stage_feedback,
+   };
+   const VkPipelineShaderStageCreateInfo stage_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .stage = job->stage,
+      .module = job->module,
+      .pName = job->entry,
+   };
+   VkPipeline pipeline;
+   VkResult result;
+
+   if (job->stage == VK_SHADER_STAGE_COMPUTE_BIT) {
+      const VkComputePipelineCreateInfo info = {
+         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+         .pNext = &feedback_info,
+         .stage = stage_info,
+         .layout = job->layout,
+      };
+      result = vkCreateComputePipelines(b->device, b->cache, 1, &info, NULL,
+                                        &pipeline);
+   } else {
+      const bool vertex = job->stage == VK_SHADER_STAGE_VERTEX_BIT;
+      const VkGraphicsPipelineLibraryCreateInfoEXT library_info = {
+         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+         .pNext = &feedback_info,
+         .flags = vertex ?
+            VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT :
+            VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+      };
+      const VkPipelineViewportStateCreateInfo vp = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+         .viewportCount = 1,
+         .scissorCount = 1,
+      };
+      const VkPipelineRasterizationStateCreateInfo rs = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+         .polygonMode = VK_POLYGON_MODE_FILL,
+         .cullMode = VK_CULL_MODE_NONE,
+         .lineWidth = 1.0f,
+      };
+      const VkPipelineMultisampleStateCreateInfo ms = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+         .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+      };
+      const VkPipelineDepthStencilStateCreateInfo ds = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+      };
+      const VkDynamicState dynamic_states[] = {
+         VK_DYNAMIC_STATE_VIEWPORT,
+         VK_DYNAMIC_STATE_SCISSOR,
+      };
+      const VkPipelineDynamicStateCreateInfo dyn = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+         .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+         .pDynamicStates = dynamic_states,
+      };
+      const VkGraphicsPipelineCreateInfo info = {
+         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+         .pNext = &library_info,
+         .flags = VK_PIPELINE_CREATE_LIBRARY_BIT_KHR,
+         .stageCount = 1,
+         .pStages = &stage_info,
+         .pViewportState = vertex ? &vp : NULL,
+         .pRasterizationState = vertex ? &rs : NULL,
+         .pMultisampleState = vertex ? NULL : &ms,
+         .pDepthStencilState = vertex ? NULL : &ds,
+         .pDynamicState = &dyn,
+         .layout = job->layout,
+      };
+      result = vkCreateGraphicsPipelines(b->device, b->cache, 1, &info, NULL,
+                                         &pipeline);
+   }
+
+   if (result == VK_SUCCESS)
+      vkDestroyPipeline(b->device, pipeline, NULL);
+
+   return result;
+}
+
+static int
+compile_thread(void *data)
+{
+   struct bench *b = data;
+   struct stage_stats stats[ARRAY_SIZE(b->stats)] = {0};
+   unsigned num_failed = 0;
+
+   for (;;) {
+      unsigned i = p_atomic_inc_return(&b->next_job) - 1;
+      if (i >= b->num_jobs)
+         break;
+
+      struct job *job = &b->jobs[i];
+      if (job->stage != VK_SHADER_STAGE_COMPUTE_BIT && !b->has_gpl)
+         continue;
+
+      VkPipelineCreationFeedback feedback = {0};
+      if (compile_job(b, job, &feedback) != VK_SUCCESS) {
+         num_failed++;
+         continue;
+      }
+
+      unsigned s = stage_index(job->stage);
+      stats[s].count++;
+      if (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT)
+         stats[s].duration += feedback.duration;
+   }
+
+   simple_mtx_lock(&b->stats_mtx);
+   for (unsigned s = 0; s < ARRAY_SIZE(stats); s++) {
+      b->stats[s].count += stats[s].count;
+      b->stats[s].duration += stats[s].duration;
+   }
+   b->num_failed += num_failed;
+   simple_mtx_unlock(&b->stats_mtx);
+
+   return 0;
+}
+
+static void
+run_pass(struct bench *b, unsigned num_threads, const char *name)
+{
+   thrd_t threads[num_threads];
+
+   b->next_job = 0;
+   b->num_failed = 0;
+   memset(b->stats, 0, sizeof(b->stats));
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < num_threads; i++) {
+      if (thrd_create(&threads[i], compile_thread, b) != thrd_success) {
+         fprintf(stderr, "failed to create thread\n");
+         exit(EXIT_FAILURE);
+      }
+   }
+   for (unsigned i = 0; i < num_threads; i++)
+      thrd_join(threads[i], NULL);
+   int64_t elapsed = os_time_get_nano() - start;
+
+   unsigned compiled = 0;
+   for (unsigned s = 0; s < ARRAY_SIZE(b->stats); s++)
+      compiled += b->stats[s].count;
+
+   printf("%7u  %-5s  %9u  %6u  %10.1f  %12.1f\n", num_threads, name,
+          compiled, b->num_failed, elapsed / 1000000.0,
+          elapsed ? compiled * 1000000000.0 / elapsed : 0.0);
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "usage: %s [-d DRIVER] [-j THREADS] [--disk-cache] ARCHIVE.foz\n"
+           "\n"
+           "  -d, --driver=DRIVER      load this Vulkan ICD instead of the loader\n"
+           "  -j, --threads=THREADS    highest thread count, doubling from 1\n"
+           "                           (default: number of CPUs)\n"
+           "      --disk-cache         leave the driver's disk cache enabled\n",
+           name);
+}
+
+static const struct option opts[] = {
+   { "driver", required_argument, 0, 'd' },
+   { "threads", required_argument, 0, 'j' },
+   { "disk-cache", no_argument, 0, 'c' },
+   { "help", no_argument, 0, 'h' },
+   { 0, 0, 0, 0 },
+};
+
+int
+main(int argc, char **argv)
+{
+   struct bench b = {0};
+   const char *driver = NULL;
+   long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+   int c;
+
+   while ((c = getopt_long(argc, argv, "d:j:h", opts, NULL)) != -1) {
+      switch (c) {
+      case 'd':
+         driver = optarg;
+         break;
+      case 'j':
+         max_threads = strtol(optarg, NULL, 0);
+         break;
+      case 'c':
+         b.disk_cache = true;
+         break;
+      case 'h':
+      default:
+         usage(argv[0]);
+         return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   if (optind != argc - 1 || max_threads < 1) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (!b.disk_cache)
+      setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+
+   util_dynarray_init(&b.blobs, NULL);
+   simple_mtx_init(&b.stats_mtx, mtx_plain);
+
+   load_archive(&b, argv[optind]);
+   if (!b.num_jobs)
+      return EXIT_FAILURE;
+
+   load_vulkan(driver);
+   create_instance(&b);
+
+   printf("%7s  %-5s  %9s  %6s  %10s  %12s\n", "threads", "pass",
+          "pipelines", "failed", "time ms", "pipelines/s");
+
+   struct stage_stats stats[ARRAY_SIZE(b.stats)];
+   /* 1, 2, 4, ... and then the requested count if it's not a power of two. */
+   for (unsigned threads = 1;; threads = MIN2(threads * 2, max_threads)) {
+      create_device(&b);
+
+      run_pass(&b, threads, "cold");
+      if (threads == 1)
+         memcpy(stats, b.stats, sizeof(stats));
+
+      run_pass(&b, threads, "warm");
+
+      destroy_device(&b);
+
+      if (threads == max_threads)
+         break;
+   }
+
+   printf("\n%-8s  %9s  %10s  %12s\n", "stage", "pipelines", "total ms",
+          "mean us");
+   for (unsigned s = 0; s < ARRAY_SIZE(stats); s++) {
+      if (!stats[s].count)
+         continue;
+      printf("%-8s  %9u  %10.1f  %12.1f\n", stage_names[s], stats[s].count,
+             stats[s].duration / 1000000.0,
+             stats[s].duration / 1000.0 / stats[s].count);
+   }
+
+   vkDestroyInstance(b.instance, NULL);
+
+   util_dynarray_foreach(&b.blobs, uint32_t *, blob)
+      free(*blob);
+   util_dynarray_fini(&b.blobs);
+   free(b.jobs);
+   simple_mtx_destroy(&b.stats_mtx);
+
+   return EXIT_SUCCESS;
+}
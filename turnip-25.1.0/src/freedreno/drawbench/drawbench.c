@@ -0,0 +1,846 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Measures the CPU cost of recording and submitting draws, with different
+ * kinds of state changed between the draws:
+ *
+ *    drawbench [-d libvulkan_freedreno.so] [-n draws] [-i iterations]
+ *
+ * Without -d, the Vulkan loader picks the driver.  With -d, the ICD is
+ * loaded directly, which avoids the loader's trampolines and makes the
+ * numbers easier to compare between builds.
+ *
+ * Each scenario records a command buffer with N draws in a single render
+ * pass, submits it and waits for idle.  The median over the iterations of
+ * the recording time and of the vkQueueSubmit() time, divided by N, is
+ * reported.  Waiting for the GPU is not part of either number.
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+
+static const uint32_t drawbench_vert_spv[] = {
+#include "drawbench.vert.spv.h"
+};
+
+static const uint32_t drawbench_frag_spv[] = {
+#include "drawbench.frag.spv.h"
+};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define WIDTH  256
+#define HEIGHT 256
+
+#define INSTANCE_FUNCS(X)                                                     \
+   X(vkDestroyInstance)                                                       \
+   X(vkEnumeratePhysicalDevices)                                              \
+   X(vkGetPhysicalDeviceProperties)                                           \
+   X(vkGetPhysicalDeviceQueueFamilyProperties)                                \
+   X(vkGetPhysicalDeviceMemoryProperties)                                     \
+   X(vkGetDeviceProcAddr)                                                     \
+   X(vkCreateDevice)
+
+#define DEVICE_FUNCS(X)                                                       \
+   X(vkDestroyDevice)                                                         \
+   X(vkGetDeviceQueue)                                                        \
+   X(vkDeviceWaitIdle)                                                        \
+   X(vkQueueSubmit)                                                           \
+   X(vkQueueWaitIdle)                                                         \
+   X(vkAllocateMemory)                                                        \
+   X(vkFreeMemory)                                                            \
+   X(vkMapMemory)                                                             \
+   X(vkCreateBuffer)                                                          \
+   X(vkDestroyBuffer)                                                         \
+   X(vkGetBufferMemoryRequirements)                                           \
+   X(vkBindBufferMemory)                                                      \
+   X(vkCreateImage)                                                           \
+   X(vkDestroyImage)                                                          \
+   X(vkGetImageMemoryRequirements)                                            \
+   X(vkBindImageMemory)                                                       \
+   X(vkCreateImageView)                                                       \
+   X(vkDestroyImageView)                                                      \
+   X(vkCreateRenderPass)                                                      \
+   X(vkDestroyRenderPass)                                                     \
+   X(vkCreateFramebuffer)                                                     \
+   X(vkDestroyFramebuffer)                                                    \
+   X(vkCreateShaderModule)                                                    \
+   X(vkDestroyShaderModule)                                                   \
+   X(vkCreateDescriptorSetLayout)                                             \
+   X(vkDestroyDescriptorSetLayout)                                            \
+   X(vkCreatePipelineLayout)                                                  \
+   X(vkDestroyPipelineLayout)                                                 \
+   X(vkCreateGraphicsPipelines)                                               \
+   X(vkDestroyPipeline)                                                       \
+   X(vkCreateDescriptorPool)                                                  \
+   X(vkDestroyDescriptorPool)                                                 \
+   X(vkAllocateDescriptorSets)                                                \
+   X(vkUpdateDescriptorSets)                                                  \
+   X(vkCreateCommandPool)                                                     \
+   X(vkDestroyCommandPool)                                                    \
+   X(vkAllocateCommandBuffers)                                                \
+   X(vkResetCommandBuffer)                                                    \
+   X(vkBeginCommandBuffer)                                                    \
+   X(vkEndCommandBuffer)                                                      \
+   X(vkCmdBeginRenderPass)                                                    \
+   X(vkCmdEndRenderPass)                                                      \
+   X(vkCmdBindPipeline)                                                       \
+   X(vkCmdBindDescriptorSets)                                                 \
+   X(vkCmdPushConstants)                                                      \
+   X(vkCmdSetViewport)                                                        \
+   X(vkCmdSetScissor)                                                         \
+   X(vkCmdSetBlendConstants)                                                  \
+   X(vkCmdDraw)
+
+#define DECLARE_FUNC(name) static PFN_##name name;
+INSTANCE_FUNCS(DECLARE_FUNC)
+DEVICE_FUNCS(DECLARE_FUNC)
+
+static PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+
+/* What is changed before each draw. */
+enum churn {
+   CHURN_DESCRIPTORS = 1 << 0,
+   CHURN_DYNAMIC = 1 << 1,
+   CHURN_PUSH_CONSTANTS = 1 << 2,
+   CHURN_PIPELINE = 1 << 3,
+};
+
+static const struct {
+   const char *name;
+   unsigned churn;
+} scenarios[] = {
+   { "none", 0 },
+   { "descriptors", CHURN_DESCRIPTORS },
+   { "dynamic", CHURN_DYNAMIC },
+   { "push_constants", CHURN_PUSH_CONSTANTS },
+   { "pipeline", CHURN_PIPELINE },
+   { "all", CHURN_DESCRIPTORS | CHURN_DYNAMIC | CHURN_PUSH_CONSTANTS |
+               CHURN_PIPELINE },
+};
+
+struct bench {
+   VkInstance instance;
+   VkPhysicalDevice physical_device;
+   VkPhysicalDeviceMemoryProperties mem_props;
+   VkDevice device;
+   VkQueue queue;
+
+   VkImage image;
+   VkDeviceMemory image_mem;
+   VkImageView view;
+   VkRenderPass render_pass;
+   VkFramebuffer framebuffer;
+
+   VkBuffer ubos[2];
+   VkDeviceMemory ubo_mem;
+
+   VkDescriptorSetLayout set_layout;
+   VkDescriptorPool desc_pool;
+   VkDescriptorSet sets[2];
+   VkPipelineLayout pipeline_layout;
+   VkPipeline pipelines[2];
+
+   VkCommandPool cmd_pool;
+   VkCommandBuffer cmd;
+};
+
+#define VK_CHECK(call)                                                        \
+   do {                                                                       \
+      VkResult _result = (call);                                              \
+      if (_result != VK_SUCCESS) {                                            \
+         fprintf(stderr, "%s:%d: %s failed: %d\n", __FILE__, __LINE__, #call, \
+                 _result);                                                    \
+         exit(EXIT_FAILURE);                                                  \
+      }                                                                       \
+   } while (0)
+
+static uint64_t
+now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+cmp_u64(const void *a, const void *b)
+{
+   uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+   return x < y ? -1 : x > y;
+}
+
+static uint64_t
+median(uint64_t *samples, unsigned count)
+{
+   qsort(samples, count, sizeof(*samples), cmp_u64);
+   return samples[count / 2];
+}
+
+static void
+load_vulkan(const char *driver)
+{
+   void *lib = dlopen(driver ? driver : "libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+   if (!lib) {
+      fprintf(stderr, "failed to load %s: %s\n",
+              driver ? driver : "libvulkan.so.1", dlerror());
+      exit(EXIT_FAILURE);
+   }
+
+   get_instance_proc_addr = (PFN_vkGetInstanceProcAddr)
+      dlsym(lib, driver ? "vk_icdGetInstanceProcAddr" : "vkGetInstanceProcAddr");
+   if (!get_instance_proc_addr) {
+      fprintf(stderr, "no vkGetInstanceProcAddr in %s\n",
+              driver ? driver : "libvulkan.so.1");
+      exit(EXIT_FAILURE);
+   }
+}
+
+static void
+create_instance(struct bench *b)
+{
+   PFN_vkCreateInstance create_instance = (PFN_vkCreateInstance)
+      get_instance_proc_addr(NULL, "vkCreateInstance");
+
+   const VkApplicationInfo app_info = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName = "drawbench",
+      .apiVersion = VK_API_VERSION_1_1,
+   };
+   const VkInstanceCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &app_info,
+   };
+   VK_CHECK(create_instance(&info, NULL, &b->instance));
+
+#define LOAD_INSTANCE_FUNC(name)                                              \
+   name = (PFN_##name)get_instance_proc_addr(b->instance, #name);
+   INSTANCE_FUNCS(LOAD_INSTANCE_FUNC)
+}
+
+static void
+create_device(struct bench *b)
+{
+   uint32_t count = 1;
+   VkResult result =
+      vkEnumeratePhysicalDevices(b->instance, &count, &b->physical_device);
+   if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+      fprintf(stderr, "no physical device\n");
+      exit(EXIT_FAILURE);
+   }
+
+   VkPhysicalDeviceProperties props;
+   vkGetPhysicalDeviceProperties(b->physical_device, &props);
+   vkGetPhysicalDeviceMemoryProperties(b->physical_device, &b->mem_props);
+   printf("device: %s\n", props.deviceName);
+
+   VkQueueFamilyProperties families[8];
+   count = ARRAY_SIZE(families);
+   vkGetPhysicalDeviceQueueFamilyProperties(b->physical_device, &count,
+                                            families);
+   uint32_t family = UINT32_MAX;
+   for (uint32_t i = 0; i < count; i++) {
+      if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+         family = i;
+         break;
+      }
+   }
+   if (family == UINT32_MAX) {
+      fprintf(stderr, "no graphics queue\n");
+      exit(EXIT_FAILURE);
+   }
+
+   const float priority = 1.0f;
+   const VkDeviceQueueCreateInfo queue_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = family,
+      .queueCount = 1,
+      .pQueuePriorities = &priority,
+   };
+   const VkDeviceCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+   };
+   VK_CHECK(vkCreateDevice(b->physical_device, &info, NULL, &b->device));
+
+#define LOAD_DEVICE_FUNC(name)                                                \
+   name = (PFN_##name)vkGetDeviceProcAddr(b->device, #name);
+   DEVICE_FUNCS(LOAD_DEVICE_FUNC)
+
+   vkGetDeviceQueue(b->device, family, 0, &b->queue);
+
+   const VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = family,
+   };
+   VK_CHECK(vkCreateCommandPool(b->device, &pool_info, NULL, &b->cmd_pool));
+
+   const VkCommandBufferAllocateInfo cmd_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = b->cmd_pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+   };
+   VK_CHECK(vkAllocateCommandBuffers(b->device, &cmd_info, &b->cmd));
+}
+
+static VkDeviceMemory
+allocate_memory(struct bench *b, VkMemoryRequirements *reqs,
+                VkMemoryPropertyFlags flags)
+{
+   for (uint32_t i = 0; i < b->mem_props.memoryTypeCount; i++) {
+      if (!(reqs->memoryTypeBits & (1u << i)) ||
+          (b->mem_props.memoryTypes[i].propertyFlags & flags) != flags)
+         continue;
+
+      const VkMemoryAllocateInfo info = {
+         .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+         .allocationSize = reqs->size,
+         .memoryTypeIndex = i,
+      };
+      VkDeviceMemory mem;
+      VK_CHECK(vkAllocateMemory(b->device, &info, NULL, &mem));
+      return mem;
+   }
+
+   fprintf(stderr, "no suitable memory type\n");
+   exit(EXIT_FAILURE);
+}
+
+static void
+create_framebuffer(struct bench *b)
+{
+   const VkImageCreateInfo image_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .extent = { WIDTH, HEIGHT, 1 },
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+   };
+   VK_CHECK(vkCreateImage(b->device, &image_info, NULL, &b->image));
+
+   VkMemoryRequirements reqs;
+   vkGetImageMemoryRequirements(b->device, b->image, &reqs);
+   b->image_mem = allocate_memory(b, &reqs, 0);
+   VK_CHECK(vkBindImageMemory(b->device, b->image, b->image_mem, 0));
+
+   const VkImageViewCreateInfo view_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+      .image = b->image,
+      .viewType = VK_IMAGE_VIEW_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .subresourceRange = {
+         .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+         .levelCount = 1,
+         .layerCount = 1,
+      },
+   };
+   VK_CHECK(vkCreateImageView(b->device, &view_info, NULL, &b->view));
+
+   const VkAttachmentDescription attachment = {
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+      .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+      .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+      .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+   };
+   const VkAttachmentReference color_ref = {
+      .attachment = 0,
+      .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+   };
+   const VkSubpassDescription subpass = {
+      .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+      .colorAttachmentCount = 1,
+      .pColorAttachments = &color_ref,
+   };
+   const VkRenderPassCreateInfo pass_info = {
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &attachment,
+      .subpassCount = 1,
+      .pSubpasses = &subpass,
+   };
+   VK_CHECK(vkCreateRenderPass(b->device, &pass_info, NULL, &b->render_pass));
+
+   const VkFramebufferCreateInfo fb_info = {
+      .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+      .renderPass = b->render_pass,
+      .attachmentCount = 1,
+      .pAttachments = &b->view,
+      .width = WIDTH,
+      .height = HEIGHT,
+      .layers = 1,
+   };
+   VK_CHECK(vkCreateFramebuffer(b->device, &fb_info, NULL, &b->framebuffer));
+}
+
+static void
+create_descriptors(struct bench *b)
+{
+   /* Both UBOs live in one allocation, 256 bytes apart to satisfy any
+    * minUniformBufferOffsetAlignment.
+    */
+   const VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = 256,
+      .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+   };
+   for (unsigned i = 0; i < 2; i++)
+      VK_CHECK(vkCreateBuffer(b->device, &buffer_info, NULL, &b->ubos[i]));
+
+   VkMemoryRequirements reqs;
+   vkGetBufferMemoryRequirements(b->device, b->ubos[0], &reqs);
+   VkDeviceSize stride = (reqs.size + reqs.alignment - 1) & ~(reqs.alignment - 1);
+   reqs.size = stride * 2;
+   b->ubo_mem = allocate_memory(b, &reqs,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+   uint8_t *map;
+   VK_CHECK(vkMapMemory(b->device, b->ubo_mem, 0, VK_WHOLE_SIZE, 0,
+                        (void **)&map));
+   for (unsigned i = 0; i < 2; i++) {
+      const float color[4] = { i, 1.0f - i, 0.5f, 1.0f };
+      memcpy(map + stride * i, color, sizeof(color));
+      VK_CHECK(vkBindBufferMemory(b->device, b->ubos[i], b->ubo_mem,
+                                  stride * i));
+   }
+
+   const VkDescriptorSetLayoutBinding binding = {
+      .binding = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount = 1,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+   };
+   const VkDescriptorSetLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+      .bindingCount = 1,
+      .pBindings = &binding,
+   };
+   VK_CHECK(vkCreateDescriptorSetLayout(b->device, &layout_info, NULL,
+                                        &b->set_layout));
+
+   const VkDescriptorPoolSize pool_size = {
+      .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount = 2,
+   };
+   const VkDescriptorPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+      .maxSets = 2,
+      .poolSizeCount = 1,
+      .pPoolSizes = &pool_size,
+   };
+   VK_CHECK(vkCreateDescriptorPool(b->device, &pool_info, NULL,
+                                   &b->desc_pool));
+
+   const VkDescriptorSetLayout layouts[2] = { b->set_layout, b->set_layout };
+   const VkDescriptorSetAllocateInfo alloc_info = {
+      .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+      .descriptorPool = b->desc_pool,
+      .descriptorSetCount = 2,
+      .pSetLayouts = layouts,
+   };
+   VK_CHECK(vkAllocateDescriptorSets(b->device, &alloc_info, b->sets));
+
+   for (unsigned i = 0; i < 2; i++) {
+      const VkDescriptorBufferInfo buf = {
+         .buffer = b->ubos[i],
+         .range = 16,
+      };
+      const VkWriteDescriptorSet write = {
+         .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+         .dstSet = b->sets[i],
+         .descriptorCount = 1,
+         .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+         .pBufferInfo = &buf,
+      };
+      vkUpdateDescriptorSets(b->device, 1, &write, 0, NULL);
+   }
+}
+
+static VkShaderModule
+create_shader_module(struct bench *b, const uint32_t *code, size_t size)
+{
+   const VkShaderModuleCreateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = size,
+      .pCode = code,
+   };
+   VkShaderModule module;
+   VK_CHECK(vkCreateShaderModule(b->device, &info, NULL, &module));
+   return module;
+}
+
+static void
+create_pipelines(struct bench *b)
+{
+   const VkPushConstantRange push_range = {
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+      .size = 16,
+   };
+   const VkPipelineLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+      .setLayoutCount = 1,
+      .pSetLayouts = &b->set_layout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &push_range,
+   };
+   VK_CHECK(vkCreatePipelineLayout(b->device, &layout_info, NULL,
+                                   &b->pipeline_layout));
+
+   VkShaderModule vs = create_shader_module(b, drawbench_vert_spv,
+                                            sizeof(drawbench_vert_spv));
+   VkShaderModule fs = create_shader_module(b, drawbench_frag_spv,
+                                            sizeof(drawbench_frag_spv));
+
+   const VkPipelineVertexInputStateCreateInfo vi = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+   };
+   const VkPipelineInputAssemblyStateCreateInfo ia = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+      .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+   };
+   const VkPipelineViewportStateCreateInfo vp = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+      .viewportCount = 1,
+      .scissorCount = 1,
+   };
+   const VkPipelineRasterizationStateCreateInfo rs = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+      .polygonMode = VK_POLYGON_MODE_FILL,
+      .cullMode = VK_CULL_MODE_NONE,
+      .lineWidth = 1.0f,
+   };
+   const VkPipelineMultisampleStateCreateInfo ms = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+      .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+   };
+   const VkPipelineColorBlendAttachmentState blend_att = {
+      .blendEnable = VK_TRUE,
+      .srcColorBlendFactor = VK_BLEND_FACTOR_CONSTANT_COLOR,
+      .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_CONSTANT_COLOR,
+      .colorBlendOp = VK_BLEND_OP_ADD,
+      .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+      .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+      .alphaBlendOp = VK_BLEND_OP_ADD,
+      .colorWriteMask = 0xf,
+   };
+   const VkPipelineColorBlendStateCreateInfo cb = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+      .attachmentCount = 1,
+      .pAttachments = &blend_att,
+   };
+   const VkDynamicState dynamic_states[] = {
+      VK_DYNAMIC_STATE_VIEWPORT,
+      VK_DYNAMIC_STATE_SCISSOR,
+      VK_DYNAMIC_STATE_BLEND_CONSTANTS,
+   };
+   const VkPipelineDynamicStateCreateInfo dyn = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+      .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+      .pDynamicStates = dynamic_states,
+   };
+
+   /* The two pipelines only differ by a specialization constant, which is
+    * enough for the driver to treat them as unrelated programs.
+    */
+   for (unsigned i = 0; i < 2; i++) {
+      const float scale = i ? 0.5f : 1.0f;
+      const VkSpecializationMapEntry entry = {
+         .constantID = 0,
+         .size = sizeof(scale),
+      };
+      const VkSpecializationInfo spec = {
+         .mapEntryCount = 1,
+         .pMapEntries = &entry,
+         .dataSize = sizeof(scale),
+         .pData = &scale,
+      };
+      const VkPipelineShaderStageCreateInfo stages[2] = {
+         {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vs,
+            .pName = "main",
+         },
+         {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fs,
+            .pName = "main",
+            .pSpecializationInfo = &spec,
+         },
+      };
+      const VkGraphicsPipelineCreateInfo info = {
+         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+         .stageCount = 2,
+         .pStages = stages,
+         .pVertexInputState = &vi,
+         .pInputAssemblyState = &ia,
+         .pViewportState = &vp,
+         .pRasterizationState = &rs,
+         .pMultisampleState = &ms,
+         .pColorBlendState = &cb,
+         .pDynamicState = &dyn,
+         .layout = b->pipeline_layout,
+         .renderPass = b->render_pass,
+      };
+      VK_CHECK(vkCreateGraphicsPipelines(b->device, VK_NULL_HANDLE, 1, &info,
+                                         NULL, &b->pipelines[i]));
+   }
+
+   vkDestroyShaderModule(b->device, vs, NULL);
+   vkDestroyShaderModule(b->device, fs, NULL);
+}
+
+static void
+record(struct bench *b, unsigned churn, unsigned num_draws)
+{
+   VkCommandBuffer cmd = b->cmd;
+
+   const VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+   };
+   VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+   const VkClearValue clear = { .color = { .float32 = { 0, 0, 0, 0 } } };
+   const VkRenderPassBeginInfo pass_info = {
+      .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+      .renderPass = b->render_pass,
+      .framebuffer = b->framebuffer,
+      .renderArea = { .extent = { WIDTH, HEIGHT } },
+      .clearValueCount = 1,
+      .pClearValues = &clear,
+   };
+   vkCmdBeginRenderPass(cmd, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+
+   const VkViewport viewport = {
+      .width = WIDTH, .height = HEIGHT, .maxDepth = 1.0f,
+   };
+   const VkRect2D scissor = { .extent = { WIDTH, HEIGHT } };
+   const float blend_constants[4] = { 0.5f, 0.5f, 0.5f, 0.5f };
+   const float push[4] = { 0 };
+
+   vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, b->pipelines[0]);
+   vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           b->pipeline_layout, 0, 1, &b->sets[0], 0, NULL);
+   vkCmdPushConstants(cmd, b->pipeline_layout,
+                      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                      0, sizeof(push), push);
+   vkCmdSetViewport(cmd, 0, 1, &viewport);
+   vkCmdSetScissor(cmd, 0, 1, &scissor);
+   vkCmdSetBlendConstants(cmd, blend_constants);
+
+   for (unsigned i = 0; i < num_draws; i++) {
+      if (churn & CHURN_PIPELINE) {
+         vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                           b->pipelines[i & 1]);
+      }
+
+      if (churn & CHURN_DESCRIPTORS) {
+         vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                 b->pipeline_layout, 0, 1, &b->sets[i & 1],
+                                 0, NULL);
+      }
+
+      if (churn & CHURN_PUSH_CONSTANTS) {
+         const float offset[4] = {
+            (i % 7) * 0.25f - 1.0f, (i % 5) * 0.25f - 1.0f, 0.0f,
+            (i & 1) * 0.1f,
+         };
+         vkCmdPushConstants(cmd, b->pipeline_layout,
+                            VK_SHADER_STAGE_VERTEX_BIT |
+                            VK_SHADER_STAGE_FRAGMENT_BIT,
+                            0, sizeof(offset), offset);
+      }
+
+      if (churn & CHURN_DYNAMIC) {
+         const VkRect2D s = {
+            .offset = { i % 16, i % 16 },
+            .extent = { WIDTH - 16, HEIGHT - 16 },
+         };
+         const float c = (i & 1) ? 0.25f : 0.75f;
+         const float constants[4] = { c, c, c, c };
+         vkCmdSetScissor(cmd, 0, 1, &s);
+         vkCmdSetBlendConstants(cmd, constants);
+      }
+
+      vkCmdDraw(cmd, 4, 1, 0, 0);
+   }
+
+   vkCmdEndRenderPass(cmd);
+   VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+static void
+run_scenario(struct bench *b, const char *name, unsigned churn,
+             unsigned num_draws, unsigned iterations)
+{
+   uint64_t *record_ns = calloc(iterations, sizeof(*record_ns));
+   uint64_t *submit_ns = calloc(iterations, sizeof(*submit_ns));
+
+   /* One untimed round first, so that lazily allocated driver storage and
+    * the pipelines' first use don't show up in the numbers.
+    */
+   for (unsigned i = 0; i <= iterations; i++) {
+      VK_CHECK(vkResetCommandBuffer(b->cmd, 0));
+
+      uint64_t start = now_ns();
+      record(b, churn, num_draws);
+      uint64_t recorded = now_ns();
+
+      const VkSubmitInfo submit = {
+         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+         .commandBufferCount = 1,
+         .pCommandBuffers = &b->cmd,
+      };
+      VK_CHECK(vkQueueSubmit(b->queue, 1, &submit, VK_NULL_HANDLE));
+      uint64_t submitted = now_ns();
+
+      VK_CHECK(vkQueueWaitIdle(b->queue));
+
+      if (i > 0) {
+         record_ns[i - 1] = recorded - start;
+         submit_ns[i - 1] = submitted - recorded;
+      }
+   }
+
+   printf("%-16s %12.1f %12.1f\n", name,
+          (double)median(record_ns, iterations) / num_draws,
+          (double)median(submit_ns, iterations) / num_draws);
+
+   free(record_ns);
+   free(submit_ns);
+}
+
+static void
+destroy(struct bench *b)
+{
+   vkDeviceWaitIdle(b->device);
+
+   vkDestroyCommandPool(b->device, b->cmd_pool, NULL);
+   for (unsigned i = 0; i < 2; i++)
+      vkDestroyPipeline(b->device, b->pipelines[i], NULL);
+   vkDestroyPipelineLayout(b->device, b->pipeline_layout, NULL);
+   vkDestroyDescriptorPool(b->device, b->desc_pool, NULL);
+   vkDestroyDescriptorSetLayout(b->device, b->set_layout, NULL);
+   for (unsigned i = 0; i < 2; i++)
+      vkDestroyBuffer(b->device, b->ubos[i], NULL);
+   vkFreeMemory(b->device, b->ubo_mem, NULL);
+   vkDestroyFramebuffer(b->device, b->framebuffer, NULL);
+   vkDestroyRenderPass(b->device, b->render_pass, NULL);
+   vkDestroyImageView(b->device, b->view, NULL);
+   vkDestroyImage(b->device, b->image, NULL);
+   vkFreeMemory(b->device, b->image_mem, NULL);
+   vkDestroyDevice(b->device, NULL);
+   vkDestroyInstance(b->instance, NULL);
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "usage: %s [-d DRIVER] [-n DRAWS] [-i ITERATIONS] [-s SCENARIO]\n"
+           "\n"
+           "  -d, --driver=DRIVER      load this Vulkan ICD instead of the loader\n"
+           "  -n, --draws=DRAWS        draws per command buffer (default 10000)\n"
+           "  -i, --iterations=N       timed iterations per scenario (default 20)\n"
+           "  -s, --scenario=NAME      only run this scenario, one of:\n"
+           "                           ",
+           name);
+   for (unsigned i = 0; i < ARRAY_SIZE(scenarios); i++)
+      fprintf(stderr, "%s%s", i ? ", " : "", scenarios[i].name);
+   fprintf(stderr, "\n");
+}
+
+static const struct option opts[] = {
+   { "driver", required_argument, 0, 'd' },
+   { "draws", required_argument, 0, 'n' },
+   { "iterations", required_argument, 0, 'i' },
+   { "scenario", required_argument, 0, 's' },
+   { "help", no_argument, 0, 'h' },
+   { 0, 0, 0, 0 },
+};
+
+int
+main(int argc, char **argv)
+{
+   const char *driver = NULL, *only = NULL;
+   unsigned num_draws = 10000, iterations = 20;
+   int c;
+
+   while ((c = getopt_long(argc, argv, "d:n:i:s:h", opts, NULL)) != -1) {
+      switch (c) {
+      case 'd':
+         driver = optarg;
+         break;
+      case 'n':
+         num_draws = strtoul(optarg, NULL, 0);
+         break;
+      case 'i':
+         iterations = strtoul(optarg, NULL, 0);
+         break;
+      case 's':
+         only = optarg;
+         break;
+      case 'h':
+      default:
+         usage(argv[0]);
+         return c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+      }
+   }
+
+   bool found = !only;
+   for (unsigned i = 0; i < ARRAY_SIZE(scenarios) && !found; i++)
+      found = !strcmp(only, scenarios[i].name);
+
+   if (!num_draws || !iterations || !found) {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   struct bench b = {0};
+
+   load_vulkan(driver);
+   create_instance(&b);
+   create_device(&b);
+   create_framebuffer(&b);
+   create_descriptors(&b);
+   create_pipelines(&b);
+
+   printf("%-16s %12s %12s\n", "scenario", "record ns", "submit ns");
+
+   for (unsigned i = 0; i < ARRAY_SIZE(scenarios); i++) {
+      if (only && strcmp(only, scenarios[i].name))
+         continue;
+      run_scenario(&b, scenarios[i].name, scenarios[i].churn, num_draws,
+                   iterations);
+   }
+
+   destroy(&b);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,18 @@
+#version 450
+
+layout(constant_id = 0) const float scale = 1.0;
+
+layout(set = 0, binding = 0) uniform Color {
+   vec4 color;
+} u;
+
+layout(push_constant) uniform PushConstants {
+   vec4 offset;
+} pc;
+
+layout(location = 0) out vec4 out_color;
+
+void main()
+{
+   out_color = u.color * scale + pc.offset.zwzw;
+}
@@ -0,0 +1,11 @@
+#version 450
+
+layout(push_constant) uniform PushConstants {
+   vec4 offset;
+} pc;
+
+void main()
+{
+   vec2 pos = vec2(float(gl_VertexIndex & 1), float(gl_VertexIndex >> 1));
+   gl_Position = vec4(pos * 0.25 + pc.offset.xy, 0.0, 1.0);
+}
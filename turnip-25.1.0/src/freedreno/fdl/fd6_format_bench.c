@@ -0,0 +1,283 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* CPU baselines for the paths texture uploads and downloads go through:
+ *
+ *  - util/format pack and unpack of the formats freedreno sees most in
+ *    texstore and transfer maps, to and from both RGBA8 and float;
+ *  - fdl6_layout() for every cpp, linear, tiled and UBWC;
+ *  - the fdl6_memcpy_*() tiling and untiling used by host image copies, for
+ *    every cpp, whole-image and on an unaligned sub-rectangle.
+ *
+ * Results are printed as one JSON object per line on stdout:
+ *
+ *    fd6_format_bench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/format/u_format.h"
+#include "util/os_time.h"
+#include "util/u_math.h"
+
+#include "adreno_common.xml.h"
+#include "adreno_pm4.xml.h"
+#include "a6xx.xml.h"
+#include "freedreno_dev_info.h"
+#include "freedreno_layout.h"
+
+#define IMAGE_WIDTH  1024
+#define IMAGE_HEIGHT 256
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_R8_UNORM,
+   PIPE_FORMAT_R8G8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_SRGB,
+   PIPE_FORMAT_B5G6R5_UNORM,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+   PIPE_FORMAT_R11G11B10_FLOAT,
+   PIPE_FORMAT_R9G9B9E5_FLOAT,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+};
+
+/* One format of each cpp fdl6 lays out differently. */
+static const enum pipe_format layout_formats[] = {
+   PIPE_FORMAT_R8_UNORM,
+   PIPE_FORMAT_R8G8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+};
+
+static const struct {
+   const char *name;
+   uint32_t tile_mode;
+   bool ubwc;
+} layout_modes[] = {
+   { "linear", TILE6_LINEAR, false },
+   { "tiled", TILE6_3, false },
+   { "ubwc", TILE6_3, true },
+};
+
+/* A660 is the reference: it has the 8-channel macrotile mode. */
+static const struct fd_dev_id dev_id = {
+   .gpu_id = 660,
+};
+
+/* Keeps the results from being optimized away. */
+static uint32_t checksum;
+
+static void
+fill(uint8_t *buf, size_t size)
+{
+   uint32_t x = 0x12345678;
+   for (size_t i = 0; i < size; i++) {
+      x = x * 1103515245 + 12345;
+      buf[i] = x >> 24;
+   }
+}
+
+static void
+print_result(const char *bench, enum pipe_format format, const char *mode,
+             unsigned iterations, int64_t ns, uint64_t pixels)
+{
+   printf("{\"bench\": \"%s\", \"format\": \"%s\", \"mode\": \"%s\", "
+          "\"ns_per_iter\": %.1f",
+          bench, util_format_short_name(format), mode,
+          (double) ns / iterations);
+   if (pixels)
+      printf(", \"mpix_per_s\": %.1f", pixels * iterations * 1e3 / ns);
+   printf("}\n");
+}
+
+static void
+bench_format(enum pipe_format format, unsigned iterations)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format);
+   const struct util_format_pack_description *pack =
+      util_format_pack_description(format);
+   unsigned stride = util_format_get_stride(format, IMAGE_WIDTH);
+   unsigned rgba8_stride = IMAGE_WIDTH * 4;
+   unsigned float_stride = IMAGE_WIDTH * 4 * sizeof(float);
+   uint64_t pixels = (uint64_t) IMAGE_WIDTH * IMAGE_HEIGHT;
+
+   uint8_t *packed = (uint8_t *) malloc((size_t) stride * IMAGE_HEIGHT);
+   uint8_t *rgba8 = (uint8_t *) malloc((size_t) rgba8_stride * IMAGE_HEIGHT);
+   float *rgbaf = (float *) malloc((size_t) float_stride * IMAGE_HEIGHT);
+
+   fill(packed, (size_t) stride * IMAGE_HEIGHT);
+   fill(rgba8, (size_t) rgba8_stride * IMAGE_HEIGHT);
+   for (size_t i = 0; i < pixels * 4; i++)
+      rgbaf[i] = rgba8[i] / 255.0f;
+
+   if (unpack->unpack_rgba_8unorm_rect || unpack->unpack_rgba_8unorm) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         util_format_unpack_rgba_8unorm_rect(format, rgba8, rgba8_stride,
+                                             packed, stride, IMAGE_WIDTH,
+                                             IMAGE_HEIGHT);
+         checksum += rgba8[i % (rgba8_stride * IMAGE_HEIGHT)];
+      }
+      print_result("unpack", format, "rgba8", iterations,
+                   os_time_get_nano() - start, pixels);
+   }
+
+   if (unpack->unpack_rgba) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         util_format_unpack_rgba_rect(format, rgbaf, float_stride, packed,
+                                      stride, IMAGE_WIDTH, IMAGE_HEIGHT);
+         checksum += (uint32_t) rgbaf[i % (pixels * 4)];
+      }
+      print_result("unpack", format, "float", iterations,
+                   os_time_get_nano() - start, pixels);
+   }
+
+   if (pack && pack->pack_rgba_8unorm) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         pack->pack_rgba_8unorm(packed, stride, rgba8, rgba8_stride,
+                                IMAGE_WIDTH, IMAGE_HEIGHT);
+         checksum += packed[i % (stride * IMAGE_HEIGHT)];
+      }
+      print_result("pack", format, "rgba8", iterations,
+                   os_time_get_nano() - start, pixels);
+   }
+
+   if (pack && pack->pack_rgba_float) {
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         pack->pack_rgba_float(packed, stride, rgbaf, float_stride,
+                               IMAGE_WIDTH, IMAGE_HEIGHT);
+         checksum += packed[i % (stride * IMAGE_HEIGHT)];
+      }
+      print_result("pack", format, "float", iterations,
+                   os_time_get_nano() - start, pixels);
+   }
+
+   free(packed);
+   free(rgba8);
+   free(rgbaf);
+}
+
+static void
+bench_layout(const struct fd_dev_info *info, enum pipe_format format,
+             unsigned mode, unsigned iterations)
+{
+   /* layouts are cheap, make each sample long enough to time */
+   iterations *= 64;
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      struct fdl_layout layout = {
+         .ubwc = layout_modes[mode].ubwc,
+         .tile_mode = layout_modes[mode].tile_mode,
+      };
+
+      /* full mip chain, as for a typical texture */
+      fdl6_layout(&layout, info, format, 1, 2048, 2048, 1,
+                  util_logbase2(2048) + 1, 1, false, false, false, NULL);
+      checksum += layout.size;
+   }
+   print_result("layout", format, layout_modes[mode].name, iterations,
+                os_time_get_nano() - start, 0);
+}
+
+static void
+bench_memcpy(const struct fd_dev_info *info, enum pipe_format format,
+             unsigned iterations)
+{
+   const struct fdl_ubwc_config config = {
+      .highest_bank_bit = info->highest_bank_bit,
+      .bank_swizzle_levels = info->ubwc_swizzle,
+      .macrotile_mode = (enum fdl_macrotile_mode) info->macrotile_mode,
+   };
+   struct fdl_layout layout = {
+      .tile_mode = TILE6_3,
+   };
+   fdl6_layout(&layout, info, format, 1, IMAGE_WIDTH, IMAGE_HEIGHT, 1, 1, 1,
+               false, false, false, NULL);
+
+   uint32_t pitch = IMAGE_WIDTH * layout.cpp;
+   char *tiled = (char *) malloc(layout.size);
+   char *linear = (char *) malloc((size_t) pitch * IMAGE_HEIGHT);
+   fill((uint8_t *) tiled, layout.size);
+   fill((uint8_t *) linear, (size_t) pitch * IMAGE_HEIGHT);
+
+   /* The whole image, and a rectangle that starts and ends inside a block,
+    * which takes the per-pixel edge paths.
+    */
+   static const struct {
+      const char *name;
+      uint32_t x, y, width, height;
+   } rects[] = {
+      { "full", 0, 0, IMAGE_WIDTH, IMAGE_HEIGHT },
+      { "unaligned", 3, 5, IMAGE_WIDTH - 6, IMAGE_HEIGHT - 10 },
+   };
+
+   for (unsigned r = 0; r < ARRAY_SIZE(rects); r++) {
+      uint64_t pixels = (uint64_t) rects[r].width * rects[r].height;
+      char mode[32];
+
+      snprintf(mode, sizeof(mode), "to-tiled-%s", rects[r].name);
+      int64_t start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         fdl6_memcpy_linear_to_tiled(rects[r].x, rects[r].y, rects[r].width,
+                                     rects[r].height, tiled, linear, &layout,
+                                     0, pitch, &config);
+         checksum += (uint8_t) tiled[i % layout.size];
+      }
+      print_result("memcpy", format, mode, iterations,
+                   os_time_get_nano() - start, pixels);
+
+      snprintf(mode, sizeof(mode), "to-linear-%s", rects[r].name);
+      start = os_time_get_nano();
+      for (unsigned i = 0; i < iterations; i++) {
+         fdl6_memcpy_tiled_to_linear(rects[r].x, rects[r].y, rects[r].width,
+                                     rects[r].height, linear, tiled, &layout,
+                                     0, pitch, &config);
+         checksum += (uint8_t) linear[i % ((size_t) pitch * IMAGE_HEIGHT)];
+      }
+      print_result("memcpy", format, mode, iterations,
+                   os_time_get_nano() - start, pixels);
+   }
+
+   free(tiled);
+   free(linear);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned iterations = 20;
+
+   if (argc > 2 || (argc == 2 && !(iterations = atoi(argv[1])))) {
+      fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+      return 2;
+   }
+
+   const struct fd_dev_info *info = fd_dev_info_raw(&dev_id);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(formats); i++)
+      bench_format(formats[i], iterations);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(layout_formats); i++) {
+      for (unsigned m = 0; m < ARRAY_SIZE(layout_modes); m++)
+         bench_layout(info, layout_formats[i], m, iterations);
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(layout_formats); i++)
+      bench_memcpy(info, layout_formats[i], iterations);
+
+   fprintf(stderr, "checksum %08x\n", checksum);
+   return 0;
+}
@@ -153,6 +153,15 @@ ir3_should_double_threadsize(struct ir3_shader_variant *v, unsigned regs_count)
       if (!v->local_size_variable) {
          if (threads_per_wg <= compiler->threadsize_base)
             return false;
+
+         /* If the workgroup fills a whole number of single waves but would
+          * leave the last doubled wave partially empty (e.g. 192 threads
+          * as 3x64 vs 2x128), the doubled threadsize only burns lanes and
+          * registers on inactive fibers.
+          */
+         unsigned single = compiler->threadsize_base;
+         if (ALIGN(threads_per_wg, single) < ALIGN(threads_per_wg, single * 2))
+            return false;
       }
    }
       FALLTHROUGH;
@@ -74,6 +74,11 @@ struct ir3_info {
 
    /* Number of instructions of a given category: */
    uint16_t instrs_per_cat[8];
+
+   /* Time it took to compile and assemble the variant, in microseconds.
+    * Variants loaded from a cache report the time of the original compile.
+    */
+   uint32_t compile_time_us;
 };
 
 struct ir3_merge_set {
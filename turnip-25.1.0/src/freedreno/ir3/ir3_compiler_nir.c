@@ -5772,7 +5772,15 @@ ir3_compile_shader_nir(struct ir3_compiler *compiler,
       progress |= IR3_PASS(ir, ir3_dce, so);
       progress |= IR3_PASS(ir, ir3_opt_predicates, so);
       progress |= IR3_PASS(ir, ir3_shared_fold);
-   } while (progress);
+   } while (progress && !so->shader_options.fast_compile);
+
+   /* A single round may leave dead code behind, which ir3_sched expects to
+    * be gone.
+    */
+   if (so->shader_options.fast_compile) {
+      while (IR3_PASS(ir, ir3_dce, so)) {
+      }
+   }
 
    progress = IR3_PASS(ir, ir3_create_alias_tex_regs);
    progress |= IR3_PASS(ir, ir3_create_alias_rt, so);
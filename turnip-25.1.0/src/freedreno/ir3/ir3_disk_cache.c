@@ -85,6 +85,8 @@ ir3_disk_cache_init_shader_key(struct ir3_compiler *compiler,
                      sizeof(shader->options.real_wavesize));
    _mesa_sha1_update(&ctx, &shader->options.nir_options,
                      sizeof(shader->options.nir_options));
+   _mesa_sha1_update(&ctx, &shader->options.fast_compile,
+                     sizeof(shader->options.fast_compile));
 
    /* Note that on some gens stream-out is lowered in ir3 to stg.  For later
     * gens we maybe don't need to include stream-out in the cache key.
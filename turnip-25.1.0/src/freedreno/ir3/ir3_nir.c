@@ -298,6 +298,25 @@ ir3_get_variable_size_align_bytes(const glsl_type *type, unsigned *size, unsigne
       this_progress;                                                           \
    })
 
+/* Once variables have been lowered away, the deref based passes below are
+ * just expensive no-ops: nothing else in the loop creates new derefs, so
+ * we can stop running them.
+ */
+static bool
+shader_has_derefs(nir_shader *s)
+{
+   nir_foreach_function_impl (impl, s) {
+      nir_foreach_block (block, impl) {
+         nir_foreach_instr (instr, block) {
+            if (instr->type == nir_instr_type_deref)
+               return true;
+         }
+      }
+   }
+
+   return false;
+}
+
 bool
 ir3_optimize_loop(struct ir3_compiler *compiler,
                   const struct ir3_shader_nir_options *options,
@@ -307,6 +326,7 @@ ir3_optimize_loop(struct ir3_compiler *compiler,
 
    bool progress;
    bool did_progress = false;
+   bool has_derefs = true;
    unsigned lower_flrp = (s->options->lower_flrp16 ? 16 : 0) |
                          (s->options->lower_flrp32 ? 32 : 0) |
                          (s->options->lower_flrp64 ? 64 : 0);
@@ -314,19 +334,26 @@ ir3_optimize_loop(struct ir3_compiler *compiler,
    do {
       progress = false;
 
-      OPT(s, nir_lower_vars_to_ssa);
+      if (has_derefs)
+         has_derefs = shader_has_derefs(s);
+
+      if (has_derefs)
+         OPT(s, nir_lower_vars_to_ssa);
       progress |= OPT(s, nir_lower_alu_to_scalar, NULL, NULL);
       progress |= OPT(s, nir_lower_phis_to_scalar, false);
 
       progress |= OPT(s, nir_copy_prop);
-      progress |= OPT(s, nir_opt_deref);
+      if (has_derefs)
+         progress |= OPT(s, nir_opt_deref);
       progress |= OPT(s, nir_opt_dce);
       progress |= OPT(s, nir_opt_cse);
 
-      progress |= OPT(s, nir_opt_find_array_copies);
-      progress |= OPT(s, nir_opt_copy_prop_vars);
-      progress |= OPT(s, nir_opt_dead_write_vars);
-      progress |= OPT(s, nir_split_struct_vars, nir_var_function_temp);
+      if (has_derefs) {
+         progress |= OPT(s, nir_opt_find_array_copies);
+         progress |= OPT(s, nir_opt_copy_prop_vars);
+         progress |= OPT(s, nir_opt_dead_write_vars);
+         progress |= OPT(s, nir_split_struct_vars, nir_var_function_temp);
+      }
 
       static int gcm = -1;
       if (gcm == -1)
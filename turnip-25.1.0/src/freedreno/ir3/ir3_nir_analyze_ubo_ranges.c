@@ -651,17 +651,33 @@ ir3_nir_analyze_ubo_ranges(nir_shader *nir, struct ir3_shader_variant *v)
    if (ir3_shader_debug & IR3_DBG_NOUBOOPT)
       return;
 
+   /* Ranges of indirect loads, like the big arrays in D3D constant buffers,
+    * can easily eat up the whole budget and push out the statically
+    * accessed constants that every invocation reads.  Plan the loads with
+    * a constant offset first, and only hand what remains to the indirect
+    * ones.  Indirect ranges that neighbor or overlap a static one still
+    * extend it in the second pass.
+    */
    uint32_t upload_remaining = max_upload;
    bool push_ubos = compiler->options.push_ubo_with_preamble;
 
-   nir_foreach_function (function, nir) {
-      if (function->impl && (!push_ubos || !function->is_preamble)) {
-         nir_foreach_block (block, function->impl) {
-            nir_foreach_instr (instr, block) {
-               if (instr_is_load_ubo(instr))
-                  gather_ubo_ranges(nir, nir_instr_as_intrinsic(instr), state,
+   for (unsigned pass = 0; pass < 2; pass++) {
+      bool indirect = pass == 1;
+      nir_foreach_function (function, nir) {
+         if (function->impl && (!push_ubos || !function->is_preamble)) {
+            nir_foreach_block (block, function->impl) {
+               nir_foreach_instr (instr, block) {
+                  if (!instr_is_load_ubo(instr))
+                     continue;
+
+                  nir_intrinsic_instr *intr = nir_instr_as_intrinsic(instr);
+                  if (nir_src_is_const(intr->src[1]) == indirect)
+                     continue;
+
+                  gather_ubo_ranges(nir, intr, state,
                                     compiler->const_upload_unit,
                                     &upload_remaining);
+               }
             }
          }
       }
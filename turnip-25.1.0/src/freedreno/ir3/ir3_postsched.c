@@ -790,6 +790,12 @@ ir3_postsched(struct ir3 *ir, struct ir3_shader_variant *v)
 
    cleanup_self_movs(ir);
 
+   /* The pre-RA schedule is already valid, post-RA scheduling only improves
+    * latency hiding.
+    */
+   if (v->shader_options.fast_compile)
+      return true;
+
    foreach_block (block, &ir->block_list) {
       sched_block(&ctx, block);
    }
@@ -102,6 +102,13 @@ struct ir3_sched_ctx {
     */
    int sy_index, first_outstanding_sy_index;
    int ss_index, first_outstanding_ss_index;
+
+   /* Estimate of the registers live at this point of the block, summed up
+    * from the live_effect() of the scheduled instructions, and the estimate
+    * above which we stop trading registers for latency hiding.
+    */
+   int live;
+   int live_budget;
 };
 
 struct ir3_sched_node {
@@ -246,11 +253,15 @@ cycle_count(struct ir3_instruction *instr)
    }
 }
 
+static int live_effect(struct ir3_instruction *instr);
+
 static void
 schedule(struct ir3_sched_ctx *ctx, struct ir3_instruction *instr)
 {
    assert(ctx->block == instr->block);
 
+   ctx->live += live_effect(instr);
+
    /* remove from depth list:
     */
    list_delinit(&instr->node);
@@ -881,9 +892,15 @@ choose_instr(struct ir3_sched_ctx *ctx, struct ir3_sched_notes *notes)
    if (chosen)
       return chosen->instr;
 
-   chosen = choose_instr_dec(ctx, notes, true);
-   if (chosen)
-      return chosen->instr;
+   /* Deferring instructions that would sync lets other values become live
+    * meanwhile.  Once the shader is likely to lose occupancy from that, stop
+    * and prefer whatever frees registers instead.
+    */
+   if (ctx->live <= ctx->live_budget) {
+      chosen = choose_instr_dec(ctx, notes, true);
+      if (chosen)
+         return chosen->instr;
+   }
 
    chosen = choose_instr_dec(ctx, notes, false);
    if (chosen)
@@ -1138,6 +1155,7 @@ sched_block(struct ir3_sched_ctx *ctx, struct ir3_block *block)
    ctx->ss_delay = 0;
    ctx->sy_index = ctx->first_outstanding_sy_index = 0;
    ctx->ss_index = ctx->first_outstanding_ss_index = 0;
+   ctx->live = 0;
 
    /* The terminator has to stay at the end. Instead of trying to set up
     * dependencies to achieve this, it's easier to just remove it now and add it
@@ -1252,6 +1270,13 @@ ir3_sched(struct ir3 *ir)
 
    ctx->compiler = ir->compiler;
 
+   /* Aim for at least half of the maximum waves at single threadsize, see
+    * ir3_get_reg_dependent_max_waves().  This is in scalar registers.
+    */
+   unsigned target_waves = MAX2(ctx->compiler->max_waves / 2, 1);
+   ctx->live_budget = ctx->compiler->reg_size_vec4 *
+                      ctx->compiler->wave_granularity / target_waves * 4;
+
    foreach_block (block, &ir->block_list) {
       foreach_instr (instr, &block->instr_list) {
          instr->data = NULL;
@@ -10,6 +10,7 @@
 #include "util/u_atomic.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/os_time.h"
 #include "util/u_string.h"
 
 #include "drm/freedreno_drmif.h"
@@ -284,6 +285,8 @@ assemble_variant(struct ir3_shader_variant *v, bool internal)
 static bool
 compile_variant(struct ir3_shader *shader, struct ir3_shader_variant *v)
 {
+   int64_t start = os_time_get_nano();
+
    int ret = ir3_compile_shader_nir(shader->compiler, shader, v);
    if (ret) {
       mesa_loge("compile failed! (%s:%s)", shader->nir->info.name,
@@ -298,6 +301,8 @@ compile_variant(struct ir3_shader *shader, struct ir3_shader_variant *v)
       return false;
    }
 
+   v->info.compile_time_us = (os_time_get_nano() - start) / 1000;
+
    return true;
 }
 
@@ -612,6 +612,13 @@ struct ir3_shader_options {
     * anywhere (e.g., as the target of alias.rt).
     */
    bool fragdata_dynamic_remap;
+
+   /* Trade code quality for compile time, for shaders that are needed right
+    * away and expected to be replaced by a fully optimized compile later:
+    * the ir3 copy-propagation/CSE loop runs once and post-RA scheduling is
+    * skipped.
+    */
+   bool fast_compile;
 };
 
 struct ir3_shader_output {
@@ -314,17 +314,42 @@ compute_next_distance(struct ra_spill_ctx *ctx, struct ir3 *ir)
    }
 }
 
+/* Values computed only from immediates and (non-relative) constants can be
+ * recomputed wherever they are needed, which is always cheaper than a
+ * round trip through private memory. Besides plain movs this catches
+ * address computations and other ALU math on uniforms.
+ */
 static bool
 can_rematerialize(struct ir3_register *reg)
 {
-   if (reg->flags & IR3_REG_ARRAY)
-      return false;
-   if (reg->instr->opc != OPC_MOV)
-      return false;
-   if (!(reg->instr->srcs[0]->flags & (IR3_REG_IMMED | IR3_REG_CONST)))
+   struct ir3_instruction *instr = reg->instr;
+
+   if (reg->flags & (IR3_REG_ARRAY | IR3_REG_SHARED))
       return false;
-   if (reg->instr->srcs[0]->flags & IR3_REG_RELATIV)
+
+   switch (opc_cat(instr->opc)) {
+   case 1:
+      if (instr->opc != OPC_MOV)
+         return false;
+      break;
+   case 2:
+   case 3:
+      if (instr->dsts_count != 1 || instr->srcs_count == 0 ||
+          writes_addr0(instr) || writes_addr1(instr) || writes_pred(instr))
+         return false;
+      break;
+   default:
       return false;
+   }
+
+   for (unsigned i = 0; i < instr->srcs_count; i++) {
+      struct ir3_register *src = instr->srcs[i];
+      if (!(src->flags & (IR3_REG_IMMED | IR3_REG_CONST)))
+         return false;
+      if (src->flags & IR3_REG_RELATIV)
+         return false;
+   }
+
    return true;
 }
 
@@ -341,9 +366,23 @@ rematerialize(struct ir3_register *reg, struct ir3_cursor cursor)
       struct ir3_register *src =
          ir3_src_create(remat, INVALID_REG, reg->instr->srcs[i]->flags);
       *src = *reg->instr->srcs[i];
-   }
-
-   remat->cat1 = reg->instr->cat1;
+      src->instr = remat;
+   }
+
+   switch (opc_cat(reg->instr->opc)) {
+   case 1:
+      remat->cat1 = reg->instr->cat1;
+      break;
+   case 2:
+      remat->cat2 = reg->instr->cat2;
+      break;
+   case 3:
+      remat->cat3 = reg->instr->cat3;
+      break;
+   default:
+      unreachable("can't rematerialize");
+   }
+   remat->flags |= reg->instr->flags & IR3_INSTR_SAT;
 
    dst->merge_set = reg->merge_set;
    dst->merge_set_offset = reg->merge_set_offset;
@@ -0,0 +1,468 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Decodes the render pass decision log written by turnip with
+ * TU_RP_LOG=<file>:
+ *
+ *    tu_rp_log [-v] log           per-frame sysmem/GMEM split and GPU time
+ *    tu_rp_log -s log             per render pass summary
+ *    tu_rp_log -d before after    what changed for each render pass
+ *
+ * -v also prints every PASS record with the reason for its mode, its bin
+ * layout and LRZ state.  The diff mode is meant for bisecting: it lines up
+ * render passes of two runs of the same content by their autotune key and
+ * reports passes whose rendering mode, binning, bin count or LRZ state
+ * changed, along with the change in average GPU time.
+ */
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/hash_table.h"
+#include "util/macros.h"
+#include "util/u_dynarray.h"
+
+#include "tu_rp_log_format.h"
+
+static const char *reason_names[] = {
+   [TU_RP_LOG_REASON_AUTOTUNE] = "autotune",
+   [TU_RP_LOG_REASON_AUTOTUNE_TIMED] = "autotune-timed",
+   [TU_RP_LOG_REASON_AUTOTUNE_FALLBACK] = "autotune-fallback",
+   [TU_RP_LOG_REASON_SINGLE_PRIM_MODE] = "single-prim-mode",
+   [TU_RP_LOG_REASON_DEBUG_SYSMEM] = "TU_DEBUG=sysmem",
+   [TU_RP_LOG_REASON_DEBUG_GMEM] = "TU_DEBUG=gmem",
+   [TU_RP_LOG_REASON_GMEM_TOO_SMALL] = "gmem-too-small",
+   [TU_RP_LOG_REASON_EMPTY_RENDER_AREA] = "empty-render-area",
+   [TU_RP_LOG_REASON_TESS] = "tess",
+   [TU_RP_LOG_REASON_GMEM_DISABLED] = "gmem-disabled",
+   [TU_RP_LOG_REASON_XFB] = "xfb",
+   [TU_RP_LOG_REASON_PRIM_GENERATED_QUERY] = "prim-generated-query",
+   [TU_RP_LOG_REASON_FDM] = "fdm",
+};
+static_assert(ARRAY_SIZE(reason_names) == TU_RP_LOG_REASON_COUNT,
+              "missing reason name");
+
+static const char *lrz_disable_names[] = {
+   [TU_LRZ_DISABLE_NONE] = "none",
+   [TU_LRZ_DISABLE_MULTIPLE_DEPTH_ATTACHMENTS] = "multiple-depth",
+   [TU_LRZ_DISABLE_FS] = "fs",
+   [TU_LRZ_DISABLE_ALWAYS_NOT_EQUAL] = "always-not-equal",
+   [TU_LRZ_DISABLE_DIRECTION_CHANGE] = "direction-change",
+   [TU_LRZ_DISABLE_STENCIL_KILL] = "stencil-kill",
+   [TU_LRZ_DISABLE_BLEND_DEPTH_WRITE] = "blend-depth-write",
+   [TU_LRZ_DISABLE_CLEAR_IN_RP] = "clear-in-rp",
+};
+static_assert(ARRAY_SIZE(lrz_disable_names) == TU_LRZ_DISABLE_COUNT,
+              "missing LRZ disable reason name");
+
+static const char *
+reason_name(unsigned reason)
+{
+   return reason < ARRAY_SIZE(reason_names) ? reason_names[reason] : "?";
+}
+
+static const char *
+lrz_disable_name(unsigned reason)
+{
+   return reason < ARRAY_SIZE(lrz_disable_names) ? lrz_disable_names[reason]
+                                                 : "?";
+}
+
+/* What we know about one render pass (by rp_key) over a whole log. */
+struct rp_stats {
+   uint64_t rp_key;
+
+   /* the last PASS record seen for it */
+   struct tu_rp_log_pass last;
+   uint32_t passes;
+   uint32_t sysmem_passes;
+   /* PASS records whose mode differs from the previous one */
+   uint32_t mode_flips;
+
+   uint32_t results;
+   uint32_t timed_results;
+   uint64_t samples_passed;
+   uint64_t duration_ns;
+};
+
+struct rp_log {
+   const char *path;
+   struct tu_rp_log_header header;
+
+   struct hash_table_u64 *passes; /* rp_key -> struct rp_stats */
+   struct util_dynarray keys;     /* uint64_t, in first-seen order */
+};
+
+struct frame_stats {
+   uint32_t sysmem;
+   uint32_t gmem;
+   uint32_t results;
+   uint64_t duration_ns;
+};
+
+static bool verbose = false;
+
+static struct rp_stats *
+get_rp(struct rp_log *log, uint64_t rp_key)
+{
+   struct rp_stats *rp =
+      (struct rp_stats *) _mesa_hash_table_u64_search(log->passes, rp_key);
+   if (rp)
+      return rp;
+
+   rp = (struct rp_stats *) calloc(1, sizeof(*rp));
+   rp->rp_key = rp_key;
+   _mesa_hash_table_u64_insert(log->passes, rp_key, rp);
+   util_dynarray_append(&log->keys, uint64_t, rp_key);
+   return rp;
+}
+
+static void
+print_pass(const struct tu_rp_log_pass *pass)
+{
+   printf("   pass %016" PRIx64 " %-6s %-20s %4ux%-4u",
+          pass->rp_key, pass->sysmem ? "sysmem" : "gmem",
+          reason_name(pass->reason), pass->render_width, pass->render_height);
+   if (!pass->sysmem) {
+      printf(" bins %ux%u pipes %ux%u%s", pass->bins_x, pass->bins_y,
+             pass->pipes_x, pass->pipes_y,
+             pass->binning ? " binning" : "");
+   }
+   printf(" draws %u", pass->drawcall_count);
+   if (pass->avg_samples)
+      printf(" avg-samples %u", pass->avg_samples);
+
+   if (pass->lrz_flags & TU_RP_LOG_LRZ_IMAGE) {
+      printf(" lrz %s%s%s%s",
+             (pass->lrz_flags & TU_RP_LOG_LRZ_VALID) ? "valid" : "invalid",
+             (pass->lrz_flags & TU_RP_LOG_LRZ_NO_WRITE) ? ",no-write" : "",
+             (pass->lrz_flags & TU_RP_LOG_LRZ_FAST_CLEAR) ? ",fast-clear" : "",
+             (pass->lrz_flags & TU_RP_LOG_LRZ_GPU_DIR) ? ",gpu-dir" : "");
+      if (pass->lrz_disable_reason != TU_LRZ_DISABLE_NONE)
+         printf(" (%s)", lrz_disable_name(pass->lrz_disable_reason));
+   } else {
+      printf(" lrz none");
+   }
+   printf("\n");
+}
+
+static void
+print_frame(uint64_t frame, const struct frame_stats *stats)
+{
+   printf("frame %" PRIu64 ": %u sysmem, %u gmem", frame, stats->sysmem,
+          stats->gmem);
+   if (stats->results) {
+      printf(", %u results, gpu %.3f ms", stats->results,
+             stats->duration_ns / 1000000.0);
+   }
+   printf("\n");
+}
+
+/* Reads a whole log into per render pass stats, printing frames as it goes
+ * if print_frames is set.
+ */
+static bool
+load_log(struct rp_log *log, const char *path, bool print_frames)
+{
+   memset(log, 0, sizeof(*log));
+   log->path = path;
+   log->passes = _mesa_hash_table_u64_create(NULL);
+   util_dynarray_init(&log->keys, NULL);
+
+   FILE *f = fopen(path, "rb");
+   if (!f) {
+      perror(path);
+      return false;
+   }
+
+   if (fread(&log->header, sizeof(log->header), 1, f) != 1 ||
+       memcmp(log->header.magic, TU_RP_LOG_MAGIC, sizeof(TU_RP_LOG_MAGIC))) {
+      fprintf(stderr, "%s: not a TU_RP_LOG file\n", path);
+      fclose(f);
+      return false;
+   }
+   if (log->header.version != TU_RP_LOG_VERSION) {
+      fprintf(stderr, "%s: unsupported version %u\n", path,
+              log->header.version);
+      fclose(f);
+      return false;
+   }
+
+   if (print_frames) {
+      printf("%s: gpu %u, chip id %016" PRIx64 "\n", path,
+             log->header.gpu_id, log->header.chip_id);
+   }
+
+   struct frame_stats frame = { 0 };
+   union {
+      struct tu_rp_log_record hdr;
+      struct tu_rp_log_frame frame;
+      struct tu_rp_log_pass pass;
+      struct tu_rp_log_result result;
+      uint8_t data[UINT16_MAX];
+   } rec;
+
+   while (fread(&rec.hdr, sizeof(rec.hdr), 1, f) == 1) {
+      if (rec.hdr.size < sizeof(rec.hdr) ||
+          fread(rec.data + sizeof(rec.hdr), rec.hdr.size - sizeof(rec.hdr),
+                1, f) != (rec.hdr.size > sizeof(rec.hdr) ? 1 : 0)) {
+         fprintf(stderr, "%s: truncated record\n", path);
+         break;
+      }
+
+      /* records only ever grow, zero what an older writer didn't have */
+      if (rec.hdr.size < sizeof(rec.pass))
+         memset(rec.data + rec.hdr.size, 0, sizeof(rec.pass) - rec.hdr.size);
+
+      switch (rec.hdr.type) {
+      case TU_RP_LOG_RECORD_FRAME:
+         if (print_frames)
+            print_frame(rec.frame.frame, &frame);
+         memset(&frame, 0, sizeof(frame));
+         break;
+
+      case TU_RP_LOG_RECORD_PASS: {
+         struct rp_stats *rp = get_rp(log, rec.pass.rp_key);
+         if (rp->passes && rp->last.sysmem != rec.pass.sysmem)
+            rp->mode_flips++;
+         rp->last = rec.pass;
+         rp->passes++;
+         if (rec.pass.sysmem) {
+            rp->sysmem_passes++;
+            frame.sysmem++;
+         } else {
+            frame.gmem++;
+         }
+         if (print_frames && verbose)
+            print_pass(&rec.pass);
+         break;
+      }
+
+      case TU_RP_LOG_RECORD_RESULT: {
+         struct rp_stats *rp = get_rp(log, rec.result.rp_key);
+         rp->results++;
+         rp->samples_passed += rec.result.samples_passed;
+         if (rec.result.duration_ns) {
+            rp->timed_results++;
+            rp->duration_ns += rec.result.duration_ns;
+         }
+         frame.results++;
+         frame.duration_ns += rec.result.duration_ns;
+         break;
+      }
+
+      default:
+         break;
+      }
+   }
+
+   fclose(f);
+   return true;
+}
+
+static double
+avg_duration_us(const struct rp_stats *rp)
+{
+   return rp->timed_results ? rp->duration_ns / 1000.0 / rp->timed_results
+                            : 0.0;
+}
+
+static void
+print_summary(struct rp_log *log)
+{
+   printf("%-16s %7s %7s %6s %-20s %9s %12s\n", "rp_key", "passes",
+          "sysmem", "flips", "last reason", "bins", "avg gpu us");
+
+   util_dynarray_foreach (&log->keys, uint64_t, key) {
+      const struct rp_stats *rp = (const struct rp_stats *)
+         _mesa_hash_table_u64_search(log->passes, *key);
+      char bins[16] = "-";
+
+      if (!rp->passes) {
+         printf("%016" PRIx64 " %7s %7s %6s %-20s %9s %12.1f\n", rp->rp_key,
+                "-", "-", "-", "-", "-", avg_duration_us(rp));
+         continue;
+      }
+
+      if (!rp->last.sysmem)
+         snprintf(bins, sizeof(bins), "%ux%u", rp->last.bins_x,
+                  rp->last.bins_y);
+      printf("%016" PRIx64 " %7u %7u %6u %-20s %9s %12.1f\n", rp->rp_key,
+             rp->passes, rp->sysmem_passes, rp->mode_flips,
+             reason_name(rp->last.reason), bins, avg_duration_us(rp));
+   }
+}
+
+static void
+describe_mode(char *buf, size_t size, const struct rp_stats *rp)
+{
+   const struct tu_rp_log_pass *p = &rp->last;
+   if (p->sysmem) {
+      snprintf(buf, size, "sysmem (%s)", reason_name(p->reason));
+   } else {
+      snprintf(buf, size, "gmem %ux%u%s (%s)", p->bins_x, p->bins_y,
+               p->binning ? " binning" : "", reason_name(p->reason));
+   }
+}
+
+static void
+describe_lrz(char *buf, size_t size, const struct rp_stats *rp)
+{
+   const struct tu_rp_log_pass *p = &rp->last;
+   if (!(p->lrz_flags & TU_RP_LOG_LRZ_IMAGE))
+      snprintf(buf, size, "none");
+   else if (!(p->lrz_flags & TU_RP_LOG_LRZ_VALID))
+      snprintf(buf, size, "invalid (%s)",
+               lrz_disable_name(p->lrz_disable_reason));
+   else if (p->lrz_flags & TU_RP_LOG_LRZ_NO_WRITE)
+      snprintf(buf, size, "valid, no-write (%s)",
+               lrz_disable_name(p->lrz_disable_reason));
+   else
+      snprintf(buf, size, "valid");
+}
+
+/* Compares the last decisions made for every render pass of a in b. */
+static void
+print_diff(struct rp_log *a, struct rp_log *b)
+{
+   unsigned changed = 0, only_a = 0, only_b = 0;
+   double total_a = 0.0, total_b = 0.0;
+
+   util_dynarray_foreach (&a->keys, uint64_t, key) {
+      const struct rp_stats *ra = (const struct rp_stats *)
+         _mesa_hash_table_u64_search(a->passes, *key);
+      const struct rp_stats *rb = (const struct rp_stats *)
+         _mesa_hash_table_u64_search(b->passes, *key);
+
+      if (!rb || !rb->passes) {
+         if (ra->passes)
+            only_a++;
+         continue;
+      }
+      if (!ra->passes)
+         continue;
+
+      total_a += ra->duration_ns / 1000.0;
+      total_b += rb->duration_ns / 1000.0;
+
+      char mode_a[64], mode_b[64], lrz_a[64], lrz_b[64];
+      describe_mode(mode_a, sizeof(mode_a), ra);
+      describe_mode(mode_b, sizeof(mode_b), rb);
+      describe_lrz(lrz_a, sizeof(lrz_a), ra);
+      describe_lrz(lrz_b, sizeof(lrz_b), rb);
+
+      bool mode_changed = ra->last.sysmem != rb->last.sysmem ||
+                          ra->last.binning != rb->last.binning ||
+                          ra->last.bins_x != rb->last.bins_x ||
+                          ra->last.bins_y != rb->last.bins_y;
+      bool lrz_changed = strcmp(lrz_a, lrz_b) != 0;
+      if (!mode_changed && !lrz_changed)
+         continue;
+
+      changed++;
+      printf("%016" PRIx64 " %ux%u, %u draws:\n", *key,
+             rb->last.render_width, rb->last.render_height,
+             rb->last.drawcall_count);
+      if (mode_changed)
+         printf("   mode: %s -> %s\n", mode_a, mode_b);
+      if (lrz_changed)
+         printf("   lrz:  %s -> %s\n", lrz_a, lrz_b);
+      if (ra->timed_results && rb->timed_results) {
+         printf("   gpu:  %.1f us -> %.1f us\n", avg_duration_us(ra),
+                avg_duration_us(rb));
+      }
+   }
+
+   util_dynarray_foreach (&b->keys, uint64_t, key) {
+      const struct rp_stats *rb = (const struct rp_stats *)
+         _mesa_hash_table_u64_search(b->passes, *key);
+      const struct rp_stats *ra = (const struct rp_stats *)
+         _mesa_hash_table_u64_search(a->passes, *key);
+      if (rb->passes && (!ra || !ra->passes))
+         only_b++;
+   }
+
+   printf("%u render passes changed, %u only in %s, %u only in %s\n",
+          changed, only_a, a->path, only_b, b->path);
+   if (total_a > 0.0 && total_b > 0.0) {
+      printf("total gpu time of common passes: %.3f ms -> %.3f ms\n",
+             total_a / 1000.0, total_b / 1000.0);
+   }
+}
+
+static void
+free_log(struct rp_log *log)
+{
+   util_dynarray_foreach (&log->keys, uint64_t, key)
+      free(_mesa_hash_table_u64_search(log->passes, *key));
+   _mesa_hash_table_u64_destroy(log->passes);
+   util_dynarray_fini(&log->keys);
+}
+
+static void
+usage(const char *name)
+{
+   fprintf(stderr,
+           "usage: %s [-v] <log>\n"
+           "       %s -s <log>\n"
+           "       %s -d <before> <after>\n",
+           name, name, name);
+   exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+   bool summary = false, diff = false;
+   int opt;
+
+   while ((opt = getopt(argc, argv, "vsdh")) != -1) {
+      switch (opt) {
+      case 'v':
+         verbose = true;
+         break;
+      case 's':
+         summary = true;
+         break;
+      case 'd':
+         diff = true;
+         break;
+      default:
+         usage(argv[0]);
+      }
+   }
+
+   if (diff) {
+      if (argc - optind != 2)
+         usage(argv[0]);
+
+      struct rp_log a, b;
+      if (!load_log(&a, argv[optind], false) ||
+          !load_log(&b, argv[optind + 1], false))
+         return 1;
+      if (a.header.gpu_id != b.header.gpu_id)
+         fprintf(stderr, "warning: logs are from different GPUs\n");
+
+      print_diff(&a, &b);
+      free_log(&a);
+      free_log(&b);
+      return 0;
+   }
+
+   if (argc - optind != 1)
+      usage(argv[0]);
+
+   struct rp_log log;
+   if (!load_log(&log, argv[optind], !summary))
+      return 1;
+   if (summary)
+      print_summary(&log);
+   free_log(&log);
+   return 0;
+}
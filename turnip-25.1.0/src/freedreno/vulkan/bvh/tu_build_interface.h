@@ -38,6 +38,8 @@ struct encode_args {
    VOID_REF intermediate_bvh;
    VOID_REF output_bvh;
    REF(vk_ir_header) header;
+   /* Leaf index to node index, only written for updateable BLASes. */
+   REF(uint32_t) leaf_table;
    uint32_t output_bvh_offset;
    uint32_t leaf_node_count;
    uint32_t geometry_type;
@@ -50,6 +52,17 @@ struct header_args {
    uint32_t instance_count;
 };
 
+struct update_args {
+   REF(tu_accel_struct_header) src;
+   REF(tu_accel_struct_header) dst;
+   REF(vk_aabb) node_bounds;
+   REF(uint32_t) ready_count;
+   uint32_t bvh_offset;
+   uint32_t leaf_table_offset;
+
+   vk_bvh_geometry_data geom_data;
+};
+
 #define TU_COPY_MODE_COPY        0
 #define TU_COPY_MODE_SERIALIZE   1
 #define TU_COPY_MODE_DESERIALIZE 2
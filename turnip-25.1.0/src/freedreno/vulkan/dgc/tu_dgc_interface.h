@@ -0,0 +1,87 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_DGC_INTERFACE_H
+#define TU_DGC_INTERFACE_H
+
+/* Shared between the C driver and the GLSL preprocess shader. */
+
+#ifndef VULKAN
+#include <stdint.h>
+#endif
+
+/* pm4 bits the shader needs to pad out blocks with CP_NOP and to patch the
+ * index size of draws.
+ */
+#define TU_DGC_CP_TYPE7_PKT       0x70000000u
+#define TU_DGC_CP_NOP             0x10u
+#define TU_DGC_INDEX4_SIZE_8_BIT  0u
+#define TU_DGC_INDEX4_SIZE_16_BIT 1u
+#define TU_DGC_INDEX4_SIZE_32_BIT 2u
+
+#define TU_DGC_NO_IES 0xffffffffu
+
+/* Each generated sequence is a copy of a CPU-built template with a list of
+ * patches applied to it. All offsets into the sequence data are in bytes,
+ * all offsets into the block are in dwords.
+ */
+
+/* block[dst + i] = seq[arg + 4 * i] for i < count */
+#define TU_DGC_PATCH_SEQ_DW        0
+/* block[dst] = sequence index */
+#define TU_DGC_PATCH_SEQ_INDEX     1
+/* block[dst..dst+1] = address of seq[arg] */
+#define TU_DGC_PATCH_SEQ_ADDR      2
+/* block[dst..dst+1] is an address into the template, relocate it into the
+ * block.
+ */
+#define TU_DGC_PATCH_BLOCK_ADDR    3
+/* block[dst] |= index size of the VkBindIndexBufferIndirectCommandEXT at
+ * seq[arg], shifted by count.
+ */
+#define TU_DGC_PATCH_INDEX_SIZE    4
+/* block[dst] = number of indices of the VkBindIndexBufferIndirectCommandEXT
+ * at seq[arg].
+ */
+#define TU_DGC_PATCH_MAX_INDEX     5
+/* block[dst] = restart index of the VkBindIndexBufferIndirectCommandEXT at
+ * seq[arg].
+ */
+#define TU_DGC_PATCH_RESTART_INDEX 6
+/* block[dst] = min(seq[arg], max_draw_count) */
+#define TU_DGC_PATCH_DRAW_COUNT    7
+
+struct tu_dgc_patch {
+   uint32_t dst;
+   uint32_t type;
+   uint32_t arg;
+   uint32_t count;
+};
+
+struct tu_dgc_template {
+   /* The template dwords, which also serve as the relocation base of
+    * TU_DGC_PATCH_BLOCK_ADDR.
+    */
+   uint64_t dw_addr;
+   uint64_t patch_addr;
+   uint32_t dw_count;
+   uint32_t patch_count;
+};
+
+struct tu_dgc_args {
+   uint64_t seq_addr;
+   uint64_t out_addr;
+   uint64_t count_addr;
+   uint64_t templates_addr;
+   uint32_t seq_stride;
+   uint32_t max_seq_count;
+   uint32_t block_dw;
+   uint32_t ies_offset;
+   uint32_t template_count;
+   uint32_t max_draw_count;
+   uint32_t index_mode_dx;
+};
+
+#endif
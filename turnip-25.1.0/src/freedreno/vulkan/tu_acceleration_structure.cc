@@ -24,6 +24,7 @@
 
 #include "tu_buffer.h"
 #include "tu_device.h"
+#include "tu_clear_blit.h"
 #include "tu_cmd_buffer.h"
 
 #include "vk_acceleration_structure.h"
@@ -49,6 +50,10 @@ static const uint32_t copy_spv[] = {
 #include "bvh/copy.spv.h"
 };
 
+static const uint32_t update_spv[] = {
+#include "bvh/update.spv.h"
+};
+
 static_assert(sizeof(struct tu_instance_descriptor) == AS_RECORD_SIZE);
 static_assert(sizeof(struct tu_accel_struct_header) == AS_RECORD_SIZE);
 static_assert(sizeof(struct tu_internal_node) == AS_NODE_SIZE);
@@ -112,12 +117,22 @@ get_pipeline_spv(struct tu_device *device,
 
 struct bvh_layout {
    uint64_t bvh_offset;
+   uint64_t leaf_table_offset;
    uint64_t size;
 };
 
+/* Only BLASes are refitted, TLAS updates do a full rebuild. */
+static bool
+is_updateable(const VkAccelerationStructureBuildGeometryInfoKHR *build_info)
+{
+   return build_info->type == VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR &&
+          (build_info->flags & VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR);
+}
+
 static void
 get_bvh_layout(VkGeometryTypeKHR geometry_type,
                uint32_t leaf_count,
+               bool updateable,
                struct bvh_layout *layout)
 {
    uint32_t internal_count = MAX2(leaf_count, 2) - 1;
@@ -141,6 +156,13 @@ get_bvh_layout(VkGeometryTypeKHR geometry_type,
    offset += internal_count * sizeof(struct tu_internal_node) +
       leaf_count * sizeof(struct tu_leaf_node);
 
+   /* The node each leaf was encoded to, so that updates can refit the BVH
+    * starting from the leaves.
+    */
+   layout->leaf_table_offset = offset;
+   if (updateable)
+      offset += leaf_count * sizeof(uint32_t);
+
    layout->size = offset;
 }
 
@@ -149,7 +171,8 @@ VkDeviceSize get_bvh_size(VkDevice device,
                           uint32_t leaf_count)
 {
    struct bvh_layout layout;
-   get_bvh_layout(vk_get_as_geometry_type(pBuildInfo), leaf_count, &layout);
+   get_bvh_layout(vk_get_as_geometry_type(pBuildInfo), leaf_count,
+                  is_updateable(pBuildInfo), &layout);
    return layout.size;
 }
 
@@ -200,12 +223,15 @@ encode(VkCommandBuffer commandBuffer,
                     sizeof(encode_args), &pipeline, &layout);
 
    struct bvh_layout bvh_layout;
-   get_bvh_layout(geometry_type, leaf_count, &bvh_layout);
+   bool updateable = is_updateable(build_info);
+   get_bvh_layout(geometry_type, leaf_count, updateable, &bvh_layout);
 
    const struct encode_args args = {
       .intermediate_bvh = intermediate_as_addr,
       .output_bvh = vk_acceleration_structure_get_va(dst) + bvh_layout.bvh_offset,
       .header = intermediate_header_addr,
+      .leaf_table = updateable ?
+         vk_acceleration_structure_get_va(dst) + bvh_layout.leaf_table_offset : 0,
       .output_bvh_offset = bvh_layout.bvh_offset,
       .leaf_node_count = leaf_count,
       .geometry_type = geometry_type,
@@ -288,7 +314,8 @@ header(VkCommandBuffer commandBuffer,
    VkGeometryTypeKHR geometry_type = vk_get_as_geometry_type(build_info);
 
    struct bvh_layout bvh_layout;
-   get_bvh_layout(geometry_type, leaf_count, &bvh_layout);
+   get_bvh_layout(geometry_type, leaf_count, is_updateable(build_info),
+                  &bvh_layout);
 
    VkDeviceAddress header_addr = vk_acceleration_structure_get_va(dst);
 
@@ -347,11 +374,150 @@ header(VkCommandBuffer commandBuffer,
    tu_cs_emit_array(cs, header_ptr, header_size / sizeof(uint32_t));
 }
 
+/* The update scratch holds the bounds of every node, followed by the number
+ * of children of each internal node that have been refitted so far.
+ */
+struct update_scratch_layout {
+   uint64_t ready_count_offset;
+   uint64_t size;
+};
+
+static void
+get_update_scratch_layout(uint32_t leaf_count,
+                          struct update_scratch_layout *layout)
+{
+   uint32_t node_count = MAX2(leaf_count, 2) - 1 + leaf_count;
+
+   layout->ready_count_offset = node_count * sizeof(vk_aabb);
+   layout->size = layout->ready_count_offset + node_count * sizeof(uint32_t);
+}
+
+static VkDeviceSize
+get_update_scratch_size(struct vk_device *device, uint32_t leaf_count)
+{
+   struct update_scratch_layout layout;
+   get_update_scratch_layout(leaf_count, &layout);
+   return layout.size;
+}
+
+static void
+init_update_scratch(VkCommandBuffer commandBuffer,
+                    VkDeviceAddress scratch,
+                    uint32_t leaf_count,
+                    struct vk_acceleration_structure *src_as,
+                    struct vk_acceleration_structure *dst_as)
+{
+   struct update_scratch_layout layout;
+   get_update_scratch_layout(leaf_count, &layout);
+
+   tu_cmd_fill_buffer_addr(commandBuffer,
+                           scratch + layout.ready_count_offset,
+                           layout.size - layout.ready_count_offset, 0);
+}
+
+static void
+update_bind_pipeline(VkCommandBuffer commandBuffer)
+{
+   VK_FROM_HANDLE(tu_cmd_buffer, cmdbuf, commandBuffer);
+   struct tu_device *device = cmdbuf->device;
+
+   VkPipeline pipeline;
+   VkPipelineLayout layout;
+   VkResult result =
+      get_pipeline_spv(device, "update", update_spv, sizeof(update_spv),
+                       sizeof(update_args), &pipeline, &layout);
+
+   if (result != VK_SUCCESS) {
+      vk_command_buffer_set_error(&cmdbuf->vk, result);
+      return;
+   }
+
+   /* Wait for the ready counts to be cleared. */
+   static const VkMemoryBarrier mb = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+   };
+
+   vk_common_CmdPipelineBarrier(commandBuffer,
+                                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                0, 1, &mb, 0, NULL, 0, NULL);
+
+   tu_CmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+}
+
+static void
+update(VkCommandBuffer commandBuffer,
+       const VkAccelerationStructureBuildGeometryInfoKHR *build_info,
+       const VkAccelerationStructureBuildRangeInfoKHR *build_range_infos,
+       uint32_t leaf_count,
+       struct vk_acceleration_structure *src,
+       struct vk_acceleration_structure *dst)
+{
+   VK_FROM_HANDLE(tu_cmd_buffer, cmdbuf, commandBuffer);
+   struct tu_device *device = cmdbuf->device;
+
+   VkPipeline pipeline;
+   VkPipelineLayout layout;
+   get_pipeline_spv(device, "update", update_spv, sizeof(update_spv),
+                    sizeof(update_args), &pipeline, &layout);
+
+   struct bvh_layout bvh_layout;
+   get_bvh_layout(vk_get_as_geometry_type(build_info), leaf_count, true,
+                  &bvh_layout);
+
+   struct update_scratch_layout scratch_layout;
+   get_update_scratch_layout(leaf_count, &scratch_layout);
+
+   struct update_args args = {
+      .src = vk_acceleration_structure_get_va(src),
+      .dst = vk_acceleration_structure_get_va(dst),
+      .node_bounds = build_info->scratchData.deviceAddress,
+      .ready_count = build_info->scratchData.deviceAddress +
+                     scratch_layout.ready_count_offset,
+      .bvh_offset = (uint32_t) bvh_layout.bvh_offset,
+      .leaf_table_offset = (uint32_t) bvh_layout.leaf_table_offset,
+   };
+
+   /* Leaves of all geometries go into the same BVH, so the geometries can't
+    * be refitted separately.
+    */
+   uint32_t first_id = 0;
+   for (uint32_t i = 0; i < build_info->geometryCount; i++) {
+      const VkAccelerationStructureGeometryKHR *geom =
+         build_info->pGeometries ? &build_info->pGeometries[i] : build_info->ppGeometries[i];
+      const VkAccelerationStructureBuildRangeInfoKHR *build_range_info =
+         &build_range_infos[i];
+
+      args.geom_data = vk_fill_geometry_data(build_info->type, first_id, i,
+                                             geom, build_range_info);
+
+      vk_common_CmdPushConstants(commandBuffer, layout,
+                                 VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(args),
+                                 &args);
+
+      tu_dispatch_unaligned(commandBuffer, build_range_info->primitiveCount, 1, 1);
+
+      first_id += build_range_info->primitiveCount;
+   }
+
+   if (src != dst) {
+      *(VkDeviceSize *)
+         util_sparse_array_get(&device->accel_struct_ranges,
+                               vk_acceleration_structure_get_va(dst)) = dst->size;
+   }
+}
+
 const struct vk_acceleration_structure_build_ops tu_as_build_ops = {
    .get_as_size = get_bvh_size,
+   .get_update_scratch_size = get_update_scratch_size,
    .get_encode_key = { encode_key, header_key },
    .encode_bind_pipeline = { encode_bind_pipeline, header_bind_pipeline },
    .encode_as = { encode, header },
+   .init_update_scratch = init_update_scratch,
+   .update_bind_pipeline = { update_bind_pipeline },
+   .update_as = { update },
 };
 
 struct radix_sort_vk_target_config tu_radix_sort_config = {
@@ -623,7 +789,8 @@ tu_init_null_accel_struct(struct tu_device *device)
                                     &device->null_accel_struct_bo,
                                     sizeof(tu_accel_struct_header) +
                                     sizeof(tu_internal_node),
-                                    TU_BO_ALLOC_NO_FLAGS, "null AS");
+                                    TU_BO_ALLOC_NO_FLAGS,
+                                    TU_MEM_CATEGORY_INTERNAL, "null AS");
    if (result != VK_SUCCESS) {
       return result;
    }
@@ -10,7 +10,10 @@
 #include "tu_device.h"
 #include "tu_image.h"
 #include "tu_pass.h"
+#include "tu_rp_log.h"
 
+#include "util/blob.h"
+#include "util/disk_cache.h"
 #define XXH_INLINE_ALL
 #include "util/xxhash.h"
 
@@ -57,6 +60,20 @@ tu_autotune_free_results_locked(struct tu_device *dev, struct list_head *results
 #define MAX_HISTORY_RESULTS 5
 /* For how many submissions we store renderpass stats. */
 #define MAX_HISTORY_LIFETIME 128
+/* How many renderpasses we remember across runs. */
+#define MAX_SAVED_HISTORY 1024
+#define SAVED_HISTORY_VERSION 1
+
+/* The timed autotuner needs this many measurements of either mode before
+ * picking one.
+ */
+#define TIMED_MIN_RESULTS 3
+/* Every this many instances it renders with the mode it didn't pick, to
+ * notice when the other one becomes faster.
+ */
+#define TIMED_EXPLORE_INTERVAL 64
+/* How much faster (in percent) the other mode has to be to switch to it. */
+#define TIMED_HYSTERESIS 10
 
 
 /**
@@ -75,6 +92,22 @@ struct tu_renderpass_history {
    uint32_t num_results;
 
    uint32_t avg_samples;
+
+   /* Only used by the timed autotuner: running averages of the GPU time of
+    * GMEM ([0]) and sysmem ([1]) rendering, and the mode picked from them.
+    */
+   uint64_t avg_duration[2];
+   uint32_t num_durations[2];
+   uint32_t prefer_sysmem;
+   uint32_t instance_count;
+};
+
+/**
+ * What is kept of a tu_renderpass_history across runs.
+ */
+struct tu_saved_history {
+   uint64_t key;
+   uint32_t avg_samples;
 };
 
 /* Holds per-submission cs which writes the fence. */
@@ -221,6 +254,164 @@ get_history(struct tu_autotune *at, uint64_t rp_key, uint32_t *avg_samples)
          has_history = true;
       }
    }
+
+   if (!has_history) {
+      entry = _mesa_hash_table_search(at->saved_ht, &rp_key);
+      if (entry) {
+         *avg_samples =
+            ((struct tu_saved_history *) entry->data)->avg_samples;
+         has_history = true;
+      }
+   }
+   u_rwlock_rdunlock(&at->ht_lock);
+
+   return has_history;
+}
+
+/* Must be called with ht_lock held for writing. */
+static void
+save_history_locked(struct tu_autotune *at,
+                    const struct tu_renderpass_history *history)
+{
+   if (!history->num_results)
+      return;
+
+   struct tu_saved_history *saved;
+   struct hash_entry *entry =
+      _mesa_hash_table_search(at->saved_ht, &history->key);
+   if (entry) {
+      saved = (struct tu_saved_history *) entry->data;
+   } else {
+      if (at->saved_ht->entries >= MAX_SAVED_HISTORY)
+         return;
+
+      saved = ralloc(at->saved_ht, struct tu_saved_history);
+      if (!saved)
+         return;
+
+      saved->key = history->key;
+      _mesa_hash_table_insert(at->saved_ht, &saved->key, saved);
+   }
+
+   saved->avg_samples = history->avg_samples;
+}
+
+static void
+saved_history_cache_key(struct tu_autotune *at, struct disk_cache *cache,
+                        cache_key key)
+{
+   const struct vk_app_info *app = &at->device->instance->vk.app_info;
+   struct blob blob;
+
+   /* Sample counts only make sense for the same content. */
+   blob_init(&blob);
+   blob_write_string(&blob, "tu_autotune");
+   blob_write_string(&blob, app->app_name ? app->app_name : "");
+   blob_write_uint32(&blob, app->app_version);
+   blob_write_string(&blob, app->engine_name ? app->engine_name : "");
+   blob_write_uint32(&blob, app->engine_version);
+
+   disk_cache_compute_key(cache, blob.data, blob.size, key);
+   blob_finish(&blob);
+}
+
+static void
+load_saved_history(struct tu_autotune *at)
+{
+   struct disk_cache *cache = at->device->physical_device->vk.disk_cache;
+   if (!cache)
+      return;
+
+   cache_key key;
+   saved_history_cache_key(at, cache, key);
+
+   size_t size;
+   void *data = disk_cache_get(cache, key, &size);
+   if (!data)
+      return;
+
+   struct blob_reader blob;
+   blob_reader_init(&blob, data, size);
+
+   if (blob_read_uint32(&blob) == SAVED_HISTORY_VERSION) {
+      uint32_t count = MIN2(blob_read_uint32(&blob), MAX_SAVED_HISTORY);
+      for (uint32_t i = 0; i < count; i++) {
+         uint64_t rp_key = blob_read_uint64(&blob);
+         uint32_t avg_samples = blob_read_uint32(&blob);
+         if (blob.overrun)
+            break;
+
+         struct tu_saved_history *saved =
+            ralloc(at->saved_ht, struct tu_saved_history);
+         if (!saved)
+            break;
+
+         saved->key = rp_key;
+         saved->avg_samples = avg_samples;
+         _mesa_hash_table_insert(at->saved_ht, &saved->key, saved);
+      }
+   }
+
+   free(data);
+}
+
+static void
+store_saved_history(struct tu_autotune *at)
+{
+   struct disk_cache *cache = at->device->physical_device->vk.disk_cache;
+   if (!cache || !at->saved_ht->entries)
+      return;
+
+   struct blob blob;
+   blob_init(&blob);
+   blob_write_uint32(&blob, SAVED_HISTORY_VERSION);
+   blob_write_uint32(&blob, at->saved_ht->entries);
+
+   hash_table_foreach(at->saved_ht, entry) {
+      struct tu_saved_history *saved =
+         (struct tu_saved_history *) entry->data;
+      blob_write_uint64(&blob, saved->key);
+      blob_write_uint32(&blob, saved->avg_samples);
+   }
+
+   if (!blob.out_of_memory) {
+      cache_key key;
+      saved_history_cache_key(at, cache, key);
+      disk_cache_put(cache, key, blob.data, blob.size, NULL);
+   }
+
+   blob_finish(&blob);
+}
+
+/* Picks the mode for the timed autotuner, returns false if there is no
+ * history for the renderpass yet.
+ */
+static bool
+get_timed_choice(struct tu_autotune *at, uint64_t rp_key, bool *sysmem)
+{
+   bool has_history = false;
+
+   u_rwlock_rdlock(&at->ht_lock);
+   struct hash_entry *entry =
+      _mesa_hash_table_search(at->ht, &rp_key);
+   if (entry) {
+      struct tu_renderpass_history *history =
+         (struct tu_renderpass_history *) entry->data;
+      uint32_t num_gmem = p_atomic_read(&history->num_durations[0]);
+      uint32_t num_sysmem = p_atomic_read(&history->num_durations[1]);
+
+      if (num_gmem < TIMED_MIN_RESULTS || num_sysmem < TIMED_MIN_RESULTS) {
+         /* Still measuring, alternate between the modes. */
+         *sysmem = num_sysmem < num_gmem;
+      } else {
+         uint32_t count = p_atomic_inc_return(&history->instance_count);
+         *sysmem = p_atomic_read(&history->prefer_sysmem);
+         if (count % TIMED_EXPLORE_INTERVAL == 0)
+            *sysmem = !*sysmem;
+      }
+
+      has_history = true;
+   }
    u_rwlock_rdunlock(&at->ht_lock);
 
    return has_history;
@@ -267,6 +458,45 @@ history_add_result(struct tu_device *dev, struct tu_renderpass_history *history,
    p_atomic_set(&history->avg_samples, (uint32_t)avg_samples);
 }
 
+static void
+history_add_duration(struct tu_renderpass_history *history, bool sysmem,
+                     uint64_t duration)
+{
+   unsigned i = sysmem;
+
+   if (!history->num_durations[i])
+      history->avg_duration[i] = duration;
+   else
+      history->avg_duration[i] = (history->avg_duration[i] * 3 + duration) / 4;
+
+   if (history->num_durations[i] < TIMED_MIN_RESULTS)
+      p_atomic_inc(&history->num_durations[i]);
+
+   if (history->num_durations[0] < TIMED_MIN_RESULTS ||
+       history->num_durations[1] < TIMED_MIN_RESULTS)
+      return;
+
+   uint64_t gmem_duration = history->avg_duration[0];
+   uint64_t sysmem_duration = history->avg_duration[1];
+   bool prefer_sysmem = history->prefer_sysmem;
+
+   if (prefer_sysmem &&
+       gmem_duration * 100 < sysmem_duration * (100 - TIMED_HYSTERESIS))
+      prefer_sysmem = false;
+   else if (!prefer_sysmem &&
+            sysmem_duration * 100 < gmem_duration * (100 - TIMED_HYSTERESIS))
+      prefer_sysmem = true;
+
+   if (TU_AUTOTUNE_DEBUG_LOG && prefer_sysmem != history->prefer_sysmem) {
+      mesa_logi("autotune %016" PRIx64 ": switching to %s (gmem=%" PRIu64
+                ", sysmem=%" PRIu64 ")", history->key,
+                prefer_sysmem ? "sysmem" : "gmem",
+                gmem_duration, sysmem_duration);
+   }
+
+   p_atomic_set(&history->prefer_sysmem, prefer_sysmem);
+}
+
 static void
 process_results(struct tu_autotune *at, uint32_t current_fence)
 {
@@ -281,6 +511,28 @@ process_results(struct tu_autotune *at, uint32_t current_fence)
       result->samples_passed =
          result->samples->samples_end - result->samples->samples_start;
 
+      if ((at->timed || dev->rp_log) &&
+          result->samples->ts_end > result->samples->ts_start) {
+         result->duration =
+            result->samples->ts_end - result->samples->ts_start;
+         if (at->timed)
+            history_add_duration(history, result->sysmem, result->duration);
+      }
+
+      if (unlikely(dev->rp_log)) {
+         struct tu_rp_log_result rec = {
+            .hdr = {
+               .type = TU_RP_LOG_RECORD_RESULT,
+               .size = sizeof(rec),
+            },
+            .rp_key = result->rp_key,
+            .sysmem = result->sysmem,
+            .samples_passed = result->samples_passed,
+            .duration_ns = tu_device_ticks_to_ns(dev, result->duration),
+         };
+         tu_rp_log_write(dev, &rec.hdr);
+      }
+
       history_add_result(dev, history, result);
    }
 
@@ -388,6 +640,7 @@ tu_autotune_on_submit(struct tu_device *dev,
          mesa_logi("Removed old history entry %016" PRIx64 "", history->key);
 
       u_rwlock_wrlock(&at->ht_lock);
+      save_history_locked(at, history);
       _mesa_hash_table_remove_key(at->ht, &history->key);
       u_rwlock_wrunlock(&at->ht_lock);
 
@@ -415,12 +668,18 @@ VkResult
 tu_autotune_init(struct tu_autotune *at, struct tu_device *dev)
 {
    at->enabled = true;
+   at->timed = TU_DEBUG(AUTOTUNE_TIME);
    at->device = dev;
    at->ht = _mesa_hash_table_create(NULL,
                                     renderpass_key_hash,
                                     renderpass_key_equals);
+   at->saved_ht = _mesa_hash_table_create(NULL,
+                                          renderpass_key_hash,
+                                          renderpass_key_equals);
    u_rwlock_init(&at->ht_lock);
 
+   load_saved_history(at);
+
    list_inithead(&at->pending_results);
    list_inithead(&at->pending_submission_data);
    list_inithead(&at->submission_data_pool);
@@ -455,10 +714,13 @@ tu_autotune_fini(struct tu_autotune *at, struct tu_device *dev)
    hash_table_foreach(at->ht, entry) {
       struct tu_renderpass_history *history =
          (struct tu_renderpass_history *) entry->data;
+      save_history_locked(at, history);
       free_history(dev, history);
    }
    mtx_unlock(&dev->autotune_mutex);
 
+   store_saved_history(at);
+
    list_for_each_entry_safe(struct tu_submission_data, submission_data,
                             &at->pending_submission_data, node) {
       free_submission_data(submission_data);
@@ -470,6 +732,7 @@ tu_autotune_fini(struct tu_autotune *at, struct tu_device *dev)
    }
 
    _mesa_hash_table_destroy(at->ht, NULL);
+   _mesa_hash_table_destroy(at->saved_ht, NULL);
    u_rwlock_destroy(&at->ht_lock);
 }
 
@@ -540,10 +803,18 @@ estimate_drawcall_bandwidth(const struct tu_cmd_buffer *cmd,
       state->rp.drawcall_bandwidth_per_sample_sum / state->rp.drawcall_count;
 }
 
+uint64_t
+tu_autotune_renderpass_key(const struct tu_cmd_buffer *cmd_buffer)
+{
+   return hash_renderpass_instance(cmd_buffer->state.pass,
+                                   cmd_buffer->state.framebuffer, cmd_buffer);
+}
+
 bool
 tu_autotune_use_bypass(struct tu_autotune *at,
                        struct tu_cmd_buffer *cmd_buffer,
-                       struct tu_renderpass_result **autotune_result)
+                       struct tu_renderpass_result **autotune_result,
+                       enum tu_rp_log_reason *reason)
 {
    const struct tu_render_pass *pass = cmd_buffer->state.pass;
    const struct tu_framebuffer *framebuffer = cmd_buffer->state.framebuffer;
@@ -553,8 +824,10 @@ tu_autotune_use_bypass(struct tu_autotune *at,
     * SINGLE_PRIM_MODE(FLUSH), then that should cause significantly increased
     * sysmem bandwidth (though we haven't quantified it).
     */
-   if (cmd_buffer->state.rp.sysmem_single_prim_mode)
+   if (cmd_buffer->state.rp.sysmem_single_prim_mode) {
+      *reason = TU_RP_LOG_REASON_SINGLE_PRIM_MODE;
       return false;
+   }
 
    /* If the user is using a fragment density map, then this will cause less
     * FS invocations with GMEM, which has a hard-to-measure impact on
@@ -564,8 +837,10 @@ tu_autotune_use_bypass(struct tu_autotune *at,
     * actually faster then they could've just not used the fragment density
     * map.
     */
-   if (pass->has_fdm)
+   if (pass->has_fdm) {
+      *reason = TU_RP_LOG_REASON_FDM;
       return false;
+   }
 
    /* For VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT buffers
     * we would have to allocate GPU memory at the submit time and copy
@@ -576,8 +851,10 @@ tu_autotune_use_bypass(struct tu_autotune *at,
    bool simultaneous_use =
       cmd_buffer->usage_flags & VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
-   if (!at->enabled || simultaneous_use)
+   if (!at->enabled || simultaneous_use) {
+      *reason = TU_RP_LOG_REASON_AUTOTUNE_FALLBACK;
       return fallback_use_bypass(pass, framebuffer, cmd_buffer);
+   }
 
    /* We use 64bit hash as a key since we don't fear rare hash collision,
     * the worst that would happen is sysmem being selected when it should
@@ -592,8 +869,17 @@ tu_autotune_use_bypass(struct tu_autotune *at,
 
    *autotune_result = create_history_result(at, renderpass_key);
 
+   bool select_sysmem;
    uint32_t avg_samples = 0;
-   if (get_history(at, renderpass_key, &avg_samples)) {
+   if (at->timed && get_timed_choice(at, renderpass_key, &select_sysmem)) {
+      *reason = TU_RP_LOG_REASON_AUTOTUNE_TIMED;
+      if (TU_AUTOTUNE_DEBUG_LOG) {
+         mesa_logi("autotune %016" PRIx64 ":%u selecting %s (timed)",
+               renderpass_key,
+               cmd_buffer->state.rp.drawcall_count,
+               select_sysmem ? "sysmem" : "gmem");
+      }
+   } else if (get_history(at, renderpass_key, &avg_samples)) {
       const uint32_t pass_pixel_count =
          get_render_pass_pixel_count(cmd_buffer);
       uint64_t sysmem_bandwidth =
@@ -613,7 +899,8 @@ tu_autotune_use_bypass(struct tu_autotune *at,
        */
       gmem_bandwidth = (gmem_bandwidth * 11 + total_draw_call_bandwidth) / 10;
 
-      const bool select_sysmem = sysmem_bandwidth <= gmem_bandwidth;
+      select_sysmem = sysmem_bandwidth <= gmem_bandwidth;
+      *reason = TU_RP_LOG_REASON_AUTOTUNE;
       if (TU_AUTOTUNE_DEBUG_LOG) {
          const VkExtent2D *extent = &cmd_buffer->state.render_area.extent;
          const float drawcall_bandwidth_per_sample =
@@ -635,11 +922,34 @@ tu_autotune_use_bypass(struct tu_autotune *at,
          mesa_logi("   sysmem_bandwidth=%" PRIu64 ", gmem_bandwidth=%" PRIu64,
                sysmem_bandwidth, gmem_bandwidth);
       }
-
-      return select_sysmem;
+   } else {
+      select_sysmem = fallback_use_bypass(pass, framebuffer, cmd_buffer);
+      *reason = TU_RP_LOG_REASON_AUTOTUNE_FALLBACK;
    }
 
-   return fallback_use_bypass(pass, framebuffer, cmd_buffer);
+   (*autotune_result)->sysmem = select_sysmem;
+   (*autotune_result)->avg_samples = avg_samples;
+   return select_sysmem;
+}
+
+template <chip CHIP>
+static void
+emit_timestamp(struct tu_cs *cs, uint64_t iova)
+{
+   if (CHIP == A6XX) {
+      tu_cs_emit_pkt7(cs, CP_EVENT_WRITE, 4);
+      tu_cs_emit(cs, CP_EVENT_WRITE_0_EVENT(RB_DONE_TS) |
+                     CP_EVENT_WRITE_0_TIMESTAMP);
+      tu_cs_emit_qw(cs, iova);
+      tu_cs_emit(cs, 0x00000000);
+   } else {
+      tu_cs_emit_pkt7(cs, CP_EVENT_WRITE7, 3);
+      tu_cs_emit(cs, CP_EVENT_WRITE7_0(.event = RB_DONE_TS,
+                                       .write_src = EV_WRITE_ALWAYSON,
+                                       .write_dst = EV_DST_RAM,
+                                       .write_enabled = true).value);
+      tu_cs_emit_qw(cs, iova);
+   }
 }
 
 template <chip CHIP>
@@ -696,6 +1006,10 @@ tu_autotune_begin_renderpass(struct tu_cmd_buffer *cmd,
       tu_cs_emit_pkt7(cs, CP_EVENT_WRITE, 1);
       tu_cs_emit(cs, ZPASS_DONE);
    }
+
+   if (dev->autotune.timed || dev->rp_log)
+      emit_timestamp<CHIP>(cs, result_iova +
+                               offsetof(struct tu_renderpass_samples, ts_start));
 }
 TU_GENX(tu_autotune_begin_renderpass);
 
@@ -742,5 +1056,9 @@ void tu_autotune_end_renderpass(struct tu_cmd_buffer *cmd,
       tu_cs_emit_pkt7(cs, CP_EVENT_WRITE, 1);
       tu_cs_emit(cs, ZPASS_DONE);
    }
+
+   if (cmd->device->autotune.timed || cmd->device->rp_log)
+      emit_timestamp<CHIP>(cs, autotune_result->bo.iova +
+                               offsetof(struct tu_renderpass_samples, ts_end));
 }
 TU_GENX(tu_autotune_end_renderpass);
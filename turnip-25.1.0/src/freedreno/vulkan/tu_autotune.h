@@ -11,6 +11,7 @@
 #include "util/hash_table.h"
 #include "util/rwlock.h"
 
+#include "tu_rp_log_format.h"
 #include "tu_suballoc.h"
 
 struct tu_renderpass_history;
@@ -51,6 +52,11 @@ struct tu_autotune {
     */
    bool enabled;
 
+   /* Decide from the measured GPU time of both modes instead of from the
+    * bandwidth estimates (TU_DEBUG=autotune_time).
+    */
+   bool timed;
+
    struct tu_device *device;
 
    /**
@@ -60,6 +66,13 @@ struct tu_autotune {
    struct hash_table *ht;
    struct u_rwlock ht_lock;
 
+   /**
+    * Average sample counts kept across runs in the disk cache: the ones
+    * loaded at init, updated from history entries as they are dropped and
+    * written back at fini.  Protected by ht_lock.
+    */
+   struct hash_table *saved_ht;
+
    /**
     * List of per-renderpass results that we are waiting for the GPU
     * to finish with before reading back the results.
@@ -96,6 +109,12 @@ struct PACKED tu_renderpass_samples {
    uint64_t __pad0;
    uint64_t samples_end;
    uint64_t __pad1;
+
+   /* Only written by the timed autotuner. */
+   uint64_t ts_start;
+   uint64_t ts_end;
+   /* Keeps the size a power of two, it is also used as alignment. */
+   uint64_t __pad2[2];
 };
 
 /* Necessary when writing sample counts using CP_EVENT_WRITE7::ZPASS_DONE. */
@@ -120,6 +139,11 @@ struct tu_renderpass_result {
    struct list_head node;
    uint32_t fence;
    uint64_t samples_passed;
+   /* The mode that was picked, and how long it took on the GPU. */
+   bool sysmem;
+   uint64_t duration;
+   /* history average the decision was based on, for TU_RP_LOG */
+   uint32_t avg_samples;
 };
 
 VkResult tu_autotune_init(struct tu_autotune *at, struct tu_device *dev);
@@ -127,7 +151,10 @@ void tu_autotune_fini(struct tu_autotune *at, struct tu_device *dev);
 
 bool tu_autotune_use_bypass(struct tu_autotune *at,
                             struct tu_cmd_buffer *cmd_buffer,
-                            struct tu_renderpass_result **autotune_result);
+                            struct tu_renderpass_result **autotune_result,
+                            enum tu_rp_log_reason *reason);
+
+uint64_t tu_autotune_renderpass_key(const struct tu_cmd_buffer *cmd_buffer);
 void tu_autotune_free_results(struct tu_device *dev, struct list_head *results);
 
 bool tu_autotune_submit_requires_fence(struct tu_cmd_buffer **cmd_buffers,
@@ -12,6 +12,7 @@
 #include "vk_debug_utils.h"
 
 #include "tu_device.h"
+#include "tu_dgc.h"
 #include "tu_rmv.h"
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -57,6 +58,10 @@ tu_DestroyBuffer(VkDevice _device,
    tu_perfetto_log_destroy_buffer(device, buffer);
 #endif
 
+   if (buffer->bo &&
+       (buffer->vk.usage & VK_BUFFER_USAGE_2_PREPROCESS_BUFFER_BIT_EXT))
+      tu_dgc_unregister_buffer(device, buffer);
+
    if (buffer->vk.device_address)
       vk_address_binding_report(&instance->vk, &buffer->vk.base,
                                 buffer->vk.device_address, buffer->bo_size,
@@ -78,7 +83,8 @@ tu_GetDeviceBufferMemoryRequirements(
    pMemoryRequirements->memoryRequirements = (VkMemoryRequirements) {
       .size = MAX2(align64(size, 64), size),
       .alignment = 64,
-      .memoryTypeBits = (1 << device->physical_device->memory.type_count) - 1,
+      .memoryTypeBits = ((1 << device->physical_device->memory.type_count) - 1) &
+                        ~device->physical_device->memory.lazy_type_mask,
    };
 
    vk_foreach_struct(ext, pMemoryRequirements->pNext) {
@@ -153,6 +159,8 @@ tu_BindBufferMemory2(VkDevice device,
              (VK_BUFFER_USAGE_2_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT |
               VK_BUFFER_USAGE_2_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT))
             tu_bo_allow_dump(dev, mem->bo);
+         if (buffer->vk.usage & VK_BUFFER_USAGE_2_PREPROCESS_BUFFER_BIT_EXT)
+            tu_dgc_register_buffer(dev, buffer);
 #ifdef HAVE_PERFETTO
          tu_perfetto_log_bind_buffer(dev, buffer);
 #endif
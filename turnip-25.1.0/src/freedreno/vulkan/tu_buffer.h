@@ -20,6 +20,9 @@ struct tu_buffer
 
    struct tu_bo *bo;
    uint64_t bo_size;
+
+   /* Link in tu_device::dgc_buffers for preprocess buffers. */
+   struct list_head dgc_link;
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(tu_buffer, vk.base, VkBuffer,
@@ -2124,7 +2124,7 @@ tu6_clear_lrz(struct tu_cmd_buffer *cmd,
               VK_SAMPLE_COUNT_1_BIT);
    ops->clear_value(cmd, cs, PIPE_FORMAT_Z16_UNORM, value);
    ops->dst_buffer(cs, PIPE_FORMAT_Z16_UNORM,
-                   image->iova + image->lrz_layout.lrz_offset,
+                   image->lrz_iova,
                    image->lrz_layout.lrz_pitch * 2, PIPE_FORMAT_Z16_UNORM);
    uint32_t lrz_height = image->lrz_layout.lrz_height * image->vk.array_layers;
    ops->coords(cmd, cs, (VkOffset2D) {}, blt_no_coord,
@@ -2152,7 +2152,8 @@ tu6_dirty_lrz_fc(struct tu_cmd_buffer *cmd,
    clear.color.uint32[0] = 0xffffffff;
 
    using LRZFC = fd_lrzfc_layout<CHIP>;
-   uint64_t lrz_fc_iova = image->iova + image->lrz_layout.lrz_fc_offset;
+   uint64_t lrz_fc_iova = image->lrz_iova + image->lrz_layout.lrz_fc_offset -
+                          image->lrz_layout.lrz_offset;
    ops->setup(cmd, cs, PIPE_FORMAT_R32_UINT, PIPE_FORMAT_R32_UINT,
               VK_IMAGE_ASPECT_COLOR_BIT, 0, true, false,
               VK_SAMPLE_COUNT_1_BIT);
@@ -2531,6 +2532,127 @@ tu_CmdCopyBufferToImage2(VkCommandBuffer commandBuffer,
 }
 TU_GENX(tu_CmdCopyBufferToImage2);
 
+/* Below this many bytes per band, splitting a host copy across threads
+ * costs more than it saves.
+ */
+#define TU_HOST_COPY_MIN_BAND_SIZE (1024 * 1024)
+#define TU_HOST_COPY_MAX_BANDS 8
+
+struct tu_host_copy_job {
+   struct util_queue_fence fence;
+   const struct tu_device *device;
+   bool to_tiled;
+   uint32_t x, y, width, height;
+   char *tiled;
+   char *linear;
+   const struct fdl_layout *layout;
+   unsigned miplevel;
+   uint32_t linear_pitch;
+};
+
+static void
+tu_host_copy_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct tu_host_copy_job *job = (struct tu_host_copy_job *) data;
+   const struct fdl_ubwc_config *config =
+      &job->device->physical_device->ubwc_config;
+
+   if (job->to_tiled) {
+      fdl6_memcpy_linear_to_tiled(job->x, job->y, job->width, job->height,
+                                  job->tiled, job->linear, job->layout,
+                                  job->miplevel, job->linear_pitch, config);
+   } else {
+      fdl6_memcpy_tiled_to_linear(job->x, job->y, job->width, job->height,
+                                  job->linear, job->tiled, job->layout,
+                                  job->miplevel, job->linear_pitch, config);
+   }
+}
+
+/* Copies between a tiled miplevel and linear memory on the CPU. Large copies
+ * are split into bands of whole macrotile rows, which don't share any tiled
+ * memory, and all but the last band are handed to the device's worker
+ * threads. linear points at the first row of the copied region.
+ */
+static void
+tu_host_copy_tiled(struct tu_device *device, bool to_tiled,
+                   uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                   char *tiled, char *linear,
+                   const struct fdl_layout *layout, unsigned miplevel,
+                   uint32_t linear_pitch)
+{
+   struct tu_host_copy_job jobs[TU_HOST_COPY_MAX_BANDS];
+   uint64_t size = (uint64_t) width * height * layout->cpp;
+   uint32_t band_count = 1;
+
+   if (util_queue_is_initialized(&device->compile_queue)) {
+      band_count = MIN3(size / TU_HOST_COPY_MIN_BAND_SIZE,
+                        device->compile_queue.num_threads + 1,
+                        TU_HOST_COPY_MAX_BANDS);
+      band_count = MAX2(band_count, 1);
+   }
+
+   if (band_count == 1) {
+      jobs[0] = (struct tu_host_copy_job) {
+         .device = device,
+         .to_tiled = to_tiled,
+         .x = x,
+         .y = y,
+         .width = width,
+         .height = height,
+         .tiled = tiled,
+         .linear = linear,
+         .layout = layout,
+         .miplevel = miplevel,
+         .linear_pitch = linear_pitch,
+      };
+      tu_host_copy_job_execute(&jobs[0], NULL, 0);
+      return;
+   }
+
+   uint32_t block_width, block_height;
+   fdl6_get_ubwc_blockwidth(layout, &block_width, &block_height);
+   uint32_t band_align = block_height * 4;
+   uint32_t band_rows = align(DIV_ROUND_UP(height, band_count), band_align);
+
+   uint32_t job_count = 0;
+   for (uint32_t band_y = y; band_y < y + height;) {
+      /* Band boundaries are aligned in image space. The unaligned start can
+       * add a band, which the last slot absorbs.
+       */
+      uint32_t band_end =
+         job_count == TU_HOST_COPY_MAX_BANDS - 1 ? y + height :
+         MIN2(ROUND_DOWN_TO(band_y + band_rows, band_align), y + height);
+
+      jobs[job_count++] = (struct tu_host_copy_job) {
+         .device = device,
+         .to_tiled = to_tiled,
+         .x = x,
+         .y = band_y,
+         .width = width,
+         .height = band_end - band_y,
+         .tiled = tiled,
+         .linear = linear + (uint64_t) (band_y - y) * linear_pitch,
+         .layout = layout,
+         .miplevel = miplevel,
+         .linear_pitch = linear_pitch,
+      };
+      band_y = band_end;
+   }
+
+   for (uint32_t i = 0; i + 1 < job_count; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&device->compile_queue, &jobs[i], &jobs[i].fence,
+                         tu_host_copy_job_execute, NULL, 0);
+   }
+
+   tu_host_copy_job_execute(&jobs[job_count - 1], NULL, 0);
+
+   for (uint32_t i = 0; i + 1 < job_count; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
 static void
 tu_copy_memory_to_image(struct tu_device *device,
                         struct tu_image *dst_image,
@@ -2586,12 +2708,10 @@ tu_copy_memory_to_image(struct tu_device *device,
                    extent.width * layout->cpp);
          }
       } else {
-         fdl6_memcpy_linear_to_tiled(offset.x, offset.y,
-                                     extent.width, extent.height,
-                                     dst, src, layout,
-                                     info->imageSubresource.mipLevel,
-                                     src_pitch,
-                                     &device->physical_device->ubwc_config);
+         tu_host_copy_tiled(device, true, offset.x, offset.y,
+                            extent.width, extent.height,
+                            dst, (char *) src, layout,
+                            info->imageSubresource.mipLevel, src_pitch);
       }
 
       if (dst_image->bo->cached_non_coherent) {
@@ -2775,12 +2895,10 @@ tu_copy_image_to_memory(struct tu_device *device,
                    extent.width * layout->cpp);
          }
       } else {
-         fdl6_memcpy_tiled_to_linear(offset.x, offset.y,
-                                     extent.width, extent.height,
-                                     dst, src, layout,
-                                     info->imageSubresource.mipLevel,
-                                     dst_pitch,
-                                     &device->physical_device->ubwc_config);
+         tu_host_copy_tiled(device, false, offset.x, offset.y,
+                            extent.width, extent.height,
+                            (char *) src, dst, layout,
+                            info->imageSubresource.mipLevel, dst_pitch);
       }
    }
 }
@@ -3165,14 +3283,12 @@ tu_copy_image_to_image_cpu(struct tu_device *device,
                    extent.width * src_layout->cpp);
          }
       } else if (!src_tiled) {
-         fdl6_memcpy_linear_to_tiled(dst_offset.x, dst_offset.y,
-                                     extent.width, extent.height,
-                                     dst,
-                                     src + src_pitch * src_offset.y + src_offset.x * src_layout->cpp,
-                                     dst_layout,
-                                     info->dstSubresource.mipLevel,
-                                     src_pitch,
-                                     &device->physical_device->ubwc_config);
+         tu_host_copy_tiled(device, true, dst_offset.x, dst_offset.y,
+                            extent.width, extent.height,
+                            dst,
+                            (char *) src + src_pitch * src_offset.y + src_offset.x * src_layout->cpp,
+                            dst_layout, info->dstSubresource.mipLevel,
+                            src_pitch);
       } else if (!dst_tiled) {
          fdl6_memcpy_tiled_to_linear(src_offset.x, src_offset.y,
                                      extent.width, extent.height,
@@ -3298,15 +3414,25 @@ copy_buffer(struct tu_cmd_buffer *cmd,
       uint32_t src_x = (src_va & 63) / block_size;
       uint32_t dst_x = (dst_va & 63) / block_size;
       uint32_t width = MIN2(MIN2(blocks, 0x4000 - src_x), 0x4000 - dst_x);
+      uint32_t height = 1, pitch = 0;
+
+      /* When both sides are aligned, copy as many full rows as possible
+       * with a single blit instead of one blit per row.
+       */
+      if (src_x == 0 && dst_x == 0 && blocks >= 2 * 0x4000) {
+         width = 0x4000;
+         height = MIN2(blocks / 0x4000, 0x4000);
+         pitch = width * block_size;
+      }
 
-      ops->src_buffer(cmd, cs, format, src_va & ~63, 0, src_x + width, 1, format);
-      ops->dst_buffer(     cs, format, dst_va & ~63, 0, format);
-      ops->coords(cmd, cs, (VkOffset2D) {dst_x}, (VkOffset2D) {src_x}, (VkExtent2D) {width, 1});
+      ops->src_buffer(cmd, cs, format, src_va & ~63, pitch, src_x + width, height, format);
+      ops->dst_buffer(     cs, format, dst_va & ~63, pitch, format);
+      ops->coords(cmd, cs, (VkOffset2D) {dst_x}, (VkOffset2D) {src_x}, (VkExtent2D) {width, height});
       ops->run(cmd, cs);
 
-      src_va += width * block_size;
-      dst_va += width * block_size;
-      blocks -= width;
+      src_va += (uint64_t) width * height * block_size;
+      dst_va += (uint64_t) width * height * block_size;
+      blocks -= width * height;
    }
 
    ops->teardown(cmd, cs);
@@ -3388,13 +3514,21 @@ tu_cmd_fill_buffer(VkCommandBuffer commandBuffer,
    while (blocks) {
       uint32_t dst_x = (dstAddr & 63) / 4;
       uint32_t width = MIN2(blocks, 0x4000 - dst_x);
+      uint32_t height = 1, pitch = 0;
 
-      ops->dst_buffer(cs, PIPE_FORMAT_R32_UINT, dstAddr & ~63, 0, PIPE_FORMAT_R32_UINT);
-      ops->coords(cmd, cs, (VkOffset2D) {dst_x}, blt_no_coord, (VkExtent2D) {width, 1});
+      /* Fill full rows of an aligned destination with a single blit. */
+      if (dst_x == 0 && blocks >= 2 * 0x4000) {
+         width = 0x4000;
+         height = MIN2(blocks / 0x4000, 0x4000);
+         pitch = width * 4;
+      }
+
+      ops->dst_buffer(cs, PIPE_FORMAT_R32_UINT, dstAddr & ~63, pitch, PIPE_FORMAT_R32_UINT);
+      ops->coords(cmd, cs, (VkOffset2D) {dst_x}, blt_no_coord, (VkExtent2D) {width, height});
       ops->run(cmd, cs);
 
-      dstAddr += width * 4;
-      blocks -= width;
+      dstAddr += (uint64_t) width * height * 4;
+      blocks -= width * height;
    }
 
    ops->teardown(cmd, cs);
@@ -3432,6 +3566,13 @@ tu_CmdFillBuffer(VkCommandBuffer commandBuffer,
 }
 TU_GENX(tu_CmdFillBuffer);
 
+template <chip CHIP>
+static bool
+tu_fold_resolve_image(struct tu_cmd_buffer *cmd,
+                      struct tu_image *src_image,
+                      struct tu_image *dst_image,
+                      const VkImageResolve2 *info);
+
 template <chip CHIP>
 VKAPI_ATTR void VKAPI_CALL
 tu_CmdResolveImage2(VkCommandBuffer commandBuffer,
@@ -3443,6 +3584,11 @@ tu_CmdResolveImage2(VkCommandBuffer commandBuffer,
    const struct blit_ops *ops = &r2d_ops<CHIP>;
    struct tu_cs *cs = &cmd->cs;
 
+   if (pResolveImageInfo->regionCount == 1 &&
+       tu_fold_resolve_image<CHIP>(cmd, src_image, dst_image,
+                                   &pResolveImageInfo->pRegions[0]))
+      return;
+
    enum pipe_format src_format =
       vk_format_to_pipe_format(src_image->vk.format);
    enum pipe_format dst_format =
@@ -5218,11 +5364,10 @@ store_3d_blit(struct tu_cmd_buffer *cmd,
 }
 
 static bool
-tu_attachment_store_unaligned(struct tu_cmd_buffer *cmd, uint32_t a)
+tu_store_unaligned(struct tu_cmd_buffer *cmd, const struct fdl6_view *view,
+                   const VkRect2D *render_area)
 {
    struct tu_physical_device *phys_dev = cmd->device->physical_device;
-   const struct tu_image_view *iview = cmd->state.attachments[a];
-   const VkRect2D *render_area = &cmd->state.render_area;
 
    /* Unaligned store is incredibly rare in CTS, we have to force it to test. */
    if (TU_DEBUG(UNALIGNED_STORE))
@@ -5241,14 +5386,131 @@ tu_attachment_store_unaligned(struct tu_cmd_buffer *cmd, uint32_t a)
     * have the required y padding in the layout (except for the last level)
     */
    bool need_y2_align =
-      y2 != iview->view.height || iview->view.need_y2_align;
+      y2 != view->height || view->need_y2_align;
 
    return (x1 % phys_dev->info->gmem_align_w ||
-           (x2 % phys_dev->info->gmem_align_w && x2 != iview->view.width) ||
+           (x2 % phys_dev->info->gmem_align_w && x2 != view->width) ||
            y1 % phys_dev->info->gmem_align_h ||
            (y2 % phys_dev->info->gmem_align_h && need_y2_align));
 }
 
+static bool
+tu_attachment_store_unaligned(struct tu_cmd_buffer *cmd, uint32_t a)
+{
+   return tu_store_unaligned(cmd, &cmd->state.attachments[a]->view,
+                             &cmd->state.render_area);
+}
+
+/* Turns a resolve of an MSAA attachment stored by the render pass that was
+ * just recorded into a resolve from GMEM in each of its tiles, see struct
+ * tu_resolve_fold. Only a resolve of the whole render area that can use the
+ * fast path is folded.
+ */
+template <chip CHIP>
+static bool
+tu_fold_resolve_image(struct tu_cmd_buffer *cmd,
+                      struct tu_image *src_image,
+                      struct tu_image *dst_image,
+                      const VkImageResolve2 *info)
+{
+   struct tu_resolve_fold *fold = &cmd->resolve_fold;
+   const VkRect2D *render_area = &fold->render_area;
+
+   if (!fold->attachment_count ||
+       cmd->cs.cur != fold->cs_cur ||
+       cmd->cs.entry_count != fold->cs_entry_count)
+      return false;
+
+   if (info->srcOffset.x != render_area->offset.x ||
+       info->srcOffset.y != render_area->offset.y ||
+       info->dstOffset.x != render_area->offset.x ||
+       info->dstOffset.y != render_area->offset.y ||
+       info->extent.width != render_area->extent.width ||
+       info->extent.height != render_area->extent.height ||
+       info->srcOffset.z || info->dstOffset.z || info->extent.depth != 1 ||
+       vk_image_subresource_layer_count(&src_image->vk,
+                                        &info->srcSubresource) != 1 ||
+       src_image->vk.format != dst_image->vk.format ||
+       !blit_can_resolve(dst_image->vk.format))
+      return false;
+
+   struct tu_resolve_fold_attachment *att = NULL;
+   for (uint32_t i = 0; i < fold->attachment_count; i++) {
+      struct tu_resolve_fold_attachment *cur = &fold->attachments[i];
+      if (!cur->folded && cur->image == src_image &&
+          cur->level == info->srcSubresource.mipLevel &&
+          cur->layer == info->srcSubresource.baseArrayLayer &&
+          cur->format == dst_image->vk.format) {
+         att = cur;
+         break;
+      }
+   }
+   if (!att)
+      return false;
+
+   struct fdl6_view dst;
+   tu_image_view_blit<CHIP>(&dst, dst_image, &info->dstSubresource, 0);
+
+   if (dst.is_mutable != att->is_mutable ||
+       tu_store_unaligned(cmd, &dst, render_area))
+      return false;
+
+   struct tu_cs cs;
+   VkResult result = tu_cs_begin_sub_stream(&cmd->sub_cs, 32, &cs);
+   if (result != VK_SUCCESS) {
+      vk_command_buffer_set_error(&cmd->vk, result);
+      return false;
+   }
+
+   tu_cs_emit_pkt7(&cs, CP_SET_MARKER, 1);
+   tu_cs_emit(&cs, A6XX_CP_SET_MARKER_0_MODE(RM6_BIN_RESOLVE) |
+                   A6XX_CP_SET_MARKER_0_USES_GMEM);
+
+   tu_cs_emit_regs(&cs,
+                   A6XX_RB_BLIT_SCISSOR_TL(.x = render_area->offset.x,
+                                           .y = render_area->offset.y),
+                   A6XX_RB_BLIT_SCISSOR_BR(.x = render_area->offset.x +
+                                                render_area->extent.width - 1,
+                                           .y = render_area->offset.y +
+                                                render_area->extent.height - 1));
+
+   const struct tu_render_pass_attachment src = {
+      .format = att->format,
+      .samples = att->samples,
+   };
+   struct tu_resolve_group resolve_group = {};
+   uint32_t buffer_id =
+      tu_resolve_group_include_buffer<CHIP>(&resolve_group, att->format);
+   event_blit_setup(&cs, buffer_id, &src, BLIT_EVENT_STORE, 0);
+   tu_cs_emit_regs(&cs, A6XX_RB_BLIT_BASE_GMEM(att->gmem_offset));
+
+   const struct event_blit_dst_view blt_view = {
+      .image = dst_image,
+      .view = &dst,
+      .layer = 0,
+   };
+   event_blit_run<CHIP>(cmd, &cs, NULL, &blt_view, false);
+   tu_emit_resolve_group<CHIP>(cmd, &cs, &resolve_group);
+
+   struct tu_cs_entry entry = tu_cs_end_sub_stream(&cmd->sub_cs, &cs);
+
+   uint32_t stride = fold->attachment_count;
+   uint32_t idx = att - fold->attachments;
+   uint32_t **slots = util_dynarray_begin(&fold->slots);
+   uint32_t slot_count =
+      util_dynarray_num_elements(&fold->slots, uint32_t *);
+   for (uint32_t i = idx; i < slot_count; i += stride) {
+      uint32_t *slot = slots[i];
+      slot[0] = pm4_pkt7_hdr(CP_INDIRECT_BUFFER, 3);
+      slot[1] = entry.bo->iova + entry.offset;
+      slot[2] = (entry.bo->iova + entry.offset) >> 32;
+      slot[3] = entry.size / sizeof(uint32_t);
+   }
+
+   att->folded = true;
+   return true;
+}
+
 /* The fast path cannot handle mismatched mutability. */
 static bool
 tu_attachment_store_mismatched_mutability(struct tu_cmd_buffer *cmd, uint32_t a,
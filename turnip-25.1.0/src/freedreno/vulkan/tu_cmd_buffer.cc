@@ -16,8 +16,11 @@
 #include "tu_buffer.h"
 #include "tu_clear_blit.h"
 #include "tu_cs.h"
+#include "tu_dgc.h"
 #include "tu_event.h"
 #include "tu_image.h"
+#include "tu_rp_log.h"
+#include "tu_shader_object.h"
 #include "tu_tracepoints.h"
 
 #include "common/freedreno_gpu_event.h"
@@ -198,6 +201,16 @@ tu6_emit_flushes(struct tu_cmd_buffer *cmd_buffer,
    BITMASK_ENUM(tu_cmd_flush_bits) flushes = cache->flush_bits;
    cache->flush_bits = 0;
 
+   /* Flushes in the draw_cs execute after everything recorded before the
+    * render pass ends, so only the outside cache can be checked against
+    * dirty_caches.
+    */
+   bool outside_rp = cache == &cmd_buffer->state.cache;
+   if (outside_rp) {
+      flushes &= ~(TU_CMD_FLAG_ALL_CACHE_CLEAN &
+                   ~cmd_buffer->state.dirty_caches);
+   }
+
    if (TU_DEBUG(FLUSHALL))
       flushes |= TU_CMD_FLAG_ALL_CLEAN | TU_CMD_FLAG_ALL_INVALIDATE;
 
@@ -223,6 +236,16 @@ tu6_emit_flushes(struct tu_cmd_buffer *cmd_buffer,
       tu_emit_event_write<CHIP>(cmd_buffer, cs, FD_CCU_INVALIDATE_DEPTH);
    if (flushes & TU_CMD_FLAG_CACHE_CLEAN)
       tu_emit_event_write<CHIP>(cmd_buffer, cs, FD_CACHE_CLEAN);
+   if (outside_rp) {
+      if (flushes & (TU_CMD_FLAG_CCU_CLEAN_COLOR |
+                     TU_CMD_FLAG_CCU_INVALIDATE_COLOR))
+         cmd_buffer->state.dirty_caches &= ~TU_CMD_FLAG_CCU_CLEAN_COLOR;
+      if (flushes & (TU_CMD_FLAG_CCU_CLEAN_DEPTH |
+                     TU_CMD_FLAG_CCU_INVALIDATE_DEPTH))
+         cmd_buffer->state.dirty_caches &= ~TU_CMD_FLAG_CCU_CLEAN_DEPTH;
+      if (flushes & TU_CMD_FLAG_CACHE_CLEAN)
+         cmd_buffer->state.dirty_caches &= ~TU_CMD_FLAG_CACHE_CLEAN;
+   }
    if (flushes & TU_CMD_FLAG_CACHE_INVALIDATE)
       tu_emit_event_write<CHIP>(cmd_buffer, cs, FD_CACHE_INVALIDATE);
    if (flushes & TU_CMD_FLAG_BINDLESS_DESCRIPTOR_INVALIDATE) {
@@ -402,6 +425,10 @@ tu_emit_cache_flush_ccu(struct tu_cmd_buffer *cmd_buffer,
 
    tu6_emit_flushes<CHIP>(cmd_buffer, cs, &cmd_buffer->state.cache);
 
+   /* Whatever comes next writes through the CCU. */
+   cmd_buffer->state.dirty_caches |=
+      TU_CMD_FLAG_CCU_CLEAN_COLOR | TU_CMD_FLAG_CCU_CLEAN_DEPTH;
+
    if (ccu_state != cmd_buffer->state.ccu_state) {
       emit_rb_ccu_cntl<CHIP>(cs, cmd_buffer->device,
                              ccu_state == TU_CMD_CCU_GMEM);
@@ -1021,21 +1048,30 @@ use_hw_binning(struct tu_cmd_buffer *cmd)
       return true;
    }
 
+   /* A pass with only loads, clears and stores has nothing to bin, so skip
+    * the binning pass and treat every tile as visible.
+    */
+   if (!cmd->state.rp.drawcall_count && !TU_DEBUG(FORCEBIN))
+      return false;
+
    return vsc->binning;
 }
 
 static bool
 use_sysmem_rendering(struct tu_cmd_buffer *cmd,
-                     struct tu_renderpass_result **autotune_result)
+                     struct tu_renderpass_result **autotune_result,
+                     enum tu_rp_log_reason *reason)
 {
    if (TU_DEBUG(SYSMEM)) {
       cmd->state.rp.gmem_disable_reason = "TU_DEBUG(SYSMEM)";
+      *reason = TU_RP_LOG_REASON_DEBUG_SYSMEM;
       return true;
    }
 
    /* can't fit attachments into gmem */
    if (!cmd->state.tiling->possible) {
       cmd->state.rp.gmem_disable_reason = "Can't fit attachments into gmem";
+      *reason = TU_RP_LOG_REASON_GMEM_TOO_SMALL;
       return true;
    }
 
@@ -1043,16 +1079,19 @@ use_sysmem_rendering(struct tu_cmd_buffer *cmd,
    if (cmd->state.render_area.extent.width == 0 ||
        cmd->state.render_area.extent.height == 0) {
       cmd->state.rp.gmem_disable_reason = "Render area is empty";
+      *reason = TU_RP_LOG_REASON_EMPTY_RENDER_AREA;
       return true;
    }
 
    if (cmd->state.rp.has_tess) {
       cmd->state.rp.gmem_disable_reason = "Uses tessellation shaders";
+      *reason = TU_RP_LOG_REASON_TESS;
       return true;
    }
 
    if (cmd->state.rp.disable_gmem) {
       /* gmem_disable_reason is set where disable_gmem is set. */
+      *reason = TU_RP_LOG_REASON_GMEM_DISABLED;
       return true;
    }
 
@@ -1062,6 +1101,7 @@ use_sysmem_rendering(struct tu_cmd_buffer *cmd,
    if (cmd->state.rp.xfb_used && !vsc->binning_possible) {
       cmd->state.rp.gmem_disable_reason =
          "XFB is incompatible with non-hw binning GMEM rendering";
+      *reason = TU_RP_LOG_REASON_XFB;
       return true;
    }
 
@@ -1073,14 +1113,17 @@ use_sysmem_rendering(struct tu_cmd_buffer *cmd,
        !vsc->binning_possible) {
       cmd->state.rp.gmem_disable_reason =
          "QUERY_TYPE_PRIMITIVES_GENERATED is incompatible with non-hw binning GMEM rendering";
+      *reason = TU_RP_LOG_REASON_PRIM_GENERATED_QUERY;
       return true;
    }
 
-   if (TU_DEBUG(GMEM))
+   if (TU_DEBUG(GMEM)) {
+      *reason = TU_RP_LOG_REASON_DEBUG_GMEM;
       return false;
+   }
 
    bool use_sysmem = tu_autotune_use_bypass(&cmd->device->autotune,
-                                            cmd, autotune_result);
+                                            cmd, autotune_result, reason);
    if (*autotune_result) {
       list_addtail(&(*autotune_result)->node, &cmd->renderpass_autotune_results);
    }
@@ -1092,6 +1135,44 @@ use_sysmem_rendering(struct tu_cmd_buffer *cmd,
    return use_sysmem;
 }
 
+static void
+tu_rp_log_render_pass(struct tu_cmd_buffer *cmd, bool sysmem,
+                      enum tu_rp_log_reason reason,
+                      const struct tu_renderpass_result *autotune_result)
+{
+   const struct tu_vsc_config *vsc = tu_vsc_config(cmd, cmd->state.tiling);
+   const struct tu_lrz_state *lrz = &cmd->state.lrz;
+
+   struct tu_rp_log_pass rec = {
+      .hdr = {
+         .type = TU_RP_LOG_RECORD_PASS,
+         .size = sizeof(rec),
+      },
+      .rp_key = autotune_result ? autotune_result->rp_key :
+                                  tu_autotune_renderpass_key(cmd),
+      .sysmem = sysmem,
+      .reason = (uint8_t) reason,
+      .binning = !sysmem && use_hw_binning(cmd),
+      .lrz_flags = (uint8_t)
+         ((lrz->image_view ? TU_RP_LOG_LRZ_IMAGE : 0) |
+          (lrz->valid ? TU_RP_LOG_LRZ_VALID : 0) |
+          (lrz->fast_clear ? TU_RP_LOG_LRZ_FAST_CLEAR : 0) |
+          (lrz->gpu_dir_tracking ? TU_RP_LOG_LRZ_GPU_DIR : 0) |
+          (lrz->disable_write_for_rp ? TU_RP_LOG_LRZ_NO_WRITE : 0)),
+      .lrz_disable_reason = (uint8_t) lrz->disable_reason,
+      .render_width = (uint16_t) cmd->state.render_area.extent.width,
+      .render_height = (uint16_t) cmd->state.render_area.extent.height,
+      .bins_x = (uint16_t) vsc->tile_count.width,
+      .bins_y = (uint16_t) vsc->tile_count.height,
+      .pipes_x = (uint16_t) vsc->pipe_count.width,
+      .pipes_y = (uint16_t) vsc->pipe_count.height,
+      .drawcall_count = cmd->state.rp.drawcall_count,
+      .avg_samples = autotune_result ? autotune_result->avg_samples : 0,
+   };
+
+   tu_rp_log_write(cmd->device, &rec.hdr);
+}
+
 /* Optimization: there is no reason to load gmem if there is no
  * geometry to process. COND_REG_EXEC predicate is set here,
  * but the actual skip happens in tu_load_gmem_attachment() and tile_store_cs,
@@ -2210,9 +2291,11 @@ tu_trace_end_render_pass(struct tu_cmd_buffer *cmd, bool gmem)
    struct u_trace_address addr = {};
    if (cmd->state.lrz.image_view) {
       struct tu_image *image = cmd->state.lrz.image_view->image;
-      addr.bo = image->bo;
-      addr.offset = (image->iova - image->bo->iova) +
-                    image->lrz_layout.lrz_fc_offset +
+      struct tu_bo *lrz_bo = image->lrz_bo ? image->lrz_bo : image->bo;
+      addr.bo = lrz_bo;
+      addr.offset = (image->lrz_iova - lrz_bo->iova) +
+                    image->lrz_layout.lrz_fc_offset -
+                    image->lrz_layout.lrz_offset +
                     offsetof(fd_lrzfc_layout<CHIP>, dir_track);
    }
 
@@ -2304,6 +2387,8 @@ tu6_sysmem_render_begin(struct tu_cmd_buffer *cmd, struct tu_cs *cs,
    tu_cs_emit(cs, 0x0);
 
    tu_emit_cache_flush_ccu<CHIP>(cmd, cs, TU_CMD_CCU_SYSMEM);
+   /* shaders in the pass may write storage through UCHE */
+   cmd->state.dirty_caches |= TU_CMD_FLAG_CACHE_CLEAN;
 
    tu_cs_emit_pkt7(cs, CP_SET_VISIBILITY_OVERRIDE, 1);
    tu_cs_emit(cs, 0x1);
@@ -2357,6 +2442,7 @@ tu6_tile_render_begin(struct tu_cmd_buffer *cmd, struct tu_cs *cs,
    }
 
    tu_emit_cache_flush_ccu<CHIP>(cmd, cs, TU_CMD_CCU_GMEM);
+   cmd->state.dirty_caches |= TU_CMD_FLAG_CACHE_CLEAN;
 
    if (use_hw_binning(cmd)) {
       if (!cmd->vsc_initialized) {
@@ -2469,6 +2555,16 @@ tu6_render_tile(struct tu_cmd_buffer *cmd, struct tu_cs *cs,
    tu_cs_emit_pkt7(cs, CP_SKIP_IB2_ENABLE_GLOBAL, 1);
    tu_cs_emit(cs, 0x0);
 
+   /* Folded resolves go before the stores, which may clear GMEM with
+    * BLIT_EVENT_STORE_AND_CLEAR.
+    */
+   for (uint32_t i = 0; i < cmd->resolve_fold.attachment_count; i++) {
+      util_dynarray_append(&cmd->resolve_fold.slots, uint32_t *, cs->cur);
+      tu_cs_emit_pkt7(cs, CP_NOP, TU_RESOLVE_FOLD_SLOT_DWORDS - 1);
+      for (uint32_t j = 1; j < TU_RESOLVE_FOLD_SLOT_DWORDS; j++)
+         tu_cs_emit(cs, 0);
+   }
+
    tu_cs_emit_call(cs, &cmd->tile_store_cs);
 
    tu_clone_trace_range(cmd, cs, cmd->trace_renderpass_start,
@@ -2796,6 +2892,60 @@ tu_render_pipe_fdm(struct tu_cmd_buffer *cmd, uint32_t pipe,
    }
 }
 
+/* Picks the MSAA color attachments whose vkCmdResolveImage right after the
+ * render pass could be done from GMEM, see struct tu_resolve_fold.
+ */
+static void
+tu_resolve_fold_begin(struct tu_cmd_buffer *cmd)
+{
+   struct tu_resolve_fold *fold = &cmd->resolve_fold;
+   const struct tu_render_pass *pass = cmd->state.pass;
+   const struct tu_subpass *subpass = &pass->subpasses[pass->subpass_count - 1];
+
+   if (cmd->vk.level != VK_COMMAND_BUFFER_LEVEL_PRIMARY ||
+       cmd->state.suspend_resume != SR_NONE || pass->has_fdm ||
+       cmd->state.framebuffer->layers > 1 || subpass->multiview_mask)
+      return;
+
+   for (uint32_t a = 0; a < pass->attachment_count; a++) {
+      const struct tu_render_pass_attachment *att = &pass->attachments[a];
+      const struct tu_image_view *iview = cmd->state.attachments[a];
+
+      /* Conditionally stored attachments aren't loaded into GMEM in bins
+       * without geometry either.
+       */
+      if (!iview || !att->gmem || !att->store ||
+          att->samples == VK_SAMPLE_COUNT_1_BIT ||
+          vk_format_is_depth_or_stencil(att->format) ||
+          (att->cond_store_allowed && pass->has_cond_load_store))
+         continue;
+
+      if (fold->attachment_count == ARRAY_SIZE(fold->attachments))
+         break;
+
+      fold->attachments[fold->attachment_count++] = {
+         .image = iview->image,
+         .level = iview->vk.base_mip_level,
+         .layer = iview->vk.base_array_layer,
+         .format = att->format,
+         .samples = att->samples,
+         .gmem_offset = tu_attachment_gmem_offset(cmd, att, 0),
+         .is_mutable = iview->view.is_mutable,
+         .folded = false,
+      };
+   }
+
+   fold->render_area = cmd->state.render_area;
+}
+
+/* Called once nothing else is emitted for the render pass. */
+static void
+tu_resolve_fold_end(struct tu_cmd_buffer *cmd)
+{
+   cmd->resolve_fold.cs_cur = cmd->cs.cur;
+   cmd->resolve_fold.cs_entry_count = cmd->cs.entry_count;
+}
+
 template <chip CHIP>
 static void
 tu_cmd_render_tiles(struct tu_cmd_buffer *cmd,
@@ -2827,10 +2977,29 @@ tu_cmd_render_tiles(struct tu_cmd_buffer *cmd,
    tu6_emit_tile_store<CHIP>(cmd, &cmd->tile_store_cs);
    tu_cs_end(&cmd->tile_store_cs);
 
+   tu_resolve_fold_begin(cmd);
+
    cmd->trace_renderpass_end = u_trace_end_iterator(&cmd->trace);
 
    tu6_tile_render_begin<CHIP>(cmd, &cmd->cs, autotune_result, fdm_offsets);
 
+   /* Bins entirely outside of the render area have nothing to load, draw or
+    * store, so only walk the ones it touches. use_sysmem_rendering() already
+    * rejected empty render areas. FDM offsets shift the bins relative to the
+    * framebuffer, so walk all of them in that case.
+    */
+   uint32_t rx1 = 0, ry1 = 0;
+   uint32_t rx2 = vsc->tile_count.width, ry2 = vsc->tile_count.height;
+   if (!fdm_offsets) {
+      const VkRect2D *render_area = &cmd->state.render_area;
+      rx1 = render_area->offset.x / tiling->tile0.width;
+      ry1 = render_area->offset.y / tiling->tile0.height;
+      rx2 = MIN2((render_area->offset.x + render_area->extent.width - 1) /
+                 tiling->tile0.width + 1, rx2);
+      ry2 = MIN2((render_area->offset.y + render_area->extent.height - 1) /
+                 tiling->tile0.height + 1, ry2);
+   }
+
    /* Note: we reverse the order of walking the pipes and tiles on every
     * other row, to improve texture cache locality compared to raster order.
     */
@@ -2848,6 +3017,9 @@ tu_cmd_render_tiles(struct tu_cmd_buffer *cmd,
          uint32_t tx2 = MIN2(tx1 + vsc->pipe0.width, vsc->tile_count.width);
          uint32_t ty2 = MIN2(ty1 + vsc->pipe0.height, vsc->tile_count.height);
 
+         if (tx2 <= rx1 || tx1 >= rx2 || ty2 <= ry1 || ty1 >= ry2)
+            continue;
+
          if (merge_tiles) {
             tu_render_pipe_fdm<CHIP>(cmd, pipe, tx1, ty1, tx2, ty2, fdm,
                                      fdm_offsets);
@@ -2857,6 +3029,10 @@ tu_cmd_render_tiles(struct tu_cmd_buffer *cmd,
          uint32_t tile_row_stride = tx2 - tx1;
          uint32_t slot_row = 0;
          for (uint32_t ty = ty1; ty < ty2; ty++) {
+            if (ty < ry1 || ty >= ry2) {
+               slot_row += tile_row_stride;
+               continue;
+            }
             for (uint32_t tile_row_i = 0; tile_row_i < tile_row_stride; tile_row_i++) {
                uint32_t tx;
                if (ty & 1)
@@ -2864,6 +3040,9 @@ tu_cmd_render_tiles(struct tu_cmd_buffer *cmd,
                else
                   tx = tile_row_i;
 
+               if (tx1 + tx < rx1 || tx1 + tx >= rx2)
+                  continue;
+
                struct tu_tile_config tile = {
                   .pos = { tx1 + tx, ty },
                   .pipe = pipe,
@@ -2923,6 +3102,30 @@ tu_cmd_render_sysmem(struct tu_cmd_buffer *cmd,
    tu_trace_end_render_pass<CHIP>(cmd, false);
 }
 
+/* Lazily allocated attachments are only backed once something touches
+ * them outside of GMEM: sysmem rendering, or a GMEM load, store or resolve.
+ */
+static void
+tu_commit_lazy_attachments(struct tu_cmd_buffer *cmd, bool sysmem)
+{
+   const struct tu_render_pass *pass = cmd->state.pass;
+
+   for (uint32_t i = 0; i < pass->attachment_count; i++) {
+      const struct tu_image_view *iview = cmd->state.attachments[i];
+      if (!iview || !iview->image->bo || !iview->image->bo->lazy)
+         continue;
+
+      const struct tu_render_pass_attachment *att = &pass->attachments[i];
+      if (!sysmem && att->gmem && !att->load && !att->store &&
+          !att->load_stencil && !att->store_stencil)
+         continue;
+
+      VkResult result = tu_bo_commit(cmd->device, iview->image->bo);
+      if (result != VK_SUCCESS)
+         vk_command_buffer_set_error(&cmd->vk, result);
+   }
+}
+
 template <chip CHIP>
 void
 tu_cmd_render(struct tu_cmd_buffer *cmd_buffer,
@@ -2932,7 +3135,19 @@ tu_cmd_render(struct tu_cmd_buffer *cmd_buffer,
       tu6_lazy_emit_tessfactor_addr<CHIP>(cmd_buffer);
 
    struct tu_renderpass_result *autotune_result = NULL;
-   if (use_sysmem_rendering(cmd_buffer, &autotune_result))
+   enum tu_rp_log_reason reason;
+   bool sysmem = use_sysmem_rendering(cmd_buffer, &autotune_result, &reason);
+
+   cmd_buffer->resolve_fold.attachment_count = 0;
+   util_dynarray_clear(&cmd_buffer->resolve_fold.slots);
+
+   if (unlikely(cmd_buffer->device->rp_log))
+      tu_rp_log_render_pass(cmd_buffer, sysmem, reason, autotune_result);
+
+   if (cmd_buffer->device->physical_device->has_lazy_memory)
+      tu_commit_lazy_attachments(cmd_buffer, sysmem);
+
+   if (sysmem)
       tu_cmd_render_sysmem<CHIP>(cmd_buffer, autotune_result);
    else
       tu_cmd_render_tiles<CHIP>(cmd_buffer, autotune_result, fdm_offsets);
@@ -2996,6 +3211,7 @@ tu_create_cmd_buffer(struct vk_command_pool *pool,
    }
 
    cmd_buffer->device = device;
+   cmd_buffer->queue_family_index = pool->queue_family_index;
 
    u_trace_init(&cmd_buffer->trace, &device->trace_context);
    list_inithead(&cmd_buffer->renderpass_autotune_results);
@@ -3046,6 +3262,7 @@ tu_cmd_buffer_destroy(struct vk_command_buffer *vk_cmd_buffer)
    ralloc_free(cmd_buffer->pre_chain.patchpoints_ctx);
    util_dynarray_fini(&cmd_buffer->fdm_bin_patchpoints);
    util_dynarray_fini(&cmd_buffer->pre_chain.fdm_bin_patchpoints);
+   util_dynarray_fini(&cmd_buffer->resolve_fold.slots);
 
    vk_command_buffer_finish(&cmd_buffer->vk);
    vk_free2(&cmd_buffer->device->vk.alloc, &cmd_buffer->vk.pool->alloc,
@@ -3098,6 +3315,8 @@ tu_reset_cmd_buffer(struct vk_command_buffer *vk_cmd_buffer,
    cmd_buffer->pre_chain.patchpoints_ctx = NULL;
    util_dynarray_clear(&cmd_buffer->fdm_bin_patchpoints);
    util_dynarray_clear(&cmd_buffer->pre_chain.fdm_bin_patchpoints);
+   cmd_buffer->resolve_fold.attachment_count = 0;
+   util_dynarray_clear(&cmd_buffer->resolve_fold.slots);
 }
 
 const struct vk_command_buffer_ops tu_cmd_buffer_ops = {
@@ -3135,6 +3354,8 @@ tu_cmd_buffer_begin(struct tu_cmd_buffer *cmd_buffer,
 
    tu_cache_init(&cmd_buffer->state.cache);
    tu_cache_init(&cmd_buffer->state.renderpass_cache);
+   /* earlier command buffers may have left anything in the caches */
+   cmd_buffer->state.dirty_caches = TU_CMD_FLAG_ALL_CACHE_CLEAN;
    cmd_buffer->usage_flags = pBeginInfo->flags;
 
    tu_cs_begin(&cmd_buffer->cs);
@@ -3163,6 +3384,10 @@ tu_BeginCommandBuffer(VkCommandBuffer commandBuffer,
 
       switch (cmd_buffer->queue_family_index) {
       case TU_QUEUE_GENERAL:
+      case TU_QUEUE_COMPUTE:
+         /* Every queue has its own context, and transfers on the compute
+          * queue still go through the 2D and 3D blit paths.
+          */
          TU_CALLX(cmd_buffer->device, tu6_init_hw)(cmd_buffer, &cmd_buffer->cs);
          break;
       default:
@@ -3753,40 +3978,74 @@ tu_push_descriptor_set_update_layout(struct tu_device *device,
       vk_descriptor_set_layout_unref(&device->vk, &set->layout->vk);
    vk_descriptor_set_layout_ref(&layout->vk);
    set->layout = layout;
+   /* the last pushed contents were laid out for the old layout */
+   set->va = 0;
 
    if (set->host_size < layout->size) {
+      uint32_t host_size = align(layout->size, 8);
       void *new_buf =
-         vk_realloc(&device->vk.alloc, set->mapped_ptr, layout->size, 8,
+         vk_realloc(&device->vk.alloc, set->mapped_ptr, 2 * host_size, 8,
                     VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
       if (!new_buf)
          return VK_ERROR_OUT_OF_HOST_MEMORY;
       set->mapped_ptr = (uint32_t *) new_buf;
-      set->host_size = layout->size;
+      set->pushed_ptr = (uint32_t *) ((char *) new_buf + host_size);
+      set->host_size = host_size;
    }
    return VK_SUCCESS;
 }
 
+/* Uploads the push set after its host copy has been updated and binds it.
+ * Layers like zink push the same descriptors over and over, so a push that
+ * leaves the set as it was last uploaded, while that upload is still bound,
+ * keeps the old GPU copy and skips the rebind and its descriptor re-emit.
+ */
 static void
-tu_push_descriptor_set(struct tu_cmd_buffer *cmd,
-                       const VkPushDescriptorSetInfoKHR *info,
-                       VkPipelineBindPoint bind_point)
+tu_push_descriptor_set_upload(struct tu_cmd_buffer *cmd,
+                              struct tu_descriptor_set *set,
+                              VkPipelineBindPoint bind_point,
+                              VkPipelineLayout _layout,
+                              uint32_t _set)
 {
-   VK_FROM_HANDLE(tu_pipeline_layout, pipe_layout, info->layout);
-   struct tu_descriptor_set_layout *layout =
-      pipe_layout->set[info->set].layout;
-   struct tu_descriptor_set *set =
-      &tu_get_descriptors_state(cmd, bind_point)->push_set;
+   struct tu_descriptor_state *descriptors_state =
+      tu_get_descriptors_state(cmd, bind_point);
+   uint32_t size = set->layout->size;
+
+   if (set->va && descriptors_state->sets[_set] == set &&
+       descriptors_state->set_iova[_set] == (set->va | BINDLESS_DESCRIPTOR_64B) &&
+       !memcmp(set->mapped_ptr, set->pushed_ptr, size))
+      return;
 
    struct tu_cs_memory set_mem;
    VkResult result = tu_cs_alloc(&cmd->sub_cs,
-                                 DIV_ROUND_UP(layout->size, A6XX_TEX_CONST_DWORDS * 4),
+                                 DIV_ROUND_UP(size, A6XX_TEX_CONST_DWORDS * 4),
                                  A6XX_TEX_CONST_DWORDS, &set_mem);
    if (result != VK_SUCCESS) {
       vk_command_buffer_set_error(&cmd->vk, result);
       return;
    }
 
-   result = tu_push_descriptor_set_update_layout(cmd->device, set, layout);
+   memcpy(set_mem.map, set->mapped_ptr, size);
+   memcpy(set->pushed_ptr, set->mapped_ptr, size);
+   set->va = set_mem.iova;
+
+   const VkDescriptorSet desc_set[] = { tu_descriptor_set_to_handle(set) };
+   vk_common_CmdBindDescriptorSets(tu_cmd_buffer_to_handle(cmd), bind_point,
+                                   _layout, _set, 1, desc_set, 0, NULL);
+}
+
+static void
+tu_push_descriptor_set(struct tu_cmd_buffer *cmd,
+                       const VkPushDescriptorSetInfoKHR *info,
+                       VkPipelineBindPoint bind_point)
+{
+   VK_FROM_HANDLE(tu_pipeline_layout, pipe_layout, info->layout);
+   struct tu_descriptor_set_layout *layout =
+      pipe_layout->set[info->set].layout;
+   struct tu_descriptor_set *set =
+      &tu_get_descriptors_state(cmd, bind_point)->push_set;
+
+   VkResult result = tu_push_descriptor_set_update_layout(cmd->device, set, layout);
    if (result != VK_SUCCESS) {
       vk_command_buffer_set_error(&cmd->vk, result);
       return;
@@ -3796,13 +4055,7 @@ tu_push_descriptor_set(struct tu_cmd_buffer *cmd,
                              info->descriptorWriteCount,
                              info->pDescriptorWrites, 0, NULL);
 
-   memcpy(set_mem.map, set->mapped_ptr, layout->size);
-   set->va = set_mem.iova;
-
-   const VkDescriptorSet desc_set[] = { tu_descriptor_set_to_handle(set) };
-   vk_common_CmdBindDescriptorSets(tu_cmd_buffer_to_handle(cmd), bind_point,
-                                   info->layout, info->set, 1, desc_set, 0,
-                                   NULL);
+   tu_push_descriptor_set_upload(cmd, set, bind_point, info->layout, info->set);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -3840,16 +4093,7 @@ tu_CmdPushDescriptorSetWithTemplate2KHR(
    struct tu_descriptor_set *set =
       &tu_get_descriptors_state(cmd, templ->bind_point)->push_set;
 
-   struct tu_cs_memory set_mem;
-   VkResult result = tu_cs_alloc(&cmd->sub_cs,
-                                 DIV_ROUND_UP(layout->size, A6XX_TEX_CONST_DWORDS * 4),
-                                 A6XX_TEX_CONST_DWORDS, &set_mem);
-   if (result != VK_SUCCESS) {
-      vk_command_buffer_set_error(&cmd->vk, result);
-      return;
-   }
-
-   result = tu_push_descriptor_set_update_layout(cmd->device, set, layout);
+   VkResult result = tu_push_descriptor_set_update_layout(cmd->device, set, layout);
    if (result != VK_SUCCESS) {
       vk_command_buffer_set_error(&cmd->vk, result);
       return;
@@ -3860,14 +4104,9 @@ tu_CmdPushDescriptorSetWithTemplate2KHR(
       pPushDescriptorSetWithTemplateInfo->descriptorUpdateTemplate,
       pPushDescriptorSetWithTemplateInfo->pData);
 
-   memcpy(set_mem.map, set->mapped_ptr, layout->size);
-   set->va = set_mem.iova;
-
-   const VkDescriptorSet desc_set[] = { tu_descriptor_set_to_handle(set) };
-   vk_common_CmdBindDescriptorSets(
-      tu_cmd_buffer_to_handle(cmd), templ->bind_point,
-      pPushDescriptorSetWithTemplateInfo->layout,
-      pPushDescriptorSetWithTemplateInfo->set, 1, desc_set, 0, NULL);
+   tu_push_descriptor_set_upload(cmd, set, templ->bind_point,
+                                 pPushDescriptorSetWithTemplateInfo->layout,
+                                 pPushDescriptorSetWithTemplateInfo->set);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -4179,6 +4418,73 @@ tu_pipeline_update_rp_state(struct tu_cmd_state *cmd_state)
    }
 }
 
+static void
+tu_emit_program_draw_states(struct tu_cs *cs,
+                            const struct tu_program_state *program,
+                            struct tu_draw_state prim_order_gmem,
+                            uint32_t extra_states)
+{
+   tu_cs_emit_pkt7(cs, CP_SET_DRAW_STATE, 3 * (10 + extra_states));
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_PROGRAM_CONFIG, program->config_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VS, program->vs_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VS_BINNING, program->vs_binning_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_HS, program->hs_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_DS, program->ds_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_GS, program->gs_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_GS_BINNING, program->gs_binning_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_FS, program->fs_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VPC, program->vpc_state);
+   tu_cs_emit_draw_state(cs, TU_DRAW_STATE_PRIM_MODE_GMEM, prim_order_gmem);
+}
+
+/* State derived from the newly bound cmd->state.program. */
+static void
+tu_update_program_state(struct tu_cmd_buffer *cmd)
+{
+   const struct tu_program_state *program = &cmd->state.program;
+
+   if (program->per_view_viewport != cmd->state.per_view_viewport) {
+      cmd->state.per_view_viewport = program->per_view_viewport;
+      cmd->state.dirty |= TU_CMD_DIRTY_PER_VIEW_VIEWPORT;
+   }
+
+   if (program->writes_shading_rate !=
+          cmd->state.pipeline_writes_shading_rate ||
+       program->reads_shading_rate !=
+          cmd->state.pipeline_reads_shading_rate ||
+       program->accesses_smask !=
+          cmd->state.pipeline_accesses_smask) {
+      cmd->state.pipeline_writes_shading_rate = program->writes_shading_rate;
+      cmd->state.pipeline_reads_shading_rate = program->reads_shading_rate;
+      cmd->state.pipeline_accesses_smask = program->accesses_smask;
+      cmd->state.dirty |= TU_CMD_DIRTY_SHADING_RATE;
+   }
+}
+
+static void
+tu_update_feedback_loops(struct tu_cmd_buffer *cmd,
+                         VkImageAspectFlags feedback_loops)
+{
+   if (feedback_loops != cmd->state.pipeline_feedback_loops) {
+      cmd->state.pipeline_feedback_loops = feedback_loops;
+      cmd->state.dirty |= TU_CMD_DIRTY_FEEDBACK_LOOPS | TU_CMD_DIRTY_LRZ;
+   }
+}
+
+static void
+tu_update_raster_order(struct tu_cmd_buffer *cmd,
+                       bool raster_order_attachment_access)
+{
+   if (!cmd->state.raster_order_attachment_access_valid ||
+       raster_order_attachment_access !=
+       cmd->state.raster_order_attachment_access) {
+      cmd->state.raster_order_attachment_access =
+         raster_order_attachment_access;
+      cmd->state.dirty |= TU_CMD_DIRTY_RAST_ORDER;
+      cmd->state.raster_order_attachment_access_valid = true;
+   }
+}
+
 VKAPI_ATTR void VKAPI_CALL
 tu_CmdBindPipeline(VkCommandBuffer commandBuffer,
                    VkPipelineBindPoint pipelineBindPoint,
@@ -4199,6 +4505,7 @@ tu_CmdBindPipeline(VkCommandBuffer commandBuffer,
    assert(pipelineBindPoint == VK_PIPELINE_BIND_POINT_GRAPHICS);
 
    struct tu_graphics_pipeline *gfx_pipeline = tu_pipeline_to_graphics(pipeline);
+   cmd->state.gfx_shader_objects = false;
    cmd->state.dirty |= TU_CMD_DIRTY_DESC_SETS | TU_CMD_DIRTY_SHADER_CONSTS |
                        TU_CMD_DIRTY_VS_PARAMS | TU_CMD_DIRTY_PROGRAM;
 
@@ -4259,17 +4566,9 @@ tu_CmdBindPipeline(VkCommandBuffer commandBuffer,
    if (!(cmd->state.dirty & TU_CMD_DIRTY_DRAW_STATE)) {
       uint32_t mask = pipeline->set_state_mask;
 
-      tu_cs_emit_pkt7(cs, CP_SET_DRAW_STATE, 3 * (10 + util_bitcount(mask)));
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_PROGRAM_CONFIG, pipeline->program.config_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VS, pipeline->program.vs_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VS_BINNING, pipeline->program.vs_binning_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_HS, pipeline->program.hs_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_DS, pipeline->program.ds_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_GS, pipeline->program.gs_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_GS_BINNING, pipeline->program.gs_binning_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_FS, pipeline->program.fs_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_VPC, pipeline->program.vpc_state);
-      tu_cs_emit_draw_state(cs, TU_DRAW_STATE_PRIM_MODE_GMEM, pipeline->prim_order.state_gmem);
+      tu_emit_program_draw_states(cs, &pipeline->program,
+                                  pipeline->prim_order.state_gmem,
+                                  util_bitcount(mask));
 
       u_foreach_bit(i, mask)
          tu_cs_emit_draw_state(cs, TU_DRAW_STATE_DYNAMIC + i, pipeline->dynamic_state[i]);
@@ -4279,41 +4578,65 @@ tu_CmdBindPipeline(VkCommandBuffer commandBuffer,
    u_foreach_bit(i, pipeline->set_state_mask)
       cmd->state.dynamic_state[i] = pipeline->dynamic_state[i];
 
-   if (pipeline->program.per_view_viewport != cmd->state.per_view_viewport) {
-      cmd->state.per_view_viewport = pipeline->program.per_view_viewport;
-      cmd->state.dirty |= TU_CMD_DIRTY_PER_VIEW_VIEWPORT;
-   }
+   tu_update_program_state(cmd);
+   tu_update_feedback_loops(cmd, gfx_pipeline->feedback_loops);
+   tu_update_raster_order(cmd,
+                          pipeline->output.raster_order_attachment_access ||
+                          pipeline->ds.raster_order_attachment_access);
+}
 
-   if (gfx_pipeline->feedback_loops != cmd->state.pipeline_feedback_loops) {
-      cmd->state.pipeline_feedback_loops = gfx_pipeline->feedback_loops;
-      cmd->state.dirty |= TU_CMD_DIRTY_FEEDBACK_LOOPS | TU_CMD_DIRTY_LRZ;
-   }
+VKAPI_ATTR void VKAPI_CALL
+tu_CmdBindShadersEXT(VkCommandBuffer commandBuffer,
+                     uint32_t stageCount,
+                     const VkShaderStageFlagBits *pStages,
+                     const VkShaderEXT *pShaders)
+{
+   VK_FROM_HANDLE(tu_cmd_buffer, cmd, commandBuffer);
 
-   if (pipeline->program.writes_shading_rate !=
-          cmd->state.pipeline_writes_shading_rate ||
-       pipeline->program.reads_shading_rate !=
-          cmd->state.pipeline_reads_shading_rate ||
-       pipeline->program.accesses_smask !=
-          cmd->state.pipeline_accesses_smask) {
-      cmd->state.pipeline_writes_shading_rate =
-         pipeline->program.writes_shading_rate;
-      cmd->state.pipeline_reads_shading_rate =
-         pipeline->program.reads_shading_rate;
-      cmd->state.pipeline_accesses_smask =
-         pipeline->program.accesses_smask;
-      cmd->state.dirty |= TU_CMD_DIRTY_SHADING_RATE;
-   }
+   for (uint32_t i = 0; i < stageCount; i++) {
+      gl_shader_stage stage = vk_to_mesa_shader_stage(pStages[i]);
+      VK_FROM_HANDLE(tu_shader_object, obj,
+                     pShaders ? pShaders[i] : VK_NULL_HANDLE);
 
-   bool raster_order_attachment_access =
-      pipeline->output.raster_order_attachment_access ||
-      pipeline->ds.raster_order_attachment_access;
-   if (!cmd->state.raster_order_attachment_access_valid ||
-       raster_order_attachment_access !=
-       cmd->state.raster_order_attachment_access) {
-      cmd->state.raster_order_attachment_access =
-         raster_order_attachment_access;
-      cmd->state.dirty |= TU_CMD_DIRTY_RAST_ORDER;
-      cmd->state.raster_order_attachment_access_valid = true;
+      if (stage == MESA_SHADER_COMPUTE) {
+         if (!obj)
+            continue;
+
+         const struct tu_shader_object_key key = {};
+         struct tu_shader *shader =
+            tu_shader_object_get_variant(cmd->device, obj, &key);
+         if (!shader) {
+            vk_command_buffer_set_error(&cmd->vk, VK_ERROR_OUT_OF_HOST_MEMORY);
+            return;
+         }
+
+         cmd->state.shaders[MESA_SHADER_COMPUTE] = shader;
+         tu_cs_emit_state_ib(&cmd->cs, shader->state);
+         cmd->state.compute_load_state = (struct tu_draw_state) {};
+         continue;
+      }
+
+      if (stage > MESA_SHADER_FRAGMENT)
+         continue;
+
+      if (!cmd->state.gfx_shader_objects) {
+         /* Nothing of the previously bound pipeline is kept, the state it
+          * baked in has to come from the dynamic state from now on.
+          */
+         memset(cmd->state.shader_objects, 0,
+                sizeof(cmd->state.shader_objects));
+         cmd->state.gfx_shader_objects = true;
+         cmd->state.pipeline_draw_states = 0;
+         cmd->state.pipeline_blend_lrz = false;
+         cmd->state.pipeline_bandwidth = false;
+         cmd->state.pipeline_disable_fs = false;
+         BITSET_ONES(cmd->vk.dynamic_graphics_state.dirty);
+         tu_update_feedback_loops(cmd, 0);
+         tu_update_raster_order(cmd, false);
+      }
+
+      cmd->state.shader_objects[stage] = obj;
+      cmd->state.dirty |= TU_CMD_DIRTY_SHADER_OBJECTS;
    }
 }
 
@@ -4493,13 +4816,28 @@ vk2tu_access(VkAccessFlags2 flags, VkAccessFlags3KHR flags2,
                        VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT |
                        VK_ACCESS_2_CONDITIONAL_RENDERING_READ_BIT_EXT |
                        VK_ACCESS_2_TRANSFORM_FEEDBACK_COUNTER_READ_BIT_EXT |
+                       VK_ACCESS_2_COMMAND_PREPROCESS_READ_BIT_EXT |
                        VK_ACCESS_2_HOST_READ_BIT,
                        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
                        VK_PIPELINE_STAGE_2_CONDITIONAL_RENDERING_BIT_EXT |
                        VK_PIPELINE_STAGE_2_TRANSFORM_FEEDBACK_BIT_EXT |
+                       VK_PIPELINE_STAGE_2_COMMAND_PREPROCESS_BIT_EXT |
                        VK_PIPELINE_STAGE_2_HOST_BIT))
       mask |= TU_ACCESS_SYSMEM_READ;
 
+   /* The generated commands are written by a compute shader and the
+    * sequence inputs are read both by that shader and directly by the CP.
+    */
+   if (gfx_read_access(flags, stages,
+                       VK_ACCESS_2_COMMAND_PREPROCESS_READ_BIT_EXT,
+                       VK_PIPELINE_STAGE_2_COMMAND_PREPROCESS_BIT_EXT))
+      mask |= TU_ACCESS_UCHE_READ;
+
+   if (gfx_write_access(flags, stages,
+                        VK_ACCESS_2_COMMAND_PREPROCESS_WRITE_BIT_EXT,
+                        VK_PIPELINE_STAGE_2_COMMAND_PREPROCESS_BIT_EXT))
+      mask |= TU_ACCESS_UCHE_WRITE;
+
    if (gfx_write_access(flags, stages,
                         VK_ACCESS_2_TRANSFORM_FEEDBACK_COUNTER_READ_BIT_EXT,
                         VK_PIPELINE_STAGE_2_TRANSFORM_FEEDBACK_BIT_EXT))
@@ -4728,8 +5066,12 @@ vk2tu_single_stage(VkPipelineStageFlags2 vk_stage, bool dst)
        vk_stage == VK_PIPELINE_STAGE_2_FRAGMENT_DENSITY_PROCESS_BIT_EXT)
       return TU_STAGE_CP;
 
+   /* Generated commands are written by a compute shader but consumed by the
+    * CP as part of the command stream.
+    */
    if (vk_stage == VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT ||
-       vk_stage == VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT)
+       vk_stage == VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT ||
+       vk_stage == VK_PIPELINE_STAGE_2_COMMAND_PREPROCESS_BIT_EXT)
       return dst ? TU_STAGE_CP : TU_STAGE_GPU;
 
    if (vk_stage == VK_PIPELINE_STAGE_2_HOST_BIT)
@@ -4910,6 +5252,28 @@ tu_save_pre_chain(struct tu_cmd_buffer *cmd)
    cmd->patchpoints_ctx = NULL;
 }
 
+/* Secondaries at most this big are copied into the primary instead of being
+ * called as IBs, which for the draw_cs happens once per tile.
+ *
+ * FDM patchpoints point into the secondary's own command stream and
+ * generated commands aren't written until the GPU runs, so secondaries with
+ * either are always called.
+ */
+#define TU_SECONDARY_COPY_MAX_DWORDS 512
+
+static VkResult
+tu_cs_add_secondary(struct tu_cs *cs, struct tu_cs *secondary_cs,
+                    const struct tu_cmd_buffer *secondary)
+{
+   if (!secondary_cs->has_external_entries &&
+       !util_dynarray_num_elements(&secondary->fdm_bin_patchpoints,
+                                   struct tu_fdm_bin_patchpoint) &&
+       tu_cs_entries_size(secondary_cs) <= TU_SECONDARY_COPY_MAX_DWORDS)
+      return tu_cs_copy_entries(cs, secondary_cs);
+
+   return tu_cs_add_entries(cs, secondary_cs);
+}
+
 VKAPI_ATTR void VKAPI_CALL
 tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
                       uint32_t commandBufferCount,
@@ -4934,12 +5298,23 @@ tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
 
       if (secondary->usage_flags &
           VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT) {
-         assert(tu_cs_is_empty(&secondary->cs));
+         /* Only the preprocessing of generated commands is recorded outside
+          * of draw_cs, and like in the primary it runs ahead of the render
+          * pass.
+          */
+         if (secondary->cs.entry_count) {
+            result = tu_cs_add_entries(&cmd->cs, &secondary->cs);
+            if (result != VK_SUCCESS) {
+               vk_command_buffer_set_error(&cmd->vk, result);
+               break;
+            }
+         }
 
          TU_CALLX(cmd->device, tu_lrz_flush_valid_during_renderpass)
             (cmd, &cmd->draw_cs);
 
-         result = tu_cs_add_entries(&cmd->draw_cs, &secondary->draw_cs);
+         result = tu_cs_add_secondary(&cmd->draw_cs, &secondary->draw_cs,
+                                      secondary);
          if (result != VK_SUCCESS) {
             vk_command_buffer_set_error(&cmd->vk, result);
             break;
@@ -4967,7 +5342,7 @@ tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
          case SR_NONE:
             assert(tu_cs_is_empty(&secondary->draw_cs));
             assert(tu_cs_is_empty(&secondary->draw_epilogue_cs));
-            tu_cs_add_entries(&cmd->cs, &secondary->cs);
+            tu_cs_add_secondary(&cmd->cs, &secondary->cs, secondary);
             tu_clone_trace(cmd, &cmd->cs, &secondary->trace);
             break;
 
@@ -5047,7 +5422,7 @@ tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
                tu_reset_render_pass(cmd);
             }
 
-            tu_cs_add_entries(&cmd->cs, &secondary->cs);
+            tu_cs_add_secondary(&cmd->cs, &secondary->cs, secondary);
 
             if (secondary->state.suspend_resume == SR_IN_CHAIN_AFTER_PRE_CHAIN ||
                 secondary->state.suspend_resume == SR_IN_CHAIN) {
@@ -5075,8 +5450,30 @@ tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
       }
 
       cmd->state.index_size = secondary->state.index_size; /* for restart index update */
+
+      /* Secondaries outside of a render pass start with an unknown CCU
+       * state, and only know it once they change it.
+       */
+      if (!(secondary->usage_flags &
+            VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT) &&
+          secondary->state.ccu_state != TU_CMD_CCU_UNKNOWN)
+         cmd->state.ccu_state = secondary->state.ccu_state;
+
+      /* The secondary may have written through any cache, and the next one
+       * may start by finishing a suspended render pass.
+       */
+      cmd->state.dirty_caches = TU_CMD_FLAG_ALL_CACHE_CLEAN;
    }
-   cmd->state.dirty = ~0u; /* TODO: set dirty only what needs to be */
+
+   /* The secondaries left the draw state groups pointing at their own state,
+    * so re-enable all of ours, which also re-emits PC_PRIMITIVE_CNTL_0 and
+    * PC_TESS_CNTL. What the groups contain is still what the primary tracks,
+    * and anything bound before vkCmdExecuteCommands() is undefined after it,
+    * so re-binding marks whatever actually changes dirty. Only re-emit the
+    * state that isn't in a group.
+    */
+   cmd->state.dirty |= TU_CMD_DIRTY_DRAW_STATE | TU_CMD_DIRTY_VS_PARAMS |
+                       TU_CMD_DIRTY_LRZ | TU_CMD_DIRTY_COMPUTE_DESC_SETS;
 
    if (!cmd->state.lrz.gpu_dir_tracking && cmd->state.pass) {
       /* After a secondary command buffer is executed, LRZ is not valid
@@ -5085,6 +5482,9 @@ tu_CmdExecuteCommands(VkCommandBuffer commandBuffer,
       cmd->state.lrz.valid = false;
    }
 
+   /* Secondaries may have rendered to or copied into any depth image. */
+   memset(&cmd->state.last_lrz, 0, sizeof(cmd->state.last_lrz));
+
    /* After executing secondary command buffers, there may have been arbitrary
     * flushes executed, so when we encounter a pipeline barrier with a
     * srcMask, we have to assume that we need to invalidate. Therefore we need
@@ -5775,7 +6175,8 @@ tu6_emit_per_stage_push_consts(struct tu_cs *cs,
                                const struct tu_const_state *const_state,
                                const struct ir3_const_state *ir_const_state,
                                gl_shader_stage type,
-                               uint32_t *push_constants)
+                               uint32_t *push_constants,
+                               struct tu_dgc_patch_list *patches)
 {
    if (const_state->push_consts.type == IR3_PUSH_CONSTS_PER_STAGE) {
       unsigned num_units = const_state->push_consts.dwords;
@@ -5795,6 +6196,8 @@ tu6_emit_per_stage_push_consts(struct tu_cs *cs,
       tu_cs_emit(cs, 0);
 
       unsigned lo = const_state->push_consts.lo_dwords;
+      if (patches)
+         tu_dgc_patch_push_consts(patches, cs->cur, lo, num_units);
       for (unsigned i = 0; i < num_units; i++)
          tu_cs_emit(cs, push_constants[i + lo]);
    }
@@ -5844,7 +6247,8 @@ tu7_emit_inline_ubo(struct tu_cs *cs,
                     const struct ir3_const_state *ir_const_state,
                     unsigned constlen,
                     gl_shader_stage type,
-                    struct tu_descriptor_state *descriptors)
+                    struct tu_descriptor_state *descriptors,
+                    struct tu_dgc_patch_list *patches)
 {
    uint64_t addresses[7] = {0};
    unsigned offset = const_state->inline_uniforms_ubo.idx;
@@ -5871,6 +6275,8 @@ tu7_emit_inline_ubo(struct tu_cs *cs,
    tu_cs_emit(cs, CP_LOAD_STATE6_1_EXT_SRC_ADDR(0));
    tu_cs_emit(cs, CP_LOAD_STATE6_2_EXT_SRC_ADDR_HI(0));
    int size_vec4s = DIV_ROUND_UP(const_state->num_inline_ubos * 2, 4);
+   if (patches)
+      tu_dgc_patch_block_addr(patches, cs->cur);
    tu_cs_emit_qw(cs, iova | ((uint64_t)A6XX_UBO_1_SIZE(size_vec4s) << 32));
 }
 
@@ -5880,13 +6286,15 @@ tu_emit_inline_ubo(struct tu_cs *cs,
                    const struct ir3_const_state *ir_const_state,
                    unsigned constlen,
                    gl_shader_stage type,
-                   struct tu_descriptor_state *descriptors)
+                   struct tu_descriptor_state *descriptors,
+                   struct tu_dgc_patch_list *patches)
 {
    if (!const_state->num_inline_ubos)
       return;
 
    if (cs->device->physical_device->info->a7xx.load_inline_uniforms_via_preamble_ldgk) {
-      tu7_emit_inline_ubo(cs, const_state, ir_const_state, constlen, type, descriptors);
+      tu7_emit_inline_ubo(cs, const_state, ir_const_state, constlen, type,
+                          descriptors, patches);
    } else {
       tu6_emit_inline_ubo(cs, const_state, constlen, type, descriptors);
    }
@@ -5896,7 +6304,8 @@ static void
 tu6_emit_shared_consts(struct tu_cs *cs,
                        const struct tu_push_constant_range *shared_consts,
                        uint32_t *push_constants,
-                       bool compute)
+                       bool compute,
+                       struct tu_dgc_patch_list *patches)
 {
    if (shared_consts->dwords > 0) {
       /* Offset and num_units for shared consts are in units of dwords. */
@@ -5915,6 +6324,8 @@ tu6_emit_shared_consts(struct tu_cs *cs,
       tu_cs_emit(cs, 0);
       tu_cs_emit(cs, 0);
 
+      if (patches)
+         tu_dgc_patch_push_consts(patches, cs->cur, offset, num_units);
       for (unsigned i = 0; i < num_units; i++)
          tu_cs_emit(cs, push_constants[i + offset]);
    }
@@ -5924,16 +6335,22 @@ static void
 tu7_emit_shared_preamble_consts(
    struct tu_cs *cs,
    const struct tu_push_constant_range *shared_consts,
-   uint32_t *push_constants)
+   uint32_t *push_constants,
+   struct tu_dgc_patch_list *patches)
 {
    tu_cs_emit_pkt4(cs, REG_A7XX_HLSQ_SHARED_CONSTS_IMM(shared_consts->lo_dwords),
                    shared_consts->dwords);
+   if (patches) {
+      tu_dgc_patch_push_consts(patches, cs->cur, shared_consts->lo_dwords,
+                               shared_consts->dwords);
+   }
    tu_cs_emit_array(cs, push_constants + shared_consts->lo_dwords,
                     shared_consts->dwords);
 }
 
 static uint32_t
-tu6_const_size(struct tu_cmd_buffer *cmd,
+tu6_const_size(struct tu_device *dev,
+               struct tu_shader *const *shaders,
                const struct tu_push_constant_range *shared_consts,
                bool compute)
 {
@@ -5945,66 +6362,92 @@ tu6_const_size(struct tu_cmd_buffer *cmd,
       dwords += shared_consts->dwords + 1;
    }
 
-   bool ldgk = cmd->device->physical_device->info->a7xx.load_inline_uniforms_via_preamble_ldgk;
+   bool ldgk = dev->physical_device->info->a7xx.load_inline_uniforms_via_preamble_ldgk;
    if (compute) {
       dwords +=
-         tu6_user_consts_size(&cmd->state.shaders[MESA_SHADER_COMPUTE]->const_state, ldgk, MESA_SHADER_COMPUTE);
+         tu6_user_consts_size(&shaders[MESA_SHADER_COMPUTE]->const_state, ldgk, MESA_SHADER_COMPUTE);
    } else {
-      for (uint32_t type = MESA_SHADER_VERTEX; type <= MESA_SHADER_FRAGMENT; type++)
-         dwords += tu6_user_consts_size(&cmd->state.shaders[type]->const_state, ldgk, (gl_shader_stage) type);
+      /* Pipelines leave the shaders of unused stages NULL. */
+      for (uint32_t type = MESA_SHADER_VERTEX; type <= MESA_SHADER_FRAGMENT; type++) {
+         if (shaders[type])
+            dwords += tu6_user_consts_size(&shaders[type]->const_state, ldgk, (gl_shader_stage) type);
+      }
    }
 
    return dwords;
 }
 
-static struct tu_draw_state
-tu_emit_consts(struct tu_cmd_buffer *cmd, bool compute)
+/* Emits the push constants and inline uniforms of either the given compute
+ * shader or, if it is NULL, the bound graphics shaders. With patches, the
+ * push constants sourced from generated commands are recorded.
+ */
+static void
+tu_emit_consts_cs(struct tu_cmd_buffer *cmd,
+                  struct tu_cs *cs,
+                  const struct tu_shader *compute_shader,
+                  struct tu_dgc_patch_list *patches)
 {
-   uint32_t dwords = 0;
    const struct tu_push_constant_range *shared_consts =
-      compute ? &cmd->state.shaders[MESA_SHADER_COMPUTE]->const_state.push_consts :
+      compute_shader ? &compute_shader->const_state.push_consts :
       &cmd->state.program.shared_consts;
 
-   dwords = tu6_const_size(cmd, shared_consts, compute);
-
-   if (dwords == 0)
-      return (struct tu_draw_state) {};
-
-   struct tu_cs cs;
-   tu_cs_begin_sub_stream(&cmd->sub_cs, dwords, &cs);
-
    if (shared_consts->type == IR3_PUSH_CONSTS_SHARED) {
-      tu6_emit_shared_consts(&cs, shared_consts, cmd->push_constants, compute);
+      tu6_emit_shared_consts(cs, shared_consts, cmd->push_constants,
+                             compute_shader != NULL, patches);
    } else if (shared_consts->type == IR3_PUSH_CONSTS_SHARED_PREAMBLE) {
-      tu7_emit_shared_preamble_consts(&cs, shared_consts, cmd->push_constants);
+      tu7_emit_shared_preamble_consts(cs, shared_consts, cmd->push_constants,
+                                      patches);
    }
 
-   if (compute) {
+   if (compute_shader) {
       tu6_emit_per_stage_push_consts(
-         &cs, &cmd->state.shaders[MESA_SHADER_COMPUTE]->const_state,
-         cmd->state.shaders[MESA_SHADER_COMPUTE]->variant->const_state,
-         MESA_SHADER_COMPUTE, cmd->push_constants);
+         cs, &compute_shader->const_state,
+         compute_shader->variant->const_state,
+         MESA_SHADER_COMPUTE, cmd->push_constants, patches);
       tu_emit_inline_ubo(
-         &cs, &cmd->state.shaders[MESA_SHADER_COMPUTE]->const_state,
-         cmd->state.shaders[MESA_SHADER_COMPUTE]->variant->const_state,
-         cmd->state.shaders[MESA_SHADER_COMPUTE]->variant->constlen,
+         cs, &compute_shader->const_state,
+         compute_shader->variant->const_state,
+         compute_shader->variant->constlen,
          MESA_SHADER_COMPUTE,
-         tu_get_descriptors_state(cmd, VK_PIPELINE_BIND_POINT_COMPUTE));
+         tu_get_descriptors_state(cmd, VK_PIPELINE_BIND_POINT_COMPUTE),
+         patches);
    } else {
       struct tu_descriptor_state *descriptors =
          tu_get_descriptors_state(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS);
       for (uint32_t type = MESA_SHADER_VERTEX; type <= MESA_SHADER_FRAGMENT; type++) {
          const struct tu_program_descriptor_linkage *link =
             &cmd->state.program.link[type];
-         tu6_emit_per_stage_push_consts(&cs, &link->tu_const_state,
+         tu6_emit_per_stage_push_consts(cs, &link->tu_const_state,
                                         &link->const_state,
                                         (gl_shader_stage) type,
-                                        cmd->push_constants);
-         tu_emit_inline_ubo(&cs, &link->tu_const_state,
+                                        cmd->push_constants, patches);
+         tu_emit_inline_ubo(cs, &link->tu_const_state,
                             &link->const_state, link->constlen,
-                            (gl_shader_stage) type, descriptors);
+                            (gl_shader_stage) type, descriptors, patches);
       }
    }
+}
+
+static struct tu_draw_state
+tu_emit_consts(struct tu_cmd_buffer *cmd, bool compute)
+{
+   uint32_t dwords = 0;
+   const struct tu_push_constant_range *shared_consts =
+      compute ? &cmd->state.shaders[MESA_SHADER_COMPUTE]->const_state.push_consts :
+      &cmd->state.program.shared_consts;
+
+   dwords = tu6_const_size(cmd->device, cmd->state.shaders, shared_consts,
+                           compute);
+
+   if (dwords == 0)
+      return (struct tu_draw_state) {};
+
+   struct tu_cs cs;
+   tu_cs_begin_sub_stream(&cmd->sub_cs, dwords, &cs);
+
+   tu_emit_consts_cs(cmd, &cs,
+                     compute ? cmd->state.shaders[MESA_SHADER_COMPUTE] : NULL,
+                     NULL);
 
    return tu_cs_end_draw_state(&cmd->sub_cs, &cs);
 }
@@ -6351,6 +6794,116 @@ tu_flush_dynamic_input_attachments(struct tu_cmd_buffer *cmd)
    }
 }
 
+/* Picks the variants of the bound shader objects that match the other bound
+ * stages and the render pass, and binds them the way tu_CmdBindPipeline()
+ * binds the shaders of a pipeline.
+ */
+template <chip CHIP>
+static void
+tu_bind_shader_objects(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
+{
+   struct tu_device *dev = cmd->device;
+   struct tu_shader_object *const *objs = cmd->state.shader_objects;
+   struct tu_shader *shaders[MESA_SHADER_STAGES] = {};
+
+   struct tu_shader_object_key key;
+   memset(&key, 0, sizeof(key));
+   key.multiview_mask = cmd->state.vk_rp.view_mask;
+   key.has_gs = objs[MESA_SHADER_GEOMETRY] != NULL;
+   if (objs[MESA_SHADER_TESS_CTRL] && objs[MESA_SHADER_TESS_EVAL])
+      key.tessellation = objs[MESA_SHADER_TESS_EVAL]->tess_mode;
+
+   /* Drawing without a VS isn't allowed. */
+   if (!objs[MESA_SHADER_VERTEX])
+      return;
+
+   for (gl_shader_stage stage = MESA_SHADER_VERTEX;
+        stage <= MESA_SHADER_FRAGMENT; stage = (gl_shader_stage) (stage + 1)) {
+      if (!objs[stage])
+         continue;
+
+      shaders[stage] = tu_shader_object_get_variant(dev, objs[stage], &key);
+      if (!shaders[stage]) {
+         vk_command_buffer_set_error(&cmd->vk, VK_ERROR_OUT_OF_HOST_MEMORY);
+         return;
+      }
+   }
+
+   if (!shaders[MESA_SHADER_TESS_CTRL])
+      shaders[MESA_SHADER_TESS_CTRL] = dev->empty_tcs;
+   if (!shaders[MESA_SHADER_TESS_EVAL])
+      shaders[MESA_SHADER_TESS_EVAL] = dev->empty_tes;
+   if (!shaders[MESA_SHADER_GEOMETRY])
+      shaders[MESA_SHADER_GEOMETRY] = dev->empty_gs;
+   if (!shaders[MESA_SHADER_FRAGMENT]) {
+      shaders[MESA_SHADER_FRAGMENT] =
+         (cmd->state.pass && cmd->state.pass->has_fdm) ?
+         dev->empty_fs_fdm : dev->empty_fs;
+   }
+
+   /* A new render pass alone often doesn't change the variants. */
+   if (!(cmd->state.dirty & TU_CMD_DIRTY_SHADER_OBJECTS) &&
+       !memcmp(cmd->state.shaders, shaders,
+               (MESA_SHADER_FRAGMENT + 1) * sizeof(shaders[0])))
+      return;
+
+   struct tu_linked_program_cache_entry *linked = NULL;
+   for (unsigned i = 0; i < TU_LINKED_PROGRAM_CACHE_SIZE; i++) {
+      if (!memcmp(cmd->state.linked_program_cache[i].shaders, shaders,
+                  sizeof(shaders))) {
+         linked = &cmd->state.linked_program_cache[i];
+         break;
+      }
+   }
+
+   if (!linked) {
+      linked =
+         &cmd->state.linked_program_cache[cmd->state.linked_program_cache_next];
+      cmd->state.linked_program_cache_next =
+         (cmd->state.linked_program_cache_next + 1) %
+         TU_LINKED_PROGRAM_CACHE_SIZE;
+
+      memcpy(linked->shaders, shaders, sizeof(shaders));
+      memset(&linked->program, 0, sizeof(linked->program));
+      tu_emit_program_state<CHIP>(&cmd->sub_cs, &linked->program, shaders);
+
+      struct tu_cs prim_cs;
+      linked->prim_order_gmem = tu_cs_draw_state(&cmd->sub_cs, &prim_cs, 2);
+      tu_cs_emit_write_reg(&prim_cs, REG_A6XX_GRAS_SC_CNTL,
+                           A6XX_GRAS_SC_CNTL_CCUSINGLECACHELINESIZE(2) |
+                           A6XX_GRAS_SC_CNTL_SINGLE_PRIM_MODE(
+                              TU_DEBUG(RAST_ORDER) ? FLUSH_PER_OVERLAP :
+                                                     NO_FLUSH));
+   }
+
+   cmd->state.dirty |= TU_CMD_DIRTY_DESC_SETS | TU_CMD_DIRTY_SHADER_CONSTS |
+                       TU_CMD_DIRTY_VS_PARAMS | TU_CMD_DIRTY_PROGRAM;
+
+   tu_bind_vs(cmd, shaders[MESA_SHADER_VERTEX]);
+   tu_bind_tcs(cmd, shaders[MESA_SHADER_TESS_CTRL]);
+   tu_bind_tes(cmd, shaders[MESA_SHADER_TESS_EVAL]);
+   tu_bind_gs(cmd, shaders[MESA_SHADER_GEOMETRY]);
+   tu_bind_fs(cmd, shaders[MESA_SHADER_FRAGMENT]);
+
+   cmd->state.program = linked->program;
+
+   /* Descriptors aren't prefetched for shader objects. */
+   cmd->state.load_state = (struct tu_draw_state) {};
+   cmd->state.prim_order_gmem = linked->prim_order_gmem;
+   cmd->state.pipeline_sysmem_single_prim_mode = false;
+   cmd->state.pipeline_has_tess = objs[MESA_SHADER_TESS_CTRL] != NULL;
+   cmd->state.pipeline_disable_gmem = false;
+
+   tu_pipeline_update_rp_state(&cmd->state);
+
+   if (!(cmd->state.dirty & TU_CMD_DIRTY_DRAW_STATE)) {
+      tu_emit_program_draw_states(cs, &cmd->state.program,
+                                  cmd->state.prim_order_gmem, 0);
+   }
+
+   tu_update_program_state(cmd);
+}
+
 template <chip CHIP>
 static VkResult
 tu6_draw_common(struct tu_cmd_buffer *cmd,
@@ -6362,6 +6915,11 @@ tu6_draw_common(struct tu_cmd_buffer *cmd,
    const struct tu_program_state *program = &cmd->state.program;
    struct tu_render_pass_state *rp = &cmd->state.rp;
 
+   if (cmd->state.gfx_shader_objects &&
+       (cmd->state.dirty & (TU_CMD_DIRTY_SHADER_OBJECTS |
+                            TU_CMD_DIRTY_SUBPASS)))
+      tu_bind_shader_objects<CHIP>(cmd, cs);
+
    /* Emit state first, because it's needed for bandwidth calculations */
    uint32_t dynamic_draw_state_dirty = 0;
    if (!BITSET_IS_EMPTY(cmd->vk.dynamic_graphics_state.dirty) ||
@@ -6830,6 +7388,44 @@ tu_CmdDrawMultiEXT(VkCommandBuffer commandBuffer,
       }
    }
 
+   /* Instead of switching the vs params between draws, let the CP write
+    * them for all draws at once from an array of indirect draw commands.
+    */
+   if (drawCount > 1 && !has_tess) {
+      struct tu_cs_memory draws;
+      VkResult result = tu_cs_alloc(&cmd->sub_cs, drawCount,
+                                    sizeof(VkDrawIndirectCommand) / 4,
+                                    &draws);
+      if (result != VK_SUCCESS) {
+         vk_command_buffer_set_error(&cmd->vk, result);
+         return;
+      }
+
+      VkDrawIndirectCommand *cmds = (VkDrawIndirectCommand *) draws.map;
+      uint32_t i = 0;
+      vk_foreach_multi_draw(draw, i, pVertexInfo, drawCount, stride) {
+         cmds[i] = (VkDrawIndirectCommand) {
+            .vertexCount = draw->vertexCount,
+            .instanceCount = instanceCount,
+            .firstVertex = draw->firstVertex,
+            .firstInstance = firstInstance,
+         };
+      }
+
+      tu6_emit_empty_vs_params<CHIP>(cmd);
+
+      tu6_draw_common<CHIP>(cmd, cs, false, 0);
+
+      tu_cs_emit_pkt7(cs, CP_DRAW_INDIRECT_MULTI, 6);
+      tu_cs_emit(cs, tu_draw_initiator(cmd, DI_SRC_SEL_AUTO_INDEX));
+      tu_cs_emit(cs, A6XX_CP_DRAW_INDIRECT_MULTI_1_OPCODE(INDIRECT_OP_NORMAL) |
+                     A6XX_CP_DRAW_INDIRECT_MULTI_1_DST_OFF(vs_params_offset(cmd)));
+      tu_cs_emit(cs, drawCount);
+      tu_cs_emit_qw(cs, draws.iova);
+      tu_cs_emit(cs, sizeof(VkDrawIndirectCommand));
+      return;
+   }
+
    uint32_t i = 0;
    vk_foreach_multi_draw(draw, i, pVertexInfo, drawCount, stride) {
       tu6_emit_vs_params(cmd, i, draw->firstVertex, firstInstance);
@@ -6903,6 +7499,46 @@ tu_CmdDrawMultiIndexedEXT(VkCommandBuffer commandBuffer,
       }
    }
 
+   /* See tu_CmdDrawMultiEXT(). */
+   if (drawCount > 1 && !has_tess) {
+      struct tu_cs_memory draws;
+      VkResult result = tu_cs_alloc(&cmd->sub_cs, drawCount,
+                                    sizeof(VkDrawIndexedIndirectCommand) / 4,
+                                    &draws);
+      if (result != VK_SUCCESS) {
+         vk_command_buffer_set_error(&cmd->vk, result);
+         return;
+      }
+
+      VkDrawIndexedIndirectCommand *cmds =
+         (VkDrawIndexedIndirectCommand *) draws.map;
+      uint32_t i = 0;
+      vk_foreach_multi_draw_indexed(draw, i, pIndexInfo, drawCount, stride) {
+         cmds[i] = (VkDrawIndexedIndirectCommand) {
+            .indexCount = draw->indexCount,
+            .instanceCount = instanceCount,
+            .firstIndex = draw->firstIndex,
+            .vertexOffset = pVertexOffset ? *pVertexOffset : draw->vertexOffset,
+            .firstInstance = firstInstance,
+         };
+      }
+
+      tu6_emit_empty_vs_params<CHIP>(cmd);
+
+      tu6_draw_common<CHIP>(cmd, cs, true, 0);
+
+      tu_cs_emit_pkt7(cs, CP_DRAW_INDIRECT_MULTI, 9);
+      tu_cs_emit(cs, tu_draw_initiator(cmd, DI_SRC_SEL_DMA));
+      tu_cs_emit(cs, A6XX_CP_DRAW_INDIRECT_MULTI_1_OPCODE(INDIRECT_OP_INDEXED) |
+                     A6XX_CP_DRAW_INDIRECT_MULTI_1_DST_OFF(vs_params_offset(cmd)));
+      tu_cs_emit(cs, drawCount);
+      tu_cs_emit_qw(cs, cmd->state.index_va);
+      tu_cs_emit(cs, cmd->state.max_index_count);
+      tu_cs_emit_qw(cs, draws.iova);
+      tu_cs_emit(cs, sizeof(VkDrawIndexedIndirectCommand));
+      return;
+   }
+
    uint32_t i = 0;
    vk_foreach_multi_draw_indexed(draw, i, pIndexInfo, drawCount, stride) {
       int32_t vertexOffset = pVertexOffset ? *pVertexOffset : draw->vertexOffset;
@@ -7115,6 +7751,229 @@ tu_CmdDrawIndirectByteCountEXT(VkCommandBuffer commandBuffer,
 }
 TU_GENX(tu_CmdDrawIndirectByteCountEXT);
 
+/* Upper bound of the CP_SET_DRAW_STATE, PC_RESTART_INDEX and
+ * CP_DRAW_INDIRECT_MULTI packets that follow the data of a draw sequence.
+ */
+#define TU_DGC_DRAW_STREAM_DW 24
+
+static uint32_t
+tu_dgc_draw_template_size(struct tu_device *dev,
+                          const struct tu_indirect_command_layout *layout,
+                          struct tu_shader *const *shaders,
+                          const struct tu_push_constant_range *shared_consts,
+                          uint32_t vb_count, uint32_t stride_count)
+{
+   uint32_t dwords = 1 + TU_DGC_DRAW_STREAM_DW;
+
+   if (layout->vk.dgc_info & (BITFIELD_BIT(MESA_VK_DGC_PC) |
+                              BITFIELD_BIT(MESA_VK_DGC_SI))) {
+      dwords += tu6_const_size(dev, shaders, shared_consts, false);
+   }
+
+   if (layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_VB))
+      dwords += 4 * vb_count + 1 + 2 * stride_count;
+
+   return dwords;
+}
+
+uint32_t
+tu_dgc_pipeline_draw_size(struct tu_device *dev,
+                          const struct tu_indirect_command_layout *layout,
+                          const struct tu_pipeline *pipeline)
+{
+   return tu_dgc_draw_template_size(dev, layout, pipeline->shaders,
+                                    &pipeline->program.shared_consts,
+                                    MAX_VBS, MAX_VBS);
+}
+
+/* Builds the template of a draw sequence from the state of cmd. The sequence
+ * replaces the constants, vertex buffers and vertex strides draw states with
+ * its own copies, which are embedded in the sequence behind a CP_NOP, and
+ * then draws through CP_DRAW_INDIRECT_MULTI with the draw parameters read
+ * straight from the sequence.
+ */
+template <chip CHIP>
+VkResult
+tu_dgc_emit_draw_template(struct tu_cmd_buffer *cmd,
+                          struct tu_cs *sub_cs,
+                          const struct tu_indirect_command_layout *layout,
+                          struct tu_dgc_template *tmpl)
+{
+   const struct vk_indirect_command_layout *vk_layout = &layout->vk;
+   const struct vk_dynamic_graphics_state *dyn =
+      &cmd->vk.dynamic_graphics_state;
+   bool has_consts = vk_layout->dgc_info & (BITFIELD_BIT(MESA_VK_DGC_PC) |
+                                            BITFIELD_BIT(MESA_VK_DGC_SI));
+   bool has_vbs = vk_layout->dgc_info & BITFIELD_BIT(MESA_VK_DGC_VB);
+   bool has_ib = vk_layout->dgc_info & BITFIELD_BIT(MESA_VK_DGC_IB);
+   bool indexed = vk_layout->dgc_info & BITFIELD_BIT(MESA_VK_DGC_DRAW_INDEXED);
+
+   uint32_t vb_count = MAX2(cmd->state.max_vbs_bound,
+                            util_last_bit(vk_layout->vertex_bindings));
+   uint32_t stride_count = MAX2(util_last_bit(dyn->vi_bindings_valid),
+                                util_last_bit(vk_layout->vertex_bindings));
+   uint32_t size =
+      tu_dgc_draw_template_size(cmd->device, layout, cmd->state.shaders,
+                                &cmd->state.program.shared_consts,
+                                vb_count, stride_count);
+
+   struct tu_cs_memory mem;
+   VkResult result = tu_cs_alloc(sub_cs, DIV_ROUND_UP(size, 4), 4, &mem);
+   if (result != VK_SUCCESS)
+      return result;
+
+   struct tu_cs cs;
+   tu_cs_init_external(&cs, cmd->device, mem.map, mem.map + align(size, 4),
+                       mem.iova, false);
+   tu_cs_begin(&cs);
+   tu_cs_reserve_space(&cs, size);
+
+   struct tu_dgc_patch_list patches;
+   tu_dgc_patch_list_init(&patches, layout, mem.map, mem.iova);
+
+   uint32_t *nop = tu_dgc_begin_data(&cs);
+
+   struct tu_draw_state consts = {};
+   if (has_consts) {
+      consts.iova = tu_cs_get_cur_iova(&cs);
+      uint32_t *start = cs.cur;
+      tu_emit_consts_cs(cmd, &cs, NULL, &patches);
+      consts.size = cs.cur - start;
+   }
+
+   struct tu_draw_state vbs = {}, strides = {};
+   if (has_vbs) {
+      vbs.iova = tu_cs_get_cur_iova(&cs);
+      vbs.size = 4 * vb_count;
+      for (uint32_t i = 0; i < vb_count; i++) {
+         tu_cs_emit_regs(&cs,
+                         A6XX_VFD_FETCH_BASE(i, .qword = cmd->state.vb[i].base),
+                         A6XX_VFD_FETCH_SIZE(i, cmd->state.vb[i].size));
+      }
+
+      strides.iova = tu_cs_get_cur_iova(&cs);
+      strides.size = 1 + 2 * stride_count;
+      tu_cs_emit_pkt7(&cs, CP_CONTEXT_REG_BUNCH, 2 * stride_count);
+      uint32_t *stride_dw = cs.cur;
+      for (uint32_t i = 0; i < stride_count; i++) {
+         tu_cs_emit(&cs, REG_A6XX_VFD_FETCH_STRIDE(i));
+         tu_cs_emit(&cs, dyn->vi_binding_strides[i]);
+      }
+
+      /* VkBindVertexBufferIndirectCommandEXT is the address, size and
+       * stride, which are laid out like VFD_FETCH_BASE/VFD_FETCH_SIZE.
+       */
+      for (uint32_t i = 0; i < vk_layout->n_vb_layouts; i++) {
+         const struct vk_indirect_command_vertex_layout *vb =
+            &vk_layout->vb_layouts[i];
+         uint32_t *vb_dw = mem.map + 1 + consts.size + 4 * vb->binding;
+
+         tu_dgc_patch_add(&patches, vb_dw + 1, TU_DGC_PATCH_SEQ_DW,
+                          vb->src_offset_B, 3);
+         tu_dgc_patch_add(&patches, stride_dw + 2 * vb->binding + 1,
+                          TU_DGC_PATCH_SEQ_DW, vb->src_offset_B + 12, 1);
+      }
+   }
+
+   tu_dgc_end_data(&cs, nop);
+
+   /* These may be different every time the sequence is generated. */
+   consts.writeable = vbs.writeable = strides.writeable = true;
+
+   uint32_t state_count = !!consts.size + !!vbs.size + !!strides.size;
+   if (state_count) {
+      tu_cs_emit_pkt7(&cs, CP_SET_DRAW_STATE, 3 * state_count);
+      if (consts.size) {
+         tu_dgc_patch_block_addr(&patches, cs.cur + 1);
+         tu_cs_emit_draw_state(&cs, TU_DRAW_STATE_CONST, consts);
+      }
+      if (vbs.size) {
+         tu_dgc_patch_block_addr(&patches, cs.cur + 1);
+         tu_cs_emit_draw_state(&cs, TU_DRAW_STATE_VB, vbs);
+         tu_dgc_patch_block_addr(&patches, cs.cur + 1);
+         tu_cs_emit_draw_state(&cs,
+                               TU_DRAW_STATE_DYNAMIC + TU_DYNAMIC_STATE_VB_STRIDE,
+                               strides);
+      }
+   }
+
+   uint32_t ib_offset = vk_layout->index_src_offset_B;
+   if (indexed && has_ib) {
+      tu_cs_emit_regs(&cs, A6XX_PC_RESTART_INDEX(0));
+      tu_dgc_patch_add(&patches, cs.cur - 1, TU_DGC_PATCH_RESTART_INDEX,
+                       ib_offset, 0);
+   }
+
+   uint32_t draw_offset = vk_layout->draw_src_offset_B;
+   uint32_t initiator =
+      tu_draw_initiator(cmd, indexed ? DI_SRC_SEL_DMA : DI_SRC_SEL_AUTO_INDEX);
+
+   tu_cs_emit_pkt7(&cs, CP_DRAW_INDIRECT_MULTI, indexed ? 9 : 6);
+   if (indexed && has_ib) {
+      tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_INDEX_SIZE, ib_offset,
+                       CP_DRAW_INDX_OFFSET_0_INDEX_SIZE__SHIFT);
+      initiator &= ~CP_DRAW_INDX_OFFSET_0_INDEX_SIZE__MASK;
+   }
+   tu_cs_emit(&cs, initiator);
+   tu_cs_emit(&cs, A6XX_CP_DRAW_INDIRECT_MULTI_1_OPCODE(indexed ? INDIRECT_OP_INDEXED :
+                                                                  INDIRECT_OP_NORMAL) |
+                   A6XX_CP_DRAW_INDIRECT_MULTI_1_DST_OFF(vs_params_offset(cmd)));
+
+   /* VkDrawIndirectCountIndirectCommandEXT is the address, stride and
+    * count of the draws.
+    */
+   if (vk_layout->draw_count) {
+      tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_DRAW_COUNT,
+                       draw_offset + 12, 0);
+   }
+   tu_cs_emit(&cs, 1);
+
+   if (indexed) {
+      if (has_ib) {
+         tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_SEQ_DW,
+                          ib_offset, 2);
+         tu_dgc_patch_add(&patches, cs.cur + 2, TU_DGC_PATCH_MAX_INDEX,
+                          ib_offset, 0);
+      }
+      tu_cs_emit_qw(&cs, cmd->state.index_va);
+      tu_cs_emit(&cs, cmd->state.max_index_count);
+   }
+
+   if (vk_layout->draw_count) {
+      tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_SEQ_DW, draw_offset, 2);
+      tu_dgc_patch_add(&patches, cs.cur + 2, TU_DGC_PATCH_SEQ_DW,
+                       draw_offset + 8, 1);
+   } else {
+      tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_SEQ_ADDR, draw_offset, 0);
+   }
+   tu_cs_emit_qw(&cs, 0);
+   tu_cs_emit(&cs, 0);
+
+   assert(cs.cur <= mem.map + size);
+
+   return tu_dgc_patch_list_finish(&patches, sub_cs, cs.cur - mem.map, tmpl);
+}
+TU_GENX(tu_dgc_emit_draw_template);
+
+/* Emits the state that the draw sequences of generated commands depend on.
+ * This has to come right before the sequences in draw_cs.
+ */
+template <chip CHIP>
+void
+tu_dgc_begin_draw(struct tu_cmd_buffer *cmd,
+                  const struct tu_indirect_command_layout *layout)
+{
+   tu6_emit_empty_vs_params<CHIP>(cmd);
+
+   if (cmd->device->physical_device->info->a6xx.indirect_draw_wfm_quirk)
+      draw_wfm(cmd);
+
+   tu6_draw_common<CHIP>(
+      cmd, &cmd->draw_cs,
+      layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_DRAW_INDEXED), 0);
+}
+TU_GENX(tu_dgc_begin_draw);
+
 struct tu_dispatch_info
 {
    /**
@@ -7136,6 +7995,14 @@ struct tu_dispatch_info
     * Indirect compute parameters resource.
     */
    VkDeviceAddress indirect;
+
+   /**
+    * When recording a generated commands template, the indirect parameters
+    * are instead patched in from the VkDispatchIndirectCommand at this
+    * offset of the sequence.
+    */
+   struct tu_dgc_patch_list *dgc_patches;
+   uint32_t dgc_dispatch_offset;
 };
 
 static inline struct ir3_driver_params_cs
@@ -7165,10 +8032,10 @@ template <chip CHIP>
 static void
 tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
                               struct tu_cs *cs,
+                              const struct tu_shader *shader,
                               const struct tu_dispatch_info *info)
 {
    gl_shader_stage type = MESA_SHADER_COMPUTE;
-   const struct tu_shader *shader = cmd->state.shaders[MESA_SHADER_COMPUTE];
    const struct ir3_shader_variant *variant = shader->variant;
    const struct ir3_const_state *const_state = variant->const_state;
    unsigned subgroup_size = variant->info.subgroup_size;
@@ -7180,7 +8047,7 @@ tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
          return;
 
       bool direct_indirect_load =
-         !(info->indirect & 0xf) &&
+         !(info->indirect & 0xf) && !info->dgc_patches &&
          !(info->indirect && num_consts > IR3_DP_CS(base_group_x));
 
       uint64_t iova = 0;
@@ -7216,6 +8083,12 @@ tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
             tu_cs_emit_pkt7(cs, CP_MEM_TO_MEM, 5);
             tu_cs_emit(cs, 0);
             tu_cs_emit_qw(cs, global_iova_arr(cmd, cs_indirect_xyz, i));
+            if (info->dgc_patches) {
+               tu_dgc_patch_add(info->dgc_patches, cs->cur,
+                                TU_DGC_PATCH_SEQ_ADDR,
+                                info->dgc_dispatch_offset + i * sizeof(uint32_t),
+                                0);
+            }
             tu_cs_emit_qw(cs, indirect_iova + i * sizeof(uint32_t));
          }
 
@@ -7282,7 +8155,7 @@ tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
          tu_cs_emit(cs, 0);
          tu_cs_emit(cs, 0);
          tu_cs_emit_array(cs, (uint32_t *)&driver_params, num_consts);
-      } else if (!(info->indirect & 0xf)) {
+      } else if (!(info->indirect & 0xf) && !info->dgc_patches) {
          tu_cs_emit_pkt7(cs, tu6_stage2opcode(type), 3);
          tu_cs_emit(cs, CP_LOAD_STATE6_0_DST_OFF(offset) |
                      CP_LOAD_STATE6_0_STATE_TYPE(ST6_CONSTANTS) |
@@ -7302,6 +8175,11 @@ tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
             tu_cs_emit_pkt7(cs, CP_MEM_TO_MEM, 5);
             tu_cs_emit(cs, 0);
             tu_cs_emit_qw(cs, global_iova_arr(cmd, cs_indirect_xyz, i));
+            if (info->dgc_patches) {
+               tu_dgc_patch_add(info->dgc_patches, cs->cur,
+                                TU_DGC_PATCH_SEQ_ADDR,
+                                info->dgc_dispatch_offset + i * 4, 0);
+            }
             tu_cs_emit_qw(cs, info->indirect + i * 4);
          }
 
@@ -7345,6 +8223,31 @@ tu_emit_compute_driver_params(struct tu_cmd_buffer *cmd,
    }
 }
 
+template <chip CHIP>
+static void
+tu_emit_compute_ndrange(struct tu_cs *cs,
+                        const uint16_t *local_size,
+                        const uint32_t *num_groups)
+{
+   tu_cs_emit_regs(cs,
+                   HLSQ_CS_NDRANGE_0(CHIP, .kerneldim = 3,
+                                           .localsizex = local_size[0] - 1,
+                                           .localsizey = local_size[1] - 1,
+                                           .localsizez = local_size[2] - 1),
+                   HLSQ_CS_NDRANGE_1(CHIP, .globalsize_x = local_size[0] * num_groups[0]),
+                   HLSQ_CS_NDRANGE_2(CHIP, .globaloff_x = 0),
+                   HLSQ_CS_NDRANGE_3(CHIP, .globalsize_y = local_size[1] * num_groups[1]),
+                   HLSQ_CS_NDRANGE_4(CHIP, .globaloff_y = 0),
+                   HLSQ_CS_NDRANGE_5(CHIP, .globalsize_z = local_size[2] * num_groups[2]),
+                   HLSQ_CS_NDRANGE_6(CHIP, .globaloff_z = 0));
+   if (CHIP >= A7XX) {
+      tu_cs_emit_regs(cs,
+                      A7XX_HLSQ_CS_LAST_LOCAL_SIZE(.localsizex = local_size[0] - 1,
+                                                   .localsizey = local_size[1] - 1,
+                                                   .localsizez = local_size[2] - 1));
+   }
+}
+
 template <chip CHIP>
 static void
 tu_dispatch(struct tu_cmd_buffer *cmd,
@@ -7392,11 +8295,12 @@ tu_dispatch(struct tu_cmd_buffer *cmd,
     * bitfield.
     */
    tu_emit_cache_flush<CHIP>(cmd);
+   cmd->state.dirty_caches |= TU_CMD_FLAG_CACHE_CLEAN;
 
    /* note: no reason to have this in a separate IB */
    tu_cs_emit_state_ib(cs, tu_emit_consts(cmd, true));
 
-   tu_emit_compute_driver_params<CHIP>(cmd, cs, info);
+   tu_emit_compute_driver_params<CHIP>(cmd, cs, shader, info);
 
    if (cmd->state.dirty & TU_CMD_DIRTY_COMPUTE_DESC_SETS) {
       tu6_emit_descriptor_sets<CHIP>(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
@@ -7546,23 +8450,7 @@ tu_dispatch(struct tu_cmd_buffer *cmd,
                                                       .localsizez = last_local_size[2] - 1));
       }
    } else {
-      tu_cs_emit_regs(cs,
-                      HLSQ_CS_NDRANGE_0(CHIP, .kerneldim = 3,
-                                              .localsizex = local_size[0] - 1,
-                                              .localsizey = local_size[1] - 1,
-                                              .localsizez = local_size[2] - 1),
-                      HLSQ_CS_NDRANGE_1(CHIP, .globalsize_x = local_size[0] * num_groups[0]),
-                      HLSQ_CS_NDRANGE_2(CHIP, .globaloff_x = 0),
-                      HLSQ_CS_NDRANGE_3(CHIP, .globalsize_y = local_size[1] * num_groups[1]),
-                      HLSQ_CS_NDRANGE_4(CHIP, .globaloff_y = 0),
-                      HLSQ_CS_NDRANGE_5(CHIP, .globalsize_z = local_size[2] * num_groups[2]),
-                      HLSQ_CS_NDRANGE_6(CHIP, .globaloff_z = 0));
-      if (CHIP >= A7XX) {
-         tu_cs_emit_regs(cs,
-                         A7XX_HLSQ_CS_LAST_LOCAL_SIZE(.localsizex = local_size[0] - 1,
-                                                      .localsizey = local_size[1] - 1,
-                                                      .localsizez = local_size[2] - 1));
-      }
+      tu_emit_compute_ndrange<CHIP>(cs, local_size, num_groups);
    }
 
    if (cmd->device->physical_device->info->a7xx.has_rt_workaround &&
@@ -7697,6 +8585,134 @@ tu_dispatch_unaligned_indirect(VkCommandBuffer commandBuffer,
    TU_CALLX(cmd_buffer->device, tu_dispatch)(cmd_buffer, &info);
 }
 
+/* Upper bound of the packets that follow the constants of a dispatch
+ * sequence, which are dominated by the driver params of indirect dispatches.
+ */
+#define TU_DGC_DISPATCH_STREAM_DW 128
+
+uint32_t
+tu_dgc_dispatch_template_size(struct tu_device *dev,
+                              struct tu_shader *shader)
+{
+   struct tu_shader *shaders[MESA_SHADER_STAGES] = {};
+   shaders[MESA_SHADER_COMPUTE] = shader;
+
+   return 1 + TU_DGC_DISPATCH_STREAM_DW +
+      tu6_const_size(dev, shaders, &shader->const_state.push_consts, true);
+}
+
+/* Builds the template of a dispatch sequence of the given compute shader,
+ * with its program and descriptor loads if these differ between sequences.
+ * This is tu_dispatch() with the constants embedded in the sequence behind
+ * a CP_NOP and the dispatch parameters read straight from the sequence.
+ */
+template <chip CHIP>
+VkResult
+tu_dgc_emit_dispatch_template(struct tu_cmd_buffer *cmd,
+                              struct tu_cs *sub_cs,
+                              const struct tu_indirect_command_layout *layout,
+                              struct tu_shader *shader,
+                              struct tu_draw_state program,
+                              struct tu_draw_state load_state,
+                              struct tu_dgc_template *tmpl)
+{
+   uint32_t size = tu_dgc_dispatch_template_size(cmd->device, shader);
+
+   struct tu_cs_memory mem;
+   VkResult result = tu_cs_alloc(sub_cs, DIV_ROUND_UP(size, 4), 4, &mem);
+   if (result != VK_SUCCESS)
+      return result;
+
+   struct tu_cs cs;
+   tu_cs_init_external(&cs, cmd->device, mem.map, mem.map + align(size, 4),
+                       mem.iova, false);
+   tu_cs_begin(&cs);
+   tu_cs_reserve_space(&cs, size);
+
+   struct tu_dgc_patch_list patches;
+   tu_dgc_patch_list_init(&patches, layout, mem.map, mem.iova);
+
+   uint32_t *nop = tu_dgc_begin_data(&cs);
+   struct tu_draw_state consts = { .iova = tu_cs_get_cur_iova(&cs) };
+   uint32_t *start = cs.cur;
+   tu_emit_consts_cs(cmd, &cs, shader, &patches);
+   consts.size = cs.cur - start;
+   tu_dgc_end_data(&cs, nop);
+
+   tu_cs_emit_state_ib(&cs, program);
+   tu_cs_emit_state_ib(&cs, load_state);
+
+   bool emit_instrlen_workaround =
+      shader->variant->instrlen >
+      cmd->device->physical_device->info->a6xx.instr_cache_size;
+
+   /* See tu_dispatch(). */
+   if (emit_instrlen_workaround) {
+      tu_cs_emit_regs(&cs, A6XX_SP_FS_INSTRLEN(shader->variant->instrlen));
+      tu_emit_event_write<CHIP>(cmd, &cs, FD_LABEL);
+   }
+
+   if (consts.size) {
+      tu_dgc_patch_block_addr(&patches, cs.cur + 1);
+      tu_cs_emit_state_ib(&cs, consts);
+   }
+
+   struct tu_dispatch_info info = {};
+   /* Any non-zero address, the parameters are patched in. */
+   info.indirect = mem.iova;
+   info.dgc_patches = &patches;
+   info.dgc_dispatch_offset = layout->vk.dispatch_src_offset_B;
+   tu_emit_compute_driver_params<CHIP>(cmd, &cs, shader, &info);
+
+   tu_cs_emit_pkt7(&cs, CP_SET_MARKER, 1);
+   tu_cs_emit(&cs, A6XX_CP_SET_MARKER_0_MODE(RM6_COMPUTE));
+
+   const uint16_t *local_size = shader->variant->local_size;
+   tu_emit_compute_ndrange<CHIP>(&cs, local_size, info.blocks);
+
+   if (cmd->device->physical_device->info->a7xx.has_rt_workaround &&
+       shader->variant->info.uses_ray_intersection) {
+      tu_cs_emit_pkt7(&cs, CP_SET_MARKER, 1);
+      tu_cs_emit(&cs, A6XX_CP_SET_MARKER_0_SHADER_USES_RT);
+   }
+
+   tu_cs_emit_pkt7(&cs, CP_EXEC_CS_INDIRECT, 4);
+   tu_cs_emit(&cs, 0x00000000);
+   tu_dgc_patch_add(&patches, cs.cur, TU_DGC_PATCH_SEQ_ADDR,
+                    layout->vk.dispatch_src_offset_B, 0);
+   tu_cs_emit_qw(&cs, 0);
+   tu_cs_emit(&cs,
+              A5XX_CP_EXEC_CS_INDIRECT_3_LOCALSIZEX(local_size[0] - 1) |
+              A5XX_CP_EXEC_CS_INDIRECT_3_LOCALSIZEY(local_size[1] - 1) |
+              A5XX_CP_EXEC_CS_INDIRECT_3_LOCALSIZEZ(local_size[2] - 1));
+
+   if (emit_instrlen_workaround)
+      tu_emit_event_write<CHIP>(cmd, &cs, FD_LABEL);
+
+   assert(cs.cur <= mem.map + size);
+
+   return tu_dgc_patch_list_finish(&patches, sub_cs, cs.cur - mem.map, tmpl);
+}
+TU_GENX(tu_dgc_emit_dispatch_template);
+
+/* Emits the state that the dispatch sequences of generated commands depend
+ * on, right before the sequences in cs.
+ */
+template <chip CHIP>
+void
+tu_dgc_begin_dispatch(struct tu_cmd_buffer *cmd)
+{
+   tu_emit_cache_flush<CHIP>(cmd);
+   cmd->state.dirty_caches |= TU_CMD_FLAG_CACHE_CLEAN;
+
+   /* The sequences load the descriptors themselves. */
+   if (cmd->state.dirty & TU_CMD_DIRTY_COMPUTE_DESC_SETS)
+      tu6_emit_descriptor_sets<CHIP>(cmd, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+   cmd->state.dirty &= ~TU_CMD_DIRTY_COMPUTE_DESC_SETS;
+}
+TU_GENX(tu_dgc_begin_dispatch);
+
 VKAPI_ATTR void VKAPI_CALL
 tu_CmdEndRenderPass2(VkCommandBuffer commandBuffer,
                      const VkSubpassEndInfo *pSubpassEndInfo)
@@ -7735,6 +8751,7 @@ tu_CmdEndRenderPass2(VkCommandBuffer commandBuffer,
    vk_free(&cmd_buffer->vk.pool->alloc, cmd_buffer->state.attachments);
 
    tu_reset_render_pass(cmd_buffer);
+   tu_resolve_fold_end(cmd_buffer);
 }
 
 VKAPI_ATTR void VKAPI_CALL
@@ -7791,6 +8808,7 @@ tu_CmdEndRendering2EXT(VkCommandBuffer commandBuffer,
       }
 
       tu_reset_render_pass(cmd_buffer);
+      tu_resolve_fold_end(cmd_buffer);
    }
 
    if (cmd_buffer->state.resuming && !cmd_buffer->state.suspending) {
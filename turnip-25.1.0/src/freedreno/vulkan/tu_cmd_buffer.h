@@ -75,8 +75,9 @@ enum tu_cmd_dirty_bits
    TU_CMD_DIRTY_FS = BIT(14),
    TU_CMD_DIRTY_SHADING_RATE = BIT(15),
    TU_CMD_DIRTY_DISABLE_FS = BIT(16),
+   TU_CMD_DIRTY_SHADER_OBJECTS = BIT(17),
    /* all draw states were disabled and need to be re-enabled: */
-   TU_CMD_DIRTY_DRAW_STATE = BIT(17)
+   TU_CMD_DIRTY_DRAW_STATE = BIT(18)
 };
 
 /* There are only three cache domains we have to care about: the CCU, or
@@ -226,6 +227,12 @@ enum tu_cmd_flush_bits {
        */
       TU_CMD_FLAG_WAIT_MEM_WRITES,
 
+   /* The cleans which write back an actual cache. */
+   TU_CMD_FLAG_ALL_CACHE_CLEAN =
+      TU_CMD_FLAG_CCU_CLEAN_DEPTH |
+      TU_CMD_FLAG_CCU_CLEAN_COLOR |
+      TU_CMD_FLAG_CACHE_CLEAN,
+
    TU_CMD_FLAG_ALL_INVALIDATE =
       TU_CMD_FLAG_CCU_INVALIDATE_DEPTH |
       TU_CMD_FLAG_CCU_INVALIDATE_COLOR |
@@ -417,6 +424,31 @@ enum tu_suspend_resume_state
    SR_IN_CHAIN_AFTER_PRE_CHAIN,
 };
 
+/* Recently emitted copies of small dynamic states, see
+ * tu_cmd_cached_dynamic_state().
+ */
+#define TU_DYNAMIC_STATE_CACHE_SIZE 16
+#define TU_DYNAMIC_STATE_CACHE_MAX_DWORDS 32
+
+struct tu_dynamic_state_cache_entry
+{
+   struct tu_draw_state state;
+   uint32_t id;
+   uint32_t dwords[TU_DYNAMIC_STATE_CACHE_MAX_DWORDS];
+};
+
+/* Programs recently linked from bound shader objects, see
+ * tu_bind_shader_objects().
+ */
+#define TU_LINKED_PROGRAM_CACHE_SIZE 4
+
+struct tu_linked_program_cache_entry
+{
+   struct tu_shader *shaders[MESA_SHADER_STAGES];
+   struct tu_program_state program;
+   struct tu_draw_state prim_order_gmem;
+};
+
 struct tu_cmd_state
 {
    uint32_t dirty;
@@ -425,6 +457,15 @@ struct tu_cmd_state
 
    struct tu_program_state program;
 
+   /* VK_EXT_shader_object: the graphics shaders come from shader_objects
+    * instead of a pipeline, and are linked at draw time.
+    */
+   bool gfx_shader_objects;
+   struct tu_shader_object *shader_objects[MESA_SHADER_FRAGMENT + 1];
+   struct tu_linked_program_cache_entry
+      linked_program_cache[TU_LINKED_PROGRAM_CACHE_SIZE];
+   uint32_t linked_program_cache_next;
+
    struct tu_render_pass_state rp;
 
    struct vk_render_pass_state vk_rp;
@@ -448,6 +489,9 @@ struct tu_cmd_state
 
    /* saved states to re-emit in TU_CMD_DIRTY_DRAW_STATE case */
    struct tu_draw_state dynamic_state[TU_DYNAMIC_STATE_COUNT];
+   struct tu_dynamic_state_cache_entry
+      dynamic_state_cache[TU_DYNAMIC_STATE_CACHE_SIZE];
+   uint32_t dynamic_state_cache_next;
    struct tu_draw_state vertex_buffers;
    struct tu_draw_state shader_const;
    struct tu_draw_state desc_sets;
@@ -480,6 +524,15 @@ struct tu_cmd_state
 
    enum tu_cmd_ccu_state ccu_state;
 
+   /* Caches which may hold writes that haven't been cleaned yet, as
+    * TU_CMD_FLAG_ALL_CACHE_CLEAN bits. Barriers often name more source
+    * accesses than were actually performed, and cleaning a cache nothing
+    * wrote through since its last clean is a no-op, so these cleans are
+    * dropped outside of render passes. What happens inside render passes
+    * and secondaries isn't tracked, so they dirty everything they may touch.
+    */
+   BITMASK_ENUM(tu_cmd_flush_bits) dirty_caches;
+
    /* Decides which GMEM layout to use from the tu_pass, based on whether the CCU
     * might get used by tu_store_gmem_attachment().
     */
@@ -549,6 +602,11 @@ struct tu_cmd_state
 
    struct tu_lrz_state lrz;
 
+   /* LRZ state left by the last GMEM renderpass, only used without GPU
+    * direction tracking. See tu_lrz.cc.
+    */
+   struct tu_lrz_state last_lrz;
+
    struct tu_draw_state lrz_and_depth_plane_state;
 
    struct tu_vs_params last_vs_params;
@@ -559,6 +617,39 @@ struct tu_cmd_state
    uint64_t descriptor_buffer_iova[MAX_SETS];
 };
 
+/* A GMEM render pass that just ended leaves a CP_NOP slot in each tile for
+ * every MSAA color attachment it stores, so that a vkCmdResolveImage of that
+ * attachment recorded right after it can be patched in as a resolve from
+ * GMEM rather than done by reading the stored image back.
+ */
+#define TU_RESOLVE_FOLD_SLOT_DWORDS 4
+
+struct tu_resolve_fold_attachment {
+   const struct tu_image *image;
+   uint32_t level, layer;
+   VkFormat format;
+   VkSampleCountFlagBits samples;
+   uint32_t gmem_offset;
+   bool is_mutable;
+   bool folded;
+};
+
+struct tu_resolve_fold {
+   /* cmd->cs position after the render pass, folding is only possible if
+    * nothing was emitted since
+    */
+   uint32_t *cs_cur;
+   uint32_t cs_entry_count;
+
+   VkRect2D render_area;
+
+   uint32_t attachment_count;
+   struct tu_resolve_fold_attachment attachments[MAX_RTS];
+
+   /* uint32_t *, attachment_count slots per tile */
+   struct util_dynarray slots;
+};
+
 struct tu_cmd_buffer
 {
    struct vk_command_buffer vk;
@@ -629,6 +720,8 @@ struct tu_cmd_buffer
       void *patchpoints_ctx;
    } pre_chain;
 
+   struct tu_resolve_fold resolve_fold;
+
    uint32_t vsc_draw_strm_pitch;
    uint32_t vsc_prim_strm_pitch;
    uint64_t vsc_draw_strm_va, vsc_draw_strm_size_va, vsc_prim_strm_va;
@@ -706,6 +799,44 @@ void tu_dispatch_unaligned(VkCommandBuffer commandBuffer,
 void tu_dispatch_unaligned_indirect(VkCommandBuffer commandBuffer,
                                     VkDeviceAddress size_addr);
 
+struct tu_indirect_command_layout;
+struct tu_dgc_template;
+
+uint32_t
+tu_dgc_pipeline_draw_size(struct tu_device *dev,
+                          const struct tu_indirect_command_layout *layout,
+                          const struct tu_pipeline *pipeline);
+
+uint32_t
+tu_dgc_dispatch_template_size(struct tu_device *dev,
+                              struct tu_shader *shader);
+
+template <chip CHIP>
+VkResult
+tu_dgc_emit_draw_template(struct tu_cmd_buffer *cmd,
+                          struct tu_cs *sub_cs,
+                          const struct tu_indirect_command_layout *layout,
+                          struct tu_dgc_template *tmpl);
+
+template <chip CHIP>
+VkResult
+tu_dgc_emit_dispatch_template(struct tu_cmd_buffer *cmd,
+                              struct tu_cs *sub_cs,
+                              const struct tu_indirect_command_layout *layout,
+                              struct tu_shader *shader,
+                              struct tu_draw_state program,
+                              struct tu_draw_state load_state,
+                              struct tu_dgc_template *tmpl);
+
+template <chip CHIP>
+void
+tu_dgc_begin_draw(struct tu_cmd_buffer *cmd,
+                  const struct tu_indirect_command_layout *layout);
+
+template <chip CHIP>
+void
+tu_dgc_begin_dispatch(struct tu_cmd_buffer *cmd);
+
 void tu_write_buffer_cp(VkCommandBuffer commandBuffer,
                         VkDeviceAddress addr,
                         void *data, uint32_t size);
@@ -65,21 +65,38 @@ tu_cs_init_suballoc(struct tu_cs *cs, struct tu_device *device,
    cs->refcount_bo = tu_bo_get_ref(suballoc_bo->bo);
 }
 
+static bool
+tu_cs_bo_is_suballoc(const struct tu_cs *cs, const struct tu_bo_array *bos,
+                     const struct tu_suballoc_bo *bo)
+{
+   return bos == &cs->read_only && bo->size <= TU_CS_SUBALLOC_MAX_SIZE;
+}
+
+static void
+tu_cs_free_bo(struct tu_cs *cs, struct tu_bo_array *bos,
+              struct tu_suballoc_bo *bo)
+{
+   if (tu_cs_bo_is_suballoc(cs, bos, bo)) {
+      mtx_lock(&cs->device->cs_mutex);
+      tu_suballoc_bo_free(&cs->device->cs_suballoc, bo);
+      mtx_unlock(&cs->device->cs_mutex);
+   } else {
+      TU_RMV(resource_destroy, cs->device, bo->bo);
+      tu_bo_finish(cs->device, bo->bo);
+   }
+}
+
 /**
  * Finish and release all resources owned by a command stream.
  */
 void
 tu_cs_finish(struct tu_cs *cs)
 {
-   for (uint32_t i = 0; i < cs->read_only.bo_count; ++i) {
-      TU_RMV(resource_destroy, cs->device, cs->read_only.bos[i]);
-      tu_bo_finish(cs->device, cs->read_only.bos[i]);
-   }
+   for (uint32_t i = 0; i < cs->read_only.bo_count; ++i)
+      tu_cs_free_bo(cs, &cs->read_only, &cs->read_only.bos[i]);
 
-   for (uint32_t i = 0; i < cs->read_write.bo_count; ++i) {
-      TU_RMV(resource_destroy, cs->device, cs->read_write.bos[i]);
-      tu_bo_finish(cs->device, cs->read_write.bos[i]);
-   }
+   for (uint32_t i = 0; i < cs->read_write.bo_count; ++i)
+      tu_cs_free_bo(cs, &cs->read_write, &cs->read_write.bos[i]);
 
    if (cs->refcount_bo)
       tu_bo_finish(cs->device, cs->refcount_bo);
@@ -97,7 +114,7 @@ tu_cs_current_bo(const struct tu_cs *cs)
    } else {
       const struct tu_bo_array *bos = cs->writeable ? &cs->read_write : &cs->read_only;
       assert(bos->bo_count);
-      return bos->bos[bos->bo_count - 1];
+      return bos->bos[bos->bo_count - 1].bo;
    }
 }
 
@@ -144,8 +161,8 @@ tu_cs_add_bo(struct tu_cs *cs, uint32_t size)
    /* grow cs->bos if needed */
    if (bos->bo_count == bos->bo_capacity) {
       uint32_t new_capacity = MAX2(4, 2 * bos->bo_capacity);
-      struct tu_bo **new_bos = (struct tu_bo **)
-         realloc(bos->bos, new_capacity * sizeof(struct tu_bo *));
+      struct tu_suballoc_bo *new_bos = (struct tu_suballoc_bo *)
+         realloc(bos->bos, new_capacity * sizeof(struct tu_suballoc_bo));
       if (!new_bos)
          return VK_ERROR_OUT_OF_HOST_MEMORY;
 
@@ -153,30 +170,53 @@ tu_cs_add_bo(struct tu_cs *cs, uint32_t size)
       bos->bos = new_bos;
    }
 
-   struct tu_bo *new_bo;
+   struct tu_suballoc_bo new_bo;
+   VkResult result;
 
-   VkResult result =
-      tu_bo_init_new(cs->device, NULL, &new_bo, size * sizeof(uint32_t),
-                     (enum tu_bo_alloc_flags)(COND(!cs->writeable,
-                                                   TU_BO_ALLOC_GPU_READ_ONLY) |
-                                              TU_BO_ALLOC_ALLOW_DUMP),
-                     cs->name);
-   if (result != VK_SUCCESS) {
-      return result;
-   }
+   /* Small chunks, which are what most command buffers need, are carved out
+    * of shared BOs so that recording lots of short command buffers doesn't
+    * cost a kernel BO allocation and a mapping for each of their streams.
+    */
+   if (!cs->writeable && size * sizeof(uint32_t) <= TU_CS_SUBALLOC_MAX_SIZE) {
+      mtx_lock(&cs->device->cs_mutex);
+      result = tu_suballoc_bo_alloc(&new_bo, &cs->device->cs_suballoc,
+                                    size * sizeof(uint32_t), 64);
+      mtx_unlock(&cs->device->cs_mutex);
+      if (result != VK_SUCCESS)
+         return result;
+   } else {
+      struct tu_bo *bo;
+      result =
+         tu_bo_init_new(cs->device, NULL, &bo, size * sizeof(uint32_t),
+                        (enum tu_bo_alloc_flags)(COND(!cs->writeable,
+                                                      TU_BO_ALLOC_GPU_READ_ONLY) |
+                                                 TU_BO_ALLOC_ALLOW_DUMP |
+                                                 TU_BO_ALLOC_CACHEABLE),
+                        TU_MEM_CATEGORY_CMDSTREAM, cs->name);
+      if (result != VK_SUCCESS) {
+         return result;
+      }
 
-   result = tu_bo_map(cs->device, new_bo, NULL);
-   if (result != VK_SUCCESS) {
-      tu_bo_finish(cs->device, new_bo);
-      return result;
-   }
+      result = tu_bo_map(cs->device, bo, NULL);
+      if (result != VK_SUCCESS) {
+         tu_bo_finish(cs->device, bo);
+         return result;
+      }
 
-   TU_RMV(cmd_buffer_bo_create, cs->device, new_bo);
+      TU_RMV(cmd_buffer_bo_create, cs->device, bo);
+
+      new_bo = (struct tu_suballoc_bo) {
+         .bo = bo,
+         .iova = bo->iova,
+         .size = (uint32_t) bo->size,
+      };
+   }
 
    bos->bos[bos->bo_count++] = new_bo;
 
-   cs->start = cs->cur = cs->reserved_end = (uint32_t *) new_bo->map;
-   cs->end = cs->start + new_bo->size / sizeof(uint32_t);
+   cs->start = cs->cur = cs->reserved_end =
+      (uint32_t *) tu_suballoc_bo_map(&new_bo);
+   cs->end = cs->start + new_bo.size / sizeof(uint32_t);
 
    return VK_SUCCESS;
 }
@@ -257,6 +297,71 @@ tu_cs_add_entries(struct tu_cs *cs, struct tu_cs *target)
       cs->entries[cs->entry_count++] = target->entries[i];
    }
 
+   cs->has_external_entries |= target->has_external_entries;
+
+   return VK_SUCCESS;
+}
+
+/**
+ * Add an IB entry for command packets that were not emitted through \a cs,
+ * such as commands generated on the GPU.
+ */
+VkResult
+tu_cs_add_external_entry(struct tu_cs *cs, const struct tu_cs_entry *entry)
+{
+   assert(cs->mode == TU_CS_MODE_GROW);
+
+   if (!tu_cs_is_empty(cs))
+      tu_cs_add_entry(cs);
+
+   VkResult result = tu_cs_reserve_entry(cs);
+   if (result != VK_SUCCESS)
+      return result;
+
+   cs->entries[cs->entry_count++] = *entry;
+   cs->has_external_entries = true;
+
+   return VK_SUCCESS;
+}
+
+/**
+ * Get the size in dwords of all the entries of \a cs.
+ */
+uint32_t
+tu_cs_entries_size(const struct tu_cs *cs)
+{
+   uint32_t size = 0;
+
+   for (unsigned i = 0; i < cs->entry_count; i++)
+      size += cs->entries[i].size / sizeof(uint32_t);
+
+   return size;
+}
+
+/**
+ * same behavior as tu_cs_add_entries but copies the command packets, which
+ * avoids the overhead of an IB per entry when the entries are small
+ */
+VkResult
+tu_cs_copy_entries(struct tu_cs *cs, const struct tu_cs *target)
+{
+   assert(cs->mode == TU_CS_MODE_GROW);
+   assert(!target->has_external_entries);
+
+   for (unsigned i = 0; i < target->entry_count; i++) {
+      const struct tu_cs_entry *entry = &target->entries[i];
+      uint32_t size = entry->size / sizeof(uint32_t);
+
+      VkResult result = tu_cs_reserve_space(cs, size);
+      if (result != VK_SUCCESS)
+         return result;
+
+      tu_cs_emit_array(cs,
+                       (const uint32_t *) ((const char *) entry->bo->map +
+                                           entry->offset),
+                       size);
+   }
+
    return VK_SUCCESS;
 }
 
@@ -298,8 +403,9 @@ tu_cs_set_writeable(struct tu_cs *cs, bool writeable)
       old_bos->start = cs->start;
       cs->start = cs->cur = cs->reserved_end = new_bos->start;
       if (new_bos->bo_count) {
-         struct tu_bo *bo = new_bos->bos[new_bos->bo_count - 1];
-         cs->end = (uint32_t *)bo->map + bo->size / sizeof(uint32_t);
+         struct tu_suballoc_bo *bo = &new_bos->bos[new_bos->bo_count - 1];
+         cs->end = (uint32_t *) tu_suballoc_bo_map(bo) +
+                   bo->size / sizeof(uint32_t);
       } else {
          cs->end = NULL;
       }
@@ -500,15 +606,11 @@ tu_cs_reset(struct tu_cs *cs)
       return;
    }
 
-   for (uint32_t i = 0; i + 1 < cs->read_only.bo_count; ++i) {
-      TU_RMV(resource_destroy, cs->device, cs->read_only.bos[i]);
-      tu_bo_finish(cs->device, cs->read_only.bos[i]);
-   }
+   for (uint32_t i = 0; i + 1 < cs->read_only.bo_count; ++i)
+      tu_cs_free_bo(cs, &cs->read_only, &cs->read_only.bos[i]);
 
-   for (uint32_t i = 0; i + 1 < cs->read_write.bo_count; ++i) {
-      TU_RMV(resource_destroy, cs->device, cs->read_write.bos[i]);
-      tu_bo_finish(cs->device, cs->read_write.bos[i]);
-   }
+   for (uint32_t i = 0; i + 1 < cs->read_write.bo_count; ++i)
+      tu_cs_free_bo(cs, &cs->read_write, &cs->read_write.bos[i]);
 
    cs->writeable = false;
 
@@ -516,8 +618,9 @@ tu_cs_reset(struct tu_cs *cs)
       cs->read_only.bos[0] = cs->read_only.bos[cs->read_only.bo_count - 1];
       cs->read_only.bo_count = 1;
 
-      cs->start = cs->cur = cs->reserved_end = (uint32_t *) cs->read_only.bos[0]->map;
-      cs->end = cs->start + cs->read_only.bos[0]->size / sizeof(uint32_t);
+      cs->start = cs->cur = cs->reserved_end =
+         (uint32_t *) tu_suballoc_bo_map(&cs->read_only.bos[0]);
+      cs->end = cs->start + cs->read_only.bos[0].size / sizeof(uint32_t);
    }
 
    if (cs->read_write.bo_count) {
@@ -526,6 +629,7 @@ tu_cs_reset(struct tu_cs *cs)
    }
 
    cs->entry_count = 0;
+   cs->has_external_entries = false;
 }
 
 uint64_t
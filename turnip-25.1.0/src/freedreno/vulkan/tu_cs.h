@@ -11,6 +11,7 @@
 #include "freedreno_pm4.h"
 
 #include "tu_knl.h"
+#include "tu_suballoc.h"
 
 /* For breadcrumbs we may open a network socket based on the envvar,
  * it's not something that should be enabled by default.
@@ -71,8 +72,13 @@ struct tu_draw_state {
    bool writeable;
 };
 
+/* Read-only chunks of up to this size are suballocated from the device's
+ * cs_suballoc, bigger ones and writeable ones get a BO of their own.
+ */
+#define TU_CS_SUBALLOC_MAX_SIZE (32 * 1024)
+
 struct tu_bo_array {
-   struct tu_bo **bos;
+   struct tu_suballoc_bo *bos;
    uint32_t bo_count;
    uint32_t bo_capacity;
    uint32_t *start;
@@ -97,6 +103,11 @@ struct tu_cs
    uint32_t entry_count;
    uint32_t entry_capacity;
 
+   /* Whether any entry was added with tu_cs_add_external_entry, whose
+    * contents may not be written until the GPU runs.
+    */
+   bool has_external_entries;
+
    struct tu_bo_array read_only, read_write;
 
    /* Optional BO that this CS is sub-allocated from for TU_CS_MODE_SUB_STREAM */
@@ -208,6 +219,15 @@ tu_cs_reset(struct tu_cs *cs);
 VkResult
 tu_cs_add_entries(struct tu_cs *cs, struct tu_cs *target);
 
+VkResult
+tu_cs_add_external_entry(struct tu_cs *cs, const struct tu_cs_entry *entry);
+
+uint32_t
+tu_cs_entries_size(const struct tu_cs *cs);
+
+VkResult
+tu_cs_copy_entries(struct tu_cs *cs, const struct tu_cs *target);
+
 /**
  * Get the size of the command packets emitted since the last call to
  * tu_cs_add_entry.
@@ -275,7 +275,7 @@ tu_CreateDescriptorSetLayout(
                               &set_layout->embedded_samplers, set_layout->size,
                               (enum tu_bo_alloc_flags) (TU_BO_ALLOC_ALLOW_DUMP |
                                                         TU_BO_ALLOC_INTERNAL_RESOURCE),
-                              "embedded samplers");
+                              TU_MEM_CATEGORY_DESCRIPTOR, "embedded samplers");
       if (result != VK_SUCCESS) {
          vk_object_free(&device->vk, pAllocator, set_layout);
          return vk_error(device, result);
@@ -563,6 +563,14 @@ tu_DestroyPipelineLayout(VkDevice _device,
 
 #define EMPTY 1
 
+#define TU_DESCRIPTOR_POOL_HEAP_BASE 4096
+
+static bool
+pool_has_heap(const struct tu_descriptor_pool *pool)
+{
+   return !pool->host_memory_base && pool->size;
+}
+
 static VkResult
 tu_descriptor_set_create(struct tu_device *device,
             struct tu_descriptor_pool *pool,
@@ -611,68 +619,42 @@ tu_descriptor_set_create(struct tu_device *device,
       }
    }
 
+   if (!pool->host_memory_base && pool->set_count == pool->max_set_count) {
+      vk_object_free(&device->vk, NULL, set);
+      return vk_error(device, VK_ERROR_OUT_OF_POOL_MEMORY);
+   }
+
    if (layout_size) {
       set->size = layout_size;
 
-      if (!pool->host_memory_base && pool->entry_count == pool->max_entry_count) {
-         vk_object_free(&device->vk, NULL, set);
-         return vk_error(device, VK_ERROR_OUT_OF_POOL_MEMORY);
-      }
+      uint64_t offset;
+      if (pool->host_memory_base) {
+         /* Sets are only freed all at once by resetting the pool, so just
+          * allocate linearly.
+          */
+         if (pool->current_offset + layout_size > pool->size)
+            return vk_error(device, VK_ERROR_OUT_OF_POOL_MEMORY);
 
-      /* try to allocate linearly first, so that we don't spend
-       * time looking for gaps if the app only allocates &
-       * resets via the pool. */
-      if (pool->current_offset + layout_size <= pool->size) {
-         set->mapped_ptr = (uint32_t*)(pool_base(pool) + pool->current_offset);
-         set->va = pool->host_bo ? 0 : pool->bo->iova + pool->current_offset;
-
-         if (!pool->host_memory_base) {
-            pool->entries[pool->entry_count].offset = pool->current_offset;
-            pool->entries[pool->entry_count].size = layout_size;
-            pool->entries[pool->entry_count].set = set;
-            pool->entry_count++;
-         }
+         offset = pool->current_offset;
          pool->current_offset += layout_size;
-      } else if (!pool->host_memory_base) {
-         uint64_t offset = 0;
-         int index;
-
-         for (index = 0; index < pool->entry_count; ++index) {
-            if (pool->entries[index].size == 0)
-               continue;
-
-            if (pool->entries[index].offset - offset >= layout_size)
-               break;
-            offset = pool->entries[index].offset + pool->entries[index].size;
-         }
-
-         if (pool->size - offset < layout_size) {
+      } else {
+         uint64_t addr = pool_has_heap(pool) ?
+            util_vma_heap_alloc(&pool->heap, layout_size, 1) : 0;
+         if (!addr) {
             vk_object_free(&device->vk, NULL, set);
             return vk_error(device, VK_ERROR_OUT_OF_POOL_MEMORY);
          }
 
-         set->mapped_ptr = (uint32_t*)(pool_base(pool) + offset);
-         set->va = pool->host_bo ? 0 : pool->bo->iova + offset;
+         offset = addr - TU_DESCRIPTOR_POOL_HEAP_BASE;
+      }
 
-         memmove(&pool->entries[index + 1], &pool->entries[index],
-            sizeof(pool->entries[0]) * (pool->entry_count - index));
-         pool->entries[index].offset = offset;
-         pool->entries[index].size = layout_size;
-         pool->entries[index].set = set;
-         pool->entry_count++;
-      } else
-         return vk_error(device, VK_ERROR_OUT_OF_POOL_MEMORY);
-   } else if (!pool->host_memory_base) {
-      /* Also keep track of zero sized descriptor sets, such as descriptor
-       * sets with just dynamic descriptors, so that we can free the sets on
-       * vkDestroyDescriptorPool().
-       */
-      pool->entries[pool->entry_count].offset = ~0;
-      pool->entries[pool->entry_count].size = 0;
-      pool->entries[pool->entry_count].set = set;
-      pool->entry_count++;
+      set->mapped_ptr = (uint32_t*)(pool_base(pool) + offset);
+      set->va = pool->host_bo ? 0 : pool->bo->iova + offset;
    }
 
+   if (!pool->host_memory_base)
+      pool->set_count++;
+
    if (layout->has_immutable_samplers) {
       for (unsigned i = 0; i < layout->binding_count; ++i) {
          if (!layout->binding[i].immutable_samplers_offset)
@@ -708,23 +690,13 @@ tu_descriptor_set_destroy(struct tu_device *device,
 {
    assert(!pool->host_memory_base);
 
-   if (free_bo && !pool->host_memory_base) {
-      for (int i = 0; i < pool->entry_count; ++i) {
-         if (pool->entries[i].set == set) {
-            if (set->size) {
-               ASSERTED uint32_t offset =
-                  (uint8_t *) set->mapped_ptr - pool_base(pool);
-               assert(pool->entries[i].offset == offset);
-            } else {
-               assert(pool->entries[i].size == 0);
-            }
-
-            memmove(&pool->entries[i], &pool->entries[i+1],
-               sizeof(pool->entries[i]) * (pool->entry_count - i - 1));
-            --pool->entry_count;
-            break;
-         }
+   if (free_bo) {
+      if (set->size) {
+         uint64_t offset = (uint8_t*)set->mapped_ptr - pool_base(pool);
+         util_vma_heap_free(&pool->heap,
+                            offset + TU_DESCRIPTOR_POOL_HEAP_BASE, set->size);
       }
+      pool->set_count--;
    }
 
    vk_object_free(&device->vk, NULL, set);
@@ -795,8 +767,6 @@ tu_CreateDescriptorPool(VkDevice _device,
       uint64_t host_size = pCreateInfo->maxSets * sizeof(struct tu_descriptor_set);
       host_size += dynamic_size;
       size += host_size;
-   } else {
-      size += sizeof(struct tu_descriptor_pool_entry) * pCreateInfo->maxSets;
    }
 
    pool = (struct tu_descriptor_pool *) vk_object_zalloc(
@@ -813,7 +783,8 @@ tu_CreateDescriptorPool(VkDevice _device,
    if (bo_size) {
       if (!(pCreateInfo->flags & VK_DESCRIPTOR_POOL_CREATE_HOST_ONLY_BIT_EXT)) {
          ret = tu_bo_init_new(device, &pool->base, &pool->bo, bo_size,
-                              TU_BO_ALLOC_ALLOW_DUMP, "descriptor pool");
+                              TU_BO_ALLOC_ALLOW_DUMP,
+                              TU_MEM_CATEGORY_DESCRIPTOR, "descriptor pool");
          if (ret)
             goto fail_alloc;
 
@@ -831,7 +802,12 @@ tu_CreateDescriptorPool(VkDevice _device,
       }
    }
    pool->size = bo_size;
-   pool->max_entry_count = pCreateInfo->maxSets;
+   pool->max_set_count = pCreateInfo->maxSets;
+
+   if (pool_has_heap(pool)) {
+      util_vma_heap_init(&pool->heap, TU_DESCRIPTOR_POOL_HEAP_BASE, bo_size);
+      pool->heap.alloc_high = false;
+   }
 
    list_inithead(&pool->desc_sets);
 
@@ -863,13 +839,12 @@ tu_DestroyDescriptorPool(VkDevice _device,
    list_for_each_entry_safe(struct tu_descriptor_set, set,
                             &pool->desc_sets, pool_link) {
       vk_descriptor_set_layout_unref(&device->vk, &set->layout->vk);
+      if (!pool->host_memory_base)
+         tu_descriptor_set_destroy(device, pool, set, false);
    }
 
-   if (!pool->host_memory_base) {
-      for(int i = 0; i < pool->entry_count; ++i) {
-         tu_descriptor_set_destroy(device, pool, pool->entries[i].set, false);
-      }
-   }
+   if (pool_has_heap(pool))
+      util_vma_heap_finish(&pool->heap);
 
    if (pool->size) {
       if (pool->host_bo)
@@ -892,15 +867,17 @@ tu_ResetDescriptorPool(VkDevice _device,
    list_for_each_entry_safe(struct tu_descriptor_set, set,
                             &pool->desc_sets, pool_link) {
       vk_descriptor_set_layout_unref(&device->vk, &set->layout->vk);
+      if (!pool->host_memory_base)
+         tu_descriptor_set_destroy(device, pool, set, false);
    }
    list_inithead(&pool->desc_sets);
 
-   if (!pool->host_memory_base) {
-      for(int i = 0; i < pool->entry_count; ++i) {
-         tu_descriptor_set_destroy(device, pool, pool->entries[i].set, false);
-      }
-      pool->entry_count = 0;
+   if (pool_has_heap(pool)) {
+      util_vma_heap_finish(&pool->heap);
+      util_vma_heap_init(&pool->heap, TU_DESCRIPTOR_POOL_HEAP_BASE, pool->size);
+      pool->heap.alloc_high = false;
    }
+   pool->set_count = 0;
 
    pool->current_offset = 0;
    pool->host_memory_ptr = pool->host_memory_base;
@@ -1593,7 +1570,7 @@ tu_CreateDescriptorUpdateTemplate(
       dst_offset += (binding_layout->size * entry->dstArrayElement) / 4;
       dst_stride = binding_layout->size / 4;
 
-      templ->entry[j++] = (struct tu_descriptor_update_template_entry) {
+      struct tu_descriptor_update_template_entry new_entry = {
          .descriptor_type = entry->descriptorType,
          .descriptor_count = entry->descriptorCount,
          .dst_offset = dst_offset,
@@ -1603,9 +1580,33 @@ tu_CreateDescriptorUpdateTemplate(
          .src_stride = entry->stride,
          .immutable_samplers = immutable_samplers,
       };
+
+      /* Apps commonly use one template entry per binding. When the previous
+       * entry continues into this one on both sides with the same strides,
+       * extend it instead so the update loop runs once for both.
+       */
+      if (j > 0) {
+         struct tu_descriptor_update_template_entry *prev = &templ->entry[j - 1];
+         if (prev->descriptor_type == new_entry.descriptor_type &&
+             prev->descriptor_type != VK_DESCRIPTOR_TYPE_INLINE_UNIFORM_BLOCK &&
+             prev->has_sampler == new_entry.has_sampler &&
+             !prev->immutable_samplers && !new_entry.immutable_samplers &&
+             prev->dst_stride == new_entry.dst_stride &&
+             prev->src_stride == new_entry.src_stride &&
+             prev->dst_offset + prev->descriptor_count * prev->dst_stride ==
+                new_entry.dst_offset &&
+             prev->src_offset + prev->descriptor_count * prev->src_stride ==
+                new_entry.src_offset) {
+            prev->descriptor_count += new_entry.descriptor_count;
+            continue;
+         }
+      }
+
+      templ->entry[j++] = new_entry;
    }
 
-   assert(j == dst_entry_count);
+   assert(j <= dst_entry_count);
+   templ->entry_count = j;
 
    *pDescriptorUpdateTemplate =
       tu_descriptor_update_template_to_handle(templ);
@@ -1650,56 +1651,82 @@ tu_update_descriptor_set_with_template(
          continue;
       }
 
-      ptr += templ->entry[i].dst_offset;
-      unsigned dst_offset = templ->entry[i].dst_offset;
-      for (unsigned j = 0; j < templ->entry[i].descriptor_count; ++j) {
-         switch(templ->entry[i].descriptor_type) {
-         case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC: {
-            assert(!(set->layout->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR));
-            write_ubo_descriptor(set->dynamic_descriptors + dst_offset,
-                                 (const VkDescriptorBufferInfo *) src);
-            break;
-         }
-         case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+      const struct tu_descriptor_update_template_entry *entry =
+         &templ->entry[i];
+      const uint32_t count = entry->descriptor_count;
+      const uint32_t src_stride = entry->src_stride;
+      const uint32_t dst_stride = entry->dst_stride;
+      ptr += entry->dst_offset;
+
+      /* Dispatch on the type once per entry rather than per descriptor, so
+       * that large entries run a tight loop of the one write helper.
+       */
+      switch (entry->descriptor_type) {
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+         assert(!(set->layout->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR));
+         ptr = set->dynamic_descriptors + entry->dst_offset;
+         FALLTHROUGH;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+         for (unsigned j = 0; j < count; j++) {
             write_ubo_descriptor(ptr, (const VkDescriptorBufferInfo *) src);
-            break;
-         case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC: {
-            assert(!(set->layout->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR));
-            write_buffer_descriptor(device,
-                                    set->dynamic_descriptors + dst_offset,
-                                    (const VkDescriptorBufferInfo *) src);
-            break;
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
          }
-         case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+         break;
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+         assert(!(set->layout->flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR));
+         ptr = set->dynamic_descriptors + entry->dst_offset;
+         FALLTHROUGH;
+      case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+         for (unsigned j = 0; j < count; j++) {
             write_buffer_descriptor(device, ptr,
                                     (const VkDescriptorBufferInfo *) src);
-            break;
-         case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
-         case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
-            write_texel_buffer_descriptor(ptr, *(VkBufferView *) src);
-            break;
-         case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
-         case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
-         case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT: {
-            write_image_descriptor(ptr, templ->entry[i].descriptor_type,
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
+         }
+         break;
+      case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+      case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+         for (unsigned j = 0; j < count; j++) {
+            write_texel_buffer_descriptor(ptr, *(const VkBufferView *) src);
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
+         }
+         break;
+      case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+      case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+      case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+         for (unsigned j = 0; j < count; j++) {
+            write_image_descriptor(ptr, entry->descriptor_type,
                                    (const VkDescriptorImageInfo *) src);
-            break;
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
          }
-         case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+         break;
+      case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+         for (unsigned j = 0; j < count; j++) {
             write_combined_image_sampler_descriptor(ptr,
-                                                    templ->entry[i].descriptor_type,
+                                                    entry->descriptor_type,
                                                     (const VkDescriptorImageInfo *) src,
-                                                    templ->entry[i].has_sampler);
+                                                    entry->has_sampler);
             if (samplers)
                write_sampler_push(ptr + A6XX_TEX_CONST_DWORDS, &samplers[j]);
-            break;
-         case VK_DESCRIPTOR_TYPE_SAMPLER:
-            if (templ->entry[i].has_sampler)
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
+         }
+         break;
+      case VK_DESCRIPTOR_TYPE_SAMPLER:
+         for (unsigned j = 0; j < count; j++) {
+            if (entry->has_sampler)
                write_sampler_descriptor(ptr, ((const VkDescriptorImageInfo *)src)->sampler);
             else if (samplers)
                write_sampler_push(ptr, &samplers[j]);
-            break;
-         case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR: {
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
+         }
+         break;
+      case VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR:
+         for (unsigned j = 0; j < count; j++) {
             VK_FROM_HANDLE(vk_acceleration_structure, accel_struct, *(const VkAccelerationStructureKHR *)src);
             if (accel_struct) {
                write_accel_struct(ptr,
@@ -1709,15 +1736,13 @@ tu_update_descriptor_set_with_template(
                write_accel_struct(ptr, device->null_accel_struct_bo->iova,
                                   device->null_accel_struct_bo->size);
             }
-            break;
-         }
-         default:
-            unreachable("unimplemented descriptor type");
-            break;
+            src = (const char *) src + src_stride;
+            ptr += dst_stride;
          }
-         src = (char *) src + templ->entry[i].src_stride;
-         ptr += templ->entry[i].dst_stride;
-         dst_offset += templ->entry[i].dst_stride;
+         break;
+      default:
+         unreachable("unimplemented descriptor type");
+         break;
       }
    }
 }
@@ -8,6 +8,7 @@
 
 #include "tu_common.h"
 
+#include "util/vma.h"
 #include "vk_descriptor_set_layout.h"
 
 #include "tu_sampler.h"
@@ -127,18 +128,16 @@ struct tu_descriptor_set
    /* Size of the host memory allocation for push descriptors */
    uint32_t host_size;
 
+   /* For push descriptors, what was last copied to the GPU memory at va.
+    * Lives in the same allocation as mapped_ptr.
+    */
+   uint32_t *pushed_ptr;
+
    uint32_t *dynamic_descriptors;
 };
 VK_DEFINE_NONDISP_HANDLE_CASTS(tu_descriptor_set, base, VkDescriptorSet,
                                VK_OBJECT_TYPE_DESCRIPTOR_SET)
 
-struct tu_descriptor_pool_entry
-{
-   uint32_t offset;
-   uint32_t size;
-   struct tu_descriptor_set *set;
-};
-
 struct tu_descriptor_pool
 {
    struct vk_object_base base;
@@ -154,9 +153,13 @@ struct tu_descriptor_pool
 
    struct list_head desc_sets;
 
-   uint32_t entry_count;
-   uint32_t max_entry_count;
-   struct tu_descriptor_pool_entry entries[0];
+   /* Descriptor memory of pools which can free individual sets, offset by
+    * TU_DESCRIPTOR_POOL_HEAP_BASE since util_vma_heap can't hand out 0.
+    */
+   struct util_vma_heap heap;
+
+   uint32_t set_count;
+   uint32_t max_set_count;
 };
 VK_DEFINE_NONDISP_HANDLE_CASTS(tu_descriptor_pool, base, VkDescriptorPool,
                                VK_OBJECT_TYPE_DESCRIPTOR_POOL)
@@ -20,6 +20,8 @@
 #include "util/hex.h"
 #include "util/driconf.h"
 #include "util/os_misc.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_process.h"
 #include "vk_android.h"
 #include "vk_shader_module.h"
@@ -38,9 +40,11 @@
 #include "tu_dynamic_rendering.h"
 #include "tu_image.h"
 #include "tu_pass.h"
+#include "tu_perfcntr_sampler.h"
 #include "tu_queue.h"
 #include "tu_query_pool.h"
 #include "tu_rmv.h"
+#include "tu_rp_log.h"
 #include "tu_tracepoints.h"
 #include "tu_wsi.h"
 
@@ -266,6 +270,8 @@ get_device_extensions(const struct tu_physical_device *device,
       .EXT_descriptor_buffer = true,
       .EXT_descriptor_indexing = true,
       .EXT_device_address_binding_report = true,
+      /* not validated on hardware yet, opt-in with TU_DEBUG=dgc */
+      .EXT_device_generated_commands = TU_DEBUG(DGC),
 #ifdef VK_USE_PLATFORM_DISPLAY_KHR
       .EXT_display_control = true,
 #endif
@@ -315,6 +321,7 @@ get_device_extensions(const struct tu_physical_device *device,
       .EXT_separate_stencil_usage = true,
       .EXT_shader_demote_to_helper_invocation = true,
       .EXT_shader_module_identifier = true,
+      .EXT_shader_object = true,
       .EXT_shader_replicated_composites = true,
       .EXT_shader_stencil_export = true,
       .EXT_shader_viewport_index_layer = TU_DEBUG(NOCONFORM) ? true : device->info->a6xx.has_hw_multiview,
@@ -607,6 +614,10 @@ tu_get_features(struct tu_physical_device *pdevice,
    /* VK_EXT_device_address_binding_report */
    features->reportAddressBinding = true;
 
+   /* VK_EXT_device_generated_commands */
+   features->deviceGeneratedCommands = TU_DEBUG(DGC);
+   features->dynamicGeneratedPipelineLayout = TU_DEBUG(DGC);
+
    /* VK_EXT_extended_dynamic_state */
    features->extendedDynamicState = true;
 
@@ -731,6 +742,9 @@ tu_get_features(struct tu_physical_device *pdevice,
    /* VK_EXT_shader_module_identifier */
    features->shaderModuleIdentifier = true;
 
+   /* VK_EXT_shader_object */
+   features->shaderObject = true;
+
    /* VK_EXT_shader_replicated_composites */
    features->shaderReplicatedComposites = true;
 
@@ -1219,6 +1233,10 @@ tu_get_properties(struct tu_physical_device *pdevice,
           vk_shaderModuleIdentifierAlgorithmUUID,
           sizeof(props->shaderModuleIdentifierAlgorithmUUID));
 
+   /* VK_EXT_shader_object */
+   memcpy(props->shaderBinaryUUID, pdevice->cache_uuid, VK_UUID_SIZE);
+   props->shaderBinaryVersion = 1;
+
    /* VK_EXT_map_memory_placed */
    os_get_page_size(&os_page_size);
    props->minPlacedMemoryMapAlignment = os_page_size;
@@ -1276,6 +1294,24 @@ tu_get_properties(struct tu_physical_device *pdevice,
    props->descriptorBufferAddressSpaceSize = ~0ull;
    props->combinedImageSamplerDensityMapDescriptorSize = 2 * A6XX_TEX_CONST_DWORDS * 4;
 
+   /* VK_EXT_device_generated_commands */
+   props->maxIndirectPipelineCount = 4096;
+   props->maxIndirectShaderObjectCount = 0;
+   props->maxIndirectSequenceCount = 1 << 20;
+   props->maxIndirectCommandsTokenCount = 128;
+   props->maxIndirectCommandsTokenOffset = 2047;
+   props->maxIndirectCommandsIndirectStride = 2048;
+   props->supportedIndirectCommandsInputModes =
+      VK_INDIRECT_COMMANDS_INPUT_MODE_VULKAN_INDEX_BUFFER_EXT |
+      VK_INDIRECT_COMMANDS_INPUT_MODE_DXGI_INDEX_BUFFER_EXT;
+   props->supportedIndirectCommandsShaderStages =
+      VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+   props->supportedIndirectCommandsShaderStagesPipelineBinding =
+      VK_SHADER_STAGE_COMPUTE_BIT;
+   props->supportedIndirectCommandsShaderStagesShaderBinding = 0;
+   props->deviceGeneratedCommandsTransformFeedback = false;
+   props->deviceGeneratedCommandsMultiDrawIndirectCount = true;
+
    /* VK_EXT_legacy_vertex_attributes */
    props->nativeUnalignedPerformance = true;
 
@@ -1534,6 +1570,17 @@ tu_physical_device_init(struct tu_physical_device *device,
       device->memory.type_count++;
    }
 
+   /* Transient attachments that never leave GMEM only get backed if the
+    * render pass ends up using sysmem, see tu_cmd_render().
+    */
+   if (device->has_lazy_memory) {
+      device->memory.lazy_type_mask = 1 << device->memory.type_count;
+      device->memory.types[device->memory.type_count] =
+         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+         VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+      device->memory.type_count++;
+   }
+
    /* Provide fallback UBWC config values if the kernel doesn't support
     * providing them. This should match what the kernel programs.
     */
@@ -1628,6 +1675,8 @@ static const driOptionDescription tu_dri_options[] = {
       DRI_CONF_VK_X11_STRICT_IMAGE_COUNT(false)
       DRI_CONF_VK_X11_ENSURE_MIN_IMAGE_COUNT(false)
       DRI_CONF_VK_XWAYLAND_WAIT_READY(false)
+      DRI_CONF_VK_X11_USE_HWBUF(false)
+      DRI_CONF_TU_OVERRIDE_HEAP_SIZE(0)
    DRI_CONF_SECTION_END
 
    DRI_CONF_SECTION_DEBUG
@@ -1667,6 +1716,10 @@ tu_init_dri_options(struct tu_instance *instance)
          driQueryOptionb(&instance->dri_options, "tu_disable_d24s8_border_color_workaround");
    instance->use_tex_coord_round_nearest_even_mode =
          driQueryOptionb(&instance->dri_options, "tu_use_tex_coord_round_nearest_even_mode");
+   /* the environment overrides the application profile */
+   instance->override_heap_size =
+         debug_get_num_option("TU_OVERRIDE_HEAP_SIZE",
+                              driQueryOptioni(&instance->dri_options, "tu_override_heap_size"));
 }
 
 static uint32_t instance_count = 0;
@@ -1749,14 +1802,37 @@ tu_DestroyInstance(VkInstance _instance,
    vk_free(&instance->vk.alloc, instance);
 }
 
-static const VkQueueFamilyProperties tu_queue_family_properties = {
-   .queueFlags =
-      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
-   .queueCount = 1,
-   .timestampValidBits = 48,
-   .minImageTransferGranularity = { 1, 1, 1 },
+/* Each queue gets its own submitqueue (a separate context with KGSL), so
+ * work on the compute/transfer queue isn't ordered behind graphics
+ * submissions.
+ */
+static const VkQueueFamilyProperties tu_queue_family_properties[TU_MAX_QUEUE_FAMILIES] = {
+   /* TU_QUEUE_GENERAL */
+   {
+      .queueFlags =
+         VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+      .queueCount = 1,
+      .timestampValidBits = 48,
+      .minImageTransferGranularity = { 1, 1, 1 },
+   },
+   /* TU_QUEUE_COMPUTE */
+   {
+      .queueFlags = VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT,
+      .queueCount = 1,
+      .timestampValidBits = 48,
+      .minImageTransferGranularity = { 1, 1, 1 },
+   },
 };
 
+static uint32_t
+tu_physical_device_queue_family_count(const struct tu_physical_device *pdevice)
+{
+   /* Zombie VMAs are retired against the fence of the general queue, which
+    * only orders them against work from that queue.
+    */
+   return pdevice->has_set_iova ? 1 : TU_MAX_QUEUE_FAMILIES;
+}
+
 void
 tu_physical_device_get_global_priority_properties(const struct tu_physical_device *pdevice,
                                                   VkQueueFamilyGlobalPriorityPropertiesKHR *props)
@@ -1792,20 +1868,22 @@ tu_GetPhysicalDeviceQueueFamilyProperties2(
    VK_OUTARRAY_MAKE_TYPED(VkQueueFamilyProperties2, out,
                           pQueueFamilyProperties, pQueueFamilyPropertyCount);
 
-   vk_outarray_append_typed(VkQueueFamilyProperties2, &out, p)
-   {
-      p->queueFamilyProperties = tu_queue_family_properties;
-
-      vk_foreach_struct(ext, p->pNext) {
-         switch (ext->sType) {
-         case VK_STRUCTURE_TYPE_QUEUE_FAMILY_GLOBAL_PRIORITY_PROPERTIES_KHR: {
-            VkQueueFamilyGlobalPriorityPropertiesKHR *props =
-               (VkQueueFamilyGlobalPriorityPropertiesKHR *) ext;
-            tu_physical_device_get_global_priority_properties(pdevice, props);
-            break;
-         }
-         default:
-            break;
+   for (unsigned i = 0; i < tu_physical_device_queue_family_count(pdevice); i++) {
+      vk_outarray_append_typed(VkQueueFamilyProperties2, &out, p)
+      {
+         p->queueFamilyProperties = tu_queue_family_properties[i];
+
+         vk_foreach_struct(ext, p->pNext) {
+            switch (ext->sType) {
+            case VK_STRUCTURE_TYPE_QUEUE_FAMILY_GLOBAL_PRIORITY_PROPERTIES_KHR: {
+               VkQueueFamilyGlobalPriorityPropertiesKHR *props =
+                  (VkQueueFamilyGlobalPriorityPropertiesKHR *) ext;
+               tu_physical_device_get_global_priority_properties(pdevice, props);
+               break;
+            }
+            default:
+               break;
+            }
          }
       }
    }
@@ -1815,12 +1893,9 @@ uint64_t
 tu_get_system_heap_size(struct tu_physical_device *physical_device)
 {
    uint64_t available_ram;
-   const char* override_heap_size = getenv("TU_OVERRIDE_HEAP_SIZE");
-   if (override_heap_size) {
-      available_ram = (uint64_t) strtol(override_heap_size, NULL, 10) << 20;
-      return available_ram;
-   }
-    
+   if (physical_device->instance->override_heap_size)
+      return physical_device->instance->override_heap_size << 20;
+
    uint64_t total_ram = 0;
    ASSERTED bool has_physical_memory =
       os_get_total_physical_memory(&total_ram);
@@ -1840,16 +1915,51 @@ tu_get_system_heap_size(struct tu_physical_device *physical_device)
    return available_ram;
 }
 
-static VkDeviceSize
-tu_get_budget_memory(struct tu_physical_device *physical_device)
+/* How long a sample of available system memory is reused for the budget.
+ * Apps like DXVK query the budget every frame, and each sample parses
+ * /proc/meminfo.
+ */
+#define TU_BUDGET_REFRESH_NS (100 * 1000 * 1000)
+
+static uint64_t
+tu_get_sys_available_memory(struct tu_memory_heap *heap)
 {
-   uint64_t heap_size = physical_device->heap.size;
-   uint64_t heap_used = physical_device->heap.used;
+   int64_t now = os_time_get_nano();
+   uint64_t cached = p_atomic_read(&heap->sys_available);
+   int64_t cached_time = p_atomic_read(&heap->sys_available_time);
+
+   if (cached_time && now - cached_time < TU_BUDGET_REFRESH_NS)
+      return cached;
+
    uint64_t sys_available;
    ASSERTED bool has_available_memory =
       os_get_available_system_memory(&sys_available);
    assert(has_available_memory);
 
+   /* Take decreases right away, but ignore small increases, so that the
+    * budget doesn't keep nudging the app into reallocating because of
+    * page cache noise.
+    */
+   if (cached_time && sys_available > cached &&
+       sys_available - cached < cached / 16)
+      sys_available = cached;
+
+   /* Racing threads may both sample; either result is fine. */
+   p_atomic_set(&heap->sys_available, sys_available);
+   p_atomic_set(&heap->sys_available_time, now);
+
+   return sys_available;
+}
+
+static VkDeviceSize
+tu_get_budget_memory(struct tu_physical_device *physical_device)
+{
+   uint64_t heap_size = physical_device->heap.size;
+   uint64_t heap_used = p_atomic_read(&physical_device->heap.used) +
+                        p_atomic_read(&physical_device->heap.internal_used);
+   uint64_t sys_available =
+      tu_get_sys_available_memory(&physical_device->heap);
+
    if (physical_device->va_size)
       sys_available = MIN2(sys_available, physical_device->va_size);
 
@@ -1886,7 +1996,9 @@ tu_GetPhysicalDeviceMemoryProperties2(VkPhysicalDevice pdev,
       case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT: {
          VkPhysicalDeviceMemoryBudgetPropertiesEXT *memory_budget_props =
             (VkPhysicalDeviceMemoryBudgetPropertiesEXT *) ext;
-         memory_budget_props->heapUsage[0] = physical_device->heap.used;
+         memory_budget_props->heapUsage[0] =
+            p_atomic_read(&physical_device->heap.used) +
+            p_atomic_read(&physical_device->heap.internal_used);
          memory_budget_props->heapBudget[0] = tu_get_budget_memory(physical_device);
 
          /* The heapBudget and heapUsage values must be zero for array elements
@@ -1960,7 +2072,8 @@ tu_trace_create_buffer(struct u_trace_context *utctx, uint64_t size_B)
       container_of(utctx, struct tu_device, trace_context);
 
    struct tu_bo *bo;
-   tu_bo_init_new(device, NULL, &bo, size_B, TU_BO_ALLOC_INTERNAL_RESOURCE, "trace");
+   tu_bo_init_new(device, NULL, &bo, size_B, TU_BO_ALLOC_INTERNAL_RESOURCE,
+                  TU_MEM_CATEGORY_INTERNAL, "trace");
    tu_bo_map(device, bo, NULL);
 
    return bo;
@@ -2532,6 +2645,7 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
    mtx_init(&device->autotune_mutex, mtx_plain);
    mtx_init(&device->kgsl_profiling_mutex, mtx_plain);
    mtx_init(&device->event_mutex, mtx_plain);
+   mtx_init(&device->cs_mutex, mtx_plain);
    u_rwlock_init(&device->dma_bo_lock);
    pthread_mutex_init(&device->submit_mutex, NULL);
 
@@ -2543,6 +2657,7 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
 
    if (TU_DEBUG(BOS))
       device->bo_sizes = _mesa_hash_table_create(NULL, _mesa_hash_string, _mesa_key_string_equal);
+   tu_mem_stats_init(device);
 
    if (physical_device->instance->vk.trace_mode & VK_TRACE_MODE_RMV)
       tu_memory_trace_init(device);
@@ -2592,6 +2707,9 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
 
    mtx_init(&device->radix_sort_mutex, mtx_plain);
 
+   list_inithead(&device->dgc_buffers);
+   mtx_init(&device->dgc_buffers_mutex, mtx_plain);
+
    {
       struct ir3_compiler_options ir3_options = {
          .push_ubo_with_preamble = true,
@@ -2617,7 +2735,10 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
    util_sparse_array_init(&device->bo_map, sizeof(struct tu_bo), 512);
 
    if (physical_device->has_set_iova) {
-      STATIC_ASSERT(TU_MAX_QUEUE_FAMILIES == 1);
+      /* Only the general queue family is exposed, see
+       * tu_physical_device_queue_family_count().
+       */
+      assert(device->queue_count[TU_QUEUE_COMPUTE] == 0);
       if (!u_vector_init(&device->zombie_vmas, 64,
                          sizeof(struct tu_zombie_vma))) {
          result = vk_startup_errorf(physical_device->instance,
@@ -2639,25 +2760,33 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
       (enum tu_bo_alloc_flags) (TU_BO_ALLOC_GPU_READ_ONLY |
                                 TU_BO_ALLOC_ALLOW_DUMP |
                                 TU_BO_ALLOC_INTERNAL_RESOURCE),
-      "pipeline_suballoc");
+      TU_MEM_CATEGORY_PIPELINE, "pipeline_suballoc");
    tu_bo_suballocator_init(&device->autotune_suballoc, device,
                            128 * 1024, TU_BO_ALLOC_INTERNAL_RESOURCE,
-                           "autotune_suballoc");
+                           TU_MEM_CATEGORY_INTERNAL, "autotune_suballoc");
    if (is_kgsl(physical_device->instance)) {
       tu_bo_suballocator_init(&device->kgsl_profiling_suballoc, device,
                               128 * 1024, TU_BO_ALLOC_INTERNAL_RESOURCE,
+                              TU_MEM_CATEGORY_INTERNAL,
                               "kgsl_profiling_suballoc");
    }
 
    tu_bo_suballocator_init(&device->event_suballoc, device,
       getpagesize(), TU_BO_ALLOC_INTERNAL_RESOURCE,
-      "event_suballoc");
+      TU_MEM_CATEGORY_QUERY, "event_suballoc");
+
+   tu_bo_suballocator_init(
+      &device->cs_suballoc, device, 256 * 1024,
+      (enum tu_bo_alloc_flags) (TU_BO_ALLOC_GPU_READ_ONLY |
+                                TU_BO_ALLOC_ALLOW_DUMP |
+                                TU_BO_ALLOC_INTERNAL_RESOURCE),
+      TU_MEM_CATEGORY_CMDSTREAM, "cs_suballoc");
 
    result = tu_bo_init_new(
       device, NULL, &device->global_bo, global_size,
       (enum tu_bo_alloc_flags) (TU_BO_ALLOC_ALLOW_DUMP |
                                 TU_BO_ALLOC_INTERNAL_RESOURCE),
-      "global");
+      TU_MEM_CATEGORY_INTERNAL, "global");
    if (result != VK_SUCCESS) {
       vk_startup_errorf(device->instance, result, "BO init");
       goto fail_global_bo;
@@ -2718,6 +2847,17 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
       goto fail_pipeline_cache;
    }
 
+   /* The calling thread compiles one of the stages itself, so one thread
+    * less than the CPU count is enough. If this fails pipelines are just
+    * compiled serially.
+    */
+   if (util_get_cpu_caps()->nr_cpus > 1) {
+      util_queue_init(&device->compile_queue, "tu_compile", 64,
+                      MIN2(util_get_cpu_caps()->nr_cpus - 1,
+                           MESA_SHADER_STAGES - 1),
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+
    tu_cs_init(&device->sub_cs, device, TU_CS_MODE_SUB_STREAM, 1024, "device sub cs");
 
    if (device->vk.enabled_features.performanceCounterQueryPools) {
@@ -2822,6 +2962,8 @@ tu_CreateDevice(VkPhysicalDevice physicalDevice,
                      tu_trace_delete_flush_data);
 
    tu_breadcrumbs_init(device);
+   tu_perfcntr_sampler_init(device);
+   tu_rp_log_init(device);
 
    if (FD_RD_DUMP(ENABLE)) {
       struct vk_app_info *app_info = &device->instance->vk.app_info;
@@ -2859,6 +3001,9 @@ fail_prepare_perfcntrs_pass_cs:
    free(device->perfcntrs_pass_cs_entries);
 fail_perfcntrs_pass_entries_alloc:
    tu_cs_finish(&device->sub_cs);
+   tu_bo_suballocator_finish(&device->cs_suballoc);
+   if (util_queue_is_initialized(&device->compile_queue))
+      util_queue_destroy(&device->compile_queue);
    vk_pipeline_cache_destroy(device->mem_cache, &device->vk.alloc);
 fail_pipeline_cache:
    tu_destroy_dynamic_rendering(device);
@@ -2912,6 +3057,10 @@ tu_DestroyDevice(VkDevice _device, const VkAllocationCallbacks *pAllocator)
    if (FD_RD_DUMP(ENABLE))
       fd_rd_output_fini(&device->rd_output);
 
+   if (device->mem_stats.dump)
+      tu_mem_stats_dump(device);
+   tu_rp_log_finish(device);
+   tu_perfcntr_sampler_finish(device);
    tu_breadcrumbs_finish(device);
 
    u_trace_context_fini(&device->trace_context);
@@ -2937,6 +3086,9 @@ tu_DestroyDevice(VkDevice _device, const VkAllocationCallbacks *pAllocator)
 
    util_sparse_array_finish(&device->accel_struct_ranges);
 
+   if (util_queue_is_initialized(&device->compile_queue))
+      util_queue_destroy(&device->compile_queue);
+
    ir3_compiler_destroy(device->compiler);
 
    vk_pipeline_cache_destroy(device->mem_cache, &device->vk.alloc);
@@ -2963,6 +3115,7 @@ tu_DestroyDevice(VkDevice _device, const VkAllocationCallbacks *pAllocator)
    tu_bo_suballocator_finish(&device->autotune_suballoc);
    tu_bo_suballocator_finish(&device->kgsl_profiling_suballoc);
    tu_bo_suballocator_finish(&device->event_suballoc);
+   tu_bo_suballocator_finish(&device->cs_suballoc);
 
    tu_bo_finish(device, device->global_bo);
 
@@ -3026,7 +3179,8 @@ tu_get_scratch_bo(struct tu_device *dev, uint64_t size, struct tu_bo **bo)
 
    unsigned bo_size = 1ull << size_log2;
    VkResult result = tu_bo_init_new(dev, NULL, &dev->scratch_bos[index].bo, bo_size,
-                                    TU_BO_ALLOC_INTERNAL_RESOURCE, "scratch");
+                                    TU_BO_ALLOC_INTERNAL_RESOURCE,
+                                    TU_MEM_CATEGORY_SCRATCH, "scratch");
    if (result != VK_SUCCESS) {
       mtx_unlock(&dev->scratch_bos[index].construct_mtx);
       return result;
@@ -3171,12 +3325,16 @@ tu_AllocateMemory(VkDevice _device,
                   (long)DIV_ROUND_UP(pAllocateInfo->allocationSize, 1024));
       VkMemoryPropertyFlags mem_property =
          device->physical_device->memory.types[pAllocateInfo->memoryTypeIndex];
+      if (mem_property & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+         alloc_flags |= TU_BO_ALLOC_LAZY;
       result = tu_bo_init_new_explicit_iova(
          device, &mem->vk.base, &mem->bo, pAllocateInfo->allocationSize,
-         client_address, mem_property, alloc_flags, name);
+         client_address, mem_property, alloc_flags,
+         TU_MEM_CATEGORY_DEVICE_MEMORY, name);
    }
 
-   if (result == VK_SUCCESS) {
+   /* lazy BOs are accounted for in tu_bo_commit() */
+   if (result == VK_SUCCESS && !mem->bo->lazy) {
       mem_heap_used = p_atomic_add_return(&mem_heap->used, mem->bo->size);
       if (mem_heap_used > mem_heap->size) {
          p_atomic_add(&mem_heap->used, -mem->bo->size);
@@ -3233,7 +3391,8 @@ tu_FreeMemory(VkDevice _device,
 
    TU_RMV(resource_destroy, device, mem);
 
-   p_atomic_add(&device->physical_device->heap.used, -mem->bo->size);
+   if (!mem->bo->lazy || mem->bo->committed)
+      p_atomic_add(&device->physical_device->heap.used, -mem->bo->size);
    tu_bo_finish(device, mem->bo);
    vk_device_memory_destroy(&device->vk, pAllocator, &mem->vk);
 }
@@ -3320,10 +3479,13 @@ tu_InvalidateMappedMemoryRanges(VkDevice _device,
 
 VKAPI_ATTR void VKAPI_CALL
 tu_GetDeviceMemoryCommitment(VkDevice device,
-                             VkDeviceMemory memory,
+                             VkDeviceMemory _memory,
                              VkDeviceSize *pCommittedMemoryInBytes)
 {
-   *pCommittedMemoryInBytes = 0;
+   VK_FROM_HANDLE(tu_device_memory, mem, _memory);
+
+   *pCommittedMemoryInBytes =
+      p_atomic_read(&mem->bo->committed) ? mem->bo->size : 0;
 }
 
 VKAPI_ATTR VkResult VKAPI_CALL
@@ -3463,7 +3625,8 @@ tu_GetMemoryFdPropertiesKHR(VkDevice _device,
    VK_FROM_HANDLE(tu_device, device, _device);
    assert(handleType == VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT);
    pMemoryFdProperties->memoryTypeBits =
-      (1 << device->physical_device->memory.type_count) - 1;
+      ((1 << device->physical_device->memory.type_count) - 1) &
+      ~device->physical_device->memory.lazy_type_mask;
    return VK_SUCCESS;
 }
 
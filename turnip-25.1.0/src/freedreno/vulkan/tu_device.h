@@ -17,6 +17,7 @@
 
 #include "tu_autotune.h"
 #include "tu_cs.h"
+#include "tu_mem_stats.h"
 #include "tu_pass.h"
 #include "tu_perfetto.h"
 #include "tu_suballoc.h"
@@ -25,13 +26,15 @@
 #include "radix_sort/radix_sort_vk.h"
 
 #include "common/freedreno_rd_output.h"
+#include "util/u_queue.h"
 #include "util/vma.h"
 #include "util/u_vector.h"
 
 /* queue types */
 #define TU_QUEUE_GENERAL 0
+#define TU_QUEUE_COMPUTE 1
 
-#define TU_MAX_QUEUE_FAMILIES 1
+#define TU_MAX_QUEUE_FAMILIES 2
 
 #define TU_BORDER_COLOR_COUNT 4096
 #define TU_BORDER_COLOR_BUILTIN 6
@@ -65,6 +68,15 @@ struct tu_memory_heap {
     * Align it to 64 bits to make atomic operations faster on 32 bit platforms.
     */
    alignas(8) VkDeviceSize used;
+
+   /* Driver-internal BOs of all devices, see tu_mem_stats.h */
+   alignas(8) uint64_t internal_used;
+
+   /* Last sample of available system memory used for the budget, and when
+    * it was taken.  See tu_get_budget_memory().
+    */
+   alignas(8) uint64_t sys_available;
+   alignas(8) int64_t sys_available_time;
 };
 
 enum tu_kgsl_dma_type
@@ -128,6 +140,8 @@ struct tu_physical_device
 
    bool has_cached_coherent_memory;
    bool has_cached_non_coherent_memory;
+   /* the backend can reserve an address range and back it later */
+   bool has_lazy_memory;
    uintptr_t level1_dcache_size;
 
    struct fdl_ubwc_config ubwc_config;
@@ -137,6 +151,8 @@ struct tu_physical_device
    struct {
       uint32_t type_count;
       VkMemoryPropertyFlags types[VK_MAX_MEMORY_TYPES];
+      /* LAZILY_ALLOCATED types, only for transient attachments */
+      uint32_t lazy_type_mask;
    } memory;
 
    struct fd_dev_id dev_id;
@@ -209,6 +225,11 @@ struct tu_instance
 
    /* D3D emulation requires texture coordinates to be rounded to nearest even value. */
    bool use_tex_coord_round_nearest_even_mode;
+
+   /* Heap size in MiB from TU_OVERRIDE_HEAP_SIZE or driconf, 0 when it is
+    * derived from the system memory.
+    */
+   uint64_t override_heap_size;
 };
 VK_DEFINE_HANDLE_CASTS(tu_instance, vk.base, VkInstance,
                        VK_OBJECT_TYPE_INSTANCE)
@@ -302,6 +323,10 @@ struct tu_device
 
    struct util_sparse_array accel_struct_ranges;
 
+   /* Bound buffers with VK_BUFFER_USAGE_2_PREPROCESS_BUFFER_BIT_EXT. */
+   struct list_head dgc_buffers;
+   mtx_t dgc_buffers_mutex;
+
 #define MIN_SCRATCH_BO_SIZE_LOG2 12 /* A page */
 
    /* Currently the kernel driver uses a 32-bit GPU address space, but it
@@ -345,6 +370,12 @@ struct tu_device
    struct tu_suballocator event_suballoc;
    mtx_t event_mutex;
 
+   /* Small read-only tu_cs chunks, see TU_CS_SUBALLOC_MAX_SIZE.
+    * Synchronized by cs_mutex.
+    */
+   struct tu_suballocator cs_suballoc;
+   mtx_t cs_mutex;
+
    /* the blob seems to always use 8K factor and 128K param sizes, copy them */
 #define TU_TESS_FACTOR_SIZE (8 * 1024)
 #define TU_TESS_PARAM_SIZE (128 * 1024)
@@ -375,10 +406,14 @@ struct tu_device
    mtx_t bo_mutex;
    /* protects imported BOs creation/freeing */
    struct u_rwlock dma_bo_lock;
+   /* kgsl: dma-buf inode -> gem_handle of imported BOs, under dma_bo_lock */
+   struct hash_table_u64 *dmabuf_bos;
 
    /* Tracking of name -> size allocated for TU_DEBUG_BOS */
    struct hash_table *bo_sizes;
 
+   struct tu_mem_stats mem_stats;
+
    /* This array holds all our 'struct tu_bo' allocations. We use this
     * so we can add a refcount to our BOs and check if a particular BO
     * was already allocated in this device using its GEM handle. This is
@@ -397,6 +432,15 @@ struct tu_device
     */
    struct util_sparse_array bo_map;
 
+   /* Recently freed BOs for backends that recycle them. */
+   struct tu_bo_cache bo_cache;
+
+   /* Worker threads compiling the stages of a pipeline concurrently, also
+    * used to split large host image copies. Not initialized on single-core
+    * systems.
+    */
+   struct util_queue compile_queue;
+
    /* We cannot immediately free VMA when freeing BO, kernel truly
     * frees BO when it stops being busy.
     * So we have to free our VMA only after the kernel does it.
@@ -425,6 +469,12 @@ struct tu_device
 
    struct breadcrumbs_context *breadcrumbs_ctx;
 
+   /* TU_PERFCNTR_RING background counter sampling, or NULL */
+   struct tu_perfcntr_sampler *perfcntr_sampler;
+
+   /* TU_RP_LOG render pass decision log, or NULL */
+   struct tu_rp_log *rp_log;
+
    struct tu_cs *dbg_cmdbuf_stomp_cs;
    struct tu_cs *dbg_renderpass_stomp_cs;
 
@@ -0,0 +1,634 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* VK_EXT_device_generated_commands
+ *
+ * Each sequence of the indirect commands buffer is expanded by a compute
+ * shader into a fixed size block of the preprocess buffer, which is then
+ * executed as an IB: from draw_cs for draws, and from cs for dispatches.
+ *
+ * The blocks are copies of templates that are emitted on the CPU with the
+ * regular emission code at preprocess time, with the values that come from
+ * the sequence patched in by the shader (see dgc/tu_dgc_interface.h). State
+ * a sequence brings along, like push constants and vertex buffers, is
+ * embedded in its block behind a CP_NOP and pointed to by the draw states
+ * or IBs of the block, so that the sequences don't have to allocate memory.
+ * Blocks are padded with a CP_NOP, and so are the blocks of sequences past
+ * the sequence count.
+ */
+
+#include "tu_dgc.h"
+
+#include "vk_common_entrypoints.h"
+
+#include "tu_buffer.h"
+#include "tu_cmd_buffer.h"
+#include "tu_cs.h"
+#include "tu_device.h"
+#include "tu_pipeline.h"
+
+#include "common/freedreno_gpu_event.h"
+
+static const uint32_t dgc_process_spv[] = {
+#include "dgc/dgc_process.spv.h"
+};
+
+static_assert(TU_DGC_CP_TYPE7_PKT == CP_TYPE7_PKT);
+static_assert(TU_DGC_CP_NOP == CP_NOP);
+static_assert(TU_DGC_INDEX4_SIZE_8_BIT == INDEX4_SIZE_8_BIT);
+static_assert(TU_DGC_INDEX4_SIZE_16_BIT == INDEX4_SIZE_16_BIT);
+static_assert(TU_DGC_INDEX4_SIZE_32_BIT == INDEX4_SIZE_32_BIT);
+
+void
+tu_dgc_patch_list_init(struct tu_dgc_patch_list *list,
+                       const struct tu_indirect_command_layout *layout,
+                       const uint32_t *base, uint64_t iova)
+{
+   list->layout = layout;
+   list->base = base;
+   list->iova = iova;
+   util_dynarray_init(&list->patches, NULL);
+}
+
+VkResult
+tu_dgc_patch_list_finish(struct tu_dgc_patch_list *list,
+                         struct tu_cs *sub_cs, uint32_t dw_count,
+                         struct tu_dgc_template *tmpl)
+{
+   uint32_t count =
+      util_dynarray_num_elements(&list->patches, struct tu_dgc_patch);
+
+   struct tu_cs_memory mem;
+   VkResult result = tu_cs_alloc(sub_cs, count,
+                                 sizeof(struct tu_dgc_patch) / 4, &mem);
+   if (result == VK_SUCCESS) {
+      if (count)
+         memcpy(mem.map, list->patches.data, count * sizeof(struct tu_dgc_patch));
+
+      *tmpl = (struct tu_dgc_template) {
+         .dw_addr = list->iova,
+         .patch_addr = mem.iova,
+         .dw_count = dw_count,
+         .patch_count = count,
+      };
+   }
+
+   util_dynarray_fini(&list->patches);
+   return result;
+}
+
+void
+tu_dgc_patch_add(struct tu_dgc_patch_list *list, const uint32_t *dst,
+                 uint32_t type, uint32_t arg, uint32_t count)
+{
+   struct tu_dgc_patch patch = {
+      .dst = (uint32_t) (dst - list->base),
+      .type = type,
+      .arg = arg,
+      .count = count,
+   };
+   util_dynarray_append(&list->patches, struct tu_dgc_patch, patch);
+}
+
+/* Patches the count push constant dwords starting at dword offset, which are
+ * emitted at dst, with the ones the layout sources from the sequence.
+ */
+void
+tu_dgc_patch_push_consts(struct tu_dgc_patch_list *list, const uint32_t *dst,
+                         uint32_t offset, uint32_t count)
+{
+   for (uint32_t i = 0; i < count; i++) {
+      uint32_t src = list->layout->push_src[offset + i];
+
+      if (src == TU_DGC_PUSH_NONE)
+         continue;
+
+      if (src == TU_DGC_PUSH_SEQ_INDEX) {
+         tu_dgc_patch_add(list, dst + i, TU_DGC_PATCH_SEQ_INDEX, 0, 0);
+         continue;
+      }
+
+      /* Merge runs of consecutive dwords. */
+      struct tu_dgc_patch *last =
+         util_dynarray_num_elements(&list->patches, struct tu_dgc_patch) ?
+         util_dynarray_top_ptr(&list->patches, struct tu_dgc_patch) : NULL;
+      if (last && last->type == TU_DGC_PATCH_SEQ_DW &&
+          last->dst + last->count == dst + i - list->base &&
+          last->arg + 4 * last->count == src) {
+         last->count++;
+         continue;
+      }
+
+      tu_dgc_patch_add(list, dst + i, TU_DGC_PATCH_SEQ_DW, src, 1);
+   }
+}
+
+/* Starts the data of a template, which is hidden from the CP behind a
+ * CP_NOP.
+ */
+uint32_t *
+tu_dgc_begin_data(struct tu_cs *cs)
+{
+   uint32_t *nop = cs->cur;
+   tu_cs_emit(cs, 0);
+   return nop;
+}
+
+void
+tu_dgc_end_data(struct tu_cs *cs, uint32_t *nop)
+{
+   uint32_t data_dw = cs->cur - (nop + 1);
+
+   if (data_dw)
+      *nop = pm4_pkt7_hdr(CP_NOP, data_dw);
+   else
+      cs->cur = nop;
+}
+
+/* Preprocess buffers are only known by their address when generating
+ * commands, but executing them needs their BO.
+ */
+void
+tu_dgc_register_buffer(struct tu_device *dev, struct tu_buffer *buffer)
+{
+   mtx_lock(&dev->dgc_buffers_mutex);
+   list_addtail(&buffer->dgc_link, &dev->dgc_buffers);
+   mtx_unlock(&dev->dgc_buffers_mutex);
+}
+
+void
+tu_dgc_unregister_buffer(struct tu_device *dev, struct tu_buffer *buffer)
+{
+   mtx_lock(&dev->dgc_buffers_mutex);
+   list_del(&buffer->dgc_link);
+   mtx_unlock(&dev->dgc_buffers_mutex);
+}
+
+static struct tu_buffer *
+tu_dgc_lookup_buffer(struct tu_device *dev, uint64_t iova)
+{
+   struct tu_buffer *found = NULL;
+
+   mtx_lock(&dev->dgc_buffers_mutex);
+   list_for_each_entry (struct tu_buffer, buffer, &dev->dgc_buffers,
+                        dgc_link) {
+      if (iova >= buffer->vk.device_address &&
+          iova < buffer->vk.device_address + buffer->vk.size) {
+         found = buffer;
+         break;
+      }
+   }
+   mtx_unlock(&dev->dgc_buffers_mutex);
+
+   return found;
+}
+
+/* The size of the blocks of the preprocess buffer, which has to be the same
+ * when querying the memory requirements, preprocessing and executing.
+ */
+static uint32_t
+tu_dgc_block_dw(struct tu_device *dev,
+                const struct tu_indirect_command_layout *layout,
+                VkIndirectExecutionSetEXT _ies,
+                const void *pNext)
+{
+   VK_FROM_HANDLE(tu_indirect_execution_set, ies, _ies);
+   uint32_t dwords = 0;
+
+   if (ies) {
+      for (uint32_t i = 0; i < ies->count; i++) {
+         dwords = MAX2(dwords, tu_dgc_dispatch_template_size(
+            dev, ies->pipelines[i]->shaders[MESA_SHADER_COMPUTE]));
+      }
+   } else {
+      const VkGeneratedCommandsPipelineInfoEXT *pipeline_info =
+         vk_find_struct_const(pNext, GENERATED_COMMANDS_PIPELINE_INFO_EXT);
+      assert(pipeline_info);
+      VK_FROM_HANDLE(tu_pipeline, pipeline, pipeline_info->pipeline);
+
+      if (layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_DISPATCH)) {
+         dwords = tu_dgc_dispatch_template_size(
+            dev, pipeline->shaders[MESA_SHADER_COMPUTE]);
+      } else {
+         dwords = tu_dgc_pipeline_draw_size(dev, layout, pipeline);
+      }
+   }
+
+   return align(dwords, 4);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_GetGeneratedCommandsMemoryRequirementsEXT(
+   VkDevice _device,
+   const VkGeneratedCommandsMemoryRequirementsInfoEXT *pInfo,
+   VkMemoryRequirements2 *pMemoryRequirements)
+{
+   VK_FROM_HANDLE(tu_device, device, _device);
+   VK_FROM_HANDLE(tu_indirect_command_layout, layout,
+                  pInfo->indirectCommandsLayout);
+
+   uint32_t block_dw = tu_dgc_block_dw(device, layout,
+                                       pInfo->indirectExecutionSet,
+                                       pInfo->pNext);
+
+   pMemoryRequirements->memoryRequirements = (VkMemoryRequirements) {
+      .size = (VkDeviceSize) block_dw * sizeof(uint32_t) *
+              MAX2(pInfo->maxSequenceCount, 1),
+      .alignment = 64,
+      .memoryTypeBits = ((1 << device->physical_device->memory.type_count) - 1) &
+                        ~device->physical_device->memory.lazy_type_mask,
+   };
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+tu_CreateIndirectCommandsLayoutEXT(
+   VkDevice _device,
+   const VkIndirectCommandsLayoutCreateInfoEXT *pCreateInfo,
+   const VkAllocationCallbacks *pAllocator,
+   VkIndirectCommandsLayoutEXT *pIndirectCommandsLayout)
+{
+   VK_FROM_HANDLE(tu_device, device, _device);
+
+   struct tu_indirect_command_layout *layout =
+      (struct tu_indirect_command_layout *) vk_indirect_command_layout_create(
+         &device->vk, pCreateInfo, pAllocator, sizeof(*layout));
+   if (!layout)
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   for (uint32_t i = 0; i < ARRAY_SIZE(layout->push_src); i++)
+      layout->push_src[i] = TU_DGC_PUSH_NONE;
+
+   for (uint32_t i = 0; i < layout->vk.n_pc_layouts; i++) {
+      const struct vk_indirect_command_push_constant_layout *pc =
+         &layout->vk.pc_layouts[i];
+
+      for (uint32_t j = 0; j < pc->size_B / 4; j++)
+         layout->push_src[pc->dst_offset_B / 4 + j] = pc->src_offset_B + 4 * j;
+   }
+
+   if (layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_SI)) {
+      layout->push_src[layout->vk.si_layout.dst_offset_B / 4] =
+         TU_DGC_PUSH_SEQ_INDEX;
+   }
+
+   *pIndirectCommandsLayout = tu_indirect_command_layout_to_handle(layout);
+
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_DestroyIndirectCommandsLayoutEXT(
+   VkDevice _device,
+   VkIndirectCommandsLayoutEXT indirectCommandsLayout,
+   const VkAllocationCallbacks *pAllocator)
+{
+   VK_FROM_HANDLE(tu_device, device, _device);
+   VK_FROM_HANDLE(tu_indirect_command_layout, layout, indirectCommandsLayout);
+
+   if (!layout)
+      return;
+
+   vk_indirect_command_layout_destroy(&device->vk, pAllocator, &layout->vk);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+tu_CreateIndirectExecutionSetEXT(
+   VkDevice _device,
+   const VkIndirectExecutionSetCreateInfoEXT *pCreateInfo,
+   const VkAllocationCallbacks *pAllocator,
+   VkIndirectExecutionSetEXT *pIndirectExecutionSet)
+{
+   VK_FROM_HANDLE(tu_device, device, _device);
+
+   /* maxIndirectShaderObjectCount is 0. */
+   assert(pCreateInfo->type == VK_INDIRECT_EXECUTION_SET_INFO_TYPE_PIPELINES_EXT);
+   const VkIndirectExecutionSetPipelineInfoEXT *info =
+      pCreateInfo->info.pPipelineInfo;
+   VK_FROM_HANDLE(tu_pipeline, initial, info->initialPipeline);
+
+   VK_MULTIALLOC(ma);
+   VK_MULTIALLOC_DECL(&ma, struct tu_indirect_execution_set, ies, 1);
+   VK_MULTIALLOC_DECL(&ma, struct tu_pipeline *, pipelines,
+                      info->maxPipelineCount);
+
+   if (!vk_object_multizalloc(&device->vk, &ma, pAllocator,
+                              VK_OBJECT_TYPE_INDIRECT_EXECUTION_SET_EXT))
+      return vk_error(device, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   ies->count = info->maxPipelineCount;
+   ies->pipelines = pipelines;
+   for (uint32_t i = 0; i < ies->count; i++)
+      ies->pipelines[i] = initial;
+
+   *pIndirectExecutionSet = tu_indirect_execution_set_to_handle(ies);
+
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_DestroyIndirectExecutionSetEXT(
+   VkDevice _device,
+   VkIndirectExecutionSetEXT indirectExecutionSet,
+   const VkAllocationCallbacks *pAllocator)
+{
+   VK_FROM_HANDLE(tu_device, device, _device);
+   VK_FROM_HANDLE(tu_indirect_execution_set, ies, indirectExecutionSet);
+
+   if (!ies)
+      return;
+
+   vk_object_free(&device->vk, pAllocator, ies);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_UpdateIndirectExecutionSetPipelineEXT(
+   VkDevice _device,
+   VkIndirectExecutionSetEXT indirectExecutionSet,
+   uint32_t executionSetWriteCount,
+   const VkWriteIndirectExecutionSetPipelineEXT *pExecutionSetWrites)
+{
+   VK_FROM_HANDLE(tu_indirect_execution_set, ies, indirectExecutionSet);
+
+   for (uint32_t i = 0; i < executionSetWriteCount; i++) {
+      VK_FROM_HANDLE(tu_pipeline, pipeline, pExecutionSetWrites[i].pipeline);
+
+      assert(pExecutionSetWrites[i].index < ies->count);
+      ies->pipelines[pExecutionSetWrites[i].index] = pipeline;
+   }
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_UpdateIndirectExecutionSetShaderEXT(
+   VkDevice _device,
+   VkIndirectExecutionSetEXT indirectExecutionSet,
+   uint32_t executionSetWriteCount,
+   const VkWriteIndirectExecutionSetShaderEXT *pExecutionSetWrites)
+{
+   unreachable("maxIndirectShaderObjectCount is 0");
+}
+
+static VkResult
+get_process_pipeline(struct tu_device *device, VkPipeline *pipeline,
+                     VkPipelineLayout *layout)
+{
+   const char *key = "tu-dgc-process";
+   size_t key_size = strlen(key);
+
+   const VkPushConstantRange pc_range = {
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = sizeof(struct tu_dgc_args),
+   };
+
+   VkResult result = vk_meta_get_pipeline_layout(&device->vk,
+                                                 &device->meta, NULL,
+                                                 &pc_range, key, key_size,
+                                                 layout);
+   if (result != VK_SUCCESS)
+      return result;
+
+   VkPipeline pipeline_from_cache =
+      vk_meta_lookup_pipeline(&device->meta, key, key_size);
+   if (pipeline_from_cache != VK_NULL_HANDLE) {
+      *pipeline = pipeline_from_cache;
+      return VK_SUCCESS;
+   }
+
+   VkShaderModuleCreateInfo module_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = sizeof(dgc_process_spv),
+      .pCode = dgc_process_spv,
+   };
+
+   VkComputePipelineCreateInfo pipeline_info = {
+      .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+      .stage = {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+         .pNext = &module_info,
+         .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+         .pName = "main",
+      },
+      .layout = *layout,
+   };
+
+   return vk_meta_create_compute_pipeline(&device->vk, &device->meta,
+                                          &pipeline_info, key, key_size,
+                                          pipeline);
+}
+
+/* Emits the templates of the sequences from the state of state_cmd, and
+ * expands the sequences into the preprocess buffer in cmd->cs. Like other
+ * work in cs, this happens ahead of the render pass when recording one.
+ */
+template <chip CHIP>
+static void
+tu_dgc_preprocess(struct tu_cmd_buffer *cmd,
+                  struct tu_cmd_buffer *state_cmd,
+                  const VkGeneratedCommandsInfoEXT *info)
+{
+   VK_FROM_HANDLE(tu_indirect_command_layout, layout,
+                  info->indirectCommandsLayout);
+   VK_FROM_HANDLE(tu_indirect_execution_set, ies, info->indirectExecutionSet);
+   struct tu_device *device = cmd->device;
+
+   if (info->maxSequenceCount == 0)
+      return;
+
+   uint32_t block_dw = tu_dgc_block_dw(device, layout,
+                                       info->indirectExecutionSet,
+                                       info->pNext);
+   assert((VkDeviceSize) block_dw * sizeof(uint32_t) *
+          info->maxSequenceCount <= info->preprocessSize);
+
+   uint32_t template_count = ies ? ies->count : 1;
+   struct tu_cs_memory templates;
+   VkResult result =
+      tu_cs_alloc(&cmd->sub_cs, template_count,
+                  sizeof(struct tu_dgc_template) / 4, &templates);
+   if (result != VK_SUCCESS) {
+      vk_command_buffer_set_error(&cmd->vk, result);
+      return;
+   }
+
+   for (uint32_t i = 0; i < template_count; i++) {
+      struct tu_dgc_template tmpl;
+
+      if (ies) {
+         struct tu_pipeline *pipeline = ies->pipelines[i];
+         struct tu_shader *shader = pipeline->shaders[MESA_SHADER_COMPUTE];
+         result = tu_dgc_emit_dispatch_template<CHIP>(
+            state_cmd, &cmd->sub_cs, layout, shader, shader->state,
+            pipeline->load_state, &tmpl);
+      } else if (layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_DISPATCH)) {
+         result = tu_dgc_emit_dispatch_template<CHIP>(
+            state_cmd, &cmd->sub_cs, layout,
+            state_cmd->state.shaders[MESA_SHADER_COMPUTE],
+            (struct tu_draw_state) {}, state_cmd->state.compute_load_state,
+            &tmpl);
+      } else {
+         result = tu_dgc_emit_draw_template<CHIP>(state_cmd, &cmd->sub_cs,
+                                                  layout, &tmpl);
+      }
+
+      if (result != VK_SUCCESS) {
+         vk_command_buffer_set_error(&cmd->vk, result);
+         return;
+      }
+
+      assert(tmpl.dw_count <= block_dw);
+      memcpy(templates.map + i * sizeof(tmpl) / 4, &tmpl, sizeof(tmpl));
+   }
+
+   VkPipeline pipeline;
+   VkPipelineLayout pipeline_layout;
+   result = get_process_pipeline(device, &pipeline, &pipeline_layout);
+   if (result != VK_SUCCESS) {
+      vk_command_buffer_set_error(&cmd->vk, result);
+      return;
+   }
+
+   uint32_t push_constants[MAX_PUSH_CONSTANTS_SIZE / 4];
+   memcpy(push_constants, cmd->push_constants, sizeof(push_constants));
+   struct tu_shader *compute_shader = cmd->state.shaders[MESA_SHADER_COMPUTE];
+   struct tu_draw_state compute_load_state = cmd->state.compute_load_state;
+
+   VkCommandBuffer cmd_handle = tu_cmd_buffer_to_handle(cmd);
+   tu_CmdBindPipeline(cmd_handle, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+   const struct tu_dgc_args args = {
+      .seq_addr = info->indirectAddress,
+      .out_addr = info->preprocessAddress,
+      .count_addr = info->sequenceCountAddress,
+      .templates_addr = templates.iova,
+      .seq_stride = (uint32_t) layout->vk.stride,
+      .max_seq_count = info->maxSequenceCount,
+      .block_dw = block_dw,
+      .ies_offset = ies ? layout->vk.ies_src_offset_B : TU_DGC_NO_IES,
+      .template_count = template_count,
+      .max_draw_count = info->maxDrawCount,
+      .index_mode_dx = layout->vk.index_mode_is_dx,
+   };
+   vk_common_CmdPushConstants(cmd_handle, pipeline_layout,
+                              VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(args),
+                              &args);
+
+   tu_CmdDispatchBase<CHIP>(cmd_handle, 0, 0, 0,
+                            DIV_ROUND_UP(info->maxSequenceCount, 64), 1, 1);
+
+   /* The CP reads the sequences back right away when executing. */
+   tu_emit_event_write<CHIP>(cmd, &cmd->cs, FD_CACHE_CLEAN);
+   tu_cs_emit_wfi(&cmd->cs);
+   tu_cs_emit_pkt7(&cmd->cs, CP_WAIT_FOR_ME, 0);
+
+   cmd->state.shaders[MESA_SHADER_COMPUTE] = compute_shader;
+   if (compute_shader)
+      tu_cs_emit_state_ib(&cmd->cs, compute_shader->state);
+   cmd->state.compute_load_state = compute_load_state;
+   memcpy(cmd->push_constants, push_constants, sizeof(push_constants));
+   cmd->state.dirty |= TU_CMD_DIRTY_SHADER_CONSTS |
+                       TU_CMD_DIRTY_COMPUTE_DESC_SETS;
+}
+
+template <chip CHIP>
+VKAPI_ATTR void VKAPI_CALL
+tu_CmdPreprocessGeneratedCommandsEXT(
+   VkCommandBuffer commandBuffer,
+   const VkGeneratedCommandsInfoEXT *pGeneratedCommandsInfo,
+   VkCommandBuffer stateCommandBuffer)
+{
+   VK_FROM_HANDLE(tu_cmd_buffer, cmd, commandBuffer);
+   VK_FROM_HANDLE(tu_cmd_buffer, state_cmd, stateCommandBuffer);
+
+   tu_dgc_preprocess<CHIP>(cmd, state_cmd, pGeneratedCommandsInfo);
+}
+TU_GENX(tu_CmdPreprocessGeneratedCommandsEXT);
+
+template <chip CHIP>
+VKAPI_ATTR void VKAPI_CALL
+tu_CmdExecuteGeneratedCommandsEXT(
+   VkCommandBuffer commandBuffer,
+   VkBool32 isPreprocessed,
+   const VkGeneratedCommandsInfoEXT *pGeneratedCommandsInfo)
+{
+   VK_FROM_HANDLE(tu_cmd_buffer, cmd, commandBuffer);
+   VK_FROM_HANDLE(tu_indirect_command_layout, layout,
+                  pGeneratedCommandsInfo->indirectCommandsLayout);
+   const VkGeneratedCommandsInfoEXT *info = pGeneratedCommandsInfo;
+   bool compute = layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_DISPATCH);
+
+   if (info->maxSequenceCount == 0)
+      return;
+
+   if (!isPreprocessed)
+      tu_dgc_preprocess<CHIP>(cmd, cmd, info);
+
+   struct tu_buffer *buffer =
+      tu_dgc_lookup_buffer(cmd->device, info->preprocessAddress);
+   if (!buffer) {
+      mesa_loge("generated commands executed from an unknown preprocess buffer");
+      return;
+   }
+
+   struct tu_cs *cs;
+   if (compute) {
+      tu_dgc_begin_dispatch<CHIP>(cmd);
+      cs = &cmd->cs;
+   } else {
+      tu_dgc_begin_draw<CHIP>(cmd, layout);
+      cs = &cmd->draw_cs;
+   }
+
+   /* Split the sequences at block boundaries to stay within the 20 bit IB
+    * size of CP_INDIRECT_BUFFER.
+    */
+   uint32_t block_dw = tu_dgc_block_dw(cmd->device, layout,
+                                       info->indirectExecutionSet,
+                                       info->pNext);
+   uint32_t ib_seq_count = 0xfffff / block_dw;
+   uint64_t offset = info->preprocessAddress - buffer->bo->iova;
+
+   for (uint32_t seq = 0; seq < info->maxSequenceCount; seq += ib_seq_count) {
+      uint32_t count = MIN2(ib_seq_count, info->maxSequenceCount - seq);
+      struct tu_cs_entry entry = {
+         .bo = buffer->bo,
+         .size = count * block_dw * (uint32_t) sizeof(uint32_t),
+         .offset = (uint32_t) (offset + (uint64_t) seq * block_dw *
+                               sizeof(uint32_t)),
+      };
+
+      VkResult result = tu_cs_add_external_entry(cs, &entry);
+      if (result != VK_SUCCESS) {
+         vk_command_buffer_set_error(&cmd->vk, result);
+         return;
+      }
+   }
+
+   /* Everything the sequences set is left behind in the hardware. */
+   if (compute) {
+      if (info->indirectExecutionSet != VK_NULL_HANDLE) {
+         tu_cs_emit_state_ib(&cmd->cs,
+                             cmd->state.shaders[MESA_SHADER_COMPUTE]->state);
+         cmd->state.dirty |= TU_CMD_DIRTY_COMPUTE_DESC_SETS;
+      }
+      return;
+   }
+
+   if (layout->vk.dgc_info & (BITFIELD_BIT(MESA_VK_DGC_PC) |
+                              BITFIELD_BIT(MESA_VK_DGC_SI)))
+      cmd->state.dirty |= TU_CMD_DIRTY_SHADER_CONSTS;
+
+   /* The strides may be static pipeline state, so re-emit all of it. */
+   if (layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_VB))
+      cmd->state.dirty |= TU_CMD_DIRTY_VERTEX_BUFFERS | TU_CMD_DIRTY_DRAW_STATE;
+
+   if ((layout->vk.dgc_info & BITFIELD_BIT(MESA_VK_DGC_IB)) &&
+       cmd->state.index_va) {
+      uint32_t restart_index =
+         cmd->state.index_size == INDEX4_SIZE_8_BIT ? 0xff :
+         cmd->state.index_size == INDEX4_SIZE_16_BIT ? 0xffff : 0xffffffff;
+      tu_cs_emit_regs(&cmd->draw_cs, A6XX_PC_RESTART_INDEX(restart_index));
+   }
+}
+TU_GENX(tu_CmdExecuteGeneratedCommandsEXT);
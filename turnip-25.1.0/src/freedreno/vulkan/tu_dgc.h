@@ -0,0 +1,90 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_DGC_H
+#define TU_DGC_H
+
+#include "tu_common.h"
+
+#include "vk_device_generated_commands.h"
+
+#include "dgc/tu_dgc_interface.h"
+
+/* Where a push constant dword comes from in a sequence. Anything else is
+ * a byte offset into the sequence.
+ */
+#define TU_DGC_PUSH_NONE      (~0u)
+#define TU_DGC_PUSH_SEQ_INDEX (~1u)
+
+struct tu_indirect_command_layout
+{
+   struct vk_indirect_command_layout vk;
+
+   uint32_t push_src[MAX_PUSH_CONSTANTS_SIZE / 4];
+};
+
+VK_DEFINE_NONDISP_HANDLE_CASTS(tu_indirect_command_layout, vk.base,
+                               VkIndirectCommandsLayoutEXT,
+                               VK_OBJECT_TYPE_INDIRECT_COMMANDS_LAYOUT_EXT)
+
+/* Only compute pipelines can be switched between sequences. */
+struct tu_indirect_execution_set
+{
+   struct vk_object_base base;
+
+   uint32_t count;
+   struct tu_pipeline **pipelines;
+};
+
+VK_DEFINE_NONDISP_HANDLE_CASTS(tu_indirect_execution_set, base,
+                               VkIndirectExecutionSetEXT,
+                               VK_OBJECT_TYPE_INDIRECT_EXECUTION_SET_EXT)
+
+/* The patches of a template that is being emitted at base/iova. */
+struct tu_dgc_patch_list
+{
+   const struct tu_indirect_command_layout *layout;
+   const uint32_t *base;
+   uint64_t iova;
+   struct util_dynarray patches;
+};
+
+void
+tu_dgc_patch_list_init(struct tu_dgc_patch_list *list,
+                       const struct tu_indirect_command_layout *layout,
+                       const uint32_t *base, uint64_t iova);
+
+VkResult
+tu_dgc_patch_list_finish(struct tu_dgc_patch_list *list,
+                         struct tu_cs *sub_cs, uint32_t dw_count,
+                         struct tu_dgc_template *tmpl);
+
+void
+tu_dgc_patch_add(struct tu_dgc_patch_list *list, const uint32_t *dst,
+                 uint32_t type, uint32_t arg, uint32_t count);
+
+static inline void
+tu_dgc_patch_block_addr(struct tu_dgc_patch_list *list, const uint32_t *dst)
+{
+   tu_dgc_patch_add(list, dst, TU_DGC_PATCH_BLOCK_ADDR, 0, 0);
+}
+
+void
+tu_dgc_patch_push_consts(struct tu_dgc_patch_list *list, const uint32_t *dst,
+                         uint32_t offset, uint32_t count);
+
+uint32_t *
+tu_dgc_begin_data(struct tu_cs *cs);
+
+void
+tu_dgc_end_data(struct tu_cs *cs, uint32_t *nop);
+
+void
+tu_dgc_register_buffer(struct tu_device *dev, struct tu_buffer *buffer);
+
+void
+tu_dgc_unregister_buffer(struct tu_device *dev, struct tu_buffer *buffer);
+
+#endif /* TU_DGC_H */
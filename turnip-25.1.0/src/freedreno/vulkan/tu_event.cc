@@ -80,6 +80,11 @@ tu_GetEventStatus(VkDevice _device, VkEvent _event)
 
    if (*tu_event_map(event) == 1)
       return VK_EVENT_SET;
+
+   /* The command setting the event may still be held back by the kernel
+    * backend, make sure polling for it eventually succeeds.
+    */
+   tu_device_flush_deferred_submits(device);
    return VK_EVENT_RESET;
 }
 
@@ -93,13 +93,18 @@ tu6_mutable_format_list_ubwc_compatible(const struct fd_dev_info *info,
    if (fmt_list->viewFormatCount == 1)
       return true;
 
-   enum fd6_ubwc_compat_type type =
-      tu6_ubwc_compat_mode(info, fmt_list->pViewFormats[0]);
-   if (type == FD6_UBWC_UNKNOWN_COMPAT)
-      return false;
+   VkFormat format = fmt_list->pViewFormats[0];
+   enum fd6_ubwc_compat_type type = tu6_ubwc_compat_mode(info, format);
 
    for (uint32_t i = 1; i < fmt_list->viewFormatCount; i++) {
-      if (tu6_ubwc_compat_mode(info, fmt_list->pViewFormats[i]) != type)
+      /* Apps like DXVK repeat formats in the list, and a format with no
+       * known compatible formats is still compatible with itself.
+       */
+      if (fmt_list->pViewFormats[i] == format)
+         continue;
+
+      if (type == FD6_UBWC_UNKNOWN_COMPAT ||
+          tu6_ubwc_compat_mode(info, fmt_list->pViewFormats[i]) != type)
          return false;
    }
 
@@ -887,6 +887,9 @@ tu_DestroyImage(VkDevice _device,
                                 image->iova, image->total_size,
                                 VK_DEVICE_ADDRESS_BINDING_TYPE_UNBIND_EXT);
 
+   if (image->lrz_bo)
+      tu_bo_finish(device, image->lrz_bo);
+
    vk_image_destroy(&device->vk, pAllocator, &image->vk);
 }
 
@@ -915,6 +918,7 @@ tu_BindImageMemory2(VkDevice _device,
          image->bo = wsi_img->bo;
          image->map = NULL;
          image->iova = wsi_img->iova;
+         image->lrz_iova = image->iova + image->lrz_layout.lrz_offset;
 
          TU_RMV(image_bind, device, image);
 
@@ -956,6 +960,25 @@ tu_BindImageMemory2(VkDevice _device,
          image->bo = mem->bo;
          image->bo_offset = pBindInfos[i].memoryOffset;
          image->iova = mem->bo->iova + pBindInfos[i].memoryOffset;
+         image->lrz_iova = image->iova + image->lrz_layout.lrz_offset;
+
+         /* LRZ is used by GMEM rendering too, so it can't be left
+          * uncommitted. Give it memory of its own instead.
+          */
+         if (mem->bo->lazy && image->lrz_layout.lrz_total_size &&
+             !image->lrz_bo) {
+            result = tu_bo_init_new(device, &image->vk.base, &image->lrz_bo,
+                                    image->lrz_layout.lrz_total_size,
+                                    TU_BO_ALLOC_NO_FLAGS,
+                                    TU_MEM_CATEGORY_INTERNAL,
+                                    "lazy image LRZ");
+            if (result != VK_SUCCESS) {
+               if (status)
+                  *status->pResult = result;
+               return result;
+            }
+            image->lrz_iova = image->lrz_bo->iova;
+         }
 
          if (image->vk.usage & (VK_IMAGE_USAGE_FRAGMENT_DENSITY_MAP_BIT_EXT |
                                 VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT)) {
@@ -979,6 +1002,7 @@ tu_BindImageMemory2(VkDevice _device,
          image->bo = NULL;
          image->map = NULL;
          image->iova = 0;
+         image->lrz_iova = 0;
       }
 
       TU_RMV(image_bind, device, image);
@@ -1001,6 +1025,12 @@ tu_get_image_memory_requirements(struct tu_device *dev, struct tu_image *image,
       .memoryTypeBits = (1 << dev->physical_device->memory.type_count) - 1,
    };
 
+   if (!(image->vk.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) ||
+       image->vk.external_handle_types) {
+      pMemoryRequirements->memoryRequirements.memoryTypeBits &=
+         ~dev->physical_device->memory.lazy_type_mask;
+   }
+
    vk_foreach_struct(ext, pMemoryRequirements->pNext) {
       switch (ext->sType) {
       case VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS: {
@@ -43,6 +43,11 @@ struct tu_image
    void *map;
 
    struct fdl_lrz_layout lrz_layout;
+   /* Set when bound, LRZ of images bound to lazily allocated memory lives
+    * in lrz_bo.
+    */
+   uint64_t lrz_iova;
+   struct tu_bo *lrz_bo;
 
    bool ubwc_enabled;
    bool force_linear_tile;
@@ -35,7 +35,8 @@ tu_bo_init_new_explicit_iova(struct tu_device *dev,
                              uint64_t size,
                              uint64_t client_iova,
                              VkMemoryPropertyFlags mem_property,
-                             enum tu_bo_alloc_flags flags, const char *name)
+                             enum tu_bo_alloc_flags flags,
+                             enum tu_mem_category category, const char *name)
 {
    struct tu_instance *instance = dev->physical_device->instance;
 
@@ -55,6 +56,12 @@ tu_bo_init_new_explicit_iova(struct tu_device *dev,
 
    (*out_bo)->dump = flags & TU_BO_ALLOC_ALLOW_DUMP;
 
+   /* lazy BOs count once they are committed */
+   if ((*out_bo)->lazy)
+      (*out_bo)->mem_category = category;
+   else
+      tu_mem_stats_add(dev, *out_bo, category);
+
    return VK_SUCCESS;
 }
 
@@ -214,6 +221,28 @@ void tu_bo_allow_dump(struct tu_device *dev, struct tu_bo *bo)
    p_atomic_set(&bo->dump, true);
 }
 
+VkResult
+tu_bo_commit(struct tu_device *dev, struct tu_bo *bo)
+{
+   if (!bo->lazy || p_atomic_read(&bo->committed))
+      return VK_SUCCESS;
+
+   VkResult result = VK_SUCCESS;
+   mtx_lock(&dev->bo_mutex);
+   if (!bo->committed) {
+      result = dev->instance->knl->bo_commit(dev, bo);
+      if (result == VK_SUCCESS) {
+         /* lazy BOs are only ever vkAllocateMemory() ones */
+         p_atomic_add(&dev->physical_device->heap.used, bo->size);
+         tu_mem_stats_add(dev, bo, (enum tu_mem_category) bo->mem_category);
+         p_atomic_set(&bo->committed, true);
+      }
+   }
+   mtx_unlock(&dev->bo_mutex);
+
+   return result;
+}
+
 void
 tu_bo_set_metadata(struct tu_device *dev, struct tu_bo *bo,
                    void *metadata, uint32_t metadata_size)
@@ -273,6 +302,33 @@ tu_device_check_status(struct vk_device *vk_device)
    return dev->instance->knl->device_check_status(dev);
 }
 
+bool
+tu_device_has_perfcntr_read(struct tu_device *dev)
+{
+   return dev->instance->knl->perfcntr_read != NULL;
+}
+
+int
+tu_device_perfcntr_get(struct tu_device *dev, const char *group_name,
+                       uint32_t countable, uint32_t *group)
+{
+   return dev->instance->knl->perfcntr_get(dev, group_name, countable, group);
+}
+
+void
+tu_device_perfcntr_put(struct tu_device *dev, uint32_t group,
+                       uint32_t countable)
+{
+   dev->instance->knl->perfcntr_put(dev, group, countable);
+}
+
+int
+tu_device_perfcntr_read(struct tu_device *dev, struct tu_knl_perfcntr *cntrs,
+                        uint32_t count)
+{
+   return dev->instance->knl->perfcntr_read(dev, cntrs, count);
+}
+
 int
 tu_drm_submitqueue_new(struct tu_device *dev,
                        int priority,
@@ -320,6 +376,20 @@ tu_queue_submit(struct tu_queue *queue, void *submit,
                                                      u_trace_submission_data);
 }
 
+void
+tu_device_flush_deferred_submits(struct tu_device *dev)
+{
+   if (!dev->instance->knl->queue_flush)
+      return;
+
+   pthread_mutex_lock(&dev->submit_mutex);
+   for (unsigned i = 0; i < TU_MAX_QUEUE_FAMILIES; i++) {
+      for (int q = 0; q < dev->queue_count[i]; q++)
+         dev->instance->knl->queue_flush(&dev->queues[i][q]);
+   }
+   pthread_mutex_unlock(&dev->submit_mutex);
+}
+
 /**
  * Enumeration entrypoint specific to non-drm devices (ie. kgsl)
  */
@@ -23,6 +23,31 @@ enum tu_bo_alloc_flags {
    TU_BO_ALLOC_INTERNAL_RESOURCE = 1 << 3,
    TU_BO_ALLOC_DMABUF = 1 << 4,
    TU_BO_ALLOC_SHAREABLE = 1 << 5,
+   /* The BO is never exported and its users don't rely on it being zeroed,
+    * so a freed BO may be handed out again by the backend's BO cache.
+    */
+   TU_BO_ALLOC_CACHEABLE = 1 << 6,
+   /* Only reserve the address range, the backing is allocated by
+    * tu_bo_commit() once the BO is first needed. Requires
+    * tu_physical_device::has_lazy_memory.
+    */
+   TU_BO_ALLOC_LAZY = 1 << 7,
+};
+
+/* What a BO is used for, see tu_mem_stats.h */
+enum tu_mem_category {
+   TU_MEM_CATEGORY_INTERNAL,
+   TU_MEM_CATEGORY_CMDSTREAM,
+   TU_MEM_CATEGORY_DESCRIPTOR,
+   TU_MEM_CATEGORY_PIPELINE,
+   TU_MEM_CATEGORY_SCRATCH,
+   TU_MEM_CATEGORY_QUERY,
+   /* vkAllocateMemory(), i.e. images and buffers */
+   TU_MEM_CATEGORY_DEVICE_MEMORY,
+   TU_MEM_CATEGORY_IMPORTED,
+   /* freed BOs kept around by the backend's BO cache */
+   TU_MEM_CATEGORY_BO_CACHE,
+   TU_MEM_CATEGORY_COUNT,
 };
 
 /* Define tu_timeline_sync type based on drm syncobj for a point type
@@ -50,6 +75,8 @@ struct tu_bo {
    uint32_t gem_handle;
 #ifdef TU_HAS_VIRTIO
    uint32_t res_id;
+   /* GEM_NEW and blob flags, used to match BOs for reuse from the BO cache */
+   uint32_t virtio_alloc_flags;
 #endif
    uint64_t size;
    uint64_t iova;
@@ -66,11 +93,29 @@ struct tu_bo {
     * export file descriptor.
     */
    int shared_fd;
+
+   /* kernel allocation flags, used to match BOs for reuse from the BO cache */
+   uint32_t kgsl_alloc_flags;
+
+   /* inode of the imported dma-buf, or 0 if not imported */
+   uint64_t dmabuf_ino;
+
+   /* id of the physical allocation backing a committed lazy BO */
+   uint32_t lazy_backing;
 #endif
 
+   /* TU_BO_ALLOC_LAZY BO whose backing has been allocated, read unlocked */
+   bool committed;
+
+   uint8_t mem_category; /* enum tu_mem_category */
+
    bool implicit_sync : 1;
    bool never_unmap : 1;
    bool cached_non_coherent : 1;
+   bool cacheable : 1;
+   /* counted in tu_device::mem_stats under mem_category */
+   bool mem_counted : 1;
+   bool lazy : 1;
 
    bool dump;
 
@@ -80,6 +125,42 @@ struct tu_bo {
    struct vk_object_base *base;
 };
 
+/* Freed TU_BO_ALLOC_CACHEABLE BOs, bucketed by power-of-two size, so that
+ * reallocating them doesn't have to go through the kernel.
+ */
+#define TU_BO_CACHE_MIN_SIZE_LOG2 12
+#define TU_BO_CACHE_MAX_SIZE_LOG2 20
+#define TU_BO_CACHE_BUCKETS (TU_BO_CACHE_MAX_SIZE_LOG2 - TU_BO_CACHE_MIN_SIZE_LOG2 + 1)
+/* cached BOs unused for longer than this are returned to the kernel */
+#define TU_BO_CACHE_TIMEOUT_NS 1000000000ll
+#define TU_BO_CACHE_MAX_BUCKET_ENTRIES 64
+
+struct tu_bo_cache_entry {
+   uint32_t gem_handle;
+#ifdef TU_HAS_VIRTIO
+   uint32_t res_id;
+#endif
+   uint32_t alloc_flags;
+   void *map;
+   uint64_t size;
+   int64_t free_time;
+};
+
+struct tu_bo_cache {
+   mtx_t lock;
+   /* arrays of tu_bo_cache_entry, oldest first */
+   struct util_dynarray buckets[TU_BO_CACHE_BUCKETS];
+};
+
+/* A GPU counter reserved through the kernel, for backends that can read
+ * counters on behalf of userspace (see tu_perfcntr_sampler.h).
+ */
+struct tu_knl_perfcntr {
+   uint32_t group;     /* kernel group id returned by perfcntr_get */
+   uint32_t countable;
+   uint64_t value;     /* filled in by perfcntr_read */
+};
+
 struct tu_knl {
    const char *name;
 
@@ -100,6 +181,8 @@ struct tu_knl {
    VkResult (*bo_map)(struct tu_device *dev, struct tu_bo *bo, void *placed_addr);
    void (*bo_allow_dump)(struct tu_device *dev, struct tu_bo *bo);
    void (*bo_finish)(struct tu_device *dev, struct tu_bo *bo);
+   /* optional: back a TU_BO_ALLOC_LAZY BO, called once under bo_mutex */
+   VkResult (*bo_commit)(struct tu_device *dev, struct tu_bo *bo);
    void (*bo_set_metadata)(struct tu_device *dev, struct tu_bo *bo,
                            void *metadata, uint32_t metadata_size);
    int (*bo_get_metadata)(struct tu_device *dev, struct tu_bo *bo,
@@ -115,6 +198,17 @@ struct tu_knl {
                             struct tu_u_trace_submission_data *u_trace_submission_data);
    VkResult (*queue_wait_fence)(struct tu_queue *queue, uint32_t fence,
                                 uint64_t timeout_ns);
+   /* Optional, submits any work the backend has held back. Called with the
+    * device submit_mutex held.
+    */
+   VkResult (*queue_flush)(struct tu_queue *queue);
+   /* optional: reserve/release/read counters by fd_perfcntr group name */
+   int (*perfcntr_get)(struct tu_device *dev, const char *group_name,
+                       uint32_t countable, uint32_t *group);
+   void (*perfcntr_put)(struct tu_device *dev, uint32_t group,
+                        uint32_t countable);
+   int (*perfcntr_read)(struct tu_device *dev, struct tu_knl_perfcntr *cntrs,
+                        uint32_t count);
 
    const struct vk_device_entrypoint_table *device_entrypoints;
 };
@@ -144,12 +238,14 @@ tu_bo_init_new_explicit_iova(struct tu_device *dev,
                              uint64_t client_iova,
                              VkMemoryPropertyFlags mem_property,
                              enum tu_bo_alloc_flags flags,
+                             enum tu_mem_category category,
                              const char *name);
 
 static inline VkResult
 tu_bo_init_new(struct tu_device *dev, struct vk_object_base *base,
                struct tu_bo **out_bo, uint64_t size,
-               enum tu_bo_alloc_flags flags, const char *name)
+               enum tu_bo_alloc_flags flags, enum tu_mem_category category,
+               const char *name)
 {
    // TODO don't mark everything with HOST_VISIBLE !!! Anything that
    // never gets CPU access should not have this bit set
@@ -158,7 +254,7 @@ tu_bo_init_new(struct tu_device *dev, struct vk_object_base *base,
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-      flags, name);
+      flags, category, name);
 }
 
 VkResult
@@ -190,6 +286,10 @@ uint32_t tu_get_l1_dcache_size();
 
 void tu_bo_allow_dump(struct tu_device *dev, struct tu_bo *bo);
 
+/* Makes sure a TU_BO_ALLOC_LAZY BO is backed, no-op for other BOs. */
+VkResult
+tu_bo_commit(struct tu_device *dev, struct tu_bo *bo);
+
 void tu_bo_set_metadata(struct tu_device *dev, struct tu_bo *bo,
                         void *metadata, uint32_t metadata_size);
 int tu_bo_get_metadata(struct tu_device *dev, struct tu_bo *bo,
@@ -239,6 +339,21 @@ tu_device_wait_u_trace(struct tu_device *dev, struct tu_u_trace_syncobj *syncobj
 VkResult
 tu_device_check_status(struct vk_device *vk_device);
 
+bool
+tu_device_has_perfcntr_read(struct tu_device *dev);
+
+int
+tu_device_perfcntr_get(struct tu_device *dev, const char *group_name,
+                       uint32_t countable, uint32_t *group);
+
+void
+tu_device_perfcntr_put(struct tu_device *dev, uint32_t group,
+                       uint32_t countable);
+
+int
+tu_device_perfcntr_read(struct tu_device *dev, struct tu_knl_perfcntr *cntrs,
+                        uint32_t count);
+
 int
 tu_drm_submitqueue_new(struct tu_device *dev,
                        int priority,
@@ -268,4 +383,7 @@ VkResult
 tu_queue_wait_fence(struct tu_queue *queue, uint32_t fence,
                     uint64_t timeout_ns);
 
+void
+tu_device_flush_deferred_submits(struct tu_device *dev);
+
 #endif /* TU_DRM_H */
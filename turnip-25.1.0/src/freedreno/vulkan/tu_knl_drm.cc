@@ -58,25 +58,15 @@ tu_drm_export_dmabuf(struct tu_device *dev, struct tu_bo *bo)
    return ret == 0 ? prime_fd : -1;
 }
 
+/* Drops the debug tracking of a BO and removes it from the submit BO list,
+ * leaving its GEM handle, iova and mapping alone.
+ */
 void
-tu_drm_bo_finish(struct tu_device *dev, struct tu_bo *bo)
+tu_drm_bo_untrack(struct tu_device *dev, struct tu_bo *bo)
 {
-   assert(bo->gem_handle);
-
-   u_rwlock_rdlock(&dev->dma_bo_lock);
-
-   if (!p_atomic_dec_zero(&bo->refcnt)) {
-      u_rwlock_rdunlock(&dev->dma_bo_lock);
-      return;
-   }
-
-   if (bo->map) {
-      TU_RMV(bo_unmap, dev, bo);
-      munmap(bo->map, bo->size);
-   }
-
    TU_RMV(bo_destroy, dev, bo);
    tu_debug_bos_del(dev, bo);
+   tu_mem_stats_del(dev, bo);
    tu_dump_bo_del(dev, bo);
 
    mtx_lock(&dev->bo_mutex);
@@ -90,7 +80,14 @@ tu_drm_bo_finish(struct tu_device *dev, struct tu_bo *bo)
       dev->implicit_sync_bo_count--;
 
    mtx_unlock(&dev->bo_mutex);
+}
 
+/* Returns the GEM handle and iova of an untracked BO to the kernel, once the
+ * GPU is done with them.
+ */
+void
+tu_drm_bo_release(struct tu_device *dev, struct tu_bo *bo)
+{
    if (dev->physical_device->has_set_iova) {
       mtx_lock(&dev->vma_mutex);
       struct tu_zombie_vma *vma = (struct tu_zombie_vma *)
@@ -126,6 +123,27 @@ tu_drm_bo_finish(struct tu_device *dev, struct tu_bo *bo)
 
       drmIoctl(dev->fd, DRM_IOCTL_GEM_CLOSE, &req);
    }
+}
+
+void
+tu_drm_bo_finish(struct tu_device *dev, struct tu_bo *bo)
+{
+   assert(bo->gem_handle);
+
+   u_rwlock_rdlock(&dev->dma_bo_lock);
+
+   if (!p_atomic_dec_zero(&bo->refcnt)) {
+      u_rwlock_rdunlock(&dev->dma_bo_lock);
+      return;
+   }
+
+   if (bo->map) {
+      TU_RMV(bo_unmap, dev, bo);
+      munmap(bo->map, bo->size);
+   }
+
+   tu_drm_bo_untrack(dev, bo);
+   tu_drm_bo_release(dev, bo);
 
    u_rwlock_rdunlock(&dev->dma_bo_lock);
 }
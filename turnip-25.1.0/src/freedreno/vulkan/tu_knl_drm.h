@@ -20,6 +20,8 @@ VkResult tu_allocate_userspace_iova(struct tu_device *dev,
                                     enum tu_bo_alloc_flags flags,
                                     uint64_t *iova);
 int tu_drm_export_dmabuf(struct tu_device *dev, struct tu_bo *bo);
+void tu_drm_bo_untrack(struct tu_device *dev, struct tu_bo *bo);
+void tu_drm_bo_release(struct tu_device *dev, struct tu_bo *bo);
 void tu_drm_bo_finish(struct tu_device *dev, struct tu_bo *bo);
 
 struct tu_msm_queue_submit
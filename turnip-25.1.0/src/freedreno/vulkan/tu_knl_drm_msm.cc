@@ -732,10 +732,12 @@ msm_bo_init_dmabuf(struct tu_device *dev,
    VkResult result =
       tu_bo_init(dev, NULL, bo, gem_handle, size, 0, TU_BO_ALLOC_DMABUF, "dmabuf");
 
-   if (result != VK_SUCCESS)
+   if (result != VK_SUCCESS) {
       memset(bo, 0, sizeof(*bo));
-   else
+   } else {
+      tu_mem_stats_add(dev, bo, TU_MEM_CATEGORY_IMPORTED);
       *out_bo = bo;
+   }
 
    msm_vma_unlock(dev);
    u_rwlock_wrunlock(&dev->dma_bo_lock);
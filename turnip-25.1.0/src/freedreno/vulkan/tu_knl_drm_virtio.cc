@@ -21,6 +21,7 @@
 #include "util/u_debug.h"
 #include "util/hash_table.h"
 #include "util/libsync.h"
+#include "util/os_time.h"
 #include "util/u_process.h"
 
 #include "tu_cmd_buffer.h"
@@ -204,6 +205,10 @@ virtio_device_init(struct tu_device *dev)
 
    u_vector_init(&vdev->zombie_vmas_stage_2, 64, sizeof(struct tu_zombie_vma));
 
+   mtx_init(&dev->bo_cache.lock, mtx_plain);
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++)
+      util_dynarray_init(&dev->bo_cache.buckets[i], NULL);
+
    dev->vdev = vdev;
    dev->fd = fd;
 
@@ -230,6 +235,20 @@ virtio_device_finish(struct tu_device *dev)
 
    u_vector_finish(&vdev->zombie_vmas_stage_2);
 
+   /* This may run after the BO sparse array is gone, so only use the
+    * entries themselves. The iovas go away with the VMA heap.
+    */
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++) {
+      util_dynarray_foreach(&dev->bo_cache.buckets[i], struct tu_bo_cache_entry, entry) {
+         if (entry->map)
+            munmap(entry->map, entry->size);
+         vdrm_bo_close(vdev->vdrm, entry->gem_handle);
+         tu_mem_stats_del_size(dev, TU_MEM_CATEGORY_BO_CACHE, entry->size);
+      }
+      util_dynarray_fini(&dev->bo_cache.buckets[i]);
+   }
+   mtx_destroy(&dev->bo_cache.lock);
+
    vdrm_device_close(vdev->vdrm);
 
    vk_free(&instance->vk.alloc, vdev);
@@ -675,6 +694,107 @@ tu_bo_set_kernel_name(struct tu_device *dev, struct tu_bo *bo, const char *name)
    vdrm_send_req(dev->vdev->vdrm, &req->hdr, false);
 }
 
+/* Returns the cache bucket for a (power of two) size, or -1 if BOs of that
+ * size aren't cached.
+ */
+static int
+virtio_bo_cache_bucket(uint64_t size)
+{
+   if (size < (1ull << TU_BO_CACHE_MIN_SIZE_LOG2) ||
+       size > (1ull << TU_BO_CACHE_MAX_SIZE_LOG2) ||
+       !util_is_power_of_two_or_zero64(size))
+      return -1;
+   return util_logbase2_64(size) - TU_BO_CACHE_MIN_SIZE_LOG2;
+}
+
+/* Frees cached BOs that have been idle for too long, cache lock held. */
+static void
+virtio_bo_cache_trim(struct tu_device *dev, int64_t now)
+{
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++) {
+      struct util_dynarray *bucket = &dev->bo_cache.buckets[i];
+      unsigned count = util_dynarray_num_elements(bucket, struct tu_bo_cache_entry);
+      unsigned expired = 0;
+      while (expired < count) {
+         struct tu_bo_cache_entry *entry =
+            util_dynarray_element(bucket, struct tu_bo_cache_entry, expired);
+         if (now - entry->free_time < TU_BO_CACHE_TIMEOUT_NS)
+            break;
+         struct tu_bo *bo = tu_device_lookup_bo(dev, entry->res_id);
+         if (entry->map)
+            munmap(entry->map, entry->size);
+         tu_mem_stats_del(dev, bo);
+         tu_drm_bo_release(dev, bo);
+         expired++;
+      }
+      if (!expired)
+         continue;
+      struct tu_bo_cache_entry *entries =
+         (struct tu_bo_cache_entry *) util_dynarray_begin(bucket);
+      memmove(entries, entries + expired,
+              (count - expired) * sizeof(struct tu_bo_cache_entry));
+      bucket->size -= expired * sizeof(struct tu_bo_cache_entry);
+   }
+}
+
+static struct tu_bo *
+virtio_bo_cache_get(struct tu_device *dev, uint64_t size, uint32_t flags)
+{
+   int idx = virtio_bo_cache_bucket(size);
+   if (idx < 0)
+      return NULL;
+
+   struct tu_bo *bo = NULL;
+   mtx_lock(&dev->bo_cache.lock);
+   virtio_bo_cache_trim(dev, os_time_get_nano());
+   struct util_dynarray *bucket = &dev->bo_cache.buckets[idx];
+   unsigned count = util_dynarray_num_elements(bucket, struct tu_bo_cache_entry);
+   /* most recently freed first, since it is the most likely to be hot */
+   for (int i = count - 1; i >= 0; i--) {
+      struct tu_bo_cache_entry *entry =
+         util_dynarray_element(bucket, struct tu_bo_cache_entry, i);
+      if (entry->alloc_flags != flags)
+         continue;
+      bo = tu_device_lookup_bo(dev, entry->res_id);
+      memmove(entry, entry + 1, (count - i - 1) * sizeof(*entry));
+      bucket->size -= sizeof(*entry);
+      break;
+   }
+   mtx_unlock(&dev->bo_cache.lock);
+   return bo;
+}
+
+/* Returns true if the BO was taken by the cache. */
+static bool
+virtio_bo_cache_put(struct tu_device *dev, struct tu_bo *bo)
+{
+   int idx = virtio_bo_cache_bucket(bo->size);
+   if (idx < 0)
+      return false;
+
+   int64_t now = os_time_get_nano();
+   mtx_lock(&dev->bo_cache.lock);
+   virtio_bo_cache_trim(dev, now);
+   struct util_dynarray *bucket = &dev->bo_cache.buckets[idx];
+   if (util_dynarray_num_elements(bucket, struct tu_bo_cache_entry) >=
+       TU_BO_CACHE_MAX_BUCKET_ENTRIES) {
+      mtx_unlock(&dev->bo_cache.lock);
+      return false;
+   }
+   struct tu_bo_cache_entry entry = {
+      .gem_handle = bo->gem_handle,
+      .res_id = bo->res_id,
+      .alloc_flags = bo->virtio_alloc_flags,
+      .map = bo->map,
+      .size = bo->size,
+      .free_time = now,
+   };
+   util_dynarray_append(bucket, struct tu_bo_cache_entry, entry);
+   tu_mem_stats_add(dev, bo, TU_MEM_CATEGORY_BO_CACHE);
+   mtx_unlock(&dev->bo_cache.lock);
+   return true;
+}
+
 static VkResult
 virtio_bo_init(struct tu_device *dev,
                struct vk_object_base *base,
@@ -721,6 +841,49 @@ virtio_bo_init(struct tu_device *dev,
 
    assert(!(flags & TU_BO_ALLOC_DMABUF));
 
+   /* Every allocation is a GEM_NEW ccmd plus a blob resource creation,
+    * which is a round trip to the host, so recycle the BOs whose address
+    * the caller doesn't control. The MSM_BO_* flags used here don't overlap
+    * with the blob flags.
+    */
+   uint32_t alloc_flags = req.flags | blob_flags;
+   bool cacheable = (flags & TU_BO_ALLOC_CACHEABLE) &&
+                    !(flags & TU_BO_ALLOC_REPLAYABLE) && !client_iova;
+   if (cacheable) {
+      uint64_t cache_size =
+         util_next_power_of_two64(MAX2(size, 1ull << TU_BO_CACHE_MIN_SIZE_LOG2));
+      if (virtio_bo_cache_bucket(cache_size) >= 0) {
+         bo = virtio_bo_cache_get(dev, cache_size, alloc_flags);
+         if (bo) {
+            /* the mapping stays with the cached BO */
+            void *map = bo->map;
+            uint64_t iova = bo->iova;
+            result = tu_bo_init(dev, base, bo, bo->gem_handle, bo->size,
+                                iova, flags, name);
+            if (result != VK_SUCCESS) {
+               /* tu_bo_init() closed the handle */
+               if (map)
+                  munmap(map, cache_size);
+               memset(bo, 0, sizeof(*bo));
+               mtx_lock(&dev->vma_mutex);
+               util_vma_heap_free(&dev->vma, iova, cache_size);
+               mtx_unlock(&dev->vma_mutex);
+               return result;
+            }
+
+            bo->map = map;
+            bo->virtio_alloc_flags = alloc_flags;
+            bo->cacheable = true;
+
+            *out_bo = bo;
+            return VK_SUCCESS;
+         }
+         size = req.size = cache_size;
+      } else {
+         cacheable = false;
+      }
+   }
+
    mtx_lock(&dev->vma_mutex);
    result = virtio_allocate_userspace_iova_locked(dev, 0, size, client_iova,
                                                   flags, &req.iova);
@@ -755,6 +918,9 @@ virtio_bo_init(struct tu_device *dev,
       goto fail;
    }
 
+   bo->virtio_alloc_flags = alloc_flags;
+   bo->cacheable = cacheable;
+
    *out_bo = bo;
 
    /* We don't use bo->name here because for the !TU_DEBUG=bo case bo->name is NULL. */
@@ -852,6 +1018,7 @@ virtio_bo_init_dmabuf(struct tu_device *dev,
       util_vma_heap_free(&dev->vma, iova, size);
       memset(bo, 0, sizeof(*bo));
    } else {
+      tu_mem_stats_add(dev, bo, TU_MEM_CATEGORY_IMPORTED);
       *out_bo = bo;
    }
 
@@ -881,6 +1048,32 @@ virtio_bo_map(struct tu_device *dev, struct tu_bo *bo, void *placed_addr)
    return VK_SUCCESS;
 }
 
+static void
+virtio_bo_finish(struct tu_device *dev, struct tu_bo *bo)
+{
+   if (!bo->cacheable) {
+      tu_drm_bo_finish(dev, bo);
+      return;
+   }
+
+   /* Cacheable BOs are never exported or imported, so they don't need the
+    * dma_bo_lock.
+    */
+   if (!p_atomic_dec_zero(&bo->refcnt))
+      return;
+
+   /* Drop the tracking before another thread can take it from the cache.
+    * Cached BOs keep their iova and mapping for whoever gets them next.
+    */
+   tu_drm_bo_untrack(dev, bo);
+   if (virtio_bo_cache_put(dev, bo))
+      return;
+
+   if (bo->map)
+      munmap(bo->map, bo->size);
+   tu_drm_bo_release(dev, bo);
+}
+
 static void
 virtio_bo_allow_dump(struct tu_device *dev, struct tu_bo *bo)
 {
@@ -899,7 +1092,7 @@ setup_fence_cmds(struct tu_device *dev)
    result = tu_bo_init_new(dev, NULL, &vdev->fence_cmds_mem,
                            sizeof(*vdev->fence_cmds), (enum tu_bo_alloc_flags)
                               (TU_BO_ALLOC_ALLOW_DUMP | TU_BO_ALLOC_GPU_READ_ONLY),
-                           "fence_cmds");
+                           TU_MEM_CATEGORY_INTERNAL, "fence_cmds");
    if (result != VK_SUCCESS)
       return result;
 
@@ -1158,7 +1351,7 @@ static const struct tu_knl virtio_knl_funcs = {
       .bo_export_dmabuf = virtio_bo_export_dmabuf,
       .bo_map = virtio_bo_map,
       .bo_allow_dump = virtio_bo_allow_dump,
-      .bo_finish = tu_drm_bo_finish,
+      .bo_finish = virtio_bo_finish,
       .submit_create = msm_submit_create,
       .submit_finish = msm_submit_finish,
       .submit_add_entries = msm_submit_add_entries,
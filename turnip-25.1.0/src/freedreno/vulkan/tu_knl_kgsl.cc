@@ -11,6 +11,7 @@
 #include <stdint.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <linux/dma-heap.h>
 
 #define __user
@@ -20,7 +21,10 @@
 
 #include "vk_util.h"
 
+#include "util/hash_table.h"
 #include "util/os_file.h"
+#include "util/os_time.h"
+#include "util/perf/u_stall.h"
 #include "util/u_debug.h"
 #include "util/u_vector.h"
 #include "util/libsync.h"
@@ -36,6 +40,10 @@
 /* ION_HEAP(ION_SYSTEM_HEAP_ID) */
 #define KGSL_ION_SYSTEM_HEAP_MASK (1u << 25)
 
+/* BOs at least this large are allocated and CPU-mapped for huge pages. */
+#define KGSL_HUGEPAGE_SIZE_LOG2 21
+#define KGSL_HUGEPAGE_SIZE (1ull << KGSL_HUGEPAGE_SIZE_LOG2)
+
 
 static int
 safe_ioctl(int fd, unsigned long request, void *arg)
@@ -81,6 +89,119 @@ kgsl_submitqueue_close(struct tu_device *dev, uint32_t queue_id)
 
 static void kgsl_bo_finish(struct tu_device *dev, struct tu_bo *bo);
 
+static void
+kgsl_bo_cache_entry_free(struct tu_device *dev, struct tu_bo_cache_entry *entry)
+{
+   if (entry->map)
+      munmap(entry->map, entry->size);
+
+   struct kgsl_gpumem_free_id req = {
+      .id = entry->gem_handle
+   };
+
+   safe_ioctl(dev->physical_device->local_fd, IOCTL_KGSL_GPUMEM_FREE_ID, &req);
+}
+
+/* Returns the cache bucket for a (power of two) size, or -1 if BOs of that
+ * size aren't cached.
+ */
+static int
+kgsl_bo_cache_bucket(uint64_t size)
+{
+   if (size < (1ull << TU_BO_CACHE_MIN_SIZE_LOG2) ||
+       size > (1ull << TU_BO_CACHE_MAX_SIZE_LOG2) ||
+       !util_is_power_of_two_or_zero64(size))
+      return -1;
+   return util_logbase2_64(size) - TU_BO_CACHE_MIN_SIZE_LOG2;
+}
+
+/* Frees cached BOs that have been idle for too long, cache lock held. */
+static void
+kgsl_bo_cache_trim(struct tu_device *dev, int64_t now)
+{
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++) {
+      struct util_dynarray *bucket = &dev->bo_cache.buckets[i];
+      unsigned count = util_dynarray_num_elements(bucket, struct tu_bo_cache_entry);
+      unsigned expired = 0;
+      while (expired < count) {
+         struct tu_bo_cache_entry *entry =
+            util_dynarray_element(bucket, struct tu_bo_cache_entry, expired);
+         if (now - entry->free_time < TU_BO_CACHE_TIMEOUT_NS)
+            break;
+         struct tu_bo *bo = tu_device_lookup_bo(dev, entry->gem_handle);
+         tu_mem_stats_del(dev, bo);
+         /* Tell sparse array that entry is free */
+         memset(bo, 0, sizeof(struct tu_bo));
+         kgsl_bo_cache_entry_free(dev, entry);
+         expired++;
+      }
+      if (!expired)
+         continue;
+      struct tu_bo_cache_entry *entries =
+         (struct tu_bo_cache_entry *) util_dynarray_begin(bucket);
+      memmove(entries, entries + expired,
+              (count - expired) * sizeof(struct tu_bo_cache_entry));
+      bucket->size -= expired * sizeof(struct tu_bo_cache_entry);
+   }
+}
+
+static struct tu_bo *
+kgsl_bo_cache_get(struct tu_device *dev, uint64_t size, uint32_t flags)
+{
+   int idx = kgsl_bo_cache_bucket(size);
+   if (idx < 0)
+      return NULL;
+
+   struct tu_bo *bo = NULL;
+   mtx_lock(&dev->bo_cache.lock);
+   kgsl_bo_cache_trim(dev, os_time_get_nano());
+   struct util_dynarray *bucket = &dev->bo_cache.buckets[idx];
+   unsigned count = util_dynarray_num_elements(bucket, struct tu_bo_cache_entry);
+   /* most recently freed first, since it is the most likely to be hot */
+   for (int i = count - 1; i >= 0; i--) {
+      struct tu_bo_cache_entry *entry =
+         util_dynarray_element(bucket, struct tu_bo_cache_entry, i);
+      if (entry->alloc_flags != flags)
+         continue;
+      bo = tu_device_lookup_bo(dev, entry->gem_handle);
+      memmove(entry, entry + 1, (count - i - 1) * sizeof(*entry));
+      bucket->size -= sizeof(*entry);
+      break;
+   }
+   mtx_unlock(&dev->bo_cache.lock);
+   return bo;
+}
+
+/* Returns true if the BO was taken by the cache. */
+static bool
+kgsl_bo_cache_put(struct tu_device *dev, struct tu_bo *bo)
+{
+   int idx = kgsl_bo_cache_bucket(bo->size);
+   if (!bo->cacheable || idx < 0)
+      return false;
+
+   int64_t now = os_time_get_nano();
+   mtx_lock(&dev->bo_cache.lock);
+   kgsl_bo_cache_trim(dev, now);
+   struct util_dynarray *bucket = &dev->bo_cache.buckets[idx];
+   if (util_dynarray_num_elements(bucket, struct tu_bo_cache_entry) >=
+       TU_BO_CACHE_MAX_BUCKET_ENTRIES) {
+      mtx_unlock(&dev->bo_cache.lock);
+      return false;
+   }
+   struct tu_bo_cache_entry entry = {
+      .gem_handle = bo->gem_handle,
+      .alloc_flags = bo->kgsl_alloc_flags,
+      .map = bo->map,
+      .size = bo->size,
+      .free_time = now,
+   };
+   util_dynarray_append(bucket, struct tu_bo_cache_entry, entry);
+   tu_mem_stats_add(dev, bo, TU_MEM_CATEGORY_BO_CACHE);
+   mtx_unlock(&dev->bo_cache.lock);
+   return true;
+}
+
 static VkResult
 bo_init_new_dmaheap(struct tu_device *dev, struct tu_bo **out_bo, uint64_t size,
                 enum tu_bo_alloc_flags flags)
@@ -165,6 +286,130 @@ bo_init_new_ion_legacy(struct tu_device *dev, struct tu_bo **out_bo, uint64_t si
    return tu_bo_init_dmabuf(dev, out_bo, -1, share.fd);
 }
 
+/* Lazy BOs are a sparse VA range, bound to a physical allocation of their
+ * whole size on commit.
+ */
+static VkResult
+kgsl_bo_init_lazy(struct tu_device *dev,
+                  struct vk_object_base *base,
+                  struct tu_bo **out_bo,
+                  uint64_t size,
+                  const char *name)
+{
+   struct kgsl_sparse_virt_alloc req = {
+      .size = align64(size, 4096),
+      .pagesize = 4096,
+   };
+
+   int ret = safe_ioctl(dev->physical_device->local_fd,
+                        IOCTL_KGSL_SPARSE_VIRT_ALLOC, &req);
+   if (ret) {
+      return vk_errorf(dev, VK_ERROR_OUT_OF_DEVICE_MEMORY,
+                       "SPARSE_VIRT_ALLOC failed (%s)", strerror(errno));
+   }
+
+   struct tu_bo* bo = tu_device_lookup_bo(dev, req.id);
+   assert(bo && bo->gem_handle == 0);
+
+   *bo = (struct tu_bo) {
+      .gem_handle = req.id,
+      .size = req.size,
+      .iova = req.gpuaddr,
+      .name = tu_debug_bos_add(dev, req.size, name),
+      .refcnt = 1,
+      .dump_bo_list_idx = ~0u,
+      .shared_fd = -1,
+      .lazy = true,
+      .base = base,
+   };
+
+   *out_bo = bo;
+
+   TU_RMV(bo_allocate, dev, bo);
+
+   return VK_SUCCESS;
+}
+
+static VkResult
+kgsl_bo_commit(struct tu_device *dev, struct tu_bo *bo)
+{
+   int fd = dev->physical_device->local_fd;
+
+   struct kgsl_sparse_phys_alloc req_phys = {
+      .size = bo->size,
+      .pagesize = 4096,
+      .flags = KGSL_CACHEMODE_WRITECOMBINE << KGSL_CACHEMODE_SHIFT,
+   };
+
+   int ret = safe_ioctl(fd, IOCTL_KGSL_SPARSE_PHYS_ALLOC, &req_phys);
+   if (ret) {
+      return vk_errorf(dev, VK_ERROR_OUT_OF_DEVICE_MEMORY,
+                       "SPARSE_PHYS_ALLOC failed (%s)", strerror(errno));
+   }
+
+   struct kgsl_sparse_binding_object bind = {
+      .size = bo->size,
+      .flags = KGSL_SPARSE_BIND,
+      .id = req_phys.id,
+   };
+   struct kgsl_sparse_bind req_bind = {
+      .list = (uintptr_t) &bind,
+      .id = bo->gem_handle,
+      .size = sizeof(bind),
+      .count = 1,
+   };
+
+   ret = safe_ioctl(fd, IOCTL_KGSL_SPARSE_BIND, &req_bind);
+   if (ret) {
+      struct kgsl_sparse_phys_free req_free = { .id = req_phys.id };
+      safe_ioctl(fd, IOCTL_KGSL_SPARSE_PHYS_FREE, &req_free);
+      return vk_errorf(dev, VK_ERROR_OUT_OF_DEVICE_MEMORY,
+                       "SPARSE_BIND failed (%s)", strerror(errno));
+   }
+
+   bo->lazy_backing = req_phys.id;
+
+   return VK_SUCCESS;
+}
+
+static void
+kgsl_lazy_bo_free(struct tu_device *dev, struct tu_bo *bo)
+{
+   int fd = dev->physical_device->local_fd;
+   uint32_t virt_id = bo->gem_handle;
+   uint32_t phys_id = bo->lazy_backing;
+   uint64_t size = bo->size;
+
+   TU_RMV(bo_destroy, dev, bo);
+   tu_debug_bos_del(dev, bo);
+   tu_mem_stats_del(dev, bo);
+
+   /* Tell sparse array that entry is free */
+   memset(bo, 0, sizeof(*bo));
+
+   if (phys_id) {
+      struct kgsl_sparse_binding_object unbind = {
+         .size = size,
+         .flags = KGSL_SPARSE_UNBIND,
+      };
+      struct kgsl_sparse_bind req_unbind = {
+         .list = (uintptr_t) &unbind,
+         .id = virt_id,
+         .size = sizeof(unbind),
+         .count = 1,
+      };
+      safe_ioctl(fd, IOCTL_KGSL_SPARSE_BIND, &req_unbind);
+   }
+
+   struct kgsl_sparse_virt_free req_virt = { .id = virt_id };
+   safe_ioctl(fd, IOCTL_KGSL_SPARSE_VIRT_FREE, &req_virt);
+
+   if (phys_id) {
+      struct kgsl_sparse_phys_free req_phys = { .id = phys_id };
+      safe_ioctl(fd, IOCTL_KGSL_SPARSE_PHYS_FREE, &req_phys);
+   }
+}
+
 static VkResult
 kgsl_bo_init(struct tu_device *dev,
              struct vk_object_base *base,
@@ -195,6 +440,9 @@ kgsl_bo_init(struct tu_device *dev,
       }
    }
 
+   if (flags & TU_BO_ALLOC_LAZY)
+      return kgsl_bo_init_lazy(dev, base, out_bo, size, name);
+
    struct kgsl_gpumem_alloc_id req = {
       .size = size,
    };
@@ -215,6 +463,43 @@ kgsl_bo_init(struct tu_device *dev,
    if (flags & TU_BO_ALLOC_REPLAYABLE)
       req.flags |= KGSL_MEMFLAGS_USE_CPU_MAP;
 
+   /* Lets kgsl back large BOs with its 2MB page pools, which is what makes
+    * huge CPU mappings in kgsl_bo_map() possible.
+    */
+   if (size >= KGSL_HUGEPAGE_SIZE)
+      req.flags |= (uint64_t) KGSL_HUGEPAGE_SIZE_LOG2 << KGSL_MEMALIGN_SHIFT;
+
+   /* Only round up and recycle BOs whose address the caller doesn't control. */
+   bool cacheable = (flags & TU_BO_ALLOC_CACHEABLE) &&
+                    !(flags & TU_BO_ALLOC_REPLAYABLE) && !client_iova;
+   if (cacheable) {
+      uint64_t cache_size =
+         util_next_power_of_two64(MAX2(size, 1ull << TU_BO_CACHE_MIN_SIZE_LOG2));
+      if (kgsl_bo_cache_bucket(cache_size) >= 0) {
+         struct tu_bo *bo = kgsl_bo_cache_get(dev, cache_size, req.flags);
+         if (bo) {
+            bo->name = tu_debug_bos_add(dev, bo->size, name);
+            bo->refcnt = 1;
+            bo->base = base;
+
+            tu_dump_bo_init(dev, bo);
+
+            *out_bo = bo;
+
+            TU_RMV(bo_allocate, dev, bo);
+            if (flags & TU_BO_ALLOC_INTERNAL_RESOURCE) {
+               TU_RMV(internal_resource_create, dev, bo);
+               TU_RMV(resource_name, dev, bo, name);
+            }
+
+            return VK_SUCCESS;
+         }
+         req.size = cache_size;
+      } else {
+         cacheable = false;
+      }
+   }
+
    int ret;
 
    ret = safe_ioctl(dev->physical_device->local_fd,
@@ -234,6 +519,8 @@ kgsl_bo_init(struct tu_device *dev,
       .name = tu_debug_bos_add(dev, req.mmapsize, name),
       .refcnt = 1,
       .shared_fd = -1,
+      .kgsl_alloc_flags = (uint32_t) req.flags,
+      .cacheable = cacheable,
       .base = base,
    };
 
@@ -294,11 +581,36 @@ kgsl_bo_init_dmabuf(struct tu_device *dev,
    };
    int ret;
 
+   /* Unlike DRM, kgsl hands out a new id each time the same dma-buf is
+    * imported. Swapchain and AHardwareBuffer images get re-imported
+    * whenever they are recreated, so reuse the BO of an earlier import of
+    * the same buffer, identified by its inode, while it is alive.
+    */
+   struct stat st;
+   uint64_t ino = fstat(fd, &st) == 0 ? st.st_ino : 0;
+
+   u_rwlock_wrlock(&dev->dma_bo_lock);
+
+   if (ino) {
+      uint32_t handle = (uintptr_t)
+         _mesa_hash_table_u64_search(dev->dmabuf_bos, ino);
+      if (handle) {
+         struct tu_bo *bo = tu_device_lookup_bo(dev, handle);
+         p_atomic_inc(&bo->refcnt);
+         u_rwlock_wrunlock(&dev->dma_bo_lock);
+
+         *out_bo = bo;
+         return VK_SUCCESS;
+      }
+   }
+
    ret = safe_ioctl(dev->physical_device->local_fd,
                     IOCTL_KGSL_GPUOBJ_IMPORT, &req);
-   if (ret)
+   if (ret) {
+      u_rwlock_wrunlock(&dev->dma_bo_lock);
       return vk_errorf(dev, VK_ERROR_OUT_OF_DEVICE_MEMORY,
                        "Failed to import dma-buf (%s)\n", strerror(errno));
+   }
 
    struct kgsl_gpuobj_info info_req = {
       .id = req.id,
@@ -306,9 +618,16 @@ kgsl_bo_init_dmabuf(struct tu_device *dev,
 
    ret = safe_ioctl(dev->physical_device->local_fd,
                     IOCTL_KGSL_GPUOBJ_INFO, &info_req);
-   if (ret)
+   if (ret) {
+      struct kgsl_gpumem_free_id free_req = {
+         .id = req.id,
+      };
+      safe_ioctl(dev->physical_device->local_fd,
+                 IOCTL_KGSL_GPUMEM_FREE_ID, &free_req);
+      u_rwlock_wrunlock(&dev->dma_bo_lock);
       return vk_errorf(dev, VK_ERROR_OUT_OF_DEVICE_MEMORY,
                        "Failed to get dma-buf info (%s)\n", strerror(errno));
+   }
 
    struct tu_bo* bo = tu_device_lookup_bo(dev, req.id);
    assert(bo && bo->gem_handle == 0);
@@ -320,7 +639,16 @@ kgsl_bo_init_dmabuf(struct tu_device *dev,
       .name = tu_debug_bos_add(dev, info_req.size, "dmabuf"),
       .refcnt = 1,
       .shared_fd = os_dupfd_cloexec(fd),
+      .dmabuf_ino = ino,
    };
+   tu_mem_stats_add(dev, bo, TU_MEM_CATEGORY_IMPORTED);
+
+   if (ino) {
+      _mesa_hash_table_u64_insert(dev->dmabuf_bos, ino,
+                                  (void *) (uintptr_t) req.id);
+   }
+
+   u_rwlock_wrunlock(&dev->dma_bo_lock);
 
    tu_dump_bo_init(dev, bo);
 
@@ -336,15 +664,55 @@ kgsl_bo_export_dmabuf(struct tu_device *dev, struct tu_bo *bo)
    return os_dupfd_cloexec(bo->shared_fd);
 }
 
+/* Places a large BO on a 2MB boundary so that the kernel can map it with
+ * huge pages, saving TLB misses on big uploads and readbacks. Enough address
+ * space to align within is reserved, then the BO is mapped over it.
+ */
+static void *
+kgsl_bo_map_huge(struct tu_device *dev, struct tu_bo *bo, uint64_t offset)
+{
+   size_t reserve_size = bo->size + KGSL_HUGEPAGE_SIZE;
+   void *reserve = mmap(0, reserve_size, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+   if (reserve == MAP_FAILED)
+      return MAP_FAILED;
+
+   uintptr_t start = (uintptr_t) reserve;
+   uintptr_t aligned = align64(start, KGSL_HUGEPAGE_SIZE);
+   uintptr_t end = start + reserve_size;
+
+   void *map = mmap((void *) aligned, bo->size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_FIXED, dev->physical_device->local_fd,
+                    offset);
+   if (map == MAP_FAILED) {
+      munmap(reserve, reserve_size);
+      return MAP_FAILED;
+   }
+
+   if (aligned > start)
+      munmap(reserve, aligned - start);
+   if (end > aligned + bo->size)
+      munmap((void *) (aligned + bo->size), end - (aligned + bo->size));
+
+   /* Only a hint, kernels without THP for kgsl mappings refuse it. */
+   madvise(map, bo->size, MADV_HUGEPAGE);
+
+   return map;
+}
+
 static VkResult
 kgsl_bo_map(struct tu_device *dev, struct tu_bo *bo, void *placed_addr)
 {
    void *map = MAP_FAILED;
    if (bo->shared_fd == -1) {
       uint64_t offset = bo->gem_handle << 12;
-      map = mmap(placed_addr, bo->size, PROT_READ | PROT_WRITE,
-                 MAP_SHARED | (placed_addr != NULL ? MAP_FIXED : 0),
-                 dev->physical_device->local_fd, offset);
+      if (!placed_addr && bo->size >= KGSL_HUGEPAGE_SIZE) {
+         map = kgsl_bo_map_huge(dev, bo, offset);
+      } else {
+         map = mmap(placed_addr, bo->size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | (placed_addr != NULL ? MAP_FIXED : 0),
+                    dev->physical_device->local_fd, offset);
+      }
    } else {
       map = mmap(placed_addr, bo->size, PROT_READ | PROT_WRITE,
                  MAP_SHARED | (placed_addr != NULL ? MAP_FIXED : 0),
@@ -370,20 +738,51 @@ kgsl_bo_finish(struct tu_device *dev, struct tu_bo *bo)
 {
    assert(bo->gem_handle);
 
-   if (!p_atomic_dec_zero(&bo->refcnt))
+   if (bo->dmabuf_ino) {
+      /* Imports of the same dma-buf look the BO up under the lock. */
+      u_rwlock_wrlock(&dev->dma_bo_lock);
+      if (!p_atomic_dec_zero(&bo->refcnt)) {
+         u_rwlock_wrunlock(&dev->dma_bo_lock);
+         return;
+      }
+      _mesa_hash_table_u64_remove(dev->dmabuf_bos, bo->dmabuf_ino);
+      u_rwlock_wrunlock(&dev->dma_bo_lock);
+   } else if (!p_atomic_dec_zero(&bo->refcnt)) {
+      return;
+   }
+
+   if (bo->lazy) {
+      kgsl_lazy_bo_free(dev, bo);
       return;
+   }
+
+   if (bo->cacheable) {
+      /* Drop the tracking before another thread can take it from the cache.
+       * Cached BOs keep their mapping for whoever gets them next.
+       */
+      TU_RMV(bo_destroy, dev, bo);
+      tu_debug_bos_del(dev, bo);
+      tu_mem_stats_del(dev, bo);
+      tu_dump_bo_del(dev, bo);
+      if (kgsl_bo_cache_put(dev, bo))
+         return;
+   }
 
    if (bo->map) {
-      TU_RMV(bo_unmap, dev, bo);
+      if (!bo->cacheable)
+         TU_RMV(bo_unmap, dev, bo);
       munmap(bo->map, bo->size);
    }
 
    if (bo->shared_fd != -1)
       close(bo->shared_fd);
 
-   TU_RMV(bo_destroy, dev, bo);
-   tu_debug_bos_del(dev, bo);
-   tu_dump_bo_del(dev, bo);
+   if (!bo->cacheable) {
+      TU_RMV(bo_destroy, dev, bo);
+      tu_debug_bos_del(dev, bo);
+      tu_mem_stats_del(dev, bo);
+      tu_dump_bo_del(dev, bo);
+   }
 
    struct kgsl_gpumem_free_id req = {
       .id = bo->gem_handle
@@ -429,6 +828,24 @@ kgsl_is_memory_type_supported(int fd, uint32_t flags)
    return true;
 }
 
+static bool
+kgsl_has_sparse_memory(int fd)
+{
+   struct kgsl_sparse_virt_alloc req_alloc = {
+      .size = 0x1000,
+      .pagesize = 0x1000,
+   };
+
+   if (safe_ioctl(fd, IOCTL_KGSL_SPARSE_VIRT_ALLOC, &req_alloc))
+      return false;
+
+   struct kgsl_sparse_virt_free req_free = { .id = req_alloc.id };
+
+   safe_ioctl(fd, IOCTL_KGSL_SPARSE_VIRT_FREE, &req_free);
+
+   return true;
+}
+
 enum kgsl_syncobj_state {
    KGSL_SYNCOBJ_STATE_UNSIGNALED,
    KGSL_SYNCOBJ_STATE_SIGNALED,
@@ -522,6 +939,78 @@ timestamp_cmp(uint32_t a, uint32_t b)
    return (int32_t) (a - b) >= 0;
 }
 
+/* Returns a sync file for a timestamp that the caller may poll or merge,
+ * but must give back with kgsl_queue_ts_fd_put() instead of closing.  Sync
+ * files are shared with other waits on the same timestamp, which saves the
+ * TIMESTAMP_EVENT ioctl and the fence setup in the kernel when the same
+ * fence is waited on or polled repeatedly.
+ */
+static int
+kgsl_queue_ts_fd_get(struct tu_queue *queue, uint32_t timestamp)
+{
+   mtx_lock(&queue->ts_fd_lock);
+   for (unsigned i = 0; i < ARRAY_SIZE(queue->ts_fds); i++) {
+      struct tu_queue_ts_fd *entry = &queue->ts_fds[i];
+      if (entry->fd >= 0 && entry->timestamp == timestamp) {
+         entry->users++;
+         mtx_unlock(&queue->ts_fd_lock);
+         return entry->fd;
+      }
+   }
+   mtx_unlock(&queue->ts_fd_lock);
+
+   int fd = timestamp_to_fd(queue, timestamp);
+   if (fd < 0)
+      return fd;
+
+   /* replace the oldest unused entry, if there is one */
+   mtx_lock(&queue->ts_fd_lock);
+   struct tu_queue_ts_fd *slot = NULL;
+   for (unsigned i = 0; i < ARRAY_SIZE(queue->ts_fds); i++) {
+      struct tu_queue_ts_fd *entry = &queue->ts_fds[i];
+      if (entry->users)
+         continue;
+      if (entry->fd < 0) {
+         slot = entry;
+         break;
+      }
+      if (!slot || timestamp_cmp(slot->timestamp, entry->timestamp))
+         slot = entry;
+   }
+   if (slot) {
+      if (slot->fd >= 0)
+         close(slot->fd);
+      slot->timestamp = timestamp;
+      slot->fd = fd;
+      slot->users = 1;
+   }
+   mtx_unlock(&queue->ts_fd_lock);
+
+   return fd;
+}
+
+static void
+kgsl_queue_ts_fd_put(struct tu_queue *queue, int fd)
+{
+   if (fd < 0)
+      return;
+
+   mtx_lock(&queue->ts_fd_lock);
+   for (unsigned i = 0; i < ARRAY_SIZE(queue->ts_fds); i++) {
+      struct tu_queue_ts_fd *entry = &queue->ts_fds[i];
+      if (entry->fd == fd) {
+         assert(entry->users);
+         entry->users--;
+         mtx_unlock(&queue->ts_fd_lock);
+         return;
+      }
+   }
+   mtx_unlock(&queue->ts_fd_lock);
+
+   /* it didn't fit in the cache */
+   close(fd);
+}
+
 static uint32_t
 max_ts(uint32_t a, uint32_t b)
 {
@@ -534,6 +1023,42 @@ min_ts(uint32_t a, uint32_t b)
    return timestamp_cmp(a, b) ? b : a;
 }
 
+static bool
+kgsl_queue_ts_retired(struct tu_queue *queue, uint32_t timestamp)
+{
+   int64_t retired = p_atomic_read(&queue->retired_timestamp);
+   return retired >= 0 && timestamp_cmp((uint32_t) retired, timestamp);
+}
+
+static void
+kgsl_queue_set_retired(struct tu_queue *queue, uint32_t timestamp)
+{
+   int64_t old = p_atomic_read(&queue->retired_timestamp);
+   while (old < 0 || !timestamp_cmp((uint32_t) old, timestamp)) {
+      int64_t prev = p_atomic_cmpxchg(&queue->retired_timestamp, old,
+                                      (int64_t) timestamp);
+      if (prev == old)
+         break;
+      old = prev;
+   }
+}
+
+/* Refreshes the retired timestamp of a queue from the kernel, which answers
+ * for all the fences of the queue at once.
+ */
+static void
+kgsl_queue_read_retired(struct tu_queue *queue)
+{
+   struct kgsl_cmdstream_readtimestamp_ctxtid req = {
+      .context_id = queue->msm_queue_id,
+      .type = KGSL_TIMESTAMP_RETIRED,
+   };
+
+   if (!safe_ioctl(queue->device->fd,
+                   IOCTL_KGSL_CMDSTREAM_READTIMESTAMP_CTXTID, &req))
+      kgsl_queue_set_retired(queue, req.timestamp);
+}
+
 static int
 get_relative_ms(uint64_t abs_timeout_ns)
 {
@@ -591,16 +1116,23 @@ VkResult
 kgsl_queue_wait_fence(struct tu_queue *queue, uint32_t fence,
                       uint64_t timeout_ns)
 {
+   if (kgsl_queue_ts_retired(queue, fence))
+      return VK_SUCCESS;
+
    uint64_t abs_timeout_ns = os_time_get_nano() + timeout_ns;
 
-   return wait_timestamp_safe(queue->device->fd, queue->msm_queue_id,
-                              fence, abs_timeout_ns);
+   VkResult result = wait_timestamp_safe(queue->device->fd,
+                                         queue->msm_queue_id, fence,
+                                         abs_timeout_ns);
+   if (result == VK_SUCCESS)
+      kgsl_queue_set_retired(queue, fence);
+   return result;
 }
 
 static VkResult
-kgsl_syncobj_wait(struct tu_device *device,
-                  struct kgsl_syncobj *s,
-                  uint64_t abs_timeout_ns)
+kgsl_syncobj_do_wait(struct tu_device *device,
+                     struct kgsl_syncobj *s,
+                     uint64_t abs_timeout_ns)
 {
    if (s->state == KGSL_SYNCOBJ_STATE_UNSIGNALED) {
       /* If this syncobj is unsignaled we need to wait for it to resolve to a
@@ -642,8 +1174,21 @@ kgsl_syncobj_wait(struct tu_device *device,
       return VK_TIMEOUT;
 
    case KGSL_SYNCOBJ_STATE_TS: {
-      return wait_timestamp_safe(device->fd, s->queue->msm_queue_id,
-                                 s->timestamp, abs_timeout_ns);
+      if (kgsl_queue_ts_retired(s->queue, s->timestamp))
+         return VK_SUCCESS;
+
+      /* status checks: one read covers every fence of the queue */
+      if (abs_timeout_ns == 0) {
+         kgsl_queue_read_retired(s->queue);
+         return kgsl_queue_ts_retired(s->queue, s->timestamp) ? VK_SUCCESS
+                                                              : VK_TIMEOUT;
+      }
+
+      VkResult result = wait_timestamp_safe(device->fd, s->queue->msm_queue_id,
+                                            s->timestamp, abs_timeout_ns);
+      if (result == VK_SUCCESS)
+         kgsl_queue_set_retired(s->queue, s->timestamp);
+      return result;
    }
 
    case KGSL_SYNCOBJ_STATE_FD: {
@@ -661,6 +1206,29 @@ kgsl_syncobj_wait(struct tu_device *device,
    }
 }
 
+static VkResult
+kgsl_syncobj_wait(struct tu_device *device,
+                  struct kgsl_syncobj *s,
+                  uint64_t abs_timeout_ns)
+{
+   U_STALL_SITE(wait_site, "turnip syncobj wait");
+   static const char *const origins[] = {
+      [KGSL_SYNCOBJ_STATE_UNSIGNALED] = "not yet submitted",
+      [KGSL_SYNCOBJ_STATE_SIGNALED] = "signaled",
+      [KGSL_SYNCOBJ_STATE_TS] = "queue timestamp",
+      [KGSL_SYNCOBJ_STATE_FD] = "sync fd",
+   };
+
+   /* polls don't block */
+   if (!abs_timeout_ns || s->state == KGSL_SYNCOBJ_STATE_SIGNALED)
+      return kgsl_syncobj_do_wait(device, s, abs_timeout_ns);
+
+   bool stall = u_stall_begin(&wait_site, origins[s->state]);
+   VkResult result = kgsl_syncobj_do_wait(device, s, abs_timeout_ns);
+   u_stall_end(stall);
+   return result;
+}
+
 #define kgsl_syncobj_foreach_state(syncobjs, filter) \
    for (uint32_t i = 0; sync = syncobjs[i], i < count; i++) \
       if (sync->state == filter)
@@ -681,6 +1249,11 @@ kgsl_syncobj_wait_any(struct tu_device* device, struct kgsl_syncobj **syncobjs,
    kgsl_syncobj_foreach_state(syncobjs, KGSL_SYNCOBJ_STATE_SIGNALED)
       return VK_SUCCESS;
 
+   kgsl_syncobj_foreach_state(syncobjs, KGSL_SYNCOBJ_STATE_TS) {
+      if (kgsl_queue_ts_retired(sync->queue, sync->timestamp))
+         return VK_SUCCESS;
+   }
+
    kgsl_syncobj_foreach_state(syncobjs, KGSL_SYNCOBJ_STATE_FD)
       num_fds++;
 
@@ -704,14 +1277,17 @@ kgsl_syncobj_wait_any(struct tu_device* device, struct kgsl_syncobj **syncobjs,
 
    struct u_vector poll_fds = { 0 };
    uint32_t lowest_timestamp = 0;
+   /* the queues of the timestamp sync files at the start of poll_fds */
+   struct tu_queue *fd_queues[count];
 
    if (convert_ts_to_fd || num_fds > 0)
       u_vector_init(&poll_fds, 4, sizeof(struct pollfd));
 
    if (convert_ts_to_fd) {
       kgsl_syncobj_foreach_state(syncobjs, KGSL_SYNCOBJ_STATE_TS) {
+         fd_queues[u_vector_length(&poll_fds)] = sync->queue;
          struct pollfd *poll_fd = (struct pollfd *) u_vector_add(&poll_fds);
-         poll_fd->fd = timestamp_to_fd(sync->queue, sync->timestamp);
+         poll_fd->fd = kgsl_queue_ts_fd_get(sync->queue, sync->timestamp);
          poll_fd->events = POLLIN;
       }
    } else {
@@ -725,8 +1301,9 @@ kgsl_syncobj_wait_any(struct tu_device* device, struct kgsl_syncobj **syncobjs,
       }
 
       if (num_fds) {
+         fd_queues[0] = queue;
          struct pollfd *poll_fd = (struct pollfd *) u_vector_add(&poll_fds);
-         poll_fd->fd = timestamp_to_fd(queue, lowest_timestamp);
+         poll_fd->fd = kgsl_queue_ts_fd_get(queue, lowest_timestamp);
          poll_fd->events = POLLIN;
       }
    }
@@ -742,6 +1319,8 @@ kgsl_syncobj_wait_any(struct tu_device* device, struct kgsl_syncobj **syncobjs,
    if (u_vector_length(&poll_fds) == 0) {
       result = wait_timestamp_safe(device->fd, queue->msm_queue_id,
                                    lowest_timestamp, MIN2(abs_timeout_ns, INT64_MAX));
+      if (result == VK_SUCCESS)
+         kgsl_queue_set_retired(queue, lowest_timestamp);
    } else {
       int ret, i;
 
@@ -765,7 +1344,7 @@ kgsl_syncobj_wait_any(struct tu_device* device, struct kgsl_syncobj **syncobjs,
       } while (ret == -1 && (errno == EINTR || errno == EAGAIN));
 
       for (uint32_t i = 0; i < fds_count - num_fds; i++)
-         close(fds[i].fd);
+         kgsl_queue_ts_fd_put(fd_queues[i], fds[i].fd);
 
       if (ret != 0) {
          assert(errno == ETIME);
@@ -836,6 +1415,19 @@ sync_merge_close(const char *name, int fd1, int fd2, bool close_fd2)
    return fd;
 }
 
+/* Merges fd with the sync file for a timestamp, without closing fd. */
+static int
+sync_merge_ts(const char *name, int fd, struct tu_queue *queue, uint32_t timestamp)
+{
+   int ts_fd = kgsl_queue_ts_fd_get(queue, timestamp);
+   if (ts_fd < 0)
+      return -1;
+
+   int merged = sync_merge(name, fd, ts_fd);
+   kgsl_queue_ts_fd_put(queue, ts_fd);
+   return merged;
+}
+
 /* Merges multiple kgsl_syncobjs into a single one which is only signalled
  * after all submitted syncobjs are signalled
  */
@@ -864,14 +1456,18 @@ kgsl_syncobj_merge(const struct kgsl_syncobj **syncobjs, uint32_t count)
             if (ret.queue == sync->queue) {
                ret.timestamp = max_ts(ret.timestamp, sync->timestamp);
             } else {
+               int ret_fd = kgsl_queue_ts_fd_get(ret.queue, ret.timestamp);
                ret.state = KGSL_SYNCOBJ_STATE_FD;
-               int sync_fd = kgsl_syncobj_ts_to_fd(sync);
-               ret.fd = sync_merge_close("tu_sync", ret.fd, sync_fd, true);
+               ret.fd = sync_merge_ts("tu_sync", ret_fd, sync->queue,
+                                      sync->timestamp);
+               kgsl_queue_ts_fd_put(ret.queue, ret_fd);
                assert(ret.fd >= 0);
             }
          } else if (ret.state == KGSL_SYNCOBJ_STATE_FD) {
-            int sync_fd = kgsl_syncobj_ts_to_fd(sync);
-            ret.fd = sync_merge_close("tu_sync", ret.fd, sync_fd, true);
+            int merged = sync_merge_ts("tu_sync", ret.fd, sync->queue,
+                                       sync->timestamp);
+            close(ret.fd);
+            ret.fd = merged;
             assert(ret.fd >= 0);
          } else {
             ret = *sync;
@@ -884,8 +1480,8 @@ kgsl_syncobj_merge(const struct kgsl_syncobj **syncobjs, uint32_t count)
             assert(ret.fd >= 0);
          } else if (ret.state == KGSL_SYNCOBJ_STATE_TS) {
             ret.state = KGSL_SYNCOBJ_STATE_FD;
-            int sync_fd = kgsl_syncobj_ts_to_fd(sync);
-            ret.fd = sync_merge_close("tu_sync", ret.fd, sync_fd, true);
+            ret.fd = sync_merge_ts("tu_sync", sync->fd, ret.queue,
+                                   ret.timestamp);
             assert(ret.fd >= 0);
          } else {
             ret = *sync;
@@ -1086,6 +1682,42 @@ kgsl_submit_add_entries(struct tu_device *device, void *_submit,
    }
 }
 
+/* Upper bound on the IBs merged into one deferred submit. */
+#define TU_KGSL_MAX_DEFERRED_CMDS 256
+
+/* Submits the IBs of the submits held back by TU_DEBUG=defer_submit as a
+ * single GPU command. None of them had waits or signals, so the only thing
+ * to track is the queue timestamp.
+ */
+static VkResult
+kgsl_queue_flush(struct tu_queue *queue)
+{
+   if (queue->deferred_cmds.size == 0)
+      return VK_SUCCESS;
+
+   struct kgsl_gpu_command req = {
+      .flags = KGSL_CMDBATCH_SUBMIT_IB_LIST,
+      .cmdlist = (uintptr_t) queue->deferred_cmds.data,
+      .cmdsize = sizeof(struct kgsl_command_object),
+      .numcmds = util_dynarray_num_elements(&queue->deferred_cmds,
+                                            struct kgsl_command_object),
+      .context_id = queue->msm_queue_id,
+   };
+
+   int ret = safe_ioctl(queue->device->physical_device->local_fd,
+                        IOCTL_KGSL_GPU_COMMAND, &req);
+
+   util_dynarray_clear(&queue->deferred_cmds);
+
+   if (ret)
+      return vk_device_set_lost(&queue->device->vk, "submit failed: %s\n",
+                                strerror(errno));
+
+   p_atomic_set(&queue->fence, req.timestamp);
+
+   return VK_SUCCESS;
+}
+
 static VkResult
 kgsl_queue_submit(struct tu_queue *queue, void *_submit,
                   struct vk_sync_wait *waits, uint32_t wait_count,
@@ -1095,6 +1727,38 @@ kgsl_queue_submit(struct tu_queue *queue, void *_submit,
    struct tu_kgsl_queue_submit *submit =
       (struct tu_kgsl_queue_submit *)_submit;
 
+   /* Submits which nothing can wait on are merged into the next one, which
+    * saves a kernel round trip for apps doing many tiny submits.
+    */
+   if (TU_DEBUG(DEFER_SUBMIT) && submit->commands.size != 0 &&
+       wait_count == 0 && signal_count == 0 && !u_trace_submission_data) {
+      util_dynarray_append_dynarray(&queue->deferred_cmds, &submit->commands);
+      if (util_dynarray_num_elements(&queue->deferred_cmds,
+                                     struct kgsl_command_object) <
+          TU_KGSL_MAX_DEFERRED_CMDS)
+         return VK_SUCCESS;
+      return kgsl_queue_flush(queue);
+   }
+
+   /* Deferred IBs must not end up behind the waits of this submit, and the
+    * empty path below relies on queue->fence covering everything submitted
+    * so far.
+    */
+   if (queue->deferred_cmds.size != 0 &&
+       (wait_count != 0 || submit->commands.size == 0 ||
+        u_trace_submission_data)) {
+      VkResult result = kgsl_queue_flush(queue);
+      if (result != VK_SUCCESS)
+         return result;
+   }
+
+   /* Anything still deferred at this point is prepended to this submit. */
+   struct util_dynarray *cmds = &submit->commands;
+   if (queue->deferred_cmds.size != 0) {
+      util_dynarray_append_dynarray(&queue->deferred_cmds, &submit->commands);
+      cmds = &queue->deferred_cmds;
+   }
+
 #if HAVE_PERFETTO
    uint64_t start_ts = tu_perfetto_begin_submit();
 #endif
@@ -1240,10 +1904,9 @@ kgsl_queue_submit(struct tu_queue *queue, void *_submit,
 
    struct kgsl_gpu_command req = {
       .flags = KGSL_CMDBATCH_SUBMIT_IB_LIST,
-      .cmdlist = (uintptr_t) submit->commands.data,
+      .cmdlist = (uintptr_t) cmds->data,
       .cmdsize = sizeof(struct kgsl_command_object),
-      .numcmds = util_dynarray_num_elements(&submit->commands,
-                                            struct kgsl_command_object),
+      .numcmds = util_dynarray_num_elements(cmds, struct kgsl_command_object),
       .synclist = (uintptr_t) &sync,
       .syncsize = sizeof(sync),
       .numsyncs = has_sync != 0 ? 1 : 0,
@@ -1301,6 +1964,7 @@ kgsl_queue_submit(struct tu_queue *queue, void *_submit,
 #endif
 
    kgsl_syncobj_destroy(&wait_sync);
+   util_dynarray_clear(&queue->deferred_cmds);
 
    if (ret) {
       result = vk_device_set_lost(&queue->device->vk, "submit failed: %s\n",
@@ -1342,13 +2006,36 @@ static VkResult
 kgsl_device_init(struct tu_device *dev)
 {
    dev->fd = dev->physical_device->local_fd;
+
+   mtx_init(&dev->bo_cache.lock, mtx_plain);
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++)
+      util_dynarray_init(&dev->bo_cache.buckets[i], NULL);
+
+   dev->dmabuf_bos = _mesa_hash_table_u64_create(NULL);
+   if (!dev->dmabuf_bos) {
+      mtx_destroy(&dev->bo_cache.lock);
+      return vk_error(dev, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    return VK_SUCCESS;
 }
 
 static void
 kgsl_device_finish(struct tu_device *dev)
 {
-   /* No-op */
+   /* This may run after the BO sparse array is gone, so only use the
+    * entries themselves.
+    */
+   for (unsigned i = 0; i < TU_BO_CACHE_BUCKETS; i++) {
+      util_dynarray_foreach(&dev->bo_cache.buckets[i], struct tu_bo_cache_entry, entry) {
+         kgsl_bo_cache_entry_free(dev, entry);
+         tu_mem_stats_del_size(dev, TU_MEM_CATEGORY_BO_CACHE, entry->size);
+      }
+      util_dynarray_fini(&dev->bo_cache.buckets[i]);
+   }
+   mtx_destroy(&dev->bo_cache.lock);
+
+   _mesa_hash_table_u64_destroy(dev->dmabuf_bos);
 }
 
 static int
@@ -1391,6 +2078,98 @@ kgsl_device_check_status(struct tu_device *device)
    return VK_SUCCESS;
 }
 
+static const struct {
+   const char *name;
+   uint32_t group;
+} kgsl_perfcntr_groups[] = {
+   { "CP", KGSL_PERFCOUNTER_GROUP_CP },
+   { "RBBM", KGSL_PERFCOUNTER_GROUP_RBBM },
+   { "PC", KGSL_PERFCOUNTER_GROUP_PC },
+   { "VFD", KGSL_PERFCOUNTER_GROUP_VFD },
+   { "HLSQ", KGSL_PERFCOUNTER_GROUP_HLSQ },
+   { "VPC", KGSL_PERFCOUNTER_GROUP_VPC },
+   { "TSE", KGSL_PERFCOUNTER_GROUP_TSE },
+   { "RAS", KGSL_PERFCOUNTER_GROUP_RAS },
+   { "UCHE", KGSL_PERFCOUNTER_GROUP_UCHE },
+   { "TP", KGSL_PERFCOUNTER_GROUP_TP },
+   { "SP", KGSL_PERFCOUNTER_GROUP_SP },
+   { "RB", KGSL_PERFCOUNTER_GROUP_RB },
+   { "VBIF", KGSL_PERFCOUNTER_GROUP_VBIF },
+   { "VSC", KGSL_PERFCOUNTER_GROUP_VSC },
+   { "CCU", KGSL_PERFCOUNTER_GROUP_CCU },
+   { "LRZ", KGSL_PERFCOUNTER_GROUP_LRZ },
+   { "CMP", KGSL_PERFCOUNTER_GROUP_CMP },
+};
+
+/* kgsl programs the counter selectors itself and accumulates the 64-bit
+ * values, so userspace only needs to name the countable it wants.
+ */
+static int
+kgsl_perfcntr_get(struct tu_device *dev, const char *group_name,
+                  uint32_t countable, uint32_t *group)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(kgsl_perfcntr_groups); i++) {
+      if (strcmp(kgsl_perfcntr_groups[i].name, group_name))
+         continue;
+
+      struct kgsl_perfcounter_get req = {
+         .groupid = kgsl_perfcntr_groups[i].group,
+         .countable = countable,
+      };
+
+      int ret = safe_ioctl(dev->physical_device->local_fd,
+                           IOCTL_KGSL_PERFCOUNTER_GET, &req);
+      if (ret)
+         return -errno;
+
+      *group = req.groupid;
+      return 0;
+   }
+
+   return -EINVAL;
+}
+
+static void
+kgsl_perfcntr_put(struct tu_device *dev, uint32_t group, uint32_t countable)
+{
+   struct kgsl_perfcounter_put req = {
+      .groupid = group,
+      .countable = countable,
+   };
+
+   safe_ioctl(dev->physical_device->local_fd, IOCTL_KGSL_PERFCOUNTER_PUT, &req);
+}
+
+static int
+kgsl_perfcntr_read(struct tu_device *dev, struct tu_knl_perfcntr *cntrs,
+                   uint32_t count)
+{
+   STACK_ARRAY(struct kgsl_perfcounter_read_group, reads, count);
+
+   for (uint32_t i = 0; i < count; i++) {
+      reads[i] = (struct kgsl_perfcounter_read_group) {
+         .groupid = cntrs[i].group,
+         .countable = cntrs[i].countable,
+      };
+   }
+
+   struct kgsl_perfcounter_read req = {
+      .reads = reads,
+      .count = count,
+   };
+
+   int ret = safe_ioctl(dev->physical_device->local_fd,
+                        IOCTL_KGSL_PERFCOUNTER_READ, &req);
+   if (!ret) {
+      for (uint32_t i = 0; i < count; i++)
+         cntrs[i].value = reads[i].value;
+   }
+
+   STACK_ARRAY_FINISH(reads);
+
+   return ret ? -errno : 0;
+}
+
 static const struct tu_knl kgsl_knl_funcs = {
       .name = "kgsl",
 
@@ -1407,11 +2186,16 @@ static const struct tu_knl kgsl_knl_funcs = {
       .bo_map = kgsl_bo_map,
       .bo_allow_dump = kgsl_bo_allow_dump,
       .bo_finish = kgsl_bo_finish,
+      .bo_commit = kgsl_bo_commit,
       .submit_create = kgsl_submit_create,
       .submit_finish = kgsl_submit_finish,
       .submit_add_entries = kgsl_submit_add_entries,
       .queue_submit = kgsl_queue_submit,
       .queue_wait_fence = kgsl_queue_wait_fence,
+      .queue_flush = kgsl_queue_flush,
+      .perfcntr_get = kgsl_perfcntr_get,
+      .perfcntr_put = kgsl_perfcntr_put,
+      .perfcntr_read = kgsl_perfcntr_read,
 };
 
 static bool
@@ -1528,6 +2312,8 @@ tu_knl_kgsl_load(struct tu_instance *instance, int fd)
       fd, KGSL_MEMFLAGS_IOCOHERENT |
              (KGSL_CACHEMODE_WRITEBACK << KGSL_CACHEMODE_SHIFT));
 
+   device->has_lazy_memory = kgsl_has_sparse_memory(fd);
+
    /* preemption is always supported on kgsl */
    device->has_preemption = true;
 
@@ -43,7 +43,8 @@
  *   - Depth Write + OP_ALWAYS or OP_NOT_EQUAL;
  *   - Clearing depth with vkCmdClearAttachments;
  *   - Depth image is a target of blit commands.
- *   - (pre-a650) Not clearing depth attachment with LOAD_OP_CLEAR;
+ *   - (pre-a650) Not clearing depth attachment with LOAD_OP_CLEAR, unless
+ *     LRZ is carried over from the previous renderpass (see below);
  *   - (pre-a650) Using secondary command buffers;
  * LRZ WRITE is DISABLED until depth attachment is cleared when:
  *   - Depth Write + blending (color blend, logic ops, partial color mask, etc.);
@@ -57,6 +58,16 @@
  * There is a documentation on LRZ rules in QCOM's driver:
  *  https://docs.qualcomm.com/bundle/publicresource/topics/80-78185-2/best_practices.html?product=1601111740035277#lrz-do-not-disable
  *
+ * Pre-A650
+ * ========
+ *
+ * Without GPU direction tracking LRZ can still be reused by a renderpass
+ * which loads depth, if the previous renderpass in the same command buffer
+ * rendered to the same depth view in GMEM and left LRZ valid. The direction
+ * is then known on the CPU and carried over in cmd->state.last_lrz. Any
+ * other renderpass, secondary command buffer or depth image write in between
+ * forgets it.
+ *
  * A650+ (gen3+)
  * =============
  *
@@ -116,9 +127,10 @@ tu6_emit_lrz_buffer(struct tu_cs *cs, struct tu_image *depth_image)
       return;
    }
 
-   uint64_t lrz_iova = depth_image->iova + depth_image->lrz_layout.lrz_offset;
-   uint64_t lrz_fc_iova =
-      depth_image->iova + depth_image->lrz_layout.lrz_fc_offset;
+   uint64_t lrz_iova = depth_image->lrz_iova;
+   uint64_t lrz_fc_iova = depth_image->lrz_iova +
+      depth_image->lrz_layout.lrz_fc_offset -
+      depth_image->lrz_layout.lrz_offset;
    if (!depth_image->lrz_layout.lrz_fc_offset)
       lrz_fc_iova = 0;
 
@@ -192,6 +204,27 @@ tu6_disable_lrz_via_depth_view(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
    tu_emit_event_write<A6XX>(cmd, cs, FD_LRZ_FLUSH);
 }
 
+static void
+tu_lrz_forget_last_state(struct tu_cmd_buffer *cmd,
+                         const struct tu_image *image)
+{
+   if (cmd->state.last_lrz.image_view &&
+       cmd->state.last_lrz.image_view->image == image)
+      memset(&cmd->state.last_lrz, 0, sizeof(cmd->state.last_lrz));
+}
+
+static bool
+tu_lrz_last_state_matches(struct tu_cmd_buffer *cmd,
+                          const struct tu_image_view *view)
+{
+   const struct tu_lrz_state *last = &cmd->state.last_lrz;
+
+   return last->valid && last->image_view &&
+          last->image_view->image == view->image &&
+          last->image_view->view.GRAS_LRZ_DEPTH_VIEW ==
+             view->view.GRAS_LRZ_DEPTH_VIEW;
+}
+
 static void
 tu_lrz_init_state(struct tu_cmd_buffer *cmd,
                   const struct tu_render_pass_attachment *att,
@@ -207,8 +240,18 @@ tu_lrz_init_state(struct tu_cmd_buffer *cmd,
    bool has_gpu_tracking =
       cmd->device->physical_device->info->a6xx.has_lrz_dir_tracking;
 
-   if (!has_gpu_tracking && !clears_depth)
+   if (!has_gpu_tracking && !clears_depth) {
+      if (!att->load || !tu_lrz_last_state_matches(cmd, view))
+         return;
+
+      /* Continue from where the previous renderpass left LRZ, including its
+       * direction, since nothing touched the depth image in between.
+       */
+      cmd->state.lrz = cmd->state.last_lrz;
+      cmd->state.lrz.image_view = view;
+      cmd->state.lrz.reuse_previous_state = true;
       return;
+   }
 
    /* We need to always have an LRZ view just to disable it if there is a
     * depth attachment, there are any secondaries, and GPU tracking is
@@ -346,6 +389,7 @@ tu_lrz_begin_renderpass(struct tu_cmd_buffer *cmd)
        * the last one as emitted in tu_disable_lrz().
        */
       memset(&cmd->state.lrz, 0, sizeof(cmd->state.lrz));
+      cmd->state.lrz.disable_reason = TU_LRZ_DISABLE_MULTIPLE_DEPTH_ATTACHMENTS;
       return;
    }
 
@@ -390,10 +434,10 @@ tu_lrz_tiling_begin(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
       /* Reuse previous LRZ state, LRZ cache is assumed to be
        * already invalidated by previous renderpass.
        */
-      assert(lrz->gpu_dir_tracking);
-
-      tu6_write_lrz_reg(cmd, cs,
-         A6XX_GRAS_LRZ_DEPTH_VIEW(.dword = lrz->image_view->view.GRAS_LRZ_DEPTH_VIEW));
+      if (lrz->gpu_dir_tracking) {
+         tu6_write_lrz_reg(cmd, cs,
+            A6XX_GRAS_LRZ_DEPTH_VIEW(.dword = lrz->image_view->view.GRAS_LRZ_DEPTH_VIEW));
+      }
       return;
    }
 
@@ -472,6 +516,15 @@ template <chip CHIP>
 void
 tu_lrz_tiling_end(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
 {
+   /* Remember what is left in LRZ for the next renderpass, see
+    * tu_lrz_init_state().
+    */
+   if (cmd->state.lrz.valid && cmd->state.lrz.image_view &&
+       !cmd->state.lrz.gpu_dir_tracking)
+      cmd->state.last_lrz = cmd->state.lrz;
+   else
+      memset(&cmd->state.last_lrz, 0, sizeof(cmd->state.last_lrz));
+
    if (cmd->state.lrz.fast_clear || cmd->state.lrz.gpu_dir_tracking) {
       tu6_emit_lrz_buffer<CHIP>(cs, cmd->state.lrz.image_view->image);
 
@@ -534,6 +587,13 @@ tu_lrz_sysmem_begin(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
          A6XX_GRAS_LRZ_DEPTH_VIEW(.dword = 0));
    } else {
       tu6_emit_lrz_buffer<CHIP>(cs, lrz->image_view->image);
+
+      /* LRZ carried over from the previous renderpass still matches the
+       * loaded depth buffer.
+       */
+      if (lrz->reuse_previous_state)
+         return;
+
       /* Even though we disable LRZ writes in sysmem mode - there is still
        * LRZ test, so LRZ should be cleared.
        */
@@ -563,6 +623,9 @@ tu_lrz_sysmem_end(struct tu_cmd_buffer *cmd, struct tu_cs *cs)
       return;
    }
 
+   /* LRZ isn't written in sysmem mode. */
+   memset(&cmd->state.last_lrz, 0, sizeof(cmd->state.last_lrz));
+
    tu_emit_event_write<CHIP>(cmd, &cmd->cs, FD_LRZ_FLUSH);
 }
 TU_GENX(tu_lrz_sysmem_end);
@@ -573,6 +636,8 @@ void
 tu_disable_lrz(struct tu_cmd_buffer *cmd, struct tu_cs *cs,
                struct tu_image *image)
 {
+   tu_lrz_forget_last_state(cmd, image);
+
    if (!cmd->device->physical_device->info->a6xx.has_lrz_dir_tracking)
       return;
 
@@ -619,6 +684,8 @@ tu_lrz_clear_depth_image(struct tu_cmd_buffer *cmd,
                          uint32_t rangeCount,
                          const VkImageSubresourceRange *pRanges)
 {
+   tu_lrz_forget_last_state(cmd, image);
+
    if (!rangeCount || !image->lrz_layout.lrz_total_size ||
        !cmd->device->physical_device->info->a6xx.has_lrz_dir_tracking)
       return;
@@ -677,6 +744,7 @@ tu_lrz_disable_during_renderpass(struct tu_cmd_buffer *cmd,
    tu_lrz_disable_reason(cmd, reason);
 
    cmd->state.lrz.valid = false;
+   cmd->state.lrz.disable_reason = TU_LRZ_DISABLE_CLEAR_IN_RP;
    cmd->state.dirty |= TU_CMD_DIRTY_LRZ;
 }
 TU_GENX(tu_lrz_disable_during_renderpass);
@@ -779,6 +847,7 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
     */
    bool disable_lrz = false;
    bool temporary_disable_lrz = false;
+   enum tu_lrz_disable_reason disable_reason = TU_LRZ_DISABLE_NONE;
 
    /* What happens in FS could affect LRZ, e.g.: writes to gl_FragDepth or early
     * fragment tests.  We have to skip LRZ testing and updating, but as long as
@@ -791,6 +860,7 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
       } else {
          tu_lrz_disable_reason(cmd, "FS writes depth or has side-effects (TODO: fix for gpu-direction-tracking case)");
          disable_lrz = true;
+         disable_reason = TU_LRZ_DISABLE_FS;
       }
    }
 
@@ -812,6 +882,7 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
       if (z_write_enable) {
          tu_lrz_disable_reason(cmd, "Depth write + ALWAYS/NOT_EQUAL");
          disable_lrz = true;
+         disable_reason = TU_LRZ_DISABLE_ALWAYS_NOT_EQUAL;
          gras_lrz_cntl.dir = LRZ_DIR_INVALID;
       } else {
          perf_debug(cmd->device, "Skipping LRZ due to ALWAYS/NOT_EQUAL");
@@ -856,6 +927,7 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
       if (z_write_enable) {
          tu_lrz_disable_reason(cmd, "Depth write + compare-op direction change");
          disable_lrz = true;
+         disable_reason = TU_LRZ_DISABLE_DIRECTION_CHANGE;
       } else {
          perf_debug(cmd->device, "Skipping LRZ due to direction change");
          temporary_disable_lrz = true;
@@ -906,6 +978,7 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
           frag_may_be_killed_by_stencil) {
          tu_lrz_write_disable_reason(cmd, "Stencil may kill fragments");
          cmd->state.lrz.disable_write_for_rp = true;
+         cmd->state.lrz.disable_reason = TU_LRZ_DISABLE_STENCIL_KILL;
       }
 
       if (writes_stencil_on_ds_fail)
@@ -936,11 +1009,14 @@ tu6_calculate_lrz_state(struct tu_cmd_buffer *cmd,
    if (reads_dest && z_write_enable && cmd->device->instance->conservative_lrz) {
       tu_lrz_write_disable_reason(cmd, "Depth write + blending");
       cmd->state.lrz.disable_write_for_rp = true;
+      cmd->state.lrz.disable_reason = TU_LRZ_DISABLE_BLEND_DEPTH_WRITE;
       temporary_disable_lrz = true;
    }
 
-   if (disable_lrz)
+   if (disable_lrz) {
       cmd->state.lrz.valid = false;
+      cmd->state.lrz.disable_reason = disable_reason;
+   }
 
    if (cmd->state.lrz.disable_write_for_rp)
       gras_lrz_cntl.lrz_write = false;
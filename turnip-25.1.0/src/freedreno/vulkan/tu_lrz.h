@@ -12,6 +12,8 @@
 
 #include "tu_common.h"
 
+#include "tu_rp_log_format.h"
+
 enum tu_lrz_force_disable_mask {
    TU_LRZ_FORCE_DISABLE_LRZ = 1 << 0,
    TU_LRZ_FORCE_DISABLE_WRITE = 1 << 1,
@@ -45,6 +47,8 @@ struct tu_lrz_state
    /* Continue using old LRZ state (LOAD_OP_LOAD of depth) */
    bool reuse_previous_state : 1;
    enum tu_lrz_direction prev_direction;
+   /* why LRZ was invalidated during the pass, for TU_RP_LOG */
+   enum tu_lrz_disable_reason disable_reason;
 };
 
 template <chip CHIP>
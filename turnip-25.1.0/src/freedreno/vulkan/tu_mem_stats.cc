@@ -0,0 +1,122 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "tu_mem_stats.h"
+
+#include "util/u_debug.h"
+
+#include "tu_device.h"
+
+static const char *mem_category_names[] = {
+   [TU_MEM_CATEGORY_INTERNAL] = "internal",
+   [TU_MEM_CATEGORY_CMDSTREAM] = "cmdstream",
+   [TU_MEM_CATEGORY_DESCRIPTOR] = "descriptor",
+   [TU_MEM_CATEGORY_PIPELINE] = "pipeline",
+   [TU_MEM_CATEGORY_SCRATCH] = "scratch",
+   [TU_MEM_CATEGORY_QUERY] = "query",
+   [TU_MEM_CATEGORY_DEVICE_MEMORY] = "device memory",
+   [TU_MEM_CATEGORY_IMPORTED] = "imported",
+   [TU_MEM_CATEGORY_BO_CACHE] = "bo cache",
+};
+static_assert(ARRAY_SIZE(mem_category_names) == TU_MEM_CATEGORY_COUNT,
+              "missing memory category name");
+
+/* vkAllocateMemory() BOs are already counted in heap.used */
+static bool
+mem_category_is_internal(enum tu_mem_category category)
+{
+   return category != TU_MEM_CATEGORY_DEVICE_MEMORY &&
+          category != TU_MEM_CATEGORY_IMPORTED;
+}
+
+void
+tu_mem_stats_init(struct tu_device *dev)
+{
+   const char *option = os_get_option("TU_MEM_STATS");
+
+   dev->mem_stats.dump = option != NULL;
+   dev->mem_stats.dump_period = option ? strtoul(option, NULL, 0) : 0;
+}
+
+void
+tu_mem_stats_add(struct tu_device *dev, struct tu_bo *bo,
+                 enum tu_mem_category category)
+{
+   struct tu_mem_stats *stats = &dev->mem_stats;
+
+   if (bo->mem_counted)
+      tu_mem_stats_del(dev, bo);
+
+   bo->mem_category = category;
+   bo->mem_counted = true;
+   p_atomic_add(&stats->size[category], bo->size);
+   p_atomic_inc(&stats->count[category]);
+   if (mem_category_is_internal(category))
+      p_atomic_add(&dev->physical_device->heap.internal_used, bo->size);
+
+   uint64_t total = p_atomic_add_return(&stats->total, bo->size);
+   uint64_t peak = p_atomic_read(&stats->peak);
+   while (total > peak) {
+      uint64_t old = p_atomic_cmpxchg(&stats->peak, peak, total);
+      if (old == peak)
+         break;
+      peak = old;
+   }
+}
+
+void
+tu_mem_stats_del_size(struct tu_device *dev, enum tu_mem_category category,
+                      uint64_t size)
+{
+   struct tu_mem_stats *stats = &dev->mem_stats;
+
+   p_atomic_add(&stats->size[category], -size);
+   p_atomic_dec(&stats->count[category]);
+   if (mem_category_is_internal(category))
+      p_atomic_add(&dev->physical_device->heap.internal_used, -size);
+   p_atomic_add(&stats->total, -size);
+}
+
+void
+tu_mem_stats_del(struct tu_device *dev, struct tu_bo *bo)
+{
+   if (!bo->mem_counted)
+      return;
+
+   tu_mem_stats_del_size(dev, (enum tu_mem_category) bo->mem_category,
+                         bo->size);
+   bo->mem_counted = false;
+}
+
+void
+tu_mem_stats_dump(struct tu_device *dev)
+{
+   struct tu_mem_stats *stats = &dev->mem_stats;
+
+   mesa_logi("TU_MEM_STATS frame %u: %" PRIu64 " kb, peak %" PRIu64 " kb",
+             p_atomic_read(&stats->frame),
+             p_atomic_read(&stats->total) / 1024,
+             p_atomic_read(&stats->peak) / 1024);
+   for (unsigned i = 0; i < TU_MEM_CATEGORY_COUNT; i++) {
+      uint32_t count = p_atomic_read(&stats->count[i]);
+      if (!count)
+         continue;
+      mesa_logi("%16s: %5u bos, %8" PRIu64 " kb", mem_category_names[i],
+                count, p_atomic_read(&stats->size[i]) / 1024);
+   }
+}
+
+void
+tu_mem_stats_frame(struct tu_device *dev)
+{
+   struct tu_mem_stats *stats = &dev->mem_stats;
+
+   if (likely(!stats->dump_period))
+      return;
+
+   uint32_t frame = p_atomic_inc_return(&stats->frame);
+   if (frame % stats->dump_period == 0)
+      tu_mem_stats_dump(dev);
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_MEM_STATS_H
+#define TU_MEM_STATS_H
+
+#include "tu_common.h"
+
+#include "tu_knl.h"
+
+/* Always-on accounting of the BOs a device holds, by what they are used
+ * for.  Unlike TU_DEBUG=bos this costs two atomics per BO creation and
+ * destruction, so it can stay enabled when chasing an OOM in the field.
+ *
+ * Driver-internal BOs are also reported as heap usage in
+ * VK_EXT_memory_budget, on top of what the application allocated.
+ *
+ * TU_MEM_STATS=<n> logs the counters every <n> presents (never if 0) and
+ * when the device is destroyed.
+ */
+struct tu_mem_stats
+{
+   alignas(8) uint64_t size[TU_MEM_CATEGORY_COUNT];
+   uint32_t count[TU_MEM_CATEGORY_COUNT];
+
+   /* sum of size[], and its high watermark */
+   alignas(8) uint64_t total;
+   alignas(8) uint64_t peak;
+
+   bool dump;
+   uint32_t dump_period;
+   uint32_t frame;
+};
+
+void
+tu_mem_stats_init(struct tu_device *dev);
+
+/* Called when a BO is created or imported, and when the backend takes it
+ * into its BO cache. A BO that is already counted moves to the new category.
+ */
+void
+tu_mem_stats_add(struct tu_device *dev, struct tu_bo *bo,
+                 enum tu_mem_category category);
+
+/* Called when the backend frees the BO, or takes it back into its cache. */
+void
+tu_mem_stats_del(struct tu_device *dev, struct tu_bo *bo);
+
+/* For BO cache entries freed after the BO array is gone. */
+void
+tu_mem_stats_del_size(struct tu_device *dev, enum tu_mem_category category,
+                      uint64_t size);
+
+void
+tu_mem_stats_dump(struct tu_device *dev);
+
+/* Counts a present, for TU_MEM_STATS=<n>. */
+void
+tu_mem_stats_frame(struct tu_device *dev);
+
+#endif /* TU_MEM_STATS_H */
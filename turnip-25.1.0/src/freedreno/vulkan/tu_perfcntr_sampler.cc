@@ -0,0 +1,293 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "tu_perfcntr_sampler.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "util/os_time.h"
+#include "util/u_debug.h"
+
+#include "tu_device.h"
+#include "tu_knl.h"
+
+#define TU_PERFCNTR_RING_SIZE 256
+/* publish an entry this often even if nothing is being presented */
+#define TU_PERFCNTR_IDLE_NS 1000000000ll
+
+/* What an overlay needs to tell whether the GPU is the bottleneck and, if
+ * so, whether it is shader ALU or texture bound:
+ *
+ *    gpu busy %     = CP_BUSY_CYCLES / CP_ALWAYS_COUNT
+ *    ALU %          = SP_ALU_WORKING_CYCLES / SP_BUSY_CYCLES
+ *    tex stall %    = SP_STALL_CYCLES_TP / SP_BUSY_CYCLES
+ *    TP L1 miss %   = TP_L1_CACHELINE_MISSES / TP_L1_CACHELINE_REQUESTS
+ */
+static const struct {
+   const char *group;
+   const char *countable;
+} sampler_countables[] = {
+   { "CP", "PERF_CP_ALWAYS_COUNT" },
+   { "CP", "PERF_CP_BUSY_CYCLES" },
+   { "SP", "PERF_SP_BUSY_CYCLES" },
+   { "SP", "PERF_SP_ALU_WORKING_CYCLES" },
+   { "SP", "PERF_SP_STALL_CYCLES_TP" },
+   { "TP", "PERF_TP_L1_CACHELINE_REQUESTS" },
+   { "TP", "PERF_TP_L1_CACHELINE_MISSES" },
+   { "RB", "PERF_RB_3D_PIXELS" },
+};
+static_assert(ARRAY_SIZE(sampler_countables) <= TU_PERFCNTR_RING_MAX_COUNTERS,
+              "too many sampled countables");
+
+struct tu_perfcntr_sampler
+{
+   struct tu_device *device;
+
+   struct tu_perfcntr_ring *ring;
+   size_t ring_map_size;
+
+   uint32_t num_counters;
+   struct tu_knl_perfcntr counters[TU_PERFCNTR_RING_MAX_COUNTERS];
+   uint64_t last_values[TU_PERFCNTR_RING_MAX_COUNTERS];
+
+   uint64_t period_us;
+
+   /* incremented on present, read by the sampling thread */
+   uint32_t frames;
+
+   bool thread_stop;
+   pthread_t thread;
+};
+
+static const struct fd_perfcntr_countable *
+find_countable(const struct fd_perfcntr_group *groups, unsigned num_groups,
+               const char *group_name, const char *countable_name)
+{
+   for (unsigned i = 0; i < num_groups; i++) {
+      if (strcmp(groups[i].name, group_name))
+         continue;
+
+      for (unsigned j = 0; j < groups[i].num_countables; j++) {
+         if (!strcmp(groups[i].countables[j].name, countable_name))
+            return &groups[i].countables[j];
+      }
+   }
+
+   return NULL;
+}
+
+static void
+publish_entry(struct tu_perfcntr_sampler *sampler, uint32_t frames,
+              int64_t now, int64_t duration)
+{
+   struct tu_perfcntr_ring *ring = sampler->ring;
+   uint64_t idx = ring->write_count;
+   struct tu_perfcntr_ring_entry *entry =
+      &ring->entries[idx % ring->ring_size];
+
+   /* the exchange keeps the stores below from being reordered before it */
+   p_atomic_xchg(&entry->seq, 0);
+
+   entry->timestamp_ns = now;
+   entry->duration_ns = duration;
+   entry->frames = frames;
+   for (uint32_t i = 0; i < sampler->num_counters; i++) {
+      entry->values[i] =
+         sampler->counters[i].value - sampler->last_values[i];
+      sampler->last_values[i] = sampler->counters[i].value;
+   }
+
+   p_atomic_set(&entry->seq, idx + 1);
+   p_atomic_set(&ring->write_count, idx + 1);
+}
+
+/* The kernel accumulates the counters for us, so a read per interval is
+ * all that is needed.  Frame boundaries are only resolved to the sampling
+ * period, but the thread does no ioctls at all while nothing happens.
+ */
+static void *
+sample_counters(void *_sampler)
+{
+   struct tu_perfcntr_sampler *sampler =
+      (struct tu_perfcntr_sampler *) _sampler;
+   struct tu_device *device = sampler->device;
+   uint32_t last_frames = 0;
+   int64_t last_publish = os_time_get_nano();
+
+   if (tu_device_perfcntr_read(device, sampler->counters,
+                               sampler->num_counters)) {
+      mesa_loge("TU_PERFCNTR_RING: failed to read GPU counters");
+      return NULL;
+   }
+   for (uint32_t i = 0; i < sampler->num_counters; i++)
+      sampler->last_values[i] = sampler->counters[i].value;
+
+   while (!p_atomic_read(&sampler->thread_stop)) {
+      os_time_sleep(sampler->period_us);
+
+      uint32_t frames = p_atomic_read(&sampler->frames);
+      int64_t now = os_time_get_nano();
+      if (frames == last_frames && now - last_publish < TU_PERFCNTR_IDLE_NS)
+         continue;
+
+      if (tu_device_perfcntr_read(device, sampler->counters,
+                                  sampler->num_counters)) {
+         mesa_loge("TU_PERFCNTR_RING: failed to read GPU counters");
+         break;
+      }
+
+      publish_entry(sampler, frames - last_frames, now, now - last_publish);
+      last_frames = frames;
+      last_publish = now;
+   }
+
+   return NULL;
+}
+
+static void
+release_counters(struct tu_perfcntr_sampler *sampler)
+{
+   for (uint32_t i = 0; i < sampler->num_counters; i++) {
+      tu_device_perfcntr_put(sampler->device, sampler->counters[i].group,
+                             sampler->counters[i].countable);
+   }
+}
+
+static bool
+map_ring(struct tu_perfcntr_sampler *sampler, const char *path)
+{
+   size_t size = sizeof(struct tu_perfcntr_ring) +
+                 TU_PERFCNTR_RING_SIZE * sizeof(struct tu_perfcntr_ring_entry);
+
+   int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0) {
+      mesa_loge("TU_PERFCNTR_RING: failed to open %s: %s", path,
+                strerror(errno));
+      return false;
+   }
+
+   void *map = MAP_FAILED;
+   if (!ftruncate(fd, size))
+      map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED) {
+      mesa_loge("TU_PERFCNTR_RING: failed to map %s: %s", path,
+                strerror(errno));
+      return false;
+   }
+
+   sampler->ring = (struct tu_perfcntr_ring *) map;
+   sampler->ring_map_size = size;
+   return true;
+}
+
+void
+tu_perfcntr_sampler_init(struct tu_device *device)
+{
+   const char *path = os_get_option("TU_PERFCNTR_RING");
+
+   device->perfcntr_sampler = NULL;
+   if (!path)
+      return;
+
+   if (!tu_device_has_perfcntr_read(device)) {
+      mesa_loge("TU_PERFCNTR_RING: not supported by the %s backend",
+                device->instance->knl->name);
+      return;
+   }
+
+   unsigned num_groups;
+   const struct fd_perfcntr_group *groups =
+      fd_perfcntrs(&device->physical_device->dev_id, &num_groups);
+   if (!groups) {
+      mesa_loge("TU_PERFCNTR_RING: no counters known for this GPU");
+      return;
+   }
+
+   struct tu_perfcntr_sampler *sampler = (struct tu_perfcntr_sampler *)
+      calloc(1, sizeof(struct tu_perfcntr_sampler));
+   if (!sampler)
+      return;
+
+   sampler->device = device;
+   sampler->period_us =
+      MAX2(debug_get_num_option("TU_PERFCNTR_PERIOD_US", 1000), 100);
+
+   if (!map_ring(sampler, path)) {
+      free(sampler);
+      return;
+   }
+
+   struct tu_perfcntr_ring *ring = sampler->ring;
+   for (unsigned i = 0; i < ARRAY_SIZE(sampler_countables); i++) {
+      const struct fd_perfcntr_countable *countable =
+         find_countable(groups, num_groups, sampler_countables[i].group,
+                        sampler_countables[i].countable);
+      if (!countable)
+         continue;
+
+      struct tu_knl_perfcntr *cntr = &sampler->counters[sampler->num_counters];
+      if (tu_device_perfcntr_get(device, sampler_countables[i].group,
+                                 countable->selector, &cntr->group)) {
+         mesa_logw("TU_PERFCNTR_RING: couldn't reserve %s",
+                   countable->name);
+         continue;
+      }
+      cntr->countable = countable->selector;
+
+      /* drop the PERF_ prefix, overlays have little room */
+      snprintf(ring->names[sampler->num_counters], TU_PERFCNTR_RING_NAME_LEN,
+               "%s", countable->name + strlen("PERF_"));
+      sampler->num_counters++;
+   }
+
+   if (!sampler->num_counters) {
+      munmap(sampler->ring, sampler->ring_map_size);
+      free(sampler);
+      return;
+   }
+
+   ring->version = TU_PERFCNTR_RING_VERSION;
+   ring->ring_size = TU_PERFCNTR_RING_SIZE;
+   ring->num_counters = sampler->num_counters;
+   ring->write_count = 0;
+   p_atomic_set(&ring->magic, TU_PERFCNTR_RING_MAGIC);
+
+   if (pthread_create(&sampler->thread, NULL, sample_counters, sampler)) {
+      release_counters(sampler);
+      munmap(sampler->ring, sampler->ring_map_size);
+      free(sampler);
+      return;
+   }
+
+   device->perfcntr_sampler = sampler;
+}
+
+void
+tu_perfcntr_sampler_finish(struct tu_device *device)
+{
+   struct tu_perfcntr_sampler *sampler = device->perfcntr_sampler;
+   if (!sampler)
+      return;
+
+   p_atomic_set(&sampler->thread_stop, true);
+   pthread_join(sampler->thread, NULL);
+
+   release_counters(sampler);
+   munmap(sampler->ring, sampler->ring_map_size);
+   free(sampler);
+   device->perfcntr_sampler = NULL;
+}
+
+void
+tu_perfcntr_sampler_frame(struct tu_device *device)
+{
+   if (device->perfcntr_sampler)
+      p_atomic_inc(&device->perfcntr_sampler->frames);
+}
@@ -0,0 +1,65 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_PERFCNTR_SAMPLER_H
+#define TU_PERFCNTR_SAMPLER_H
+
+#include "tu_common.h"
+
+/* Background sampling of a few GPU-wide counters for live overlays.
+ *
+ * With TU_PERFCNTR_RING=<file>, the device reserves a fixed set of
+ * countables (GPU busy, SP ALU/texture stall, TP L1 hit rate, ...) through
+ * the kernel and a thread reads them every TU_PERFCNTR_PERIOD_US
+ * (default 1000).  Whenever at least one frame has been presented, or
+ * nothing was presented for a second, the counter deltas since the last
+ * entry are appended to a ring in <file>, which is mmap()ed MAP_SHARED so
+ * that an overlay in another process can map it read-only.
+ *
+ * Only backends that can read counters from userspace on behalf of the
+ * process (kgsl) support this.  The counters are GPU-wide, so they include
+ * the work of other processes.
+ *
+ * The layout below is the ABI with readers.  For each index i in
+ * [write_count - ring_size, write_count), a reader loads entries[i %
+ * ring_size].seq, copies the entry, and loads seq again; the copy is
+ * consistent if both loads returned i + 1.
+ */
+
+#define TU_PERFCNTR_RING_MAGIC 0x52435054 /* "TPCR" */
+#define TU_PERFCNTR_RING_VERSION 1
+#define TU_PERFCNTR_RING_MAX_COUNTERS 16
+#define TU_PERFCNTR_RING_NAME_LEN 32
+
+struct tu_perfcntr_ring_entry {
+   uint64_t seq;          /* index + 1 once written, 0 while being written */
+   uint64_t timestamp_ns; /* CLOCK_MONOTONIC at the end of the interval */
+   uint64_t duration_ns;
+   uint32_t frames;       /* presents during the interval */
+   uint32_t _pad;
+   uint64_t values[TU_PERFCNTR_RING_MAX_COUNTERS];
+};
+
+struct tu_perfcntr_ring {
+   uint32_t magic;        /* written last, once the header is valid */
+   uint32_t version;
+   uint32_t ring_size;
+   uint32_t num_counters;
+   char names[TU_PERFCNTR_RING_MAX_COUNTERS][TU_PERFCNTR_RING_NAME_LEN];
+   uint64_t write_count;  /* number of entries written so far */
+   struct tu_perfcntr_ring_entry entries[];
+};
+
+void
+tu_perfcntr_sampler_init(struct tu_device *device);
+
+void
+tu_perfcntr_sampler_finish(struct tu_device *device);
+
+/* Marks a frame boundary, called on present. */
+void
+tu_perfcntr_sampler_frame(struct tu_device *device);
+
+#endif /* TU_PERFCNTR_SAMPLER_H */
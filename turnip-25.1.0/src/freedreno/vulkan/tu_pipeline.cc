@@ -1098,7 +1098,8 @@ tu_get_tess_iova(struct tu_device *dev,
       mtx_lock(&dev->mutex);
       if (!dev->tess_bo) {
          tu_bo_init_new(dev, NULL, &dev->tess_bo, TU_TESS_BO_SIZE,
-                        TU_BO_ALLOC_INTERNAL_RESOURCE, "tess");
+                        TU_BO_ALLOC_INTERNAL_RESOURCE,
+                        TU_MEM_CATEGORY_PIPELINE, "tess");
       }
       mtx_unlock(&dev->mutex);
    }
@@ -1565,6 +1566,9 @@ tu_nir_shaders_destroy(struct vk_device *device,
    for (unsigned i = 0; i < ARRAY_SIZE(shaders->nir); i++)
       ralloc_free(shaders->nir[i]);
 
+   vk_free(&device->alloc, shaders->data);
+   mtx_destroy(&shaders->lock);
+
    vk_pipeline_cache_object_finish(&shaders->base);
    vk_free(&device->alloc, shaders);
 }
@@ -1589,10 +1593,33 @@ tu_nir_shaders_init(struct tu_device *dev, const void *key_data, size_t key_size
    memcpy(obj_key_data, key_data, key_size);
    vk_pipeline_cache_object_init(&dev->vk, &shaders->base,
                                  &tu_nir_shaders_ops, obj_key_data, key_size);
+   mtx_init(&shaders->lock, mtx_plain);
 
    return shaders;
 }
 
+static nir_shader *
+tu_nir_shaders_get(struct tu_device *dev, struct tu_nir_shaders *shaders,
+                   gl_shader_stage stage)
+{
+   if (!(shaders->stage_mask & (1u << stage)))
+      return NULL;
+
+   mtx_lock(&shaders->lock);
+   if (!shaders->nir[stage]) {
+      struct blob_reader blob;
+      blob_reader_init(&blob,
+                       (uint8_t *) shaders->data + shaders->data_offset[stage],
+                       shaders->data_size[stage]);
+      shaders->nir[stage] =
+         nir_deserialize(NULL, ir3_get_compiler_options(dev->compiler), &blob);
+   }
+   nir_shader *nir = shaders->nir[stage];
+   mtx_unlock(&shaders->lock);
+
+   return nir;
+}
+
 static bool
 tu_nir_shaders_serialize(struct vk_pipeline_cache_object *object,
                          struct blob *blob)
@@ -1600,16 +1627,26 @@ tu_nir_shaders_serialize(struct vk_pipeline_cache_object *object,
    struct tu_nir_shaders *shaders =
       container_of(object, struct tu_nir_shaders, base);
 
-   for (unsigned i = 0; i < ARRAY_SIZE(shaders->nir); i++) {
-      if (shaders->nir[i]) {
-         blob_write_uint8(blob, 1);
-         nir_serialize(blob, shaders->nir[i], true);
+   /* Each stage is prefixed with its size so that loading can skip over it
+    * without deserializing.
+    */
+   blob_write_uint32(blob, shaders->stage_mask);
+   u_foreach_bit(i, shaders->stage_mask) {
+      intptr_t size_offset = blob_reserve_uint32(blob);
+      size_t start = blob->size;
+
+      if (shaders->data) {
+         blob_write_bytes(blob,
+                          (uint8_t *) shaders->data + shaders->data_offset[i],
+                          shaders->data_size[i]);
       } else {
-         blob_write_uint8(blob, 0);
+         nir_serialize(blob, shaders->nir[i], true);
       }
+
+      blob_overwrite_uint32(blob, size_offset, blob->size - start);
    }
 
-   return true;
+   return !blob->out_of_memory;
 }
 
 static struct vk_pipeline_cache_object *
@@ -1626,11 +1663,30 @@ tu_nir_shaders_deserialize(struct vk_pipeline_cache *cache,
    if (!shaders)
       return NULL;
 
-   for (unsigned i = 0; i < ARRAY_SIZE(shaders->nir); i++) {
-      if (blob_read_uint8(blob)) {
-         shaders->nir[i] =
-            nir_deserialize(NULL, ir3_get_compiler_options(dev->compiler), blob);
-      }
+   shaders->stage_mask = blob_read_uint32(blob);
+   if (shaders->stage_mask & ~BITFIELD_MASK(MESA_SHADER_STAGES)) {
+      tu_nir_shaders_destroy(&dev->vk, &shaders->base);
+      return NULL;
+   }
+
+   const uint8_t *start = (const uint8_t *) blob->current;
+   u_foreach_bit(i, shaders->stage_mask) {
+      shaders->data_size[i] = blob_read_uint32(blob);
+      shaders->data_offset[i] = (const uint8_t *) blob->current - start;
+      blob_skip_bytes(blob, shaders->data_size[i]);
+   }
+
+   size_t size = (const uint8_t *) blob->current - start;
+   if (!blob->overrun && size > 0) {
+      shaders->data = vk_alloc(&dev->vk.alloc, size, 8,
+                               VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
+      if (shaders->data)
+         memcpy(shaders->data, start, size);
+   }
+
+   if (blob->overrun || (size > 0 && !shaders->data)) {
+      tu_nir_shaders_destroy(&dev->vk, &shaders->base);
+      return NULL;
    }
 
    return &shaders->base;
@@ -1700,6 +1756,7 @@ tu_pipeline_builder_compile_shaders(struct tu_pipeline_builder *builder,
    nir_shader *nir[ARRAY_SIZE(stage_infos)] = { NULL };
    struct tu_shader *shaders[ARRAY_SIZE(stage_infos)] = { NULL };
    nir_shader *post_link_nir[ARRAY_SIZE(nir)] = { NULL };
+   struct tu_nir_shaders *post_link_nir_owner[ARRAY_SIZE(nir)] = { NULL };
    char *nir_initial_disasm[ARRAY_SIZE(stage_infos)] = { NULL };
    bool cache_hit = false;
 
@@ -1774,6 +1831,18 @@ tu_pipeline_builder_compile_shaders(struct tu_pipeline_builder *builder,
          ~attachments_referenced;
    }
 
+   /* A library that retains link-time optimization info is going to be
+    * recompiled from its NIR into an optimized pipeline (this is what DXVK
+    * and vkd3d-proton do), so its own shaders are only a stopgap used by
+    * fast-linked pipelines in the meantime. Compile them as quickly as
+    * possible to avoid hitches.
+    */
+   if ((builder->create_flags & VK_PIPELINE_CREATE_2_LIBRARY_BIT_KHR) &&
+       retain_nir) {
+      for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+         keys[i].fast_compile = true;
+   }
+
    if (builder->create_flags &
        VK_PIPELINE_CREATE_2_LINK_TIME_OPTIMIZATION_BIT_EXT) {
       for (unsigned i = 0; i < builder->num_libraries; i++) {
@@ -1783,8 +1852,11 @@ tu_pipeline_builder_compile_shaders(struct tu_pipeline_builder *builder,
             if (library->shaders[j].nir) {
                assert(!nir[j]);
                nir[j] = nir_shader_clone(builder->mem_ctx,
-                     library->shaders[j].nir);
+                     tu_nir_shaders_get(builder->device,
+                                        library->shaders[j].nir,
+                                        (gl_shader_stage) j));
                keys[j] = library->shaders[j].key;
+               keys[j].fast_compile = false;
                must_compile = true;
             }
          }
@@ -1926,6 +1998,7 @@ tu_pipeline_builder_compile_shaders(struct tu_pipeline_builder *builder,
                continue;
 
             nir_shaders->nir[stage] = post_link_nir[stage];
+            nir_shaders->stage_mask |= 1u << stage;
          }
 
          nir_shaders = tu_nir_cache_insert(builder->cache, nir_shaders);
@@ -1985,8 +2058,8 @@ done:
    if (nir_shaders) {
       for (gl_shader_stage stage = MESA_SHADER_VERTEX;
            stage < ARRAY_SIZE(nir); stage = (gl_shader_stage) (stage + 1)) {
-         if (nir_shaders->nir[stage]) {
-            post_link_nir[stage] = nir_shaders->nir[stage];
+         if (nir_shaders->stage_mask & (1u << stage)) {
+            post_link_nir_owner[stage] = nir_shaders;
          }
       }
    }
@@ -2000,8 +2073,8 @@ done:
       for (gl_shader_stage stage = MESA_SHADER_VERTEX;
            stage < ARRAY_SIZE(library->shaders);
            stage = (gl_shader_stage) (stage + 1)) {
-         if (!post_link_nir[stage] && library->shaders[stage].nir) {
-            post_link_nir[stage] = library->shaders[stage].nir;
+         if (!post_link_nir_owner[stage] && library->shaders[stage].nir) {
+            post_link_nir_owner[stage] = library->shaders[stage].nir;
             keys[stage] = library->shaders[stage].key;
          }
 
@@ -2035,7 +2108,7 @@ done:
       for (gl_shader_stage stage = MESA_SHADER_VERTEX;
            stage < ARRAY_SIZE(library->shaders);
            stage = (gl_shader_stage) (stage + 1)) {
-         library->shaders[stage].nir = post_link_nir[stage];
+         library->shaders[stage].nir = post_link_nir_owner[stage];
          library->shaders[stage].key = keys[stage];
       }
    }
@@ -2193,7 +2266,7 @@ tu_pipeline_set_linkage(struct tu_program_descriptor_linkage *link,
 }
 
 template <chip CHIP>
-static void
+void
 tu_emit_program_state(struct tu_cs *sub_cs,
                       struct tu_program_state *prog,
                       struct tu_shader **shaders)
@@ -2318,6 +2391,7 @@ tu_emit_program_state(struct tu_cs *sub_cs,
    prog->reads_shading_rate = fs->reads_shading_rate;
    prog->accesses_smask = fs->reads_smask || fs->writes_smask;
 }
+TU_GENX(tu_emit_program_state);
 
 static const enum mesa_vk_dynamic_graphics_state tu_vertex_input_state[] = {
    MESA_VK_DYNAMIC_VI,
@@ -3849,6 +3923,46 @@ emit_draw_state(const struct vk_dynamic_graphics_state *dynamic_state,
    return !BITSET_IS_EMPTY(temp);
 }
 
+/* Small dynamic states are often toggled back and forth between a few
+ * values from draw to draw. These are built on the stack, and an identical
+ * copy emitted earlier in the command buffer is pointed at instead of
+ * allocating and filling another one.
+ */
+static struct tu_draw_state
+tu_cmd_cached_dynamic_state(struct tu_cmd_buffer *cmd, uint32_t id,
+                            const uint32_t *dwords, uint32_t size)
+{
+   for (unsigned i = 0; i < TU_DYNAMIC_STATE_CACHE_SIZE; i++) {
+      const struct tu_dynamic_state_cache_entry *entry =
+         &cmd->state.dynamic_state_cache[i];
+      if (entry->state.size == size && entry->id == id &&
+          !memcmp(entry->dwords, dwords, size * sizeof(uint32_t)))
+         return entry->state;
+   }
+
+   struct tu_cs_memory memory;
+   VkResult result = tu_cs_alloc(&cmd->sub_cs, size, 1, &memory);
+   if (result != VK_SUCCESS) {
+      vk_command_buffer_set_error(&cmd->vk, result);
+      return (struct tu_draw_state) {};
+   }
+
+   memcpy(memory.map, dwords, size * sizeof(uint32_t));
+
+   struct tu_dynamic_state_cache_entry *entry =
+      &cmd->state.dynamic_state_cache[cmd->state.dynamic_state_cache_next];
+   cmd->state.dynamic_state_cache_next =
+      (cmd->state.dynamic_state_cache_next + 1) % TU_DYNAMIC_STATE_CACHE_SIZE;
+   entry->state = (struct tu_draw_state) {
+      .iova = memory.iova,
+      .size = size,
+   };
+   entry->id = id;
+   memcpy(entry->dwords, dwords, size * sizeof(uint32_t));
+
+   return entry->state;
+}
+
 template <chip CHIP>
 uint32_t
 tu_emit_draw_state(struct tu_cmd_buffer *cmd)
@@ -3863,11 +3977,20 @@ tu_emit_draw_state(struct tu_cmd_buffer *cmd)
    if ((EMIT_STATE(name) || (extra_cond)) &&                                  \
        !(cmd->state.pipeline_draw_states & (1u << id))) {                     \
       unsigned size = tu6_##name##_size<CHIP>(cmd->device, __VA_ARGS__);      \
-      if (size > 0) {                                                         \
+      if (size > TU_DYNAMIC_STATE_CACHE_MAX_DWORDS) {                         \
          tu_cs_begin_sub_stream(&cmd->sub_cs, size, &cs);                     \
          tu6_emit_##name<CHIP>(&cs, __VA_ARGS__);                             \
          cmd->state.dynamic_state[id] =                                       \
             tu_cs_end_draw_state(&cmd->sub_cs, &cs);                          \
+      } else if (size > 0) {                                                  \
+         uint32_t dwords[TU_DYNAMIC_STATE_CACHE_MAX_DWORDS];                  \
+         tu_cs_init_external(&cs, cmd->device, dwords, dwords + size, 0,      \
+                             false);                                          \
+         tu_cs_begin(&cs);                                                    \
+         tu_cs_reserve_space(&cs, size);                                      \
+         tu6_emit_##name<CHIP>(&cs, __VA_ARGS__);                             \
+         cmd->state.dynamic_state[id] =                                       \
+            tu_cmd_cached_dynamic_state(cmd, id, dwords, cs.cur - dwords);    \
       } else {                                                                \
          cmd->state.dynamic_state[id] = {};                                   \
       }                                                                       \
@@ -3892,12 +4015,6 @@ tu_emit_draw_state(struct tu_cmd_buffer *cmd)
          } else {                                                             \
             cmd->state.dynamic_state[id] = {};                                \
          }                                                                    \
-         tu_cs_begin_sub_stream(&cmd->sub_cs,                                 \
-                                tu6_##name##_size<CHIP>(cmd->device, __VA_ARGS__),  \
-                                &cs);                                         \
-         tu6_emit_##name<CHIP>(&cs, __VA_ARGS__);                             \
-         cmd->state.dynamic_state[id] =                                       \
-            tu_cs_end_draw_state(&cmd->sub_cs, &cs);                          \
       }                                                                       \
       dirty_draw_states |= (1u << id);                                        \
    }
@@ -4862,6 +4979,14 @@ tu_GetPipelineExecutableStatisticsKHR(
    }
 
    vk_add_adreno_stats(out, &stats);
+
+   /* Not part of the shared adreno stats, where it would make shader-db
+    * reports nondeterministic.
+    */
+   vk_add_exec_statistic_u64(out, "Compile time",
+                             "Time in microseconds spent compiling the shader "
+                             "executable from NIR, when it was first built.",
+                             exe->stats.compile_time_us);
    return vk_outarray_status(&out);
 }
 
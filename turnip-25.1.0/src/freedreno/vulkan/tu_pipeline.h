@@ -64,8 +64,18 @@ struct tu_nir_shaders
 
    /* This is optional, and is only filled out when a library pipeline is
     * compiled with RETAIN_LINK_TIME_OPTIMIZATION_INFO.
+    *
+    * When loaded from a pipeline cache, each stage is kept serialized in
+    * data until tu_nir_shaders_get() asks for it, since most libraries are
+    * never linked with LTO.
     */
+   uint32_t stage_mask;
    nir_shader *nir[MESA_SHADER_STAGES];
+
+   void *data;
+   uint32_t data_offset[MESA_SHADER_STAGES];
+   uint32_t data_size[MESA_SHADER_STAGES];
+   mtx_t lock;
 };
 
 extern const struct vk_pipeline_cache_object_ops tu_nir_shaders_ops;
@@ -196,7 +206,8 @@ struct tu_graphics_lib_pipeline {
 
    struct tu_nir_shaders *nir_shaders;
    struct {
-      nir_shader *nir;
+      /* Owner of this stage's link-time NIR, see tu_nir_shaders_get(). */
+      struct tu_nir_shaders *nir;
       struct tu_shader_key key;
    } shaders[MESA_SHADER_FRAGMENT + 1];
 
@@ -275,6 +286,12 @@ tu6_emit_vpc(struct tu_cs *cs,
              const struct ir3_shader_variant *gs,
              const struct ir3_shader_variant *fs);
 
+template <chip CHIP>
+void
+tu_emit_program_state(struct tu_cs *sub_cs,
+                      struct tu_program_state *prog,
+                      struct tu_shader **shaders);
+
 void
 tu_fill_render_pass_state(struct vk_render_pass_state *rp,
                           const struct tu_render_pass *pass,
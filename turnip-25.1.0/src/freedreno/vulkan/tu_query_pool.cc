@@ -12,6 +12,7 @@
 
 #include "nir/nir_builder.h"
 #include "util/os_time.h"
+#include "util/perf/u_stall.h"
 
 #include "vk_acceleration_structure.h"
 #include "vk_util.h"
@@ -391,7 +392,8 @@ tu_CreateQueryPool(VkDevice _device,
    }
 
    VkResult result = tu_bo_init_new(device, &pool->vk.base, &pool->bo,
-         pCreateInfo->queryCount * slot_size, TU_BO_ALLOC_NO_FLAGS, "query pool");
+         pCreateInfo->queryCount * slot_size, TU_BO_ALLOC_NO_FLAGS,
+         TU_MEM_CATEGORY_QUERY, "query pool");
    if (result != VK_SUCCESS) {
       vk_query_pool_destroy(&device->vk, pAllocator, &pool->vk);
       return result;
@@ -526,22 +528,59 @@ is_pipeline_query_with_compute_stage(uint32_t pipeline_statistics)
           VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
 }
 
-/* Wait on the the availability status of a query up until a timeout. */
+static const char *
+pool_type_name(const struct tu_query_pool *pool)
+{
+   switch (pool->vk.query_type) {
+   case VK_QUERY_TYPE_OCCLUSION:
+      return "occlusion";
+   case VK_QUERY_TYPE_TIMESTAMP:
+      return "timestamp";
+   case VK_QUERY_TYPE_PIPELINE_STATISTICS:
+      return "pipeline statistics";
+   default:
+      return "other queries";
+   }
+}
+
+/* Wait on the the availability status of a range of queries up until a
+ * timeout shared by the whole range.
+ */
 static VkResult
 wait_for_available(struct tu_device *device, struct tu_query_pool *pool,
-                   uint32_t query)
+                   uint32_t firstQuery, uint32_t queryCount)
 {
    /* TODO: Use the MSM_IOVA_WAIT ioctl to wait on the available bit in a
     * scheduler friendly way instead of busy polling once the patch has landed
     * upstream. */
-   struct query_slot *slot = slot_address(pool, query);
-   uint64_t abs_timeout = os_time_get_absolute_timeout(
-         WAIT_TIMEOUT * NSEC_PER_SEC);
-   while(os_time_get_nano() < abs_timeout) {
+   U_STALL_SITE(wait_site, "turnip query availability");
+   uint64_t abs_timeout = 0;
+   bool stall = false;
+
+   /* Queries usually become available in order, so start from the last one:
+    * once it is available the rest mostly are too and need a single check.
+    */
+   for (uint32_t i = queryCount; i-- > 0;) {
+      struct query_slot *slot = slot_address(pool, firstQuery + i);
       if (query_is_available(slot))
-         return VK_SUCCESS;
+         continue;
+
+      if (!abs_timeout) {
+         stall = u_stall_begin(&wait_site, pool_type_name(pool));
+         tu_device_flush_deferred_submits(device);
+         abs_timeout = os_time_get_absolute_timeout(
+               WAIT_TIMEOUT * NSEC_PER_SEC);
+      }
+
+      while (!query_is_available(slot)) {
+         if (os_time_get_nano() >= abs_timeout) {
+            u_stall_end(stall);
+            return vk_error(device, VK_TIMEOUT);
+         }
+      }
    }
-   return vk_error(device, VK_TIMEOUT);
+   u_stall_end(stall);
+   return VK_SUCCESS;
 }
 
 /* Writes a query value to a buffer from the CPU. */
@@ -600,20 +639,30 @@ get_query_pool_results(struct tu_device *device,
 {
    assert(dataSize >= stride * queryCount);
 
+   if (flags & VK_QUERY_RESULT_WAIT_BIT) {
+      VkResult wait_result =
+         wait_for_available(device, pool, firstQuery, queryCount);
+      if (wait_result != VK_SUCCESS)
+         return wait_result;
+   }
+
    char *result_base = (char *) pData;
    VkResult result = VK_SUCCESS;
+   bool flushed = false;
    for (uint32_t i = 0; i < queryCount; i++) {
       uint32_t query = firstQuery + i;
       struct query_slot *slot = slot_address(pool, query);
       bool available = query_is_available(slot);
       uint32_t result_count = get_result_count(pool);
+
+      if (!available && !flushed) {
+         tu_device_flush_deferred_submits(device);
+         flushed = true;
+      }
       uint32_t statistics = pool->vk.pipeline_statistics;
 
-      if ((flags & VK_QUERY_RESULT_WAIT_BIT) && !available) {
-         VkResult wait_result = wait_for_available(device, pool, query);
-         if (wait_result != VK_SUCCESS)
-            return wait_result;
-         available = true;
+      if (flags & VK_QUERY_RESULT_WAIT_BIT) {
+         assert(available);
       } else if (!(flags & VK_QUERY_RESULT_PARTIAL_BIT) && !available) {
          /* From the Vulkan 1.1.130 spec:
           *
@@ -806,6 +855,24 @@ emit_copy_query_pool_results(struct tu_cmd_buffer *cmdbuf,
          tu_cs_emit(cs, CP_WAIT_REG_MEM_5_DELAY_LOOP_CYCLES(16));
       }
 
+      /* Unless every result is copied unconditionally, predicate them all
+       * on the available bit with a single CP_COND_EXEC. After waiting on
+       * the bit above the predicate always passes and can be skipped.
+       *
+       * NOTE: For the conditional packets to be executed, CP_COND_EXEC
+       * tests that ADDR0 != 0 and ADDR1 < REF. The packet here simply tests
+       * that 0 < available < 2, aka available == 1.
+       */
+      if (!(flags & (VK_QUERY_RESULT_PARTIAL_BIT | VK_QUERY_RESULT_WAIT_BIT))) {
+         tu_cs_reserve(cs, 7 + 6 * result_count);
+         tu_cs_emit_pkt7(cs, CP_COND_EXEC, 6);
+         tu_cs_emit_qw(cs, available_iova);
+         tu_cs_emit_qw(cs, available_iova);
+         tu_cs_emit(cs, CP_COND_EXEC_4_REF(0x2));
+         /* Cond execute the next 6 DWORDS of each copy */
+         tu_cs_emit(cs, 6 * result_count);
+      }
+
       for (uint32_t k = 0; k < result_count; k++) {
          uint64_t result_iova;
 
@@ -822,34 +889,13 @@ emit_copy_query_pool_results(struct tu_cmd_buffer *cmdbuf,
             result_iova = query_result_iova(pool, query, uint64_t, k);
          }
 
-         if (flags & VK_QUERY_RESULT_PARTIAL_BIT) {
-            /* Unconditionally copying the bo->result into the buffer here is
-             * valid because we only set bo->result on vkCmdEndQuery. Thus, even
-             * if the query is unavailable, this will copy the correct partial
-             * value of 0.
-             */
-            copy_query_value_gpu(cmdbuf, cs, result_iova, buffer_iova,
-                                 k /* offset */, flags);
-         } else {
-            /* Conditionally copy bo->result into the buffer based on whether the
-             * query is available.
-             *
-             * NOTE: For the conditional packets to be executed, CP_COND_EXEC
-             * tests that ADDR0 != 0 and ADDR1 < REF. The packet here simply tests
-             * that 0 < available < 2, aka available == 1.
-             */
-            tu_cs_reserve(cs, 7 + 6);
-            tu_cs_emit_pkt7(cs, CP_COND_EXEC, 6);
-            tu_cs_emit_qw(cs, available_iova);
-            tu_cs_emit_qw(cs, available_iova);
-            tu_cs_emit(cs, CP_COND_EXEC_4_REF(0x2));
-            tu_cs_emit(cs, 6); /* Cond execute the next 6 DWORDS */
-
-            /* Start of conditional execution */
-            copy_query_value_gpu(cmdbuf, cs, result_iova, buffer_iova,
+         /* With VK_QUERY_RESULT_PARTIAL_BIT, unconditionally copying the
+          * bo->result into the buffer here is valid because we only set
+          * bo->result on vkCmdEndQuery. Thus, even if the query is
+          * unavailable, this will copy the correct partial value of 0.
+          */
+         copy_query_value_gpu(cmdbuf, cs, result_iova, buffer_iova,
                               k /* offset */, flags);
-            /* End of conditional execution */
-         }
       }
 
       if (flags & VK_QUERY_RESULT_WITH_AVAILABILITY_BIT) {
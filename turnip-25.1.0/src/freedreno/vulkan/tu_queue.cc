@@ -16,6 +16,8 @@
 
 #include "vk_util.h"
 
+#include <unistd.h>
+
 static int
 tu_get_submitqueue_priority(const struct tu_physical_device *pdevice,
                             VkQueueGlobalPriorityKHR global_priority,
@@ -266,6 +268,12 @@ tu_queue_init(struct tu_device *device,
                                "submitqueue create failed");
 
    queue->fence = -1;
+   queue->retired_timestamp = -1;
+   util_dynarray_init(&queue->deferred_cmds, NULL);
+
+   mtx_init(&queue->ts_fd_lock, mtx_plain);
+   for (unsigned i = 0; i < ARRAY_SIZE(queue->ts_fds); i++)
+      queue->ts_fds[i].fd = -1;
 
    return VK_SUCCESS;
 }
@@ -274,6 +282,14 @@ void
 tu_queue_finish(struct tu_queue *queue)
 {
    vk_queue_finish(&queue->vk);
+   util_dynarray_fini(&queue->deferred_cmds);
    tu_drm_submitqueue_close(queue->device, queue->msm_queue_id);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(queue->ts_fds); i++) {
+      assert(!queue->ts_fds[i].users);
+      if (queue->ts_fds[i].fd >= 0)
+         close(queue->ts_fds[i].fd);
+   }
+   mtx_destroy(&queue->ts_fd_lock);
 }
 
@@ -12,6 +12,16 @@
 
 #include "tu_common.h"
 
+/* A sync file for a kgsl queue timestamp, shared by waiters on it. */
+struct tu_queue_ts_fd
+{
+   uint32_t timestamp;
+   int fd;
+   uint32_t users;
+};
+
+#define TU_QUEUE_TS_FD_CACHE_SIZE 8
+
 struct tu_queue
 {
    struct vk_queue vk;
@@ -22,6 +32,22 @@ struct tu_queue
    uint32_t priority;
 
    int fence;           /* timestamp/fence of the last queue submission */
+
+   /* kgsl: the most recent timestamp known to be retired, or -1. Updated
+    * with atomics so status checks of old fences don't need the kernel.
+    */
+   int64_t retired_timestamp;
+
+   /* kgsl_command_objects of submits held back by TU_DEBUG=defer_submit,
+    * protected by the device submit_mutex.
+    */
+   struct util_dynarray deferred_cmds;
+
+   /* kgsl: sync files of recently waited-on timestamps, so that repeated
+    * waits don't create a new one every time.
+    */
+   struct tu_queue_ts_fd ts_fds[TU_QUEUE_TS_FD_CACHE_SIZE];
+   mtx_t ts_fd_lock;
 };
 VK_DEFINE_HANDLE_CASTS(tu_queue, vk.base, VkQueue, VK_OBJECT_TYPE_QUEUE)
 
@@ -0,0 +1,93 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "tu_rp_log.h"
+
+#include <errno.h>
+
+#include "util/os_time.h"
+
+#include "tu_device.h"
+
+void
+tu_rp_log_init(struct tu_device *device)
+{
+   const char *path = os_get_option("TU_RP_LOG");
+
+   device->rp_log = NULL;
+   if (!path)
+      return;
+
+   struct tu_rp_log *log =
+      (struct tu_rp_log *) calloc(1, sizeof(struct tu_rp_log));
+   if (!log)
+      return;
+
+   log->file = fopen(path, "wbe");
+   if (!log->file) {
+      mesa_loge("TU_RP_LOG: failed to open %s: %s", path, strerror(errno));
+      free(log);
+      return;
+   }
+
+   struct tu_rp_log_header header = {
+      .magic = TU_RP_LOG_MAGIC,
+      .version = TU_RP_LOG_VERSION,
+      .gpu_id = device->physical_device->dev_id.gpu_id,
+      .chip_id = device->physical_device->dev_id.chip_id,
+   };
+   fwrite(&header, sizeof(header), 1, log->file);
+
+   mtx_init(&log->lock, mtx_plain);
+   device->rp_log = log;
+}
+
+void
+tu_rp_log_finish(struct tu_device *device)
+{
+   struct tu_rp_log *log = device->rp_log;
+   if (!log)
+      return;
+
+   fclose(log->file);
+   mtx_destroy(&log->lock);
+   free(log);
+   device->rp_log = NULL;
+}
+
+void
+tu_rp_log_write(struct tu_device *device, const struct tu_rp_log_record *rec)
+{
+   struct tu_rp_log *log = device->rp_log;
+
+   mtx_lock(&log->lock);
+   fwrite(rec, rec->size, 1, log->file);
+   mtx_unlock(&log->lock);
+}
+
+void
+tu_rp_log_frame(struct tu_device *device)
+{
+   struct tu_rp_log *log = device->rp_log;
+   if (!log)
+      return;
+
+   mtx_lock(&log->lock);
+
+   struct tu_rp_log_frame rec = {
+      .hdr = {
+         .type = TU_RP_LOG_RECORD_FRAME,
+         .size = sizeof(rec),
+      },
+      .frame = log->frame++,
+      .timestamp_ns = (uint64_t) os_time_get_nano(),
+   };
+   fwrite(&rec, sizeof(rec), 1, log->file);
+
+   /* so that a crashing or killed app still leaves whole frames behind */
+   fflush(log->file);
+
+   mtx_unlock(&log->lock);
+}
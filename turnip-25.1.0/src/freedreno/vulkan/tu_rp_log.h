@@ -0,0 +1,39 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_RP_LOG_H
+#define TU_RP_LOG_H
+
+#include "tu_common.h"
+
+#include "tu_rp_log_format.h"
+
+/* TU_RP_LOG=<file> writes a binary log of the sysmem/GMEM, binning and LRZ
+ * decisions made for each render pass and of the autotuner's measurements,
+ * with frame markers, for decoding with the tu_rp_log tool.  See
+ * tu_rp_log_format.h for the format.
+ */
+struct tu_rp_log
+{
+   FILE *file;
+   mtx_t lock;
+   uint64_t frame;
+};
+
+void
+tu_rp_log_init(struct tu_device *device);
+
+void
+tu_rp_log_finish(struct tu_device *device);
+
+/* Appends a record, whose hdr.type and hdr.size must be set. */
+void
+tu_rp_log_write(struct tu_device *device, const struct tu_rp_log_record *rec);
+
+/* Marks a frame boundary, called on present. */
+void
+tu_rp_log_frame(struct tu_device *device);
+
+#endif /* TU_RP_LOG_H */
@@ -0,0 +1,123 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_RP_LOG_FORMAT_H
+#define TU_RP_LOG_FORMAT_H
+
+#include <stdint.h>
+
+/* On-disk format of the TU_RP_LOG render pass decision log, shared between
+ * turnip and the tu_rp_log tool, so it must not depend on driver headers.
+ *
+ * The file is a tu_rp_log_header followed by records.  Every record starts
+ * with a tu_rp_log_record giving its type and total size, so readers can
+ * skip types they don't know.  All fields are little-endian and naturally
+ * aligned; new fields may only be appended to a record.
+ *
+ * PASS records are written when a render pass is recorded into a command
+ * buffer, with the decisions made for it.  RESULT records are written
+ * each time the autotuner reads back what the GPU measured for an execution
+ * of a pass, and FRAME records on every present.  Reused command buffers
+ * therefore produce one PASS record and a RESULT per submission, matched up
+ * by rp_key.
+ */
+
+#define TU_RP_LOG_MAGIC "TURPLOG"
+#define TU_RP_LOG_VERSION 1
+
+struct tu_rp_log_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t gpu_id;
+   uint64_t chip_id;
+};
+
+enum tu_rp_log_record_type {
+   TU_RP_LOG_RECORD_FRAME = 1,
+   TU_RP_LOG_RECORD_PASS = 2,
+   TU_RP_LOG_RECORD_RESULT = 3,
+};
+
+struct tu_rp_log_record {
+   uint16_t type;
+   uint16_t size;
+   uint32_t _pad;
+};
+
+struct tu_rp_log_frame {
+   struct tu_rp_log_record hdr;
+   uint64_t frame;
+   uint64_t timestamp_ns; /* CLOCK_MONOTONIC */
+};
+
+/* Why a pass went to sysmem or GMEM. */
+enum tu_rp_log_reason {
+   TU_RP_LOG_REASON_AUTOTUNE = 0,          /* bandwidth estimate from history */
+   TU_RP_LOG_REASON_AUTOTUNE_TIMED = 1,    /* TU_DEBUG=autotune_time */
+   TU_RP_LOG_REASON_AUTOTUNE_FALLBACK = 2, /* no history, or autotune unusable */
+   TU_RP_LOG_REASON_SINGLE_PRIM_MODE = 3,  /* feedback loop forces GMEM */
+   TU_RP_LOG_REASON_DEBUG_SYSMEM = 4,
+   TU_RP_LOG_REASON_DEBUG_GMEM = 5,
+   TU_RP_LOG_REASON_GMEM_TOO_SMALL = 6,    /* attachments don't fit in GMEM */
+   TU_RP_LOG_REASON_EMPTY_RENDER_AREA = 7,
+   TU_RP_LOG_REASON_TESS = 8,
+   TU_RP_LOG_REASON_GMEM_DISABLED = 9,     /* e.g. unaligned or self-dependent */
+   TU_RP_LOG_REASON_XFB = 10,
+   TU_RP_LOG_REASON_PRIM_GENERATED_QUERY = 11,
+   TU_RP_LOG_REASON_FDM = 12,              /* fragment density map forces GMEM */
+   TU_RP_LOG_REASON_COUNT,
+};
+
+/* Why LRZ was invalidated, or LRZ writes disabled, for the rest of a render
+ * pass.
+ */
+enum tu_lrz_disable_reason {
+   TU_LRZ_DISABLE_NONE = 0,
+   TU_LRZ_DISABLE_MULTIPLE_DEPTH_ATTACHMENTS = 1,
+   TU_LRZ_DISABLE_FS = 2,                /* FS writes depth, discards, ... */
+   TU_LRZ_DISABLE_ALWAYS_NOT_EQUAL = 3,  /* with depth writes */
+   TU_LRZ_DISABLE_DIRECTION_CHANGE = 4,
+   TU_LRZ_DISABLE_STENCIL_KILL = 5,      /* stencil test may kill fragments */
+   TU_LRZ_DISABLE_BLEND_DEPTH_WRITE = 6,
+   TU_LRZ_DISABLE_CLEAR_IN_RP = 7,       /* depth cleared inside the pass */
+   TU_LRZ_DISABLE_COUNT,
+};
+
+#define TU_RP_LOG_LRZ_IMAGE      (1 << 0) /* pass has an LRZ-capable depth */
+#define TU_RP_LOG_LRZ_VALID      (1 << 1) /* still valid at the end of the pass */
+#define TU_RP_LOG_LRZ_FAST_CLEAR (1 << 2)
+#define TU_RP_LOG_LRZ_GPU_DIR    (1 << 3) /* GPU direction tracking */
+#define TU_RP_LOG_LRZ_NO_WRITE   (1 << 4) /* LRZ writes disabled for the pass */
+
+struct tu_rp_log_pass {
+   struct tu_rp_log_record hdr;
+   uint64_t rp_key;            /* same key as the autotuner's history */
+   uint8_t sysmem;
+   uint8_t reason;             /* enum tu_rp_log_reason */
+   uint8_t binning;            /* GMEM only: hw binning used */
+   uint8_t lrz_flags;          /* TU_RP_LOG_LRZ_* */
+   uint8_t lrz_disable_reason; /* enum tu_lrz_disable_reason */
+   uint8_t _pad[3];
+   uint16_t render_width;
+   uint16_t render_height;
+   uint16_t bins_x;
+   uint16_t bins_y;
+   uint16_t pipes_x;
+   uint16_t pipes_y;
+   uint32_t drawcall_count;
+   uint32_t avg_samples;       /* autotune history, 0 if none */
+   uint32_t _pad2;
+};
+
+struct tu_rp_log_result {
+   struct tu_rp_log_record hdr;
+   uint64_t rp_key;
+   uint8_t sysmem;
+   uint8_t _pad[7];
+   uint64_t samples_passed;
+   uint64_t duration_ns;       /* GPU time of the pass, 0 if not measured */
+};
+
+#endif /* TU_RP_LOG_FORMAT_H */
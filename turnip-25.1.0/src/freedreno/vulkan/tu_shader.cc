@@ -2204,24 +2204,33 @@ tu_setup_pvtmem(struct tu_device *dev,
    mtx_lock(&pvtmem_bo->mtx);
 
    if (pvtmem_bo->per_fiber_size < pvtmem_bytes) {
-      if (pvtmem_bo->bo)
-         tu_bo_finish(dev, pvtmem_bo->bo);
-
-      pvtmem_bo->per_fiber_size =
+      uint32_t per_fiber_size =
          util_next_power_of_two(ALIGN(pvtmem_bytes, 512));
-      pvtmem_bo->per_sp_size =
-         ALIGN(pvtmem_bo->per_fiber_size *
-                  dev->physical_device->info->fibers_per_sp,
+      uint32_t per_sp_size =
+         ALIGN(per_fiber_size * dev->physical_device->info->fibers_per_sp,
                1 << 12);
       uint32_t total_size =
-         dev->physical_device->info->num_sp_cores * pvtmem_bo->per_sp_size;
+         dev->physical_device->info->num_sp_cores * per_sp_size;
 
-      VkResult result = tu_bo_init_new(dev, NULL, &pvtmem_bo->bo, total_size,
-                                       TU_BO_ALLOC_INTERNAL_RESOURCE, "pvtmem");
+      /* Only replace the pool once the bigger BO exists, so that a failed
+       * allocation leaves the previous one usable for smaller shaders.
+       * Shaders using the previous BO keep their own reference to it.
+       */
+      struct tu_bo *bo;
+      VkResult result = tu_bo_init_new(dev, NULL, &bo, total_size,
+                                       TU_BO_ALLOC_INTERNAL_RESOURCE,
+                                       TU_MEM_CATEGORY_SCRATCH, "pvtmem");
       if (result != VK_SUCCESS) {
          mtx_unlock(&pvtmem_bo->mtx);
          return result;
       }
+
+      if (pvtmem_bo->bo)
+         tu_bo_finish(dev, pvtmem_bo->bo);
+
+      pvtmem_bo->bo = bo;
+      pvtmem_bo->per_fiber_size = per_fiber_size;
+      pvtmem_bo->per_sp_size = per_sp_size;
    }
 
    config->per_wave = per_wave;
@@ -2676,6 +2685,7 @@ tu_shader_create(struct tu_device *dev,
       .push_consts_dwords = shader->const_state.push_consts.dwords,
       .const_allocs = const_allocs,
       .nir_options = nir_options,
+      .fast_compile = key->fast_compile,
    };
 
    struct ir3_shader *ir3_shader =
@@ -2824,7 +2834,7 @@ tu_link_shaders(nir_shader **shaders, unsigned shaders_count)
    }
 }
 
-static uint32_t
+uint32_t
 tu6_get_tessmode(const struct nir_shader *shader)
 {
    enum tess_primitive_mode primitive_mode = shader->info.tess._primitive_mode;
@@ -2842,6 +2852,35 @@ tu6_get_tessmode(const struct nir_shader *shader)
    }
 }
 
+struct tu_compile_job {
+   struct tu_device *device;
+   struct tu_shader **shader_out;
+   nir_shader *nir;
+   const struct tu_shader_key *key;
+   const struct ir3_shader_key *ir3_key;
+   unsigned char shader_sha1[21];
+   struct tu_pipeline_layout *layout;
+   bool executable_info;
+
+   VkResult result;
+   int64_t duration;
+   struct util_queue_fence fence;
+};
+
+static void
+tu_compile_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct tu_compile_job *job = (struct tu_compile_job *) data;
+   int64_t start = os_time_get_nano();
+
+   job->result = tu_shader_create(job->device, job->shader_out, job->nir,
+                                  job->key, job->ir3_key, job->shader_sha1,
+                                  sizeof(job->shader_sha1), job->layout,
+                                  job->executable_info);
+
+   job->duration = os_time_get_nano() - start;
+}
+
 VkResult
 tu_compile_shaders(struct tu_device *device,
                    VkPipelineCreateFlags2KHR pipeline_flags,
@@ -2958,26 +2997,66 @@ tu_compile_shaders(struct tu_device *device,
    if (nir[MESA_SHADER_TESS_CTRL] && !nir[MESA_SHADER_FRAGMENT])
       ir3_key.tcs_store_primid = true;
 
+   /* Once linked and with the ir3 key settled, the stages don't depend on
+    * each other anymore. All but the last one are handed to the device's
+    * compile queue and the last one is compiled on the calling thread.
+    */
+   struct tu_compile_job jobs[MESA_SHADER_STAGES];
+   uint32_t job_mask = 0;
    for (gl_shader_stage stage = MESA_SHADER_VERTEX; stage < MESA_SHADER_STAGES;
         stage = (gl_shader_stage) (stage + 1)) {
       if (!nir[stage] || shaders[stage])
          continue;
 
-      int64_t stage_start = os_time_get_nano();
+      /* tu_shader_create() frees the NIR, which must not touch the shared
+       * mem_ctx from several threads.
+       */
+      ralloc_steal(ralloc_context(mem_ctx), nir[stage]);
+
+      jobs[stage] = (struct tu_compile_job) {
+         .device = device,
+         .shader_out = &shaders[stage],
+         .nir = nir[stage],
+         .key = &keys[stage],
+         .ir3_key = &ir3_key,
+         .layout = layout,
+         .executable_info = !!nir_initial_disasm,
+      };
+      memcpy(jobs[stage].shader_sha1, pipeline_sha1, 20);
+      jobs[stage].shader_sha1[20] = (unsigned char) stage;
+      job_mask |= BITFIELD_BIT(stage);
+   }
 
-      unsigned char shader_sha1[21];
-      memcpy(shader_sha1, pipeline_sha1, 20);
-      shader_sha1[20] = (unsigned char) stage;
+   if (job_mask) {
+      bool threaded = util_queue_is_initialized(&device->compile_queue);
+      unsigned last = util_last_bit(job_mask) - 1;
 
-      result = tu_shader_create(device,
-                                &shaders[stage], nir[stage], &keys[stage],
-                                &ir3_key, shader_sha1, sizeof(shader_sha1),
-                                layout, !!nir_initial_disasm);
-      if (result != VK_SUCCESS) {
-         goto fail;
+      u_foreach_bit (stage, job_mask & ~BITFIELD_BIT(last)) {
+         if (threaded) {
+            util_queue_fence_init(&jobs[stage].fence);
+            util_queue_add_job(&device->compile_queue, &jobs[stage],
+                               &jobs[stage].fence, tu_compile_job_execute,
+                               NULL, 0);
+         } else {
+            tu_compile_job_execute(&jobs[stage], NULL, 0);
+         }
       }
 
-      stage_feedbacks[stage].duration += os_time_get_nano() - stage_start;
+      tu_compile_job_execute(&jobs[last], NULL, 0);
+
+      u_foreach_bit (stage, job_mask) {
+         if (threaded && stage != last) {
+            util_queue_fence_wait(&jobs[stage].fence);
+            util_queue_fence_destroy(&jobs[stage].fence);
+         }
+
+         stage_feedbacks[stage].duration += jobs[stage].duration;
+         if (jobs[stage].result != VK_SUCCESS)
+            result = jobs[stage].result;
+      }
+
+      if (result != VK_SUCCESS)
+         goto fail;
    }
 
    ralloc_free(mem_ctx);
@@ -112,6 +112,7 @@ struct tu_shader_key {
    bool robust_storage_access2;
    bool robust_uniform_access2;
    bool lower_view_index_to_device_index;
+   bool fast_compile;
    enum ir3_wavesize_option api_wavesize, real_wavesize;
 };
 
@@ -180,6 +181,9 @@ void
 tu_shader_key_robustness(struct tu_shader_key *key,
                          const struct vk_pipeline_robustness_state *rs);
 
+uint32_t
+tu6_get_tessmode(const struct nir_shader *shader);
+
 VkResult
 tu_compile_shaders(struct tu_device *device,
                    VkPipelineCreateFlags2KHR pipeline_flags,
@@ -0,0 +1,454 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "tu_shader_object.h"
+
+#include "nir/nir_serialize.h"
+#include "util/mesa-sha1.h"
+#include "vk_pipeline.h"
+#include "vk_util.h"
+
+#include "ir3/ir3_compiler.h"
+#include "ir3/ir3_nir.h"
+
+#include "tu_device.h"
+
+struct tu_shader_object_binary
+{
+   uint8_t cache_uuid[VK_UUID_SIZE];
+   uint32_t stage;
+   struct tu_shader_key key;
+   uint8_t tess_mode;
+   unsigned char nir_sha1[20];
+   uint32_t nir_size;
+};
+
+static const struct tu_shader_object_binary *
+tu_shader_object_get_binary(const struct tu_shader_object *obj)
+{
+   return (const struct tu_shader_object_binary *) obj->binary;
+}
+
+/* Only keep the parts of the key the stage actually depends on, so that
+ * stages don't get compiled several times for the same variant.
+ */
+static struct tu_shader_object_key
+tu_shader_object_canonical_key(const struct tu_shader_object *obj,
+                               const struct tu_shader_object_key *key)
+{
+   struct tu_shader_object_key canonical;
+   memset(&canonical, 0, sizeof(canonical));
+
+   switch (obj->stage) {
+   case MESA_SHADER_VERTEX:
+      canonical = *key;
+      break;
+   case MESA_SHADER_TESS_CTRL:
+      canonical.tessellation = key->tessellation;
+      canonical.has_gs = key->has_gs;
+      break;
+   case MESA_SHADER_TESS_EVAL:
+      canonical.tessellation = obj->tess_mode;
+      canonical.has_gs = key->has_gs;
+      break;
+   case MESA_SHADER_GEOMETRY:
+      canonical.tessellation = key->tessellation;
+      canonical.has_gs = true;
+      break;
+   case MESA_SHADER_FRAGMENT:
+      canonical.multiview_mask = key->multiview_mask;
+      break;
+   default:
+      break;
+   }
+
+   return canonical;
+}
+
+static VkResult
+tu_shader_object_compile(struct tu_device *dev,
+                         struct tu_shader_object *obj,
+                         const struct tu_shader_object_key *key,
+                         struct tu_shader **shader_out)
+{
+   const struct tu_shader_object_binary *binary =
+      tu_shader_object_get_binary(obj);
+
+   unsigned char shader_sha1[21];
+   struct mesa_sha1 ctx;
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, binary->nir_sha1, sizeof(binary->nir_sha1));
+   _mesa_sha1_update(&ctx, &obj->key, sizeof(obj->key));
+   _mesa_sha1_update(&ctx, obj->layout.sha1, sizeof(obj->layout.sha1));
+   _mesa_sha1_update(&ctx, key, sizeof(*key));
+   enum ir3_shader_debug ir3_debug_key = ir3_shader_debug_hash_key();
+   _mesa_sha1_update(&ctx, &ir3_debug_key, sizeof(ir3_debug_key));
+   _mesa_sha1_final(&ctx, shader_sha1);
+   shader_sha1[20] = (unsigned char) obj->stage;
+
+   struct vk_pipeline_cache_object *cache_obj =
+      vk_pipeline_cache_lookup_object(dev->mem_cache, shader_sha1,
+                                      sizeof(shader_sha1), &tu_shader_ops,
+                                      NULL);
+   if (cache_obj) {
+      *shader_out = container_of(cache_obj, struct tu_shader, base);
+      return VK_SUCCESS;
+   }
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, (const uint8_t *) obj->binary + sizeof(*binary),
+                    binary->nir_size);
+   nir_shader *nir =
+      nir_deserialize(NULL, ir3_get_compiler_options(dev->compiler), &reader);
+   if (!nir)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   struct tu_shader_key shader_key = obj->key;
+   shader_key.multiview_mask = key->multiview_mask;
+
+   struct ir3_shader_key ir3_key = {};
+   ir3_key.tessellation = key->tessellation;
+   ir3_key.has_gs = key->has_gs;
+   /* We don't know whether the FS will read PrimID, so the TCS has to store
+    * it unconditionally, as in the tess-but-not-FS case of pipelines.
+    */
+   ir3_key.tcs_store_primid = key->tessellation != IR3_TESS_NONE;
+
+   struct tu_shader *shader;
+   VkResult result = tu_shader_create(dev, &shader, nir, &shader_key,
+                                      &ir3_key, shader_sha1,
+                                      sizeof(shader_sha1), &obj->layout,
+                                      false);
+   if (result != VK_SUCCESS)
+      return result;
+
+   cache_obj = vk_pipeline_cache_add_object(dev->mem_cache, &shader->base);
+   *shader_out = container_of(cache_obj, struct tu_shader, base);
+   return VK_SUCCESS;
+}
+
+struct tu_shader *
+tu_shader_object_get_variant(struct tu_device *dev,
+                             struct tu_shader_object *obj,
+                             const struct tu_shader_object_key *key)
+{
+   struct tu_shader_object_key canonical =
+      tu_shader_object_canonical_key(obj, key);
+   struct tu_shader *shader = NULL;
+
+   mtx_lock(&obj->lock);
+
+   util_dynarray_foreach (&obj->variants, struct tu_shader_object_variant,
+                          variant) {
+      if (!memcmp(&variant->key, &canonical, sizeof(canonical))) {
+         shader = variant->shader;
+         break;
+      }
+   }
+
+   if (!shader &&
+       tu_shader_object_compile(dev, obj, &canonical, &shader) == VK_SUCCESS) {
+      struct tu_shader_object_variant variant = {
+         .key = canonical,
+         .shader = shader,
+      };
+      util_dynarray_append(&obj->variants, struct tu_shader_object_variant,
+                           variant);
+   }
+
+   mtx_unlock(&obj->lock);
+
+   return shader;
+}
+
+static VkResult
+tu_shader_object_init_from_spirv(struct tu_device *dev,
+                                 struct tu_shader_object *obj,
+                                 const VkShaderCreateInfoEXT *info)
+{
+   const VkPipelineShaderStageRequiredSubgroupSizeCreateInfo *subgroup_info =
+      vk_find_struct_const(info->pNext,
+                           PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO);
+   tu_shader_key_subgroup_size(&obj->key,
+                               info->flags &
+                               VK_SHADER_CREATE_ALLOW_VARYING_SUBGROUP_SIZE_BIT_EXT,
+                               info->flags &
+                               VK_SHADER_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT,
+                               subgroup_info, dev);
+
+   struct vk_pipeline_robustness_state rs;
+   vk_pipeline_robustness_state_fill(&dev->vk, &rs, NULL, info->pNext);
+   tu_shader_key_robustness(&obj->key, &rs);
+
+   if (obj->stage == MESA_SHADER_FRAGMENT) {
+      /* Shader objects are always used with dynamic rendering, and input
+       * attachments can't be assumed to be read-only.
+       */
+      obj->key.dynamic_renderpass = true;
+      obj->key.read_only_input_attachments = 0;
+      obj->key.fragment_density_map =
+         info->flags & VK_SHADER_CREATE_FRAGMENT_DENSITY_MAP_ATTACHMENT_BIT_EXT;
+   }
+
+   const VkShaderModuleCreateInfo module_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .pNext = info->pNext,
+      .codeSize = info->codeSize,
+      .pCode = (const uint32_t *) info->pCode,
+   };
+   const VkPipelineShaderStageCreateInfo stage_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .pNext = &module_info,
+      .stage = info->stage,
+      .module = VK_NULL_HANDLE,
+      .pName = info->pName,
+      .pSpecializationInfo = info->pSpecializationInfo,
+   };
+
+   void *mem_ctx = ralloc_context(NULL);
+   nir_shader *nir = tu_spirv_to_nir(dev, mem_ctx, 0, &stage_info, &obj->key,
+                                     obj->stage);
+   if (!nir) {
+      ralloc_free(mem_ctx);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   if (obj->stage == MESA_SHADER_TESS_EVAL)
+      obj->tess_mode = tu6_get_tessmode(nir);
+
+   struct tu_shader_object_binary header;
+   memset(&header, 0, sizeof(header));
+
+   struct blob blob;
+   blob_init(&blob);
+   blob_write_bytes(&blob, &header, sizeof(header));
+   nir_serialize(&blob, nir, false);
+   ralloc_free(mem_ctx);
+
+   if (blob.out_of_memory) {
+      blob_finish(&blob);
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+   }
+
+   memcpy(header.cache_uuid, dev->physical_device->cache_uuid, VK_UUID_SIZE);
+   header.stage = obj->stage;
+   header.key = obj->key;
+   header.tess_mode = obj->tess_mode;
+   header.nir_size = blob.size - sizeof(header);
+   _mesa_sha1_compute(blob.data + sizeof(header), header.nir_size,
+                      header.nir_sha1);
+   blob_overwrite_bytes(&blob, 0, &header, sizeof(header));
+
+   blob_finish_get_buffer(&blob, &obj->binary, &obj->binary_size);
+   return VK_SUCCESS;
+}
+
+static VkResult
+tu_shader_object_init_from_binary(struct tu_device *dev,
+                                  struct tu_shader_object *obj,
+                                  const VkShaderCreateInfoEXT *info)
+{
+   struct tu_shader_object_binary header;
+   if (info->codeSize < sizeof(header))
+      return VK_INCOMPATIBLE_SHADER_BINARY_EXT;
+
+   memcpy(&header, info->pCode, sizeof(header));
+
+   const uint8_t *nir_data = (const uint8_t *) info->pCode + sizeof(header);
+   unsigned char nir_sha1[20];
+
+   if (memcmp(header.cache_uuid, dev->physical_device->cache_uuid,
+              VK_UUID_SIZE) ||
+       header.stage != obj->stage ||
+       header.nir_size != info->codeSize - sizeof(header))
+      return VK_INCOMPATIBLE_SHADER_BINARY_EXT;
+
+   _mesa_sha1_compute(nir_data, header.nir_size, nir_sha1);
+   if (memcmp(nir_sha1, header.nir_sha1, sizeof(nir_sha1)))
+      return VK_INCOMPATIBLE_SHADER_BINARY_EXT;
+
+   obj->key = header.key;
+   obj->tess_mode = header.tess_mode;
+
+   obj->binary = malloc(info->codeSize);
+   if (!obj->binary)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+   memcpy(obj->binary, info->pCode, info->codeSize);
+   obj->binary_size = info->codeSize;
+   return VK_SUCCESS;
+}
+
+static void
+tu_shader_object_destroy(struct tu_device *dev,
+                         struct tu_shader_object *obj,
+                         const VkAllocationCallbacks *pAllocator)
+{
+   util_dynarray_foreach (&obj->variants, struct tu_shader_object_variant,
+                          variant)
+      vk_pipeline_cache_object_unref(&dev->vk, &variant->shader->base);
+   util_dynarray_fini(&obj->variants);
+
+   for (unsigned i = 0; i < obj->layout.num_sets; i++) {
+      if (obj->layout.set[i].layout)
+         vk_descriptor_set_layout_unref(&dev->vk,
+                                        &obj->layout.set[i].layout->vk);
+   }
+
+   free(obj->binary);
+   mtx_destroy(&obj->lock);
+   vk_object_free(&dev->vk, pAllocator, obj);
+}
+
+/* The variant most likely to be used with the stage that is declared to
+ * follow, which is compiled up front to avoid a hitch at the first draw.
+ */
+static struct tu_shader_object_key
+tu_shader_object_default_key(const struct tu_shader_object *obj,
+                             VkShaderStageFlags next_stage)
+{
+   struct tu_shader_object_key key;
+   memset(&key, 0, sizeof(key));
+
+   switch (obj->stage) {
+   case MESA_SHADER_VERTEX:
+      if (next_stage & VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT)
+         key.tessellation = IR3_TESS_TRIANGLES;
+      else if (next_stage & VK_SHADER_STAGE_GEOMETRY_BIT)
+         key.has_gs = true;
+      break;
+   case MESA_SHADER_TESS_CTRL:
+      key.tessellation = IR3_TESS_TRIANGLES;
+      break;
+   case MESA_SHADER_TESS_EVAL:
+      key.has_gs = next_stage & VK_SHADER_STAGE_GEOMETRY_BIT;
+      break;
+   default:
+      break;
+   }
+
+   return key;
+}
+
+static VkResult
+tu_shader_object_create(struct tu_device *dev,
+                        const VkShaderCreateInfoEXT *info,
+                        const VkAllocationCallbacks *pAllocator,
+                        VkShaderEXT *pShader)
+{
+   gl_shader_stage stage = vk_to_mesa_shader_stage(info->stage);
+
+   struct tu_shader_object *obj = (struct tu_shader_object *)
+      vk_object_zalloc(&dev->vk, pAllocator, sizeof(*obj),
+                       VK_OBJECT_TYPE_SHADER_EXT);
+   if (!obj)
+      return vk_error(dev, VK_ERROR_OUT_OF_HOST_MEMORY);
+
+   obj->stage = stage;
+   obj->flags = info->flags;
+   mtx_init(&obj->lock, mtx_plain);
+   util_dynarray_init(&obj->variants, NULL);
+
+   obj->layout.num_sets = info->setLayoutCount;
+   for (uint32_t set = 0; set < info->setLayoutCount; set++) {
+      VK_FROM_HANDLE(tu_descriptor_set_layout, set_layout,
+                     info->pSetLayouts[set]);
+
+      obj->layout.set[set].layout = set_layout;
+      if (set_layout)
+         vk_descriptor_set_layout_ref(&set_layout->vk);
+   }
+
+   for (uint32_t i = 0; i < info->pushConstantRangeCount; i++) {
+      const VkPushConstantRange *range = &info->pPushConstantRanges[i];
+      obj->layout.push_constant_size =
+         MAX2(obj->layout.push_constant_size, range->offset + range->size);
+   }
+   obj->layout.push_constant_size = align(obj->layout.push_constant_size, 16);
+
+   tu_pipeline_layout_init(&obj->layout);
+
+   VkResult result;
+   if (info->codeType == VK_SHADER_CODE_TYPE_BINARY_EXT)
+      result = tu_shader_object_init_from_binary(dev, obj, info);
+   else
+      result = tu_shader_object_init_from_spirv(dev, obj, info);
+
+   if (result != VK_SUCCESS) {
+      tu_shader_object_destroy(dev, obj, pAllocator);
+      return result;
+   }
+
+   struct tu_shader_object_key key =
+      tu_shader_object_default_key(obj, info->nextStage);
+   if (!tu_shader_object_get_variant(dev, obj, &key)) {
+      tu_shader_object_destroy(dev, obj, pAllocator);
+      return vk_error(dev, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
+   *pShader = tu_shader_object_to_handle(obj);
+   return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+tu_CreateShadersEXT(VkDevice _device,
+                    uint32_t createInfoCount,
+                    const VkShaderCreateInfoEXT *pCreateInfos,
+                    const VkAllocationCallbacks *pAllocator,
+                    VkShaderEXT *pShaders)
+{
+   VK_FROM_HANDLE(tu_device, dev, _device);
+   VkResult result = VK_SUCCESS;
+
+   /* All the shaders are attempted, and the ones that fail are left as
+    * VK_NULL_HANDLE.
+    */
+   for (uint32_t i = 0; i < createInfoCount; i++) {
+      VkResult r = tu_shader_object_create(dev, &pCreateInfos[i], pAllocator,
+                                           &pShaders[i]);
+      if (r != VK_SUCCESS) {
+         pShaders[i] = VK_NULL_HANDLE;
+         if (result == VK_SUCCESS)
+            result = r;
+      }
+   }
+
+   return result;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+tu_DestroyShaderEXT(VkDevice _device,
+                    VkShaderEXT shader,
+                    const VkAllocationCallbacks *pAllocator)
+{
+   VK_FROM_HANDLE(tu_device, dev, _device);
+   VK_FROM_HANDLE(tu_shader_object, obj, shader);
+
+   if (!obj)
+      return;
+
+   tu_shader_object_destroy(dev, obj, pAllocator);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+tu_GetShaderBinaryDataEXT(VkDevice _device,
+                          VkShaderEXT shader,
+                          size_t *pDataSize,
+                          void *pData)
+{
+   VK_FROM_HANDLE(tu_shader_object, obj, shader);
+
+   if (!pData) {
+      *pDataSize = obj->binary_size;
+      return VK_SUCCESS;
+   }
+
+   if (*pDataSize < obj->binary_size)
+      return VK_INCOMPLETE;
+
+   memcpy(pData, obj->binary, obj->binary_size);
+   *pDataSize = obj->binary_size;
+   return VK_SUCCESS;
+}
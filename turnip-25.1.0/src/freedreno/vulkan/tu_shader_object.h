@@ -0,0 +1,76 @@
+/*
+ * Copyright © 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TU_SHADER_OBJECT_H
+#define TU_SHADER_OBJECT_H
+
+#include "tu_common.h"
+
+#include "tu_descriptor_set.h"
+#include "tu_shader.h"
+
+#include "util/u_dynarray.h"
+
+/* VK_EXT_shader_object
+ *
+ * A VkShaderEXT keeps the NIR it was created from and compiles tu_shaders
+ * out of it, one per combination of the state that the ir3 variant depends
+ * on but that is only known once the other stages and the render pass are:
+ * see tu_shader_object_key. The variant for the most common combination is
+ * compiled at creation, the others the first time they are needed.
+ *
+ * At draw time the variants of the bound shader objects are linked into a
+ * tu_program_state like the one of a pipeline, and bound with the same
+ * helpers as pipelines.
+ */
+
+struct tu_shader_object_key
+{
+   uint32_t multiview_mask;
+   /* IR3_TESS_* of the bound TES, for stages in a tessellation pipeline */
+   uint8_t tessellation;
+   bool has_gs;
+};
+
+struct tu_shader_object_variant
+{
+   struct tu_shader_object_key key;
+   struct tu_shader *shader;
+};
+
+struct tu_shader_object
+{
+   struct vk_object_base base;
+
+   gl_shader_stage stage;
+   VkShaderCreateFlagsEXT flags;
+
+   /* The parts of the key that are known at creation. */
+   struct tu_shader_key key;
+
+   /* IR3_TESS_* for a TES */
+   uint8_t tess_mode;
+
+   struct tu_pipeline_layout layout;
+
+   /* A tu_shader_object_binary header followed by the serialized NIR, which
+    * is also what vkGetShaderBinaryDataEXT() returns.
+    */
+   void *binary;
+   size_t binary_size;
+
+   mtx_t lock;
+   struct util_dynarray variants;
+};
+
+VK_DEFINE_NONDISP_HANDLE_CASTS(tu_shader_object, base, VkShaderEXT,
+                               VK_OBJECT_TYPE_SHADER_EXT)
+
+struct tu_shader *
+tu_shader_object_get_variant(struct tu_device *dev,
+                             struct tu_shader_object *obj,
+                             const struct tu_shader_object_key *key);
+
+#endif /* TU_SHADER_OBJECT_H */
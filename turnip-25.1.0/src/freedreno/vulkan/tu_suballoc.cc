@@ -29,11 +29,13 @@ tu_bo_suballocator_init(struct tu_suballocator *suballoc,
                         struct tu_device *dev,
                         uint32_t default_size,
                         enum tu_bo_alloc_flags flags,
+                        enum tu_mem_category category,
                         const char *name)
 {
    suballoc->dev = dev;
    suballoc->default_size = default_size;
    suballoc->flags = flags;
+   suballoc->category = category;
    suballoc->bo = NULL;
    suballoc->cached_bo = NULL;
    suballoc->name = name;
@@ -84,7 +86,9 @@ tu_suballoc_bo_alloc(struct tu_suballoc_bo *suballoc_bo,
    if (!suballoc->bo) {
       VkResult result = tu_bo_init_new(suballoc->dev, NULL,
                                        &suballoc->bo, alloc_size,
-                                       suballoc->flags, suballoc->name);
+                                       (enum tu_bo_alloc_flags)(suballoc->flags |
+                                                                TU_BO_ALLOC_CACHEABLE),
+                                       suballoc->category, suballoc->name);
       if (result != VK_SUCCESS)
          return result;
    }
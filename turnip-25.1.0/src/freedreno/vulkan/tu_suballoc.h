@@ -21,6 +21,7 @@ struct tu_suballocator
 
    uint32_t default_size;
    enum tu_bo_alloc_flags flags;
+   enum tu_mem_category category;
 
    /** Current BO we're suballocating out of. */
    struct tu_bo *bo;
@@ -44,6 +45,7 @@ tu_bo_suballocator_init(struct tu_suballocator *suballoc,
                         struct tu_device *dev,
                         uint32_t default_size,
                         enum tu_bo_alloc_flags flags,
+                        enum tu_mem_category category,
                         const char *name);
 void
 tu_bo_suballocator_finish(struct tu_suballocator *suballoc);
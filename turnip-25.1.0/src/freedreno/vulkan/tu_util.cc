@@ -50,6 +50,9 @@ static const struct debug_control tu_debug_options[] = {
    { "nobinmerging", TU_DEBUG_NO_BIN_MERGING },
    { "perfcraw", TU_DEBUG_PERFCRAW },
    { "fdmoffset", TU_DEBUG_FDM_OFFSET },
+   { "defer_submit", TU_DEBUG_DEFER_SUBMIT },
+   { "autotune_time", TU_DEBUG_AUTOTUNE_TIME },
+   { "dgc", TU_DEBUG_DGC },
    { NULL, 0 }
 };
 
@@ -70,6 +70,9 @@ enum tu_debug_flags : uint64_t
    TU_DEBUG_NO_BIN_MERGING           = BITFIELD64_BIT(29),
    TU_DEBUG_PERFCRAW                 = BITFIELD64_BIT(30),
    TU_DEBUG_FDM_OFFSET               = BITFIELD64_BIT(31),
+   TU_DEBUG_DEFER_SUBMIT             = BITFIELD64_BIT(32),
+   TU_DEBUG_AUTOTUNE_TIME            = BITFIELD64_BIT(33),
+   TU_DEBUG_DGC                      = BITFIELD64_BIT(34),
 };
 
 struct tu_env {
@@ -13,6 +13,9 @@
 #include "drm-uapi/drm_fourcc.h"
 
 #include "tu_device.h"
+#include "tu_perfcntr_sampler.h"
+#include "tu_queue.h"
+#include "tu_rp_log.h"
 
 static VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL
 tu_wsi_proc_addr(VkPhysicalDevice physicalDevice, const char *pName)
@@ -32,6 +35,21 @@ tu_wsi_can_present_on_device(VkPhysicalDevice physicalDevice, int fd)
 #endif
 }
 
+VKAPI_ATTR VkResult VKAPI_CALL
+tu_QueuePresentKHR(VkQueue _queue, const VkPresentInfoKHR *pPresentInfo)
+{
+   VK_FROM_HANDLE(tu_queue, queue, _queue);
+
+   tu_perfcntr_sampler_frame(queue->device);
+   tu_rp_log_frame(queue->device);
+   tu_mem_stats_frame(queue->device);
+
+   return wsi_common_queue_present(&queue->device->physical_device->wsi_device,
+                                   tu_device_to_handle(queue->device),
+                                   _queue, queue->vk.queue_family_index,
+                                   pPresentInfo);
+}
+
 VkResult
 tu_wsi_init(struct tu_physical_device *physical_device)
 {
@@ -460,6 +460,10 @@
    DRI_CONF_OPT_B(vk_x11_ensure_min_image_count, def, \
                   "Force the X11 WSI to create at least the number of image specified by the driver in VkSurfaceCapabilitiesKHR::minImageCount")
 
+#define DRI_CONF_VK_X11_USE_HWBUF(def) \
+   DRI_CONF_OPT_B(vk_x11_use_hwbuf, def, \
+                  "Present through a hardware buffer shared with the X server, unless MESA_VK_WSI_USE_HWBUF is set")
+
 #define DRI_CONF_VK_X11_IGNORE_SUBOPTIMAL(def) \
    DRI_CONF_OPT_B(vk_x11_ignore_suboptimal, def, \
                   "Force the X11 WSI to never report VK_SUBOPTIMAL_KHR")
@@ -676,6 +680,10 @@
    DRI_CONF_OPT_B(tu_use_tex_coord_round_nearest_even_mode, def, \
                   "Use D3D-compliant round-to-nearest-even mode for texture coordinates")
 
+#define DRI_CONF_TU_OVERRIDE_HEAP_SIZE(def) \
+   DRI_CONF_OPT_I(tu_override_heap_size, def, 0, 1 << 20, \
+                  "Size of the memory heap in MiB (0 = derived from system memory), unless TU_OVERRIDE_HEAP_SIZE is set")
+
 /**
  * \brief Honeykrisp specific configuration options
  */
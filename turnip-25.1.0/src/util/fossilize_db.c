@@ -753,6 +753,72 @@ fail_file:
    simple_mtx_unlock(&foz_db->flock_mtx);
    return false;
 }
+
+/* Walk all the entries of a single fossilize archive, including archives
+ * written by Fossilize itself rather than by the shader cache.  The payload
+ * is passed on as stored, so it may still be compressed.  Returns the number
+ * of entries or -1 if the file couldn't be read.
+ */
+int
+foz_foreach_entry(const char *filename, foz_entry_cb cb, void *data)
+{
+   FILE *file = fopen(filename, "rb");
+   if (!file)
+      return -1;
+
+   uint8_t magic[FOZ_REF_MAGIC_SIZE];
+   if (fread(magic, 1, FOZ_REF_MAGIC_SIZE, file) != FOZ_REF_MAGIC_SIZE ||
+       memcmp(magic, stream_reference_magic_and_version,
+              FOZ_REF_MAGIC_SIZE - 1)) {
+      fclose(file);
+      return -1;
+   }
+
+   int version = magic[FOZ_REF_MAGIC_SIZE - 1];
+   if (version > FOSSILIZE_FORMAT_VERSION ||
+       version < FOSSILIZE_FORMAT_MIN_COMPAT_VERSION) {
+      fclose(file);
+      return -1;
+   }
+
+   int num_entries = 0;
+   void *payload = NULL;
+   for (;;) {
+      char bytes_to_read[FOSSILIZE_BLOB_HASH_LENGTH + sizeof(struct foz_payload_header)];
+
+      /* A truncated last entry is ignored, like when loading a cache. */
+      if (fread(bytes_to_read, 1, sizeof(bytes_to_read), file) !=
+          sizeof(bytes_to_read))
+         break;
+
+      struct foz_payload_header header;
+      memcpy(&header, &bytes_to_read[FOSSILIZE_BLOB_HASH_LENGTH],
+             sizeof(header));
+
+      void *new_payload = realloc(payload, MAX2(header.payload_size, 1));
+      if (!new_payload)
+         break;
+      payload = new_payload;
+
+      if (fread(payload, 1, header.payload_size, file) != header.payload_size)
+         break;
+
+      if (header.crc != 0 &&
+          util_hash_crc32(payload, header.payload_size) != header.crc)
+         continue;
+
+      char hash_str[FOSSILIZE_BLOB_HASH_LENGTH + 1] = {0};
+      memcpy(hash_str, bytes_to_read, FOSSILIZE_BLOB_HASH_LENGTH);
+
+      cb(hash_str, &header, payload, data);
+      num_entries++;
+   }
+
+   free(payload);
+   fclose(file);
+
+   return num_entries;
+}
 #else
 
 bool
@@ -783,4 +849,10 @@ foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
    return false;
 }
 
+int
+foz_foreach_entry(const char *filename, foz_entry_cb cb, void *data)
+{
+   return -1;
+}
+
 #endif
@@ -109,4 +109,11 @@ bool
 foz_write_entry(struct foz_db *foz_db, const uint8_t *cache_key_160bit,
                 const void *blob, size_t size);
 
+typedef void (*foz_entry_cb)(const char *hash_str,
+                             const struct foz_payload_header *header,
+                             const void *payload, void *data);
+
+int
+foz_foreach_entry(const char *filename, foz_entry_cb cb, void *data);
+
 #endif /* FOSSILIZE_DB_H */
@@ -24,7 +24,9 @@
 #include "vk_queue.h"
 
 #include "util/perf/cpu_trace.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
+#include "util/u_thread.h"
 #include <inttypes.h>
 
 #include "vk_alloc.h"
@@ -799,6 +801,12 @@ vk_queue_submit_thread_func(void *_data)
    struct vk_queue *queue = _data;
    VkResult result;
 
+   /* submits are latency-critical, keep them off the slow cores */
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+   if (caps->has_big_little)
+      util_set_current_thread_affinity(caps->big_cpu_mask, NULL,
+                                       caps->num_cpu_mask_bits);
+
    mtx_lock(&queue->submit.mutex);
 
    while (queue->submit.thread_run) {
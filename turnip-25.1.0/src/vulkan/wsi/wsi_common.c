@@ -208,6 +208,7 @@ wsi_device_init(struct wsi_device *wsi,
    WSI_GET_CB(BindImageMemory);
    WSI_GET_CB(BeginCommandBuffer);
    WSI_GET_CB(CmdPipelineBarrier);
+   WSI_GET_CB(CmdBlitImage);
    WSI_GET_CB(CmdCopyImage);
    WSI_GET_CB(CmdCopyImageToBuffer);
    WSI_GET_CB(CreateBuffer);
@@ -297,6 +298,10 @@ wsi_device_init(struct wsi_device *wsi,
    wsi->force_headless_swapchain =
       debug_get_bool_option("MESA_VK_WSI_HEADLESS_SWAPCHAIN", false);
 
+   int64_t fps_limit = debug_get_num_option("MESA_VK_WSI_FPS_LIMIT", 0);
+   if (fps_limit > 0)
+      wsi->min_present_interval_ns = 1000000000ull / fps_limit;
+
    if (dri_options) {
       if (driCheckOption(dri_options, "adaptive_sync", DRI_BOOL))
          wsi->enable_adaptive_sync = driQueryOptionb(dri_options,
@@ -841,6 +846,8 @@ wsi_destroy_image(const struct wsi_swapchain *chain,
    wsi->DestroyImage(chain->device, image->image, &chain->alloc);
    wsi->DestroyImage(chain->device, image->blit.image, &chain->alloc);
    wsi->FreeMemory(chain->device, image->blit.memory, &chain->alloc);
+   wsi->DestroyImage(chain->device, image->blit.scaled, &chain->alloc);
+   wsi->FreeMemory(chain->device, image->blit.scaled_memory, &chain->alloc);
    wsi->DestroyBuffer(chain->device, image->blit.buffer, &chain->alloc);
 }
 
@@ -1393,6 +1400,37 @@ handle_trace(VkQueue queue, struct vk_device *device, uint32_t current_frame)
    return result;
 }
 
+/* Holds the present back until MESA_VK_WSI_FPS_LIMIT allows it.  Most of the
+ * wait is a regular sleep, but the last millisecond is spent spinning since
+ * sleeps routinely overshoot by about that much, which would show up as
+ * frame time jitter.
+ */
+static void
+wsi_swapchain_limit_frame_rate(struct wsi_swapchain *swapchain)
+{
+   const int64_t interval = swapchain->wsi->min_present_interval_ns;
+   if (!interval)
+      return;
+
+   int64_t target = swapchain->next_present_time;
+   int64_t now = os_time_get_nano();
+   if (target > now) {
+      MESA_TRACE_SCOPE("frame limit");
+      const int64_t spin_ns = 1000000;
+      if (target - now > spin_ns)
+         os_time_sleep((target - now - spin_ns) / 1000);
+      while ((now = os_time_get_nano()) < target)
+         ;
+   }
+
+   /* Keep a steady cadence across small delays, but don't try to catch up
+    * with a burst of presents after a real stall.
+    */
+   if (now - target > interval)
+      target = now;
+   swapchain->next_present_time = target + interval;
+}
+
 VkResult
 wsi_common_queue_present(const struct wsi_device *wsi,
                          VkDevice device,
@@ -1615,6 +1653,8 @@ wsi_common_queue_present(const struct wsi_device *wsi,
             goto fail_present;
       }
 
+      wsi_swapchain_limit_frame_rate(swapchain);
+
       result = swapchain->queue_present(swapchain, image_index, present_id, region);
       if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
          goto fail_present;
@@ -1820,6 +1860,65 @@ wsi_select_host_memory_type(const struct wsi_device *wsi,
                                  0 /* deny_props */, type_bits);
 }
 
+/* Creates the device-local image a scaling buffer blit blits into before
+ * copying to the buffer, since vkCmdBlitImage can't write buffers.
+ */
+static VkResult
+wsi_create_scaled_blit_image(const struct wsi_swapchain *chain,
+                             const struct wsi_image_info *info,
+                             struct wsi_image *image)
+{
+   const struct wsi_device *wsi = chain->wsi;
+   VkResult result;
+
+   const VkImageCreateInfo image_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .flags = info->create.flags & VK_IMAGE_CREATE_PROTECTED_BIT,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = info->create.format,
+      .extent = {
+         .width = info->blit_extent.width,
+         .height = info->blit_extent.height,
+         .depth = 1,
+      },
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_OPTIMAL,
+      .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+               VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+   };
+   result = wsi->CreateImage(chain->device, &image_info,
+                             &chain->alloc, &image->blit.scaled);
+   if (result != VK_SUCCESS)
+      return result;
+
+   VkMemoryRequirements reqs;
+   wsi->GetImageMemoryRequirements(chain->device, image->blit.scaled, &reqs);
+
+   const VkMemoryDedicatedAllocateInfo memory_dedicated_info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+      .image = image->blit.scaled,
+      .buffer = VK_NULL_HANDLE,
+   };
+   const VkMemoryAllocateInfo memory_info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .pNext = &memory_dedicated_info,
+      .allocationSize = reqs.size,
+      .memoryTypeIndex =
+         wsi_select_device_memory_type(wsi, reqs.memoryTypeBits),
+   };
+   result = wsi->AllocateMemory(chain->device, &memory_info,
+                                &chain->alloc, &image->blit.scaled_memory);
+   if (result != VK_SUCCESS)
+      return result;
+
+   return wsi->BindImageMemory(chain->device, image->blit.scaled,
+                               image->blit.scaled_memory, 0);
+}
+
 VkResult
 wsi_create_buffer_blit_context(const struct wsi_swapchain *chain,
                                const struct wsi_image_info *info,
@@ -1928,6 +2027,13 @@ wsi_create_buffer_blit_context(const struct wsi_swapchain *chain,
    if (result != VK_SUCCESS)
       return result;
 
+   if (info->blit_extent.width != info->create.extent.width ||
+       info->blit_extent.height != info->create.extent.height) {
+      result = wsi_create_scaled_blit_image(chain, info, image);
+      if (result != VK_SUCCESS)
+         return result;
+   }
+
    image->num_planes = 1;
    image->sizes[0] = info->linear_size;
    image->row_pitches[0] = info->linear_stride;
@@ -1936,6 +2042,87 @@ wsi_create_buffer_blit_context(const struct wsi_swapchain *chain,
    return VK_SUCCESS;
 }
 
+/* Records the filtered blit from the swapchain image into the scaled image,
+ * leaving the latter in TRANSFER_SRC_OPTIMAL for the buffer copy. The
+ * swapchain image is expected in TRANSFER_SRC_OPTIMAL already.
+ */
+static void
+wsi_cmd_blit_scaled(const struct wsi_swapchain *chain,
+                    const struct wsi_image_info *info,
+                    const struct wsi_image *image,
+                    VkCommandBuffer cmd_buffer)
+{
+   const struct wsi_device *wsi = chain->wsi;
+
+   VkFormatProperties props;
+   wsi->GetPhysicalDeviceFormatProperties(wsi->pdevice, info->create.format,
+                                          &props);
+   const VkFilter filter =
+      (props.optimalTilingFeatures &
+       VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ?
+      VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+   VkImageMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = 0,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image->blit.scaled,
+      .subresourceRange = {
+         .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+         .baseMipLevel = 0,
+         .levelCount = 1,
+         .baseArrayLayer = 0,
+         .layerCount = 1,
+      },
+   };
+   wsi->CmdPipelineBarrier(cmd_buffer,
+                           VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0,
+                           0, NULL,
+                           0, NULL,
+                           1, &barrier);
+
+   const VkImageSubresourceLayers subresource = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .mipLevel = 0,
+      .baseArrayLayer = 0,
+      .layerCount = 1,
+   };
+   const VkImageBlit region = {
+      .srcSubresource = subresource,
+      .srcOffsets = {
+         { 0, 0, 0 },
+         { info->create.extent.width, info->create.extent.height, 1 },
+      },
+      .dstSubresource = subresource,
+      .dstOffsets = {
+         { 0, 0, 0 },
+         { info->blit_extent.width, info->blit_extent.height, 1 },
+      },
+   };
+   wsi->CmdBlitImage(cmd_buffer,
+                     image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     image->blit.scaled, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     1, &region, filter);
+
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+   barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+   wsi->CmdPipelineBarrier(cmd_buffer,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           0,
+                           0, NULL,
+                           0, NULL,
+                           1, &barrier);
+}
+
 VkResult
 wsi_finish_create_blit_context(const struct wsi_swapchain *chain,
                                const struct wsi_image_info *info,
@@ -2023,6 +2210,13 @@ wsi_finish_create_blit_context(const struct wsi_swapchain *chain,
                               1, img_mem_barriers);
 
       if (chain->blit.type == WSI_SWAPCHAIN_BUFFER_BLIT) {
+         VkImage copy_src = image->image;
+
+         if (image->blit.scaled != VK_NULL_HANDLE) {
+            wsi_cmd_blit_scaled(chain, info, image, image->blit.cmd_buffers[i]);
+            copy_src = image->blit.scaled;
+         }
+
          struct VkBufferImageCopy buffer_image_copy = {
             .bufferOffset = 0,
             .bufferRowLength = info->linear_stride /
@@ -2035,10 +2229,14 @@ wsi_finish_create_blit_context(const struct wsi_swapchain *chain,
                .layerCount = 1,
             },
             .imageOffset = { .x = 0, .y = 0, .z = 0 },
-            .imageExtent = info->create.extent,
+            .imageExtent = {
+               .width = info->blit_extent.width,
+               .height = info->blit_extent.height,
+               .depth = 1,
+            },
          };
          wsi->CmdCopyImageToBuffer(image->blit.cmd_buffers[i],
-                                   image->image,
+                                   copy_src,
                                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
                                    image->blit.buffer,
                                    1, &buffer_image_copy);
@@ -2107,8 +2305,11 @@ wsi_configure_buffer_image(UNUSED const struct wsi_swapchain *chain,
    info->create.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
    info->wsi.blit_src = true;
 
+   if (info->blit_extent.width == 0 || info->blit_extent.height == 0)
+      info->blit_extent = pCreateInfo->imageExtent;
+
    const uint32_t cpp = vk_format_get_blocksize(pCreateInfo->imageFormat);
-   info->linear_stride = pCreateInfo->imageExtent.width * cpp;
+   info->linear_stride = info->blit_extent.width * cpp;
    info->linear_stride = align(info->linear_stride, stride_align);
 
    /* Since we can pick the stride to be whatever we want, also align to the
@@ -2119,7 +2320,7 @@ wsi_configure_buffer_image(UNUSED const struct wsi_swapchain *chain,
                                wsi->optimalBufferCopyRowPitchAlignment);
 
    info->linear_size = (uint64_t)info->linear_stride *
-                       pCreateInfo->imageExtent.height;
+                       info->blit_extent.height;
    info->linear_size = align64(info->linear_size, size_align);
 
    info->finish_create = wsi_finish_create_blit_context;
@@ -2225,6 +2426,10 @@ wsi_cpu_image_needs_buffer_blit(const struct wsi_device *wsi,
    if (WSI_DEBUG & WSI_DEBUG_BUFFER)
       return true;
 
+   /* Only the buffer blit can scale. */
+   if (params->blit_extent.width != 0)
+      return true;
+
    if (wsi->wants_linear)
       return false;
 
@@ -2251,6 +2456,7 @@ wsi_configure_cpu_image(const struct wsi_swapchain *chain,
       return result;
 
    if (chain->blit.type != WSI_SWAPCHAIN_NO_BLIT) {
+      info->blit_extent = params->blit_extent;
       wsi_configure_buffer_image(chain, pCreateInfo,
                                  1 /* stride_align */,
                                  1 /* size_align */,
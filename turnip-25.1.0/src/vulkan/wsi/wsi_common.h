@@ -131,6 +131,11 @@ struct wsi_device {
    VkPresentModeKHR override_present_mode;
    bool force_bgra8_unorm_first;
 
+   /* Minimum time between two presents on a swapchain, set from
+    * MESA_VK_WSI_FPS_LIMIT.  0 means no limit.
+    */
+   uint64_t min_present_interval_ns;
+
    /* Whether to enable adaptive sync for a swapchain if implemented and
     * available. Not all window systems might support this. */
    bool enable_adaptive_sync;
@@ -166,6 +171,11 @@ struct wsi_device {
       /* adds an extra minImageCount when running under xwayland */
       bool extra_xwayland_image;
 
+      /* Hand the images to the server through a shared hardware buffer,
+       * from vk_x11_use_hwbuf or MESA_VK_WSI_USE_HWBUF.
+       */
+      bool use_hwbuf;
+
       /* Never report VK_SUBOPTIMAL_KHR. Used to workaround
        * games that cannot handle SUBOPTIMAL correctly. */
       bool ignore_suboptimal;
@@ -248,6 +258,7 @@ struct wsi_device {
    WSI_CB(BindImageMemory);
    WSI_CB(BeginCommandBuffer);
    WSI_CB(CmdPipelineBarrier);
+   WSI_CB(CmdBlitImage);
    WSI_CB(CmdCopyImage);
    WSI_CB(CmdCopyImageToBuffer);
    WSI_CB(CreateBuffer);
@@ -58,6 +58,11 @@ struct wsi_cpu_image_params {
    struct wsi_base_image_params base;
 
    uint8_t *(*alloc_shm)(struct wsi_image *image, unsigned size);
+
+   /* If non-zero, the size of the presented buffer. The buffer blit then
+    * scales the swapchain image to it.
+    */
+   VkExtent2D blit_extent;
 };
 
 struct wsi_drm_image_params {
@@ -103,6 +108,11 @@ struct wsi_image_info {
    /* For buffer blit images, the size of the buffer in bytes */
    uint64_t linear_size;
 
+   /* For buffer blit images, the extent of the buffer in pixels. When it
+    * differs from create.extent, the blit goes through a scaled image.
+    */
+   VkExtent2D blit_extent;
+
    wsi_memory_type_select_cb select_image_memory_type;
    wsi_memory_type_select_cb select_blit_dst_memory_type;
 
@@ -146,6 +156,9 @@ struct wsi_image {
       VkBuffer buffer;
       VkImage image;
       VkDeviceMemory memory;
+      /* Buffer blits that scale do so into this image first. */
+      VkImage scaled;
+      VkDeviceMemory scaled_memory;
       VkCommandBuffer *cmd_buffers;
    } blit;
    /* Whether or not the image has been acquired
@@ -182,6 +195,9 @@ struct wsi_swapchain {
    VkPresentModeKHR present_mode;
    VkSemaphore present_id_timeline;
 
+   /* Earliest time the frame limiter lets the next present through. */
+   int64_t next_present_time;
+
    int signal_dma_buf_from_semaphore;
    VkSemaphore dma_buf_semaphore;
 
@@ -26,6 +26,9 @@
 #include <xcb/dri3.h>
 #include <xcb/present.h>
 #include <xcb/shm.h>
+#include <xcb/sync.h>
+#include <xcb/xfixes.h>
+#include <xshmfence.h>
 
 #include "util/macros.h"
 #include <stdatomic.h>
@@ -35,11 +38,13 @@
 #include <errno.h>
 #include <string.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include "util/hash_table.h"
 #include "util/os_file.h"
 #include "util/os_time.h"
 #include "util/u_debug.h"
 #include "util/u_thread.h"
+#include "util/xmlconfig.h"
 #include "util/timespec.h"
 
 #include "vk_format.h"
@@ -56,9 +61,12 @@
 #include <sys/shm.h>
 #endif
 
+#define MAX_DAMAGE_RECTS 64
+
 struct wsi_x11_connection {
    bool has_dri3;
    bool has_present;
+   bool has_xfixes;
    bool has_mit_shm;
 };
 
@@ -71,7 +79,15 @@ struct wsi_x11 {
 struct wsi_x11_image {
    struct wsi_image base;
    xcb_pixmap_t pixmap;
+   xcb_xfixes_region_t update_region; /* long lived XID */
+   xcb_xfixes_region_t update_area;   /* the above or None */
+   /* Bounding box of the damage, used by the sw paths. */
+   VkRect2D damage;
    atomic_bool busy;
+   struct xshmfence *shm_fence;
+   uint32_t sync_fence;
+   uint32_t serial;
+   int hwbuf_fd;
    xcb_shm_seg_t shmseg;
    int shmid;
    uint8_t *shmaddr;
@@ -80,18 +96,40 @@ struct wsi_x11_image {
 
 struct wsi_x11_swapchain {
    struct wsi_swapchain base;
+   bool has_xfixes;
    bool has_mit_shm;
+   /* Images are scaled to extent, which is the window size. */
+   bool scaled;
 
    xcb_connection_t *conn;
    xcb_window_t window;
    xcb_gc_t gc;
    uint32_t depth;
+   /* Bytes per pixel of the swapchain format. */
+   uint32_t cpp;
    VkExtent2D extent;
    
    bool has_present_queue;
    VkResult status;
    struct wsi_queue present_queue;
    pthread_t queue_thread;
+
+   /* Present events. When enabled, images only become free again on
+    * PresentIdleNotify and present IDs are signaled on CompleteNotify.
+    */
+   bool has_present_events;
+   xcb_present_event_t event_id;
+   xcb_special_event_t *special_event;
+   pthread_t event_thread;
+   atomic_bool event_thread_exit;
+   uint32_t send_sbc;
+
+   /* Set when the server handed out a distinct hwbuf for every image.
+    * hwbuf_shown is the image it is showing, which stays busy until the
+    * next present replaces it.
+    */
+   bool hwbuf_per_image;
+   uint32_t hwbuf_shown;
    
    pthread_mutex_t image_pool_mutex;
    pthread_cond_t image_pool_cond;    
@@ -100,6 +138,9 @@ struct wsi_x11_swapchain {
    pthread_cond_t present_id_cond; 
 
    uint64_t present_id;
+   /* Protected by present_id_mutex. */
+   uint64_t last_present_msc;
+   uint32_t complete_sbc;
 
    struct wsi_x11_image images[0];
 };
@@ -108,8 +149,8 @@ static struct wsi_x11_connection *
 wsi_x11_connection_create(struct wsi_device *wsi_dev,
                           xcb_connection_t *conn)
 {
-   xcb_query_extension_cookie_t dri3_cookie, pres_cookie, shm_cookie;
-   xcb_query_extension_reply_t *dri3_reply, *pres_reply, *shm_reply = NULL;
+   xcb_query_extension_cookie_t dri3_cookie, pres_cookie, xfixes_cookie, shm_cookie;
+   xcb_query_extension_reply_t *dri3_reply, *pres_reply, *xfixes_reply;
    bool wants_shm = wsi_dev->sw && !(WSI_DEBUG & WSI_DEBUG_NOSHM);
 
    struct wsi_x11_connection *wsi_conn =
@@ -120,13 +161,16 @@ wsi_x11_connection_create(struct wsi_device *wsi_dev,
 
    dri3_cookie = xcb_query_extension(conn, 4, "DRI3");
    pres_cookie = xcb_query_extension(conn, 7, "Present");
+   xfixes_cookie = xcb_query_extension(conn, 6, "XFIXES");
 
    dri3_reply = xcb_query_extension_reply(conn, dri3_cookie, NULL);
    pres_reply = xcb_query_extension_reply(conn, pres_cookie, NULL);
+   xfixes_reply = xcb_query_extension_reply(conn, xfixes_cookie, NULL);
 
    if (!dri3_reply || !pres_reply) {
       free(dri3_reply);
       free(pres_reply);
+      free(xfixes_reply);
       vk_free(&wsi_dev->instance_alloc, wsi_conn);
       return NULL;
    }
@@ -134,8 +178,20 @@ wsi_x11_connection_create(struct wsi_device *wsi_dev,
    wsi_conn->has_dri3 = dri3_reply->present != 0;
    wsi_conn->has_present = pres_reply->present != 0;
 
+   /* Regions need XFixes 2.0. */
+   wsi_conn->has_xfixes = false;
+   if (xfixes_reply && xfixes_reply->present) {
+      xcb_xfixes_query_version_cookie_t ver_cookie =
+         xcb_xfixes_query_version(conn, 6, 0);
+      xcb_xfixes_query_version_reply_t *ver_reply =
+         xcb_xfixes_query_version_reply(conn, ver_cookie, NULL);
+      wsi_conn->has_xfixes = ver_reply && ver_reply->major_version >= 2;
+      free(ver_reply);
+   }
+
    free(dri3_reply);
    free(pres_reply);
+   free(xfixes_reply);
 
    wsi_conn->has_mit_shm = false;
    if (wants_shm) {
@@ -394,9 +450,15 @@ wsi_x11_surface_get_support(VkIcdSurfaceBase *icd_surface,
 static uint32_t
 wsi_x11_get_min_image_count(const struct wsi_device *wsi_device, const VkSurfacePresentModeEXT *present_mode)
 {
-   const char *use_hwbuf = getenv("MESA_VK_WSI_USE_HWBUF");
-
-   if (wsi_device->sw || (use_hwbuf && (!strcmp(use_hwbuf, "true") || !strcmp(use_hwbuf, "1"))))
+   if (wsi_device->x11.override_minImageCount)
+      return wsi_device->x11.override_minImageCount;
+
+   /* Software presents are asynchronous with MIT-SHM, triple buffer so
+    * that rendering overlaps the server's upload.
+    */
+   if (wsi_device->sw)
+      return 3;
+   else if (wsi_device->x11.use_hwbuf)
       return 1;
    else if (present_mode && 
             present_mode->presentMode == VK_PRESENT_MODE_MAILBOX_KHR)
@@ -405,6 +467,18 @@ wsi_x11_get_min_image_count(const struct wsi_device *wsi_device, const VkSurface
       return 2;
 }
 
+/* With MESA_VK_WSI_UPSCALE, software swapchains may be smaller than the
+ * window and get scaled up to it by the GPU during the buffer blit.
+ */
+static bool
+wsi_x11_upscale_enabled(const struct wsi_device *wsi_device)
+{
+   const char *upscale = getenv("MESA_VK_WSI_UPSCALE");
+
+   return wsi_device->sw && upscale &&
+          (!strcmp(upscale, "true") || !strcmp(upscale, "1"));
+}
+
 static VkResult
 wsi_x11_surface_get_capabilities(VkIcdSurfaceBase *icd_surface,
                                  struct wsi_device *wsi_device,
@@ -434,6 +508,8 @@ wsi_x11_surface_get_capabilities(VkIcdSurfaceBase *icd_surface,
       caps->currentExtent = extent;
       caps->minImageExtent = extent;
       caps->maxImageExtent = extent;
+      if (wsi_x11_upscale_enabled(wsi_device))
+         caps->minImageExtent = (VkExtent2D) { 1, 1 };
    }
    free(err);
    free(geom);
@@ -806,26 +882,57 @@ wsi_x11_present_image_dri3(struct wsi_x11_swapchain *chain, uint32_t image_index
    if (!wsi_conn)
       return VK_ERROR_OUT_OF_HOST_MEMORY;
 
+   uint32_t options = XCB_PRESENT_OPTION_NONE;
+   uint32_t idle_fence = XCB_NONE;
+   uint64_t target_msc = 0;
+
+   /* Without pixmaps, the serial tells a hwbuf server which of the
+    * buffers it handed out, in order, is being presented.
+    */
+   if (chain->hwbuf_per_image)
+      image->serial = image_index + 1;
+
+   if (chain->has_present_events) {
+      image->serial = ++chain->send_sbc;
+      idle_fence = image->sync_fence;
+      xshmfence_reset(image->shm_fence);
+
+      /* MAILBOX targets the next vblank and lets the server replace a
+       * pending pixmap, FIFO queues one pixmap per vblank.
+       */
+      if (chain->base.present_mode == VK_PRESENT_MODE_FIFO_KHR ||
+          chain->base.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+         pthread_mutex_lock(&chain->present_id_mutex);
+         target_msc = chain->last_present_msc + 1;
+         pthread_mutex_unlock(&chain->present_id_mutex);
+      }
+   }
+
+   if (chain->base.present_mode == VK_PRESENT_MODE_IMMEDIATE_KHR ||
+       chain->base.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+      options |= XCB_PRESENT_OPTION_ASYNC;
+
    xcb_void_cookie_t cookie =
       xcb_present_pixmap(chain->conn,
                          chain->window,
                          image->pixmap,
-                         0,             /* serial */
+                         image->serial,
                          XCB_NONE,      /* valid */
-                         XCB_NONE,      /* update */
+                         image->update_area, /* update */
                          0,             /* x_off */
                          0,             /* y_off */
                          XCB_NONE,      /* target_crtc */
                          XCB_NONE,      /* wait_fence */
-                         XCB_NONE,      /* idle_fence */
-                         XCB_PRESENT_OPTION_NONE,
-                         0,             /* target_msc */
+                         idle_fence,
+                         options,
+                         target_msc,
                          0,             /* divisor */ 
                          0,             /* remainder */ 
                          0,             /* notifies_len */
                          NULL);
 
    xcb_discard_reply(chain->conn, cookie.sequence);
+   xcb_flush(chain->conn);
    return wsi_x11_swapchain_result(chain, VK_SUCCESS);
 }
 
@@ -833,38 +940,72 @@ static VkResult
 wsi_x11_present_image_sw(struct wsi_x11_swapchain *chain, uint32_t image_index)
 {
    struct wsi_x11_image *image = &chain->images[image_index];
+   const VkRect2D *damage = &image->damage;
    xcb_void_cookie_t cookie;
-   
-   if (chain->has_mit_shm) {
-      memcpy(image->shmaddr, image->base.cpu_map, image->base.row_pitches[0] * chain->extent.height);
+
+   /* With MIT-SHM the image's CPU mapping is the SHM segment itself (see
+    * alloc_shm()), so the server reads the rendered pixels directly.
+    */
+   if (image->shmaddr) {
+      if (damage->extent.width == 0 || damage->extent.height == 0)
+         goto done;
+
       cookie = xcb_shm_put_image(chain->conn,
                                  chain->window,
-								 chain->gc,
-								 image->base.row_pitches[0] / 4,
-								 chain->extent.height,
-								 0, 0,
-								 chain->extent.width,
-								 chain->extent.height,
-								 0, 0, chain->depth, XCB_IMAGE_FORMAT_Z_PIXMAP, 
-								 0,
-								 image->shmseg,
-								 0);
-      xcb_discard_reply(chain->conn, cookie.sequence);
-   }
-   else {
-      cookie = xcb_put_image(chain->conn, XCB_IMAGE_FORMAT_Z_PIXMAP,
-                             chain->window,
-                             chain->gc,
-                             image->base.row_pitches[0] / 4,
-                             chain->extent.height,
-                             0, 0, 0, chain->depth,
-                             image->base.row_pitches[0] * chain->extent.height,
-                             image->base.cpu_map);
+                                 chain->gc,
+                                 image->base.row_pitches[0] / chain->cpp,
+                                 chain->extent.height,
+                                 damage->offset.x, damage->offset.y,
+                                 damage->extent.width,
+                                 damage->extent.height,
+                                 damage->offset.x, damage->offset.y,
+                                 chain->depth, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                 0,
+                                 image->shmseg,
+                                 0);
       xcb_discard_reply(chain->conn, cookie.sequence);
+
+      /* The server reads the segment while processing the request. From
+       * the queue thread, wait for a round trip so the image is only
+       * released once it has been read.
+       */
+      if (chain->has_present_queue) {
+         free(xcb_get_input_focus_reply(chain->conn,
+                                        xcb_get_input_focus(chain->conn),
+                                        NULL));
+         return VK_SUCCESS;
+      }
+   } else {
+      /* PutImage takes whole rows, so send the damaged rows, split into as
+       * many requests as needed to stay under the maximum request length.
+       */
+      const uint8_t *data = image->base.cpu_map;
+      uint32_t stride = image->base.row_pitches[0];
+      uint64_t max_req_len = xcb_get_maximum_request_length(chain->conn);
+      uint32_t num_lines =
+         MAX2(((max_req_len << 2) - sizeof(xcb_put_image_request_t)) / stride, 1);
+      uint32_t y_start = damage->offset.y;
+      uint32_t y_todo = damage->extent.height;
+
+      while (y_todo) {
+         uint32_t this_lines = MIN2(num_lines, y_todo);
+         cookie = xcb_put_image(chain->conn, XCB_IMAGE_FORMAT_Z_PIXMAP,
+                                chain->window,
+                                chain->gc,
+                                stride / chain->cpp,
+                                this_lines,
+                                0, y_start, 0, chain->depth,
+                                this_lines * stride,
+                                data + y_start * stride);
+         xcb_discard_reply(chain->conn, cookie.sequence);
+         y_start += this_lines;
+         y_todo -= this_lines;
+      }
    }
-   
+
    xcb_flush(chain->conn);
-   image->busy = false;
+
+done:
    return VK_SUCCESS;  
 }
 
@@ -877,9 +1018,10 @@ wsi_x11_present_image(struct wsi_x11_swapchain *chain, uint32_t image_index)
    else
       result = wsi_x11_present_image_dri3(chain, image_index);
 
+   /* With Present events the ID is signaled on CompleteNotify instead. */
    if (result < 0)
       wsi_x11_notify_present_error(chain);
-   else
+   else if (!chain->has_present_events)
       wsi_x11_notify_present_success(chain, &chain->images[image_index]);
 
    return result;
@@ -907,7 +1049,6 @@ wsi_x11_acquire_next_image(struct wsi_swapchain *wsi_chain,
                            uint32_t *image_index)
 {
    struct wsi_x11_swapchain *chain = (struct wsi_x11_swapchain *)wsi_chain;
-   xcb_generic_event_t *event;
    VkResult result;
    struct timespec abs_timespec;
    uint64_t abs_timeout = 0;
@@ -923,20 +1064,32 @@ wsi_x11_acquire_next_image(struct wsi_swapchain *wsi_chain,
       timespec_from_nsec(&abs_timespec, abs_timeout);
    }    
 
+   /* Images are freed by the queue or event thread, or by the present
+    * itself when there is neither. Scan under the pool lock so that a
+    * release between the scan and the wait isn't missed.
+    */
+   pthread_mutex_lock(&chain->image_pool_mutex);
+
+   result = VK_NOT_READY;
    while (chain->status >= 0) {
       for (uint32_t i = 0; i < chain->base.image_count; i++) {
          if (!chain->images[i].busy) {
+            /* Already triggered once the IdleNotify has arrived. */
+            if (chain->images[i].shm_fence)
+               xshmfence_await(chain->images[i].shm_fence);
+
             *image_index = i;
             chain->images[i].busy = true;
+            pthread_mutex_unlock(&chain->image_pool_mutex);
             return VK_SUCCESS;
          }
       }
-      
-      if (chain->base.wsi->sw)
-         return VK_NOT_READY;
-     
-      pthread_mutex_lock(&chain->image_pool_mutex);
-      
+
+      if (info->timeout == 0) {
+         result = VK_NOT_READY;
+         break;
+      }
+
       int ret;
       if (info->timeout == UINT64_MAX)
          ret = pthread_cond_wait(&chain->image_pool_cond,
@@ -945,17 +1098,17 @@ wsi_x11_acquire_next_image(struct wsi_swapchain *wsi_chain,
          ret = pthread_cond_timedwait(&chain->image_pool_cond,
                                       &chain->image_pool_mutex,
                                       &abs_timespec);
-      if (ret == ETIMEDOUT)
+      if (ret == ETIMEDOUT) {
          result = VK_TIMEOUT;
-      else if (ret)
+         break;
+      } else if (ret) {
          result = VK_ERROR_DEVICE_LOST;
-     
-      pthread_mutex_unlock(&chain->image_pool_mutex);
-      
-      if (result < 0)
-          break;
+         break;
+      }
    }
 
+   pthread_mutex_unlock(&chain->image_pool_mutex);
+
    if (chain->status < 0)
       return chain->status;       
    
@@ -975,15 +1128,62 @@ wsi_x11_queue_present(struct wsi_swapchain *anv_chain,
    if (chain->status < 0)
       return chain->status;
 
-   chain->images[image_index].present_id = present_id;
-   chain->images[image_index].busy = true;
+   struct wsi_x11_image *image = &chain->images[image_index];
+   xcb_xfixes_region_t update_area = XCB_NONE;
+   VkRect2D bbox = {
+      .extent = chain->extent,
+   };
+
+   /* Damage is in swapchain image coordinates, which don't match the
+    * presented buffer when scaling.
+    */
+   if (!chain->scaled &&
+       damage && damage->pRectangles && damage->rectangleCount > 0 &&
+       damage->rectangleCount <= MAX_DAMAGE_RECTS) {
+      xcb_rectangle_t rects[MAX_DAMAGE_RECTS];
+      int32_t x0 = chain->extent.width, y0 = chain->extent.height;
+      int32_t x1 = 0, y1 = 0;
+
+      for (unsigned i = 0; i < damage->rectangleCount; i++) {
+         const VkRectLayerKHR *rect = &damage->pRectangles[i];
+         assert(rect->layer == 0);
+         rects[i].x = rect->offset.x;
+         rects[i].y = rect->offset.y;
+         rects[i].width = rect->extent.width;
+         rects[i].height = rect->extent.height;
+
+         x0 = MIN2(x0, MAX2(rect->offset.x, 0));
+         y0 = MIN2(y0, MAX2(rect->offset.y, 0));
+         x1 = MAX2(x1, CLAMP(rect->offset.x + (int32_t)rect->extent.width,
+                             0, (int32_t)chain->extent.width));
+         y1 = MAX2(y1, CLAMP(rect->offset.y + (int32_t)rect->extent.height,
+                             0, (int32_t)chain->extent.height));
+      }
+
+      bbox = (VkRect2D) {
+         .offset = { x0, y0 },
+         .extent = { MAX2(x1 - x0, 0), MAX2(y1 - y0, 0) },
+      };
+
+      if (image->update_region) {
+         xcb_xfixes_set_region(chain->conn, image->update_region,
+                               damage->rectangleCount, rects);
+         update_area = image->update_region;
+      }
+   }
+
+   image->update_area = update_area;
+   image->damage = bbox;
+   image->present_id = present_id;
+   image->busy = true;
    
    if (chain->has_present_queue) {
       wsi_queue_push(&chain->present_queue, image_index);
       result = chain->status;
    } else {
       result = wsi_x11_present_image(chain, image_index);
-      chain->images[image_index].busy = false;
+      if (!chain->has_present_events)
+         wsi_x11_notify_idle_image(chain, image);
    }
    
    return result;
@@ -1003,7 +1203,10 @@ wsi_x11_present_queue_thread(void *state)
       if (result < 0 || chain->status < 0)
          break;
       
-      if (chain->base.image_info.hwbuf_fd <= 0) {
+      /* A single shared hwbuf relies on implicit sync, separate buffers
+       * are only handed to the server once rendering is done.
+       */
+      if (chain->base.image_info.hwbuf_fd <= 0 || chain->hwbuf_per_image) {
          result = chain->base.wsi->WaitForFences(chain->base.device, 1,
                                                  &chain->base.fences[image_index],
                                                  true, UINT64_MAX);
@@ -1016,8 +1219,33 @@ wsi_x11_present_queue_thread(void *state)
       result = wsi_x11_present_image(chain, image_index);      
       if (result < 0)
          break;
-     
-      wsi_x11_notify_idle_image(chain, &chain->images[image_index]);
+
+      /* The buffer the server showed until now is released by this
+       * present.
+       */
+      if (chain->hwbuf_per_image) {
+         if (chain->hwbuf_shown != UINT32_MAX)
+            wsi_x11_notify_idle_image(chain, &chain->images[chain->hwbuf_shown]);
+         chain->hwbuf_shown = image_index;
+         continue;
+      }
+
+      if (!chain->has_present_events) {
+         wsi_x11_notify_idle_image(chain, &chain->images[image_index]);
+         continue;
+      }
+
+      /* FIFO: don't send the next image before this one hit the screen. */
+      if (chain->base.present_mode == VK_PRESENT_MODE_FIFO_KHR ||
+          chain->base.present_mode == VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+         uint32_t serial = chain->images[image_index].serial;
+
+         pthread_mutex_lock(&chain->present_id_mutex);
+         while (chain->status >= 0 &&
+                (int32_t)(chain->complete_sbc - serial) < 0)
+            pthread_cond_wait(&chain->present_id_cond, &chain->present_id_mutex);
+         pthread_mutex_unlock(&chain->present_id_mutex);
+      }
    }
 
    wsi_x11_swapchain_result(chain, result);
@@ -1025,6 +1253,113 @@ wsi_x11_present_queue_thread(void *state)
    return NULL;
 }
 
+static void
+wsi_x11_handle_present_event(struct wsi_x11_swapchain *chain,
+                             xcb_present_generic_event_t *event)
+{
+   switch (event->evtype) {
+   case XCB_PRESENT_CONFIGURE_NOTIFY: {
+      xcb_present_configure_notify_event_t *config = (void *) event;
+
+      if (config->width != chain->extent.width ||
+          config->height != chain->extent.height)
+         wsi_x11_swapchain_result(chain, VK_SUBOPTIMAL_KHR);
+      break;
+   }
+
+   case XCB_PRESENT_EVENT_IDLE_NOTIFY: {
+      xcb_present_idle_notify_event_t *idle = (void *) event;
+
+      for (uint32_t i = 0; i < chain->base.image_count; i++) {
+         if (chain->images[i].pixmap == idle->pixmap) {
+            wsi_x11_notify_idle_image(chain, &chain->images[i]);
+            break;
+         }
+      }
+      break;
+   }
+
+   case XCB_PRESENT_EVENT_COMPLETE_NOTIFY: {
+      xcb_present_complete_notify_event_t *complete = (void *) event;
+
+      if (complete->kind != XCB_PRESENT_COMPLETE_KIND_PIXMAP)
+         break;
+
+      pthread_mutex_lock(&chain->present_id_mutex);
+      chain->last_present_msc = complete->msc;
+      chain->complete_sbc = complete->serial;
+      pthread_cond_broadcast(&chain->present_id_cond);
+      pthread_mutex_unlock(&chain->present_id_mutex);
+
+      for (uint32_t i = 0; i < chain->base.image_count; i++) {
+         if (chain->images[i].serial == complete->serial) {
+            wsi_x11_notify_present_success(chain, &chain->images[i]);
+            break;
+         }
+      }
+      break;
+   }
+
+   default:
+      break;
+   }
+}
+
+static void *
+wsi_x11_event_thread(void *state)
+{
+   struct wsi_x11_swapchain *chain = state;
+
+   while (!chain->event_thread_exit) {
+      xcb_generic_event_t *event =
+         xcb_wait_for_special_event(chain->conn, chain->special_event);
+      if (!event) {
+         wsi_x11_swapchain_result(chain, VK_ERROR_SURFACE_LOST_KHR);
+         break;
+      }
+
+      wsi_x11_handle_present_event(chain, (void *) event);
+      free(event);
+   }
+
+   /* Wake up anyone waiting for an image or a present. */
+   wsi_x11_notify_idle_image(chain, NULL);
+   pthread_mutex_lock(&chain->present_id_mutex);
+   pthread_cond_broadcast(&chain->present_id_cond);
+   pthread_mutex_unlock(&chain->present_id_mutex);
+   return NULL;
+}
+
+static int wsi_x11_get_hwbuf_fd(xcb_connection_t *conn, xcb_window_t window) 
+{
+   xcb_dri3_buffer_from_pixmap_cookie_t cookie;
+   xcb_dri3_buffer_from_pixmap_reply_t *reply;
+   int fd = -1;
+
+   cookie = xcb_dri3_buffer_from_pixmap(conn, window);
+   reply = xcb_dri3_buffer_from_pixmap_reply(conn, cookie, NULL);
+   
+   if (reply) {
+      int *fds;
+      fds = xcb_dri3_buffer_from_pixmap_reply_fds(conn, reply);
+      fd = fds[0];
+      free(reply);
+   }
+   
+   return fd;
+}
+
+static bool
+wsi_x11_same_buffer(int fd_a, int fd_b)
+{
+   struct stat st_a, st_b;
+
+   if (fstat(fd_a, &st_a) || fstat(fd_b, &st_b))
+      return true;
+
+   return st_a.st_dev == st_b.st_dev && st_a.st_ino == st_b.st_ino;
+}
+
 static uint8_t *
 alloc_shm(struct wsi_image *imagew, unsigned size)
 {
@@ -1056,20 +1391,47 @@ wsi_x11_image_init(VkDevice device_h, struct wsi_x11_swapchain *chain,
 {
    xcb_void_cookie_t cookie;
    VkResult result;
-   uint32_t bpp = 32;
+   uint32_t bpp = chain->cpp * 8;
+   int chain_hwbuf_fd = chain->base.image_info.hwbuf_fd;
+
+   /* Ask the server for one hwbuf per image. Servers that only have a
+    * single buffer per window hand out the same one again, in which case
+    * every image shares it.
+    */
+   image->hwbuf_fd = -1;
+   if (chain_hwbuf_fd > 0) {
+      if (image != &chain->images[0]) {
+         image->hwbuf_fd = wsi_x11_get_hwbuf_fd(chain->conn, chain->window);
+         if (image->hwbuf_fd > 0 &&
+             wsi_x11_same_buffer(image->hwbuf_fd, chain_hwbuf_fd)) {
+            close(image->hwbuf_fd);
+            image->hwbuf_fd = -1;
+         }
+         if (image->hwbuf_fd <= 0)
+            chain->hwbuf_per_image = false;
+      }
+      if (image->hwbuf_fd <= 0)
+         image->hwbuf_fd = os_dupfd_cloexec(chain_hwbuf_fd);
+      if (image->hwbuf_fd < 0)
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+      chain->base.image_info.hwbuf_fd = image->hwbuf_fd;
+   }
 
    result = wsi_create_image(&chain->base, &chain->base.image_info,
                              &image->base);
+   chain->base.image_info.hwbuf_fd = chain_hwbuf_fd;
    if (result != VK_SUCCESS)
       return result;
 
    if (chain->base.wsi->sw) {
-      if (!chain->has_mit_shm) {
+      /* alloc_shm() is called from wsi_create_image() when MIT-SHM is
+       * available. Fall back to PutImage if it failed.
+       */
+      if (!image->shmaddr) {
          image->busy = false;
          return VK_SUCCESS;
       }
-	  
-      alloc_shm(&image->base, image->base.row_pitches[0] * chain->extent.height);	  
 
       image->shmseg = xcb_generate_id(chain->conn);
 
@@ -1082,6 +1444,12 @@ wsi_x11_image_init(VkDevice device_h, struct wsi_x11_swapchain *chain,
       return VK_SUCCESS;		
    }
    
+   image->update_region = XCB_NONE;
+   if (chain->has_xfixes) {
+      image->update_region = xcb_generate_id(chain->conn);
+      xcb_xfixes_create_region(chain->conn, image->update_region, 0, NULL);
+   }
+
    image->pixmap = 0;
    if (chain->base.image_info.hwbuf_fd <= 0) {
       image->pixmap = xcb_generate_id(chain->conn);
@@ -1101,6 +1469,24 @@ wsi_x11_image_init(VkDevice device_h, struct wsi_x11_swapchain *chain,
                                   image->base.row_pitches[0],
                                   chain->depth, bpp, fd);
    }
+
+   if (chain->has_present_events) {
+      int fence_fd = xshmfence_alloc_shm();
+      if (fence_fd < 0)
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+      image->shm_fence = xshmfence_map_shm(fence_fd);
+      if (image->shm_fence == NULL) {
+         close(fence_fd);
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+      }
+
+      /* XCB takes ownership of the fd. */
+      image->sync_fence = xcb_generate_id(chain->conn);
+      xcb_dri3_fence_from_fd(chain->conn, image->pixmap, image->sync_fence,
+                             false, fence_fd);
+      xshmfence_trigger(image->shm_fence);
+   }
    
    image->busy = false;
    return VK_SUCCESS;
@@ -1117,9 +1503,20 @@ wsi_x11_image_finish(struct wsi_x11_swapchain *chain,
       cookie = xcb_free_pixmap(chain->conn, image->pixmap);
       xcb_discard_reply(chain->conn, cookie.sequence);
    }
+
+   if (image->update_region) {
+      cookie = xcb_xfixes_destroy_region(chain->conn, image->update_region);
+      xcb_discard_reply(chain->conn, cookie.sequence);
+   }
+
+   if (image->shm_fence) {
+      cookie = xcb_sync_destroy_fence(chain->conn, image->sync_fence);
+      xcb_discard_reply(chain->conn, cookie.sequence);
+      xshmfence_unmap_shm(image->shm_fence);
+   }
    
-   if (chain->base.image_info.hwbuf_fd > 0)
-      close(chain->base.image_info.hwbuf_fd);
+   if (image->hwbuf_fd > 0)
+      close(image->hwbuf_fd);
 
    wsi_destroy_image(&chain->base, &image->base);
 #ifdef HAVE_SYS_SHM_H
@@ -1128,6 +1525,30 @@ wsi_x11_image_finish(struct wsi_x11_swapchain *chain,
 #endif
 }
 
+static void
+wsi_x11_stop_event_thread(struct wsi_x11_swapchain *chain)
+{
+   /* A NotifyMSC request generates a CompleteNotify, which wakes the thread
+    * up so that it sees the exit flag.
+    */
+   chain->event_thread_exit = true;
+   xcb_present_notify_msc(chain->conn, chain->window, 0, 0, 0, 0);
+   xcb_flush(chain->conn);
+   pthread_join(chain->event_thread, NULL);
+}
+
+static void
+wsi_x11_unregister_present_events(struct wsi_x11_swapchain *chain)
+{
+   xcb_void_cookie_t cookie;
+
+   cookie = xcb_present_select_input(chain->conn, chain->event_id,
+                                     chain->window,
+                                     XCB_PRESENT_EVENT_MASK_NO_EVENT);
+   xcb_discard_reply(chain->conn, cookie.sequence);
+   xcb_unregister_for_special_event(chain->conn, chain->special_event);
+}
+
 static VkResult
 wsi_x11_swapchain_destroy(struct wsi_swapchain *anv_chain,
                           const VkAllocationCallbacks *pAllocator)
@@ -1136,14 +1557,26 @@ wsi_x11_swapchain_destroy(struct wsi_swapchain *anv_chain,
 
    if (chain->has_present_queue) {
       chain->status = VK_ERROR_OUT_OF_DATE_KHR;
+      pthread_mutex_lock(&chain->present_id_mutex);
+      pthread_cond_broadcast(&chain->present_id_cond);
+      pthread_mutex_unlock(&chain->present_id_mutex);
       wsi_queue_push(&chain->present_queue, UINT32_MAX);
       pthread_join(chain->queue_thread, NULL);
 
       wsi_queue_destroy(&chain->present_queue);
    }
 
+   if (chain->has_present_events)
+      wsi_x11_stop_event_thread(chain);
+
    for (uint32_t i = 0; i < chain->base.image_count; i++)
       wsi_x11_image_finish(chain, pAllocator, &chain->images[i]); 
+
+   if (chain->has_present_events)
+      wsi_x11_unregister_present_events(chain);
+
+   if (chain->base.image_info.hwbuf_fd > 0)
+      close(chain->base.image_info.hwbuf_fd);
   
    pthread_mutex_destroy(&chain->image_pool_mutex);
    pthread_cond_destroy(&chain->image_pool_cond);  
@@ -1234,25 +1667,6 @@ static VkResult wsi_x11_wait_for_present(struct wsi_swapchain *wsi_chain,
    return result;
 }
 
-static int wsi_x11_get_hwbuf_fd(xcb_connection_t *conn, xcb_window_t window) 
-{
-   xcb_dri3_buffer_from_pixmap_cookie_t cookie;
-   xcb_dri3_buffer_from_pixmap_reply_t *reply;
-   int fd = -1;
-
-   cookie = xcb_dri3_buffer_from_pixmap(conn, window);
-   reply = xcb_dri3_buffer_from_pixmap_reply(conn, cookie, NULL);
-   
-   if (reply) {
-      int *fds;
-      fds = xcb_dri3_buffer_from_pixmap_reply_fds(conn, reply);
-      fd = fds[0];
-      free(reply);
-   }
-   
-   return fd;
-}
-
 static VkResult
 wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
                                  VkDevice device,
@@ -1285,6 +1699,17 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    const uint16_t cur_height = geom->height;
    free(geom);
 
+   const bool hwbuf = wsi_device->x11.use_hwbuf;
+
+   /* The hwbuf path hands the images themselves to the server, so only
+    * the buffer blit can scale.
+    */
+   const bool scaled = wsi_x11_upscale_enabled(wsi_device) && !hwbuf &&
+                       pCreateInfo->imageExtent.width <= cur_width &&
+                       pCreateInfo->imageExtent.height <= cur_height &&
+                       (pCreateInfo->imageExtent.width != cur_width ||
+                        pCreateInfo->imageExtent.height != cur_height);
+
    /* Allocate the actual swapchain. The size depends on image count. */
    size_t size = sizeof(*chain) + pCreateInfo->minImageCount * sizeof(chain->images[0]);
    chain = vk_zalloc(pAllocator, size, 8,
@@ -1327,8 +1752,11 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    
    if (wsi_device->sw) {
       cpu_image_params = (struct wsi_cpu_image_params) {
-         .base.image_type = WSI_IMAGE_TYPE_CPU
+         .base.image_type = WSI_IMAGE_TYPE_CPU,
+         .alloc_shm = wsi_conn->has_mit_shm ? &alloc_shm : NULL,
       };
+      if (scaled)
+         cpu_image_params.blit_extent = (VkExtent2D) { cur_width, cur_height };
       image_params = &cpu_image_params.base;
    } else {
       drm_image_params = (struct wsi_drm_image_params) {
@@ -1356,9 +1784,7 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    chain->base.get_wsi_image = wsi_x11_get_wsi_image;
    chain->base.acquire_next_image = wsi_x11_acquire_next_image;
    chain->base.queue_present = wsi_x11_queue_present;
-   
-   if (!wsi_device->sw)
-      chain->base.wait_for_present = wsi_x11_wait_for_present;
+   chain->base.wait_for_present = wsi_x11_wait_for_present;
 
    chain->base.release_images = wsi_x11_release_images;
    chain->base.present_mode = present_mode;
@@ -1366,29 +1792,30 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    chain->conn = conn;
    chain->window = window;
    chain->depth = bit_depth;
-   chain->extent = pCreateInfo->imageExtent;
+   chain->cpp = vk_format_get_blocksize(pCreateInfo->imageFormat);
+   chain->scaled = scaled;
+   if (scaled)
+      chain->extent = (VkExtent2D) { cur_width, cur_height };
+   else
+      chain->extent = pCreateInfo->imageExtent;
    chain->has_present_queue = false;
    chain->present_id = 0;
    chain->status = VK_SUCCESS;
+   chain->has_xfixes = wsi_conn->has_xfixes;
    chain->has_mit_shm = wsi_conn->has_mit_shm;
 
    if (chain->extent.width != cur_width || chain->extent.height != cur_height)
        chain->status = VK_SUBOPTIMAL_KHR;
    
-   const char *use_hwbuf = getenv("MESA_VK_WSI_USE_HWBUF");
-   if (use_hwbuf && (!strcmp(use_hwbuf, "true") || !strcmp(use_hwbuf, "1"))) {
+   if (hwbuf) {
       chain->base.image_info.hwbuf_fd = wsi_x11_get_hwbuf_fd(chain->conn, chain->window);
    }
    else 
       chain->base.image_info.hwbuf_fd = -1;
-   
-   if (chain->base.image_info.hwbuf_fd <= 0 && !wsi_device->sw) {
-      cookie = xcb_present_select_input(chain->conn, 0,
-                                        chain->window,
-                                        XCB_PRESENT_EVENT_MASK_NO_EVENT);
-      xcb_discard_reply(chain->conn, cookie.sequence);    
-   }   
 
+   chain->hwbuf_per_image = chain->base.image_info.hwbuf_fd > 0;
+   chain->hwbuf_shown = UINT32_MAX;
+   
    /* Create the graphics context. */
    chain->gc = xcb_generate_id(chain->conn);
    if (!chain->gc) {
@@ -1403,6 +1830,22 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
                           (uint32_t []) { 0 });
    xcb_discard_reply(chain->conn, cookie.sequence);
    
+   /* The hwbuf path has no pixmaps, and so no Present events. */
+   chain->has_present_events =
+      chain->base.image_info.hwbuf_fd <= 0 && !wsi_device->sw;
+   if (chain->has_present_events) {
+      chain->event_id = xcb_generate_id(chain->conn);
+      chain->special_event =
+         xcb_register_for_special_xge(chain->conn, &xcb_present_id,
+                                      chain->event_id, NULL);
+      cookie = xcb_present_select_input(chain->conn, chain->event_id,
+                                        chain->window,
+                                        XCB_PRESENT_EVENT_MASK_CONFIGURE_NOTIFY |
+                                        XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY |
+                                        XCB_PRESENT_EVENT_MASK_IDLE_NOTIFY);
+      xcb_discard_reply(chain->conn, cookie.sequence);
+   }
+
    uint32_t image = 0;
    for (; image < chain->base.image_count; image++) {
       result = wsi_x11_image_init(device, chain, pCreateInfo, pAllocator,
@@ -1411,7 +1854,27 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
          goto fail_init_images;
    }
 
-   if (chain->base.present_mode == VK_PRESENT_MODE_MAILBOX_KHR && !wsi_device->sw) {
+   if (chain->has_present_events) {
+      ret = pthread_create(&chain->event_thread, NULL,
+                           wsi_x11_event_thread, chain);
+      if (ret) {
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+         goto fail_init_images;
+      }
+   }
+
+   /* With a single image there is nothing to release the shown one. */
+   if (chain->base.image_count < 2)
+      chain->hwbuf_per_image = false;
+
+   /* FIFO needs the queue thread to wait for each present to complete. */
+   bool wants_queue = chain->base.present_mode == VK_PRESENT_MODE_MAILBOX_KHR ||
+                      chain->hwbuf_per_image ||
+                      (chain->has_present_events &&
+                       chain->base.present_mode != VK_PRESENT_MODE_IMMEDIATE_KHR);
+   if (wsi_device->sw)
+      wants_queue = chain->has_mit_shm;
+   if (wants_queue) {
       chain->has_present_queue = true;
 
       /* The queues have a length of base.image_count + 1 because we will
@@ -1421,14 +1884,14 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
       int ret;
       ret = wsi_queue_init(&chain->present_queue, chain->base.image_count + 1);
       if (ret)
-         goto fail_init_images;
+         goto fail_event_thread;
 
       ret = pthread_create(&chain->queue_thread, NULL,
                            wsi_x11_present_queue_thread, chain);
       if (ret) {
          wsi_queue_destroy(&chain->present_queue);
 
-         goto fail_init_images;
+         goto fail_event_thread;
       }
    }
    
@@ -1438,10 +1901,20 @@ wsi_x11_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
 
    return VK_SUCCESS;
 
+fail_event_thread:
+   if (chain->has_present_events)
+      wsi_x11_stop_event_thread(chain);
+
 fail_init_images:
    for (uint32_t j = 0; j < image; j++)
       wsi_x11_image_finish(chain, pAllocator, &chain->images[j]);
 
+   if (chain->has_present_events)
+      wsi_x11_unregister_present_events(chain);
+
+   if (chain->base.image_info.hwbuf_fd > 0)
+      close(chain->base.image_info.hwbuf_fd);
+
 fail_register:
    wsi_swapchain_finish(&chain->base);
 
@@ -1473,6 +1946,20 @@ wsi_x11_init_wsi(struct wsi_device *wsi_device,
       goto fail_alloc;
    }
 
+   if (dri_options) {
+      if (driCheckOption(dri_options, "vk_x11_override_min_image_count", DRI_INT)) {
+         wsi_device->x11.override_minImageCount =
+            driQueryOptioni(dri_options, "vk_x11_override_min_image_count");
+      }
+      if (driCheckOption(dri_options, "vk_x11_use_hwbuf", DRI_BOOL)) {
+         wsi_device->x11.use_hwbuf =
+            driQueryOptionb(dri_options, "vk_x11_use_hwbuf");
+      }
+   }
+   /* the environment overrides the application profile */
+   wsi_device->x11.use_hwbuf =
+      debug_get_bool_option("MESA_VK_WSI_USE_HWBUF", wsi_device->x11.use_hwbuf);
+
    wsi->connections = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
                                               _mesa_key_pointer_equal);
    if (!wsi->connections) {
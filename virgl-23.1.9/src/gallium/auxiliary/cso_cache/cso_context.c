@@ -61,6 +61,12 @@ struct sampler_info
    void *samplers[PIPE_MAX_SAMPLERS];
 };
 
+/* The number of most recently used rasterizer, blend and DSA states that are
+ * checked before hashing the template.
+ */
+#define CSO_RECENT_STATES 4
+#define CSO_RECENT_TYPES (CSO_DEPTH_STENCIL_ALPHA + 1)
+
 
 
 struct cso_context {
@@ -120,11 +126,62 @@ struct cso_context {
    unsigned min_samples, min_samples_saved;
    struct pipe_stencil_ref stencil_ref, stencil_ref_saved;
 
+   /* Most recently used first, indexed by cso_cache_type. */
+   void *recent_states[CSO_RECENT_TYPES][CSO_RECENT_STATES];
+
    /* This should be last to keep all of the above together in memory. */
    struct cso_cache cache;
 };
 
 
+/**
+ * Look for a state matching the template among the last few ones set, which
+ * is a lot cheaper than hashing the template when apps keep toggling between
+ * a handful of states.
+ */
+static inline void *
+cso_find_recent_state(struct cso_context *ctx, enum cso_cache_type type,
+                      const void *templ, unsigned key_size)
+{
+   void **recent = ctx->recent_states[type];
+
+   for (unsigned i = 0; i < CSO_RECENT_STATES; i++) {
+      void *cso = recent[i];
+
+      /* All the CSO structures start with the state. */
+      if (cso && !memcmp(cso, templ, key_size)) {
+         memmove(&recent[1], &recent[0], i * sizeof(recent[0]));
+         recent[0] = cso;
+         return cso;
+      }
+   }
+   return NULL;
+}
+
+
+static inline void
+cso_add_recent_state(struct cso_context *ctx, enum cso_cache_type type,
+                     void *cso)
+{
+   void **recent = ctx->recent_states[type];
+
+   memmove(&recent[1], &recent[0],
+           (CSO_RECENT_STATES - 1) * sizeof(recent[0]));
+   recent[0] = cso;
+}
+
+
+static inline void
+cso_remove_recent_state(struct cso_context *ctx, enum cso_cache_type type,
+                        void *cso)
+{
+   for (unsigned i = 0; i < CSO_RECENT_STATES; i++) {
+      if (ctx->recent_states[type][i] == cso)
+         ctx->recent_states[type][i] = NULL;
+   }
+}
+
+
 static inline boolean
 delete_cso(struct cso_context *ctx,
            void *state, enum cso_cache_type type)
@@ -157,6 +214,8 @@ delete_cso(struct cso_context *ctx,
       assert(0);
    }
 
+   if (type < CSO_RECENT_TYPES)
+      cso_remove_recent_state(ctx, type, state);
    cso_delete_state(ctx->base.pipe, state, type);
    return true;
 }
@@ -504,6 +563,7 @@ cso_set_blend(struct cso_context *ctx,
 {
    unsigned key_size, hash_key;
    struct cso_hash_iter iter;
+   struct cso_blend *cso;
    void *handle;
 
    if (templ->independent_blend_enable) {
@@ -511,11 +571,19 @@ cso_set_blend(struct cso_context *ctx,
        * to be a literal constant, so that memcpy and the hash computation can
        * be inlined and unrolled.
        */
+      cso = cso_find_recent_state(ctx, CSO_BLEND, templ,
+                                  CSO_BLEND_KEY_SIZE_ALL_RT);
+      if (cso)
+         goto bind;
       hash_key = cso_construct_key(templ, CSO_BLEND_KEY_SIZE_ALL_RT);
       iter = cso_find_state_template(&ctx->cache, hash_key, CSO_BLEND,
                                      templ, CSO_BLEND_KEY_SIZE_ALL_RT);
       key_size = CSO_BLEND_KEY_SIZE_ALL_RT;
    } else {
+      cso = cso_find_recent_state(ctx, CSO_BLEND, templ,
+                                  CSO_BLEND_KEY_SIZE_RT0);
+      if (cso)
+         goto bind;
       hash_key = cso_construct_key(templ, CSO_BLEND_KEY_SIZE_RT0);
       iter = cso_find_state_template(&ctx->cache, hash_key, CSO_BLEND,
                                      templ, CSO_BLEND_KEY_SIZE_RT0);
@@ -523,7 +591,7 @@ cso_set_blend(struct cso_context *ctx,
    }
 
    if (cso_hash_iter_is_null(iter)) {
-      struct cso_blend *cso = MALLOC(sizeof(struct cso_blend));
+      cso = MALLOC(sizeof(struct cso_blend));
       if (!cso)
          return PIPE_ERROR_OUT_OF_MEMORY;
 
@@ -536,12 +604,13 @@ cso_set_blend(struct cso_context *ctx,
          FREE(cso);
          return PIPE_ERROR_OUT_OF_MEMORY;
       }
-
-      handle = cso->data;
    } else {
-      handle = ((struct cso_blend *)cso_hash_iter_data(iter))->data;
+      cso = (struct cso_blend *)cso_hash_iter_data(iter);
    }
+   cso_add_recent_state(ctx, CSO_BLEND, cso);
 
+bind:
+   handle = cso->data;
    if (ctx->blend != handle) {
       ctx->blend = handle;
       ctx->base.pipe->bind_blend_state(ctx->base.pipe, handle);
@@ -574,36 +643,38 @@ cso_set_depth_stencil_alpha(struct cso_context *ctx,
                             const struct pipe_depth_stencil_alpha_state *templ)
 {
    const unsigned key_size = sizeof(struct pipe_depth_stencil_alpha_state);
-   const unsigned hash_key = cso_construct_key(templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(&ctx->cache,
-                                                       hash_key,
-                                                       CSO_DEPTH_STENCIL_ALPHA,
-                                                       templ, key_size);
+   struct cso_depth_stencil_alpha *cso =
+      cso_find_recent_state(ctx, CSO_DEPTH_STENCIL_ALPHA, templ, key_size);
    void *handle;
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_depth_stencil_alpha *cso =
-         MALLOC(sizeof(struct cso_depth_stencil_alpha));
-      if (!cso)
-         return PIPE_ERROR_OUT_OF_MEMORY;
+   if (!cso) {
+      const unsigned hash_key = cso_construct_key(templ, key_size);
+      struct cso_hash_iter iter =
+         cso_find_state_template(&ctx->cache, hash_key,
+                                 CSO_DEPTH_STENCIL_ALPHA, templ, key_size);
 
-      memcpy(&cso->state, templ, sizeof(*templ));
-      cso->data = ctx->base.pipe->create_depth_stencil_alpha_state(ctx->base.pipe,
-                                                              &cso->state);
-
-      iter = cso_insert_state(&ctx->cache, hash_key,
-                              CSO_DEPTH_STENCIL_ALPHA, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
+         cso = MALLOC(sizeof(struct cso_depth_stencil_alpha));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
+
+         memcpy(&cso->state, templ, sizeof(*templ));
+         cso->data = ctx->base.pipe->create_depth_stencil_alpha_state(ctx->base.pipe,
+                                                                 &cso->state);
+
+         iter = cso_insert_state(&ctx->cache, hash_key,
+                                 CSO_DEPTH_STENCIL_ALPHA, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+      } else {
+         cso = (struct cso_depth_stencil_alpha *)cso_hash_iter_data(iter);
       }
-
-      handle = cso->data;
-   } else {
-      handle = ((struct cso_depth_stencil_alpha *)
-                cso_hash_iter_data(iter))->data;
+      cso_add_recent_state(ctx, CSO_DEPTH_STENCIL_ALPHA, cso);
    }
 
+   handle = cso->data;
    if (ctx->depth_stencil != handle) {
       ctx->depth_stencil = handle;
       ctx->base.pipe->bind_depth_stencil_alpha_state(ctx->base.pipe, handle);
@@ -637,11 +708,8 @@ cso_set_rasterizer(struct cso_context *ctx,
                    const struct pipe_rasterizer_state *templ)
 {
    const unsigned key_size = sizeof(struct pipe_rasterizer_state);
-   const unsigned hash_key = cso_construct_key(templ, key_size);
-   struct cso_hash_iter iter = cso_find_state_template(&ctx->cache,
-                                                       hash_key,
-                                                       CSO_RASTERIZER,
-                                                       templ, key_size);
+   struct cso_rasterizer *cso =
+      cso_find_recent_state(ctx, CSO_RASTERIZER, templ, key_size);
    void *handle = NULL;
 
    /* We can't have both point_quad_rasterization (sprites) and point_smooth
@@ -649,25 +717,32 @@ cso_set_rasterizer(struct cso_context *ctx,
     */
    assert(!(templ->point_quad_rasterization && templ->point_smooth));
 
-   if (cso_hash_iter_is_null(iter)) {
-      struct cso_rasterizer *cso = MALLOC(sizeof(struct cso_rasterizer));
-      if (!cso)
-         return PIPE_ERROR_OUT_OF_MEMORY;
-
-      memcpy(&cso->state, templ, sizeof(*templ));
-      cso->data = ctx->base.pipe->create_rasterizer_state(ctx->base.pipe, &cso->state);
+   if (!cso) {
+      const unsigned hash_key = cso_construct_key(templ, key_size);
+      struct cso_hash_iter iter =
+         cso_find_state_template(&ctx->cache, hash_key, CSO_RASTERIZER,
+                                 templ, key_size);
 
-      iter = cso_insert_state(&ctx->cache, hash_key, CSO_RASTERIZER, cso);
       if (cso_hash_iter_is_null(iter)) {
-         FREE(cso);
-         return PIPE_ERROR_OUT_OF_MEMORY;
-      }
+         cso = MALLOC(sizeof(struct cso_rasterizer));
+         if (!cso)
+            return PIPE_ERROR_OUT_OF_MEMORY;
 
-      handle = cso->data;
-   } else {
-      handle = ((struct cso_rasterizer *)cso_hash_iter_data(iter))->data;
+         memcpy(&cso->state, templ, sizeof(*templ));
+         cso->data = ctx->base.pipe->create_rasterizer_state(ctx->base.pipe, &cso->state);
+
+         iter = cso_insert_state(&ctx->cache, hash_key, CSO_RASTERIZER, cso);
+         if (cso_hash_iter_is_null(iter)) {
+            FREE(cso);
+            return PIPE_ERROR_OUT_OF_MEMORY;
+         }
+      } else {
+         cso = (struct cso_rasterizer *)cso_hash_iter_data(iter);
+      }
+      cso_add_recent_state(ctx, CSO_RASTERIZER, cso);
    }
 
+   handle = cso->data;
    if (ctx->rasterizer != handle) {
       ctx->rasterizer = handle;
       ctx->flatshade_first = templ->flatshade_first;
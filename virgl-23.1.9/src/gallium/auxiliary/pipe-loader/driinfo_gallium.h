@@ -62,4 +62,5 @@ DRI_CONF_SECTION_MISCELLANEOUS
    DRI_CONF_VS_POSITION_ALWAYS_PRECISE(false)
    DRI_CONF_ALLOW_RGB10_CONFIGS(true)
    DRI_CONF_FORCE_INTEGER_TEX_NEAREST(false)
+   DRI_CONF_PRECOMPILE_STATE_VARIANTS(false)
 DRI_CONF_SECTION_END
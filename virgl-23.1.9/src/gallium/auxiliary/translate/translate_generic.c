@@ -642,7 +642,7 @@ generic_run_one(struct translate_generic *tg,
          }
       } else {
          if (likely(tg->attrib[attr].copy_size >= 0)) {
-            memcpy(data, &instance_id, 4);
+            memcpy(dst, &instance_id, 4);
          } else {
             data[0] = (float)instance_id;
             tg->attrib[attr].emit(data, dst);
@@ -708,6 +708,40 @@ generic_run_elts8(struct translate *translate,
    }
 }
 
+static ALWAYS_INLINE void
+copy_attrib(uint8_t *restrict dst, unsigned dst_stride,
+            const uint8_t *restrict src, unsigned src_stride,
+            unsigned size, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++) {
+      memcpy(dst, src, size);
+      dst += dst_stride;
+      src += src_stride;
+   }
+}
+
+/* Convert one value and replicate it into 'count' vertices. */
+static void
+emit_constant(struct translate_generic *tg, unsigned attr, const float *data,
+              uint8_t *dst, unsigned dst_stride, unsigned count)
+{
+   enum pipe_format format = tg->translate.key.element[attr].output_format;
+   uint8_t value[32];
+
+   tg->attrib[attr].emit(data, value);
+   copy_attrib(dst, dst_stride, value, 0,
+               util_format_get_blocksize(format), count);
+}
+
+/**
+ * Fetch attributes of 'count' consecutive vertices.
+ *
+ * Unlike the indexed paths, the source of each attribute simply advances by
+ * its stride (or stays put for instanced ones), so walk one attribute at a
+ * time.  That keeps the per-attribute decisions out of the inner loop and
+ * lets the common same-format copies use fixed-size memcpys the compiler
+ * can turn into plain loads and stores.
+ */
 static void UTIL_CDECL
 generic_run(struct translate *translate,
             unsigned start,
@@ -717,12 +751,65 @@ generic_run(struct translate *translate,
             void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
+   const unsigned out_stride = tg->translate.key.output_stride;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, start + i, start_instance, instance_id, vert, 0);
-      vert += tg->translate.key.output_stride;
+   for (unsigned attr = 0; attr < tg->nr_attrib; attr++) {
+      uint8_t *dst = (uint8_t *)output_buffer + tg->attrib[attr].output_offset;
+      const uint8_t *src;
+      unsigned src_stride;
+      int copy_size = tg->attrib[attr].copy_size;
+      float data[4];
+
+      if (tg->attrib[attr].type == TRANSLATE_ELEMENT_NORMAL) {
+         unsigned index = start;
+         src_stride = tg->attrib[attr].input_stride;
+         if (tg->attrib[attr].instance_divisor) {
+            index = start_instance +
+                    instance_id / tg->attrib[attr].instance_divisor;
+            src_stride = 0;
+         }
+         src = tg->attrib[attr].input_ptr +
+               (ptrdiff_t)tg->attrib[attr].input_stride * index;
+      } else {
+         if (copy_size < 0) {
+            data[0] = (float)instance_id;
+            emit_constant(tg, attr, data, dst, out_stride, count);
+         } else {
+            copy_attrib(dst, out_stride, (const uint8_t *)&instance_id, 0,
+                        4, count);
+         }
+         continue;
+      }
+
+      if (likely(copy_size >= 0)) {
+         switch (copy_size) {
+         case 4:
+            copy_attrib(dst, out_stride, src, src_stride, 4, count);
+            break;
+         case 8:
+            copy_attrib(dst, out_stride, src, src_stride, 8, count);
+            break;
+         case 12:
+            copy_attrib(dst, out_stride, src, src_stride, 12, count);
+            break;
+         case 16:
+            copy_attrib(dst, out_stride, src, src_stride, 16, count);
+            break;
+         default:
+            copy_attrib(dst, out_stride, src, src_stride, copy_size, count);
+            break;
+         }
+      } else if (src_stride == 0) {
+         tg->attrib[attr].fetch(data, src, 1);
+         emit_constant(tg, attr, data, dst, out_stride, count);
+      } else {
+         for (unsigned i = 0; i < count; i++) {
+            tg->attrib[attr].fetch(data, src, 1);
+            tg->attrib[attr].emit(data, dst);
+            dst += out_stride;
+            src += src_stride;
+         }
+      }
    }
 }
 
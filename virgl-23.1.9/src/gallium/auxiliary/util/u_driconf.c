@@ -56,6 +56,7 @@ u_driconf_fill_st_options(struct st_config_options *options,
    query_bool_option(glsl_ignore_write_to_readonly_var);
    query_bool_option(glsl_zero_init);
    query_bool_option(force_integer_tex_nearest);
+   query_bool_option(precompile_state_variants);
    query_bool_option(vs_position_always_invariant);
    query_bool_option(vs_position_always_precise);
    query_bool_option(force_glsl_abs_sqrt);
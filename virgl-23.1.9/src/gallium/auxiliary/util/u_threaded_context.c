@@ -27,6 +27,7 @@
 #include "util/u_threaded_context.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
+#include "util/hash_table.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
 #include "util/u_upload_mgr.h"
@@ -497,7 +498,7 @@ static void
 tc_batch_flush(struct threaded_context *tc, bool full_copy)
 {
    struct tc_batch *next = &tc->batch_slots[tc->next];
-   unsigned next_id = (tc->next + 1) % TC_MAX_BATCHES;
+   unsigned next_id = (tc->next + 1) % tc->num_batches;
 
    tc_assert(next->num_total_slots != 0);
    tc_batch_check(next);
@@ -505,6 +506,17 @@ tc_batch_flush(struct threaded_context *tc, bool full_copy)
    tc->bytes_mapped_estimate = 0;
    p_atomic_add(&tc->num_offloaded_slots, next->num_total_slots);
 
+   /* If the driver thread has already finished the previous batch, it's
+    * waiting for this one, so hand out the next one sooner. If it's still
+    * busy, larger batches make the queueing overhead smaller.
+    */
+   if (util_queue_fence_is_signalled(&tc->batch_slots[tc->last].fence))
+      tc->batch_slot_limit = MAX2(tc->batch_slot_limit / 2,
+                                  TC_MIN_SLOTS_PER_BATCH);
+   else
+      tc->batch_slot_limit = MIN2(tc->batch_slot_limit * 2,
+                                  TC_SLOTS_PER_BATCH);
+
    if (next->token) {
       next->token->tc = NULL;
       tc_unflushed_batch_token_reference(&next->token, NULL);
@@ -541,7 +553,9 @@ tc_add_sized_call(struct threaded_context *tc, enum tc_call_id id,
    assert(num_slots <= TC_SLOTS_PER_BATCH);
    tc_debug_check(tc);
 
-   if (unlikely(next->num_total_slots + num_slots > TC_SLOTS_PER_BATCH)) {
+   /* Calls larger than the limit still fit into an empty batch. */
+   if (unlikely(next->num_total_slots + num_slots > tc->batch_slot_limit &&
+                next->num_total_slots)) {
       /* copy existing renderpass info during flush */
       tc_batch_flush(tc, true);
       next = &tc->batch_slots[tc->next];
@@ -607,7 +621,7 @@ tc_enlarge_last_mergeable_call(struct threaded_context *tc, unsigned desired_num
 
    unsigned added_slots = desired_num_slots - call->num_slots;
 
-   if (unlikely(batch->num_total_slots + added_slots > TC_SLOTS_PER_BATCH))
+   if (unlikely(batch->num_total_slots + added_slots > tc->batch_slot_limit))
       return false;
 
    batch->num_total_slots += added_slots;
@@ -635,6 +649,30 @@ tc_is_sync(struct threaded_context *tc)
           !next->num_total_slots;
 }
 
+static void
+tc_count_sync(struct threaded_context *tc, const char *func)
+{
+   /* __func__ strings are unique per function, so hash the pointers. */
+   struct hash_entry *entry = _mesa_hash_table_search(tc->sync_stats, func);
+
+   if (entry)
+      entry->data = (void *)((uintptr_t)entry->data + 1);
+   else
+      _mesa_hash_table_insert(tc->sync_stats, func, (void *)(uintptr_t)1);
+}
+
+static void
+tc_print_sync_stats(struct threaded_context *tc)
+{
+   mesa_logi("gallium: %u syncs, %u direct and %u offloaded slots",
+             tc->num_syncs, tc->num_direct_slots, tc->num_offloaded_slots);
+
+   hash_table_foreach(tc->sync_stats, entry) {
+      mesa_logi("gallium:   %6u %s", (unsigned)(uintptr_t)entry->data,
+                (const char *)entry->key);
+   }
+}
+
 static void
 _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char *func)
 {
@@ -685,6 +723,9 @@ _tc_sync(struct threaded_context *tc, UNUSED const char *info, UNUSED const char
    if (synced) {
       p_atomic_inc(&tc->num_syncs);
 
+      if (unlikely(tc->sync_stats))
+         tc_count_sync(tc, func);
+
       if (tc_strcmp(func, "tc_destroy") != 0) {
          tc_printf("sync %s %s", func, info);
       }
@@ -4877,6 +4918,11 @@ tc_destroy(struct pipe_context *_pipe)
 
    tc_sync(tc);
 
+   if (tc->sync_stats) {
+      tc_print_sync_stats(tc);
+      _mesa_hash_table_destroy(tc->sync_stats, NULL);
+   }
+
    if (util_queue_is_initialized(&tc->queue)) {
       util_queue_destroy(&tc->queue);
 
@@ -4988,11 +5034,22 @@ threaded_context_create(struct pipe_context *pipe,
 
    tc->use_forced_staging_uploads = true;
 
+   tc->num_batches = CLAMP(debug_get_num_option("GALLIUM_THREAD_QUEUE_DEPTH",
+                                                TC_MAX_BATCHES - 2) + 2,
+                           TC_MIN_BATCHES, TC_MAX_BATCHES);
+   tc->batch_slot_limit = TC_SLOTS_PER_BATCH;
+
+   if (debug_get_bool_option("GALLIUM_THREAD_SYNC_STATS", false)) {
+      tc->sync_stats = _mesa_pointer_hash_table_create(NULL);
+      if (!tc->sync_stats)
+         goto fail;
+   }
+
    /* The queue size is the number of batches "waiting". Batches are removed
     * from the queue before being executed, so keep one tc_batch slot for that
     * execution. Also, keep one unused slot for an unflushed batch.
     */
-   if (!util_queue_init(&tc->queue, "gdrv", TC_MAX_BATCHES - 2, 1, 0, NULL))
+   if (!util_queue_init(&tc->queue, "gdrv", tc->num_batches - 2, 1, 0, NULL))
       goto fail;
 
    for (unsigned i = 0; i < TC_MAX_BATCHES; i++) {
@@ -239,8 +239,12 @@ struct tc_unflushed_batch_token;
  * Use a size as small as possible for low CPU L2 cache usage but large enough
  * so that the queue isn't stalled too often for not having enough idle batch
  * slots.
+ *
+ * GALLIUM_THREAD_QUEUE_DEPTH can lower the number of batches in use, down to
+ * TC_MIN_BATCHES.
  */
 #define TC_MAX_BATCHES        10
+#define TC_MIN_BATCHES        3
 
 /* The size of one batch. Non-trivial calls (i.e. not setting a CSO pointer)
  * can occupy multiple call slots.
@@ -250,6 +254,12 @@ struct tc_unflushed_batch_token;
  */
 #define TC_SLOTS_PER_BATCH    1536
 
+/* Batches are flushed early, down to this size, while the driver thread is
+ * keeping up with the application thread, so that it gets work sooner.
+ * They grow back to TC_SLOTS_PER_BATCH when it falls behind.
+ */
+#define TC_MIN_SLOTS_PER_BATCH (TC_SLOTS_PER_BATCH / 8)
+
 /* The buffer list queue is much deeper than the batch queue because buffer
  * lists need to stay around until the driver internally flushes its command
  * buffer.
@@ -560,6 +570,9 @@ struct threaded_context {
    unsigned num_direct_slots;
    unsigned num_syncs;
 
+   /* Number of syncs per calling function, with GALLIUM_THREAD_SYNC_STATS. */
+   struct hash_table *sync_stats;
+
    bool use_forced_staging_uploads;
    bool add_all_gfx_bindings_to_buffer_list;
    bool add_all_compute_bindings_to_buffer_list;
@@ -608,6 +621,11 @@ struct threaded_context {
 
    unsigned last, next, next_buf_list;
 
+   /* The number of batch slots in use, at most TC_MAX_BATCHES. */
+   unsigned num_batches;
+   /* The current batch is flushed once it has this many slots. */
+   unsigned batch_slot_limit;
+
    /* The list fences that the driver should signal after the next flush.
     * If this is empty, all driver command buffers have been flushed.
     */
@@ -55,6 +55,12 @@ struct u_upload_mgr {
    unsigned offset; /* Aligned offset to the upload buffer, pointing
                      * at the first unused byte. */
    int buffer_private_refcount;
+
+   /* Exhausted buffers of the default size waiting to be reused. */
+   u_upload_is_busy_func is_busy;
+   unsigned max_recycled;
+   unsigned num_recycled;
+   struct pipe_resource *recycled[U_UPLOAD_MAX_RECYCLED];
 };
 
 
@@ -121,6 +127,15 @@ u_upload_disable_persistent(struct u_upload_mgr *upload)
    upload->map_flags |= PIPE_MAP_FLUSH_EXPLICIT;
 }
 
+void
+u_upload_enable_recycling(struct u_upload_mgr *upload, unsigned num_buffers,
+                          u_upload_is_busy_func is_busy)
+{
+   assert(num_buffers <= U_UPLOAD_MAX_RECYCLED);
+   upload->max_recycled = MIN2(num_buffers, U_UPLOAD_MAX_RECYCLED);
+   upload->is_busy = is_busy;
+}
+
 static void
 upload_unmap_internal(struct u_upload_mgr *upload, boolean destroying)
 {
@@ -161,6 +176,16 @@ u_upload_release_buffer(struct u_upload_mgr *upload)
                    -upload->buffer_private_refcount);
       upload->buffer_private_refcount = 0;
    }
+
+   /* Keep buffers of the default size for reuse, handing over our reference.
+    * Larger ones are rare and would just waste memory.
+    */
+   if (upload->buffer && upload->num_recycled < upload->max_recycled &&
+       upload->buffer_size == align(upload->default_size, 4096)) {
+      upload->recycled[upload->num_recycled++] = upload->buffer;
+      upload->buffer = NULL;
+   }
+
    pipe_resource_reference(&upload->buffer, NULL);
    upload->buffer_size = 0;
 }
@@ -170,9 +195,32 @@ void
 u_upload_destroy(struct u_upload_mgr *upload)
 {
    u_upload_release_buffer(upload);
+   for (unsigned i = 0; i < upload->num_recycled; i++)
+      pipe_resource_reference(&upload->recycled[i], NULL);
    FREE(upload);
 }
 
+
+/* Take an exhausted buffer that can be written again without synchronizing.
+ * Buffers still referenced from elsewhere can't be reused: they may be bound
+ * and read by later draws.  Only this thread could hand out new references,
+ * so a count of 1 can't go up behind our back.
+ */
+static struct pipe_resource *
+u_upload_take_recycled_buffer(struct u_upload_mgr *upload)
+{
+   for (unsigned i = 0; i < upload->num_recycled; i++) {
+      struct pipe_resource *buffer = upload->recycled[i];
+
+      if (p_atomic_read(&buffer->reference.count) == 1 &&
+          !upload->is_busy(upload->pipe, buffer)) {
+         upload->recycled[i] = upload->recycled[--upload->num_recycled];
+         return buffer;
+      }
+   }
+   return NULL;
+}
+
 /* Return the allocated buffer size or 0 if it failed. */
 static unsigned
 u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
@@ -189,6 +237,11 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
     */
    size = align(MAX2(upload->default_size, min_size), 4096);
 
+   if (upload->num_recycled && size == align(upload->default_size, 4096))
+      upload->buffer = u_upload_take_recycled_buffer(upload);
+   if (upload->buffer)
+      goto init_buffer;
+
    memset(&buffer, 0, sizeof buffer);
    buffer.target = PIPE_BUFFER;
    buffer.format = PIPE_FORMAT_R8_UNORM; /* want TYPELESS or similar */
@@ -209,6 +262,7 @@ u_upload_alloc_buffer(struct u_upload_mgr *upload, unsigned min_size)
    if (upload->buffer == NULL)
       return 0;
 
+init_buffer:
    /* Since atomic operations are very very slow when 2 threads are not
     * sharing the same L3 cache (which happens on AMD Zen), eliminate all
     * atomics in u_upload_alloc as follows:
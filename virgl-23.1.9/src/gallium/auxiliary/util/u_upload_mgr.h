@@ -73,6 +73,23 @@ u_upload_clone(struct pipe_context *pipe, struct u_upload_mgr *upload);
 void
 u_upload_disable_persistent(struct u_upload_mgr *upload);
 
+#define U_UPLOAD_MAX_RECYCLED 8
+
+typedef bool (*u_upload_is_busy_func)(struct pipe_context *pipe,
+                                      struct pipe_resource *buffer);
+
+/**
+ * Keep up to num_buffers exhausted upload buffers around and reuse them once
+ * nothing references them anymore and is_busy reports them idle, instead of
+ * creating new ones.  Clones don't inherit this.
+ *
+ * \param num_buffers      At most U_UPLOAD_MAX_RECYCLED.
+ * \param is_busy          Whether the GPU may still be using the buffer.
+ */
+void
+u_upload_enable_recycling(struct u_upload_mgr *upload, unsigned num_buffers,
+                          u_upload_is_busy_func is_busy);
+
 /**
  * Destroy the upload manager.
  */
@@ -140,6 +140,7 @@ static void
 fd6_texture_barrier(struct pipe_context *pctx, unsigned flags)
    in_dt
 {
+   struct fd_context *ctx = fd_context(pctx);
    unsigned flushes = 0;
 
    if (flags & PIPE_TEXTURE_BARRIER_SAMPLER) {
@@ -156,8 +157,13 @@ fd6_texture_barrier(struct pipe_context *pctx, unsigned flags)
        * as a texture after the barrier without a lot of extra book-
        * keeping.  So hopefully no one calls glTextureBarrierNV() just
        * for lolz.
+       *
+       * Only the current batch can have rendered to something that is
+       * sampled after the barrier without that being tracked as a
+       * dependency already, so other batches don't need to be flushed.
        */
-      pctx->flush(pctx, NULL, 0);
+      if (ctx->batch)
+         fd_batch_flush(ctx->batch);
       return;
    }
 
@@ -40,6 +40,7 @@
 #include "fd6_draw.h"
 #include "fd6_emit.h"
 #include "fd6_program.h"
+#include "fd6_query.h"
 #include "fd6_vsc.h"
 #include "fd6_zsa.h"
 
@@ -349,6 +350,9 @@ fd6_draw_vbos(struct fd_context *ctx, const struct pipe_draw_info *info,
    if (ctx->batch->barrier)
       fd6_barrier_flush(ctx->batch);
 
+   if (unlikely(ctx->cond_gpu))
+      fd6_emit_render_condition(ctx, ring, true);
+
    /* for debug after a lock up, write a unique counter value
     * to scratch7 for each draw, to make it easier to match up
     * register dumps to cmdstream.  The combination of IB
@@ -413,6 +417,12 @@ fd6_draw_vbos(struct fd_context *ctx, const struct pipe_draw_info *info,
    emit_marker6(ring, 7);
    fd_reset_wfi(ctx->batch);
 
+   /* Don't leave predication enabled for blits and clears emitted into the
+    * same ring, those still check the condition on the CPU:
+    */
+   if (unlikely(ctx->cond_gpu))
+      fd6_emit_render_condition(ctx, ring, false);
+
    flush_streamout(ctx, &emit);
 
    fd_context_all_clean(ctx);
@@ -765,6 +765,57 @@ error:
    return NULL;
 }
 
+/*
+ * Conditional rendering:
+ *
+ * Occlusion results can be tested by CP_DRAW_PRED_SET directly, so draws
+ * are skipped by the GPU rather than stalling on the result on the CPU.
+ */
+
+static bool
+fd6_render_condition(struct fd_context *ctx, struct fd_query *q) assert_dt
+{
+   switch (q->type) {
+   case PIPE_QUERY_OCCLUSION_COUNTER:
+   case PIPE_QUERY_OCCLUSION_PREDICATE:
+   case PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE:
+      break;
+   default:
+      return false;
+   }
+
+   struct fd_acc_query *aq = fd_acc_query(q);
+
+   if (!aq->prsc)
+      return false;
+
+   /* The accumulated result is only final after the last tile of the
+    * batches that wrote it, so they have to be submitted ahead of the
+    * predicated draws.  Unlike the CPU check, nothing waits for them:
+    */
+   fd_bc_flush_writer(ctx, fd_resource(aq->prsc));
+
+   return true;
+}
+
+void
+fd6_emit_render_condition(struct fd_context *ctx, struct fd_ringbuffer *ring,
+                          bool enable)
+{
+   OUT_PKT7(ring, CP_DRAW_PRED_ENABLE_GLOBAL, 1);
+   OUT_RING(ring, enable);
+
+   if (!enable)
+      return;
+
+   struct fd_acc_query *aq = fd_acc_query(fd_query(ctx->cond_query));
+
+   OUT_PKT7(ring, CP_DRAW_PRED_SET, 3);
+   OUT_RING(ring, CP_DRAW_PRED_SET_0_SRC(PRED_SRC_MEM) |
+                  CP_DRAW_PRED_SET_0_TEST(ctx->cond_cond ? EQ_0_PASS : NE_0_PASS));
+   OUT_RELOC(ring, query_sample(aq, result));
+}
+
 void
 fd6_query_context_init(struct pipe_context *pctx) disable_thread_safety_analysis
 {
@@ -772,6 +823,7 @@ fd6_query_context_init(struct pipe_context *pctx) disable_thread_safety_analysis
 
    ctx->create_query = fd_acc_create_query;
    ctx->query_update_batch = fd_acc_query_update_batch;
+   ctx->render_condition = fd6_render_condition;
 
    ctx->record_timestamp = record_timestamp;
    ctx->ts_to_ns = ticks_to_ns;
@@ -30,7 +30,14 @@
 
 #include "pipe/p_context.h"
 
+struct fd_context;
+struct fd_ringbuffer;
+
 EXTERNC
 void fd6_query_context_init(struct pipe_context *pctx);
 
+EXTERNC
+void fd6_emit_render_condition(struct fd_context *ctx,
+                               struct fd_ringbuffer *ring, bool enable);
+
 #endif /* FD6_QUERY_H_ */
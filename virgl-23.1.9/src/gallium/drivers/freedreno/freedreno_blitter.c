@@ -145,8 +145,12 @@ fd_blitter_blit(struct fd_context *ctx, const struct pipe_blit_info *info)
       ctx->validate_format(ctx, fd_resource(src), info->src.format);
    }
 
+   /* Sampling from the resource being rendered to only sees what has been
+    * resolved to memory, so pending writes to it need to land first.  But
+    * batches for unrelated framebuffers can stay queued:
+    */
    if (src == dst)
-      pipe->flush(pipe, NULL, 0);
+      fd_bc_flush_writer(ctx, fd_resource(src));
 
    DBG_BLIT(info, NULL);
 
@@ -327,10 +331,8 @@ fd_blitter_pipe_copy_region(struct fd_context *ctx, struct pipe_resource *dst,
    if (!util_blitter_is_copy_supported(ctx->blitter, dst, src))
       return false;
 
-   if (src == dst) {
-      struct pipe_context *pctx = &ctx->base;
-      pctx->flush(pctx, NULL, 0);
-   }
+   if (src == dst)
+      fd_bc_flush_writer(ctx, fd_resource(src));
 
    /* TODO we could invalidate if dst box covers dst level fully. */
    fd_blitter_pipe_begin(ctx, false);
@@ -438,6 +438,7 @@ struct fd_context {
    struct pipe_query *cond_query dt;
    bool cond_cond dt; /* inverted rendering condition */
    uint cond_mode dt;
+   bool cond_gpu dt; /* draws are predicated on cond_query by the GPU */
 
    /* Private memory is a memory space where each fiber gets its own piece of
     * memory, in addition to registers. It is backed by a buffer which needs
@@ -520,6 +521,10 @@ struct fd_context {
    void (*query_prepare_tile)(struct fd_batch *batch, uint32_t n,
                               struct fd_ringbuffer *ring) dt;
    void (*query_update_batch)(struct fd_batch *batch, bool disable_all) dt;
+   /* optional, returns true if draws can be predicated on the result of
+    * the query by the GPU, so that they don't need a CPU side check:
+    */
+   bool (*render_condition)(struct fd_context *ctx, struct fd_query *q) dt;
 
    /* blitter: */
    bool (*blit)(struct fd_context *ctx, const struct pipe_blit_info *info) dt;
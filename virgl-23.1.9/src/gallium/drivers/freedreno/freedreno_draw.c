@@ -323,7 +323,7 @@ fd_draw_vbo(struct pipe_context *pctx, const struct pipe_draw_info *info,
    }
 
    /* TODO: push down the region versions into the tiles */
-   if (!fd_render_condition_check(pctx))
+   if (!ctx->cond_gpu && !fd_render_condition_check(pctx))
       return;
 
    /* Upload a user index buffer. */
@@ -118,6 +118,8 @@ fd_render_condition(struct pipe_context *pctx, struct pipe_query *pq,
    ctx->cond_query = pq;
    ctx->cond_cond = condition;
    ctx->cond_mode = mode;
+   ctx->cond_gpu = pq && ctx->render_condition &&
+                   ctx->render_condition(ctx, fd_query(pq));
 }
 
 #define _Q(_name, _query_type, _type, _result_type) {                          \
@@ -1355,6 +1355,17 @@ lp_rast_destroy(struct lp_rasterizer *rast)
 }
 
 
+/**
+ * Whether all scenes queued so far have been rasterized.
+ * Must be called with the screen's rast_mutex held.
+ */
+boolean
+lp_rast_is_idle(struct lp_rasterizer *rast)
+{
+   return !rast->last_fence || lp_fence_signalled(rast->last_fence);
+}
+
+
 void
 lp_rast_fence(struct lp_rasterizer *rast,
               struct lp_fence **fence)
@@ -63,6 +63,12 @@ struct lp_rast_state;
  */
 #define LP_SCENE_MAX_SIZE (36*1024*1024)
 
+/* Once a scene has grown past this size, setup hands it to the rasterizer
+ * threads early if they are idle, so that binning the rest of the frame
+ * overlaps with rasterization instead of preceding it:
+ */
+#define LP_SCENE_EARLY_FLUSH_SIZE (4*1024*1024)
+
 /* The maximum amount of texture storage referenced by a scene is
  * clamped to this size:
  */
@@ -846,16 +846,15 @@ void
 lp_setup_set_linear_mode(struct lp_setup_context *setup,
                          boolean mode)
 {
-   /* The linear rasterizer requires sse2 both at compile and runtime,
-    * in particular for the code in lp_rast_linear_fallback.c.  This
-    * is more than ten-year-old technology, so it's a reasonable
-    * baseline.
+   /* On x86 the linear rasterizer's fastpaths use sse2, so it must be
+    * available at runtime too.  Elsewhere they fall back to plain C, and
+    * the spanline path in lp_linear.c is simply not used.
     */
 #if DETECT_ARCH_SSE
    setup->permit_linear_rasterizer = (mode &&
                                       util_get_cpu_caps()->has_sse2);
 #else
-   setup->permit_linear_rasterizer = FALSE;
+   setup->permit_linear_rasterizer = mode;
 #endif
 }
 
@@ -1742,6 +1741,35 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 }
 
 
+/**
+ * Setup of large scenes would otherwise leave the rasterizer threads
+ * waiting until the whole frame is binned.  Once the current scene is big
+ * enough to be worth the extra tile loads, send it off if the threads have
+ * nothing else to do, and keep binning into a fresh scene.
+ */
+void
+lp_setup_flush_if_idle(struct lp_setup_context *setup)
+{
+   struct lp_scene *scene = setup->scene;
+
+   if (setup->state != SETUP_ACTIVE || !setup->num_threads ||
+       scene->scene_size < LP_SCENE_EARLY_FLUSH_SIZE)
+      return;
+
+   struct llvmpipe_screen *screen = llvmpipe_screen(scene->pipe->screen);
+
+   mtx_lock(&screen->rast_mutex);
+   boolean idle = lp_rast_is_idle(screen->rast);
+   mtx_unlock(&screen->rast_mutex);
+
+   if (idle) {
+      LP_DBG(DEBUG_SETUP, "%s: flushing %u byte scene early\n", __func__,
+             scene->scene_size);
+      lp_setup_flush_and_restart(setup);
+   }
+}
+
+
 void
 lp_setup_add_scissor_planes(const struct u_rect *scissor,
                             struct lp_rast_plane *plane_s,
@@ -242,6 +242,9 @@ lp_setup_destroy(struct lp_setup_context *setup);
 boolean
 lp_setup_flush_and_restart(struct lp_setup_context *setup);
 
+void
+lp_setup_flush_if_idle(struct lp_setup_context *setup);
+
 boolean
 lp_setup_whole_tile(struct lp_setup_context *setup,
                     const struct lp_rast_shader_inputs *inputs,
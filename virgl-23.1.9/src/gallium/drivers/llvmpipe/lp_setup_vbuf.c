@@ -370,6 +370,8 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
    default:
       assert(0);
    }
+
+   lp_setup_flush_if_idle(setup);
 }
 
 
@@ -632,6 +634,8 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
    default:
       assert(0);
    }
+
+   lp_setup_flush_if_idle(setup);
 }
 
 
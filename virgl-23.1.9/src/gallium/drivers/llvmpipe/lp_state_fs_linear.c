@@ -41,9 +41,13 @@
 #include "lp_linear_priv.h"
 
 
-#if DETECT_ARCH_SSE
+/* The fastpaths below are plain C apart from a couple of SSE2 inner loops,
+ * which have scalar equivalents for other architectures.
+ */
 
+#if DETECT_ARCH_SSE
 #include <emmintrin.h>
+#endif
 
 
 struct nearest_sampler {
@@ -63,15 +67,6 @@ struct nearest_sampler {
 };
 
 
-struct linear_interp {
-   alignas(16) uint32_t out[64];
-   __m128i a0;
-   __m128i dadx;
-   __m128i dady;
-   int width;                   /* rounded up to multiple of 4 */
-   boolean is_constant;
-};
-
 /* Organize all the information needed for blending in one place.
  * Could have blend function pointer here, but we currently always
  * know which one we want to call.
@@ -91,7 +86,6 @@ struct shader {
    alignas(16) uint32_t out0[64];
    const uint32_t *src0;
    const uint32_t *src1;
-   __m128i const0;
    int width;                   /* rounded up to multiple of 4 */
 };
 
@@ -106,6 +100,7 @@ struct shader {
  * already been performed.  This routine then purely implements
  * blending.
  */
+#if DETECT_ARCH_SSE
 static void
 blend_premul(struct color_blend *blend)
 {
@@ -136,6 +131,38 @@ blend_premul(struct color_blend *blend)
          dst[i] = dstreg.ui[i&3];
    }
 }
+#else
+/* Scalar version of util_sse2_blend_premul_4(), with the same rounding:
+ * dst = src + dst - ((dst * src_alpha) >> 8), saturated.
+ */
+static inline uint32_t
+blend_premul_pixel(uint32_t src, uint32_t dst)
+{
+   const uint32_t a = src >> 24;
+   uint32_t res = 0;
+
+   for (unsigned shift = 0; shift < 32; shift += 8) {
+      const uint32_t d = (dst >> shift) & 0xff;
+      const uint32_t c = ((src >> shift) & 0xff) + d - ((d * a) >> 8);
+      res |= MIN2(c, 0xff) << shift;
+   }
+
+   return res;
+}
+
+static void
+blend_premul(struct color_blend *blend)
+{
+   const uint32_t *src = blend->src;
+   uint32_t *dst = (uint32_t *)blend->color;
+   const int width = blend->width;
+
+   blend->color += blend->stride;
+
+   for (int i = 0; i < width; i++)
+      dst[i] = blend_premul_pixel(src[i], dst[i]);
+}
+#endif
 
 
 static void
@@ -324,16 +351,23 @@ init_nearest_sampler(struct nearest_sampler *samp,
 static const uint32_t *
 shade_rgb1(struct shader *shader)
 {
-   const __m128i rgb1 = _mm_set1_epi32(0xff000000);
    const uint32_t *src0 = shader->src0;
    uint32_t *dst = shader->out0;
    int width = shader->width;
    int i;
 
+#if DETECT_ARCH_SSE
+   const __m128i rgb1 = _mm_set1_epi32(0xff000000);
+
    for (i = 0; i + 3 < width; i += 4) {
       __m128i s = *(const __m128i *)&src0[i];
       *(__m128i *)&dst[i] = _mm_or_si128(s, rgb1);
    }
+#else
+   /* width is a multiple of 4, and the sampler pads its rows to match. */
+   for (i = 0; i < width; i++)
+      dst[i] = src0[i] | 0xff000000;
+#endif
 
    return shader->out0;
 }
@@ -670,7 +704,7 @@ llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant)
          variant->jit_linear_blit = blit_rgba_blit;
          variant->jit_linear = blit_rgba;
       } else if (is_one_inv_src_alpha_blend(variant) &&
-                 util_get_cpu_caps()->has_sse2) {
+                 (!DETECT_ARCH_SSE || util_get_cpu_caps()->has_sse2)) {
          variant->jit_linear = blit_rgba_blend_premul;
       }
       return;
@@ -691,11 +725,4 @@ llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant)
       return;
    }
 }
-#else
-void
-llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant)
-{
-   /* don't bother if there is no SSE */
-}
-#endif
 
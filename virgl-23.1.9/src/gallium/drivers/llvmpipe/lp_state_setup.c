@@ -29,6 +29,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
 #include "gallivm/lp_bld_const.h"
@@ -627,6 +628,23 @@ init_args(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Setup variants only depend on the key, so that's all the cache key has
+ * to cover.  The screen's cache id already accounts for the LLVM version
+ * and CPU features.
+ */
+static void
+lp_setup_get_ir_cache_key(const struct lp_setup_variant_key *key,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   struct mesa_sha1 ctx;
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, "setup", 5);
+   _mesa_sha1_update(&ctx, key, key->size);
+   _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+}
+
+
 /**
  * Generate the runtime callable function for the coefficient calculation.
  *
@@ -650,8 +668,18 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    snprintf(func_name, sizeof(func_name), "setup_variant_%u",
             variant->no);
 
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_cached_code cached = { 0 };
+   unsigned char ir_sha1_cache_key[20];
+   bool needs_caching = false;
+
+   lp_setup_get_ir_cache_key(key, ir_sha1_cache_key);
+   lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+   if (!cached.data_size)
+      needs_caching = true;
+
    struct gallivm_state *gallivm;
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context, NULL);
+   variant->gallivm = gallivm = gallivm_create(func_name, lp->context, &cached);
    if (!variant->gallivm) {
       goto fail;
    }
@@ -735,6 +763,10 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching) {
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+   }
+
    gallivm_free_ir(variant->gallivm);
 
    /*
@@ -83,6 +83,14 @@ fake_resource_map(struct virgl_winsys *vws, struct virgl_hw_res *hw_res)
    return hw_res->data;
 }
 
+static bool fake_busy;
+
+static boolean
+fake_resource_is_busy(struct virgl_winsys *vws, struct virgl_hw_res *hw_res)
+{
+   return fake_busy;
+}
+
 static struct pipe_context *
 fake_virgl_context_create()
 {
@@ -96,6 +104,9 @@ fake_virgl_context_create()
    vs->vws->resource_create = fake_resource_create;
    vs->vws->resource_reference = fake_resource_reference;
    vs->vws->resource_map = fake_resource_map;
+   vs->vws->resource_is_busy = fake_resource_is_busy;
+
+   fake_busy = false;
 
    return &vctx->base;
 }
@@ -391,3 +402,84 @@ TEST_F(VirglStagingMgr, uses_staging_buffer_resource)
 
    release_resources(&out_resource, 1);
 }
+
+TEST_F(VirglStagingMgr, reuses_idle_buffer_after_flush)
+{
+   struct virgl_hw_res *out_resource[VIRGL_STAGING_RING_SIZE + 1] = {0};
+   unsigned out_offset;
+   void *map_ptr;
+   bool alloc_succeeded;
+
+   for (unsigned i = 0; i < VIRGL_STAGING_RING_SIZE; ++i) {
+      alloc_succeeded =
+         virgl_staging_alloc(&staging, staging_size, 1, &out_offset,
+                             &out_resource[i], &map_ptr);
+      EXPECT_TRUE(alloc_succeeded);
+      ASSERT_NE(out_resource[i], nullptr);
+   }
+
+   virgl_staging_flush(&staging);
+
+   alloc_succeeded =
+      virgl_staging_alloc(&staging, 128, 1, &out_offset,
+                          &out_resource[VIRGL_STAGING_RING_SIZE], &map_ptr);
+
+   EXPECT_TRUE(alloc_succeeded);
+   EXPECT_EQ(out_offset, 0);
+   /* Wrapped around to the oldest buffer. */
+   EXPECT_EQ(out_resource[VIRGL_STAGING_RING_SIZE], out_resource[0]);
+   EXPECT_EQ(map_ptr, resource_map(out_resource[0]));
+
+   release_resources(out_resource, VIRGL_STAGING_RING_SIZE + 1);
+}
+
+TEST_F(VirglStagingMgr, does_not_reuse_unflushed_buffer)
+{
+   struct virgl_hw_res *out_resource[VIRGL_STAGING_RING_SIZE + 1] = {0};
+   unsigned out_offset;
+   void *map_ptr;
+   bool alloc_succeeded;
+
+   for (unsigned i = 0; i < VIRGL_STAGING_RING_SIZE + 1; ++i) {
+      alloc_succeeded =
+         virgl_staging_alloc(&staging, staging_size, 1, &out_offset,
+                             &out_resource[i], &map_ptr);
+      EXPECT_TRUE(alloc_succeeded);
+      ASSERT_NE(out_resource[i], nullptr);
+   }
+
+   EXPECT_NE(out_resource[VIRGL_STAGING_RING_SIZE], out_resource[0]);
+
+   release_resources(out_resource, VIRGL_STAGING_RING_SIZE + 1);
+}
+
+TEST_F(VirglStagingMgr, replaces_busy_buffer_with_larger_one)
+{
+   struct virgl_hw_res *out_resource[VIRGL_STAGING_RING_SIZE + 1] = {0};
+   unsigned out_offset;
+   void *map_ptr;
+   bool alloc_succeeded;
+
+   for (unsigned i = 0; i < VIRGL_STAGING_RING_SIZE; ++i) {
+      alloc_succeeded =
+         virgl_staging_alloc(&staging, staging_size, 1, &out_offset,
+                             &out_resource[i], &map_ptr);
+      EXPECT_TRUE(alloc_succeeded);
+      ASSERT_NE(out_resource[i], nullptr);
+   }
+
+   virgl_staging_flush(&staging);
+   fake_busy = true;
+
+   alloc_succeeded =
+      virgl_staging_alloc(&staging, 128, 1, &out_offset,
+                          &out_resource[VIRGL_STAGING_RING_SIZE], &map_ptr);
+
+   EXPECT_TRUE(alloc_succeeded);
+   EXPECT_EQ(out_offset, 0);
+   EXPECT_NE(out_resource[VIRGL_STAGING_RING_SIZE], out_resource[0]);
+   EXPECT_GT(out_resource[VIRGL_STAGING_RING_SIZE]->size,
+             out_resource[0]->size);
+
+   release_resources(out_resource, VIRGL_STAGING_RING_SIZE + 1);
+}
@@ -25,6 +25,7 @@
 #include "pipe/p_shader_tokens.h"
 
 #include "compiler/nir/nir.h"
+#include "compiler/nir/nir_serialize.h"
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
@@ -41,6 +42,10 @@
 #include "util/slab.h"
 #include "util/u_upload_mgr.h"
 #include "util/u_blitter.h"
+#include "util/blob.h"
+#include "util/mesa-sha1.h"
+#include "util/perf/cpu_trace.h"
+#include "tgsi/tgsi_dump.h"
 #include "tgsi/tgsi_text.h"
 
 #include "virgl_encode.h"
@@ -170,6 +175,18 @@ virgl_rebind_resource(struct virgl_context *vctx,
    }
 }
 
+static void virgl_surface_dirty(struct pipe_surface *surf)
+{
+   struct virgl_resource *res = virgl_resource(surf->texture);
+
+   if (res->b.target == PIPE_BUFFER)
+      virgl_resource_dirty(res, 0);
+   else
+      virgl_resource_dirty_range(res, surf->u.tex.level,
+                                 surf->u.tex.first_layer,
+                                 surf->u.tex.last_layer + 1);
+}
+
 static void virgl_attach_res_framebuffer(struct virgl_context *vctx)
 {
    struct virgl_winsys *vws = virgl_screen(vctx->base.screen)->vws;
@@ -182,7 +199,7 @@ static void virgl_attach_res_framebuffer(struct virgl_context *vctx)
       res = virgl_resource(surf->texture);
       if (res) {
          vws->emit_res(vws, vctx->cbuf, res->hw_res, FALSE);
-         virgl_resource_dirty(res, surf->u.tex.level);
+         virgl_surface_dirty(surf);
       }
    }
    for (i = 0; i < vctx->framebuffer.nr_cbufs; i++) {
@@ -191,7 +208,7 @@ static void virgl_attach_res_framebuffer(struct virgl_context *vctx)
          res = virgl_resource(surf->texture);
          if (res) {
             vws->emit_res(vws, vctx->cbuf, res->hw_res, FALSE);
-            virgl_resource_dirty(res, surf->u.tex.level);
+            virgl_surface_dirty(surf);
          }
       }
    }
@@ -203,9 +220,11 @@ static void virgl_attach_res_sampler_views(struct virgl_context *vctx,
    struct virgl_winsys *vws = virgl_screen(vctx->base.screen)->vws;
    const struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader_type];
+   unsigned i;
 
-   for (int i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; ++i) {
-      if (binding->views[i] && binding->views[i]->texture) {
+   BITSET_FOREACH_SET(i, binding->view_enabled_mask,
+                      PIPE_MAX_SHADER_SAMPLER_VIEWS) {
+      if (binding->views[i]->texture) {
          struct virgl_resource *res = virgl_resource(binding->views[i]->texture);
          vws->emit_res(vws, vctx->cbuf, res->hw_res, FALSE);
       }
@@ -416,7 +435,13 @@ static void virgl_bind_blend_state(struct pipe_context *ctx,
 {
    struct virgl_context *vctx = virgl_context(ctx);
    uint32_t handle = (unsigned long)blend_state;
+
+   if (vctx->emitted.blend_valid && vctx->emitted.blend == handle)
+      return;
+
    virgl_encode_bind_object(vctx, handle, VIRGL_OBJECT_BLEND);
+   vctx->emitted.blend = handle;
+   vctx->emitted.blend_valid = true;
 }
 
 static void virgl_delete_blend_state(struct pipe_context *ctx,
@@ -443,7 +468,13 @@ static void virgl_bind_depth_stencil_alpha_state(struct pipe_context *ctx,
 {
    struct virgl_context *vctx = virgl_context(ctx);
    uint32_t handle = (unsigned long)blend_state;
+
+   if (vctx->emitted.dsa_valid && vctx->emitted.dsa == handle)
+      return;
+
    virgl_encode_bind_object(vctx, handle, VIRGL_OBJECT_DSA);
+   vctx->emitted.dsa = handle;
+   vctx->emitted.dsa_valid = true;
 }
 
 static void virgl_delete_depth_stencil_alpha_state(struct pipe_context *ctx,
@@ -482,7 +513,13 @@ static void virgl_bind_rasterizer_state(struct pipe_context *ctx,
       vctx->rs_state = *vrs;
       handle = vrs->handle;
    }
+
+   if (vctx->emitted.rasterizer_valid && vctx->emitted.rasterizer == handle)
+      return;
+
    virgl_encode_bind_object(vctx, handle, VIRGL_OBJECT_RASTERIZER);
+   vctx->emitted.rasterizer = handle;
+   vctx->emitted.rasterizer_valid = true;
 }
 
 static void virgl_delete_rasterizer_state(struct pipe_context *ctx,
@@ -635,6 +672,49 @@ static void virgl_hw_set_index_buffer(struct virgl_context *vctx,
    virgl_attach_res_index_buffer(vctx, ib);
 }
 
+static bool
+virgl_user_constants_emitted(const struct virgl_emitted_stage_state *emitted,
+                             unsigned index,
+                             const struct pipe_constant_buffer *buf)
+{
+   const uint32_t size = (buf->buffer_size / 4) * 4;
+
+   return (emitted->user_const_mask & (1 << index)) &&
+          emitted->user_const_sizes[index] == size &&
+          (!size ||
+           (buf->user_buffer &&
+            !memcmp(emitted->user_consts[index], buf->user_buffer, size)));
+}
+
+static void
+virgl_user_constants_remember(struct virgl_emitted_stage_state *emitted,
+                              unsigned index,
+                              const struct pipe_constant_buffer *buf)
+{
+   const uint32_t size = (buf->buffer_size / 4) * 4;
+
+   emitted->ubo_mask &= ~(1 << index);
+   emitted->user_const_mask &= ~(1 << index);
+
+   /* Without data the host only sees the size, that can't be compared. */
+   if (size && !buf->user_buffer)
+      return;
+
+   if (emitted->user_const_sizes[index] != size) {
+      void *data = REALLOC(emitted->user_consts[index],
+                           emitted->user_const_sizes[index], size);
+      if (size && !data)
+         return;
+
+      emitted->user_consts[index] = size ? data : NULL;
+      emitted->user_const_sizes[index] = size;
+   }
+
+   if (size)
+      memcpy(emitted->user_consts[index], buf->user_buffer, size);
+   emitted->user_const_mask |= 1 << index;
+}
+
 static void virgl_set_constant_buffer(struct pipe_context *ctx,
                                      enum pipe_shader_type shader, uint index,
                                       bool take_ownership,
@@ -643,14 +723,22 @@ static void virgl_set_constant_buffer(struct pipe_context *ctx,
    struct virgl_context *vctx = virgl_context(ctx);
    struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader];
+   struct virgl_emitted_stage_state *emitted = &vctx->emitted.stages[shader];
 
    if (buf && buf->buffer) {
       struct virgl_resource *res = virgl_resource(buf->buffer);
       res->bind_history |= PIPE_BIND_CONSTANT_BUFFER;
 
-      virgl_encoder_set_uniform_buffer(vctx, shader, index,
-                                       buf->buffer_offset,
-                                       buf->buffer_size, res);
+      if (!(emitted->ubo_mask & (1 << index)) ||
+          binding->ubos[index].buffer != buf->buffer ||
+          binding->ubos[index].buffer_offset != buf->buffer_offset ||
+          binding->ubos[index].buffer_size != buf->buffer_size) {
+         virgl_encoder_set_uniform_buffer(vctx, shader, index,
+                                          buf->buffer_offset,
+                                          buf->buffer_size, res);
+         emitted->ubo_mask |= 1 << index;
+         emitted->user_const_mask &= ~(1 << index);
+      }
 
       if (take_ownership) {
          pipe_resource_reference(&binding->ubos[index].buffer, NULL);
@@ -664,9 +752,13 @@ static void virgl_set_constant_buffer(struct pipe_context *ctx,
       static const struct pipe_constant_buffer dummy_ubo;
       if (!buf)
          buf = &dummy_ubo;
-      virgl_encoder_write_constant_buffer(vctx, shader, index,
-                                          buf->buffer_size / 4,
-                                          buf->user_buffer);
+
+      if (!virgl_user_constants_emitted(emitted, index, buf)) {
+         virgl_encoder_write_constant_buffer(vctx, shader, index,
+                                             buf->buffer_size / 4,
+                                             buf->user_buffer);
+         virgl_user_constants_remember(emitted, index, buf);
+      }
 
       pipe_resource_reference(&binding->ubos[index].buffer, NULL);
       binding->ubo_enabled_mask &= ~(1 << index);
@@ -698,78 +790,161 @@ lower_gles_arrayshadow_offset_filter(const nir_instr *instr,
    return false;
 }
 
+/* Hashes the shader IR handed to us by the state tracker.  Everything else
+ * the translation depends on is fixed per screen, and the host caps are part
+ * of the disk cache's identity already.
+ */
+static void virgl_shader_cache_key(enum pipe_shader_type type,
+                                   enum pipe_shader_ir ir_type,
+                                   const void *ir, uint8_t key[20])
+{
+   static const char tag[] = "virgl-tgsi";
+   struct mesa_sha1 sha1_ctx;
+
+   _mesa_sha1_init(&sha1_ctx);
+   _mesa_sha1_update(&sha1_ctx, tag, sizeof(tag));
+   _mesa_sha1_update(&sha1_ctx, &type, sizeof(type));
+
+   if (ir_type == PIPE_SHADER_IR_NIR) {
+      struct blob blob;
+
+      blob_init(&blob);
+      nir_serialize(&blob, ir, false);
+      _mesa_sha1_update(&sha1_ctx, blob.data, blob.size);
+      blob_finish(&blob);
+   } else {
+      const struct tgsi_token *tokens = ir;
+      _mesa_sha1_update(&sha1_ctx, tokens,
+                        tgsi_num_tokens(tokens) * sizeof(struct tgsi_token));
+   }
+
+   _mesa_sha1_final(&sha1_ctx, key);
+}
+
+/* Stores the final tokens in the shader cache, as they are when the host
+ * takes binary TGSI or dumped to text otherwise.  Takes ownership of
+ * new_tokens.
+ */
+static const struct virgl_shader_cache_entry *
+virgl_shader_cache_store(struct virgl_screen *rs, const uint8_t key[20],
+                         struct tgsi_token *new_tokens)
+{
+   const struct virgl_shader_cache_entry *entry;
+   int num_tokens;
+   char *str;
+
+   if (rs->binary_shaders) {
+      num_tokens = tgsi_num_tokens(new_tokens);
+      if (virgl_debug & VIRGL_DEBUG_TGSI) {
+         debug_printf("TGSI:\n---8<---\n");
+         tgsi_dump(new_tokens, TGSI_DUMP_FLOAT_AS_HEX);
+         debug_printf("---8<---\n");
+      }
+
+      entry = virgl_shader_cache_add(rs, key, new_tokens,
+                                     num_tokens * sizeof(struct tgsi_token),
+                                     num_tokens);
+      FREE(new_tokens);
+      return entry;
+   }
+
+   str = virgl_encode_shader_text(new_tokens, &num_tokens);
+   FREE(new_tokens);
+   if (!str)
+      return NULL;
+
+   entry = virgl_shader_cache_add(rs, key, str, strlen(str) + 1, num_tokens);
+   FREE(str);
+
+   return entry;
+}
+
 static void *virgl_shader_encoder(struct pipe_context *ctx,
                                   const struct pipe_shader_state *shader,
                                   unsigned type)
 {
    struct virgl_context *vctx = virgl_context(ctx);
    struct virgl_screen *rs = virgl_screen(ctx->screen);
+   const struct virgl_shader_cache_entry *entry = NULL;
    uint32_t handle;
-   const struct tgsi_token *tokens;
-   const struct tgsi_token *ntt_tokens = NULL;
-   struct tgsi_token *new_tokens;
-   int ret;
-   bool is_separable = false;
-
-   if (shader->type == PIPE_SHADER_IR_NIR) {
-      struct nir_to_tgsi_options options = {
-         .unoptimized_ra = true,
-         .lower_fabs = true,
-         .lower_ssbo_bindings =
-               rs->caps.caps.v2.host_feature_check_version >= 16
-      };
-
-      if (!(rs->caps.caps.v2.capability_bits_v2 & VIRGL_CAP_V2_TEXTURE_SHADOW_LOD) &&
-          rs->caps.caps.v2.capability_bits & VIRGL_CAP_HOST_IS_GLES) {
-         nir_lower_tex_options lower_tex_options = {
-            .lower_offset_filter = lower_gles_arrayshadow_offset_filter,
+   uint8_t key[20];
+
+   virgl_shader_cache_key(type, shader->type,
+                          shader->type == PIPE_SHADER_IR_NIR ?
+                          (const void *)shader->ir.nir : shader->tokens,
+                          key);
+
+   /* VIRGL_DEBUG_TGSI wants to see every translation. */
+   if (!(virgl_debug & VIRGL_DEBUG_TGSI))
+      entry = virgl_shader_cache_find(rs, key);
+
+   if (!entry) {
+      const struct tgsi_token *tokens;
+      const struct tgsi_token *ntt_tokens = NULL;
+      struct tgsi_token *new_tokens;
+      bool is_separable = false;
+
+      if (shader->type == PIPE_SHADER_IR_NIR) {
+         struct nir_to_tgsi_options options = {
+            .unoptimized_ra = true,
+            .lower_fabs = true,
+            .lower_ssbo_bindings =
+                  rs->caps.caps.v2.host_feature_check_version >= 16
          };
 
-         NIR_PASS_V(shader->ir.nir, nir_lower_tex, &lower_tex_options);
+         if (!(rs->caps.caps.v2.capability_bits_v2 & VIRGL_CAP_V2_TEXTURE_SHADOW_LOD) &&
+             rs->caps.caps.v2.capability_bits & VIRGL_CAP_HOST_IS_GLES) {
+            nir_lower_tex_options lower_tex_options = {
+               .lower_offset_filter = lower_gles_arrayshadow_offset_filter,
+            };
+
+            NIR_PASS_V(shader->ir.nir, nir_lower_tex, &lower_tex_options);
+         }
+
+         nir_shader *s = nir_shader_clone(NULL, shader->ir.nir);
+
+         /* The host can't handle certain IO slots as separable, because we can't assign
+          * more than 32 IO locations explicitly, and with varyings and patches we already
+          * exhaust the possible ways of handling this for the varyings with generic names,
+          * so drop the flag in these cases */
+         const uint64_t drop_slots_for_separable_io = 0xffull << VARYING_SLOT_TEX0 |
+                                                           1 <<  VARYING_SLOT_FOGC |
+                                                           1 <<  VARYING_SLOT_BFC0 |
+                                                           1 <<  VARYING_SLOT_BFC1 |
+                                                           1 <<  VARYING_SLOT_COL0 |
+                                                           1 <<  VARYING_SLOT_COL1;
+         bool keep_separable_flags = true;
+         if (s->info.stage != MESA_SHADER_VERTEX)
+            keep_separable_flags &= !(s->info.inputs_read & drop_slots_for_separable_io);
+         if (s->info.stage != MESA_SHADER_FRAGMENT)
+            keep_separable_flags &= !(s->info.outputs_written & drop_slots_for_separable_io);
+
+         /* Propagare the separable shader property to the host, unless
+          * it is an internal shader - these are marked separable even though they are not. */
+         is_separable = s->info.separate_shader && !s->info.internal && keep_separable_flags;
+         ntt_tokens = tokens = nir_to_tgsi_options(s, vctx->base.screen, &options); /* takes ownership */
+      } else {
+         tokens = shader->tokens;
       }
 
-      nir_shader *s = nir_shader_clone(NULL, shader->ir.nir);
-
-      /* The host can't handle certain IO slots as separable, because we can't assign
-       * more than 32 IO locations explicitly, and with varyings and patches we already
-       * exhaust the possible ways of handling this for the varyings with generic names,
-       * so drop the flag in these cases */
-      const uint64_t drop_slots_for_separable_io = 0xffull << VARYING_SLOT_TEX0 |
-                                                        1 <<  VARYING_SLOT_FOGC |
-                                                        1 <<  VARYING_SLOT_BFC0 |
-                                                        1 <<  VARYING_SLOT_BFC1 |
-                                                        1 <<  VARYING_SLOT_COL0 |
-                                                        1 <<  VARYING_SLOT_COL1;
-      bool keep_separable_flags = true;
-      if (s->info.stage != MESA_SHADER_VERTEX)
-         keep_separable_flags &= !(s->info.inputs_read & drop_slots_for_separable_io);
-      if (s->info.stage != MESA_SHADER_FRAGMENT)
-         keep_separable_flags &= !(s->info.outputs_written & drop_slots_for_separable_io);
-
-      /* Propagare the separable shader property to the host, unless
-       * it is an internal shader - these are marked separable even though they are not. */
-      is_separable = s->info.separate_shader && !s->info.internal && keep_separable_flags;
-      ntt_tokens = tokens = nir_to_tgsi_options(s, vctx->base.screen, &options); /* takes ownership */
-   } else {
-      tokens = shader->tokens;
-   }
+      new_tokens = virgl_tgsi_transform(rs, tokens, is_separable);
+      FREE((void *)ntt_tokens);
+      if (!new_tokens)
+         return NULL;
 
-   new_tokens = virgl_tgsi_transform(rs, tokens, is_separable);
-   if (!new_tokens)
-      return NULL;
+      entry = virgl_shader_cache_store(rs, key, new_tokens);
+      if (!entry)
+         return NULL;
+   }
 
    handle = virgl_object_assign_handle();
    /* encode VS state */
-   ret = virgl_encode_shader_state(vctx, handle, type,
-                                   &shader->stream_output, 0,
-                                   new_tokens);
-   if (ret) {
-      FREE((void *)ntt_tokens);
-      return NULL;
-   }
+   virgl_encode_shader_payload_state(vctx, handle, type,
+                                     &shader->stream_output, 0,
+                                     entry->data, entry->size,
+                                     entry->num_tokens, rs->binary_shaders);
+   virgl_shader_cache_release(entry);
 
-   FREE((void *)ntt_tokens);
-   FREE(new_tokens);
    return (void *)(unsigned long)handle;
 
 }
@@ -940,7 +1115,25 @@ static void virgl_clear_texture(struct pipe_context *ctx,
     * without going through the corresponding guest side resource, and
     * hence the two will diverge.
     */
-   virgl_resource_dirty(vres, level);
+   virgl_resource_dirty_box(vres, level, box);
+}
+
+static void virgl_invalidate_resource(struct pipe_context *ctx,
+                                      struct pipe_resource *res)
+{
+   struct virgl_context *vctx = virgl_context(ctx);
+   struct virgl_resource *vres = virgl_resource(res);
+
+   /* buffer discards are already handled by the guest-side maps */
+   if (res->target == PIPE_BUFFER)
+      return;
+
+   virgl_encode_invalidate_resource(vctx, vres);
+
+   /* Whatever the host had is undefined now, so there is nothing left to
+    * read back either.
+    */
+   vres->clean_mask = (1 << VR_MAX_TEXTURE_2D_LEVELS) - 1;
 }
 
 static void virgl_draw_vbo(struct pipe_context *ctx,
@@ -950,12 +1143,15 @@ static void virgl_draw_vbo(struct pipe_context *ctx,
                            const struct pipe_draw_start_count_bias *draws,
                            unsigned num_draws)
 {
-   if (num_draws > 1) {
+   if (num_draws > 1 && indirect) {
       util_draw_multi(ctx, dinfo, drawid_offset, indirect, draws, num_draws);
       return;
    }
 
-   if (!indirect && (!draws[0].count || !dinfo->instance_count))
+   if (num_draws == 1 && !indirect && (!draws[0].count || !dinfo->instance_count))
+      return;
+
+   if (!dinfo->instance_count)
       return;
 
    struct virgl_context *vctx = virgl_context(ctx);
@@ -963,7 +1159,7 @@ static void virgl_draw_vbo(struct pipe_context *ctx,
    struct virgl_indexbuf ib = {};
    struct pipe_draw_info info = *dinfo;
 
-   if (!indirect &&
+   if (num_draws == 1 && !indirect &&
        !dinfo->primitive_restart &&
        !u_trim_pipe_prim(dinfo->mode, (unsigned*)&draws[0].count))
       return;
@@ -973,33 +1169,55 @@ static void virgl_draw_vbo(struct pipe_context *ctx,
       util_primconvert_draw_vbo(vctx->primconvert, dinfo, drawid_offset, indirect, draws, num_draws);
       return;
    }
-   if (info.index_size) {
-           pipe_resource_reference(&ib.buffer, info.has_user_indices ? NULL : info.index.resource);
-           ib.user_buffer = info.has_user_indices ? info.index.user : NULL;
-           ib.index_size = dinfo->index_size;
-           ib.offset = draws[0].start * ib.index_size;
-
-           if (ib.user_buffer) {
-                   unsigned start_offset = draws[0].start * ib.index_size;
-                   u_upload_data(vctx->uploader, 0,
-                                 draws[0].count * ib.index_size, 4,
-                                 (char*)ib.user_buffer + start_offset,
-                                 &ib.offset, &ib.buffer);
-                   ib.user_buffer = NULL;
-           }
-           virgl_hw_set_index_buffer(vctx, &ib);
-   }
 
    if (!vctx->num_draws)
       virgl_reemit_draw_resources(vctx);
    vctx->num_draws++;
 
+   /* Vertex buffers and draw resources are shared by all draws, so they are
+    * only emitted once and the draws follow back to back.
+    */
    virgl_hw_set_vertex_buffers(vctx);
 
-   virgl_encoder_draw_vbo(vctx, &info, drawid_offset, indirect, &draws[0]);
+   if (info.index_size) {
+      ib.index_size = dinfo->index_size;
+      ib.offset = ~0u;
+   }
 
-   pipe_resource_reference(&ib.buffer, NULL);
+   for (unsigned i = 0; i < num_draws; i++) {
+      struct pipe_draw_start_count_bias draw = draws[i];
+
+      if (num_draws > 1) {
+         if (!draw.count)
+            continue;
+         if (!dinfo->primitive_restart &&
+             !u_trim_pipe_prim(dinfo->mode, &draw.count))
+            continue;
+      }
+
+      if (info.index_size) {
+         if (info.has_user_indices) {
+            unsigned start_offset = draw.start * ib.index_size;
+
+            pipe_resource_reference(&ib.buffer, NULL);
+            u_upload_data(vctx->uploader, 0,
+                          draw.count * ib.index_size, 4,
+                          (char*)info.index.user + start_offset,
+                          &ib.offset, &ib.buffer);
+            virgl_hw_set_index_buffer(vctx, &ib);
+         } else if (ib.offset != draw.start * ib.index_size) {
+            pipe_resource_reference(&ib.buffer, info.index.resource);
+            ib.offset = draw.start * ib.index_size;
+            virgl_hw_set_index_buffer(vctx, &ib);
+         }
+      }
 
+      virgl_encoder_draw_vbo(vctx, &info,
+                             drawid_offset + (dinfo->increment_draw_id ? i : 0),
+                             indirect, &draw);
+   }
+
+   pipe_resource_reference(&ib.buffer, NULL);
 }
 
 static void virgl_submit_cmd(struct virgl_winsys *vws,
@@ -1018,6 +1236,38 @@ static void virgl_submit_cmd(struct virgl_winsys *vws,
    }
 }
 
+static void virgl_reset_emitted_state(struct virgl_context *ctx)
+{
+   ctx->emitted.blend_valid = false;
+   ctx->emitted.dsa_valid = false;
+   ctx->emitted.rasterizer_valid = false;
+
+   for (unsigned i = 0; i < PIPE_SHADER_TYPES; i++) {
+      struct virgl_emitted_stage_state *stage = &ctx->emitted.stages[i];
+
+      stage->sampler_mask = 0;
+      BITSET_ZERO(stage->view_mask);
+      stage->ubo_mask = 0;
+      stage->ssbo_mask = 0;
+      stage->image_mask = 0;
+      stage->user_const_mask = 0;
+   }
+}
+
+/* Runs concurrently with the application thread, which may be in the
+ * middle of a winsys request that waits for a reply.  Winsyses pair each
+ * request with its reply under their own lock, so a submit sent from here
+ * can go out in between without taking that reply.
+ */
+static void virgl_submit_job(void *job, void *gdata, int thread_index)
+{
+   struct virgl_context *ctx = job;
+   struct virgl_winsys *vws = virgl_screen(ctx->base.screen)->vws;
+
+   MESA_TRACE_FUNC();
+   vws->submit_cmd(vws, ctx->submit_cbuf, NULL);
+}
+
 void virgl_flush_eq(struct virgl_context *ctx, void *closure,
                     struct pipe_fence_handle **fence)
 {
@@ -1029,6 +1279,8 @@ void virgl_flush_eq(struct virgl_context *ctx, void *closure,
        !fence)
       return;
 
+   MESA_TRACE_FUNC();
+
    if (ctx->num_draws)
       u_upload_unmap(ctx->uploader);
 
@@ -1037,7 +1289,26 @@ void virgl_flush_eq(struct virgl_context *ctx, void *closure,
 
    virgl_transfer_queue_clear(&ctx->queue, ctx->cbuf);
 
-   virgl_submit_cmd(rs->vws, ctx->cbuf, fence);
+   /* Fences are created by the submission itself, so those flushes stay
+    * synchronous.
+    */
+   if (ctx->threaded_submit && !fence) {
+      struct virgl_cmd_buf *cbuf = ctx->cbuf;
+
+      util_queue_fence_wait(&ctx->submit_fence);
+      ctx->cbuf = ctx->submit_cbuf;
+      ctx->submit_cbuf = cbuf;
+      util_queue_add_job(&ctx->submit_queue, ctx, &ctx->submit_fence,
+                         virgl_submit_job, NULL, 0);
+   } else {
+      virgl_submit_wait(ctx);
+      virgl_submit_cmd(rs->vws, ctx->cbuf, fence);
+   }
+
+   if (ctx->supports_staging)
+      virgl_staging_flush(&ctx->staging);
+
+   virgl_reset_emitted_state(ctx);
 
    /* Reserve some space for transfers. */
    if (ctx->encoded_transfers)
@@ -1103,9 +1374,19 @@ static void virgl_set_sampler_views(struct pipe_context *ctx,
    struct virgl_context *vctx = virgl_context(ctx);
    struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader_type];
+   struct virgl_emitted_stage_state *emitted =
+      &vctx->emitted.stages[shader_type];
+   /* The first slot that differs from what the host has. */
+   unsigned first_changed = ~0u;
 
    for (unsigned i = 0; i < num_views; i++) {
       unsigned idx = start_slot + i;
+      struct pipe_sampler_view *view = views ? views[i] : NULL;
+
+      if (first_changed == ~0u &&
+          (!BITSET_TEST(emitted->view_mask, idx) || binding->views[idx] != view))
+         first_changed = idx;
+
       if (views && views[i]) {
          struct virgl_resource *res = virgl_resource(views[i]->texture);
          res->bind_history |= PIPE_BIND_SAMPLER_VIEW;
@@ -1116,13 +1397,25 @@ static void virgl_set_sampler_views(struct pipe_context *ctx,
          } else {
             pipe_sampler_view_reference(&binding->views[idx], views[i]);
          }
+         BITSET_SET(binding->view_enabled_mask, idx);
       } else {
          pipe_sampler_view_reference(&binding->views[idx], NULL);
+         BITSET_CLEAR(binding->view_enabled_mask, idx);
       }
    }
 
-   virgl_encode_set_sampler_views(vctx, shader_type,
-         start_slot, num_views, (struct virgl_sampler_view **)binding->views);
+   /* Leave out the unchanged slots in front, e.g. when only the last
+    * texture is swapped.  The range still ends at the same slot, as the
+    * host may take it as the number of views.
+    */
+   if (first_changed != ~0u) {
+      unsigned end = start_slot + num_views;
+
+      virgl_encode_set_sampler_views(vctx, shader_type,
+            first_changed, end - first_changed,
+            (struct virgl_sampler_view **)(binding->views + first_changed));
+      BITSET_SET_RANGE(emitted->view_mask, first_changed, end - 1);
+   }
    virgl_attach_res_sampler_views(vctx, shader_type);
 
    if (unbind_num_trailing_slots) {
@@ -1182,12 +1475,26 @@ static void virgl_bind_sampler_states(struct pipe_context *ctx,
                                      void **samplers)
 {
    struct virgl_context *vctx = virgl_context(ctx);
+   struct virgl_emitted_stage_state *emitted = &vctx->emitted.stages[shader];
    uint32_t handles[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   bool changed = false;
    int i;
    for (i = 0; i < num_samplers; i++) {
       handles[i] = (unsigned long)(samplers[i]);
+
+      if (!(emitted->sampler_mask & (1u << (start_slot + i))) ||
+          emitted->samplers[start_slot + i] != handles[i])
+         changed = true;
    }
+
+   if (!changed)
+      return;
+
    virgl_encode_bind_sampler_states(vctx, shader, start_slot, num_samplers, handles);
+   for (i = 0; i < num_samplers; i++) {
+      emitted->samplers[start_slot + i] = handles[i];
+      emitted->sampler_mask |= 1u << (start_slot + i);
+   }
 }
 
 static void virgl_set_polygon_stipple(struct pipe_context *ctx,
@@ -1261,10 +1568,13 @@ static void virgl_resource_copy_region(struct pipe_context *ctx,
    struct virgl_context *vctx = virgl_context(ctx);
    struct virgl_resource *dres = virgl_resource(dst);
    struct virgl_resource *sres = virgl_resource(src);
+   struct pipe_box dst_box;
 
    if (dres->b.target == PIPE_BUFFER)
       util_range_add(&dres->b, &dres->valid_buffer_range, dstx, dstx + src_box->width);
-   virgl_resource_dirty(dres, dst_level);
+   u_box_3d(dstx, dsty, dstz, src_box->width, src_box->height, src_box->depth,
+            &dst_box);
+   virgl_resource_dirty_box(dres, dst_level, &dst_box);
 
    virgl_encode_resource_copy_region(vctx, dres,
                                     dst_level, dstx, dsty, dstz,
@@ -1290,7 +1600,7 @@ static void virgl_blit(struct pipe_context *ctx,
           (util_format_is_srgb(blit->dst.resource->format) ==
             util_format_is_srgb(blit->dst.format)));
 
-   virgl_resource_dirty(dres, blit->dst.level);
+   virgl_resource_dirty_box(dres, blit->dst.level, &blit->dst.box);
    virgl_encode_blit(vctx, dres, sres,
                     blit);
 }
@@ -1331,8 +1641,24 @@ static void virgl_set_shader_buffers(struct pipe_context *ctx,
    struct virgl_screen *rs = virgl_screen(ctx->screen);
    struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader];
+   struct virgl_emitted_stage_state *emitted = &vctx->emitted.stages[shader];
+   const uint32_t slot_mask = u_bit_consecutive(start_slot, count);
+   bool changed = (emitted->ssbo_mask & slot_mask) != slot_mask;
+
+   for (unsigned i = 0; i < count && !changed; i++) {
+      const struct pipe_shader_buffer *ssbo = &binding->ssbos[start_slot + i];
+      const bool enabled = binding->ssbo_enabled_mask & (1 << (start_slot + i));
+
+      if (buffers && buffers[i].buffer) {
+         changed = !enabled || ssbo->buffer != buffers[i].buffer ||
+                   ssbo->buffer_offset != buffers[i].buffer_offset ||
+                   ssbo->buffer_size != buffers[i].buffer_size;
+      } else {
+         changed = enabled;
+      }
+   }
 
-   binding->ssbo_enabled_mask &= ~u_bit_consecutive(start_slot, count);
+   binding->ssbo_enabled_mask &= ~slot_mask;
    for (unsigned i = 0; i < count; i++) {
       unsigned idx = start_slot + i;
       if (buffers && buffers[i].buffer) {
@@ -1350,9 +1676,10 @@ static void virgl_set_shader_buffers(struct pipe_context *ctx,
    uint32_t max_shader_buffer = (shader == PIPE_SHADER_FRAGMENT || shader == PIPE_SHADER_COMPUTE) ?
       rs->caps.caps.v2.max_shader_buffer_frag_compute :
       rs->caps.caps.v2.max_shader_buffer_other_stages;
-   if (!max_shader_buffer)
+   if (!max_shader_buffer || !changed)
       return;
    virgl_encode_set_shader_buffers(vctx, shader, start_slot, count, buffers);
+   emitted->ssbo_mask |= slot_mask;
 }
 
 static void virgl_create_fence_fd(struct pipe_context *ctx,
@@ -1387,8 +1714,21 @@ static void virgl_set_shader_images(struct pipe_context *ctx,
    struct virgl_screen *rs = virgl_screen(ctx->screen);
    struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader];
+   struct virgl_emitted_stage_state *emitted = &vctx->emitted.stages[shader];
+   const uint32_t slot_mask = u_bit_consecutive(start_slot, count);
+   bool changed = (emitted->image_mask & slot_mask) != slot_mask;
+
+   for (unsigned i = 0; i < count && !changed; i++) {
+      const struct pipe_image_view *image = &binding->images[start_slot + i];
+      const bool enabled = binding->image_enabled_mask & (1 << (start_slot + i));
+
+      if (images && images[i].resource)
+         changed = !enabled || memcmp(image, &images[i], sizeof(*image));
+      else
+         changed = enabled;
+   }
 
-   binding->image_enabled_mask &= ~u_bit_consecutive(start_slot, count);
+   binding->image_enabled_mask &= ~slot_mask;
    for (unsigned i = 0; i < count; i++) {
       unsigned idx = start_slot + i;
       if (images && images[i].resource) {
@@ -1409,7 +1749,10 @@ static void virgl_set_shader_images(struct pipe_context *ctx,
      rs->caps.caps.v2.max_shader_image_other_stages;
    if (!max_shader_images)
       return;
-   virgl_encode_set_shader_images(vctx, shader, start_slot, count, images);
+   if (changed) {
+      virgl_encode_set_shader_images(vctx, shader, start_slot, count, images);
+      emitted->image_mask |= slot_mask;
+   }
 
    if (unbind_num_trailing_slots) {
       virgl_set_shader_images(ctx, shader, start_slot + count,
@@ -1432,39 +1775,49 @@ static void *virgl_create_compute_state(struct pipe_context *ctx,
                                         const struct pipe_compute_state *state)
 {
    struct virgl_context *vctx = virgl_context(ctx);
+   struct virgl_screen *rs = virgl_screen(ctx->screen);
+   const struct virgl_shader_cache_entry *entry = NULL;
    uint32_t handle;
-   const struct tgsi_token *ntt_tokens = NULL;
-   const struct tgsi_token *tokens;
    struct pipe_stream_output_info so_info = {};
-   int ret;
-
-   if (state->ir_type == PIPE_SHADER_IR_NIR) {
-      struct nir_to_tgsi_options options = {
-         .unoptimized_ra = true,
-         .lower_fabs = true
-      };
-      nir_shader *s = nir_shader_clone(NULL, state->prog);
-      ntt_tokens = tokens = nir_to_tgsi_options(s, vctx->base.screen, &options); /* takes ownership */
-   } else {
-      tokens = state->prog;
-   }
-
-   void *new_tokens = virgl_tgsi_transform((struct virgl_screen *)vctx->base.screen, tokens, false);
-   if (!new_tokens)
-      return NULL;
+   uint8_t key[20];
+
+   virgl_shader_cache_key(PIPE_SHADER_COMPUTE, state->ir_type, state->prog,
+                          key);
+   if (!(virgl_debug & VIRGL_DEBUG_TGSI))
+      entry = virgl_shader_cache_find(rs, key);
+
+   if (!entry) {
+      const struct tgsi_token *ntt_tokens = NULL;
+      const struct tgsi_token *tokens;
+      struct tgsi_token *new_tokens;
+
+      if (state->ir_type == PIPE_SHADER_IR_NIR) {
+         struct nir_to_tgsi_options options = {
+            .unoptimized_ra = true,
+            .lower_fabs = true
+         };
+         nir_shader *s = nir_shader_clone(NULL, state->prog);
+         ntt_tokens = tokens = nir_to_tgsi_options(s, vctx->base.screen, &options); /* takes ownership */
+      } else {
+         tokens = state->prog;
+      }
 
-   handle = virgl_object_assign_handle();
-   ret = virgl_encode_shader_state(vctx, handle, PIPE_SHADER_COMPUTE,
-                                   &so_info,
-                                   state->static_shared_mem,
-                                   new_tokens);
-   if (ret) {
+      new_tokens = virgl_tgsi_transform(rs, tokens, false);
       FREE((void *)ntt_tokens);
-      return NULL;
+      if (!new_tokens)
+         return NULL;
+
+      entry = virgl_shader_cache_store(rs, key, new_tokens);
+      if (!entry)
+         return NULL;
    }
 
-   FREE((void *)ntt_tokens);
-   FREE(new_tokens);
+   handle = virgl_object_assign_handle();
+   virgl_encode_shader_payload_state(vctx, handle, PIPE_SHADER_COMPUTE,
+                                     &so_info, state->static_shared_mem,
+                                     entry->data, entry->size,
+                                     entry->num_tokens, rs->binary_shaders);
+   virgl_shader_cache_release(entry);
 
    return (void *)(unsigned long)handle;
 }
@@ -1503,13 +1856,14 @@ virgl_release_shader_binding(struct virgl_context *vctx,
 {
    struct virgl_shader_binding_state *binding =
       &vctx->shader_bindings[shader_type];
+   unsigned view;
 
-   for (int i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; ++i) {
-      if (binding->views[i]) {
-         pipe_sampler_view_reference(
-                  (struct pipe_sampler_view **)&binding->views[i], NULL);
-      }
+   BITSET_FOREACH_SET(view, binding->view_enabled_mask,
+                      PIPE_MAX_SHADER_SAMPLER_VIEWS) {
+      pipe_sampler_view_reference(
+               (struct pipe_sampler_view **)&binding->views[view], NULL);
    }
+   BITSET_ZERO(binding->view_enabled_mask);
 
    while (binding->ubo_enabled_mask) {
       int i = u_bit_scan(&binding->ubo_enabled_mask);
@@ -1546,19 +1900,31 @@ virgl_context_destroy( struct pipe_context *ctx )
    virgl_encoder_destroy_sub_ctx(vctx, vctx->hw_sub_ctx_id);
    virgl_flush_eq(vctx, vctx, NULL);
 
-   for (shader_type = 0; shader_type < PIPE_SHADER_TYPES; shader_type++)
+   for (shader_type = 0; shader_type < PIPE_SHADER_TYPES; shader_type++) {
       virgl_release_shader_binding(vctx, shader_type);
 
+      for (unsigned i = 0; i < PIPE_MAX_CONSTANT_BUFFERS; i++)
+         FREE(vctx->emitted.stages[shader_type].user_consts[i]);
+   }
+
    while (vctx->atomic_buffer_enabled_mask) {
       int i = u_bit_scan(&vctx->atomic_buffer_enabled_mask);
       pipe_resource_reference(&vctx->atomic_buffers[i].buffer, NULL);
    }
 
+   if (vctx->threaded_submit) {
+      util_queue_fence_wait(&vctx->submit_fence);
+      util_queue_destroy(&vctx->submit_queue);
+      util_queue_fence_destroy(&vctx->submit_fence);
+      rs->vws->cmd_buf_destroy(vctx->submit_cbuf);
+   }
+
    rs->vws->cmd_buf_destroy(vctx->cbuf);
    if (vctx->uploader)
       u_upload_destroy(vctx->uploader);
    if (vctx->supports_staging)
       virgl_staging_destroy(&vctx->staging);
+   u_suballocator_destroy(&vctx->query_suballoc);
    util_primconvert_destroy(vctx->primconvert);
    virgl_transfer_queue_fini(&vctx->queue);
 
@@ -1626,6 +1992,23 @@ static void virgl_link_shader(struct pipe_context *ctx, void **handles)
    virgl_encode_link_shader(vctx, shader_handles);
 }
 
+static bool virgl_upload_buffer_is_busy(struct pipe_context *ctx,
+                                        struct pipe_resource *buffer)
+{
+   struct virgl_context *vctx = virgl_context(ctx);
+   struct virgl_winsys *vws = virgl_screen(ctx->screen)->vws;
+   struct virgl_hw_res *hw_res = virgl_resource(buffer)->hw_res;
+
+   /* Data that is still to be sent counts as well. */
+   if (vws->res_is_referenced(vws, vctx->cbuf, hw_res) ||
+       virgl_transfer_queue_is_buffer_queued(&vctx->queue, hw_res,
+                                             buffer->width0))
+      return true;
+
+   virgl_submit_wait(vctx);
+   return vws->resource_is_busy(vws, hw_res);
+}
+
 struct pipe_context *virgl_context_create(struct pipe_screen *pscreen,
                                           void *priv,
                                           unsigned flags)
@@ -1641,6 +2024,21 @@ struct pipe_context *virgl_context_create(struct pipe_screen *pscreen,
       return NULL;
    }
 
+   /* Encode the next command buffer while the previous one is submitted. */
+   if (rs->threaded_submit && !(virgl_debug & VIRGL_DEBUG_SYNC)) {
+      vctx->submit_cbuf = rs->vws->cmd_buf_create(rs->vws,
+                                                  VIRGL_MAX_CMDBUF_DWORDS);
+      if (vctx->submit_cbuf &&
+          util_queue_init(&vctx->submit_queue, "virgl_submit", 1, 1,
+                          UTIL_QUEUE_INIT_PREFER_BIG_CORES, NULL)) {
+         util_queue_fence_init(&vctx->submit_fence);
+         vctx->threaded_submit = true;
+      } else if (vctx->submit_cbuf) {
+         rs->vws->cmd_buf_destroy(vctx->submit_cbuf);
+         vctx->submit_cbuf = NULL;
+      }
+   }
+
    vctx->base.destroy = virgl_context_destroy;
    vctx->base.create_surface = virgl_create_surface;
    vctx->base.surface_destroy = virgl_surface_destroy;
@@ -1731,6 +2129,9 @@ struct pipe_context *virgl_context_create(struct pipe_screen *pscreen,
    if (rs->caps.caps.v2.host_feature_check_version >= 7)
       vctx->base.link_shader = virgl_link_shader;
 
+   if (rs->caps.caps.v2.capability_bits_v2 & VIRGL_CAP_V2_INVALIDATE_RESOURCE)
+      vctx->base.invalidate_resource = virgl_invalidate_resource;
+
    virgl_init_context_resource_functions(&vctx->base);
    virgl_init_query_functions(vctx);
    virgl_init_so_functions(vctx);
@@ -1749,9 +2150,16 @@ struct pipe_context *virgl_context_create(struct pipe_screen *pscreen,
                                      PIPE_BIND_INDEX_BUFFER, PIPE_USAGE_STREAM, 0);
    if (!vctx->uploader)
            goto fail;
+   /* Creating resources takes a round trip to the host, so reuse the upload
+    * buffers the host is done with.
+    */
+   u_upload_enable_recycling(vctx->uploader, 4, virgl_upload_buffer_is_busy);
    vctx->base.stream_uploader = vctx->uploader;
    vctx->base.const_uploader = vctx->uploader;
 
+   u_suballocator_init(&vctx->query_suballoc, &vctx->base, 4096,
+                       PIPE_BIND_CUSTOM, PIPE_USAGE_STAGING, 0, false);
+
    /* We use a special staging buffer as the source of copy transfers. */
    if ((rs->caps.caps.v2.capability_bits & VIRGL_CAP_COPY_TRANSFER) &&
        vctx->encoded_transfers) {
@@ -27,6 +27,9 @@
 #include "pipe/p_context.h"
 #include "util/slab.h"
 #include "util/list.h"
+#include "util/bitset.h"
+#include "util/u_queue.h"
+#include "util/u_suballoc.h"
 
 #include "virgl_staging_mgr.h"
 #include "virgl_transfer_queue.h"
@@ -54,6 +57,7 @@ struct virgl_rasterizer_state {
 
 struct virgl_shader_binding_state {
    struct pipe_sampler_view *views[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   BITSET_DECLARE(view_enabled_mask, PIPE_MAX_SHADER_SAMPLER_VIEWS);
 
    struct pipe_constant_buffer ubos[PIPE_MAX_CONSTANT_BUFFERS];
    uint32_t ubo_enabled_mask;
@@ -65,12 +69,54 @@ struct virgl_shader_binding_state {
    uint32_t image_enabled_mask;
 };
 
+/* What was sent to the host since the last flush, so binds that would not
+ * change anything can be dropped.  The state objects and views compared
+ * against are kept alive by the bindings above for as long as they are
+ * bound, so their handles and pointers can't be recycled meanwhile.
+ */
+struct virgl_emitted_stage_state {
+   uint32_t samplers[PIPE_MAX_SAMPLERS];
+   uint32_t sampler_mask;
+
+   BITSET_DECLARE(view_mask, PIPE_MAX_SHADER_SAMPLER_VIEWS);
+
+   /* UBOs, SSBOs and images matching the binding state. */
+   uint32_t ubo_mask;
+   uint32_t ssbo_mask;
+   uint32_t image_mask;
+
+   /* Contents of user constant buffers. */
+   void *user_consts[PIPE_MAX_CONSTANT_BUFFERS];
+   uint32_t user_const_sizes[PIPE_MAX_CONSTANT_BUFFERS];
+   uint32_t user_const_mask;
+};
+
+struct virgl_emitted_state {
+   uint32_t blend;
+   uint32_t dsa;
+   uint32_t rasterizer;
+   bool blend_valid;
+   bool dsa_valid;
+   bool rasterizer_valid;
+
+   struct virgl_emitted_stage_state stages[PIPE_SHADER_TYPES];
+};
+
 struct virgl_context {
    struct pipe_context base;
    struct virgl_cmd_buf *cbuf;
    unsigned cbuf_initial_cdw;
 
+   /* With threaded submission, flushes swap cbuf with submit_cbuf and hand
+    * the latter to submit_queue.  At most one command buffer is in flight.
+    */
+   struct virgl_cmd_buf *submit_cbuf;
+   struct util_queue submit_queue;
+   struct util_queue_fence submit_fence;
+   bool threaded_submit;
+
    struct virgl_shader_binding_state shader_bindings[PIPE_SHADER_TYPES];
+   struct virgl_emitted_state emitted;
    struct pipe_shader_buffer atomic_buffers[PIPE_MAX_HW_ATOMIC_BUFFERS];
    uint32_t atomic_buffer_enabled_mask;
 
@@ -82,6 +128,12 @@ struct virgl_context {
    struct virgl_transfer_queue queue;
    struct u_upload_mgr *uploader;
    struct virgl_staging_mgr staging;
+   /* Queries share result buffers, so that one wait covers all the queries
+    * that ended in the same flush.
+    */
+   struct u_suballocator query_suballoc;
+   /* Set once the host has been seen updating query states in place. */
+   bool query_state_coherent;
    bool encoded_transfers;
    bool supports_staging;
    uint8_t patch_vertices;
@@ -140,4 +192,15 @@ virgl_rebind_resource(struct virgl_context *vctx,
 
 void virgl_flush_eq(struct virgl_context *ctx, void *closure, struct pipe_fence_handle **fence);
 
+/* The winsys only knows about command buffers that have been submitted to
+ * it.  This must be called before asking it whether a resource is busy,
+ * waiting for a resource, or talking to the host outside of cbuf.
+ */
+static inline void
+virgl_submit_wait(struct virgl_context *ctx)
+{
+   if (ctx->threaded_submit)
+      util_queue_fence_wait(&ctx->submit_fence);
+}
+
 #endif
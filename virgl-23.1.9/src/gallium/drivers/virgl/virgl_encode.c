@@ -547,24 +547,17 @@ static void virgl_emit_shader_streamout(struct virgl_context *ctx,
    }
 }
 
-int virgl_encode_shader_state(struct virgl_context *ctx,
-                              uint32_t handle,
-                              enum pipe_shader_type type,
-                              const struct pipe_stream_output_info *so_info,
-                              uint32_t cs_req_local_mem,
-                              const struct tgsi_token *tokens)
+char *virgl_encode_shader_text(const struct tgsi_token *tokens,
+                               int *out_num_tokens)
 {
-   char *str, *sptr;
-   uint32_t shader_len, len;
+   char *str;
    bool bret;
    int num_tokens = tgsi_num_tokens(tokens);
    int str_total_size = 65536;
    int retry_size = 1;
-   uint32_t left_bytes, base_hdr_size, strm_hdr_size, thispass;
-   bool first_pass;
    str = CALLOC(1, str_total_size);
    if (!str)
-      return -1;
+      return NULL;
 
    do {
       int old_size;
@@ -578,12 +571,14 @@ int virgl_encode_shader_state(struct virgl_context *ctx,
          retry_size *= 2;
          str = REALLOC(str, old_size, str_total_size);
          if (!str)
-            return -1;
+            return NULL;
       }
    } while (bret == false && retry_size < 1024);
 
-   if (bret == false)
-      return -1;
+   if (bret == false) {
+      FREE(str);
+      return NULL;
+   }
 
    if (virgl_debug & VIRGL_DEBUG_TGSI)
       debug_printf("TGSI:\n---8<---\n%s\n---8<---\n", str);
@@ -595,7 +590,31 @@ int virgl_encode_shader_state(struct virgl_context *ctx,
    while ((barrier = strstr(barrier + 1, "BARRIER")))
       num_tokens++;
 
-   shader_len = strlen(str) + 1;
+   *out_num_tokens = num_tokens;
+   return str;
+}
+
+int virgl_encode_shader_payload_state(struct virgl_context *ctx,
+                                      uint32_t handle,
+                                      enum pipe_shader_type type,
+                                      const struct pipe_stream_output_info *so_info,
+                                      uint32_t cs_req_local_mem,
+                                      const void *data,
+                                      uint32_t size,
+                                      int num_tokens,
+                                      bool binary)
+{
+   const uint8_t *str = data;
+   const uint8_t *sptr;
+   uint32_t shader_len, len;
+   uint32_t left_bytes, base_hdr_size, strm_hdr_size, thispass;
+   uint32_t stage;
+   bool first_pass;
+
+   shader_len = size;
+   stage = virgl_shader_stage_convert(type);
+   if (binary)
+      stage |= VIRGL_OBJ_SHADER_TYPE_BINARY;
 
    left_bytes = shader_len;
 
@@ -619,20 +638,39 @@ int virgl_encode_shader_state(struct virgl_context *ctx,
       else
          offlen = VIRGL_OBJ_SHADER_OFFSET_VAL((uintptr_t)sptr - (uintptr_t)str) | VIRGL_OBJ_SHADER_OFFSET_CONT;
 
-      virgl_emit_shader_header(ctx, handle, len, virgl_shader_stage_convert(type), offlen, num_tokens);
+      virgl_emit_shader_header(ctx, handle, len, stage, offlen, num_tokens);
 
       if (type == PIPE_SHADER_COMPUTE)
          virgl_encoder_write_dword(ctx->cbuf, cs_req_local_mem);
       else
          virgl_emit_shader_streamout(ctx, first_pass ? so_info : NULL);
 
-      virgl_encoder_write_block(ctx->cbuf, (uint8_t *)sptr, length);
+      virgl_encoder_write_block(ctx->cbuf, sptr, length);
 
       sptr += length;
       first_pass = false;
       left_bytes -= length;
    }
 
+   return 0;
+}
+
+int virgl_encode_shader_state(struct virgl_context *ctx,
+                              uint32_t handle,
+                              enum pipe_shader_type type,
+                              const struct pipe_stream_output_info *so_info,
+                              uint32_t cs_req_local_mem,
+                              const struct tgsi_token *tokens)
+{
+   int num_tokens;
+   char *str = virgl_encode_shader_text(tokens, &num_tokens);
+   if (!str)
+      return -1;
+
+   virgl_encode_shader_payload_state(ctx, handle, type, so_info,
+                                     cs_req_local_mem, str, strlen(str) + 1,
+                                     num_tokens, false);
+
    FREE(str);
    return 0;
 }
@@ -690,6 +728,14 @@ int virgl_encode_clear_texture(struct virgl_context *ctx,
    return 0;
 }
 
+int virgl_encode_invalidate_resource(struct virgl_context *ctx,
+                                     struct virgl_resource *res)
+{
+   virgl_encoder_write_cmd_dword(ctx, VIRGL_CMD0(VIRGL_CCMD_INVALIDATE_RESOURCE, 0, VIRGL_INVALIDATE_RESOURCE_SIZE));
+   virgl_encoder_write_res(ctx, res);
+   return 0;
+}
+
 int virgl_encoder_set_framebuffer_state(struct virgl_context *ctx,
                                        const struct pipe_framebuffer_state *state)
 {
@@ -786,7 +832,8 @@ int virgl_encoder_draw_vbo(struct virgl_context *ctx,
                            const struct pipe_draw_start_count_bias *draw)
 {
    uint32_t length = VIRGL_DRAW_VBO_SIZE;
-   if (info->mode == PIPE_PRIM_PATCHES)
+   /* The draw id only travels in the long form of the command. */
+   if (info->mode == PIPE_PRIM_PATCHES || drawid_offset)
       length = VIRGL_DRAW_VBO_SIZE_TESS;
    if (indirect && indirect->buffer)
       length = VIRGL_DRAW_VBO_SIZE_INDIRECT;
@@ -1331,7 +1378,8 @@ int virgl_encode_set_shader_buffers(struct virgl_context *ctx,
 
          util_range_add(&res->b, &res->valid_buffer_range, buffers[i].buffer_offset,
                buffers[i].buffer_offset + buffers[i].buffer_size);
-         virgl_resource_dirty(res, 0);
+         virgl_resource_dirty_range(res, 0, buffers[i].buffer_offset,
+               buffers[i].buffer_offset + buffers[i].buffer_size);
       } else {
          virgl_encoder_write_dword(ctx->cbuf, 0);
          virgl_encoder_write_dword(ctx->cbuf, 0);
@@ -1358,7 +1406,8 @@ int virgl_encode_set_hw_atomic_buffers(struct virgl_context *ctx,
 
          util_range_add(&res->b, &res->valid_buffer_range, buffers[i].buffer_offset,
                buffers[i].buffer_offset + buffers[i].buffer_size);
-         virgl_resource_dirty(res, 0);
+         virgl_resource_dirty_range(res, 0, buffers[i].buffer_offset,
+               buffers[i].buffer_offset + buffers[i].buffer_size);
       } else {
          virgl_encoder_write_dword(ctx->cbuf, 0);
          virgl_encoder_write_dword(ctx->cbuf, 0);
@@ -1390,8 +1439,12 @@ int virgl_encode_set_shader_images(struct virgl_context *ctx,
          if (res->b.target == PIPE_BUFFER) {
             util_range_add(&res->b, &res->valid_buffer_range, images[i].u.buf.offset,
                   images[i].u.buf.offset + images[i].u.buf.size);
+            virgl_resource_dirty_range(res, 0, images[i].u.buf.offset,
+                  images[i].u.buf.offset + images[i].u.buf.size);
+         } else {
+            virgl_resource_dirty_range(res, images[i].u.tex.level,
+                  images[i].u.tex.first_layer, images[i].u.tex.last_layer + 1);
          }
-         virgl_resource_dirty(res, images[i].u.tex.level);
       } else {
          virgl_encoder_write_dword(ctx->cbuf, 0);
          virgl_encoder_write_dword(ctx->cbuf, 0);
@@ -97,6 +97,25 @@ extern int virgl_encode_shader_state(struct virgl_context *ctx,
                                      uint32_t cs_req_local_mem,
                                      const struct tgsi_token *tokens);
 
+/* Dumps tokens into the text form sent to the host.  The returned string
+ * must be freed with FREE().
+ */
+char *virgl_encode_shader_text(const struct tgsi_token *tokens,
+                               int *num_tokens);
+
+/* Sends size bytes of shader, either the NUL terminated text or, when
+ * binary is set, the raw tokens (VIRGL_CAP_V2_TGSI_BINARY).
+ */
+int virgl_encode_shader_payload_state(struct virgl_context *ctx,
+                                      uint32_t handle,
+                                      enum pipe_shader_type type,
+                                      const struct pipe_stream_output_info *so_info,
+                                      uint32_t cs_req_local_mem,
+                                      const void *data,
+                                      uint32_t size,
+                                      int num_tokens,
+                                      bool binary);
+
 int virgl_encode_stream_output_info(struct virgl_context *ctx,
                                    uint32_t handle,
                                    uint32_t type,
@@ -124,6 +143,9 @@ int virgl_encode_clear_texture(struct virgl_context *ctx,
                                const struct pipe_box *box,
                                const void *data);
 
+int virgl_encode_invalidate_resource(struct virgl_context *ctx,
+                                     struct virgl_resource *res);
+
 int virgl_encode_bind_object(struct virgl_context *ctx,
                             uint32_t handle, uint32_t object);
 int virgl_encode_delete_object(struct virgl_context *ctx,
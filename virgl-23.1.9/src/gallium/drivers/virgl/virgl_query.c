@@ -30,7 +30,11 @@
 #include "virgl_screen.h"
 
 struct virgl_query {
+   /* The state lives at buf_offset within a buffer shared with other
+    * queries of the same context.
+    */
    struct virgl_resource *buf;
+   uint32_t buf_offset;
    uint32_t handle;
    uint32_t result_size;
 
@@ -79,6 +83,28 @@ static inline struct virgl_query *virgl_query(struct pipe_query *q)
    return (struct virgl_query *)q;
 }
 
+static inline volatile struct virgl_host_query_state *
+virgl_query_host_state(struct virgl_winsys *vws, struct virgl_query *query)
+{
+   uint8_t *map = vws->resource_map(vws, query->buf->hw_res);
+
+   if (!map)
+      return NULL;
+
+   return (volatile struct virgl_host_query_state *)(map + query->buf_offset);
+}
+
+static void virgl_query_read_result(struct virgl_query *query,
+                                    volatile struct virgl_host_query_state *host_state)
+{
+   if (query->result_size == 8)
+      query->result = host_state->result;
+   else
+      query->result = (uint32_t) host_state->result;
+
+   query->ready = true;
+}
+
 static void virgl_render_condition(struct pipe_context *ctx,
                                   struct pipe_query *q,
                                   bool condition,
@@ -102,9 +128,11 @@ static struct pipe_query *virgl_create_query(struct pipe_context *ctx,
    if (!query)
       return NULL;
 
-   query->buf = (struct virgl_resource *)
-      pipe_buffer_create(ctx->screen, PIPE_BIND_CUSTOM, PIPE_USAGE_STAGING,
-                         sizeof(struct virgl_host_query_state));
+   u_suballocator_alloc(&vctx->query_suballoc,
+                        sizeof(struct virgl_host_query_state),
+                        sizeof(struct virgl_host_query_state),
+                        &query->buf_offset,
+                        (struct pipe_resource **)&query->buf);
    if (!query->buf) {
       FREE(query);
       return NULL;
@@ -114,12 +142,16 @@ static struct pipe_query *virgl_create_query(struct pipe_context *ctx,
    query->result_size = (query_type == PIPE_QUERY_TIMESTAMP ||
                          query_type == PIPE_QUERY_TIME_ELAPSED) ? 8 : 4;
 
-   util_range_add(&query->buf->b, &query->buf->valid_buffer_range, 0,
-                  sizeof(struct virgl_host_query_state));
-   virgl_resource_dirty(query->buf, 0);
+   util_range_add(&query->buf->b, &query->buf->valid_buffer_range,
+                  query->buf_offset,
+                  query->buf_offset + sizeof(struct virgl_host_query_state));
+   virgl_resource_dirty_range(query->buf, 0, query->buf_offset,
+                              query->buf_offset +
+                              sizeof(struct virgl_host_query_state));
 
    virgl_encoder_create_query(vctx, query->handle,
-         pipe_to_virgl_query(query_type), index, query->buf, 0);
+         pipe_to_virgl_query(query_type), index, query->buf,
+         query->buf_offset);
 
    return (struct pipe_query *)query;
 }
@@ -153,9 +185,9 @@ static bool virgl_end_query(struct pipe_context *ctx,
    struct virgl_screen *vs = virgl_screen(ctx->screen);
    struct virgl_context *vctx = virgl_context(ctx);
    struct virgl_query *query = virgl_query(q);
-   struct virgl_host_query_state *host_state;
+   volatile struct virgl_host_query_state *host_state;
 
-   host_state = vs->vws->resource_map(vs->vws, query->buf->hw_res);
+   host_state = virgl_query_host_state(vs->vws, query);
    if (!host_state)
       return false;
 
@@ -184,15 +216,38 @@ static bool virgl_get_query_result(struct pipe_context *ctx,
       volatile struct virgl_host_query_state *host_state;
       struct pipe_transfer *transfer = NULL;
 
+      host_state = virgl_query_host_state(vs->vws, query);
+      if (!host_state)
+         return false;
+
+      /* A host that updates the state in place may already be done, and
+       * then there is no need to ask the winsys about the buffer at all.
+       */
+      if (host_state->query_state == VIRGL_QUERY_STATE_DONE) {
+         vctx->query_state_coherent = true;
+         virgl_query_read_result(query, host_state);
+         result->u64 = query->result;
+         return true;
+      }
+
       if (vs->vws->res_is_referenced(vs->vws, vctx->cbuf, query->buf->hw_res))
          ctx->flush(ctx, NULL, 0);
 
+      /* The buffer is shared with the queries that ended after this one, so
+       * polling it for idleness says little.  Keep polling the state.
+       */
+      if (!wait && vctx->query_state_coherent)
+         return false;
+
+      virgl_submit_wait(vctx);
+
       if (wait)
          vs->vws->resource_wait(vs->vws, query->buf->hw_res);
       else if (vs->vws->resource_is_busy(vs->vws, query->buf->hw_res))
          return false;
 
-      host_state = vs->vws->resource_map(vs->vws, query->buf->hw_res);
+      if (host_state->query_state == VIRGL_QUERY_STATE_DONE)
+         vctx->query_state_coherent = true;
 
       /* The resource is idle and the result should be available at this point,
        * unless we are dealing with an older host.  In that case,
@@ -209,19 +264,15 @@ static bool virgl_get_query_result(struct pipe_context *ctx,
                return false;
          }
 
-         host_state = pipe_buffer_map(ctx, &query->buf->b,
+         host_state = pipe_buffer_map_range(ctx, &query->buf->b,
+               query->buf_offset, sizeof(struct virgl_host_query_state),
                PIPE_MAP_READ, &transfer);
       }
 
-      if (query->result_size == 8)
-         query->result = host_state->result;
-      else
-         query->result = (uint32_t) host_state->result;
+      virgl_query_read_result(query, host_state);
 
       if (transfer)
          pipe_buffer_unmap(ctx, transfer);
-
-      query->ready = true;
    }
 
    result->u64 = query->result;
@@ -98,6 +98,15 @@ static bool virgl_can_copy_transfer_from_host(struct virgl_screen *vs,
                                               struct virgl_resource *res,
                                               int bind)
 {
+   /* Compressed formats are never readback formats, their reads take the
+    * resolve path.  Uploads can still go through staging, skipping the
+    * guest copy of the texture, as a GL host copies blocks both ways.
+    */
+   if (util_format_is_compressed(res->b.format))
+      return virgl_can_use_staging(vs, res) &&
+             !(bind & VIRGL_BIND_SHARED) &&
+             !(vs->caps.caps.v2.capability_bits & VIRGL_CAP_HOST_IS_GLES);
+
    return virgl_can_use_staging(vs, res) &&
          !is_stencil_array(res) &&
          !(bind & VIRGL_BIND_SHARED) &&
@@ -128,11 +137,46 @@ static bool virgl_res_needs_flush(struct virgl_context *vctx,
    return true;
 }
 
+/* Returns the extent of box along the dimension that virgl_dirty_range
+ * tracks for the resource's target.
+ */
+static void
+virgl_box_dirty_extent(const struct virgl_resource *res,
+                       const struct pipe_box *box,
+                       uint32_t *start, uint32_t *end)
+{
+   int first, count;
+
+   switch (res->b.target) {
+   case PIPE_BUFFER:
+      first = box->x;
+      count = box->width;
+      break;
+   case PIPE_TEXTURE_1D_ARRAY:
+      first = box->y;
+      count = box->height;
+      break;
+   default:
+      first = box->z;
+      count = box->depth;
+      break;
+   }
+
+   if (count < 0) {
+      first += count;
+      count = -count;
+   }
+
+   *start = MAX2(first, 0);
+   *end = MAX2(first + count, 0);
+}
+
 /* We need to read back from the host storage to make sure the guest storage
  * is up-to-date.  But there are cases where the readback can be skipped:
  *
  *  - the content can be discarded
  *  - the host storage is read-only
+ *  - the host never wrote to the mapped region
  *
  * Note that PIPE_MAP_WRITE without discard bits requires readback.
  * PIPE_MAP_READ becomes irrelevant.  PIPE_MAP_UNSYNCHRONIZED and
@@ -140,8 +184,12 @@ static bool virgl_res_needs_flush(struct virgl_context *vctx,
  */
 static bool virgl_res_needs_readback(struct virgl_context *vctx,
                                      struct virgl_resource *res,
-                                     unsigned usage, unsigned level)
+                                     unsigned usage, unsigned level,
+                                     const struct pipe_box *box)
 {
+   const struct virgl_dirty_range *range;
+   uint32_t start, end;
+
    if (usage & (PIPE_MAP_DISCARD_RANGE |
                 PIPE_MAP_DISCARD_WHOLE_RESOURCE))
       return false;
@@ -149,6 +197,14 @@ static bool virgl_res_needs_readback(struct virgl_context *vctx,
    if (res->clean_mask & (1 << level))
       return false;
 
+   /* The host never wrote to the mapped region. */
+   range = res->b.target == PIPE_BUFFER ?
+           &res->dirty_buffer : &res->dirty_layers[level];
+   virgl_box_dirty_extent(res, box, &start, &end);
+   if ((end <= range->start || start >= range->end) &&
+       likely(!(virgl_debug & VIRGL_DEBUG_XFER)))
+      return false;
+
    return true;
 }
 
@@ -179,7 +235,7 @@ virgl_resource_transfer_prepare(struct virgl_context *vctx,
 
    flush = virgl_res_needs_flush(vctx, xfer);
    readback = virgl_res_needs_readback(vctx, res, xfer->base.usage,
-                                       xfer->base.level);
+                                       xfer->base.level, &xfer->base.box);
    /* We need to wait for all cmdbufs, current or previous, that access the
     * resource to finish unless synchronization is disabled.
     */
@@ -199,6 +255,9 @@ virgl_resource_transfer_prepare(struct virgl_context *vctx,
       wait = false;
    }
 
+   if (wait || readback)
+      virgl_submit_wait(vctx);
+
    /* When the resource is busy but its content can be discarded, we can
     * replace its HW resource or use a staging buffer to avoid waiting.
     */
@@ -263,8 +322,11 @@ virgl_resource_transfer_prepare(struct virgl_context *vctx,
          flush = true;
    }
 
-   if (flush)
+   if (flush) {
       vctx->base.flush(&vctx->base, NULL, 0);
+      if (wait || readback)
+         virgl_submit_wait(vctx);
+   }
 
    /* If we are not allowed to block, and we know that we will have to wait,
     * either because the resource is busy, or because it will become busy due
@@ -374,6 +436,8 @@ virgl_staging_map(struct virgl_context *vctx,
                   vtransfer->base.box.x % VIRGL_MAP_BUFFER_ALIGNMENT :
                   0;
 
+   /* The staging manager reuses buffers that the winsys reports idle. */
+   virgl_submit_wait(vctx);
    alloc_succeeded =
       virgl_staging_alloc(&vctx->staging, size + align_offset,
                           VIRGL_MAP_BUFFER_ALIGNMENT,
@@ -390,7 +454,8 @@ virgl_staging_map(struct virgl_context *vctx,
        * without going through the corresponding guest side resource, and
        * hence the two will diverge.
        */
-      virgl_resource_dirty(vres, vtransfer->base.level);
+      virgl_resource_dirty_box(vres, vtransfer->base.level,
+                               &vtransfer->base.box);
 
       /* We are using the minimum required size to hold the contents,
        * possibly using a layout different from the layout of the resource,
@@ -432,6 +497,7 @@ virgl_staging_read_map(struct virgl_context *vctx,
    vtransfer->direction = VIRGL_TRANSFER_FROM_HOST;
    virgl_encode_copy_transfer(vctx, vtransfer);
    vctx->base.flush(&vctx->base, NULL, 0);
+   virgl_submit_wait(vctx);
    vws->resource_wait(vws, vtransfer->copy_src_hw_res);
    return map_addr;
 }
@@ -919,6 +985,7 @@ void virgl_resource_destroy_transfer(struct virgl_context *vctx,
    struct virgl_winsys *vws = virgl_screen(vctx->base.screen)->vws;
 
    vws->resource_reference(vws, &trans->copy_src_hw_res, NULL);
+   free(trans->translate_map);
 
    util_range_destroy(&trans->range);
    vws->resource_reference(vws, &trans->hw_res, NULL);
@@ -958,10 +1025,42 @@ bool virgl_resource_get_handle(struct pipe_screen *screen,
 
 void virgl_resource_dirty(struct virgl_resource *res, uint32_t level)
 {
-   if (res) {
-      if (res->b.target == PIPE_BUFFER)
-         res->clean_mask &= ~1;
-      else
-         res->clean_mask &= ~(1 << level);
+   virgl_resource_dirty_range(res, level, 0, UINT32_MAX);
+}
+
+void virgl_resource_dirty_range(struct virgl_resource *res, uint32_t level,
+                                uint32_t start, uint32_t end)
+{
+   struct virgl_dirty_range *range;
+
+   if (!res)
+      return;
+
+   if (res->b.target == PIPE_BUFFER) {
+      level = 0;
+      range = &res->dirty_buffer;
+   } else {
+      range = &res->dirty_layers[level];
    }
+
+   if (res->clean_mask & (1 << level)) {
+      res->clean_mask &= ~(1 << level);
+      range->start = start;
+      range->end = end;
+   } else {
+      range->start = MIN2(range->start, start);
+      range->end = MAX2(range->end, end);
+   }
+}
+
+void virgl_resource_dirty_box(struct virgl_resource *res, uint32_t level,
+                              const struct pipe_box *box)
+{
+   uint32_t start, end;
+
+   if (!res)
+      return;
+
+   virgl_box_dirty_extent(res, box, &start, &end);
+   virgl_resource_dirty_range(res, level, start, end);
 }
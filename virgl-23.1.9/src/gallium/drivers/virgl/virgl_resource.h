@@ -27,6 +27,7 @@
 #include "util/u_resource.h"
 #include "util/u_range.h"
 #include "util/list.h"
+#include "util/rb_tree.h"
 #include "util/u_transfer.h"
 
 #include "virtio-gpu/virgl_hw.h"
@@ -38,6 +39,13 @@
 #define VIRGL_BLOB_MEM_HOST3D_GUEST 3
 
 struct winsys_handle;
+
+/* A half-open [start, end) interval. */
+struct virgl_dirty_range {
+   uint32_t start;
+   uint32_t end;
+};
+
 struct virgl_screen;
 struct virgl_context;
 
@@ -69,6 +77,16 @@ struct virgl_resource {
    uint32_t blob_mem;
 
    uint16_t clean_mask;
+
+   /* What the host may have written while the matching clean_mask bit is
+    * clear: a byte range for buffers, and a layer range per level for
+    * textures.  Lets maps of untouched regions skip the readback.
+    */
+   union {
+      struct virgl_dirty_range dirty_buffer;
+      struct virgl_dirty_range dirty_layers[VR_MAX_TEXTURE_2D_LEVELS];
+   };
+
    uint16_t use_staging : 1;
    uint16_t reserved : 15;
 };
@@ -78,6 +96,7 @@ struct virgl_transfer {
    uint32_t offset, l_stride;
    struct util_range range;
    struct list_head queue_link;
+   struct rb_node queue_node;
    struct pipe_transfer *resolve_transfer;
 
    struct virgl_hw_res *hw_res;
@@ -91,6 +110,10 @@ struct virgl_transfer {
    uint32_t copy_src_offset;
    /* copy transfers can be performed to and from host */
    uint32_t direction;
+   /* Holds the box of a resolve-path read for resources without a guest
+    * copy (use_staging), in the transfer's strides.
+    */
+   void *translate_map;
 };
 
 void virgl_resource_destroy(struct pipe_screen *screen,
@@ -207,6 +230,15 @@ bool virgl_resource_get_handle(struct pipe_screen *screen,
 
 void virgl_resource_dirty(struct virgl_resource *res, uint32_t level);
 
+/* Like virgl_resource_dirty(), limited to bytes [start, end) of a buffer
+ * or layers [start, end) of a texture level.
+ */
+void virgl_resource_dirty_range(struct virgl_resource *res, uint32_t level,
+                                uint32_t start, uint32_t end);
+
+void virgl_resource_dirty_box(struct virgl_resource *res, uint32_t level,
+                              const struct pipe_box *box);
+
 void *virgl_texture_transfer_map(struct pipe_context *ctx,
                                  struct pipe_resource *resource,
                                  unsigned level,
@@ -28,7 +28,9 @@
 #include "util/u_math.h"
 #include "util/u_inlines.h"
 #include "util/os_time.h"
+#include "util/hash_table.h"
 #include "util/xmlconfig.h"
+#include "util/perf/cpu_trace.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "nir/nir_to_tgsi.h"
@@ -946,6 +948,166 @@ static int virgl_fence_get_fd(struct pipe_screen *screen,
    return vws->fence_get_fd(vws, fence);
 }
 
+/* Bounds the memory kept for shaders, entries past that limit only
+ * go to the disk cache.
+ */
+#define VIRGL_SHADER_CACHE_MAX_SIZE (32 * 1024 * 1024)
+
+static uint32_t
+virgl_shader_cache_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, 20);
+}
+
+static bool
+virgl_shader_cache_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, 20) == 0;
+}
+
+static void
+virgl_shader_cache_entry_free(struct hash_entry *entry)
+{
+   FREE(entry->data);
+}
+
+static struct virgl_shader_cache_entry *
+virgl_shader_cache_entry_create(const uint8_t key[20], const void *data,
+                                uint32_t size, int num_tokens)
+{
+   struct virgl_shader_cache_entry *entry = MALLOC(sizeof(*entry) + size);
+   if (!entry)
+      return NULL;
+
+   memcpy(entry->key, key, sizeof(entry->key));
+   entry->in_memory = false;
+   entry->num_tokens = num_tokens;
+   entry->size = size;
+   memcpy(entry->data, data, size);
+
+   return entry;
+}
+
+/* Adds entry to the memory cache unless that would exceed the budget.
+ * Returns the entry to use, which is the already cached one when another
+ * context translated the same shader meanwhile.
+ */
+static struct virgl_shader_cache_entry *
+virgl_shader_cache_insert(struct virgl_screen *vs,
+                          struct virgl_shader_cache_entry *entry)
+{
+   simple_mtx_lock(&vs->shader_cache_mutex);
+
+   struct hash_entry *he = _mesa_hash_table_search(vs->shader_cache, entry->key);
+   if (he) {
+      FREE(entry);
+      entry = he->data;
+   } else if (vs->shader_cache_size + entry->size <= VIRGL_SHADER_CACHE_MAX_SIZE) {
+      entry->in_memory = true;
+      _mesa_hash_table_insert(vs->shader_cache, entry->key, entry);
+      vs->shader_cache_size += entry->size;
+   }
+
+   simple_mtx_unlock(&vs->shader_cache_mutex);
+
+   return entry;
+}
+
+/* Whether a disk cache payload is well formed for the transport in use.
+ * The mode is part of the cache identity, this only guards against
+ * truncated files.
+ */
+static bool
+virgl_shader_cache_payload_valid(const struct virgl_screen *vs,
+                                 const uint8_t *data, size_t size,
+                                 int32_t num_tokens)
+{
+   if (!size || num_tokens < 0)
+      return false;
+
+   if (vs->binary_shaders)
+      return size == (size_t)num_tokens * sizeof(struct tgsi_token);
+
+   return data[size - 1] == '\0';
+}
+
+const struct virgl_shader_cache_entry *
+virgl_shader_cache_find(struct virgl_screen *vs, const uint8_t key[20])
+{
+   struct virgl_shader_cache_entry *entry = NULL;
+   cache_key disk_key;
+   size_t size;
+
+   simple_mtx_lock(&vs->shader_cache_mutex);
+   struct hash_entry *he = _mesa_hash_table_search(vs->shader_cache, key);
+   simple_mtx_unlock(&vs->shader_cache_mutex);
+   if (he)
+      return he->data;
+
+   if (!vs->disk_cache)
+      return NULL;
+
+   /* The disk entry is the token count followed by the payload sent to the
+    * host: the NUL terminated shader text, or the tokens themselves.
+    */
+   disk_cache_compute_key(vs->disk_cache, key, 20, disk_key);
+   uint8_t *blob = disk_cache_get(vs->disk_cache, disk_key, &size);
+   if (!blob)
+      return NULL;
+
+   if (size > sizeof(int32_t)) {
+      const uint8_t *data = blob + sizeof(int32_t);
+      const size_t len = size - sizeof(int32_t);
+      int32_t num_tokens;
+
+      memcpy(&num_tokens, blob, sizeof(num_tokens));
+      if (virgl_shader_cache_payload_valid(vs, data, len, num_tokens)) {
+         entry = virgl_shader_cache_entry_create(key, data, len, num_tokens);
+         if (entry)
+            entry = virgl_shader_cache_insert(vs, entry);
+      }
+   }
+
+   free(blob);
+   return entry;
+}
+
+const struct virgl_shader_cache_entry *
+virgl_shader_cache_add(struct virgl_screen *vs, const uint8_t key[20],
+                       const void *data, uint32_t size, int num_tokens)
+{
+   struct virgl_shader_cache_entry *entry =
+      virgl_shader_cache_entry_create(key, data, size, num_tokens);
+   if (!entry)
+      return NULL;
+
+   if (vs->disk_cache) {
+      const size_t blob_size = sizeof(int32_t) + size;
+      cache_key disk_key;
+      uint8_t *blob = MALLOC(blob_size);
+
+      if (blob) {
+         const int32_t tokens = num_tokens;
+
+         memcpy(blob, &tokens, sizeof(tokens));
+         memcpy(blob + sizeof(tokens), data, size);
+
+         disk_cache_compute_key(vs->disk_cache, key, 20, disk_key);
+         disk_cache_put(vs->disk_cache, disk_key, blob, blob_size, NULL);
+         FREE(blob);
+      }
+   }
+
+   return virgl_shader_cache_insert(vs, entry);
+}
+
+void
+virgl_shader_cache_release(const struct virgl_shader_cache_entry *entry)
+{
+   if (entry && !entry->in_memory)
+      FREE((void *)entry);
+}
+
 static void
 virgl_destroy_screen(struct pipe_screen *screen)
 {
@@ -959,6 +1121,9 @@ virgl_destroy_screen(struct pipe_screen *screen)
 
    disk_cache_destroy(vscreen->disk_cache);
 
+   _mesa_hash_table_destroy(vscreen->shader_cache, virgl_shader_cache_entry_free);
+   simple_mtx_destroy(&vscreen->shader_cache_mutex);
+
    FREE(vscreen);
 }
 
@@ -1002,6 +1167,7 @@ static void virgl_query_memory_info(struct pipe_screen *screen, struct pipe_memo
 
    virgl_encode_get_memory_info(vctx, res);
    ctx->flush(ctx, NULL, 0);
+   virgl_submit_wait(vctx);
    vscreen->vws->resource_wait(vscreen->vws, res->hw_res);
    pipe_buffer_read(ctx, &res->b, 0, sizeof(struct virgl_memory_info), &virgl_info);
 
@@ -1122,12 +1288,15 @@ virgl_create_screen(struct virgl_winsys *vws, const struct pipe_screen_config *c
    const char *VIRGL_GLES_APPLY_BGRA_DEST_SWIZZLE = "gles_apply_bgra_dest_swizzle";
    const char *VIRGL_GLES_SAMPLES_PASSED_VALUE = "gles_samples_passed_value";
    const char *VIRGL_FORMAT_L8_SRGB_ENABLE_READBACK = "format_l8_srgb_enable_readback";
+   const char *VIRGL_THREADED_SUBMIT = "virgl_threaded_submit";
 
    if (!screen)
       return NULL;
 
    virgl_debug = debug_get_option_virgl_debug();
 
+   util_cpu_trace_init();
+
    if (config && config->options) {
       driParseConfigFiles(config->options, config->options_info, 0, "virtio_gpu",
                           NULL, NULL, NULL, 0, NULL, 0);
@@ -1140,7 +1309,12 @@ virgl_create_screen(struct virgl_winsys *vws, const struct pipe_screen_config *c
             driQueryOptioni(config->options, VIRGL_GLES_SAMPLES_PASSED_VALUE);
       screen->tweak_l8_srgb_readback =
             driQueryOptionb(config->options, VIRGL_FORMAT_L8_SRGB_ENABLE_READBACK);
+      screen->threaded_submit =
+            driQueryOptionb(config->options, VIRGL_THREADED_SUBMIT);
    }
+   /* the environment overrides the application profile either way */
+   screen->threaded_submit =
+         debug_get_bool_option("VIRGL_THREADED_SUBMIT", screen->threaded_submit);
    screen->tweak_gles_emulate_bgra &= !(virgl_debug & VIRGL_DEBUG_NO_EMULATE_BGRA);
    screen->tweak_gles_apply_bgra_dest_swizzle &= !(virgl_debug & VIRGL_DEBUG_NO_BGRA_DEST_SWIZZLE);
    screen->no_coherent = virgl_debug & VIRGL_DEBUG_NO_COHERENT;
@@ -1181,6 +1355,7 @@ virgl_create_screen(struct virgl_winsys *vws, const struct pipe_screen_config *c
 
    union virgl_caps *caps = &screen->caps.caps;
    screen->tweak_gles_emulate_bgra &= !virgl_format_check_bitmask(PIPE_FORMAT_B8G8R8A8_SRGB, caps->v1.render.bitmask, false);
+   screen->binary_shaders = !!(caps->v2.capability_bits_v2 & VIRGL_CAP_V2_TGSI_BINARY);
    screen->refcnt = 1;
 
    /* Set up the NIR shader compiler options now that we've figured out the caps. */
@@ -1202,5 +1377,9 @@ virgl_create_screen(struct virgl_winsys *vws, const struct pipe_screen_config *c
    slab_create_parent(&screen->transfer_pool, sizeof(struct virgl_transfer), 16);
 
    virgl_disk_cache_create(screen);
+
+   simple_mtx_init(&screen->shader_cache_mutex, mtx_plain);
+   screen->shader_cache = _mesa_hash_table_create(NULL, virgl_shader_cache_key_hash,
+                                                  virgl_shader_cache_key_equal);
    return &screen->base;
 }
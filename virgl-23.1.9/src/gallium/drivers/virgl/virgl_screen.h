@@ -26,6 +26,7 @@
 #include "pipe/p_screen.h"
 #include "util/slab.h"
 #include "util/disk_cache.h"
+#include "util/simple_mtx.h"
 #include "virgl_winsys.h"
 #include "compiler/nir/nir.h"
 #include "virtio-gpu/virgl_protocol.h"
@@ -64,11 +65,31 @@ struct virgl_screen {
    bool tweak_gles_apply_bgra_dest_swizzle;
    bool tweak_l8_srgb_readback;
    bool no_coherent;
+   bool threaded_submit;
+   /* the host takes TGSI tokens as they are, no need for text */
+   bool binary_shaders;
    int32_t tweak_gles_tf3_value;
 
    nir_shader_compiler_options compiler_options;
 
    struct disk_cache *disk_cache;
+
+   /* Shaders as sent to the host, keyed by the hash of the shader IR they
+    * were translated from.
+    */
+   simple_mtx_t shader_cache_mutex;
+   struct hash_table *shader_cache;
+   size_t shader_cache_size;
+};
+
+struct virgl_shader_cache_entry {
+   uint8_t key[20];
+   /* Owned by the screen's cache, otherwise by whoever looked it up. */
+   bool in_memory;
+   int num_tokens;
+   /* TGSI text including its NUL, or the tokens with binary_shaders */
+   uint32_t size;
+   uint8_t data[];
 };
 
 
@@ -78,6 +99,16 @@ virgl_screen(struct pipe_screen *pipe)
    return (struct virgl_screen *)pipe;
 }
 
+const struct virgl_shader_cache_entry *
+virgl_shader_cache_find(struct virgl_screen *vs, const uint8_t key[20]);
+
+const struct virgl_shader_cache_entry *
+virgl_shader_cache_add(struct virgl_screen *vs, const uint8_t key[20],
+                       const void *data, uint32_t size, int num_tokens);
+
+void
+virgl_shader_cache_release(const struct virgl_shader_cache_entry *entry);
+
 bool
 virgl_has_readback_format(struct pipe_screen *screen, enum virgl_formats fmt,
                           bool allow_tweak);
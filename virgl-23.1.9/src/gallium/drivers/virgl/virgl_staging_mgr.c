@@ -32,47 +32,79 @@
 #include "virgl_resource.h"
 
 static bool
-virgl_staging_alloc_buffer(struct virgl_staging_mgr *staging, unsigned min_size)
+virgl_staging_alloc_buffer(struct virgl_staging_mgr *staging,
+                           struct virgl_staging_buffer *buf,
+                           unsigned min_size)
 {
    struct virgl_winsys *vws = staging->vws;
    unsigned size;
 
    /* Release the old buffer, if present:
     */
-   vws->resource_reference(vws, &staging->hw_res, NULL);
+   vws->resource_reference(vws, &buf->hw_res, NULL);
+   buf->size = 0;
 
    /* Allocate a new one:
     */
-   size = align(MAX2(staging->default_size, min_size), 4096);
-
-   staging->hw_res = vws->resource_create(vws,
-                                          PIPE_BUFFER,
-                                          NULL,
-                                          PIPE_FORMAT_R8_UNORM,
-                                          VIRGL_BIND_STAGING,
-                                          size,  /* width */
-                                          1,     /* height */
-                                          1,     /* depth */
-                                          1,     /* array_size */
-                                          0,     /* last_level */
-                                          0,     /* nr_samples */
-                                          0,     /* flags */
-                                          size); /* size */
-   if (staging->hw_res == NULL)
+   size = align(MAX2(staging->buffer_size, min_size), 4096);
+
+   buf->hw_res = vws->resource_create(vws,
+                                      PIPE_BUFFER,
+                                      NULL,
+                                      PIPE_FORMAT_R8_UNORM,
+                                      VIRGL_BIND_STAGING,
+                                      size,  /* width */
+                                      1,     /* height */
+                                      1,     /* depth */
+                                      1,     /* array_size */
+                                      0,     /* last_level */
+                                      0,     /* nr_samples */
+                                      0,     /* flags */
+                                      size); /* size */
+   if (buf->hw_res == NULL)
       return false;
 
-   staging->map = vws->resource_map(vws, staging->hw_res);
-   if (staging->map == NULL) {
-      vws->resource_reference(vws, &staging->hw_res, NULL);
+   buf->map = vws->resource_map(vws, buf->hw_res);
+   if (buf->map == NULL) {
+      vws->resource_reference(vws, &buf->hw_res, NULL);
       return false;
    }
 
-   staging->offset = 0;
-   staging->size = size;
+   buf->size = size;
+   buf->submitted = false;
 
    return true;
 }
 
+/* Moves on to the next buffer of the ring.  The buffer found there is the
+ * oldest one, it is reused when everything that read from it has finished.
+ * Otherwise it is replaced by a new buffer and, since the ring wrapped
+ * around faster than the host consumes it, later buffers are made larger.
+ */
+static bool
+virgl_staging_next_buffer(struct virgl_staging_mgr *staging, unsigned min_size)
+{
+   struct virgl_winsys *vws = staging->vws;
+   struct virgl_staging_buffer *buf;
+
+   staging->index = (staging->index + 1) % VIRGL_STAGING_RING_SIZE;
+   staging->offset = 0;
+   buf = &staging->ring[staging->index];
+
+   if (buf->hw_res && buf->submitted && buf->size >= min_size &&
+       !vws->resource_is_busy(vws, buf->hw_res)) {
+      buf->submitted = false;
+      return true;
+   }
+
+   if (buf->hw_res)
+      staging->buffer_size = MIN2(staging->buffer_size * 2,
+                                  MAX2(VIRGL_STAGING_MAX_BUFFER_SIZE,
+                                       staging->default_size));
+
+   return virgl_staging_alloc_buffer(staging, buf, min_size);
+}
+
 void
 virgl_staging_init(struct virgl_staging_mgr *staging, struct pipe_context *pipe,
                    unsigned default_size)
@@ -81,13 +113,35 @@ virgl_staging_init(struct virgl_staging_mgr *staging, struct pipe_context *pipe,
 
    staging->vws = virgl_screen(pipe->screen)->vws;
    staging->default_size = default_size;
+   staging->buffer_size = default_size;
 }
 
 void
 virgl_staging_destroy(struct virgl_staging_mgr *staging)
 {
    struct virgl_winsys *vws = staging->vws;
-   vws->resource_reference(vws, &staging->hw_res, NULL);
+
+   for (unsigned i = 0; i < VIRGL_STAGING_RING_SIZE; i++)
+      vws->resource_reference(vws, &staging->ring[i].hw_res, NULL);
+}
+
+void
+virgl_staging_flush(struct virgl_staging_mgr *staging)
+{
+   for (unsigned i = 0; i < VIRGL_STAGING_RING_SIZE; i++)
+      staging->ring[i].submitted = true;
+
+   /* Size the buffers so that the uploads of one submission fill no more
+    * than half of the ring, and the other half can still be in flight.
+    */
+   const unsigned wanted = staging->flush_bytes / (VIRGL_STAGING_RING_SIZE / 2);
+   if (wanted > staging->buffer_size) {
+      staging->buffer_size = MIN2(align(wanted, 4096),
+                                  MAX2(VIRGL_STAGING_MAX_BUFFER_SIZE,
+                                       staging->default_size));
+   }
+
+   staging->flush_bytes = 0;
 }
 
 bool
@@ -99,6 +153,7 @@ virgl_staging_alloc(struct virgl_staging_mgr *staging,
                     void **ptr)
 {
    struct virgl_winsys *vws = staging->vws;
+   struct virgl_staging_buffer *buf = &staging->ring[staging->index];
    unsigned offset = align(staging->offset, alignment);
 
    assert(out_offset);
@@ -109,29 +164,31 @@ virgl_staging_alloc(struct virgl_staging_mgr *staging,
    /* Make sure we have enough space in the staging buffer
     * for the sub-allocation.
     */
-   if (offset + size > staging->size) {
-      if (unlikely(!virgl_staging_alloc_buffer(staging, size))) {
+   if (offset + size > buf->size) {
+      if (unlikely(!virgl_staging_next_buffer(staging, size))) {
          *out_offset = ~0;
          vws->resource_reference(vws, outbuf, NULL);
          *ptr = NULL;
          return false;
       }
 
+      buf = &staging->ring[staging->index];
       offset = 0;
    }
 
-   assert(staging->size);
-   assert(staging->hw_res);
-   assert(staging->map);
-   assert(offset < staging->size);
-   assert(offset + size <= staging->size);
+   assert(buf->size);
+   assert(buf->hw_res);
+   assert(buf->map);
+   assert(offset < buf->size);
+   assert(offset + size <= buf->size);
 
    /* Emit the return values: */
-   *ptr = staging->map + offset;
-   vws->resource_reference(vws, outbuf, staging->hw_res);
+   *ptr = buf->map + offset;
+   vws->resource_reference(vws, outbuf, buf->hw_res);
    *out_offset = offset;
 
    staging->offset = offset + size;
+   staging->flush_bytes += size;
 
    return true;
 }
@@ -35,13 +35,33 @@ struct virgl_winsys;
 extern "C" {
 #endif
 
+/* Number of staging buffers the manager cycles through. */
+#define VIRGL_STAGING_RING_SIZE 4
+
+/* Upper bound for the adaptive staging buffer size, in bytes. */
+#define VIRGL_STAGING_MAX_BUFFER_SIZE (8 * 1024 * 1024)
+
+struct virgl_staging_buffer {
+   struct virgl_hw_res *hw_res;
+   uint8_t *map;
+   unsigned size;
+   /* Set once the commands reading from this buffer have been submitted,
+    * i.e. once the winsys busy tracking covers all of its users.
+    */
+   bool submitted;
+};
+
 struct virgl_staging_mgr {
    struct virgl_winsys *vws;
    unsigned default_size;  /* Minimum size of the staging buffer, in bytes. */
-   struct virgl_hw_res *hw_res;   /* Staging buffer hw_res. */
-   unsigned size;   /* Current staging buffer size. */
-   uint8_t *map;    /* Pointer to the mapped staging buffer. */
+   unsigned buffer_size;   /* Size of newly allocated staging buffers. */
    unsigned offset; /* Offset pointing at the first unused buffer byte. */
+
+   /* Ring of staging buffers, ring[index] is the current one. */
+   struct virgl_staging_buffer ring[VIRGL_STAGING_RING_SIZE];
+   unsigned index;
+   /* Bytes handed out since the last virgl_staging_flush(). */
+   unsigned flush_bytes;
 };
 
 /**
@@ -61,6 +81,13 @@ virgl_staging_init(struct virgl_staging_mgr *staging, struct pipe_context *pipe,
 void
 virgl_staging_destroy(struct virgl_staging_mgr *staging);
 
+/**
+ * Tell the staging manager that all previous sub-allocations have been
+ * submitted, so buffers can be recycled once the winsys reports them idle.
+ */
+void
+virgl_staging_flush(struct virgl_staging_mgr *staging);
+
 /**
  * Sub-allocate new memory from the staging buffer.
  *
@@ -52,7 +52,8 @@ static struct pipe_stream_output_target *virgl_create_so_target(
    res->bind_history |= PIPE_BIND_STREAM_OUTPUT;
    util_range_add(&res->b, &res->valid_buffer_range, buffer_offset,
                   buffer_offset + buffer_size);
-   virgl_resource_dirty(res, 0);
+   virgl_resource_dirty_range(res, 0, buffer_offset,
+                              buffer_offset + buffer_size);
 
    virgl_encoder_create_so_target(vctx, handle, res, buffer_offset, buffer_size);
    return &t->base;
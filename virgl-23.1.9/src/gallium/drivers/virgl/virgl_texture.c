@@ -23,6 +23,7 @@
 #include "util/format/u_format.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
+#include "util/u_surface.h"
 
 #include "virgl_context.h"
 #include "virgl_encode.h"
@@ -181,15 +182,29 @@ static void *texture_transfer_map_resolve(struct pipe_context *ctx,
       if (usage & PIPE_MAP_READ) {
          struct virgl_winsys *vws = virgl_screen(ctx->screen)->vws;
          void *src = ptr;
-         ptr = vws->resource_map(vws, vtex->hw_res);
-         if (!ptr)
-            goto fail;
+         void *dst;
+         struct pipe_box dst_origin = *box;
+
+         if (vtex->use_staging) {
+            /* there is no guest copy of the texture to translate into */
+            trans->translate_map = malloc(trans->base.layer_stride * box->depth);
+            if (!trans->translate_map)
+               goto fail;
+            ptr = trans->translate_map;
+            dst = ptr;
+            dst_origin.x = dst_origin.y = dst_origin.z = 0;
+         } else {
+            ptr = vws->resource_map(vws, vtex->hw_res);
+            if (!ptr)
+               goto fail;
+            dst = ptr + vtex->metadata.level_offset[level];
+         }
 
          if (!util_format_translate_3d(resource->format,
-                                       ptr + vtex->metadata.level_offset[level],
+                                       dst,
                                        trans->base.stride,
                                        trans->base.layer_stride,
-                                       box->x, box->y, box->z,
+                                       dst_origin.x, dst_origin.y, dst_origin.z,
                                        fmt,
                                        src,
                                        trans->resolve_transfer->stride,
@@ -208,6 +223,8 @@ static void *texture_transfer_map_resolve(struct pipe_context *ctx,
       if ((usage & PIPE_MAP_WRITE) == 0)
          pipe_resource_reference(&trans->resolve_transfer->resource, NULL);
 
+      if (trans->translate_map)
+         return trans->translate_map;
       return ptr + trans->offset;
    }
 
@@ -249,11 +266,36 @@ static void flush_data(struct pipe_context *ctx,
                        const struct pipe_box *box)
 {
    struct virgl_winsys *vws = virgl_screen(ctx->screen)->vws;
+
+   virgl_submit_wait(virgl_context(ctx));
    vws->transfer_put(vws, trans->hw_res, box,
                      trans->base.stride, trans->l_stride, trans->offset,
                      trans->base.level);
 }
 
+/* Writes back a read-write resolve-path map of a resource without a guest
+ * copy, through a staging upload of the mapped box.
+ */
+static void upload_translated(struct pipe_context *ctx,
+                              struct virgl_transfer *trans)
+{
+   struct pipe_transfer *upload;
+   const struct pipe_box *box = &trans->base.box;
+   uint8_t *map = virgl_resource_transfer_map(ctx, trans->base.resource,
+                                              trans->base.level,
+                                              PIPE_MAP_WRITE | PIPE_MAP_DISCARD_RANGE,
+                                              box, &upload);
+   if (!map)
+      return;
+
+   util_copy_box(map, trans->base.resource->format,
+                 upload->stride, upload->layer_stride, 0, 0, 0,
+                 box->width, box->height, box->depth,
+                 trans->translate_map, trans->base.stride,
+                 trans->base.layer_stride, 0, 0, 0);
+   virgl_texture_transfer_unmap(ctx, upload);
+}
+
 void virgl_texture_transfer_unmap(struct pipe_context *ctx,
                                   struct pipe_transfer *transfer)
 {
@@ -264,7 +306,9 @@ void virgl_texture_transfer_unmap(struct pipe_context *ctx,
    if (transfer->usage & PIPE_MAP_WRITE &&
        (transfer->usage & PIPE_MAP_FLUSH_EXPLICIT) == 0) {
 
-      if (trans->resolve_transfer && (trans->base.resource->format ==
+      if (trans->translate_map) {
+         upload_translated(ctx, trans);
+      } else if (trans->resolve_transfer && (trans->base.resource->format ==
           trans->resolve_transfer->resource->format)) {
          flush_data(ctx, virgl_transfer(trans->resolve_transfer),
                     &trans->resolve_transfer->box);
@@ -38,9 +38,6 @@ struct list_action_args
    struct virgl_transfer *current;
 };
 
-typedef bool (*compare_transfers_t)(struct virgl_transfer *queued,
-                                    struct virgl_transfer *current);
-
 typedef void (*list_action_t)(struct virgl_transfer_queue *queue,
                               struct list_action_args *args);
 
@@ -48,8 +45,6 @@ struct list_iteration_args
 {
    void *data;
    list_action_t action;
-   compare_transfers_t compare;
-   struct virgl_transfer *current;
 };
 
 static int
@@ -136,6 +131,71 @@ transfer_overlap(const struct virgl_transfer *xfer,
    return true;
 }
 
+static inline struct virgl_transfer *
+transfer_from_node(const struct rb_node *node)
+{
+   return rb_node_data(struct virgl_transfer, node, queue_node);
+}
+
+/* Orders queued transfers by resource, then level, then the lowest x
+ * coordinate of their box.
+ */
+static int
+transfer_key_cmp(const struct virgl_transfer *xfer,
+                 const struct virgl_hw_res *hw_res,
+                 unsigned level, int x)
+{
+   int xfer_min, xfer_max;
+
+   if (xfer->hw_res != hw_res)
+      return xfer->hw_res < hw_res ? -1 : 1;
+   if (xfer->base.level != level)
+      return xfer->base.level < level ? -1 : 1;
+
+   box_min_max(&xfer->base.box, 0, &xfer_min, &xfer_max);
+   if (xfer_min != x)
+      return xfer_min < x ? -1 : 1;
+
+   return 0;
+}
+
+static int
+transfer_insert_cmp(const struct rb_node *a, const struct rb_node *b)
+{
+   const struct virgl_transfer *xfer = transfer_from_node(b);
+   int x_min, x_max;
+
+   box_min_max(&xfer->base.box, 0, &x_min, &x_max);
+   return transfer_key_cmp(transfer_from_node(a), xfer->hw_res,
+                           xfer->base.level, x_min);
+}
+
+static void
+transfer_tree_insert(struct virgl_transfer_queue *queue,
+                     struct virgl_transfer *xfer)
+{
+   int x_min, x_max;
+
+   box_min_max(&xfer->base.box, 0, &x_min, &x_max);
+   queue->max_width = MAX2(queue->max_width, x_max - x_min);
+
+   rb_tree_insert(&queue->transfer_tree, &xfer->queue_node,
+                  transfer_insert_cmp);
+}
+
+static void
+transfer_tree_remove(struct virgl_transfer_queue *queue,
+                     struct virgl_transfer *xfer)
+{
+   rb_tree_remove(&queue->transfer_tree, &xfer->queue_node);
+
+   /* max_width only ever grows while transfers are queued, it is a bound
+    * for the search below rather than an exact value.
+    */
+   if (rb_tree_is_empty(&queue->transfer_tree))
+      queue->max_width = 0;
+}
+
 static struct virgl_transfer *
 virgl_transfer_queue_find_overlap(const struct virgl_transfer_queue *queue,
                                   const struct virgl_hw_res *hw_res,
@@ -143,8 +203,40 @@ virgl_transfer_queue_find_overlap(const struct virgl_transfer_queue *queue,
                                   const struct pipe_box *box,
                                   bool include_touching)
 {
-   struct virgl_transfer *xfer;
-   LIST_FOR_EACH_ENTRY(xfer, &queue->transfer_list, queue_link) {
+   struct rb_node *node = queue->transfer_tree.root;
+   struct rb_node *first = NULL;
+   int box_min;
+   int box_max;
+
+   box_min_max(box, 0, &box_min, &box_max);
+
+   /* No queued transfer is wider than max_width, so anything starting
+    * before box_min - max_width ends before the box does.  Look for the
+    * first transfer of this resource and level past that point and walk
+    * forward until the transfers start beyond the box.
+    */
+   const int start = box_min - queue->max_width;
+   while (node) {
+      if (transfer_key_cmp(transfer_from_node(node), hw_res, level, start) >= 0) {
+         first = node;
+         node = node->left;
+      } else {
+         node = node->right;
+      }
+   }
+
+   for (node = first; node; node = rb_node_next(node)) {
+      struct virgl_transfer *xfer = transfer_from_node(node);
+      int xfer_min;
+      int xfer_max;
+
+      if (xfer->hw_res != hw_res || xfer->base.level != level)
+         break;
+
+      box_min_max(&xfer->base.box, 0, &xfer_min, &xfer_max);
+      if (include_touching ? xfer_min > box_max : xfer_min >= box_max)
+         break;
+
       if (transfer_overlap(xfer, hw_res, level, box, include_touching))
          return xfer;
    }
@@ -152,16 +244,10 @@ virgl_transfer_queue_find_overlap(const struct virgl_transfer_queue *queue,
    return NULL;
 }
 
-static bool transfers_intersect(struct virgl_transfer *queued,
-                                struct virgl_transfer *current)
-{
-   return transfer_overlap(queued, current->hw_res, current->base.level,
-         &current->base.box, true);
-}
-
 static void remove_transfer(struct virgl_transfer_queue *queue,
                             struct virgl_transfer *queued)
 {
+   transfer_tree_remove(queue, queued);
    list_del(&queued->queue_link);
    virgl_resource_destroy_transfer(queue->vctx, queued);
 }
@@ -205,24 +291,6 @@ static void transfer_write(struct virgl_transfer_queue *queue,
    remove_transfer(queue, queued);
 }
 
-static void compare_and_perform_action(struct virgl_transfer_queue *queue,
-                                       struct list_iteration_args *iter)
-{
-   struct list_action_args args;
-   struct virgl_transfer *queued, *tmp;
-
-   memset(&args, 0, sizeof(args));
-   args.current = iter->current;
-   args.data = iter->data;
-
-   LIST_FOR_EACH_ENTRY_SAFE(queued, tmp, &queue->transfer_list, queue_link) {
-      if (iter->compare(queued, iter->current)) {
-         args.queued = queued;
-         iter->action(queue, &args);
-      }
-   }
-}
-
 static void perform_action(struct virgl_transfer_queue *queue,
                            struct list_iteration_args *iter)
 {
@@ -252,12 +320,14 @@ static void add_internal(struct virgl_transfer_queue *queue,
          iter.data = queue->tbuf;
          perform_action(queue, &iter);
 
+         virgl_submit_wait(queue->vctx);
          vws->submit_cmd(vws, queue->tbuf, NULL);
          queue->num_dwords = 0;
       }
    }
 
    list_addtail(&transfer->queue_link, &queue->transfer_list);
+   transfer_tree_insert(queue, transfer);
    queue->num_dwords += dwords;
 }
 
@@ -271,6 +341,8 @@ void virgl_transfer_queue_init(struct virgl_transfer_queue *queue,
    queue->num_dwords = 0;
 
    list_inithead(&queue->transfer_list);
+   rb_tree_init(&queue->transfer_tree);
+   queue->max_width = 0;
 
    if ((vs->caps.caps.v2.capability_bits & VIRGL_CAP_TRANSFER) &&
         vs->vws->supports_encoded_transfers)
@@ -301,18 +373,24 @@ void virgl_transfer_queue_fini(struct virgl_transfer_queue *queue)
 int virgl_transfer_queue_unmap(struct virgl_transfer_queue *queue,
                                struct virgl_transfer *transfer)
 {
-   struct list_iteration_args iter;
-
    /* We don't support copy transfers in the transfer queue. */
    assert(!transfer->copy_src_hw_res);
 
-   /* Attempt to merge multiple intersecting transfers into a single one. */
+   /* Attempt to merge multiple intersecting transfers into a single one.
+    * Merging grows the box of the new transfer, so look again until
+    * nothing queued touches it anymore.
+    */
    if (transfer->base.resource->target == PIPE_BUFFER) {
-      memset(&iter, 0, sizeof(iter));
-      iter.current = transfer;
-      iter.compare = transfers_intersect;
-      iter.action = replace_unmapped_transfer;
-      compare_and_perform_action(queue, &iter);
+      struct list_action_args args;
+
+      memset(&args, 0, sizeof(args));
+      args.current = transfer;
+      while ((args.queued = virgl_transfer_queue_find_overlap(queue,
+                                                              transfer->hw_res,
+                                                              transfer->base.level,
+                                                              &transfer->base.box,
+                                                              true)))
+         replace_unmapped_transfer(queue, &args);
    }
 
    add_internal(queue, transfer);
@@ -336,6 +414,7 @@ int virgl_transfer_queue_clear(struct virgl_transfer_queue *queue,
       virgl_encode_end_transfers(cbuf);
       cbuf->cdw = prior_num_dwords;
    } else {
+      virgl_submit_wait(queue->vctx);
       iter.action = transfer_put;
       perform_action(queue, &iter);
    }
@@ -355,6 +434,16 @@ bool virgl_transfer_queue_is_queued(struct virgl_transfer_queue *queue,
                                             false);
 }
 
+bool virgl_transfer_queue_is_buffer_queued(struct virgl_transfer_queue *queue,
+                                           const struct virgl_hw_res *hw_res,
+                                           unsigned size)
+{
+   struct pipe_box box;
+
+   u_box_1d(0, size, &box);
+   return virgl_transfer_queue_find_overlap(queue, hw_res, 0, &box, false);
+}
+
 bool
 virgl_transfer_queue_extend_buffer(struct virgl_transfer_queue *queue,
                                    const struct virgl_hw_res *hw_res,
@@ -373,8 +462,12 @@ virgl_transfer_queue_extend_buffer(struct virgl_transfer_queue *queue,
    assert(queued->hw_res_map);
 
    memcpy(queued->hw_res_map + offset, data, size);
+
+   /* The box is the sort key, take the transfer out while it changes. */
+   transfer_tree_remove(queue, queued);
    u_box_union_2d(&queued->base.box, &queued->base.box, &box);
    queued->offset = queued->base.box.x;
+   transfer_tree_insert(queue, queued);
 
    return true;
 }
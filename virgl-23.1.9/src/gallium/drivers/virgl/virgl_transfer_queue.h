@@ -26,6 +26,7 @@
 
 #include "pipe/p_defines.h"
 #include "util/list.h"
+#include "util/rb_tree.h"
 
 struct virgl_cmd_buf;
 struct virgl_screen;
@@ -33,7 +34,13 @@ struct virgl_context;
 struct virgl_transfer;
 
 struct virgl_transfer_queue {
+   /* Queued transfers in submission order. */
    struct list_head transfer_list;
+   /* The same transfers sorted by resource, level and box, together with
+    * the widest box along x, so overlaps are found without a linear scan.
+    */
+   struct rb_tree transfer_tree;
+   int max_width;
    struct virgl_screen *vs;
    struct virgl_context *vctx;
    struct virgl_cmd_buf *tbuf;
@@ -54,6 +61,11 @@ int virgl_transfer_queue_clear(struct virgl_transfer_queue *queue,
 bool virgl_transfer_queue_is_queued(struct virgl_transfer_queue *queue,
                                     struct virgl_transfer *transfer);
 
+/* Whether any transfer to the first size bytes of a buffer is queued. */
+bool virgl_transfer_queue_is_buffer_queued(struct virgl_transfer_queue *queue,
+                                           const struct virgl_hw_res *hw_res,
+                                           unsigned size);
+
 /*
  * Search the transfer queue for a transfer suitable for extension and
  * extend it to include the specified data.
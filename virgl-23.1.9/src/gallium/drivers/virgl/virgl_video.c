@@ -646,6 +646,7 @@ static void virgl_video_decode_bitstream(struct pipe_video_codec *codec,
     vctx->base.flush(&vctx->base, NULL, 0);
 
     vres = virgl_resource(vcdc->bs_buffers[vcdc->cur_buffer]);
+    virgl_submit_wait(vctx);
     vs->vws->resource_wait(vs->vws, vres->hw_res);
     ptr = pipe_buffer_map(&vctx->base, vcdc->bs_buffers[vcdc->cur_buffer],
                           PIPE_MAP_WRITE, &xfer);
@@ -660,6 +661,7 @@ static void virgl_video_decode_bitstream(struct pipe_video_codec *codec,
     /* transfer picture description */
     fill_picture_desc(picture, &vdsc);
     vres = virgl_resource(vcdc->desc_buffers[vcdc->cur_buffer]);
+    virgl_submit_wait(vctx);
     vs->vws->resource_wait(vs->vws, vres->hw_res);
     ptr = pipe_buffer_map(&vctx->base, vcdc->desc_buffers[vcdc->cur_buffer],
                           PIPE_MAP_WRITE, &xfer);
@@ -686,6 +688,7 @@ static void virgl_video_encode_bitstream(struct pipe_video_codec *codec,
 
     /* Transfer picture desc */
     vres = virgl_resource(vcdc->desc_buffers[vcdc->cur_buffer]);
+    virgl_submit_wait(vctx);
     vs->vws->resource_wait(vs->vws, vres->hw_res);
     ptr = pipe_buffer_map(&vctx->base, vcdc->desc_buffers[vcdc->cur_buffer],
                           PIPE_MAP_WRITE, &xfer);
@@ -696,6 +699,7 @@ static void virgl_video_encode_bitstream(struct pipe_video_codec *codec,
 
     /* Init feedback */
     vres = virgl_resource(vcdc->feed_buffers[vcdc->cur_buffer]);
+    virgl_submit_wait(vctx);
     vs->vws->resource_wait(vs->vws, vres->hw_res);
     fb = pipe_buffer_map(&vctx->base, vcdc->feed_buffers[vcdc->cur_buffer],
                          PIPE_MAP_WRITE, &xfer);
@@ -766,6 +770,7 @@ static void virgl_video_get_feedback(struct pipe_video_codec *codec,
     if (!feedback || !size)
         return;
 
+    virgl_submit_wait(vctx);
     vs->vws->resource_wait(vs->vws, vres->hw_res);
     fb = pipe_buffer_map(&vctx->base, &vres->b, PIPE_MAP_READ, &xfer);
     if (!fb)
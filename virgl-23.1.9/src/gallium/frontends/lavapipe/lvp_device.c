@@ -40,6 +40,7 @@
 #include "util/os_time.h"
 #include "util/u_thread.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/timespec.h"
 #include "util/ptralloc.h"
 #include "nir.h"
@@ -1529,6 +1530,37 @@ destroy_pipelines(struct lvp_queue *queue)
    simple_mtx_unlock(&queue->pipeline_lock);
 }
 
+struct lvp_xfer_job {
+   struct util_queue_fence fence;
+   struct lvp_queue *queue;
+   struct lvp_cmd_buffer *cmd_buffer;
+   /* main context work the job's barriers have to wait for */
+   struct pipe_fence_handle *wait;
+};
+
+static void
+lvp_xfer_job_execute(void *data, void *gdata, int thread_index)
+{
+   struct lvp_xfer_job *job = data;
+   struct lvp_queue *queue = job->queue;
+   struct pipe_screen *screen = queue->device->pscreen;
+   struct pipe_fence_handle *fence = NULL;
+
+   if (job->wait) {
+      screen->fence_finish(screen, NULL, job->wait, PIPE_TIMEOUT_INFINITE);
+      screen->fence_reference(screen, &job->wait, NULL);
+   }
+
+   lvp_execute_transfer_cmds(queue->device, queue, job->cmd_buffer);
+
+   /* the job only counts as done once the context has finished with it */
+   queue->xfer.ctx->flush(queue->xfer.ctx, &fence, 0);
+   if (fence) {
+      screen->fence_finish(screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+      screen->fence_reference(screen, &fence, NULL);
+   }
+}
+
 static VkResult
 lvp_queue_submit(struct vk_queue *vk_queue,
                  struct vk_queue_submit *submit)
@@ -1541,13 +1573,51 @@ lvp_queue_submit(struct vk_queue *vk_queue,
    if (result != VK_SUCCESS)
       return result;
 
+   /* Transfer-only command buffers go to the transfer thread while the
+    * others keep running here.  Jobs run in order, so a barrier on either
+    * side only has to wait for the other side's work submitted before it:
+    * a job with barriers waits for a flush of the main context, and a
+    * command buffer that synchronizes waits for the last job queued.
+    */
+   struct lvp_xfer_job *jobs = NULL;
+   struct lvp_xfer_job *last_job = NULL;
+   unsigned num_jobs = 0;
+   if (queue->xfer.ctx && submit->command_buffer_count > 1)
+      jobs = calloc(submit->command_buffer_count, sizeof(*jobs));
+
    for (uint32_t i = 0; i < submit->command_buffer_count; i++) {
       struct lvp_cmd_buffer *cmd_buffer =
          container_of(submit->command_buffers[i], struct lvp_cmd_buffer, vk);
+      bool has_barriers;
+
+      if (jobs && lvp_cmd_buffer_is_transfer_only(cmd_buffer, &has_barriers)) {
+         struct lvp_xfer_job *job = &jobs[num_jobs++];
+
+         util_queue_fence_init(&job->fence);
+         job->queue = queue;
+         job->cmd_buffer = cmd_buffer;
+         if (has_barriers)
+            queue->ctx->flush(queue->ctx, &job->wait, 0);
+         util_queue_add_job(&queue->xfer.queue, job, &job->fence,
+                            lvp_xfer_job_execute, NULL, 0);
+         last_job = job;
+         continue;
+      }
+
+      if (last_job && lvp_cmd_buffer_needs_sync(cmd_buffer)) {
+         util_queue_fence_wait(&last_job->fence);
+         last_job = NULL;
+      }
 
       lvp_execute_cmds(queue->device, queue, cmd_buffer);
    }
 
+   for (unsigned i = 0; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+   free(jobs);
+
    if (submit->command_buffer_count > 0)
       queue->ctx->flush(queue->ctx, &queue->last_fence, 0);
 
@@ -1561,6 +1631,47 @@ lvp_queue_submit(struct vk_queue *vk_queue,
    return VK_SUCCESS;
 }
 
+/* The transfer lane is optional, the queue runs everything on its main
+ * context if any of this fails.
+ */
+static void
+lvp_queue_init_xfer(struct lvp_device *device, struct lvp_queue *queue)
+{
+   queue->xfer.state = calloc(1, lvp_get_rendering_state_size());
+   if (!queue->xfer.state)
+      return;
+
+   if (!util_queue_init(&queue->xfer.queue, "lvp_xfer", 8, 1,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL)) {
+      free(queue->xfer.state);
+      queue->xfer.state = NULL;
+      return;
+   }
+
+   queue->xfer.ctx = device->pscreen->context_create(device->pscreen, NULL, PIPE_CONTEXT_ROBUST_BUFFER_ACCESS);
+   if (!queue->xfer.ctx) {
+      util_queue_destroy(&queue->xfer.queue);
+      free(queue->xfer.state);
+      queue->xfer.state = NULL;
+      return;
+   }
+   queue->xfer.cso = cso_create_context(queue->xfer.ctx, CSO_NO_VBUF);
+   queue->xfer.uploader = u_upload_create(queue->xfer.ctx, 64 * 1024, PIPE_BIND_CONSTANT_BUFFER, PIPE_USAGE_STREAM, 0);
+}
+
+static void
+lvp_queue_finish_xfer(struct lvp_queue *queue)
+{
+   if (!queue->xfer.ctx)
+      return;
+
+   util_queue_destroy(&queue->xfer.queue);
+   u_upload_destroy(queue->xfer.uploader);
+   cso_destroy_context(queue->xfer.cso);
+   queue->xfer.ctx->destroy(queue->xfer.ctx);
+   free(queue->xfer.state);
+}
+
 static VkResult
 lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
                const VkDeviceQueueCreateInfo *create_info,
@@ -1585,6 +1696,10 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
 
    queue->vk.driver_submit = lvp_queue_submit;
 
+   if (util_get_cpu_caps()->nr_cpus > 1 &&
+       debug_get_bool_option("LVP_TRANSFER_THREAD", true))
+      lvp_queue_init_xfer(device, queue);
+
    simple_mtx_init(&queue->pipeline_lock, mtx_plain);
    util_dynarray_init(&queue->pipeline_destroys, NULL);
 
@@ -1600,6 +1715,8 @@ lvp_queue_finish(struct lvp_queue *queue)
    simple_mtx_destroy(&queue->pipeline_lock);
    util_dynarray_fini(&queue->pipeline_destroys);
 
+   lvp_queue_finish_xfer(queue);
+
    u_upload_destroy(queue->uploader);
    cso_destroy_context(queue->cso);
    queue->ctx->destroy(queue->ctx);
@@ -4581,16 +4581,19 @@ static void lvp_execute_cmd_buffer(struct lvp_cmd_buffer *cmd_buffer,
    }
 }
 
-VkResult lvp_execute_cmds(struct lvp_device *device,
-                          struct lvp_queue *queue,
-                          struct lvp_cmd_buffer *cmd_buffer)
+static void
+execute_cmds(struct lvp_device *device,
+             struct pipe_context *pctx,
+             struct cso_context *cso,
+             struct u_upload_mgr *uploader,
+             struct rendering_state *state,
+             struct lvp_cmd_buffer *cmd_buffer)
 {
-   struct rendering_state *state = queue->state;
    memset(state, 0, sizeof(*state));
-   state->pctx = queue->ctx;
+   state->pctx = pctx;
    state->device = device;
-   state->uploader = queue->uploader;
-   state->cso = queue->cso;
+   state->uploader = uploader;
+   state->cso = cso;
    state->blend_dirty = true;
    state->dsa_dirty = true;
    state->rs_dirty = true;
@@ -4622,7 +4625,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
 
    state->start_vb = -1;
    state->num_vb = 0;
-   cso_unbind_context(queue->cso);
+   cso_unbind_context(cso);
    for (unsigned i = 0; i < ARRAY_SIZE(state->so_targets); i++) {
       if (state->so_targets[i]) {
          state->pctx->stream_output_target_destroy(state->pctx, state->so_targets[i]);
@@ -4630,9 +4633,88 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    }
 
    free(state->color_att);
+}
+
+VkResult lvp_execute_cmds(struct lvp_device *device,
+                          struct lvp_queue *queue,
+                          struct lvp_cmd_buffer *cmd_buffer)
+{
+   execute_cmds(device, queue->ctx, queue->cso, queue->uploader,
+                queue->state, cmd_buffer);
    return VK_SUCCESS;
 }
 
+void lvp_execute_transfer_cmds(struct lvp_device *device,
+                               struct lvp_queue *queue,
+                               struct lvp_cmd_buffer *cmd_buffer)
+{
+   assert(queue->xfer.ctx);
+   execute_cmds(device, queue->xfer.ctx, queue->xfer.cso, queue->xfer.uploader,
+                queue->xfer.state, cmd_buffer);
+}
+
+/* Transfer commands only use the pipe_context, so command buffers made of
+ * nothing else can run on the queue's transfer context.
+ */
+bool
+lvp_cmd_buffer_is_transfer_only(struct lvp_cmd_buffer *cmd_buffer,
+                                bool *has_barriers)
+{
+   struct vk_cmd_queue_entry *cmd;
+
+   *has_barriers = false;
+   LIST_FOR_EACH_ENTRY(cmd, &cmd_buffer->vk.cmd_queue.cmds, cmd_link) {
+      switch (cmd->type) {
+      case VK_CMD_COPY_BUFFER2:
+      case VK_CMD_COPY_IMAGE2:
+      case VK_CMD_BLIT_IMAGE2:
+      case VK_CMD_COPY_BUFFER_TO_IMAGE2:
+      case VK_CMD_COPY_IMAGE_TO_BUFFER2:
+      case VK_CMD_UPDATE_BUFFER:
+      case VK_CMD_FILL_BUFFER:
+      case VK_CMD_CLEAR_COLOR_IMAGE:
+      case VK_CMD_CLEAR_DEPTH_STENCIL_IMAGE:
+      case VK_CMD_RESOLVE_IMAGE2:
+         break;
+      case VK_CMD_PIPELINE_BARRIER2:
+         *has_barriers = true;
+         break;
+      default:
+         /* everything else may use CSOs or objects created on queue->ctx */
+         return false;
+      }
+   }
+   return true;
+}
+
+/* Whether the command buffer has to observe the transfer worker's commands
+ * submitted before it, i.e. whether it waits for or samples earlier work.
+ */
+bool
+lvp_cmd_buffer_needs_sync(struct lvp_cmd_buffer *cmd_buffer)
+{
+   struct vk_cmd_queue_entry *cmd;
+
+   LIST_FOR_EACH_ENTRY(cmd, &cmd_buffer->vk.cmd_queue.cmds, cmd_link) {
+      switch (cmd->type) {
+      case VK_CMD_PIPELINE_BARRIER2:
+      case VK_CMD_WAIT_EVENTS2:
+      case VK_CMD_SET_EVENT2:
+      case VK_CMD_RESET_EVENT2:
+      case VK_CMD_EXECUTE_COMMANDS:
+      case VK_CMD_BEGIN_QUERY:
+      case VK_CMD_BEGIN_QUERY_INDEXED_EXT:
+      case VK_CMD_WRITE_TIMESTAMP2:
+      case VK_CMD_RESET_QUERY_POOL:
+      case VK_CMD_COPY_QUERY_POOL_RESULTS:
+         return true;
+      default:
+         break;
+      }
+   }
+   return false;
+}
+
 size_t
 lvp_get_rendering_state_size(void)
 {
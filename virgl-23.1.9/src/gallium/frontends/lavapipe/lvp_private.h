@@ -164,6 +164,18 @@ struct lvp_queue {
    void *state;
    struct util_dynarray pipeline_destroys;
    simple_mtx_t pipeline_lock;
+
+   /* Transfer-only command buffers run on a second context and thread, so
+    * uploads and readbacks overlap with the rendering of the other command
+    * buffers of the submit.  See lvp_queue_submit().
+    */
+   struct {
+      struct util_queue queue;
+      struct pipe_context *ctx;
+      struct cso_context *cso;
+      struct u_upload_mgr *uploader;
+      void *state;
+   } xfer;
 };
 
 struct lvp_pipeline_cache {
@@ -605,6 +617,14 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp);
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
+void lvp_execute_transfer_cmds(struct lvp_device *device,
+                               struct lvp_queue *queue,
+                               struct lvp_cmd_buffer *cmd_buffer);
+bool
+lvp_cmd_buffer_is_transfer_only(struct lvp_cmd_buffer *cmd_buffer,
+                                bool *has_barriers);
+bool
+lvp_cmd_buffer_needs_sync(struct lvp_cmd_buffer *cmd_buffer);
 size_t
 lvp_get_rendering_state_size(void);
 struct lvp_image *lvp_swapchain_get_image(VkSwapchainKHR swapchain,
@@ -194,6 +194,7 @@ struct st_config_options
    bool ignore_map_unsynchronized;
    bool ignore_discard_framebuffer;
    bool force_integer_tex_nearest;
+   bool precompile_state_variants;
    bool force_gl_names_reuse;
    bool force_gl_map_buffer_synchronized;
    bool transcode_etc;
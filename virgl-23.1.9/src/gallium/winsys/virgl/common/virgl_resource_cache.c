@@ -22,7 +22,10 @@
  */
 
 #include "virgl_resource_cache.h"
+#include "util/os_misc.h"
 #include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/u_math.h"
 
 /* Checks whether the resource represented by a cache entry is able to hold
  * data of the specified size, bind and format.
@@ -46,11 +49,93 @@ virgl_resource_cache_entry_is_compatible(struct virgl_resource_cache_entry *entr
    }
 }
 
+struct virgl_resource_cache_bucket_key {
+   uint32_t target;
+   uint32_t bind;
+   uint32_t format;
+   uint32_t flags;
+   uint32_t size_class;
+};
+
+struct virgl_resource_cache_bucket {
+   struct virgl_resource_cache_bucket_key key;
+   struct list_head entries;
+};
+
+static uint32_t
+virgl_resource_cache_bucket_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct virgl_resource_cache_bucket_key));
+}
+
+static bool
+virgl_resource_cache_bucket_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct virgl_resource_cache_bucket_key)) == 0;
+}
+
+static inline unsigned
+virgl_resource_cache_size_class(uint32_t size)
+{
+   return util_logbase2_ceil(MAX2(size, 1));
+}
+
+static inline struct virgl_resource_cache_bucket_key
+virgl_resource_cache_bucket_key(const struct virgl_resource_params *params,
+                                unsigned size_class)
+{
+   struct virgl_resource_cache_bucket_key key = {
+      .target = params->target,
+      .bind = params->bind,
+      .format = params->format,
+      .flags = params->flags,
+      .size_class = size_class,
+   };
+   return key;
+}
+
+static struct virgl_resource_cache_bucket *
+virgl_resource_cache_find_bucket(struct virgl_resource_cache *cache,
+                                 const struct virgl_resource_params *params,
+                                 unsigned size_class, bool create)
+{
+   struct virgl_resource_cache_bucket_key key =
+      virgl_resource_cache_bucket_key(params, size_class);
+   uint32_t hash = virgl_resource_cache_bucket_hash(&key);
+   struct hash_entry *he =
+      _mesa_hash_table_search_pre_hashed(cache->buckets, hash, &key);
+
+   if (he)
+      return he->data;
+
+   if (!create)
+      return NULL;
+
+   struct virgl_resource_cache_bucket *bucket =
+      rzalloc(cache->buckets, struct virgl_resource_cache_bucket);
+   if (!bucket)
+      return NULL;
+
+   bucket->key = key;
+   list_inithead(&bucket->entries);
+   _mesa_hash_table_insert_pre_hashed(cache->buckets, hash, &bucket->key, bucket);
+   return bucket;
+}
+
+static void
+virgl_resource_cache_entry_unlink(struct virgl_resource_cache *cache,
+                                  struct virgl_resource_cache_entry *entry)
+{
+   list_del(&entry->head);
+   list_del(&entry->bucket_head);
+   cache->size -= entry->params.size;
+}
+
 static void
 virgl_resource_cache_entry_release(struct virgl_resource_cache *cache,
                                    struct virgl_resource_cache_entry *entry)
 {
-      list_del(&entry->head);
+      virgl_resource_cache_entry_unlink(cache, entry);
       cache->entry_release_func(entry, cache->user_data);
 }
 
@@ -68,6 +153,23 @@ virgl_resource_cache_destroy_expired(struct virgl_resource_cache *cache, int64_t
    }
 }
 
+static void
+virgl_resource_cache_update_budget(struct virgl_resource_cache *cache, int64_t now)
+{
+   uint64_t avail;
+
+   if (now - cache->budget_update_time < cache->timeout_usecs)
+      return;
+
+   cache->budget_update_time = now;
+
+   /* Let the cache hold at most an eighth of what is still available, so it
+    * shrinks quickly when the system runs low on memory.
+    */
+   if (os_get_available_system_memory(&avail))
+      cache->max_size = avail / 8;
+}
+
 void
 virgl_resource_cache_init(struct virgl_resource_cache *cache,
                           unsigned timeout_usecs,
@@ -76,6 +178,12 @@ virgl_resource_cache_init(struct virgl_resource_cache *cache,
                           void *user_data)
 {
    list_inithead(&cache->resources);
+   cache->buckets = _mesa_hash_table_create(NULL,
+                                            virgl_resource_cache_bucket_hash,
+                                            virgl_resource_cache_bucket_equal);
+   cache->size = 0;
+   cache->max_size = UINT64_MAX;
+   cache->budget_update_time = os_time_get() - timeout_usecs;
    cache->timeout_usecs = timeout_usecs;
    cache->entry_is_busy_func = is_busy_func;
    cache->entry_release_func = destroy_func;
@@ -87,16 +195,34 @@ virgl_resource_cache_add(struct virgl_resource_cache *cache,
                          struct virgl_resource_cache_entry *entry)
 {
    const int64_t now = os_time_get();
+   struct virgl_resource_cache_bucket *bucket;
 
    /* Entry should not already be in the cache. */
    assert(entry->head.next == NULL);
    assert(entry->head.prev == NULL);
 
    virgl_resource_cache_destroy_expired(cache, now);
+   virgl_resource_cache_update_budget(cache, now);
+
+   bucket = virgl_resource_cache_find_bucket(cache, &entry->params,
+                                             virgl_resource_cache_size_class(entry->params.size),
+                                             true);
+   if (!bucket) {
+      cache->entry_release_func(entry, cache->user_data);
+      return;
+   }
 
    entry->timeout_start = now;
    entry->timeout_end = entry->timeout_start + cache->timeout_usecs;
    list_addtail(&entry->head, &cache->resources);
+   list_addtail(&entry->bucket_head, &bucket->entries);
+   cache->size += entry->params.size;
+
+   /* Over budget: drop the oldest entries, but keep the one just added. */
+   while (cache->size > cache->max_size && cache->resources.next != &entry->head) {
+      virgl_resource_cache_entry_release(cache,
+         list_first_entry(&cache->resources, struct virgl_resource_cache_entry, head));
+   }
 }
 
 struct virgl_resource_cache_entry *
@@ -105,42 +231,40 @@ virgl_resource_cache_remove_compatible(struct virgl_resource_cache *cache,
 {
    const int64_t now = os_time_get();
    struct virgl_resource_cache_entry *compat_entry = NULL;
-   bool check_expired = true;
-
-   /* Iterate through the cache to find a compatible resource, while also
-    * destroying any expired resources we come across.
+   const unsigned size_class = virgl_resource_cache_size_class(params.size);
+   /* A buffer may be served by a resource up to twice its size, which is
+    * either in the same size class or the next one.  Other resources must
+    * match exactly.
     */
-   list_for_each_entry_safe(struct virgl_resource_cache_entry,
-                            entry, &cache->resources, head) {
-      const bool compatible =
-         virgl_resource_cache_entry_is_compatible(entry, params);
+   const unsigned num_classes = params.target == PIPE_BUFFER ? 2 : 1;
+
+   virgl_resource_cache_destroy_expired(cache, now);
+
+   for (unsigned i = 0; i < num_classes && !compat_entry; i++) {
+      struct virgl_resource_cache_bucket *bucket =
+         virgl_resource_cache_find_bucket(cache, &params, size_class + i, false);
+      if (!bucket)
+         continue;
+
+      list_for_each_entry(struct virgl_resource_cache_entry,
+                          entry, &bucket->entries, bucket_head) {
+         if (!virgl_resource_cache_entry_is_compatible(entry, params))
+            continue;
 
-      if (compatible) {
          if (!cache->entry_is_busy_func(entry, cache->user_data))
             compat_entry = entry;
 
          /* We either have found a compatible resource, in which case we are
           * done, or the resource is busy, which means resources later in
-          * the cache list will also be busy, so there is no point in
+          * the bucket will also be busy, so there is no point in
           * searching further.
           */
          break;
       }
-
-      /* If we aren't using this resource, check to see if it has expired.
-       * Once we have found the first non-expired resource, we can stop checking
-       * since the cache holds resources in non-decreasing timeout order.
-       */
-      if (check_expired) {
-         if (os_time_timeout(entry->timeout_start, entry->timeout_end, now))
-            virgl_resource_cache_entry_release(cache, entry);
-         else
-            check_expired = false;
-      }
    }
 
    if (compat_entry)
-      list_del(&compat_entry->head);
+      virgl_resource_cache_entry_unlink(cache, compat_entry);
 
    return compat_entry;
 }
@@ -153,3 +277,11 @@ virgl_resource_cache_flush(struct virgl_resource_cache *cache)
       virgl_resource_cache_entry_release(cache, entry);
    }
 }
+
+void
+virgl_resource_cache_fini(struct virgl_resource_cache *cache)
+{
+   virgl_resource_cache_flush(cache);
+   _mesa_hash_table_destroy(cache->buckets, NULL);
+   cache->buckets = NULL;
+}
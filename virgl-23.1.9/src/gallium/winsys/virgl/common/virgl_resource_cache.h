@@ -27,6 +27,7 @@
 #include <stdint.h>
 
 #include "util/list.h"
+#include "util/hash_table.h"
 #include "gallium/include/pipe/p_defines.h"
 
 struct virgl_resource_params {
@@ -43,8 +44,13 @@ struct virgl_resource_params {
    enum pipe_texture_target target;
 };
 
+struct virgl_resource_cache_bucket;
+
 struct virgl_resource_cache_entry {
+   /* Link in the cache's LRU list, which is in non-decreasing timeout order. */
    struct list_head head;
+   /* Link in the list of the bucket matching params, in the same order. */
+   struct list_head bucket_head;
    int64_t timeout_start;
    int64_t timeout_end;
    struct virgl_resource_params params;
@@ -64,6 +70,15 @@ typedef void (*virgl_resource_cache_entry_release_func) (
 
 struct virgl_resource_cache {
    struct list_head resources;
+   /* Buckets of entries keyed by target, bind, format, flags and size class. */
+   struct hash_table *buckets;
+   /* Total size of the cached resources and the budget it is trimmed to.
+    * The budget follows the available system memory and is re-evaluated at
+    * most once per timeout period.
+    */
+   uint64_t size;
+   uint64_t max_size;
+   int64_t budget_update_time;
    unsigned timeout_usecs;
    virgl_resource_cache_entry_is_busy_func entry_is_busy_func;
    virgl_resource_cache_entry_release_func entry_release_func;
@@ -99,6 +114,10 @@ virgl_resource_cache_remove_compatible(struct virgl_resource_cache *cache,
 void
 virgl_resource_cache_flush(struct virgl_resource_cache *cache);
 
+/** Empties the resource cache and frees its bookkeeping. */
+void
+virgl_resource_cache_fini(struct virgl_resource_cache *cache);
+
 static inline void
 virgl_resource_cache_entry_init(struct virgl_resource_cache_entry *entry,
                                 struct virgl_resource_params params)
@@ -36,6 +36,7 @@
 #include "util/u_hash_table.h"
 #include "util/u_inlines.h"
 #include "util/u_pointer.h"
+#include "util/perf/cpu_trace.h"
 #include "frontend/drm_driver.h"
 #include "virgl/virgl_screen.h"
 #include "virgl/virgl_public.h"
@@ -112,6 +113,8 @@ static boolean virgl_drm_resource_is_busy(struct virgl_winsys *vws,
    if (!p_atomic_read(&res->maybe_busy) && !p_atomic_read(&res->external))
       return false;
 
+   MESA_TRACE_FUNC();
+
    memset(&waitcmd, 0, sizeof(waitcmd));
    waitcmd.handle = res->bo_handle;
    waitcmd.flags = VIRTGPU_WAIT_NOWAIT;
@@ -130,7 +133,7 @@ virgl_drm_winsys_destroy(struct virgl_winsys *qws)
 {
    struct virgl_drm_winsys *qdws = virgl_drm_winsys(qws);
 
-   virgl_resource_cache_flush(&qdws->cache);
+   virgl_resource_cache_fini(&qdws->cache);
 
    _mesa_hash_table_destroy(qdws->bo_handles, NULL);
    _mesa_hash_table_destroy(qdws->bo_names, NULL);
@@ -952,6 +955,8 @@ static int virgl_drm_winsys_submit_cmd(struct virgl_winsys *qws,
    if (cbuf->base.cdw == 0)
       return 0;
 
+   MESA_TRACE_FUNC();
+
    memset(&eb, 0, sizeof(struct drm_virtgpu_execbuffer));
    eb.command = (unsigned long)(void*)cbuf->buf;
    eb.size = cbuf->base.cdw * 4;
@@ -1048,6 +1053,8 @@ static bool virgl_fence_wait(struct virgl_winsys *vws,
       if (timeout == 0)
          return sync_wait(fence->fd, 0) == 0;
 
+      MESA_TRACE_FUNC();
+
       timeout_ms = timeout / 1000000;
       /* round up */
       if (timeout_ms * 1000000 < timeout)
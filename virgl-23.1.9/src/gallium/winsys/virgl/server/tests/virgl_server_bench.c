@@ -0,0 +1,656 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Micro-benchmarks for the virgl server protocol.
+ *
+ * The winsys protocol functions are driven against a fake server running in
+ * a thread of the same process, which implements just enough of every VCMD
+ * to answer them, touches submitted command dwords once and retires all work
+ * immediately.  What is left is the cost of the protocol itself: syscalls,
+ * copies, wakeups and round trips.
+ *
+ * The usual environment variables select the protocol features, e.g.
+ * VIRGL_SERVER_SHM_RING, VIRGL_SERVER_FENCES or VIRGL_SERVER_BATCH_DESTROY,
+ * so runs with and without them can be compared.  Results are printed as
+ * one JSON object per line on stdout:
+ *
+ *    virgl_server_bench [iterations]
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "util/anon_file.h"
+#include "util/futex.h"
+#include "util/os_mman.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_memory.h"
+
+#include "virgl_server_winsys.h"
+
+struct fake_server {
+   int listen_fd;
+   int fd;
+   thrd_t thread;
+
+   struct virgl_server_ring *ring;
+   uint32_t ring_map_size;
+   int ring_eventfd;
+
+   struct virgl_server_fence_page *fence_page;
+   uint32_t seqno;
+
+   /* Keeps the command checksums from being optimized away. */
+   uint32_t checksum;
+
+   uint32_t *buf;
+   uint32_t buf_dw;
+};
+
+static int
+server_read(int fd, void *buf, size_t size, int *fds, int *num_fds)
+{
+   char cmsg_buf[CMSG_SPACE(sizeof(int) * 2)];
+   char *ptr = buf;
+   size_t left = size;
+
+   if (num_fds)
+      *num_fds = 0;
+
+   while (left) {
+      struct iovec iov = { .iov_base = ptr, .iov_len = left };
+      struct msghdr msgh = {
+         .msg_iov = &iov,
+         .msg_iovlen = 1,
+         .msg_control = cmsg_buf,
+         .msg_controllen = sizeof(cmsg_buf),
+      };
+
+      ssize_t ret = recvmsg(fd, &msgh, 0);
+      if (ret < 0 && errno == EINTR)
+         continue;
+      if (ret <= 0)
+         return -1;
+
+      for (struct cmsghdr *cmsgh = CMSG_FIRSTHDR(&msgh); cmsgh;
+           cmsgh = CMSG_NXTHDR(&msgh, cmsgh)) {
+         if (cmsgh->cmsg_level != SOL_SOCKET ||
+             cmsgh->cmsg_type != SCM_RIGHTS)
+            continue;
+
+         unsigned n = (cmsgh->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+         int *cfds = (int *)CMSG_DATA(cmsgh);
+         for (unsigned i = 0; i < n; i++) {
+            if (fds && *num_fds < 2)
+               fds[(*num_fds)++] = cfds[i];
+            else
+               close(cfds[i]);
+         }
+      }
+
+      ptr += ret;
+      left -= ret;
+   }
+
+   return 0;
+}
+
+static void
+server_write(int fd, const void *buf, size_t size)
+{
+   const char *ptr = buf;
+
+   while (size) {
+      ssize_t ret = write(fd, ptr, size);
+      if (ret < 0 && errno == EINTR)
+         continue;
+      if (ret <= 0)
+         return;
+      ptr += ret;
+      size -= ret;
+   }
+}
+
+static void
+server_send_fd(int sock_fd, int fd)
+{
+   char cmsg_buf[CMSG_SPACE(sizeof(int))];
+   char c = 0;
+   struct iovec iov = { .iov_base = &c, .iov_len = 1 };
+   struct msghdr msgh = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+      .msg_control = cmsg_buf,
+      .msg_controllen = sizeof(cmsg_buf),
+   };
+
+   struct cmsghdr *cmsgh = CMSG_FIRSTHDR(&msgh);
+   cmsgh->cmsg_level = SOL_SOCKET;
+   cmsgh->cmsg_type = SCM_RIGHTS;
+   cmsgh->cmsg_len = CMSG_LEN(sizeof(int));
+   memcpy(CMSG_DATA(cmsgh), &fd, sizeof(int));
+
+   while (sendmsg(sock_fd, &msgh, 0) < 0 && errno == EINTR)
+      ;
+}
+
+static void
+server_reply(struct fake_server *srv, uint32_t cmd, const uint32_t *data,
+             uint32_t ndw)
+{
+   uint32_t hdr[2] = { ndw, cmd };
+
+   server_write(srv->fd, hdr, sizeof(hdr));
+   if (ndw)
+      server_write(srv->fd, data, ndw * 4);
+}
+
+static void
+server_retire(struct fake_server *srv)
+{
+   srv->seqno++;
+
+   if (!srv->fence_page)
+      return;
+
+   p_atomic_set(&srv->fence_page->completed_seqno, srv->seqno);
+   if (p_atomic_xchg(&srv->fence_page->waiters, 0))
+      futex_wake(&srv->fence_page->completed_seqno, INT_MAX);
+}
+
+static void
+server_checksum(struct fake_server *srv, const uint32_t *cmd, uint32_t ndw)
+{
+   uint32_t sum = 0;
+
+   for (uint32_t i = 0; i < ndw; i++)
+      sum += cmd[i];
+   srv->checksum += sum;
+}
+
+static void
+server_drain_ring(struct fake_server *srv)
+{
+   struct virgl_server_ring *ring = srv->ring;
+
+   if (!ring)
+      return;
+
+   uint32_t mask = ring->size - 1;
+   uint32_t tail = ring->tail;
+
+   while (tail != p_atomic_read(&ring->head)) {
+      uint32_t ndw = ring->data[tail & mask];
+      uint32_t offset = (tail + 1) & mask;
+      uint32_t first = MIN2(ndw, ring->size - offset);
+
+      server_checksum(srv, &ring->data[offset], first);
+      if (first < ndw)
+         server_checksum(srv, &ring->data[0], ndw - first);
+      server_retire(srv);
+
+      tail += ndw + 1;
+      p_atomic_xchg(&ring->tail, tail);
+      if (p_atomic_xchg(&ring->client_waiting, 0))
+         futex_wake(&ring->tail, INT_MAX);
+   }
+}
+
+/* Sleeps until there is either a socket command or ring work. */
+static bool
+server_wait(struct fake_server *srv)
+{
+   struct pollfd pfds[2] = {
+      { .fd = srv->fd, .events = POLLIN },
+      { .fd = srv->ring_eventfd, .events = POLLIN },
+   };
+   unsigned nfds = 1;
+
+   if (srv->ring) {
+      p_atomic_xchg(&srv->ring->server_waiting, 1);
+      if (p_atomic_read(&srv->ring->head) != srv->ring->tail) {
+         p_atomic_xchg(&srv->ring->server_waiting, 0);
+         return true;
+      }
+      nfds = 2;
+   }
+
+   int ret;
+   do {
+      ret = poll(pfds, nfds, -1);
+   } while (ret < 0 && errno == EINTR);
+
+   if (srv->ring)
+      p_atomic_xchg(&srv->ring->server_waiting, 0);
+
+   if (ret < 0)
+      return false;
+
+   if (nfds > 1 && (pfds[1].revents & POLLIN)) {
+      uint64_t value;
+      if (read(srv->ring_eventfd, &value, sizeof(value)) < 0)
+         return false;
+   }
+
+   /* The client hung up. */
+   if ((pfds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) &&
+       !(pfds[0].revents & POLLIN))
+      return false;
+
+   return true;
+}
+
+static bool
+server_has_command(struct fake_server *srv)
+{
+   struct pollfd pfd = { .fd = srv->fd, .events = POLLIN };
+   return poll(&pfd, 1, 0) > 0;
+}
+
+static void *
+server_map(int fd, uint32_t size)
+{
+   void *map = os_mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+   return map == MAP_FAILED ? NULL : map;
+}
+
+static bool
+server_handle_command(struct fake_server *srv)
+{
+   uint32_t hdr[2];
+   int fds[2];
+   int num_fds;
+
+   if (server_read(srv->fd, hdr, sizeof(hdr), fds, &num_fds))
+      return false;
+
+   uint32_t ndw = hdr[0];
+   uint32_t cmd = hdr[1];
+
+   /* The length of TRANSFER_PUT includes its data, which is passed through
+    * the resource's shared memory instead.
+    */
+   if (cmd == VCMD_TRANSFER_PUT)
+      ndw = 10;
+
+   if (ndw > srv->buf_dw) {
+      srv->buf_dw = ndw;
+      srv->buf = realloc(srv->buf, ndw * 4);
+   }
+   if (ndw && server_read(srv->fd, srv->buf, ndw * 4, NULL, NULL))
+      return false;
+
+   uint32_t reply;
+
+   switch (cmd) {
+   case VCMD_GET_CAPS:
+      /* No caps, the reply length is in bytes plus one. */
+      server_write(srv->fd, (uint32_t[]){ 1, VCMD_GET_CAPS }, 8);
+      break;
+   case VCMD_RING_INIT:
+      reply = 0;
+      if (num_fds == 2) {
+         srv->ring_map_size = srv->buf[0];
+         srv->ring = server_map(fds[0], srv->ring_map_size);
+         srv->ring_eventfd = fds[1];
+         reply = srv->ring != NULL;
+      }
+      server_reply(srv, VCMD_RING_INIT, &reply, 1);
+      break;
+   case VCMD_FENCE_INIT:
+      reply = 0;
+      if (num_fds == 1) {
+         srv->fence_page = server_map(fds[0], srv->buf[0]);
+         reply = srv->fence_page != NULL;
+      }
+      server_reply(srv, VCMD_FENCE_INIT, &reply, 1);
+      break;
+   case VCMD_FENCE_GET_FD: {
+      /* Everything retires right away, so the fd is already signalled. */
+      int fd = eventfd(1, EFD_CLOEXEC);
+      server_send_fd(srv->fd, fd);
+      close(fd);
+      break;
+   }
+   case VCMD_RESOURCE_CREATE: {
+      uint32_t size = srv->buf[10];
+      if (size) {
+         int fd = os_create_anonymous_file(size, "virgl-bench-resource");
+         server_send_fd(srv->fd, fd);
+         close(fd);
+      }
+      break;
+   }
+   case VCMD_RESOURCE_BUSY_WAIT:
+      reply = 0;
+      server_reply(srv, VCMD_RESOURCE_BUSY_WAIT, &reply, 1);
+      break;
+   case VCMD_SUBMIT_CMD:
+      server_checksum(srv, srv->buf, ndw);
+      server_retire(srv);
+      break;
+   case VCMD_PRESENT_ASYNC:
+      server_retire(srv);
+      break;
+   default:
+      for (int i = 0; i < num_fds; i++)
+         close(fds[i]);
+      break;
+   }
+
+   return true;
+}
+
+static int
+server_thread(void *data)
+{
+   struct fake_server *srv = data;
+
+   srv->fd = accept(srv->listen_fd, NULL, NULL);
+   if (srv->fd < 0)
+      return 0;
+
+   for (;;) {
+      /* Ring submits are ordered before the next socket command. */
+      server_drain_ring(srv);
+
+      if (!server_has_command(srv) && !server_wait(srv))
+         break;
+
+      server_drain_ring(srv);
+
+      if (server_has_command(srv) && !server_handle_command(srv))
+         break;
+   }
+
+   if (srv->ring) {
+      os_munmap(srv->ring, srv->ring_map_size);
+      close(srv->ring_eventfd);
+   }
+   if (srv->fence_page)
+      os_munmap(srv->fence_page, 4096);
+   free(srv->buf);
+   close(srv->fd);
+   return 0;
+}
+
+static char socket_dir[] = "/tmp/virgl-server-bench-XXXXXX";
+static char socket_path[sizeof(socket_dir) + 8];
+
+static bool
+fake_server_start(struct fake_server *srv)
+{
+   struct sockaddr_un un = { .sun_family = AF_UNIX };
+
+   if (!mkdtemp(socket_dir))
+      return false;
+   snprintf(socket_path, sizeof(socket_path), "%s/sock", socket_dir);
+   snprintf(un.sun_path, sizeof(un.sun_path), "%s", socket_path);
+
+   srv->ring_eventfd = -1;
+   srv->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+   if (srv->listen_fd < 0 ||
+       bind(srv->listen_fd, (struct sockaddr *)&un, sizeof(un)) < 0 ||
+       listen(srv->listen_fd, 1) < 0)
+      return false;
+
+   setenv("VIRGL_SERVER_PATH", socket_path, 1);
+
+   return thrd_create(&srv->thread, server_thread, srv) == thrd_success;
+}
+
+static void
+fake_server_stop(struct fake_server *srv)
+{
+   thrd_join(srv->thread, NULL);
+   close(srv->listen_fd);
+   unlink(socket_path);
+   rmdir(socket_dir);
+}
+
+/*
+ * Client side
+ */
+
+static int
+compare_int64(const void *a, const void *b)
+{
+   int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+   return (x > y) - (x < y);
+}
+
+static void
+print_latency(int64_t *samples, unsigned count)
+{
+   qsort(samples, count, sizeof(*samples), compare_int64);
+
+   printf(", \"p50_us\": %.2f, \"p90_us\": %.2f, \"p99_us\": %.2f"
+          ", \"max_us\": %.2f",
+          samples[count / 2] / 1000.0,
+          samples[count * 9 / 10] / 1000.0,
+          samples[count * 99 / 100] / 1000.0,
+          samples[count - 1] / 1000.0);
+}
+
+static void
+print_header(struct virgl_server_winsys *vws, const char *name,
+             unsigned iterations)
+{
+   printf("{\"bench\": \"%s\", \"ring\": %s, \"fences\": %s, "
+          "\"batch_destroys\": %s, \"iterations\": %u",
+          name, vws->ring ? "true" : "false",
+          vws->fence_page ? "true" : "false",
+          vws->batch_destroys ? "true" : "false", iterations);
+}
+
+/* A round trip that returns once the server handled everything before it. */
+static void
+sync_server(struct virgl_server_winsys *vws)
+{
+   virgl_server_send_resource_busy_wait(vws, 0, VCMD_BUSY_WAIT_FLAG_WAIT);
+}
+
+static void
+wait_seqno(struct virgl_server_winsys *vws, uint32_t seqno)
+{
+   struct virgl_server_fence_page *page = vws->fence_page;
+
+   for (;;) {
+      uint32_t completed = p_atomic_read(&page->completed_seqno);
+      if ((int32_t)(completed - seqno) >= 0)
+         return;
+
+      p_atomic_xchg(&page->waiters, 1);
+      futex_wait(&page->completed_seqno, completed, NULL);
+   }
+}
+
+static void
+bench_submit(struct virgl_server_winsys *vws, unsigned iterations,
+             unsigned size)
+{
+   struct virgl_server_cmd_buf cbuf = { 0 };
+   uint32_t seqno;
+
+   cbuf.buf = malloc(size);
+   cbuf.base.cdw = size / 4;
+   for (unsigned i = 0; i < cbuf.base.cdw; i++)
+      cbuf.buf[i] = i;
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++)
+      virgl_server_submit_cmd(vws, &cbuf, &seqno);
+   sync_server(vws);
+   int64_t ns = os_time_get_nano() - start;
+
+   print_header(vws, "submit", iterations);
+   printf(", \"size\": %u, \"cmds_per_s\": %.0f, \"mb_per_s\": %.1f}\n",
+          size, iterations * 1e9 / ns,
+          (double)iterations * size * 1e9 / ns / (1024 * 1024));
+
+   free(cbuf.buf);
+}
+
+/* Time from submit until the fence page reports it retired. */
+static void
+bench_fence(struct virgl_server_winsys *vws, unsigned iterations)
+{
+   struct virgl_server_cmd_buf cbuf = { 0 };
+   uint32_t cmd[16] = { 0 };
+   uint32_t seqno;
+
+   if (!vws->fence_page)
+      return;
+
+   cbuf.buf = cmd;
+   cbuf.base.cdw = ARRAY_SIZE(cmd);
+
+   int64_t *samples = malloc(iterations * sizeof(*samples));
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start = os_time_get_nano();
+      virgl_server_submit_cmd(vws, &cbuf, &seqno);
+      wait_seqno(vws, seqno);
+      samples[i] = os_time_get_nano() - start;
+   }
+
+   print_header(vws, "fence_wait", iterations);
+   print_latency(samples, iterations);
+   printf("}\n");
+   free(samples);
+}
+
+static void
+bench_resource(struct virgl_server_winsys *vws, unsigned iterations,
+               unsigned size)
+{
+   int64_t *samples = malloc(iterations * sizeof(*samples));
+
+   int64_t total_start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      uint32_t handle = util_idalloc_mt_alloc(&vws->handle_ids);
+      int fd = -1;
+
+      int64_t start = os_time_get_nano();
+      virgl_server_send_resource_create(vws, handle, PIPE_BUFFER, 0, 0,
+                                        size, 1, 1, 1, 0, 0, size, &fd);
+      samples[i] = os_time_get_nano() - start;
+
+      if (fd >= 0)
+         close(fd);
+      virgl_server_send_resource_destroy(vws, handle);
+   }
+   virgl_server_flush_resource_destroys(vws);
+   sync_server(vws);
+   int64_t ns = os_time_get_nano() - total_start;
+
+   print_header(vws, "resource_create_destroy", iterations);
+   printf(", \"size\": %u, \"per_s\": %.0f", size, iterations * 1e9 / ns);
+   print_latency(samples, iterations);
+   printf("}\n");
+   free(samples);
+}
+
+static void
+bench_busy_wait(struct virgl_server_winsys *vws, unsigned iterations)
+{
+   int64_t *samples = malloc(iterations * sizeof(*samples));
+
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start = os_time_get_nano();
+      virgl_server_send_resource_busy_wait(vws, 0, VCMD_BUSY_WAIT_FLAG_WAIT);
+      samples[i] = os_time_get_nano() - start;
+   }
+
+   print_header(vws, "busy_wait", iterations);
+   print_latency(samples, iterations);
+   printf("}\n");
+   free(samples);
+}
+
+/* The same round trips virgl_server_flush_frontbuffer() waits for. */
+static void
+bench_present(struct virgl_server_winsys *vws, unsigned iterations)
+{
+   int64_t *samples = malloc(iterations * sizeof(*samples));
+   uint32_t seqno;
+
+   for (unsigned i = 0; i < iterations; i++) {
+      int64_t start = os_time_get_nano();
+      if (vws->fence_page) {
+         virgl_server_send_present_async(vws, 0, 0, NULL, &seqno);
+         wait_seqno(vws, seqno);
+      } else {
+         virgl_server_send_flush_frontbuffer(vws, 0, 0);
+         virgl_server_send_resource_busy_wait(vws, 0,
+                                              VCMD_BUSY_WAIT_FLAG_WAIT);
+      }
+      samples[i] = os_time_get_nano() - start;
+   }
+
+   print_header(vws, "present", iterations);
+   print_latency(samples, iterations);
+   printf("}\n");
+   free(samples);
+}
+
+int
+main(int argc, char **argv)
+{
+   struct fake_server srv = { 0 };
+   unsigned iterations = argc > 1 ? atoi(argv[1]) : 10000;
+
+   if (!iterations) {
+      fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (!fake_server_start(&srv)) {
+      fprintf(stderr, "failed to start the fake server: %s\n",
+              strerror(errno));
+      return EXIT_FAILURE;
+   }
+
+   struct virgl_server_winsys *vws = CALLOC_STRUCT(virgl_server_winsys);
+   simple_mtx_init(&vws->send_mutex, mtx_plain);
+   util_idalloc_mt_init(&vws->handle_ids, 256, true);
+
+   if (virgl_server_connect(vws)) {
+      fprintf(stderr, "failed to connect to the fake server\n");
+      return EXIT_FAILURE;
+   }
+
+   static const unsigned submit_sizes[] = { 256, 4096, 65536 };
+   for (unsigned i = 0; i < ARRAY_SIZE(submit_sizes); i++)
+      bench_submit(vws, iterations, submit_sizes[i]);
+   bench_fence(vws, iterations);
+   bench_resource(vws, iterations, 4096);
+   bench_busy_wait(vws, iterations);
+   bench_present(vws, iterations);
+
+   virgl_server_stats_dump(vws);
+
+   virgl_server_ring_fini(vws);
+   virgl_server_fence_fini(vws);
+   close(vws->sock_fd);
+   fake_server_stop(&srv);
+
+   util_idalloc_mt_fini(&vws->handle_ids);
+   simple_mtx_destroy(&vws->send_mutex);
+   FREE(vws->stats);
+   FREE(vws);
+
+   return EXIT_SUCCESS;
+}
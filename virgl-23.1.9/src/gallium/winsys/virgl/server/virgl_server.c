@@ -26,10 +26,26 @@
 #include <stdio.h>
 #include <netinet/in.h>
 #include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <util/u_process.h>
+#include <util/build_id.h>
+#include <util/disk_cache.h>
+#include <util/mesa-sha1.h>
 #include <util/format/u_format.h>
+#include <util/anon_file.h>
+#include <util/futex.h>
+#include <util/os_mman.h>
+#include <util/os_misc.h>
+#include <util/u_atomic.h>
+#include <util/u_debug.h>
+#include <util/u_math.h>
+#include <util/log.h>
+#include <util/perf/cpu_trace.h>
+#include <util/u_memory.h>
+#include <inttypes.h>
 
 #include "virgl_server_winsys.h"
 #include "virgl_server_public.h"
@@ -53,6 +69,36 @@ static int virgl_block_write(int fd, void *buf, int size)
    return size;
 }
 
+static int virgl_block_writev(int fd, struct iovec *iov, int iovcnt)
+{
+   int total = 0;
+   int ret;
+
+   while (iovcnt) {
+      ret = writev(fd, iov, iovcnt);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return -errno;
+      }
+
+      total += ret;
+
+      /* Skip what was written, the kernel may stop in the middle of an iov. */
+      while (iovcnt && ret >= (int)iov->iov_len) {
+         ret -= iov->iov_len;
+         iov++;
+         iovcnt--;
+      }
+      if (iovcnt) {
+         iov->iov_base = (char *)iov->iov_base + ret;
+         iov->iov_len -= ret;
+      }
+   }
+
+   return total;
+}
+
 static int virgl_block_read(int fd, void *buf, int size)
 {
    char *ptr = buf;
@@ -107,6 +153,406 @@ static int virgl_server_recv_fd(int socket_fd)
    return *((int *) CMSG_DATA(cmsgh));
 }
 
+static int virgl_server_send_fds(int socket_fd, void *buf, int size,
+                                 const int *fds, int num_fds)
+{
+   struct cmsghdr *cmsgh;
+   struct msghdr msgh = { 0 };
+   char cmsg_buf[CMSG_SPACE(sizeof(int) * 2)];
+   struct iovec iovec;
+
+   assert(num_fds <= 2);
+
+   iovec.iov_base = buf;
+   iovec.iov_len = size;
+
+   msgh.msg_iov = &iovec;
+   msgh.msg_iovlen = 1;
+   msgh.msg_control = cmsg_buf;
+   msgh.msg_controllen = CMSG_SPACE(sizeof(int) * num_fds);
+
+   cmsgh = CMSG_FIRSTHDR(&msgh);
+   cmsgh->cmsg_level = SOL_SOCKET;
+   cmsgh->cmsg_type = SCM_RIGHTS;
+   cmsgh->cmsg_len = CMSG_LEN(sizeof(int) * num_fds);
+   memcpy(CMSG_DATA(cmsgh), fds, sizeof(int) * num_fds);
+
+   int ret;
+   do {
+      ret = sendmsg(socket_fd, &msgh, 0);
+   } while (ret < 0 && errno == EINTR);
+
+   return ret < 0 ? -errno : ret;
+}
+
+static void
+virgl_server_flush_resource_destroys_locked(struct virgl_server_winsys *vws);
+
+/* Writes the queued commands and the pending destroy batch followed by
+ * buf, all in one syscall.
+ */
+static void virgl_server_write_locked(struct virgl_server_winsys *vws,
+                                      const void *buf, int size,
+                                      const void *payload, int payload_size)
+{
+   struct iovec iov[3];
+   int iovcnt = 0;
+
+   virgl_server_flush_resource_destroys_locked(vws);
+
+   if (vws->stats && size) {
+      unsigned cmd = ((const uint32_t *)buf)[1];
+      if (cmd < VIRGL_SERVER_NUM_VCMDS) {
+         vws->stats->cmds[cmd]++;
+         vws->stats->bytes[cmd] += size + payload_size;
+      }
+   }
+
+   if (vws->send_queue_dw) {
+      iov[iovcnt].iov_base = vws->send_queue;
+      iov[iovcnt].iov_len = vws->send_queue_dw * 4;
+      iovcnt++;
+   }
+   if (size) {
+      iov[iovcnt].iov_base = (void *)buf;
+      iov[iovcnt].iov_len = size;
+      iovcnt++;
+   }
+   if (payload_size) {
+      iov[iovcnt].iov_base = (void *)payload;
+      iov[iovcnt].iov_len = payload_size;
+      iovcnt++;
+   }
+
+   if (iovcnt) {
+      MESA_TRACE_SCOPE("virgl_server_socket_write");
+      virgl_block_writev(vws->sock_fd, iov, iovcnt);
+      if (vws->stats)
+         vws->stats->socket_writes++;
+   }
+   vws->send_queue_dw = 0;
+}
+
+static void virgl_server_write(struct virgl_server_winsys *vws,
+                               const void *buf, int size)
+{
+   simple_mtx_lock(&vws->send_mutex);
+   virgl_server_write_locked(vws, buf, size, NULL, 0);
+   simple_mtx_unlock(&vws->send_mutex);
+}
+
+/* Queues a command that does not expect a reply.  It goes out with the next
+ * command that is written directly, which keeps the order on the wire.
+ */
+static void virgl_server_queue_locked(struct virgl_server_winsys *vws,
+                                      const uint32_t *cmd, unsigned ndw)
+{
+   if (vws->send_queue_dw + ndw > VIRGL_SERVER_SEND_QUEUE_DWORDS)
+      virgl_server_write_locked(vws, NULL, 0, NULL, 0);
+
+   if (vws->stats && cmd[1] < VIRGL_SERVER_NUM_VCMDS) {
+      vws->stats->cmds[cmd[1]]++;
+      vws->stats->bytes[cmd[1]] += ndw * 4;
+   }
+
+   memcpy(&vws->send_queue[vws->send_queue_dw], cmd, ndw * 4);
+   vws->send_queue_dw += ndw;
+}
+
+static void virgl_server_queue(struct virgl_server_winsys *vws,
+                               const uint32_t *cmd, unsigned ndw)
+{
+   simple_mtx_lock(&vws->send_mutex);
+   virgl_server_queue_locked(vws, cmd, ndw);
+   simple_mtx_unlock(&vws->send_mutex);
+}
+
+#define VIRGL_SERVER_RING_SIZE (1 << 20)
+
+static void virgl_server_ring_init(struct virgl_server_winsys *vws)
+{
+   uint32_t send_buf[3];
+   uint32_t recv_buf[3];
+   uint32_t map_size = sizeof(struct virgl_server_ring) + VIRGL_SERVER_RING_SIZE;
+   int fds[2];
+   int ret;
+
+   vws->ring = NULL;
+   vws->ring_eventfd = -1;
+
+   if (!debug_get_bool_option("VIRGL_SERVER_SHM_RING", false))
+      return;
+
+   fds[0] = os_create_anonymous_file(map_size, "virgl-server-ring");
+   if (fds[0] < 0)
+      return;
+
+   fds[1] = eventfd(0, EFD_CLOEXEC);
+   if (fds[1] < 0) {
+      close(fds[0]);
+      return;
+   }
+
+   void *map = os_mmap(NULL, map_size, PROT_WRITE | PROT_READ, MAP_SHARED,
+                       fds[0], 0);
+   if (map == MAP_FAILED) {
+      close(fds[1]);
+      close(fds[0]);
+      return;
+   }
+
+   struct virgl_server_ring *ring = map;
+   ring->size = VIRGL_SERVER_RING_SIZE / 4;
+
+   send_buf[0] = 1;
+   send_buf[1] = VCMD_RING_INIT;
+   send_buf[2] = map_size;
+
+   simple_mtx_lock(&vws->reply_mutex);
+   ret = virgl_server_send_fds(vws->sock_fd, send_buf, sizeof(send_buf), fds, 2);
+   close(fds[0]);
+
+   if (ret >= 0)
+      ret = virgl_block_read(vws->sock_fd, recv_buf, sizeof(recv_buf));
+   simple_mtx_unlock(&vws->reply_mutex);
+
+   if (ret <= 0 || !recv_buf[2]) {
+      os_munmap(map, map_size);
+      close(fds[1]);
+      return;
+   }
+
+   vws->ring = ring;
+   vws->ring_map_size = map_size;
+   virgl_server_mem_stats_add(vws, VIRGL_SERVER_MEM_RING, map_size);
+   vws->ring_eventfd = fds[1];
+}
+
+void virgl_server_ring_fini(struct virgl_server_winsys *vws)
+{
+   if (!vws->ring)
+      return;
+
+   os_munmap(vws->ring, vws->ring_map_size);
+   virgl_server_mem_stats_del(vws, VIRGL_SERVER_MEM_RING, vws->ring_map_size);
+   close(vws->ring_eventfd);
+   vws->ring = NULL;
+   vws->ring_eventfd = -1;
+}
+
+static void virgl_server_ring_copy(struct virgl_server_ring *ring, uint32_t pos,
+                                   const uint32_t *src, uint32_t ndw)
+{
+   uint32_t offset = pos & (ring->size - 1);
+   uint32_t first = MIN2(ndw, ring->size - offset);
+
+   memcpy(&ring->data[offset], src, first * 4);
+   if (first < ndw)
+      memcpy(&ring->data[0], src + first, (ndw - first) * 4);
+}
+
+static bool virgl_server_ring_submit(struct virgl_server_winsys *vws,
+                                     const uint32_t *cmd, uint32_t ndw)
+{
+   struct virgl_server_ring *ring = vws->ring;
+   uint32_t needed = ndw + 1;
+
+   if (needed > ring->size)
+      return false;
+
+   uint32_t head = ring->head;
+   for (;;) {
+      uint32_t tail = p_atomic_read(&ring->tail);
+      if (ring->size - (head - tail) >= needed)
+         break;
+
+      MESA_TRACE_SCOPE("virgl_server_ring_full");
+      if (vws->stats)
+         vws->stats->ring_full_waits++;
+
+      /* The kernel rechecks tail, so a wakeup between the two is not lost. */
+      p_atomic_xchg(&ring->client_waiting, 1);
+      futex_wait(&ring->tail, tail, NULL);
+   }
+
+   virgl_server_ring_copy(ring, head, &ndw, 1);
+   virgl_server_ring_copy(ring, head + 1, cmd, ndw);
+
+   /* Both atomics are full barriers: the payload is visible before head,
+    * and head is visible before we sample server_waiting.
+    */
+   p_atomic_xchg(&ring->head, head + needed);
+   if (p_atomic_xchg(&ring->server_waiting, 0)) {
+      uint64_t one = 1;
+      virgl_block_write(vws->ring_eventfd, &one, sizeof(one));
+      if (vws->stats)
+         vws->stats->ring_doorbells++;
+   }
+
+   if (vws->stats) {
+      vws->stats->cmds[VCMD_SUBMIT_CMD]++;
+      vws->stats->bytes[VCMD_SUBMIT_CMD] += needed * 4;
+      vws->stats->ring_submits++;
+   }
+
+   return true;
+}
+
+/* Sets up the fence page of the timeline behind sock_fd. */
+static struct virgl_server_fence_page *
+virgl_server_fence_page_create(struct virgl_server_winsys *vws, int sock_fd)
+{
+   uint32_t send_buf[3];
+   uint32_t recv_buf[3];
+   uint32_t map_size = 4096;
+   int fd;
+   int ret;
+
+   fd = os_create_anonymous_file(map_size, "virgl-server-fences");
+   if (fd < 0)
+      return NULL;
+
+   void *map = os_mmap(NULL, map_size, PROT_WRITE | PROT_READ, MAP_SHARED,
+                       fd, 0);
+   if (map == MAP_FAILED) {
+      close(fd);
+      return NULL;
+   }
+
+   send_buf[0] = 1;
+   send_buf[1] = VCMD_FENCE_INIT;
+   send_buf[2] = map_size;
+
+   ret = virgl_server_send_fds(sock_fd, send_buf, sizeof(send_buf), &fd, 1);
+   close(fd);
+
+   if (ret >= 0)
+      ret = virgl_block_read(sock_fd, recv_buf, sizeof(recv_buf));
+
+   if (ret <= 0 || !recv_buf[2]) {
+      os_munmap(map, map_size);
+      return NULL;
+   }
+
+   virgl_server_mem_stats_add(vws, VIRGL_SERVER_MEM_RING, map_size);
+   return map;
+}
+
+static void virgl_server_fence_init(struct virgl_server_winsys *vws)
+{
+   vws->fence_page = NULL;
+   vws->submit_seqno = 0;
+
+   if (!debug_get_bool_option("VIRGL_SERVER_FENCES", false))
+      return;
+
+   simple_mtx_lock(&vws->reply_mutex);
+   vws->fence_page = virgl_server_fence_page_create(vws, vws->sock_fd);
+   simple_mtx_unlock(&vws->reply_mutex);
+}
+
+void virgl_server_fence_fini(struct virgl_server_winsys *vws)
+{
+   if (!vws->fence_page)
+      return;
+
+   os_munmap(vws->fence_page, 4096);
+   virgl_server_mem_stats_del(vws, VIRGL_SERVER_MEM_RING, 4096);
+   vws->fence_page = NULL;
+}
+
+bool virgl_server_channel_init(struct virgl_server_winsys *vws,
+                               struct virgl_server_channel *channel)
+{
+   uint32_t send_buf[2];
+   send_buf[0] = 0;
+   send_buf[1] = VCMD_CHANNEL_CREATE;
+
+   int64_t start = os_time_get_nano();
+   simple_mtx_lock(&vws->reply_mutex);
+   virgl_server_write(vws, &send_buf, sizeof(send_buf));
+   int fd = virgl_server_recv_fd(vws->sock_fd);
+   simple_mtx_unlock(&vws->reply_mutex);
+   virgl_server_stats_wait(vws, VCMD_CHANNEL_CREATE, start);
+   if (fd < 0)
+      return false;
+
+   channel->fence_page = virgl_server_fence_page_create(vws, fd);
+   if (!channel->fence_page) {
+      close(fd);
+      return false;
+   }
+
+   channel->sock_fd = fd;
+   channel->submit_seqno = 0;
+   channel->in_use = false;
+   simple_mtx_init(&channel->mutex, mtx_plain);
+   return true;
+}
+
+void virgl_server_channels_fini(struct virgl_server_winsys *vws)
+{
+   for (unsigned i = 0; i < vws->num_channels; i++) {
+      struct virgl_server_channel *channel = &vws->channels[i];
+
+      close(channel->sock_fd);
+      os_munmap(channel->fence_page, 4096);
+      virgl_server_mem_stats_del(vws, VIRGL_SERVER_MEM_RING, 4096);
+      simple_mtx_destroy(&channel->mutex);
+   }
+   vws->num_channels = 0;
+}
+
+int virgl_server_send_fence_get_fd(struct virgl_server_winsys *vws,
+                                   struct virgl_server_channel *channel,
+                                   uint32_t seqno)
+{
+   uint32_t send_buf[3];
+   send_buf[0] = 1;
+   send_buf[1] = VCMD_FENCE_GET_FD;
+   send_buf[2] = seqno;
+
+   MESA_TRACE_FUNC();
+   int64_t start = os_time_get_nano();
+   int fd;
+   if (channel) {
+      simple_mtx_lock(&channel->mutex);
+      virgl_block_write(channel->sock_fd, &send_buf, sizeof(send_buf));
+      fd = virgl_server_recv_fd(channel->sock_fd);
+      simple_mtx_unlock(&channel->mutex);
+   } else {
+      simple_mtx_lock(&vws->reply_mutex);
+      virgl_server_write(vws, &send_buf, sizeof(send_buf));
+      fd = virgl_server_recv_fd(vws->sock_fd);
+      simple_mtx_unlock(&vws->reply_mutex);
+   }
+   virgl_server_stats_wait(vws, VCMD_FENCE_GET_FD, start);
+   return fd;
+}
+
+static void virgl_server_coherent_init(struct virgl_server_winsys *vws)
+{
+   uint32_t send_buf[2];
+   uint32_t recv_buf[3];
+   int ret;
+
+   vws->coherent = false;
+
+   if (!debug_get_bool_option("VIRGL_SERVER_COHERENT", false))
+      return;
+
+   send_buf[0] = 0;
+   send_buf[1] = VCMD_COHERENT_INIT;
+
+   simple_mtx_lock(&vws->reply_mutex);
+   ret = virgl_block_write(vws->sock_fd, send_buf, sizeof(send_buf));
+   if (ret >= 0)
+      ret = virgl_block_read(vws->sock_fd, recv_buf, sizeof(recv_buf));
+   simple_mtx_unlock(&vws->reply_mutex);
+
+   vws->coherent = ret > 0 && recv_buf[2];
+}
+
 static int virgl_server_send_create_renderer(struct virgl_server_winsys *vws)
 {
    uint32_t send_buf[2];
@@ -141,33 +587,236 @@ int virgl_server_connect(struct virgl_server_winsys *vws)
    } while (ret == -EINTR);
 
    vws->sock_fd = fd;
+
+   if (debug_get_bool_option("VIRGL_SERVER_STATS", false))
+      vws->stats = CALLOC_STRUCT(virgl_server_stats);
+
+   const char *mem_stats = os_get_option("VIRGL_SERVER_MEM_STATS");
+   vws->mem_stats.dump = mem_stats != NULL;
+   vws->mem_stats.dump_period = mem_stats ? strtoul(mem_stats, NULL, 0) : 0;
    
    virgl_server_send_create_renderer(vws);
+   virgl_server_ring_init(vws);
+   virgl_server_fence_init(vws);
+   virgl_server_coherent_init(vws);
+
+   vws->num_channels = 0;
+   vws->control_in_use = false;
+   vws->use_channels = vws->fence_page &&
+                       debug_get_bool_option("VIRGL_SERVER_CHANNELS", false);
+
+   vws->batch_destroys = debug_get_bool_option("VIRGL_SERVER_BATCH_DESTROY", false);
+
+   vws->present_depth = 0;
+   vws->present_index = 0;
+   memset(vws->present_seqnos, 0, sizeof(vws->present_seqnos));
+   if (vws->fence_page) {
+      vws->present_depth = MIN2(debug_get_num_option("VIRGL_SERVER_PRESENT_DEPTH", 0),
+                                VIRGL_SERVER_MAX_PRESENT_DEPTH);
+   }
+   vws->num_pending_destroys = 0;
+   vws->send_queue_dw = 0;
    return 0;
 }
 
+void virgl_server_stats_dump(struct virgl_server_winsys *vws)
+{
+   static const char *names[VIRGL_SERVER_NUM_VCMDS] = {
+      [VCMD_CREATE_RENDERER] = "CREATE_RENDERER",
+      [VCMD_GET_CAPS] = "GET_CAPS",
+      [VCMD_RESOURCE_CREATE] = "RESOURCE_CREATE",
+      [VCMD_RESOURCE_DESTROY] = "RESOURCE_DESTROY",
+      [VCMD_TRANSFER_GET] = "TRANSFER_GET",
+      [VCMD_TRANSFER_PUT] = "TRANSFER_PUT",
+      [VCMD_SUBMIT_CMD] = "SUBMIT_CMD",
+      [VCMD_RESOURCE_BUSY_WAIT] = "RESOURCE_BUSY_WAIT",
+      [VCMD_FLUSH_FRONTBUFFER] = "FLUSH_FRONTBUFFER",
+      [VCMD_RING_INIT] = "RING_INIT",
+      [VCMD_FENCE_INIT] = "FENCE_INIT",
+      [VCMD_FENCE_GET_FD] = "FENCE_GET_FD",
+      [VCMD_RESOURCE_DESTROY_BATCH] = "RESOURCE_DESTROY_BATCH",
+      [VCMD_ARENA_CREATE] = "ARENA_CREATE",
+      [VCMD_ARENA_DESTROY] = "ARENA_DESTROY",
+      [VCMD_RESOURCE_CREATE_ARENA] = "RESOURCE_CREATE_ARENA",
+      [VCMD_PRESENT_ASYNC] = "PRESENT_ASYNC",
+      [VCMD_COHERENT_INIT] = "COHERENT_INIT",
+      [VCMD_RESOURCE_CREATE_COHERENT] = "RESOURCE_CREATE_COHERENT",
+      [VCMD_GET_RENDERER_ID] = "GET_RENDERER_ID",
+      [VCMD_CHANNEL_CREATE] = "CHANNEL_CREATE",
+   };
+   struct virgl_server_stats *stats = vws->stats;
+
+   if (!stats)
+      return;
+
+   mesa_logi("virgl server protocol statistics:");
+   for (unsigned i = 0; i < VIRGL_SERVER_NUM_VCMDS; i++) {
+      if (!stats->cmds[i])
+         continue;
+
+      if (stats->wait_ns[i]) {
+         mesa_logi("  %-22s %10" PRIu64 " cmds %12" PRIu64 " bytes, "
+                   "avg wait %" PRIu64 " us, max wait %" PRIu64 " us",
+                   names[i], stats->cmds[i], stats->bytes[i],
+                   stats->wait_ns[i] / stats->cmds[i] / 1000,
+                   stats->max_wait_ns[i] / 1000);
+      } else {
+         mesa_logi("  %-22s %10" PRIu64 " cmds %12" PRIu64 " bytes",
+                   names[i], stats->cmds[i], stats->bytes[i]);
+      }
+   }
+   mesa_logi("  socket writes %" PRIu64 ", ring submits %" PRIu64
+             ", doorbells %" PRIu64 ", ring full waits %" PRIu64,
+             stats->socket_writes, stats->ring_submits,
+             stats->ring_doorbells, stats->ring_full_waits);
+   if (stats->fence_waits) {
+      mesa_logi("  fence waits %" PRIu64 ", avg %" PRIu64 " us",
+                stats->fence_waits,
+                stats->fence_wait_ns / stats->fence_waits / 1000);
+   }
+}
+
+void virgl_server_mem_stats_dump(struct virgl_server_winsys *vws)
+{
+   static const char *names[VIRGL_SERVER_MEM_COUNT] = {
+      [VIRGL_SERVER_MEM_BUFFER] = "buffers",
+      [VIRGL_SERVER_MEM_TEXTURE] = "textures",
+      [VIRGL_SERVER_MEM_SLAB] = "slab arenas",
+      [VIRGL_SERVER_MEM_CACHE] = "resource cache",
+      [VIRGL_SERVER_MEM_RING] = "ring",
+   };
+   struct virgl_server_mem_stats *stats = &vws->mem_stats;
+   uint64_t total = 0;
+
+   for (unsigned i = 0; i < VIRGL_SERVER_MEM_COUNT; i++)
+      total += p_atomic_read(&stats->size[i]);
+
+   mesa_logi("virgl server shared memory, frame %u: %" PRIu64 " kb",
+             stats->frame, total / 1024);
+   for (unsigned i = 0; i < VIRGL_SERVER_MEM_COUNT; i++) {
+      uint32_t count = p_atomic_read(&stats->count[i]);
+      if (!count)
+         continue;
+      mesa_logi("  %-16s %6u maps %10" PRIu64 " kb", names[i], count,
+                p_atomic_read(&stats->size[i]) / 1024);
+   }
+}
+
+/* Returns the number of id dwords stored in id, 0 when the server has no
+ * stable renderer id.
+ */
+static unsigned
+virgl_server_send_get_renderer_id(struct virgl_server_winsys *vws,
+                                  uint32_t id[VCMD_RENDERER_ID_MAX_DWORDS])
+{
+   uint32_t send_buf[2];
+   uint32_t resp_buf[2];
+   int ret;
+   send_buf[0] = 0;
+   send_buf[1] = VCMD_GET_RENDERER_ID;
+
+   int64_t start = os_time_get_nano();
+   simple_mtx_lock(&vws->reply_mutex);
+   virgl_server_write(vws, &send_buf, sizeof(send_buf));
+
+   ret = virgl_block_read(vws->sock_fd, resp_buf, sizeof(resp_buf));
+   virgl_server_stats_wait(vws, VCMD_GET_RENDERER_ID, start);
+   if (ret <= 0 || !resp_buf[0]) {
+      simple_mtx_unlock(&vws->reply_mutex);
+      return 0;
+   }
+
+   uint32_t id_dw = MIN2(resp_buf[0], VCMD_RENDERER_ID_MAX_DWORDS);
+   ret = virgl_block_read(vws->sock_fd, id, id_dw * 4);
+
+   /* drop what doesn't fit, keeping the stream in sync */
+   for (uint32_t i = id_dw; i < resp_buf[0] && ret > 0; i++) {
+      uint32_t dummy;
+      ret = virgl_block_read(vws->sock_fd, &dummy, sizeof(dummy));
+   }
+   simple_mtx_unlock(&vws->reply_mutex);
+
+   return ret > 0 ? id_dw : 0;
+}
+
+/* The caps of a given renderer id are cached on disk, which saves every
+ * new process the GET_CAPS round trip and the transfer of the whole caps
+ * blob.  The client build is part of the cache identity since it defines
+ * the layout of union virgl_caps.
+ */
+static struct disk_cache *
+virgl_server_caps_cache_create(void)
+{
+   const struct build_id_note *note =
+      build_id_find_nhdr_for_addr(virgl_server_caps_cache_create);
+   if (!note || build_id_length(note) != 20)
+      return NULL;
+
+   char timestamp[41];
+   _mesa_sha1_format(timestamp, build_id_data(note));
+
+   return disk_cache_create("virgl_server_caps", timestamp, 0);
+}
+
 int virgl_server_send_get_caps(struct virgl_server_winsys *vws,
                                struct virgl_drm_caps *caps)
 {
    uint32_t send_buf[2];
    uint32_t resp_buf[2];
    uint32_t caps_size = sizeof(struct virgl_caps_v2);
+   uint32_t id[VCMD_RENDERER_ID_MAX_DWORDS];
+   struct disk_cache *cache = NULL;
+   cache_key key;
    int ret;
+
+   if (debug_get_bool_option("VIRGL_SERVER_CAPS_CACHE", false)) {
+      unsigned id_dw = virgl_server_send_get_renderer_id(vws, id);
+      if (id_dw)
+         cache = virgl_server_caps_cache_create();
+
+      if (cache) {
+         size_t size;
+
+         disk_cache_compute_key(cache, id, id_dw * 4, key);
+         void *blob = disk_cache_get(cache, key, &size);
+         if (blob && size == sizeof(caps->caps)) {
+            memcpy(&caps->caps, blob, size);
+            free(blob);
+            disk_cache_destroy(cache);
+            return 0;
+         }
+         free(blob);
+      }
+   }
+
    send_buf[0] = 0;
    send_buf[1] = VCMD_GET_CAPS;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   int64_t start = os_time_get_nano();
+   simple_mtx_lock(&vws->reply_mutex);
+   virgl_server_write(vws, &send_buf, sizeof(send_buf));
 
    ret = virgl_block_read(vws->sock_fd, resp_buf, sizeof(resp_buf));
-   if (ret <= 0)
+   virgl_server_stats_wait(vws, VCMD_GET_CAPS, start);
+   if (ret <= 0) {
+      simple_mtx_unlock(&vws->reply_mutex);
+      disk_cache_destroy(cache);
       return 0;
+   }
 
    uint32_t resp_size = resp_buf[0] - 1;
    
    if (resp_size > caps_size)
 	  resp_size = caps_size;
 
-   virgl_block_read(vws->sock_fd, &caps->caps, resp_size);
+   ret = virgl_block_read(vws->sock_fd, &caps->caps, resp_size);
+   simple_mtx_unlock(&vws->reply_mutex);
+
+   if (cache) {
+      if (ret > 0)
+         disk_cache_put(cache, key, &caps->caps, sizeof(caps->caps), NULL);
+      disk_cache_destroy(cache);
+   }
    return 0;
 }
 
@@ -183,11 +832,14 @@ int virgl_server_send_resource_create(struct virgl_server_winsys *vws,
                                       uint32_t last_level,
                                       uint32_t nr_samples,
                                       uint32_t size,
+                                      bool coherent,
                                       int *out_fd)
 {
+   const uint32_t cmd = coherent ? VCMD_RESOURCE_CREATE_COHERENT :
+                                   VCMD_RESOURCE_CREATE;
    uint32_t send_buf[13];
    send_buf[0] = 11;
-   send_buf[1] = VCMD_RESOURCE_CREATE;
+   send_buf[1] = cmd;
    send_buf[2] = handle;
    send_buf[3] = target;
    send_buf[4] = format;
@@ -200,27 +852,136 @@ int virgl_server_send_resource_create(struct virgl_server_winsys *vws,
    send_buf[11] = nr_samples;
    send_buf[12] = size;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
-   
-   if (size == 0)
+   MESA_TRACE_FUNC();
+   int64_t start = os_time_get_nano();
+   if (size == 0) {
+      virgl_server_write(vws, &send_buf, sizeof(send_buf));
       return 0;
+   }
 
+   simple_mtx_lock(&vws->reply_mutex);
+   virgl_server_write(vws, &send_buf, sizeof(send_buf));
    *out_fd = virgl_server_recv_fd(vws->sock_fd);
+   simple_mtx_unlock(&vws->reply_mutex);
+   virgl_server_stats_wait(vws, cmd, start);
    if (*out_fd < 0)
       return -1;
 
    return 0;
 }
 
+int virgl_server_send_resource_create_arena(struct virgl_server_winsys *vws,
+                                            uint32_t handle,
+                                            enum pipe_texture_target target,
+                                            uint32_t format,
+                                            uint32_t bind,
+                                            uint32_t width,
+                                            uint32_t height,
+                                            uint32_t depth,
+                                            uint32_t array_size,
+                                            uint32_t last_level,
+                                            uint32_t nr_samples,
+                                            uint32_t size,
+                                            uint32_t arena_id,
+                                            uint32_t offset)
+{
+   uint32_t send_buf[15];
+   send_buf[0] = 13;
+   send_buf[1] = VCMD_RESOURCE_CREATE_ARENA;
+   send_buf[2] = handle;
+   send_buf[3] = target;
+   send_buf[4] = format;
+   send_buf[5] = bind;
+   send_buf[6] = width;
+   send_buf[7] = height;
+   send_buf[8] = depth;
+   send_buf[9] = array_size;
+   send_buf[10] = last_level;
+   send_buf[11] = nr_samples;
+   send_buf[12] = size;
+   send_buf[13] = arena_id;
+   send_buf[14] = offset;
+
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
+   return 0;
+}
+
+int virgl_server_send_arena_create(struct virgl_server_winsys *vws,
+                                   uint32_t arena_id, uint32_t size, int fd)
+{
+   uint32_t send_buf[4];
+   send_buf[0] = 2;
+   send_buf[1] = VCMD_ARENA_CREATE;
+   send_buf[2] = arena_id;
+   send_buf[3] = size;
+
+   simple_mtx_lock(&vws->send_mutex);
+   virgl_server_write_locked(vws, NULL, 0, NULL, 0);
+   int ret = virgl_server_send_fds(vws->sock_fd, send_buf, sizeof(send_buf), &fd, 1);
+   simple_mtx_unlock(&vws->send_mutex);
+   return ret < 0 ? ret : 0;
+}
+
+int virgl_server_send_arena_destroy(struct virgl_server_winsys *vws,
+                                    uint32_t arena_id)
+{
+   uint32_t send_buf[3];
+   send_buf[0] = 1;
+   send_buf[1] = VCMD_ARENA_DESTROY;
+   send_buf[2] = arena_id;
+
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
+   return 0;
+}
+
+static void
+virgl_server_flush_resource_destroys_locked(struct virgl_server_winsys *vws)
+{
+   unsigned count = vws->num_pending_destroys;
+
+   if (!count)
+      return;
+
+   vws->destroy_buf[0] = count;
+   vws->destroy_buf[1] = VCMD_RESOURCE_DESTROY_BATCH;
+   vws->num_pending_destroys = 0;
+   virgl_server_queue_locked(vws, vws->destroy_buf, count + 2);
+
+   /* The server handles commands in order and everything sent later is
+    * queued behind the batch, so the handles can be reused right away.
+    */
+   for (unsigned i = 0; i < count; i++)
+      util_idalloc_mt_free(&vws->handle_ids, vws->destroy_buf[2 + i]);
+}
+
+void virgl_server_flush_resource_destroys(struct virgl_server_winsys *vws)
+{
+   virgl_server_write(vws, NULL, 0);
+}
+
 int virgl_server_send_resource_destroy(struct virgl_server_winsys *vws,
                                        uint32_t handle)
 {
    uint32_t send_buf[3];
+
+   if (vws->batch_destroys) {
+      simple_mtx_lock(&vws->send_mutex);
+      vws->destroy_buf[2 + vws->num_pending_destroys++] = handle;
+      if (vws->num_pending_destroys == VCMD_DESTROY_BATCH_MAX_HANDLES)
+         virgl_server_flush_resource_destroys_locked(vws);
+      simple_mtx_unlock(&vws->send_mutex);
+      return 0;
+   }
+
    send_buf[0] = 1;
    send_buf[1] = VCMD_RESOURCE_DESTROY;
    send_buf[2] = handle;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   /* Anything sent later is queued behind the destroy or flushes it first,
+    * so the handle can be reused right away.
+    */
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
+   util_idalloc_mt_free(&vws->handle_ids, handle);
    return 0;
 }
 
@@ -246,7 +1007,7 @@ int virgl_server_send_transfer_get(struct virgl_server_winsys *vws,
    send_buf[10] = data_size;
    send_buf[11] = offset;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
    return 0;
 }
 
@@ -272,19 +1033,75 @@ int virgl_server_send_transfer_put(struct virgl_server_winsys *vws,
    send_buf[10] = data_size;
    send_buf[11] = offset;
    
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
    return 0;
 }
 
 int virgl_server_submit_cmd(struct virgl_server_winsys *vws,
-                            struct virgl_server_cmd_buf *cbuf)
+                            struct virgl_server_cmd_buf *cbuf,
+                            uint32_t *seqno)
 {
    uint32_t send_buf[2];
+
+   MESA_TRACE_FUNC();
+
+   /* The server numbers submits in the order it receives them, so taking the
+    * sequence number and sending the commands must not be interleaved with
+    * another thread's submit.
+    */
+   simple_mtx_lock(&vws->send_mutex);
+
+   if (cbuf->channel) {
+      struct virgl_server_channel *channel = cbuf->channel;
+      struct iovec iov[2];
+
+      /* The server handles what the initial socket received before the
+       * channel submit, so the queued transfers and destroys only have to
+       * be written out.  The channel itself needs send_mutex no longer.
+       */
+      virgl_server_write_locked(vws, NULL, 0, NULL, 0);
+      simple_mtx_unlock(&vws->send_mutex);
+
+      send_buf[0] = cbuf->base.cdw;
+      send_buf[1] = VCMD_SUBMIT_CMD;
+      iov[0].iov_base = send_buf;
+      iov[0].iov_len = sizeof(send_buf);
+      iov[1].iov_base = cbuf->buf;
+      iov[1].iov_len = cbuf->base.cdw * 4;
+
+      simple_mtx_lock(&channel->mutex);
+      *seqno = ++channel->submit_seqno;
+      virgl_block_writev(channel->sock_fd, iov, 2);
+      simple_mtx_unlock(&channel->mutex);
+
+      if (vws->stats) {
+         p_atomic_inc(&vws->stats->cmds[VCMD_SUBMIT_CMD]);
+         p_atomic_add(&vws->stats->bytes[VCMD_SUBMIT_CMD],
+                      sizeof(send_buf) + cbuf->base.cdw * 4);
+      }
+      return 0;
+   }
+
+   *seqno = ++vws->submit_seqno;
+
+   if (vws->ring) {
+      /* Queued socket commands must reach the server before the ring
+       * submit that may depend on them.
+       */
+      virgl_server_write_locked(vws, NULL, 0, NULL, 0);
+      if (virgl_server_ring_submit(vws, cbuf->buf, cbuf->base.cdw)) {
+         simple_mtx_unlock(&vws->send_mutex);
+         return 0;
+      }
+   }
+
    send_buf[0] = cbuf->base.cdw;
    send_buf[1] = VCMD_SUBMIT_CMD;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
-   virgl_block_write(vws->sock_fd, cbuf->buf, cbuf->base.cdw * 4);
+   virgl_server_write_locked(vws, send_buf, sizeof(send_buf),
+                             cbuf->buf, cbuf->base.cdw * 4);
+
+   simple_mtx_unlock(&vws->send_mutex);
    return 0;
 }
 
@@ -298,8 +1115,13 @@ int virgl_server_send_resource_busy_wait(struct virgl_server_winsys *vws, int ha
    send_buf[2] = handle;
    send_buf[3] = flags;
 
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   MESA_TRACE_FUNC();
+   int64_t start = os_time_get_nano();
+   simple_mtx_lock(&vws->reply_mutex);
+   virgl_server_write(vws, &send_buf, sizeof(send_buf));
    virgl_block_read(vws->sock_fd, recv_buf, sizeof(recv_buf));
+   simple_mtx_unlock(&vws->reply_mutex);
+   virgl_server_stats_wait(vws, VCMD_RESOURCE_BUSY_WAIT, start);
    return recv_buf[2];
 }
 
@@ -313,6 +1135,32 @@ int virgl_server_send_flush_frontbuffer(struct virgl_server_winsys *vws,
    send_buf[2] = handle;
    send_buf[3] = drawable;
    
-   virgl_block_write(vws->sock_fd, &send_buf, sizeof(send_buf));
+   virgl_server_queue(vws, send_buf, ARRAY_SIZE(send_buf));
+   return 0;
+}
+
+int virgl_server_send_present_async(struct virgl_server_winsys *vws,
+                                    uint32_t handle,
+                                    uint32_t drawable,
+                                    const struct pipe_box *damage,
+                                    uint32_t *seqno)
+{
+   uint32_t send_buf[8];
+   send_buf[0] = 6;
+   send_buf[1] = VCMD_PRESENT_ASYNC;
+   send_buf[2] = handle;
+   send_buf[3] = drawable;
+   send_buf[4] = damage ? damage->x : 0;
+   send_buf[5] = damage ? damage->y : 0;
+   send_buf[6] = damage ? damage->width : 0;
+   send_buf[7] = damage ? damage->height : 0;
+
+   MESA_TRACE_FUNC();
+
+   /* Presents share the submit sequence numbers. */
+   simple_mtx_lock(&vws->send_mutex);
+   *seqno = ++vws->submit_seqno;
+   virgl_server_write_locked(vws, send_buf, sizeof(send_buf), NULL, 0);
+   simple_mtx_unlock(&vws->send_mutex);
    return 0;
 }
@@ -23,6 +23,8 @@
 #ifndef VIRGL_SERVER_PROTOCOL_H
 #define VIRGL_SERVER_PROTOCOL_H
 
+#include <stdint.h>
+
 #define VIRGL_DEFAULT_SERVER_PATH "/tmp/.virgl_server"
 
 #define VCMD_CREATE_RENDERER 1
@@ -34,7 +36,134 @@
 #define VCMD_SUBMIT_CMD 7
 #define VCMD_RESOURCE_BUSY_WAIT 8
 #define VCMD_FLUSH_FRONTBUFFER 9
+#define VCMD_RING_INIT 10
+#define VCMD_FENCE_INIT 11
+#define VCMD_FENCE_GET_FD 12
+#define VCMD_RESOURCE_DESTROY_BATCH 13
+#define VCMD_ARENA_CREATE 14
+#define VCMD_ARENA_DESTROY 15
+#define VCMD_RESOURCE_CREATE_ARENA 16
+#define VCMD_PRESENT_ASYNC 17
+#define VCMD_COHERENT_INIT 18
+#define VCMD_RESOURCE_CREATE_COHERENT 19
+#define VCMD_GET_RENDERER_ID 20
+#define VCMD_CHANNEL_CREATE 21
 
 #define VCMD_BUSY_WAIT_FLAG_WAIT 1
 
+/* VCMD_RESOURCE_DESTROY_BATCH carries one resource handle per payload
+ * dword and behaves like that many VCMD_RESOURCE_DESTROY commands.
+ */
+#define VCMD_DESTROY_BATCH_MAX_HANDLES 256
+
+/* Shared arenas for small buffers.
+ *
+ * VCMD_ARENA_CREATE carries an arena id and the arena size in bytes, the
+ * memfd backing it is passed in the same SCM_RIGHTS message.
+ * VCMD_RESOURCE_CREATE_ARENA takes the same arguments as
+ * VCMD_RESOURCE_CREATE followed by an arena id and a byte offset; the new
+ * resource's storage lives in the arena at that offset and no fd is sent
+ * back.  The server keeps an arena mapped until VCMD_ARENA_DESTROY has been
+ * received and every resource carved out of it has been destroyed.
+ */
+
+/* Shared-memory command ring.
+ *
+ * VCMD_RING_INIT is sent right after VCMD_CREATE_RENDERER with the size of
+ * the ring mapping in bytes.  The memfd backing the ring and an eventfd used
+ * as doorbell are passed in the same SCM_RIGHTS message.  The server answers
+ * with three dwords: a length of 1, the command id and a value that is
+ * non-zero when the ring was accepted; otherwise the client keeps using
+ * VCMD_SUBMIT_CMD on the socket.
+ *
+ * Every submit is stored at head as one length dword followed by that many
+ * command dwords, wrapping at size.  head and tail are free running dword
+ * counters: the client advances head, the server advances tail.  The server
+ * sets server_waiting before sleeping on the eventfd and the client only
+ * rings the doorbell when it finds the flag set.  Likewise the client sets
+ * client_waiting before sleeping on the tail futex when the ring is full.
+ *
+ * The server must drain the ring before it handles the next socket command,
+ * so ring submits stay ordered against every other VCMD.
+ */
+struct virgl_server_ring {
+   uint32_t head;
+   uint32_t server_waiting;
+   uint32_t pad0[14];
+   uint32_t tail;
+   uint32_t client_waiting;
+   uint32_t size;
+   uint32_t pad1[13];
+   uint32_t data[];
+};
+
+/* VCMD_GET_RENDERER_ID carries no arguments.  The server answers with a
+ * length dword, the command id and that many dwords (at most
+ * VCMD_RENDERER_ID_MAX_DWORDS) identifying its renderer and version: two
+ * servers reporting the same id must report the same caps.  A zero length
+ * means the caps may change between connections.
+ */
+#define VCMD_RENDERER_ID_MAX_DWORDS 16
+
+/* Shared-coherent resources.
+ *
+ * VCMD_COHERENT_INIT carries no arguments and the server answers with three
+ * dwords: a length of 1, the command id and a value that is non-zero when
+ * it supports VCMD_RESOURCE_CREATE_COHERENT.  That command takes the same
+ * arguments and sends back a memfd just like VCMD_RESOURCE_CREATE, but the
+ * memfd is the resource's storage of record rather than a transfer area:
+ * whatever the client wrote to it before a submit is what the host sees
+ * while executing that submit, and whatever the host wrote is in the memfd
+ * once that submit's sequence number has retired.  Neither VCMD_TRANSFER_PUT nor
+ * VCMD_TRANSFER_GET is sent for these resources; ordering against the host
+ * comes from submits and fences alone.
+ */
+
+/* VCMD_PRESENT_ASYNC takes a resource handle, a drawable and a damage box
+ * (x, y, width, height; a zero width presents the whole resource).  It
+ * does not block the client: it consumes the next submit sequence number
+ * and the server signals it like a submit once the present is done, see
+ * below.  Only used when the fence page has been set up.
+ */
+
+/* Sequence number fences.
+ *
+ * VCMD_FENCE_INIT passes a memfd holding a struct virgl_server_fence_page
+ * and the server answers with three dwords: a length of 1, the command id
+ * and a value that is non-zero when it will maintain the page.  From then
+ * on the n-th VCMD_SUBMIT_CMD (whether sent on the socket or through the
+ * ring) has sequence number n, and the server
+ * stores n into completed_seqno once the work of that submit has retired.
+ * completed_seqno only ever grows.  Whenever it changes and waiters is
+ * non-zero the server clears waiters and does a FUTEX_WAKE on
+ * completed_seqno.
+ *
+ * VCMD_FENCE_GET_FD carries a sequence number; the server answers with a
+ * pollable fd (sync_file or eventfd) that signals once that sequence number
+ * has retired, sent in an SCM_RIGHTS message.
+ */
+struct virgl_server_fence_page {
+   uint32_t completed_seqno;
+   uint32_t waiters;
+};
+
+/* Submission channels.
+ *
+ * VCMD_CHANNEL_CREATE carries no arguments and is only sent once the fence
+ * page has been set up.  The server answers with an SCM_RIGHTS message
+ * holding one end of a new socket, or without an fd when it can't create
+ * one.  A channel only takes VCMD_FENCE_INIT, VCMD_SUBMIT_CMD and
+ * VCMD_FENCE_GET_FD, and has a timeline of its
+ * own: its first command is a VCMD_FENCE_INIT for the channel's fence page
+ * and its submits are numbered from 1 independently of the other channels.
+ *
+ * The server may execute channels concurrently, but within a channel and
+ * against the initial socket everything stays in order: before handling a
+ * channel command the server handles every command already received on
+ * the initial socket.  The client completes the writes of everything a
+ * channel submit depends on before writing the submit.  A
+ * VCMD_RESOURCE_BUSY_WAIT on the initial socket covers the work of every
+ * channel.
+ */
+
 #endif
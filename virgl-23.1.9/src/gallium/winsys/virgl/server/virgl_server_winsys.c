@@ -20,6 +20,8 @@
  * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
  * USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
 #include "util/u_surface.h"
 #include "util/u_memory.h"
@@ -29,6 +31,15 @@
 #include "frontend/sw_winsys.h"
 #include "frontend/xlibsw_api.h"
 #include "util/os_mman.h"
+#include "util/os_file.h"
+#include "util/futex.h"
+#include "util/libsync.h"
+#include "util/anon_file.h"
+#include "util/u_debug.h"
+#include "util/driconf.h"
+#include "util/xmlconfig.h"
+#include "util/perf/cpu_trace.h"
+#include "util/perf/u_stall.h"
 
 #include "virgl_server_winsys.h"
 #include "virgl_server_public.h"
@@ -41,6 +52,8 @@ static void *virgl_server_resource_map(struct virgl_winsys *vws,
                                        struct virgl_hw_res *res);
 static void virgl_server_resource_unmap(struct virgl_winsys *vws,
                                         struct virgl_hw_res *res);
+static void virgl_server_resource_wait(struct virgl_winsys *vws,
+                                       struct virgl_hw_res *res);
 									   
 struct virgl_displaytarget {
    struct sw_displaytarget *sw_dt;
@@ -58,10 +71,8 @@ virgl_displaytarget_create(struct virgl_server_winsys *vsws,
                            uint32_t *stride)
 {
    struct virgl_displaytarget *dt = CALLOC_STRUCT(virgl_displaytarget);
-   
-   const char *no_readback_value = getenv("VIRGL_NO_READBACK");
-   
-   dt->no_readback = !no_readback_value || !strcmp(no_readback_value, "true") || !strcmp(no_readback_value, "1");
+
+   dt->no_readback = vsws->no_readback;
    dt->sw_dt = vsws->sws->displaytarget_create(vsws->sws, bind, format,
                                                width, height, alignment, map_front_private,
                                                stride);
@@ -85,6 +96,64 @@ static inline boolean can_cache_resource_with_bind(uint32_t bind)
           bind == VIRGL_BIND_STAGING;
 }
 
+static inline struct virgl_server_fence_page *
+virgl_server_timeline_page(struct virgl_server_winsys *vsws,
+                           struct virgl_server_channel *channel)
+{
+   return channel ? channel->fence_page : vsws->fence_page;
+}
+
+static inline bool
+virgl_server_seqno_signalled(struct virgl_server_fence_page *page,
+                             uint32_t seqno)
+{
+   uint32_t completed = p_atomic_read(&page->completed_seqno);
+   return (int32_t)(completed - seqno) >= 0;
+}
+
+static bool virgl_server_seqno_wait(struct virgl_server_winsys *vsws,
+                                    struct virgl_server_fence_page *page,
+                                    uint32_t seqno, uint64_t timeout)
+{
+   struct timespec abs_timeout, *ts = NULL;
+
+   if (timeout != OS_TIMEOUT_INFINITE) {
+      int64_t abs_ns = os_time_get_absolute_timeout(timeout);
+      abs_timeout.tv_sec = abs_ns / 1000000000;
+      abs_timeout.tv_nsec = abs_ns % 1000000000;
+      ts = &abs_timeout;
+   }
+
+   MESA_TRACE_FUNC();
+   int64_t start = os_time_get_nano();
+   bool signalled = false;
+
+   for (;;) {
+      uint32_t completed = p_atomic_read(&page->completed_seqno);
+      if ((int32_t)(completed - seqno) >= 0) {
+         signalled = true;
+         break;
+      }
+
+      /* The kernel rechecks completed_seqno, so a store by the server that
+       * lands after the check above still wakes us up.
+       */
+      p_atomic_xchg(&page->waiters, 1);
+      if (futex_wait(&page->completed_seqno, completed, ts) < 0 &&
+          errno == ETIMEDOUT) {
+         signalled = virgl_server_seqno_signalled(page, seqno);
+         break;
+      }
+   }
+
+   if (vsws->stats) {
+      p_atomic_inc(&vsws->stats->fence_waits);
+      p_atomic_add(&vsws->stats->fence_wait_ns, os_time_get_nano() - start);
+   }
+
+   return signalled;
+}
+
 static uint32_t virgl_server_get_transfer_size(struct virgl_hw_res *res,
                                                const struct pipe_box *box,
                                                uint32_t stride, uint32_t layer_stride,
@@ -126,6 +195,8 @@ virgl_server_transfer_put(struct virgl_winsys *vws,
    virgl_server_send_transfer_put(vsws, res->res_handle,
                                   level, stride, layer_stride,
                                   box, size, buf_offset);
+   p_atomic_set(&res->transfer_pending, true);
+   p_atomic_set(&res->maybe_busy, true);
    return 0;
 }
 
@@ -148,9 +219,15 @@ virgl_server_transfer_get_internal(struct virgl_winsys *vws,
                                   level, stride, layer_stride,
                                   box, size, buf_offset);
 
-   virgl_server_send_resource_busy_wait(vsws, res->res_handle, VCMD_BUSY_WAIT_FLAG_WAIT);
+   /* Only issue the readback here.  Callers that need the data wait through
+    * resource_wait, which lets them overlap other work with the transfer.
+    */
+   p_atomic_set(&res->transfer_pending, true);
+   p_atomic_set(&res->maybe_busy, true);
 
    if (flush_front_buffer) {
+      virgl_server_resource_wait(vws, res);
+
       if (box->depth > 1 || box->z > 1)
          return -1;
 
@@ -191,12 +268,22 @@ virgl_server_transfer_get(struct virgl_winsys *vws,
 static void virgl_hw_res_destroy(struct virgl_server_winsys *vsws,
                                  struct virgl_hw_res *res)
 {
+   /* The server resource of a slab entry is destroyed once the entry is
+    * reclaimed, see virgl_server_slab_can_reclaim().
+    */
+   if (res->is_slab_entry) {
+      pb_slab_free(&vsws->slabs, &res->slab_entry);
+      return;
+   }
+
    virgl_server_send_resource_destroy(vsws, res->res_handle);
    if (res->dt)
       virgl_displaytarget_destroy(vsws, res->dt);
    
-   if (res->ptr)
+   if (res->ptr) {
       os_munmap(res->ptr, res->size);
+      virgl_server_mem_stats_del(vsws, res->mem_category, res->size);
+   }
 
    FREE(res);
 }
@@ -205,14 +292,56 @@ static boolean virgl_server_resource_is_busy(struct virgl_winsys *vws,
                                              struct virgl_hw_res *res)
 {
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
-
    int ret;
+
+   if (!p_atomic_read(&res->maybe_busy))
+      return false;
+
+   if (vsws->fence_page && !p_atomic_read(&res->transfer_pending) &&
+       !p_atomic_read(&res->multi_channel)) {
+      struct virgl_server_fence_page *page =
+         virgl_server_timeline_page(vsws, res->busy_channel);
+      if (!virgl_server_seqno_signalled(page, p_atomic_read(&res->busy_seqno)))
+         return true;
+      p_atomic_set(&res->maybe_busy, false);
+      return false;
+   }
+
    ret = virgl_server_send_resource_busy_wait(vsws, res->res_handle, 0);
 
    if (ret < 0)
       return false;
 
-   return ret == 1 ? true : false;
+   if (ret == 1)
+      return true;
+
+   p_atomic_set(&res->transfer_pending, false);
+   p_atomic_set(&res->multi_channel, false);
+   p_atomic_set(&res->maybe_busy, false);
+   return false;
+}
+
+static inline enum virgl_server_mem_category
+mem_category_for_target(enum pipe_texture_target target)
+{
+   return target == PIPE_BUFFER ? VIRGL_SERVER_MEM_BUFFER :
+                                  VIRGL_SERVER_MEM_TEXTURE;
+}
+
+/* Moves a mapped resource in or out of the resource cache's share. Slab
+ * entries are accounted for with their arena.
+ */
+static void
+virgl_server_mem_stats_move(struct virgl_server_winsys *vsws,
+                            struct virgl_hw_res *res,
+                            enum virgl_server_mem_category category)
+{
+   if (res->is_slab_entry || !res->ptr)
+      return;
+
+   virgl_server_mem_stats_del(vsws, res->mem_category, res->size);
+   virgl_server_mem_stats_add(vsws, category, res->size);
+   res->mem_category = category;
 }
 
 static void virgl_server_resource_reference(struct virgl_winsys *vws,
@@ -226,6 +355,7 @@ static void virgl_server_resource_reference(struct virgl_winsys *vws,
       if (!can_cache_resource_with_bind(old->bind)) {
          virgl_hw_res_destroy(vsws, old);
       } else {
+         virgl_server_mem_stats_move(vsws, old, VIRGL_SERVER_MEM_CACHE);
          mtx_lock(&vsws->mutex);
          virgl_resource_cache_add(&vsws->cache, &old->cache_entry);
          mtx_unlock(&vsws->mutex);
@@ -234,6 +364,157 @@ static void virgl_server_resource_reference(struct virgl_winsys *vws,
    *dres = sres;
 }
 
+/* Small buffers are carved out of shared arenas of this size. */
+#define VIRGL_SERVER_SLAB_SIZE (256 * 1024)
+#define VIRGL_SERVER_SLAB_MIN_ORDER 8  /* 256 bytes */
+#define VIRGL_SERVER_SLAB_MAX_ORDER 14 /* 16 KiB */
+
+static inline bool can_suballoc_resource(enum pipe_texture_target target,
+                                         uint32_t bind, uint32_t size)
+{
+   return target == PIPE_BUFFER &&
+          size > 0 && size <= (1 << VIRGL_SERVER_SLAB_MAX_ORDER) &&
+          (bind == VIRGL_BIND_CONSTANT_BUFFER ||
+           bind == VIRGL_BIND_INDEX_BUFFER ||
+           bind == VIRGL_BIND_VERTEX_BUFFER ||
+           bind == VIRGL_BIND_CUSTOM);
+}
+
+static struct pb_slab *
+virgl_server_slab_alloc(void *priv, unsigned heap, unsigned entry_size,
+                        unsigned group_index)
+{
+   struct virgl_server_winsys *vsws = priv;
+   struct virgl_server_slab *slab;
+   int fd;
+
+   slab = CALLOC_STRUCT(virgl_server_slab);
+   if (!slab)
+      return NULL;
+
+   slab->size = VIRGL_SERVER_SLAB_SIZE;
+   fd = os_create_anonymous_file(slab->size, "virgl-server-slab");
+   if (fd < 0)
+      goto fail;
+
+   slab->map = os_mmap(NULL, slab->size, PROT_WRITE | PROT_READ, MAP_SHARED,
+                       fd, 0);
+   if (slab->map == MAP_FAILED) {
+      close(fd);
+      goto fail;
+   }
+
+   slab->arena_id = p_atomic_inc_return(&vsws->next_arena_id);
+   if (virgl_server_send_arena_create(vsws, slab->arena_id, slab->size, fd)) {
+      close(fd);
+      goto fail_unmap;
+   }
+   close(fd);
+
+   slab->base.num_entries = slab->size / entry_size;
+   slab->base.num_free = slab->base.num_entries;
+   slab->entries = CALLOC(slab->base.num_entries, sizeof(*slab->entries));
+   if (!slab->entries)
+      goto fail_arena;
+
+   list_inithead(&slab->base.free);
+   virgl_server_mem_stats_add(vsws, VIRGL_SERVER_MEM_SLAB, slab->size);
+
+   for (unsigned i = 0; i < slab->base.num_entries; ++i) {
+      struct virgl_hw_res *res = &slab->entries[i];
+
+      res->is_slab_entry = true;
+      res->ptr = (char *)slab->map + i * entry_size;
+      res->slab_entry.slab = &slab->base;
+      res->slab_entry.group_index = group_index;
+      res->slab_entry.entry_size = entry_size;
+      list_addtail(&res->slab_entry.head, &slab->base.free);
+   }
+
+   return &slab->base;
+
+fail_arena:
+   virgl_server_send_arena_destroy(vsws, slab->arena_id);
+fail_unmap:
+   os_munmap(slab->map, slab->size);
+fail:
+   FREE(slab);
+   return NULL;
+}
+
+static void
+virgl_server_slab_free(void *priv, struct pb_slab *pslab)
+{
+   struct virgl_server_winsys *vsws = priv;
+   struct virgl_server_slab *slab = (struct virgl_server_slab *)pslab;
+
+   virgl_server_send_arena_destroy(vsws, slab->arena_id);
+   os_munmap(slab->map, slab->size);
+   virgl_server_mem_stats_del(vsws, VIRGL_SERVER_MEM_SLAB, slab->size);
+   FREE(slab->entries);
+   FREE(slab);
+}
+
+static bool
+virgl_server_slab_can_reclaim(void *priv, struct pb_slab_entry *entry)
+{
+   struct virgl_server_winsys *vsws = priv;
+   struct virgl_hw_res *res = container_of(entry, struct virgl_hw_res, slab_entry);
+
+   /* The arena memory may only be handed out again once the server is done
+    * with the old resource.
+    */
+   if (virgl_server_resource_is_busy(&vsws->base, res))
+      return false;
+
+   virgl_server_send_resource_destroy(vsws, res->res_handle);
+   return true;
+}
+
+static struct virgl_hw_res *
+virgl_server_slab_resource_create(struct virgl_server_winsys *vsws,
+                                  enum pipe_texture_target target,
+                                  uint32_t format,
+                                  uint32_t bind,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t depth,
+                                  uint32_t array_size,
+                                  uint32_t last_level,
+                                  uint32_t nr_samples,
+                                  uint32_t size)
+{
+   struct pb_slab_entry *entry;
+   struct virgl_server_slab *slab;
+   struct virgl_hw_res *res;
+
+   entry = pb_slab_alloc(&vsws->slabs, size, 0);
+   if (!entry)
+      return NULL;
+
+   res = container_of(entry, struct virgl_hw_res, slab_entry);
+   slab = (struct virgl_server_slab *)entry->slab;
+
+   res->bind = bind;
+   res->format = format;
+   res->height = height;
+   res->width = width;
+   res->size = size;
+   res->stride = 0;
+   res->mapped = NULL;
+   res->maybe_busy = false;
+   res->transfer_pending = false;
+   res->res_handle = util_idalloc_mt_alloc(&vsws->handle_ids);
+
+   virgl_server_send_resource_create_arena(vsws, res->res_handle, target,
+                                           pipe_to_virgl_format(format), bind,
+                                           width, height, depth, array_size,
+                                           last_level, nr_samples, size,
+                                           slab->arena_id,
+                                           (char *)res->ptr - (char *)slab->map);
+   return res;
+}
+
 static struct virgl_hw_res *
 virgl_server_winsys_resource_create(struct virgl_winsys *vws,
                                     enum pipe_texture_target target,
@@ -246,16 +527,20 @@ virgl_server_winsys_resource_create(struct virgl_winsys *vws,
                                     uint32_t array_size,
                                     uint32_t last_level,
                                     uint32_t nr_samples,
+                                    uint32_t flags,
                                     uint32_t size)
 {
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
    struct virgl_hw_res *res;
-   static int handle = 1;
+   uint32_t handle;
    int fd = -1;
+   const bool coherent = vsws->coherent &&
+                         (flags & (VIRGL_RESOURCE_FLAG_MAP_PERSISTENT |
+                                   VIRGL_RESOURCE_FLAG_MAP_COHERENT));
    struct virgl_resource_params params = { .size = size,
                                            .bind = bind,
                                            .format = format,
-                                           .flags = 0,
+                                           .flags = flags,
                                            .nr_samples = nr_samples,
                                            .width = width,
                                            .height = height,
@@ -264,10 +549,24 @@ virgl_server_winsys_resource_create(struct virgl_winsys *vws,
                                            .last_level = last_level,
                                            .target = target };   
 
+   /* Arena storage is only a transfer area, coherent resources need their
+    * own memfd.
+    */
+   if (vsws->use_slabs && !coherent &&
+       can_suballoc_resource(target, bind, size)) {
+      res = virgl_server_slab_resource_create(vsws, target, format, bind,
+                                              width, height, depth, array_size,
+                                              last_level, nr_samples, size);
+      if (res)
+         goto out_init;
+   }
+
    res = CALLOC_STRUCT(virgl_hw_res);
    if (!res)
       return NULL;
 
+   handle = util_idalloc_mt_alloc(&vsws->handle_ids);
+
    if (bind & (VIRGL_BIND_DISPLAY_TARGET | VIRGL_BIND_SCANOUT)) {
       res->dt = virgl_displaytarget_create(vsws, bind, format,
                                            width, height, 64, map_front_private,
@@ -282,7 +581,8 @@ virgl_server_winsys_resource_create(struct virgl_winsys *vws,
    res->size = size;
    virgl_server_send_resource_create(vsws, handle, target, pipe_to_virgl_format(format), bind,
                                      width, height, depth, array_size,
-                                     last_level, nr_samples, size, &fd);
+                                     last_level, nr_samples, size, coherent,
+                                     &fd);
 
    if (res->size == 0) {
       res->ptr = NULL;
@@ -305,9 +605,13 @@ virgl_server_winsys_resource_create(struct virgl_winsys *vws,
 
    close(fd);
 
+   res->mem_category = mem_category_for_target(target);
+   virgl_server_mem_stats_add(vsws, res->mem_category, res->size);
+
 out:
+   res->res_handle = handle;
+out_init:
    virgl_resource_cache_entry_init(&res->cache_entry, params);
-   res->res_handle = handle++;
    pipe_reference_init(&res->reference, 1);
    p_atomic_set(&res->num_cs_references, 0);
    return res;
@@ -330,9 +634,31 @@ static void virgl_server_resource_unmap(struct virgl_winsys *vws,
 static void virgl_server_resource_wait(struct virgl_winsys *vws,
                                        struct virgl_hw_res *res)
 {
+   U_STALL_SITE(wait_site, "virgl resource wait");
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
 
-   virgl_server_send_resource_busy_wait(vsws, res->res_handle, VCMD_BUSY_WAIT_FLAG_WAIT);
+   if (!p_atomic_read(&res->maybe_busy))
+      return;
+
+   bool transfer_pending = p_atomic_read(&res->transfer_pending);
+   bool use_fence_page = vsws->fence_page && !transfer_pending &&
+                         !p_atomic_read(&res->multi_channel);
+   bool stall = u_stall_begin(&wait_site, use_fence_page ? "fence page" :
+                                          transfer_pending ? "pending transfer" :
+                                          "server busy wait");
+   if (use_fence_page) {
+      virgl_server_seqno_wait(vsws,
+                              virgl_server_timeline_page(vsws, res->busy_channel),
+                              p_atomic_read(&res->busy_seqno),
+                              OS_TIMEOUT_INFINITE);
+   } else {
+      virgl_server_send_resource_busy_wait(vsws, res->res_handle, VCMD_BUSY_WAIT_FLAG_WAIT);
+      p_atomic_set(&res->transfer_pending, false);
+      p_atomic_set(&res->multi_channel, false);
+   }
+   u_stall_end(stall);
+
+   p_atomic_set(&res->maybe_busy, false);
 }
 
 static struct virgl_hw_res *
@@ -356,7 +682,7 @@ virgl_server_winsys_resource_cache_create(struct virgl_winsys *vws,
    struct virgl_resource_params params = { .size = size,
                                            .bind = bind,
                                            .format = format,
-                                           .flags = 0,
+                                           .flags = flags,
                                            .nr_samples = nr_samples,
                                            .width = width,
                                            .height = height,
@@ -374,6 +700,7 @@ virgl_server_winsys_resource_cache_create(struct virgl_winsys *vws,
    if (entry) {
       res = cache_entry_container_res(entry);
       mtx_unlock(&vsws->mutex);
+      virgl_server_mem_stats_move(vsws, res, mem_category_for_target(target));
       pipe_reference_init(&res->reference, 1);
       return res;
    }
@@ -384,7 +711,7 @@ alloc:
    res = virgl_server_winsys_resource_create(vws, target, map_front_private,
                                              format, bind, width, height, depth, 
 											 array_size, last_level, nr_samples, 
-											 size);
+											 flags, size);
    return res;
 }
 
@@ -448,6 +775,59 @@ static void virgl_server_add_res(struct virgl_server_winsys *vsws,
    cbuf->cres++;
 }
 
+/* The first context submits on the initial socket, so a process with a
+ * single context never sets up a channel.  Returns NULL for the initial
+ * socket, which is also the fallback when no channel is available.
+ */
+static struct virgl_server_channel *
+virgl_server_channel_acquire(struct virgl_server_winsys *vsws)
+{
+   struct virgl_server_channel *channel = NULL;
+
+   if (!vsws->use_channels)
+      return NULL;
+
+   mtx_lock(&vsws->mutex);
+
+   if (!vsws->control_in_use) {
+      vsws->control_in_use = true;
+      mtx_unlock(&vsws->mutex);
+      return NULL;
+   }
+
+   for (unsigned i = 0; i < vsws->num_channels; i++) {
+      if (!vsws->channels[i].in_use) {
+         channel = &vsws->channels[i];
+         break;
+      }
+   }
+
+   if (!channel && vsws->num_channels < VIRGL_SERVER_MAX_CHANNELS &&
+       virgl_server_channel_init(vsws, &vsws->channels[vsws->num_channels]))
+      channel = &vsws->channels[vsws->num_channels++];
+
+   if (channel)
+      channel->in_use = true;
+
+   mtx_unlock(&vsws->mutex);
+   return channel;
+}
+
+static void
+virgl_server_channel_release(struct virgl_server_winsys *vsws,
+                             struct virgl_server_channel *channel)
+{
+   if (!vsws->use_channels)
+      return;
+
+   mtx_lock(&vsws->mutex);
+   if (channel)
+      channel->in_use = false;
+   else
+      vsws->control_in_use = false;
+   mtx_unlock(&vsws->mutex);
+}
+
 static struct virgl_cmd_buf *virgl_server_cmd_buf_create(struct virgl_winsys *vws,
                                                          uint32_t size)
 {
@@ -473,6 +853,7 @@ static struct virgl_cmd_buf *virgl_server_cmd_buf_create(struct virgl_winsys *vw
 
    cbuf->ws = vws;
    cbuf->base.buf = cbuf->buf;
+   cbuf->channel = virgl_server_channel_acquire(virgl_server_winsys(vws));
    return &cbuf->base;
 }
 
@@ -480,6 +861,7 @@ static void virgl_server_cmd_buf_destroy(struct virgl_cmd_buf *_cbuf)
 {
    struct virgl_server_cmd_buf *cbuf = virgl_server_cmd_buf(_cbuf);
 
+   virgl_server_channel_release(virgl_server_winsys(cbuf->ws), cbuf->channel);
    virgl_server_release_all_res(virgl_server_winsys(cbuf->ws), cbuf);
    FREE(cbuf->res_bo);
    FREE(cbuf->buf);
@@ -487,21 +869,43 @@ static void virgl_server_cmd_buf_destroy(struct virgl_cmd_buf *_cbuf)
 }
 
 static struct pipe_fence_handle *
-virgl_server_fence_create(struct virgl_winsys *vws)
+virgl_server_fence_create(struct virgl_winsys *vws,
+                          struct virgl_server_channel *channel,
+                          uint32_t seqno, int fd)
 {
-   struct virgl_hw_res *res;
+   struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
+   struct virgl_server_fence *fence;
 
-   /* Resources for fences should not be from the cache, since we are basing
-    * the fence status on the resource creation busy status.
-    */
-   res = virgl_server_winsys_resource_create(vws,
-                                             PIPE_BUFFER,
-											 NULL,
-                                             PIPE_FORMAT_R8_UNORM,
-                                             VIRGL_BIND_CUSTOM,
-                                             8, 1, 1, 0, 0, 0, 8);
+   fence = CALLOC_STRUCT(virgl_server_fence);
+   if (!fence) {
+      if (fd >= 0)
+         close(fd);
+      return NULL;
+   }
+
+   fence->seqno = seqno;
+   fence->channel = channel;
+   fence->fd = fd;
+
+   if (!vsws->fence_page && fd < 0) {
+      /* Resources for fences should not be from the cache, since we are basing
+       * the fence status on the resource creation busy status.
+       */
+      fence->hw_res = virgl_server_winsys_resource_create(vws,
+                                                          PIPE_BUFFER,
+                                                          NULL,
+                                                          PIPE_FORMAT_R8_UNORM,
+                                                          VIRGL_BIND_CUSTOM,
+                                                          8, 1, 1, 0, 0, 0, 0, 8);
+      if (!fence->hw_res) {
+         FREE(fence);
+         return NULL;
+      }
+      p_atomic_set(&fence->hw_res->maybe_busy, true);
+   }
 
-   return (struct pipe_fence_handle *)res;
+   pipe_reference_init(&fence->reference, 1);
+   return (struct pipe_fence_handle *)fence;
 }
 
 static int virgl_server_winsys_submit_cmd(struct virgl_winsys *vws,
@@ -510,14 +914,28 @@ static int virgl_server_winsys_submit_cmd(struct virgl_winsys *vws,
 {
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
    struct virgl_server_cmd_buf *cbuf = virgl_server_cmd_buf(_cbuf);
+   uint32_t seqno;
    int ret;
 
    if (cbuf->base.cdw == 0)
       return 0;
 
-   ret = virgl_server_submit_cmd(vsws, cbuf);
+   ret = virgl_server_submit_cmd(vsws, cbuf, &seqno);
    if (fence && ret == 0)
-      *fence = virgl_server_fence_create(vws);
+      *fence = virgl_server_fence_create(vws, cbuf->channel, seqno, -1);
+
+   for (unsigned i = 0; i < cbuf->cres; i++) {
+      struct virgl_hw_res *res = cbuf->res_bo[i];
+
+      /* Submits on another timeline don't order against this one. */
+      if (vsws->use_channels && res->busy_channel != cbuf->channel &&
+          p_atomic_read(&res->maybe_busy))
+         p_atomic_set(&res->multi_channel, true);
+
+      res->busy_channel = cbuf->channel;
+      p_atomic_set(&res->busy_seqno, seqno);
+      p_atomic_set(&res->maybe_busy, true);
+   }
 
    virgl_server_release_all_res(vsws, cbuf);
    memset(cbuf->is_handle_added, 0, sizeof(cbuf->is_handle_added));
@@ -555,45 +973,155 @@ static int virgl_server_get_caps(struct virgl_winsys *vws,
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
 
    virgl_ws_fill_new_caps_defaults(caps);
-   return virgl_server_send_get_caps(vsws, caps);
+   virgl_server_send_get_caps(vsws, caps);
+
+   /* Every server resource is backed by a memfd the server keeps mapped,
+    * so TRANSFER3D commands in the command stream can be decoded against
+    * that backing directly.  Servers built on older renderers don't
+    * report the cap though, and the driver would then fall back to one
+    * VCMD_TRANSFER_PUT per queued transfer.
+    */
+   if (vsws->encoded_transfers && caps->caps.max_version >= 2)
+      caps->caps.v2.capability_bits |= VIRGL_CAP_TRANSFER;
+
+   return 0;
 }
 
 static struct pipe_fence_handle *
 virgl_cs_create_fence(struct virgl_winsys *vws, int fd)
 {
-   return virgl_server_fence_create(vws);
+   if (!vws->supports_fences)
+      return virgl_server_fence_create(vws, NULL, 0, -1);
+
+   fd = os_dupfd_cloexec(fd);
+   if (fd < 0)
+      return NULL;
+
+   return virgl_server_fence_create(vws, NULL, 0, fd);
 }
 
-static bool virgl_fence_wait(struct virgl_winsys *vws,
-                             struct pipe_fence_handle *fence,
-                             uint64_t timeout)
+static bool virgl_fence_do_wait(struct virgl_winsys *vws,
+                                struct pipe_fence_handle *_fence,
+                                uint64_t timeout)
 {
-   struct virgl_hw_res *res = virgl_hw_res(fence);
+   struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
+   struct virgl_server_fence *fence = virgl_server_fence(_fence);
+
+   if (fence->fd >= 0) {
+      uint64_t timeout_ms;
+      int timeout_poll;
+
+      if (timeout == 0)
+         return sync_wait(fence->fd, 0) == 0;
+
+      timeout_ms = timeout / 1000000;
+      /* round up */
+      if (timeout_ms * 1000000 < timeout)
+         timeout_ms++;
+
+      timeout_poll = timeout_ms <= INT_MAX ? (int) timeout_ms : -1;
+
+      return sync_wait(fence->fd, timeout_poll) == 0;
+   }
+
+   if (!fence->hw_res) {
+      struct virgl_server_fence_page *page =
+         virgl_server_timeline_page(vsws, fence->channel);
+
+      if (timeout == 0)
+         return virgl_server_seqno_signalled(page, fence->seqno);
+
+      return virgl_server_seqno_wait(vsws, page, fence->seqno, timeout);
+   }
 
    if (timeout == 0)
-      return !virgl_server_resource_is_busy(vws, res);
+      return !virgl_server_resource_is_busy(vws, fence->hw_res);
 
    if (timeout != OS_TIMEOUT_INFINITE) {
       int64_t start_time = os_time_get();
       timeout /= 1000;
-      while (virgl_server_resource_is_busy(vws, res)) {
+      while (virgl_server_resource_is_busy(vws, fence->hw_res)) {
          if (os_time_get() - start_time >= timeout)
             return false;
          os_time_sleep(10);
       }
       return true;
    }
-   virgl_server_resource_wait(vws, res);
+   virgl_server_resource_wait(vws, fence->hw_res);
    return true;
 }
 
+static bool virgl_fence_wait(struct virgl_winsys *vws,
+                             struct pipe_fence_handle *_fence,
+                             uint64_t timeout)
+{
+   U_STALL_SITE(wait_site, "virgl fence wait");
+   struct virgl_server_fence *fence = virgl_server_fence(_fence);
+   const char *origin = fence->fd >= 0 ? "sync fd" :
+                        !fence->hw_res ? "fence page" : "fence resource";
+
+   /* infinite waits on a fence resource are counted by the resource wait */
+   bool counted = fence->fd < 0 && fence->hw_res &&
+                  timeout == OS_TIMEOUT_INFINITE;
+   bool stall = timeout && !counted && u_stall_begin(&wait_site, origin);
+   bool signaled = virgl_fence_do_wait(vws, _fence, timeout);
+   u_stall_end(stall);
+   return signaled;
+}
+
 static void virgl_fence_reference(struct virgl_winsys *vws,
                                   struct pipe_fence_handle **dst,
                                   struct pipe_fence_handle *src)
+{
+   struct virgl_server_fence *dfence = virgl_server_fence(*dst);
+   struct virgl_server_fence *sfence = virgl_server_fence(src);
+
+   if (pipe_reference(&dfence->reference, &sfence->reference)) {
+      if (dfence->fd >= 0)
+         close(dfence->fd);
+      if (dfence->hw_res)
+         virgl_server_resource_reference(vws, &dfence->hw_res, NULL);
+      FREE(dfence);
+   }
+
+   *dst = src;
+}
+
+static void virgl_fence_server_sync(struct virgl_winsys *vws,
+                                    struct virgl_cmd_buf *cbuf,
+                                    struct pipe_fence_handle *_fence)
 {
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
-   virgl_server_resource_reference(&vsws->base, (struct virgl_hw_res **)dst,
-                                   virgl_hw_res(src));
+   struct virgl_server_fence *fence = virgl_server_fence(_fence);
+
+   /* Our own fences retire in submit order on the server, as long as they
+    * are on the timeline cbuf submits to.  There is no way to hand another
+    * timeline's or an external fence to the server's queue, so wait for it
+    * here.
+    */
+   if (fence->fd >= 0) {
+      sync_wait(fence->fd, -1);
+   } else if (!fence->hw_res &&
+              fence->channel != virgl_server_cmd_buf(cbuf)->channel) {
+      virgl_server_seqno_wait(vsws,
+                              virgl_server_timeline_page(vsws, fence->channel),
+                              fence->seqno, OS_TIMEOUT_INFINITE);
+   }
+}
+
+static int virgl_fence_get_fd(struct virgl_winsys *vws,
+                              struct pipe_fence_handle *_fence)
+{
+   struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
+   struct virgl_server_fence *fence = virgl_server_fence(_fence);
+
+   if (fence->fd >= 0)
+      return os_dupfd_cloexec(fence->fd);
+
+   if (!vws->supports_fences || fence->hw_res)
+      return -1;
+
+   return virgl_server_send_fence_get_fd(vsws, fence->channel, fence->seqno);
 }
 
 static void virgl_server_flush_frontbuffer(struct virgl_winsys *vws,
@@ -607,6 +1135,10 @@ static void virgl_server_flush_frontbuffer(struct virgl_winsys *vws,
    uint32_t offset = 0;
    if (!res->dt)
       return;
+
+   if (unlikely(vsws->mem_stats.dump_period) &&
+       ++vsws->mem_stats.frame % vsws->mem_stats.dump_period == 0)
+      virgl_server_mem_stats_dump(vsws);
    
    if (res->dt->no_readback) {
       if (!res->dt->drawable) {
@@ -614,6 +1146,27 @@ static void virgl_server_flush_frontbuffer(struct virgl_winsys *vws,
 		 res->dt->drawable = xlib_drawable->drawable;
 	  }
 	  
+      if (vsws->present_depth) {
+         uint32_t *seqno = &vsws->present_seqnos[vsws->present_index];
+
+         /* Throttle to present_depth frames in flight instead of waiting
+          * for every present.
+          */
+         if (*seqno) {
+            U_STALL_SITE(wait_site, "virgl present throttle");
+            bool stall = u_stall_begin(&wait_site, "present seqno");
+            virgl_server_seqno_wait(vsws, vsws->fence_page, *seqno,
+                                    OS_TIMEOUT_INFINITE);
+            u_stall_end(stall);
+         }
+
+         virgl_server_send_present_async(vsws, res->res_handle,
+                                         (uint32_t)res->dt->drawable,
+                                         sub_box, seqno);
+         vsws->present_index = (vsws->present_index + 1) % vsws->present_depth;
+         return;
+      }
+
       virgl_server_send_flush_frontbuffer(vsws, res->res_handle, (uint32_t)res->dt->drawable);
 	  virgl_server_send_resource_busy_wait(vsws, res->res_handle, VCMD_BUSY_WAIT_FLAG_WAIT);
       return;
@@ -643,8 +1196,21 @@ virgl_server_winsys_destroy(struct virgl_winsys *vws)
 {
    struct virgl_server_winsys *vsws = virgl_server_winsys(vws);
 
-   virgl_resource_cache_flush(&vsws->cache);
-
+   if (vsws->mem_stats.dump)
+      virgl_server_mem_stats_dump(vsws);
+   virgl_resource_cache_fini(&vsws->cache);
+   virgl_server_stats_dump(vsws);
+   if (vsws->use_slabs)
+      pb_slabs_deinit(&vsws->slabs);
+   virgl_server_flush_resource_destroys(vsws);
+   virgl_server_ring_fini(vsws);
+   virgl_server_channels_fini(vsws);
+   virgl_server_fence_fini(vsws);
+
+   util_idalloc_mt_fini(&vsws->handle_ids);
+   FREE(vsws->stats);
+   simple_mtx_destroy(&vsws->reply_mutex);
+   simple_mtx_destroy(&vsws->send_mutex);
    mtx_destroy(&vsws->mutex);
    FREE(vsws);
 }
@@ -669,6 +1235,37 @@ virgl_server_resource_cache_entry_release(struct virgl_resource_cache_entry *ent
    virgl_hw_res_destroy(vsws, res);
 }
 
+static const driOptionDescription virgl_server_dri_options[] = {
+   DRI_CONF_SECTION_PERFORMANCE
+      DRI_CONF_OPT_B(virgl_no_readback, true,
+                     "Present on the server without reading the front buffer back")
+   DRI_CONF_SECTION_END
+};
+
+/* The sw screens are created without a pipe_screen_config, so the winsys
+ * reads its own options.  VIRGL_NO_READBACK still overrides the profile.
+ */
+static void
+virgl_server_init_dri_options(struct virgl_server_winsys *vsws)
+{
+   driOptionCache info, options;
+
+   driParseOptionInfo(&info, virgl_server_dri_options,
+                      ARRAY_SIZE(virgl_server_dri_options));
+   driParseConfigFiles(&options, &info, 0, "virpipe", NULL, NULL, NULL, 0,
+                       NULL, 0);
+
+   /* Parsed as before: anything but "true" or "1" turns readback on. */
+   const char *no_readback = getenv("VIRGL_NO_READBACK");
+   if (no_readback)
+      vsws->no_readback = !strcmp(no_readback, "true") || !strcmp(no_readback, "1");
+   else
+      vsws->no_readback = driQueryOptionb(&options, "virgl_no_readback");
+
+   driDestroyOptionCache(&options);
+   driDestroyOptionInfo(&info);
+}
+
 struct virgl_winsys *
 virgl_server_winsys_wrap(struct sw_winsys *sws)
 {
@@ -679,9 +1276,25 @@ virgl_server_winsys_wrap(struct sw_winsys *sws)
    if (!vsws)
       return NULL;
 
+   simple_mtx_init(&vsws->send_mutex, mtx_plain);
+   simple_mtx_init(&vsws->reply_mutex, mtx_plain);
+   util_idalloc_mt_init(&vsws->handle_ids, 512, true);
    virgl_server_connect(vsws);
    vsws->sws = sws;
 
+   vsws->encoded_transfers =
+      debug_get_bool_option("VIRGL_SERVER_ENCODED_TRANSFERS", false);
+   virgl_server_init_dri_options(vsws);
+
+   vsws->use_slabs = debug_get_bool_option("VIRGL_SERVER_SLABS", false) &&
+                     pb_slabs_init(&vsws->slabs,
+                                   VIRGL_SERVER_SLAB_MIN_ORDER,
+                                   VIRGL_SERVER_SLAB_MAX_ORDER,
+                                   1, false, vsws,
+                                   virgl_server_slab_can_reclaim,
+                                   virgl_server_slab_alloc,
+                                   virgl_server_slab_free);
+
    virgl_resource_cache_init(&vsws->cache, CACHE_TIMEOUT_USEC,
                              virgl_server_resource_cache_entry_is_busy,
                              virgl_server_resource_cache_entry_release,
@@ -709,8 +1322,11 @@ virgl_server_winsys_wrap(struct sw_winsys *sws)
    vsws->base.cs_create_fence = virgl_cs_create_fence;
    vsws->base.fence_wait = virgl_fence_wait;
    vsws->base.fence_reference = virgl_fence_reference;
-   vsws->base.supports_fences = 0;
+   vsws->base.fence_server_sync = virgl_fence_server_sync;
+   vsws->base.fence_get_fd = virgl_fence_get_fd;
+   vsws->base.supports_fences = vsws->fence_page != NULL;
    vsws->base.supports_encoded_transfers = 1;
+   vsws->base.supports_coherent = vsws->coherent;
 
    vsws->base.flush_frontbuffer = virgl_server_flush_frontbuffer;
 
@@ -29,6 +29,11 @@
 #include "pipe/p_state.h"
 #include "util/list.h"
 #include "util/u_thread.h"
+#include "util/simple_mtx.h"
+#include "util/u_idalloc.h"
+#include "util/u_atomic.h"
+#include "util/os_time.h"
+#include "pipebuffer/pb_slab.h"
 
 #include "virgl/virgl_winsys.h"
 #include "virgl_server_protocol.h"
@@ -38,13 +43,143 @@ struct pipe_fence_handle;
 struct sw_winsys;
 struct sw_displaytarget;
 
+#define VIRGL_SERVER_MAX_PRESENT_DEPTH 3
+#define VIRGL_SERVER_NUM_VCMDS (VCMD_CHANNEL_CREATE + 1)
+
+/* Protocol statistics, collected when VIRGL_SERVER_STATS is set and
+ * printed when the winsys is destroyed.
+ */
+struct virgl_server_stats {
+   uint64_t cmds[VIRGL_SERVER_NUM_VCMDS];
+   uint64_t bytes[VIRGL_SERVER_NUM_VCMDS];
+   /* Time spent waiting for replies, for commands that have one. */
+   uint64_t wait_ns[VIRGL_SERVER_NUM_VCMDS];
+   uint64_t max_wait_ns[VIRGL_SERVER_NUM_VCMDS];
+
+   uint64_t socket_writes;
+   uint64_t ring_submits;
+   uint64_t ring_doorbells;
+   uint64_t ring_full_waits;
+   uint64_t fence_waits;
+   uint64_t fence_wait_ns;
+};
+
+enum virgl_server_mem_category {
+   VIRGL_SERVER_MEM_BUFFER,
+   VIRGL_SERVER_MEM_TEXTURE,
+   VIRGL_SERVER_MEM_SLAB,  /* suballocation arenas */
+   VIRGL_SERVER_MEM_CACHE, /* idle resources held by the resource cache */
+   VIRGL_SERVER_MEM_RING,  /* command ring and fence page */
+   VIRGL_SERVER_MEM_COUNT,
+};
+
+/* Shared memory mapped with the server, always counted.
+ * VIRGL_SERVER_MEM_STATS=<n> prints it every <n> frontbuffer flushes (never
+ * if 0) and when the winsys is destroyed.
+ */
+struct virgl_server_mem_stats {
+   uint64_t size[VIRGL_SERVER_MEM_COUNT];
+   uint32_t count[VIRGL_SERVER_MEM_COUNT];
+
+   bool dump;
+   unsigned dump_period;
+   unsigned frame;
+};
+#define VIRGL_SERVER_SEND_QUEUE_DWORDS 1024
+
+#define VIRGL_SERVER_MAX_CHANNELS 8
+
+/* The submission channel of a context other than the first one, see
+ * VCMD_CHANNEL_CREATE.  Channels live as long as the winsys so fences and
+ * resources can keep pointing at them; the channel of a destroyed context
+ * goes to the next one created.
+ */
+struct virgl_server_channel {
+   int sock_fd;
+   struct virgl_server_fence_page *fence_page;
+   uint32_t submit_seqno;
+   bool in_use;
+
+   /* Pairs each request on the channel with its reply. */
+   simple_mtx_t mutex;
+};
+
 struct virgl_server_winsys {
    struct virgl_winsys base;
    struct sw_winsys *sws;
    int sock_fd;
 
+   struct virgl_server_ring *ring;
+   uint32_t ring_map_size;
+   int ring_eventfd;
+
+   struct virgl_server_fence_page *fence_page;
+   uint32_t submit_seqno;
+
+   /* Serializes everything that goes out on the socket or the ring. */
+   simple_mtx_t send_mutex;
+
+   /* Pairs each request on the initial socket with its reply.  Taken before
+    * send_mutex, and held from the write until the reply has been read.
+    */
+   simple_mtx_t reply_mutex;
+
+   /* Small commands that need no reply are gathered here and go out in one
+    * writev, together with the next command that has to reach the server.
+    */
+   unsigned send_queue_dw;
+   uint32_t send_queue[VIRGL_SERVER_SEND_QUEUE_DWORDS];
+
+   struct virgl_server_stats *stats;
+   struct virgl_server_mem_stats mem_stats;
+
+   /* Destroys are queued up and sent ahead of the next submit as a single
+    * VCMD_RESOURCE_DESTROY_BATCH, the first two dwords are its header.
+    */
+   bool batch_destroys;
+   unsigned num_pending_destroys;
+   uint32_t destroy_buf[2 + VCMD_DESTROY_BATCH_MAX_HANDLES];
+
+   /* Contexts beyond the first one submit on channels of their own, so a
+    * loading thread's submits and waits don't queue up behind the render
+    * thread's.  Protected by mutex.
+    */
+   bool use_channels;
+   bool control_in_use;
+   unsigned num_channels;
+   struct virgl_server_channel channels[VIRGL_SERVER_MAX_CHANNELS];
+
+   /* Sequence numbers of the asynchronous presents in flight, at most
+    * present_depth of them.  present_depth is 0 when presents block.
+    */
+   unsigned present_depth;
+   unsigned present_index;
+   uint32_t present_seqnos[VIRGL_SERVER_MAX_PRESENT_DEPTH];
+
    struct virgl_resource_cache cache;
    mtx_t mutex;
+
+   /* Advertise VIRGL_CAP_TRANSFER even when the server doesn't. */
+   bool encoded_transfers;
+
+   /* Display targets are presented by the server instead of being read
+    * back and put to the drawable, from driconf or VIRGL_NO_READBACK.
+    */
+   bool no_readback;
+
+   /* The server takes VCMD_RESOURCE_CREATE_COHERENT, persistent and
+    * coherent buffers are then mapped straight from their memfd.
+    */
+   bool coherent;
+
+   bool use_slabs;
+   struct pb_slabs slabs;
+   uint32_t next_arena_id;
+
+   /* Resource handles are recycled once their destroy went out, which keeps
+    * them dense for the per-cbuf reloc hash and the server's tables.
+    */
+   struct util_idalloc_mt handle_ids;
 };
 
 struct virgl_hw_res {
@@ -52,6 +187,22 @@ struct virgl_hw_res {
    uint32_t res_handle;
    int num_cs_references;
 
+   /* Cleared once the server reported the resource idle; while it is clear
+    * busy queries and waits need no round trip.
+    */
+   int maybe_busy;
+   /* Set while a socket transfer has been issued but not waited for. */
+   int transfer_pending;
+   /* Sequence number of the last submit that referenced the resource, on
+    * the timeline of busy_channel (NULL for the initial socket).
+    */
+   uint32_t busy_seqno;
+   struct virgl_server_channel *busy_channel;
+   /* Set when submits on different timelines may still be using the
+    * resource; only the server can tell when it is idle then.
+    */
+   int multi_channel;
+
    void *ptr;
    int size;
 
@@ -65,6 +216,31 @@ struct virgl_hw_res {
 
    uint32_t bind;
    struct virgl_resource_cache_entry cache_entry;
+
+   uint8_t mem_category; /* enum virgl_server_mem_category */
+
+   /* Set for resources sub-allocated from a struct virgl_server_slab. */
+   bool is_slab_entry;
+   struct pb_slab_entry slab_entry;
+};
+
+struct virgl_server_slab {
+   struct pb_slab base;
+   uint32_t arena_id;
+   uint32_t size;
+   void *map;
+   struct virgl_hw_res *entries;
+};
+
+struct virgl_server_fence {
+   struct pipe_reference reference;
+   uint32_t seqno;
+   /* timeline of seqno, NULL for the initial socket */
+   struct virgl_server_channel *channel;
+   int fd;
+
+   /* Only used when the server does not support sequence number fences. */
+   struct virgl_hw_res *hw_res;
 };
 
 struct virgl_server_cmd_buf {
@@ -75,14 +251,17 @@ struct virgl_server_cmd_buf {
    struct virgl_winsys *ws;
    struct virgl_hw_res **res_bo;
 
+   /* NULL when submitting on the initial socket */
+   struct virgl_server_channel *channel;
+
    char is_handle_added[512];
    unsigned reloc_indices_hashlist[512];
 };
 
-static inline struct virgl_hw_res *
-virgl_hw_res(struct pipe_fence_handle *f)
+static inline struct virgl_server_fence *
+virgl_server_fence(struct pipe_fence_handle *f)
 {
-   return (struct virgl_hw_res *)f;
+   return (struct virgl_server_fence *)f;
 }
 
 static inline struct virgl_server_winsys *
@@ -98,6 +277,47 @@ virgl_server_cmd_buf(struct virgl_cmd_buf *cbuf)
 }
 
 int virgl_server_connect(struct virgl_server_winsys *vws);
+void virgl_server_ring_fini(struct virgl_server_winsys *vws);
+void virgl_server_fence_fini(struct virgl_server_winsys *vws);
+bool virgl_server_channel_init(struct virgl_server_winsys *vws,
+                               struct virgl_server_channel *channel);
+void virgl_server_channels_fini(struct virgl_server_winsys *vws);
+void virgl_server_stats_dump(struct virgl_server_winsys *vws);
+void virgl_server_mem_stats_dump(struct virgl_server_winsys *vws);
+
+static inline void
+virgl_server_mem_stats_add(struct virgl_server_winsys *vws,
+                           enum virgl_server_mem_category category,
+                           uint64_t size)
+{
+   p_atomic_add(&vws->mem_stats.size[category], size);
+   p_atomic_inc(&vws->mem_stats.count[category]);
+}
+
+static inline void
+virgl_server_mem_stats_del(struct virgl_server_winsys *vws,
+                           enum virgl_server_mem_category category,
+                           uint64_t size)
+{
+   p_atomic_add(&vws->mem_stats.size[category], -size);
+   p_atomic_dec(&vws->mem_stats.count[category]);
+}
+
+static inline void
+virgl_server_stats_wait(struct virgl_server_winsys *vws, unsigned cmd,
+                        int64_t start)
+{
+   if (!vws->stats)
+      return;
+
+   uint64_t ns = os_time_get_nano() - start;
+   p_atomic_add(&vws->stats->wait_ns[cmd], ns);
+   if (ns > vws->stats->max_wait_ns[cmd])
+      vws->stats->max_wait_ns[cmd] = ns;
+}
+int virgl_server_send_fence_get_fd(struct virgl_server_winsys *vws,
+                                   struct virgl_server_channel *channel,
+                                   uint32_t seqno);
 int virgl_server_send_get_caps(struct virgl_server_winsys *vws,
                                struct virgl_drm_caps *caps);
 							  
@@ -113,10 +333,33 @@ int virgl_server_send_resource_create(struct virgl_server_winsys *vws,
                                       uint32_t last_level,
                                       uint32_t nr_samples,
                                       uint32_t size,
+                                      bool coherent,
                                       int *out_fd);
 
+int virgl_server_send_resource_create_arena(struct virgl_server_winsys *vws,
+                                            uint32_t handle,
+                                            enum pipe_texture_target target,
+                                            uint32_t format,
+                                            uint32_t bind,
+                                            uint32_t width,
+                                            uint32_t height,
+                                            uint32_t depth,
+                                            uint32_t array_size,
+                                            uint32_t last_level,
+                                            uint32_t nr_samples,
+                                            uint32_t size,
+                                            uint32_t arena_id,
+                                            uint32_t offset);
+
+int virgl_server_send_arena_create(struct virgl_server_winsys *vws,
+                                   uint32_t arena_id, uint32_t size, int fd);
+
+int virgl_server_send_arena_destroy(struct virgl_server_winsys *vws,
+                                    uint32_t arena_id);
+
 int virgl_server_send_resource_destroy(struct virgl_server_winsys *vws,
                                        uint32_t handle);
+void virgl_server_flush_resource_destroys(struct virgl_server_winsys *vws);
 
 int virgl_server_send_transfer_get(struct virgl_server_winsys *vws,
                                    uint32_t handle,
@@ -135,7 +378,8 @@ int virgl_server_send_transfer_put(struct virgl_server_winsys *vws,
                                    uint32_t offset);
 
 int virgl_server_submit_cmd(struct virgl_server_winsys *vws,
-                            struct virgl_server_cmd_buf *cbuf);
+                            struct virgl_server_cmd_buf *cbuf,
+                            uint32_t *seqno);
 
 int virgl_server_send_resource_busy_wait(struct virgl_server_winsys *vws, int handle,
                                          int flags);
@@ -143,4 +387,10 @@ int virgl_server_send_resource_busy_wait(struct virgl_server_winsys *vws, int ha
 int virgl_server_send_flush_frontbuffer(struct virgl_server_winsys *vws,
 									    uint32_t handle,
 									    uint32_t drawable);
+
+int virgl_server_send_present_async(struct virgl_server_winsys *vws,
+                                    uint32_t handle,
+                                    uint32_t drawable,
+                                    const struct pipe_box *damage,
+                                    uint32_t *seqno);
 #endif
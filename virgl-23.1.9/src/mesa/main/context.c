@@ -131,6 +131,7 @@
 #include "shaderimage.h"
 #include "texcompress_s3tc.h"
 #include "texstate.h"
+#include "texstore.h"
 #include "transformfeedback.h"
 #include "mtypes.h"
 #include "varray.h"
@@ -1153,6 +1154,7 @@ _mesa_free_context_data(struct gl_context *ctx, bool destroy_debug_output)
    _mesa_free_eval_data( ctx );
    _mesa_free_feedback(ctx);
    _mesa_free_texture_data( ctx );
+   _mesa_texstore_destroy_queue(ctx);
    _mesa_free_image_textures(ctx);
    _mesa_free_matrix_data( ctx );
    _mesa_free_pipeline_data(ctx);
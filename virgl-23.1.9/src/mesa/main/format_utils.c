@@ -825,6 +825,101 @@ swizzle_convert_try_memcpy(void *dst,
    return true;
 }
 
+/**
+ * Attempts to perform the given swizzle-and-convert operation with one of
+ * the specialized 8-bit RGBA loops
+ *
+ * Uploads of GL_BGRA / GL_RGB ubyte data into RGBA8-style textures are
+ * common enough that going through the generic per-channel loop shows up
+ * in texture-load times.  These loops work on whole pixels and are simple
+ * enough for the compiler to vectorize.
+ *
+ * The arguments are exactly the same as for _mesa_swizzle_and_convert
+ *
+ * \return  true if it successfully performed the swizzle-and-convert
+ *          operation, false otherwise
+ */
+static bool
+swizzle_convert_try_ubyte_rgba(void *void_dst, int num_dst_channels,
+                               const void *void_src, int num_src_channels,
+                               const uint8_t swizzle[4], bool normalized,
+                               int count)
+{
+   const uint8_t *src = void_src;
+   uint8_t *dst = void_dst;
+   bool force_alpha;
+   int i;
+
+   if (num_dst_channels != 4)
+      return false;
+
+   if (swizzle[3] == MESA_FORMAT_SWIZZLE_ONE && normalized)
+      force_alpha = true;
+   else if (swizzle[3] == 3 && num_src_channels == 4)
+      force_alpha = false;
+   else
+      return false;
+
+   if (num_src_channels == 4) {
+      /* RGBA <-> BGRA, optionally replacing alpha. */
+      if (swizzle[0] != 2 || swizzle[1] != 1 || swizzle[2] != 0)
+         return false;
+
+#if UTIL_ARCH_LITTLE_ENDIAN
+      if ((uintptr_t) src % 4 == 0 && (uintptr_t) dst % 4 == 0) {
+         const uint32_t *s = (const uint32_t *) src;
+         uint32_t *d = (uint32_t *) dst;
+         const uint32_t a = force_alpha ? 0xff000000 : 0;
+
+         for (i = 0; i < count; i++) {
+            d[i] = ((s[i] & 0xff00ff00) |
+                    ((s[i] &       0xff) << 16) |
+                    ((s[i] &   0xff0000) >> 16)) | a;
+         }
+         return true;
+      }
+#endif
+
+      for (i = 0; i < count; i++) {
+         dst[0] = src[2];
+         dst[1] = src[1];
+         dst[2] = src[0];
+         dst[3] = force_alpha ? 0xff : src[3];
+         src += 4;
+         dst += 4;
+      }
+      return true;
+   } else if (num_src_channels == 3) {
+      /* RGB -> RGBX and BGR -> RGBX. */
+      if (swizzle[1] != 1)
+         return false;
+
+      if (swizzle[0] == 0 && swizzle[2] == 2) {
+         for (i = 0; i < count; i++) {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+            dst[3] = 0xff;
+            src += 3;
+            dst += 4;
+         }
+         return true;
+      } else if (swizzle[0] == 2 && swizzle[2] == 0) {
+         for (i = 0; i < count; i++) {
+            dst[0] = src[2];
+            dst[1] = src[1];
+            dst[2] = src[0];
+            dst[3] = 0xff;
+            src += 3;
+            dst += 4;
+         }
+         return true;
+      }
+   }
+
+   return false;
+}
+
 /**
  * Represents a single instance of the standard swizzle-and-convert loop
  *
@@ -1544,6 +1639,13 @@ _mesa_swizzle_and_convert(void *void_dst, enum mesa_array_format_datatype dst_ty
                                   swizzle, normalized, count))
       return;
 
+   if (src_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       dst_type == MESA_ARRAY_FORMAT_TYPE_UBYTE &&
+       swizzle_convert_try_ubyte_rgba(void_dst, num_dst_channels,
+                                      void_src, num_src_channels,
+                                      swizzle, normalized, count))
+      return;
+
    switch (dst_type) {
    case MESA_ARRAY_FORMAT_TYPE_FLOAT:
       convert_float(void_dst, num_dst_channels, void_src, src_type,
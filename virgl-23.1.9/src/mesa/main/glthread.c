@@ -352,6 +352,7 @@ _mesa_glthread_flush_batch(struct gl_context *ctx)
 
    glthread->LastCallList = NULL;
    glthread->LastBindBuffer = NULL;
+   glthread->LastBufferSubData = NULL;
 }
 
 /**
@@ -391,6 +392,7 @@ _mesa_glthread_finish(struct gl_context *ctx)
 
       glthread->LastCallList = NULL;
       glthread->LastBindBuffer = NULL;
+      glthread->LastBufferSubData = NULL;
 
       /* Since glthread_unmarshal_batch changes the dispatch to direct,
        * restore it after it's done.
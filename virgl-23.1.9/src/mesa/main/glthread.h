@@ -273,6 +273,7 @@ struct glthread_state
    /** The last added call of the given function. */
    struct marshal_cmd_CallList *LastCallList;
    struct marshal_cmd_BindBuffer *LastBindBuffer;
+   struct marshal_cmd_BufferSubData *LastBufferSubData;
 
    /** Global mutex update info. */
    unsigned GlobalLockUpdateBatchCounter;
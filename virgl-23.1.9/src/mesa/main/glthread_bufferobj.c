@@ -539,6 +539,30 @@ _mesa_marshal_BufferSubData_merged(GLuint target_or_name, GLintptr offset,
       return;
    }
 
+   struct glthread_state *glthread = &ctx->GLThread;
+   struct marshal_cmd_BufferSubData *last = glthread->LastBufferSubData;
+
+   /* If the last call is BufferSubData and this one continues where it ended,
+    * append the data to it, so that the driver gets one larger upload instead
+    * of many small ones. Nothing can have changed the binding meanwhile.
+    */
+   if (_mesa_glthread_call_is_last(glthread, &last->cmd_base) &&
+       last->target_or_name == target_or_name &&
+       last->named == named && last->ext_dsa == ext_dsa &&
+       last->offset + last->size == offset) {
+      size_t merged_size = sizeof(*last) + last->size + size;
+      unsigned added = align(merged_size, 8) / 8 - last->cmd_base.cmd_size;
+
+      if (merged_size <= MARSHAL_MAX_CMD_SIZE && last->size + size <= INT_MAX &&
+          glthread->used + added <= MARSHAL_MAX_CMD_SIZE / 8) {
+         memcpy((char *)(last + 1) + last->size, data, size);
+         last->size += size;
+         last->cmd_base.cmd_size += added;
+         glthread->used += added;
+         return;
+      }
+   }
+
    struct marshal_cmd_BufferSubData *cmd =
       _mesa_glthread_allocate_command(ctx, DISPATCH_CMD_BufferSubData,
                                       cmd_size);
@@ -550,6 +574,8 @@ _mesa_marshal_BufferSubData_merged(GLuint target_or_name, GLintptr offset,
 
    char *variable_data = (char *) (cmd + 1);
    memcpy(variable_data, data, size);
+
+   glthread->LastBufferSubData = cmd;
 }
 
 void GLAPIENTRY
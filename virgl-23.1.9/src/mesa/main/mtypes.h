@@ -3307,6 +3307,9 @@ struct gl_context
 
    struct glthread_state GLThread;
 
+   /** Worker threads splitting up large texstore conversions */
+   struct util_queue TexStoreQueue;
+
    struct gl_config Visual;
    struct gl_framebuffer *DrawBuffer;	/**< buffer for writing */
    struct gl_framebuffer *ReadBuffer;	/**< buffer for reading */
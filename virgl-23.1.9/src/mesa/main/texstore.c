@@ -76,6 +76,8 @@
 #include "pixeltransfer.h"
 #include "util/format_rgb9e5.h"
 #include "util/format_r11g11b10f.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
 
 #include "state_tracker/st_cb_texture.h"
 
@@ -676,6 +678,115 @@ texstore_compressed(TEXSTORE_PARAMS)
                            srcFormat, srcType, srcAddr, srcPacking);
 }
 
+/**
+ * Images with at least this many texels per slice have their conversion
+ * split into bands of rows that run in parallel on ctx->TexStoreQueue.
+ */
+#define TEXSTORE_THREADED_MIN_TEXELS (512 * 512)
+#define TEXSTORE_MIN_ROWS_PER_BAND 32
+#define TEXSTORE_MAX_THREADS 3
+
+struct texstore_convert_job {
+   struct util_queue_fence fence;
+   void *dst;
+   uint32_t dst_format;
+   size_t dst_stride;
+   const void *src;
+   uint32_t src_format;
+   size_t src_stride;
+   size_t width, height;
+   const uint8_t *rebase_swizzle;
+};
+
+static void
+texstore_convert_job_execute(void *data, UNUSED void *gdata,
+                             UNUSED int thread_index)
+{
+   struct texstore_convert_job *job = data;
+
+   _mesa_format_convert(job->dst, job->dst_format, job->dst_stride,
+                        job->src, job->src_format, job->src_stride,
+                        job->width, job->height, job->rebase_swizzle);
+}
+
+static bool
+texstore_init_queue(struct gl_context *ctx)
+{
+   if (util_queue_is_initialized(&ctx->TexStoreQueue))
+      return true;
+
+   int num_threads = MIN2(util_get_cpu_caps()->nr_cpus - 1,
+                          TEXSTORE_MAX_THREADS);
+   if (num_threads <= 0)
+      return false;
+
+   return util_queue_init(&ctx->TexStoreQueue, "texstore", 8, num_threads,
+                          UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+}
+
+void
+_mesa_texstore_destroy_queue(struct gl_context *ctx)
+{
+   if (util_queue_is_initialized(&ctx->TexStoreQueue))
+      util_queue_destroy(&ctx->TexStoreQueue);
+}
+
+/**
+ * _mesa_format_convert() for one slice.  Large slices are split into bands
+ * of rows; all but the last band go to the worker threads, and the calling
+ * thread converts the last one before waiting for the others.
+ */
+static void
+texstore_convert_slice(struct gl_context *ctx,
+                       void *dst, uint32_t dstFormat, size_t dstRowStride,
+                       const void *src, uint32_t srcFormat, size_t srcRowStride,
+                       size_t width, size_t height,
+                       const uint8_t *rebaseSwizzle)
+{
+   struct texstore_convert_job jobs[TEXSTORE_MAX_THREADS];
+   unsigned num_bands = 1;
+
+   if (width * height >= TEXSTORE_THREADED_MIN_TEXELS &&
+       texstore_init_queue(ctx)) {
+      num_bands = MIN2(ctx->TexStoreQueue.num_threads + 1,
+                       height / TEXSTORE_MIN_ROWS_PER_BAND);
+      num_bands = CLAMP(num_bands, 1, TEXSTORE_MAX_THREADS + 1);
+   }
+
+   size_t rows_per_band = DIV_ROUND_UP(height, num_bands);
+   size_t row = 0;
+   unsigned i;
+
+   for (i = 0; i < num_bands - 1; i++) {
+      struct texstore_convert_job *job = &jobs[i];
+
+      job->dst = (uint8_t *)dst + row * dstRowStride;
+      job->dst_format = dstFormat;
+      job->dst_stride = dstRowStride;
+      job->src = (const uint8_t *)src + row * srcRowStride;
+      job->src_format = srcFormat;
+      job->src_stride = srcRowStride;
+      job->width = width;
+      job->height = rows_per_band;
+      job->rebase_swizzle = rebaseSwizzle;
+
+      util_queue_fence_init(&job->fence);
+      util_queue_add_job(&ctx->TexStoreQueue, job, &job->fence,
+                         texstore_convert_job_execute, NULL, 0);
+      row += rows_per_band;
+   }
+
+   _mesa_format_convert((uint8_t *)dst + row * dstRowStride, dstFormat,
+                        dstRowStride,
+                        (const uint8_t *)src + row * srcRowStride, srcFormat,
+                        srcRowStride, width, height - row, rebaseSwizzle);
+
+   for (i = 0; i < num_bands - 1; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
+
 static GLboolean
 texstore_rgba(TEXSTORE_PARAMS)
 {
@@ -816,10 +927,10 @@ texstore_rgba(TEXSTORE_PARAMS)
    }
 
    for (img = 0; img < srcDepth; img++) {
-      _mesa_format_convert(dstSlices[img], dstFormat, dstRowStride,
-                           src, srcMesaFormat, srcRowStride,
-                           srcWidth, srcHeight,
-                           needRebase ? rebaseSwizzle : NULL);
+      texstore_convert_slice(ctx, dstSlices[img], dstFormat, dstRowStride,
+                             src, srcMesaFormat, srcRowStride,
+                             srcWidth, srcHeight,
+                             needRebase ? rebaseSwizzle : NULL);
       src += srcHeight * srcRowStride;
    }
 
@@ -104,6 +104,43 @@ update_gl_clamp(struct st_context *st, struct gl_program *prog, uint32_t *gl_cla
    }
 }
 
+/**
+ * Initialize the part of a fragment program variant key that only depends
+ * on the GL state, not on the program or the bound textures.
+ */
+void
+st_init_fp_variant_key(struct st_context *st, struct st_fp_variant_key *key)
+{
+   /* use memset, not an initializer to be sure all memory is zeroed */
+   memset(key, 0, sizeof(*key));
+
+   key->st = st->has_shareable_shaders ? NULL : st;
+
+   key->lower_flatshade = st->lower_flatshade &&
+                          st->ctx->Light.ShadeModel == GL_FLAT;
+
+   /* _NEW_COLOR */
+   key->lower_alpha_func = COMPARE_FUNC_ALWAYS;
+   if (st->lower_alpha_test && _mesa_is_alpha_test_enabled(st->ctx))
+      key->lower_alpha_func = st->ctx->Color.AlphaFunc;
+
+   /* _NEW_LIGHT_STATE | _NEW_PROGRAM */
+   key->lower_two_sided_color = st->lower_two_sided_color &&
+      _mesa_vertex_program_two_side_enabled(st->ctx);
+
+   /* gl_driver_flags::NewFragClamp */
+   key->clamp_color = st->clamp_frag_color_in_shader &&
+                      st->ctx->Color._ClampFragmentColor;
+
+   /* _NEW_MULTISAMPLE | _NEW_BUFFERS */
+   key->persample_shading =
+      st->force_persample_in_shader &&
+      _mesa_is_multisample_enabled(st->ctx) &&
+      st->ctx->Multisample.SampleShading &&
+      st->ctx->Multisample.MinSampleShadingValue *
+      _mesa_geometric_samples(st->ctx->DrawBuffer) > 1;
+}
+
 /**
  * Update fragment program state/atom.  This involves translating the
  * Mesa fragment program into a gallium fragment program and binding it.
@@ -126,34 +163,7 @@ st_update_fp( struct st_context *st )
    } else {
       struct st_fp_variant_key key;
 
-      /* use memset, not an initializer to be sure all memory is zeroed */
-      memset(&key, 0, sizeof(key));
-
-      key.st = st->has_shareable_shaders ? NULL : st;
-
-      key.lower_flatshade = st->lower_flatshade &&
-                            st->ctx->Light.ShadeModel == GL_FLAT;
-
-      /* _NEW_COLOR */
-      key.lower_alpha_func = COMPARE_FUNC_ALWAYS;
-      if (st->lower_alpha_test && _mesa_is_alpha_test_enabled(st->ctx))
-         key.lower_alpha_func = st->ctx->Color.AlphaFunc;
-
-      /* _NEW_LIGHT_STATE | _NEW_PROGRAM */
-      key.lower_two_sided_color = st->lower_two_sided_color &&
-         _mesa_vertex_program_two_side_enabled(st->ctx);
-
-      /* gl_driver_flags::NewFragClamp */
-      key.clamp_color = st->clamp_frag_color_in_shader &&
-                        st->ctx->Color._ClampFragmentColor;
-
-      /* _NEW_MULTISAMPLE | _NEW_BUFFERS */
-      key.persample_shading =
-         st->force_persample_in_shader &&
-         _mesa_is_multisample_enabled(st->ctx) &&
-         st->ctx->Multisample.SampleShading &&
-         st->ctx->Multisample.MinSampleShadingValue *
-         _mesa_geometric_samples(st->ctx->DrawBuffer) > 1;
+      st_init_fp_variant_key(st, &key);
 
       if (fp->ati_fs) {
          key.fog = st->ctx->Fog._PackedEnabledMode;
@@ -1363,6 +1363,26 @@ st_finalize_program(struct st_context *st, struct gl_program *prog)
 
    /* Always create the default variant of the program. */
    st_precompile_shader_variant(st, prog);
+
+   /* Apps usually link their programs with the state they are going to draw
+    * with already set, so compiling the variant for it now moves the compile
+    * from the first draw to link time.  Variants that depend on the bound
+    * textures are still left to the first draw, as the textures may not be
+    * validated yet.
+    */
+   if (st->options.precompile_state_variants &&
+       prog->info.stage == MESA_SHADER_FRAGMENT &&
+       !st->shader_has_one_variant[MESA_SHADER_FRAGMENT] &&
+       !prog->ati_fs && !prog->ExternalSamplersUsed && ctx->DrawBuffer) {
+      struct st_fp_variant_key key;
+
+      st_init_fp_variant_key(st, &key);
+
+      /* The default variant is already there. */
+      simple_mtx_lock(&ctx->Shared->Mutex);
+      st_get_fp_variant(st, prog, &key);
+      simple_mtx_unlock(&ctx->Shared->Mutex);
+   }
 }
 
 /**
@@ -289,6 +289,9 @@ extern void
 st_set_prog_affected_state_flags(struct gl_program *prog);
 
 
+extern void
+st_init_fp_variant_key(struct st_context *st, struct st_fp_variant_key *key);
+
 extern struct st_fp_variant *
 st_get_fp_variant(struct st_context *st,
                   struct gl_program *stfp,
@@ -93,6 +93,14 @@ disk_cache_init_queue(struct disk_cache *cache)
                           UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY, NULL);
 }
 
+static void
+cache_db_trim(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache *cache = job;
+
+   mesa_cache_db_multipart_trim(&cache->cache_db);
+}
+
 static struct disk_cache *
 disk_cache_type_create(const char *gpu_name,
                        const char *driver_id,
@@ -123,6 +131,10 @@ disk_cache_type_create(const char *gpu_name,
    cache->path_init_failed = true;
    cache->type = DISK_CACHE_NONE;
 
+   cache->compression_min_size =
+      debug_get_num_option("MESA_SHADER_CACHE_COMPRESSION_MIN_SIZE",
+                           DISK_CACHE_DEFAULT_COMPRESSION_MIN_SIZE);
+
 #ifdef ANDROID
    /* Android needs the "disk cache" to be enabled for
     * EGL_ANDROID_blob_cache's callbacks to be called, but it doesn't actually
@@ -219,6 +231,14 @@ disk_cache_type_create(const char *gpu_name,
    if (!disk_cache_init_queue(cache))
       goto fail;
 
+   /* Bring a DB that outgrew the current size limit back within it, off
+    * the calling thread.  disk_cache_destroy() waits for the queue, so the
+    * job can't outlive the cache.
+    */
+   if (cache->type == DISK_CACHE_DATABASE)
+      util_queue_add_job(&cache->cache_queue, cache, NULL, cache_db_trim,
+                         NULL, 0);
+
    cache->path_init_failed = false;
 
  path_fail:
@@ -464,6 +484,9 @@ done:
    }
 }
 
+/* As for cache_entry_file_data, the data is stored uncompressed when its
+ * size equals uncompressed_size.
+ */
 struct blob_cache_entry {
    uint32_t uncompressed_size;
    uint8_t compressed_data[];
@@ -482,12 +505,18 @@ blob_put_compressed(struct disk_cache *cache, const cache_key key,
 
    entry->uncompressed_size = size;
 
-   MESA_TRACE_BEGIN("deflate");
-   size_t compressed_size =
-         util_compress_deflate(data, size, entry->compressed_data, max_buf);
-   MESA_TRACE_END();
-   if (!compressed_size)
-      goto out;
+   size_t compressed_size = 0;
+   if (size >= cache->compression_min_size) {
+      MESA_TRACE_BEGIN("deflate");
+      compressed_size =
+            util_compress_deflate(data, size, entry->compressed_data, max_buf);
+      MESA_TRACE_END();
+   }
+
+   if (!compressed_size || compressed_size >= size) {
+      memcpy(entry->compressed_data, data, size);
+      compressed_size = size;
+   }
 
    unsigned entry_size = compressed_size + sizeof(*entry);
    MESA_TRACE_BEGIN("blob_put");
@@ -529,10 +558,15 @@ blob_get_compressed(struct disk_cache *cache, const cache_key key,
    }
 
    unsigned compressed_size = entry_size - sizeof(*entry);
-   MESA_TRACE_BEGIN("inflate");
-   bool ret = util_compress_inflate(entry->compressed_data, compressed_size,
-                                    data, entry->uncompressed_size);
-   MESA_TRACE_END();
+   bool ret = true;
+   if (compressed_size == entry->uncompressed_size) {
+      memcpy(data, entry->compressed_data, compressed_size);
+   } else {
+      MESA_TRACE_BEGIN("inflate");
+      ret = util_compress_inflate(entry->compressed_data, compressed_size,
+                                  data, entry->uncompressed_size);
+      MESA_TRACE_END();
+   }
    if (!ret) {
       free(data);
       free(entry);
@@ -406,21 +406,6 @@ make_cache_file_directory(struct disk_cache *cache, const cache_key key)
    free(dir);
 }
 
-static ssize_t
-read_all(int fd, void *buf, size_t count)
-{
-   char *in = buf;
-   ssize_t read_ret;
-   size_t done;
-
-   for (done = 0; done < count; done += read_ret) {
-      read_ret = read(fd, in + done, count - done);
-      if (read_ret == -1 || read_ret == 0)
-         return -1;
-   }
-   return done;
-}
-
 static ssize_t
 write_all(int fd, const void *buf, size_t count)
 {
@@ -562,11 +547,10 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
    if (!uncompressed_data)
       goto fail;
 
-   if (cache->compression_disabled) {
-      if (cf_data->uncompressed_size != cache_data_size)
-         goto fail;
-
+   if (cf_data->uncompressed_size == cache_data_size) {
       memcpy(uncompressed_data, data, cache_data_size);
+   } else if (cache->compression_disabled) {
+      goto fail;
    } else {
       if (!util_compress_inflate(data, cache_data_size, uncompressed_data,
                                  cf_data->uncompressed_size))
@@ -598,21 +582,21 @@ disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
    if (fstat(fd, &sb) == -1)
       goto fail;
 
-   data = malloc(sb.st_size);
-   if (data == NULL)
-      goto fail;
-
-   /* Read entire file into memory */
-   int ret = read_all(fd, data, sb.st_size);
-   if (ret == -1)
+   /* Map the file rather than reading it, the item is only looked at once
+    * to check it and decompress or copy it out.
+    */
+   data = mmap(NULL, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   if (data == MAP_FAILED) {
+      data = NULL;
       goto fail;
+   }
 
     uint8_t *uncompressed_data =
        parse_and_validate_cache_item(cache, data, sb.st_size, size);
    if (!uncompressed_data)
       goto fail;
 
-   free(data);
+   munmap(data, sb.st_size);
    free(filename);
    close(fd);
 
@@ -620,7 +604,7 @@ disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
 
  fail:
    if (data)
-      free(data);
+      munmap(data, sb.st_size);
    if (filename)
       free(filename);
    if (fd != -1)
@@ -657,21 +641,28 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
 
    /* Compress the cache item data */
    size_t max_buf = util_compress_max_compressed_len(dc_job->size);
-   size_t compressed_size;
-   void *compressed_data;
+   size_t compressed_size = 0;
+   void *compressed_data = NULL;
+   bool compressed = false;
 
-   if (dc_job->cache->compression_disabled) {
-      compressed_size = dc_job->size;
-      compressed_data = dc_job->data;
-   } else {
+   if (!dc_job->cache->compression_disabled &&
+       dc_job->size >= dc_job->cache->compression_min_size) {
       compressed_data = malloc(max_buf);
       if (compressed_data == NULL)
          return false;
       compressed_size =
          util_compress_deflate(dc_job->data, dc_job->size,
                               compressed_data, max_buf);
-      if (compressed_size == 0)
-         goto fail;
+      compressed = compressed_size != 0 && compressed_size < dc_job->size;
+   }
+
+   /* Store the data as is if compression didn't help, see
+    * cache_entry_file_data.
+    */
+   if (!compressed) {
+      free(compressed_data);
+      compressed_size = dc_job->size;
+      compressed_data = dc_job->data;
    }
 
    /* Copy the driver_keys_blob, this can be used find information about the
@@ -714,13 +705,13 @@ create_cache_item_header_and_blob(struct disk_cache_put_job *dc_job,
    if (!blob_write_bytes(cache_blob, compressed_data, compressed_size))
       goto fail;
 
-   if (!dc_job->cache->compression_disabled)
+   if (compressed)
       free(compressed_data);
 
    return true;
 
  fail:
-   if (!dc_job->cache->compression_disabled)
+   if (compressed)
       free(compressed_data);
 
    return false;
@@ -96,6 +96,11 @@ struct disk_cache {
    /* Don't compress cached data. This is for testing purposes only. */
    bool compression_disabled;
 
+   /* Entries smaller than this are stored uncompressed, decompressing them
+    * costs more at load time than the disk space they save.
+    */
+   uint32_t compression_min_size;
+
    struct {
       bool enabled;
       unsigned hits;
@@ -106,11 +111,16 @@ struct disk_cache {
    struct disk_cache *foz_ro_cache;
 };
 
+/* The data following this is stored uncompressed when its size equals
+ * uncompressed_size, compressed data is always strictly smaller.
+ */
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
 };
 
+#define DISK_CACHE_DEFAULT_COMPRESSION_MIN_SIZE 4096
+
 struct disk_cache_put_job {
    struct util_queue_fence fence;
 
@@ -446,6 +446,10 @@
    DRI_CONF_OPT_B(force_integer_tex_nearest, def, \
                   "Force integer textures to use nearest filtering")
 
+#define DRI_CONF_PRECOMPILE_STATE_VARIANTS(def) \
+   DRI_CONF_OPT_B(precompile_state_variants, def, \
+                  "Also compile the shader variants for the current GL state when programs are linked")
+
 /**
  * \brief Initialization configuration options
  */
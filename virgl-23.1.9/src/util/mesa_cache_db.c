@@ -900,6 +900,91 @@ fail:
    return false;
 }
 
+int
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   struct mesa_cache_db_file_entry cache_entry;
+   void *blob = NULL;
+   int num_entries = 0;
+
+   if (!mesa_db_lock(db))
+      return -1;
+
+   if (!db->alive || !mesa_db_reload(db))
+      goto fail;
+
+   hash_table_foreach(db->index_db->table, entry) {
+      struct mesa_index_db_hash_entry *hash_entry = entry->data;
+
+      if (!mesa_db_seek(db->cache.file, hash_entry->cache_db_file_offset) ||
+          !mesa_db_read(db->cache.file, &cache_entry) ||
+          !mesa_db_cache_entry_valid(&cache_entry))
+         goto fail;
+
+      blob = malloc(cache_entry.size);
+      if (!blob)
+         goto fail;
+
+      if (!mesa_db_read_data(db->cache.file, blob, cache_entry.size))
+         goto fail;
+
+      /* Skip damaged entries, readers would reject them too. */
+      if (util_hash_crc32(blob, cache_entry.size) == cache_entry.crc) {
+         cb(cache_entry.key, blob, cache_entry.size, data);
+         num_entries++;
+      }
+
+      free(blob);
+      blob = NULL;
+   }
+
+   mesa_db_unlock(db);
+
+   return num_entries;
+
+fail:
+   free(blob);
+   mesa_db_unlock(db);
+
+   return -1;
+}
+
+bool
+mesa_cache_db_trim(struct mesa_cache_db *db)
+{
+   int64_t excess_size;
+
+   if (!mesa_db_lock(db))
+      return false;
+
+   if (!db->alive)
+      goto fail;
+
+   if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
+      goto fail_fatal;
+
+   if (!mesa_db_seek_end(db->cache.file))
+      goto fail_fatal;
+
+   excess_size = ftell(db->cache.file) - sizeof(struct mesa_db_file_header) -
+                 db->max_cache_size;
+
+   if (excess_size > 0 && !mesa_db_compact(db, excess_size, NULL))
+      goto fail_fatal;
+
+   mesa_db_unlock(db);
+
+   return true;
+
+fail_fatal:
+   mesa_db_zap(db);
+fail:
+   mesa_db_unlock(db);
+
+   return false;
+}
+
 bool
 mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size)
 {
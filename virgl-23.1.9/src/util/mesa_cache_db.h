@@ -11,6 +11,7 @@
 #define MESA_CACHE_DB_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -28,6 +29,10 @@ struct mesa_cache_db_file {
    uint64_t uuid;
 };
 
+typedef void (*mesa_cache_db_entry_cb)(const uint8_t *cache_key_160bit,
+                                       const void *blob, size_t blob_size,
+                                       void *data);
+
 struct mesa_cache_db {
    struct hash_table_u64 *index_db;
    struct mesa_cache_db_file cache;
@@ -70,6 +75,20 @@ mesa_cache_db_entry_remove(struct mesa_cache_db *db,
 bool
 mesa_db_wipe_path(const char *cache_path);
 
+/* Call cb for each intact entry of the DB, with the DB locked.  Returns the
+ * number of entries visited, or -1 on error.
+ */
+int
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data);
+
+/* Evict the least recently used entries and compact the files if the DB
+ * doesn't fit in its size limit, e.g. because the limit has been lowered
+ * since the DB was written.
+ */
+bool
+mesa_cache_db_trim(struct mesa_cache_db *db);
+
 bool
 mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size);
 
@@ -128,6 +147,19 @@ mesa_db_wipe_path(const char *cache_path)
    return false;
 }
 
+static inline int
+mesa_cache_db_foreach_entry(struct mesa_cache_db *db,
+                            mesa_cache_db_entry_cb cb, void *data)
+{
+   return -1;
+}
+
+static inline bool
+mesa_cache_db_trim(struct mesa_cache_db *db)
+{
+   return false;
+}
+
 static inline bool
 mesa_cache_db_has_space(struct mesa_cache_db *db, size_t blob_size)
 {
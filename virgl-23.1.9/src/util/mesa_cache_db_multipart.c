@@ -81,6 +81,29 @@ mesa_cache_db_multipart_set_size_limit(struct mesa_cache_db_multipart *db,
                                    max_cache_size / db->num_parts);
 }
 
+int
+mesa_cache_db_multipart_foreach_entry(struct mesa_cache_db_multipart *db,
+                                      mesa_cache_db_entry_cb cb, void *data)
+{
+   int num_entries = 0;
+
+   for (unsigned int i = 0; i < db->num_parts; i++) {
+      int n = mesa_cache_db_foreach_entry(&db->parts[i], cb, data);
+      if (n < 0)
+         return -1;
+      num_entries += n;
+   }
+
+   return num_entries;
+}
+
+void
+mesa_cache_db_multipart_trim(struct mesa_cache_db_multipart *db)
+{
+   for (unsigned int i = 0; i < db->num_parts; i++)
+      mesa_cache_db_trim(&db->parts[i]);
+}
+
 void *
 mesa_cache_db_multipart_read_entry(struct mesa_cache_db_multipart *db,
                                    const uint8_t *cache_key_160bit,
@@ -27,6 +27,13 @@ void
 mesa_cache_db_multipart_set_size_limit(struct mesa_cache_db_multipart *db,
                                        uint64_t max_cache_size);
 
+int
+mesa_cache_db_multipart_foreach_entry(struct mesa_cache_db_multipart *db,
+                                      mesa_cache_db_entry_cb cb, void *data);
+
+void
+mesa_cache_db_multipart_trim(struct mesa_cache_db_multipart *db);
+
 void *
 mesa_cache_db_multipart_read_entry(struct mesa_cache_db_multipart *db,
                                    const uint8_t *cache_key_160bit,
@@ -106,4 +106,17 @@ _mesa_trace_scope_end(int *scope)
 #define MESA_TRACE_FUNC_SLOW()                                               \
    _MESA_TRACE_SCOPE(UTIL_PERFETTO_CATEGORY_SLOW, __func__)
 
+/* Drivers that emit markers call this when they are created, because the
+ * API frontends do not all initialize perfetto.  Every marker, whichever
+ * driver or winsys emits it, is timestamped with perfetto's boot time clock,
+ * which the GPU render stage data sources also sync their clocks to.  A
+ * system-wide capture therefore lines up the markers of a whole stack, such
+ * as GL on zink on turnip, with each other and with the GPU.
+ */
+static inline void
+util_cpu_trace_init(void)
+{
+   util_perfetto_init();
+}
+
 #endif /* CPU_TRACE_H */
@@ -0,0 +1,53 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef U_STALL_H
+#define U_STALL_H
+
+#include <stdbool.h>
+
+#include "util/perf/cpu_trace.h"
+
+/* Marks the places where the CPU blocks on the GPU in the CPU trace.
+ *
+ * Every blocking wait a driver wants to see gets a static site:
+ *
+ *    U_STALL_SITE(wait_site, "zink batch usage wait");
+ *
+ *    bool stall = u_stall_begin(&wait_site, "unflushed batch");
+ *    ... wait ...
+ *    u_stall_end(stall);
+ *
+ * The wait shows up as a slice named after the site, with a nested slice
+ * named after the origin: what the wait was for, e.g. work that had not
+ * been submitted yet or which queue the fence came from.  Counts, durations
+ * and per-frame totals come from the trace itself.
+ */
+
+struct u_stall_site {
+   const char *name;
+};
+
+#define U_STALL_SITE(var, site_name)                                         \
+   static const struct u_stall_site var = { site_name }
+
+static inline bool
+u_stall_begin(const struct u_stall_site *site, const char *origin)
+{
+   _MESA_TRACE_BEGIN(site->name);
+   _MESA_TRACE_BEGIN(origin);
+   return true;
+}
+
+static inline void
+u_stall_end(bool stall)
+{
+   if (stall) {
+      _MESA_TRACE_END();
+      _MESA_TRACE_END();
+   }
+}
+
+#endif /* U_STALL_H */
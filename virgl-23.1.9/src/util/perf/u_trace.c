@@ -24,6 +24,7 @@
 #include "u_trace.h"
 
 #include <inttypes.h>
+#include <string.h>
 
 #include "util/list.h"
 #include "util/u_call_once.h"
@@ -249,6 +250,122 @@ static struct u_trace_printer json_printer = {
    .event = &print_json_event,
 };
 
+/* The summary printer pairs start_<x>/end_<x> tracepoints and only writes
+ * the total time and count of each <x> once per frame, which keeps the
+ * output small enough to leave enabled for long sessions.
+ */
+#define SUMMARY_MAX_DEPTH 8
+#define SUMMARY_MAX_NAMES 32
+
+struct u_trace_summary {
+   struct {
+      const char *name;
+      uint64_t start_ns;
+   } stack[SUMMARY_MAX_DEPTH];
+   unsigned depth;
+
+   struct {
+      const char *name;
+      uint64_t total_ns;
+      uint32_t count;
+   } totals[SUMMARY_MAX_NAMES];
+   unsigned num_totals;
+
+   uint64_t frame_ns;
+};
+
+static void
+print_summary_start(struct u_trace_context *utctx)
+{
+}
+
+static void
+print_summary_end_of_frame(struct u_trace_context *utctx)
+{
+   struct u_trace_summary *summary = utctx->summary;
+
+   fprintf(utctx->out, "{\"frame\": %u, \"duration_ns\": %" PRIu64 ", \"events\": {",
+           utctx->frame_nr, summary->frame_ns);
+   for (unsigned i = 0; i < summary->num_totals; i++) {
+      fprintf(utctx->out, "%s\"%s\": {\"count\": %u, \"ns\": %" PRIu64 "}",
+              i ? ", " : "", summary->totals[i].name,
+              summary->totals[i].count, summary->totals[i].total_ns);
+      summary->totals[i].total_ns = 0;
+      summary->totals[i].count = 0;
+   }
+   fprintf(utctx->out, "}}\n");
+   fflush(utctx->out);
+
+   summary->frame_ns = 0;
+}
+
+static void
+print_summary_end_of_batch(struct u_trace_context *utctx)
+{
+   utctx->summary->frame_ns += utctx->last_time_ns - utctx->first_time_ns;
+   utctx->summary->depth = 0;
+}
+
+static void
+summary_add(struct u_trace_summary *summary, const char *name, uint64_t ns)
+{
+   unsigned i;
+   for (i = 0; i < summary->num_totals; i++) {
+      if (!strcmp(summary->totals[i].name, name))
+         break;
+   }
+
+   if (i == summary->num_totals) {
+      if (i == SUMMARY_MAX_NAMES)
+         return;
+      summary->totals[i].name = name;
+      summary->num_totals++;
+   }
+
+   summary->totals[i].total_ns += ns;
+   summary->totals[i].count++;
+}
+
+static void
+print_summary_event(struct u_trace_context *utctx,
+                    struct u_trace_chunk *chunk,
+                    const struct u_trace_event *evt,
+                    uint64_t ns,
+                    int32_t delta)
+{
+   struct u_trace_summary *summary = utctx->summary;
+   const char *name = evt->tp->name;
+
+   if (!strncmp(name, "start_", 6)) {
+      if (summary->depth < SUMMARY_MAX_DEPTH) {
+         summary->stack[summary->depth].name = name + 6;
+         summary->stack[summary->depth].start_ns = ns;
+      }
+      summary->depth++;
+   } else if (!strncmp(name, "end_", 4)) {
+      /* Unwind to the matching start, dropping any unmatched ones. */
+      while (summary->depth > 0) {
+         summary->depth--;
+         if (summary->depth < SUMMARY_MAX_DEPTH &&
+             !strcmp(summary->stack[summary->depth].name, name + 4)) {
+            summary_add(summary, name + 4,
+                        ns - summary->stack[summary->depth].start_ns);
+            break;
+         }
+      }
+   }
+}
+
+static struct u_trace_printer summary_printer = {
+   .start = &print_summary_start,
+   .end = &print_summary_start,
+   .start_of_frame = &print_summary_start,
+   .end_of_frame = &print_summary_end_of_frame,
+   .start_of_batch = &print_summary_start,
+   .end_of_batch = &print_summary_end_of_batch,
+   .event = &print_summary_event,
+};
+
 static struct u_trace_payload_buf *
 u_trace_payload_buf_create(void)
 {
@@ -363,6 +480,8 @@ get_chunk(struct u_trace *ut, size_t payload_size)
 static const struct debug_named_value config_control[] = {
    { "print", U_TRACE_TYPE_PRINT, "Enable print" },
    { "print_json", U_TRACE_TYPE_PRINT_JSON, "Enable print in JSON" },
+   { "print_summary", U_TRACE_TYPE_PRINT_SUMMARY,
+     "Enable print of per-frame totals in JSON" },
 #ifdef HAVE_PERFETTO
    { "perfetto", U_TRACE_TYPE_PERFETTO_ENV, "Enable perfetto" },
 #endif
@@ -458,10 +577,16 @@ u_trace_context_init(struct u_trace_context *utctx,
 
    list_inithead(&utctx->flushed_trace_chunks);
 
+   utctx->summary = NULL;
    if (utctx->enabled_traces & U_TRACE_TYPE_PRINT) {
       utctx->out = u_trace_state.trace_file;
 
-      if (utctx->enabled_traces & U_TRACE_TYPE_JSON) {
+      if (utctx->enabled_traces & U_TRACE_TYPE_SUMMARY) {
+         utctx->summary = calloc(1, sizeof(*utctx->summary));
+         utctx->out_printer = &summary_printer;
+         if (!utctx->summary)
+            utctx->out = NULL;
+      } else if (utctx->enabled_traces & U_TRACE_TYPE_JSON) {
          utctx->out_printer = &json_printer;
       } else {
          utctx->out_printer = &txt_printer;
@@ -507,11 +632,13 @@ u_trace_context_fini(struct u_trace_context *utctx)
       fflush(utctx->out);
    }
 
-   if (!utctx->queue.jobs)
-      return;
-   util_queue_finish(&utctx->queue);
-   util_queue_destroy(&utctx->queue);
-   free_chunks(&utctx->flushed_trace_chunks);
+   if (utctx->queue.jobs) {
+      util_queue_finish(&utctx->queue);
+      util_queue_destroy(&utctx->queue);
+      free_chunks(&utctx->flushed_trace_chunks);
+   }
+
+   free(utctx->summary);
 }
 
 #ifdef HAVE_PERFETTO
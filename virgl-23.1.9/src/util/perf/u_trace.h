@@ -142,8 +142,10 @@ enum u_trace_type {
    U_TRACE_TYPE_PERFETTO_ACTIVE = 1u << 2,
    U_TRACE_TYPE_PERFETTO_ENV = 1u << 3,
    U_TRACE_TYPE_MARKERS = 1u << 4,
+   U_TRACE_TYPE_SUMMARY = 1u << 5,
 
    U_TRACE_TYPE_PRINT_JSON = U_TRACE_TYPE_PRINT | U_TRACE_TYPE_JSON,
+   U_TRACE_TYPE_PRINT_SUMMARY = U_TRACE_TYPE_PRINT | U_TRACE_TYPE_SUMMARY,
    U_TRACE_TYPE_PERFETTO =
       U_TRACE_TYPE_PERFETTO_ACTIVE | U_TRACE_TYPE_PERFETTO_ENV,
 
@@ -177,6 +179,9 @@ struct u_trace_context {
    FILE *out;
    struct u_trace_printer *out_printer;
 
+   /* Per-frame totals accumulated by the summary printer. */
+   struct u_trace_summary *summary;
+
    /* Once u_trace_flush() is called u_trace_chunk's are queued up to
     * render tracepoints on a queue.  The per-chunk queue jobs block until
     * timestamps are available.
@@ -28,6 +28,11 @@
 #include <stdbool.h>
 #include <string.h>
 
+/* Number of elements of other pools that slab_free collects before handing
+ * them back to their owners.
+ */
+#define SLAB_FOREIGN_BATCH 32
+
 #define SLAB_MAGIC_ALLOCATED 0xcafe4321
 #define SLAB_MAGIC_FREE 0x7ee01234
 
@@ -129,6 +134,35 @@ void slab_create_child(struct slab_child_pool *pool,
    pool->pages = NULL;
    pool->free = NULL;
    pool->migrated = NULL;
+   pool->foreign = NULL;
+   pool->num_foreign = 0;
+}
+
+/* Return the elements collected in pool->foreign to their owners. The parent
+ * mutex must be held.
+ */
+static void
+slab_return_foreign_locked(struct slab_child_pool *pool)
+{
+   while (pool->foreign) {
+      struct slab_element_header *elt = pool->foreign;
+      pool->foreign = elt->next;
+
+      /* Note: we _must_ read elt->owner here, under the mutex, because the
+       * owning child pool may have been destroyed by another thread since
+       * the element was freed.
+       */
+      intptr_t owner_int = p_atomic_read(&elt->owner);
+
+      if (!(owner_int & 1)) {
+         struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
+         elt->next = owner->migrated;
+         owner->migrated = elt;
+      } else {
+         slab_free_orphaned(elt);
+      }
+   }
+   pool->num_foreign = 0;
 }
 
 /**
@@ -144,6 +178,8 @@ void slab_destroy_child(struct slab_child_pool *pool)
 
    simple_mtx_lock(&pool->parent->mutex);
 
+   slab_return_foreign_locked(pool);
+
    while (pool->pages) {
       struct slab_page_header *page = pool->pages;
       pool->pages = page->u.next;
@@ -213,6 +249,8 @@ slab_alloc(struct slab_child_pool *pool)
        * different child pool.
        */
       simple_mtx_lock(&pool->parent->mutex);
+      if (pool->num_foreign)
+         slab_return_foreign_locked(pool);
       pool->free = pool->migrated;
       pool->migrated = NULL;
       simple_mtx_unlock(&pool->parent->mutex);
@@ -269,25 +307,28 @@ void slab_free(struct slab_child_pool *pool, void *ptr)
       return;
    }
 
-   /* The slow case: migration or an orphaned page. */
-   if (pool->parent)
-      simple_mtx_lock(&pool->parent->mutex);
-
-   /* Note: we _must_ re-read elt->owner here because the owning child pool
-    * may have been destroyed by another thread in the meantime.
+   /* Migration or an orphaned page.  Batch the element up and hand the
+    * batch back to the owners once it's full.
     */
+   if (pool->parent) {
+      elt->next = pool->foreign;
+      pool->foreign = elt;
+      if (++pool->num_foreign >= SLAB_FOREIGN_BATCH) {
+         simple_mtx_lock(&pool->parent->mutex);
+         slab_return_foreign_locked(pool);
+         simple_mtx_unlock(&pool->parent->mutex);
+      }
+      return;
+   }
+
+   /* The freeing pool has been destroyed, so there is no mutex to take. */
    owner_int = p_atomic_read(&elt->owner);
 
    if (!(owner_int & 1)) {
       struct slab_child_pool *owner = (struct slab_child_pool *)owner_int;
       elt->next = owner->migrated;
       owner->migrated = elt;
-      if (pool->parent)
-         simple_mtx_unlock(&pool->parent->mutex);
    } else {
-      if (pool->parent)
-         simple_mtx_unlock(&pool->parent->mutex);
-
       slab_free_orphaned(elt);
    }
 }
@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2024 Mesa contributors
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Export the entries of a MESA_DISK_CACHE_DATABASE shader cache into a
+ * Fossilize DB, so that a cache warmed up on one machine can be shipped
+ * as a read-only cache:
+ *
+ *    disk_cache_export ~/.cache/mesa_shader_cache_db /tmp/out
+ *
+ * writes /tmp/out/foz_cache.foz and /tmp/out/foz_cache_idx.foz.  Copy
+ * both to the target's cache directory under some name, say game.foz and
+ * game_idx.foz, and point MESA_DISK_CACHE_READ_ONLY_FOZ_DBS=game at them.
+ *
+ * Cache keys are hashed together with the driver and GPU identity, so the
+ * cache only hits on the same driver build and device it was recorded on.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util/fossilize_db.h"
+#include "util/mesa_cache_db_multipart.h"
+
+struct export_state {
+   struct foz_db foz_db;
+   unsigned num_failed;
+};
+
+static void
+export_entry(const uint8_t *cache_key_160bit, const void *blob,
+             size_t blob_size, void *data)
+{
+   struct export_state *state = data;
+
+   if (!foz_write_entry(&state->foz_db, cache_key_160bit, blob, blob_size))
+      state->num_failed++;
+}
+
+int
+main(int argc, char **argv)
+{
+   struct mesa_cache_db_multipart cache_db;
+   struct export_state state = {0};
+   int num_entries;
+
+   if (argc != 3) {
+      fprintf(stderr, "usage: %s <cache database dir> <output dir>\n",
+              argv[0]);
+      return EXIT_FAILURE;
+   }
+
+   if (!mesa_cache_db_multipart_open(&cache_db, argv[1])) {
+      fprintf(stderr, "failed to open cache database at %s\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+
+   /* foz_prepare() only opens a writable DB in single-file mode. */
+   setenv("MESA_DISK_CACHE_SINGLE_FILE", "true", 1);
+   unsetenv("MESA_DISK_CACHE_READ_ONLY_FOZ_DBS");
+
+   if (!foz_prepare(&state.foz_db, argv[2])) {
+      fprintf(stderr, "failed to create fossilize DB in %s\n", argv[2]);
+      mesa_cache_db_multipart_close(&cache_db);
+      return EXIT_FAILURE;
+   }
+
+   num_entries = mesa_cache_db_multipart_foreach_entry(&cache_db,
+                                                       export_entry, &state);
+
+   foz_destroy(&state.foz_db);
+   mesa_cache_db_multipart_close(&cache_db);
+
+   if (num_entries < 0) {
+      fprintf(stderr, "failed to read cache database at %s\n", argv[1]);
+      return EXIT_FAILURE;
+   }
+
+   printf("exported %u of %d entries\n", num_entries - state.num_failed,
+          num_entries);
+
+   return state.num_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -595,6 +595,59 @@ get_cpu_topology(void)
 #endif
 }
 
+static void
+get_cpu_clusters(void)
+{
+#if DETECT_OS_LINUX
+   unsigned max_freq[UTIL_MAX_CPUS] = {0};
+   unsigned lowest = ~0u, highest = 0;
+
+   for (int16_t i = 0; i < util_cpu_caps.max_cpus && i < UTIL_MAX_CPUS; i++) {
+      char path[64];
+      FILE *f;
+
+      snprintf(path, sizeof(path),
+               "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", i);
+      f = fopen(path, "r");
+      if (!f)
+         continue;
+      if (fscanf(f, "%u", &max_freq[i]) != 1)
+         max_freq[i] = 0;
+      fclose(f);
+
+      if (!max_freq[i])
+         continue;
+      lowest = MIN2(lowest, max_freq[i]);
+      highest = MAX2(highest, max_freq[i]);
+   }
+
+   if (!highest || lowest == highest)
+      return;
+
+   for (int16_t i = 0; i < util_cpu_caps.max_cpus && i < UTIL_MAX_CPUS; i++) {
+      uint32_t cpu_bit = 1u << (i % 32);
+
+      if (!max_freq[i])
+         continue;
+      if (max_freq[i] == lowest)
+         util_cpu_caps.little_cpu_mask[i / 32] |= cpu_bit;
+      else
+         util_cpu_caps.big_cpu_mask[i / 32] |= cpu_bit;
+   }
+   util_cpu_caps.has_big_little = true;
+
+   if (debug_get_option_dump_cpu()) {
+      fprintf(stderr, "CPU big/little masks:\n  - big = ");
+      for (int j = util_cpu_caps.max_cpus - 1; j >= 0; j -= 32)
+         fprintf(stderr, "%08x ", util_cpu_caps.big_cpu_mask[j / 32]);
+      fprintf(stderr, "\n  - little = ");
+      for (int j = util_cpu_caps.max_cpus - 1; j >= 0; j -= 32)
+         fprintf(stderr, "%08x ", util_cpu_caps.little_cpu_mask[j / 32]);
+      fprintf(stderr, "\n");
+   }
+#endif
+}
+
 static
 void check_cpu_caps_override(void)
 {
@@ -920,6 +973,7 @@ _util_cpu_detect_once(void)
    check_max_vector_bits();
 
    get_cpu_topology();
+   get_cpu_clusters();
 
    if (debug_get_option_dump_cpu()) {
       printf("util_cpu_caps.nr_cpus = %u\n", util_cpu_caps.nr_cpus);
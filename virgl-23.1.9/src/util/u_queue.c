@@ -106,6 +106,26 @@ remove_from_atexit_list(struct util_queue *queue)
    mtx_unlock(&exit_mutex);
 }
 
+/****************************************************************************
+ * Process-wide thread budget for UTIL_QUEUE_INIT_SCALE_THREADS queues
+ *
+ * Every such queue may grow up to its own max_threads, which is usually
+ * sized to the number of CPUs.  When several of them are busy at once they
+ * oversubscribe the CPUs and starve the single-threaded queues (submission,
+ * glthread) that everything else waits on.  Keep the total number of
+ * threads of scalable queues within the CPU count instead; every queue
+ * still keeps the threads it was created with.
+ */
+
+static int32_t scaled_queue_threads;
+
+static bool
+util_queue_can_scale_up(void)
+{
+   return p_atomic_read(&scaled_queue_threads) <
+          util_get_cpu_caps()->nr_cpus;
+}
+
 /****************************************************************************
  * util_queue_fence
  */
@@ -266,6 +286,17 @@ util_queue_thread_func(void *input)
                                        util_get_cpu_caps()->num_cpu_mask_bits);
    }
 
+   if (util_get_cpu_caps()->has_big_little &&
+       (queue->flags & (UTIL_QUEUE_INIT_PREFER_BIG_CORES |
+                        UTIL_QUEUE_INIT_PREFER_LITTLE_CORES))) {
+      const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+      util_set_current_thread_affinity(
+         queue->flags & UTIL_QUEUE_INIT_PREFER_BIG_CORES ?
+            caps->big_cpu_mask : caps->little_cpu_mask,
+         NULL, caps->num_cpu_mask_bits);
+   }
+
 #if defined(__linux__)
    if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
       /* The nice() function can only set a maximum of 19. */
@@ -345,6 +376,9 @@ util_queue_create_thread(struct util_queue *queue, unsigned index)
       return false;
    }
 
+   if (queue->flags & UTIL_QUEUE_INIT_SCALE_THREADS)
+      p_atomic_inc(&scaled_queue_threads);
+
    if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
 #if defined(__linux__) && defined(SCHED_BATCH)
       struct sched_param sched_param = {0};
@@ -515,6 +549,9 @@ util_queue_kill_threads(struct util_queue *queue, unsigned keep_num_threads,
    queue->num_threads = keep_num_threads;
    cnd_broadcast(&queue->has_queued_cond);
 
+   if (queue->flags & UTIL_QUEUE_INIT_SCALE_THREADS)
+      p_atomic_add(&scaled_queue_threads, -(int)(old_num_threads - keep_num_threads));
+
    /* Wait for threads to terminate. */
    if (keep_num_threads < old_num_threads) {
       /* We need to unlock the mutex to allow threads to terminate. */
@@ -584,7 +621,8 @@ util_queue_add_job_locked(struct util_queue *queue,
    if (queue->num_queued > 0 &&
        queue->flags & UTIL_QUEUE_INIT_SCALE_THREADS &&
        execute != util_queue_finish_execute &&
-       queue->num_threads < queue->max_threads) {
+       queue->num_threads < queue->max_threads &&
+       util_queue_can_scale_up()) {
       util_queue_adjust_num_threads(queue, queue->num_threads + 1, true);
    }
 
@@ -51,6 +51,12 @@ extern "C" {
 #define UTIL_QUEUE_INIT_RESIZE_IF_FULL            (1 << 1)
 #define UTIL_QUEUE_INIT_SET_FULL_THREAD_AFFINITY  (1 << 2)
 #define UTIL_QUEUE_INIT_SCALE_THREADS             (1 << 3)
+/* On big.LITTLE systems, keep the threads on the faster cores for
+ * latency-critical work, or on the slower cores for background work.
+ * Ignored when all cores are the same.
+ */
+#define UTIL_QUEUE_INIT_PREFER_BIG_CORES          (1 << 4)
+#define UTIL_QUEUE_INIT_PREFER_LITTLE_CORES       (1 << 5)
 
 #if UTIL_FUTEX_SUPPORTED
 #define UTIL_QUEUE_FENCE_FUTEX
@@ -129,6 +129,8 @@ enum virgl_context_cmd {
    VIRGL_CCMD_ENCODE_BITSTREAM,
    VIRGL_CCMD_END_FRAME,
 
+   VIRGL_CCMD_INVALIDATE_RESOURCE,
+
    VIRGL_MAX_COMMANDS
 };
 
@@ -266,6 +268,10 @@ enum virgl_shader_stage {
 #define VIRGL_OBJ_SHADER_HDR_SIZE(nso) (5 + ((nso) ? (2 * nso) + 4 : 0))
 #define VIRGL_OBJ_SHADER_HANDLE 1
 #define VIRGL_OBJ_SHADER_TYPE 2
+/* with VIRGL_CAP_V2_TGSI_BINARY: the payload is NUM_TOKENS struct
+ * tgsi_token dwords instead of NUL terminated TGSI text
+ */
+#define VIRGL_OBJ_SHADER_TYPE_BINARY (0x1u << 31)
 #define VIRGL_OBJ_SHADER_OFFSET 3
 #define VIRGL_OBJ_SHADER_OFFSET_VAL(x) (((x) & 0x7fffffff) << 0)
 /* start contains full length in VAL - also implies continuations */
@@ -763,4 +769,11 @@ enum vrend_tweak_type {
 #define VIRGL_END_FRAME_CDC_HANDLE          1
 #define VIRGL_END_FRAME_TGT_HANDLE          2
 
+/* VIRGL_CCMD_INVALIDATE_RESOURCE
+ * The contents of the resource become undefined, so the host may skip
+ * loading or storing them, e.g. with DONT_CARE attachment ops.
+ */
+#define VIRGL_INVALIDATE_RESOURCE_SIZE      1
+#define VIRGL_INVALIDATE_RESOURCE_HANDLE    1
+
 #endif
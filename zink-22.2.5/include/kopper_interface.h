@@ -56,7 +56,7 @@ typedef struct __DRIkopperLoaderExtensionRec    __DRIkopperLoaderExtension;
  * relying on a particular window system or DRI protocol.
  */
 #define __DRI_KOPPER "DRI_Kopper"
-#define __DRI_KOPPER_VERSION 1
+#define __DRI_KOPPER_VERSION 2
 
 struct kopper_surface;
 
@@ -76,6 +76,11 @@ struct __DRIkopperExtensionRec {
     int64_t (*swapBuffers)(__DRIdrawable *draw);
     void (*setSwapInterval)(__DRIdrawable *drawable, int interval);
     int (*queryBufferAge)(__DRIdrawable *drawable);
+
+    /* Version 2: like swapBuffers, with nrects x/y/width/height damage
+     * rectangles relative to the bottom-left corner of the drawable
+     */
+    int64_t (*swapBuffersWithDamage)(__DRIdrawable *draw, int nrects, const int *rects);
 };
 
 /**
@@ -1243,6 +1243,21 @@ dri2_kopper_query_buffer_age(_EGLDisplay *disp, _EGLSurface *surf)
    return 0;
 }
 
+static EGLBoolean
+dri2_kopper_swap_buffers_with_damage(_EGLDisplay *disp, _EGLSurface *surf,
+                                     const EGLint *rects, EGLint n_rects)
+{
+   struct dri2_egl_display *dri2_dpy = dri2_egl_display(disp);
+   struct dri2_egl_surface *dri2_surf = dri2_egl_surface(surf);
+
+   if (!dri2_dpy->kopper || dri2_dpy->kopper->base.version < 2 ||
+       !dri2_dpy->kopper->swapBuffersWithDamage)
+      return dri2_x11_swap_buffers(disp, surf);
+
+   dri2_dpy->kopper->swapBuffersWithDamage(dri2_surf->dri_drawable, n_rects, rects);
+   return EGL_TRUE;
+}
+
 static const struct dri2_egl_display_vtbl dri2_x11_swrast_display_vtbl = {
    .authenticate = NULL,
    .create_window_surface = dri2_x11_create_window_surface,
@@ -1268,6 +1283,7 @@ static const struct dri2_egl_display_vtbl dri2_x11_kopper_display_vtbl = {
    .create_image = dri2_create_image_khr,
    .swap_interval = dri2_kopper_swap_interval,
    .swap_buffers = dri2_x11_swap_buffers,
+   .swap_buffers_with_damage = dri2_kopper_swap_buffers_with_damage,
    .swap_buffers_region = dri2_x11_swap_buffers_region,
    .post_sub_buffer = dri2_x11_post_sub_buffer,
    .copy_buffers = dri2_x11_copy_buffers,
@@ -1083,11 +1083,30 @@ tc_bind_sampler_states(struct pipe_context *_pipe,
    memcpy(p->slot, states, count * sizeof(states[0]));
 }
 
+struct tc_link_shader {
+   struct tc_call_base base;
+   void *shaders[PIPE_SHADER_TYPES];
+};
+
+static uint16_t
+tc_call_link_shader(struct pipe_context *pipe, void *call, uint64_t *last)
+{
+   struct tc_link_shader *p = to_call(call, tc_link_shader);
+
+   pipe->link_shader(pipe, p->shaders);
+   return call_size(tc_link_shader);
+}
+
+/* executed in order with the shader binds and deletes so that drivers don't
+ * have to make their program caches thread-safe
+ */
 static void
 tc_link_shader(struct pipe_context *_pipe, void **shaders)
 {
    struct threaded_context *tc = threaded_context(_pipe);
-   tc->pipe->link_shader(tc->pipe, shaders);
+   struct tc_link_shader *p = tc_add_call(tc, TC_CALL_link_shader, tc_link_shader);
+
+   memcpy(p->shaders, shaders, sizeof(p->shaders));
 }
 /********************************************************************
  * immediate states
@@ -7,6 +7,7 @@ CALL(end_query)
 CALL(get_query_result_resource)
 CALL(render_condition)
 CALL(bind_sampler_states)
+CALL(link_shader)
 CALL(set_framebuffer_state)
 CALL(set_tess_state)
 CALL(set_patch_vertices)
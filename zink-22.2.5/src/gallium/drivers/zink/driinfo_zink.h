@@ -8,5 +8,6 @@ DRI_CONF_SECTION_DEBUG
 DRI_CONF_SECTION_END
 
 DRI_CONF_SECTION_PERFORMANCE
-
+   DRI_CONF_OPT_B(zink_context_threaded, false,
+                  "Wrap contexts in a threaded context, unless ZINK_CONTEXT_THREADED is set")
 DRI_CONF_SECTION_END
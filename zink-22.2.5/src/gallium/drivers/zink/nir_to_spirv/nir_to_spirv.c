@@ -4428,6 +4428,11 @@ nir_to_spirv(struct nir_shader *s, const struct zink_shader_info *sinfo, uint32_
    }
    ctx.num_defs = entry->ssa_alloc;
 
+   /* most ALU ops come out as 4-6 words, loads/stores add type and pointer
+    * boilerplate; this is a rough guess that is cheaper than regrowing
+    */
+   spirv_builder_reserve_instructions(&ctx.builder, entry->ssa_alloc * 6);
+
    nir_index_local_regs(entry);
    ctx.regs = ralloc_array_size(ctx.mem_ctx,
                                 sizeof(SpvId), entry->reg_alloc);
@@ -56,7 +56,7 @@ static inline bool
 spirv_buffer_prepare(struct spirv_buffer *b, void *mem_ctx, size_t needed)
 {
    needed += b->num_words;
-   if (b->room >= b->num_words + needed)
+   if (b->room >= needed)
       return true;
 
    return spirv_buffer_grow(b, mem_ctx, needed);
@@ -1219,6 +1219,8 @@ get_type_def(struct spirv_builder *b, SpvOp op, const uint32_t args[],
                                          non_aggregate_type_hash,
                                          non_aggregate_type_equals);
       assert(b->types);
+      /* skip the first few rehashes, every shader has dozens of these */
+      _mesa_hash_table_reserve(b->types, 64);
    }
 
    struct spirv_type *type = rzalloc(b->mem_ctx, struct spirv_type);
@@ -1440,6 +1442,7 @@ get_const_def(struct spirv_builder *b, SpvOp op, SpvId type,
       b->consts = _mesa_hash_table_create(b->mem_ctx, const_hash,
                                           const_equals);
       assert(b->consts);
+      _mesa_hash_table_reserve(b->consts, 64);
    }
 
    struct spirv_const *cnst = rzalloc(b->mem_ctx, struct spirv_const);
@@ -1617,6 +1620,12 @@ spirv_builder_import(struct spirv_builder *b, const char *name)
    return result;
 }
 
+void
+spirv_builder_reserve_instructions(struct spirv_builder *b, size_t num_words)
+{
+   spirv_buffer_prepare(&b->instructions, b->mem_ctx, num_words);
+}
+
 size_t
 spirv_builder_get_num_words(struct spirv_builder *b)
 {
@@ -1670,13 +1679,12 @@ spirv_builder_get_words(struct spirv_builder *b, uint32_t *words,
    bool find_tcs_vertices_out = *tcs_vertices_out_word > 0;
    for (int i = 0; i < ARRAY_SIZE(buffers); ++i) {
       const struct spirv_buffer *buffer = buffers[i];
-      for (int j = 0; j < buffer->num_words; ++j) {
-         if (find_tcs_vertices_out && buffer == &b->exec_modes && *tcs_vertices_out_word == j) {
-            *tcs_vertices_out_word = written;
-            find_tcs_vertices_out = false;
-         }
-         words[written++] = buffer->words[j];
-      }
+      if (find_tcs_vertices_out && buffer == &b->exec_modes &&
+          *tcs_vertices_out_word < buffer->num_words)
+         *tcs_vertices_out_word += written;
+      if (buffer->num_words)
+         memcpy(words + written, buffer->words, buffer->num_words * sizeof(uint32_t));
+      written += buffer->num_words;
    }
 
    assert(written == spirv_builder_get_num_words(b));
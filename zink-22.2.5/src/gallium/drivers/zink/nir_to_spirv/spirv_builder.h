@@ -456,6 +456,10 @@ spirv_builder_emit_control_barrier(struct spirv_builder *b, SpvScope scope, SpvS
 SpvId
 spirv_builder_import(struct spirv_builder *b, const char *name);
 
+/* Sizes the instruction stream up front, to avoid growing it repeatedly. */
+void
+spirv_builder_reserve_instructions(struct spirv_builder *b, size_t num_words);
+
 size_t
 spirv_builder_get_num_words(struct spirv_builder *b);
 
@@ -13,7 +13,10 @@
 
 #include "util/hash_table.h"
 #include "util/u_debug.h"
+#include "util/os_time.h"
 #include "util/set.h"
+#include "util/perf/cpu_trace.h"
+#include "util/perf/u_stall.h"
 
 #ifdef VK_USE_PLATFORM_METAL_EXT
 #include "QuartzCore/CAMetalLayer.h"
@@ -278,8 +281,13 @@ get_batch_state(struct zink_context *ctx, struct zink_batch *batch)
    if (util_dynarray_num_elements(&ctx->free_batch_states, struct zink_batch_state*))
       bs = util_dynarray_pop(&ctx->free_batch_states, struct zink_batch_state*);
    if (!bs && ctx->batch_states) {
-      /* states are stored sequentially, so if the first one doesn't work, none of them will */
-      if (zink_screen_check_last_finished(screen, ctx->batch_states->fence.batch_id) ||
+      /* states are stored sequentially, so if the first one doesn't work, none of them will;
+       * polling the timeline is cheap and saves growing the state list
+       *
+       * the id is only assigned once the flush thread submits the batch
+       */
+      const uint64_t batch_id = p_atomic_read(&ctx->batch_states->fence.batch_id);
+      if ((batch_id && zink_screen_timeline_wait(screen, batch_id, 0)) ||
           find_unused_state(ctx->batch_states)) {
          bs = ctx->batch_states;
          pop_batch_state(ctx);
@@ -315,6 +323,7 @@ zink_start_batch(struct zink_context *ctx, struct zink_batch *batch)
    zink_reset_batch(ctx, batch);
 
    batch->state->usage.unflushed = true;
+   batch->state->gen = p_atomic_inc_return(&zink_screen(ctx->base.screen)->batch_gen);
 
    VkCommandBufferBeginInfo cbbi = {0};
    cbbi.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -364,6 +373,9 @@ submit_queue(void *data, void *gdata, int thread_index)
    struct zink_screen *screen = zink_screen(ctx->base.screen);
    VkSubmitInfo si[2] = {0};
    int num_si = 2;
+
+   MESA_TRACE_FUNC();
+
    while (!bs->fence.batch_id)
       bs->fence.batch_id = (uint32_t)p_atomic_inc_return(&screen->curr_batch);
    bs->usage.usage = bs->fence.batch_id;
@@ -455,6 +467,12 @@ end:
 void
 zink_end_batch(struct zink_context *ctx, struct zink_batch *batch)
 {
+   MESA_TRACE_FUNC();
+
+   /* deferred barriers can't outlive their cmdbufs */
+   if (unlikely(ctx->barriers.depth))
+      zink_flush_barriers(ctx);
+
    if (!ctx->queries_disabled)
       zink_suspend_queries(ctx, batch);
 
@@ -568,10 +586,21 @@ check_oom_flush(struct zink_context *ctx, const struct zink_batch *batch)
     }
 }
 
+/* stamp the object so that later references in the same batch skip the set lookup */
+static bool
+batch_add_resource(struct zink_batch *batch, struct zink_resource_object *obj)
+{
+   if (p_atomic_read(&obj->batch_gen) == batch->state->gen)
+      return false;
+   bool added = batch_ptr_add_usage(batch, batch->state->resources, obj);
+   p_atomic_set(&obj->batch_gen, batch->state->gen);
+   return added;
+}
+
 void
 zink_batch_reference_resource(struct zink_batch *batch, struct zink_resource *res)
 {
-   if (!batch_ptr_add_usage(batch, batch->state->resources, res->obj))
+   if (!batch_add_resource(batch, res->obj))
       return;
    pipe_reference(NULL, &res->obj->reference);
    batch->state->resource_size += res->obj->size;
@@ -582,7 +611,7 @@ zink_batch_reference_resource(struct zink_batch *batch, struct zink_resource *re
 void
 zink_batch_reference_resource_move(struct zink_batch *batch, struct zink_resource *res)
 {
-   if (!batch_ptr_add_usage(batch, batch->state->resources, res->obj))
+   if (!batch_add_resource(batch, res->obj))
       return;
    batch->state->resource_size += res->obj->size;
    check_oom_flush(batch->state->ctx, batch);
@@ -667,9 +696,15 @@ zink_batch_usage_check_completion(struct zink_context *ctx, const struct zink_ba
 void
 zink_batch_usage_wait(struct zink_context *ctx, struct zink_batch_usage *u)
 {
+   U_STALL_SITE(wait_site, "zink batch usage wait");
    if (!zink_batch_usage_exists(u))
       return;
-   if (zink_batch_usage_is_unflushed(u)) {
+   int64_t stall_start = os_time_get_nano();
+   bool unflushed = zink_batch_usage_is_unflushed(u);
+   bool stall = u_stall_begin(&wait_site, !unflushed ? "submitted batch" :
+                                          u == &ctx->batch.state->usage ? "unflushed batch" :
+                                          "other context");
+   if (unflushed) {
       if (likely(u == &ctx->batch.state->usage))
          ctx->base.flush(&ctx->base, NULL, PIPE_FLUSH_HINT_FINISH);
       else { //multi-context
@@ -679,4 +714,7 @@ zink_batch_usage_wait(struct zink_context *ctx, struct zink_batch_usage *u)
       }
    }
    zink_wait_on_batch(ctx, u->usage);
+   /* this can run on the app thread for unsynchronized maps */
+   p_atomic_add(&ctx->stats[ZINK_STAT_BATCH_STALL_TIME], os_time_get_nano() - stall_start);
+   u_stall_end(stall);
 }
@@ -113,6 +113,7 @@ struct zink_batch_state {
    struct set *programs;
 
    struct set *resources;
+   uint64_t gen; //screen-unique per started batch: objects stamped with it are already in 'resources'
    struct set *surfaces;
    struct set *bufferviews;
 
@@ -382,6 +382,91 @@ end:
       zink_kopper_present_readback(ctx, src);
 }
 
+/* Records the whole chain as one vkCmdBlitImage per level, with only a
+ * barrier on the level just written in between, instead of going through
+ * zink_blit() and a whole-image barrier for each level in util_gen_mipmap().
+ */
+bool
+zink_generate_mipmap(struct pipe_context *pctx,
+                     struct pipe_resource *pres,
+                     enum pipe_format format,
+                     unsigned base_level,
+                     unsigned last_level,
+                     unsigned first_layer,
+                     unsigned last_layer)
+{
+   struct zink_context *ctx = zink_context(pctx);
+   struct zink_screen *screen = zink_screen(pctx->screen);
+   struct zink_resource *res = zink_resource(pres);
+
+   /* leave everything unusual to util_gen_mipmap() */
+   if (pres->nr_samples > 1 ||
+       pres->target == PIPE_TEXTURE_3D ||
+       res->aspect != VK_IMAGE_ASPECT_COLOR_BIT ||
+       zink_is_swapchain(res) ||
+       res->format != zink_get_format(screen, format) ||
+       util_format_is_pure_integer(format))
+      return false;
+
+   const VkFormatFeatureFlags feats = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                      VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+   if ((get_resource_features(screen, res) & feats) != feats)
+      return false;
+
+   zink_fb_clears_apply(ctx, pres);
+
+   struct zink_batch *batch = &ctx->batch;
+   zink_resource_setup_transfer_layouts(ctx, res, res);
+   VkCommandBuffer cmdbuf = zink_get_cmdbuf(ctx, res, res);
+   zink_batch_reference_resource_rw(batch, res, true);
+
+   unsigned layer_count = last_layer - first_layer + 1;
+   for (unsigned level = base_level + 1; level <= last_level; level++) {
+      if (level > base_level + 1) {
+         /* the previous level was the last blit's destination */
+         VkImageMemoryBarrier imb = {
+            VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            NULL,
+            VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_ACCESS_TRANSFER_READ_BIT,
+            res->layout,
+            res->layout,
+            VK_QUEUE_FAMILY_IGNORED,
+            VK_QUEUE_FAMILY_IGNORED,
+            res->obj->image,
+            { res->aspect, level - 1, 1, first_layer, layer_count }
+         };
+         VKCTX(CmdPipelineBarrier)(cmdbuf,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                   0, 0, NULL, 0, NULL, 1, &imb);
+         ctx->stats[ZINK_STAT_PIPELINE_BARRIERS]++;
+      }
+
+      VkImageBlit region = {0};
+      region.srcSubresource.aspectMask = res->aspect;
+      region.srcSubresource.mipLevel = level - 1;
+      region.srcSubresource.baseArrayLayer = first_layer;
+      region.srcSubresource.layerCount = layer_count;
+      region.srcOffsets[1].x = u_minify(pres->width0, level - 1);
+      region.srcOffsets[1].y = u_minify(pres->height0, level - 1);
+      region.srcOffsets[1].z = 1;
+
+      region.dstSubresource = region.srcSubresource;
+      region.dstSubresource.mipLevel = level;
+      region.dstOffsets[1].x = u_minify(pres->width0, level);
+      region.dstOffsets[1].y = u_minify(pres->height0, level);
+      region.dstOffsets[1].z = 1;
+
+      VKCTX(CmdBlitImage)(cmdbuf, res->obj->image, res->layout,
+                          res->obj->image, res->layout,
+                          1, &region, VK_FILTER_LINEAR);
+   }
+
+   return true;
+}
+
 /* similar to radeonsi */
 void
 zink_blit_begin(struct zink_context *ctx, enum zink_blit_flags flags)
@@ -33,6 +33,7 @@
 #include "zink_bo.h"
 #include "zink_resource.h"
 #include "zink_screen.h"
+#include "util/os_misc.h"
 #include "util/u_hash_table.h"
 
 #if !defined(__APPLE__) && !defined(_WIN32)
@@ -147,6 +148,8 @@ bo_destroy(struct zink_screen *screen, struct pb_buffer *pbuf)
    }
 
    VKSCR(FreeMemory)(screen->dev, bo->mem, NULL);
+   /* size is only set once the allocation succeeded */
+   p_atomic_add(&screen->mem_stats.allocated, -(int64_t)bo->base.size);
 
    simple_mtx_destroy(&bo->lock);
    FREE(bo);
@@ -308,6 +311,7 @@ bo_create_internal(struct zink_screen *screen,
    bo->base.placement = screen->heap_flags[heap];
    bo->base.usage = flags;
    bo->unique_id = p_atomic_inc_return(&screen->pb.next_bo_unique_id);
+   p_atomic_add(&screen->mem_stats.allocated, bo->base.size);
 
    return bo;
 
@@ -366,9 +370,13 @@ sparse_backing_alloc(struct zink_screen *screen, struct zink_bo *bo,
 
       assert(bo->u.sparse.num_backing_pages < DIV_ROUND_UP(bo->base.size, ZINK_SPARSE_BUFFER_PAGE_SIZE));
 
-      size = MIN3(bo->base.size / 16,
-                  8 * 1024 * 1024,
-                  bo->base.size - (uint64_t)bo->u.sparse.num_backing_pages * ZINK_SPARSE_BUFFER_PAGE_SIZE);
+      /* grow the backing along with the commitment: a resource that keeps
+       * committing pages would otherwise end up with lots of small buffers,
+       * each of which has to be searched for every later commit
+       */
+      size = MAX2(MIN2(bo->base.size / 16, 8 * 1024 * 1024),
+                  MIN2((uint64_t)bo->u.sparse.num_backing_pages * ZINK_SPARSE_BUFFER_PAGE_SIZE / 2, 32 * 1024 * 1024));
+      size = MIN2(size, bo->base.size - (uint64_t)bo->u.sparse.num_backing_pages * ZINK_SPARSE_BUFFER_PAGE_SIZE);
       size = MAX2(size, ZINK_SPARSE_BUFFER_PAGE_SIZE);
 
       buf = zink_bo_create(screen, size, ZINK_SPARSE_BUFFER_PAGE_SIZE,
@@ -646,6 +654,13 @@ no_slab:
           return &bo->base;
    }
 
+   /* Cached buffers count against the budget too: drop them before asking
+    * for more memory than the heap can take.
+    */
+   unsigned vk_heap_idx = screen->info.mem_props.memoryTypes[screen->heap_map[heap]].heapIndex;
+   if (zink_screen_heap_over_budget(screen, vk_heap_idx, size))
+      clean_up_buffer_managers(screen);
+
    /* Create a new one. */
    bo = bo_create_internal(screen, size, alignment, heap, flags, pNext);
    if (!bo) {
@@ -722,8 +737,13 @@ get_semaphore(struct zink_screen *screen)
    return ret == VK_SUCCESS ? sem : VK_NULL_HANDLE;
 }
 
+/* commits are split into as few vkQueueBindSparse calls as possible: each
+ * call needs its own semaphore and costs a roundtrip through the kernel
+ */
+#define NUM_BATCHED_BINDS 50
+
 static VkSemaphore
-buffer_commit_single(struct zink_screen *screen, struct zink_resource *res, struct zink_bo *bo, uint32_t bo_offset, uint32_t offset, uint32_t size, bool commit, VkSemaphore wait)
+buffer_commit_single(struct zink_screen *screen, struct zink_resource *res, const VkSparseMemoryBind *binds, unsigned num_binds, VkSemaphore wait)
 {
    VkSemaphore sem = get_semaphore(screen);
    VkBindSparseInfo sparse = {0};
@@ -737,19 +757,12 @@ buffer_commit_single(struct zink_screen *screen, struct zink_resource *res, stru
    VkSparseBufferMemoryBindInfo sparse_bind[2];
    sparse_bind[0].buffer = res->obj->buffer;
    sparse_bind[1].buffer = res->obj->storage_buffer;
-   sparse_bind[0].bindCount = 1;
-   sparse_bind[1].bindCount = 1;
+   sparse_bind[0].bindCount = num_binds;
+   sparse_bind[1].bindCount = num_binds;
+   sparse_bind[0].pBinds = binds;
+   sparse_bind[1].pBinds = binds;
    sparse.pBufferBinds = sparse_bind;
 
-   VkSparseMemoryBind mem_bind;
-   mem_bind.resourceOffset = offset;
-   mem_bind.size = MIN2(res->base.b.width0 - offset, size);
-   mem_bind.memory = commit ? (bo->mem ? bo->mem : bo->u.slab.real->mem) : VK_NULL_HANDLE;
-   mem_bind.memoryOffset = bo_offset * ZINK_SPARSE_BUFFER_PAGE_SIZE + (commit ? (bo->mem ? 0 : bo->offset) : 0);
-   mem_bind.flags = 0;
-   sparse_bind[0].pBinds = &mem_bind;
-   sparse_bind[1].pBinds = &mem_bind;
-
    VkResult ret = VKSCR(QueueBindSparse)(screen->queue_sparse, 1, &sparse, VK_NULL_HANDLE);
    if (zink_screen_handle_vkresult(screen, ret))
       return sem;
@@ -757,6 +770,52 @@ buffer_commit_single(struct zink_screen *screen, struct zink_resource *res, stru
    return VK_NULL_HANDLE;
 }
 
+static void
+buffer_bind_init(VkSparseMemoryBind *mem_bind, struct zink_resource *res, struct zink_bo *bo, uint32_t bo_offset, uint32_t offset, uint32_t size, bool commit)
+{
+   mem_bind->resourceOffset = offset;
+   mem_bind->size = MIN2(res->base.b.width0 - offset, size);
+   mem_bind->memory = commit ? (bo->mem ? bo->mem : bo->u.slab.real->mem) : VK_NULL_HANDLE;
+   mem_bind->memoryOffset = bo_offset * ZINK_SPARSE_BUFFER_PAGE_SIZE + (commit ? (bo->mem ? 0 : bo->offset) : 0);
+   mem_bind->flags = 0;
+}
+
+struct buffer_commit_batch {
+   VkSparseMemoryBind binds[NUM_BATCHED_BINDS];
+   struct zink_sparse_backing *backing[NUM_BATCHED_BINDS];
+   uint32_t va_page[NUM_BATCHED_BINDS];
+   uint32_t backing_start[NUM_BATCHED_BINDS];
+   uint32_t backing_size[NUM_BATCHED_BINDS];
+   unsigned num_binds;
+};
+
+/* submit the pending commits; if that fails, give their pages back */
+static bool
+buffer_commit_flush(struct zink_screen *screen, struct zink_resource *res, struct buffer_commit_batch *batch, VkSemaphore *sem)
+{
+   struct zink_bo *bo = res->obj->bo;
+   struct zink_sparse_commitment *comm = bo->u.sparse.commitments;
+
+   if (!batch->num_binds)
+      return true;
+
+   VkSemaphore new_sem = buffer_commit_single(screen, res, batch->binds, batch->num_binds, *sem);
+   if (new_sem) {
+      *sem = new_sem;
+      batch->num_binds = 0;
+      return true;
+   }
+
+   for (unsigned i = 0; i < batch->num_binds; i++) {
+      for (unsigned p = 0; p < batch->backing_size[i]; p++)
+         comm[batch->va_page[i] + p].backing = NULL;
+      ASSERTED bool ok = sparse_backing_free(screen, bo, batch->backing[i], batch->backing_start[i], batch->backing_size[i]);
+      assert(ok && "sufficient memory should already be allocated");
+   }
+   batch->num_binds = 0;
+   return false;
+}
+
 static bool
 buffer_bo_commit(struct zink_screen *screen, struct zink_resource *res, uint32_t offset, uint32_t size, bool commit, VkSemaphore *sem)
 {
@@ -773,6 +832,8 @@ buffer_bo_commit(struct zink_screen *screen, struct zink_resource *res, uint32_t
    uint32_t end_va_page = va_page + DIV_ROUND_UP(size, ZINK_SPARSE_BUFFER_PAGE_SIZE);
    VkSemaphore cur_sem = VK_NULL_HANDLE;
    if (commit) {
+      struct buffer_commit_batch batch;
+      batch.num_binds = 0;
       while (va_page < end_va_page) {
          uint32_t span_va_page;
 
@@ -796,18 +857,17 @@ buffer_bo_commit(struct zink_screen *screen, struct zink_resource *res, uint32_t
             backing = sparse_backing_alloc(screen, bo, &backing_start, &backing_size);
             if (!backing) {
                ok = false;
-               goto out;
+               break;
             }
-            cur_sem = buffer_commit_single(screen, res, backing->bo, backing_start,
-                                           (uint64_t)span_va_page * ZINK_SPARSE_BUFFER_PAGE_SIZE,
-                                           (uint64_t)backing_size * ZINK_SPARSE_BUFFER_PAGE_SIZE, true, cur_sem);
-            if (!cur_sem) {
-               ok = sparse_backing_free(screen, bo, backing, backing_start, backing_size);
-               assert(ok && "sufficient memory should already be allocated");
 
-               ok = false;
-               goto out;
-            }
+            unsigned b = batch.num_binds++;
+            buffer_bind_init(&batch.binds[b], res, backing->bo, backing_start,
+                             (uint64_t)span_va_page * ZINK_SPARSE_BUFFER_PAGE_SIZE,
+                             (uint64_t)backing_size * ZINK_SPARSE_BUFFER_PAGE_SIZE, true);
+            batch.backing[b] = backing;
+            batch.va_page[b] = span_va_page;
+            batch.backing_start[b] = backing_start;
+            batch.backing_size[b] = backing_size;
 
             while (backing_size) {
                comm[span_va_page].backing = backing;
@@ -816,8 +876,18 @@ buffer_bo_commit(struct zink_screen *screen, struct zink_resource *res, uint32_t
                backing_start++;
                backing_size--;
             }
+
+            if (batch.num_binds == NUM_BATCHED_BINDS && !buffer_commit_flush(screen, res, &batch, &cur_sem)) {
+               ok = false;
+               break;
+            }
          }
+         if (!ok)
+            break;
       }
+      /* whatever was committed before a failure still has to be bound */
+      if (!buffer_commit_flush(screen, res, &batch, &cur_sem))
+         ok = false;
    } else {
       bool done = false;
       uint32_t base_page = va_page;
@@ -833,9 +903,11 @@ buffer_bo_commit(struct zink_screen *screen, struct zink_resource *res, uint32_t
          }
 
          if (!done) {
-            cur_sem = buffer_commit_single(screen, res, NULL, 0,
-                                           (uint64_t)base_page * ZINK_SPARSE_BUFFER_PAGE_SIZE,
-                                           (uint64_t)(end_va_page - base_page) * ZINK_SPARSE_BUFFER_PAGE_SIZE, false, cur_sem);
+            VkSparseMemoryBind mem_bind;
+            buffer_bind_init(&mem_bind, res, NULL, 0,
+                             (uint64_t)base_page * ZINK_SPARSE_BUFFER_PAGE_SIZE,
+                             (uint64_t)(end_va_page - base_page) * ZINK_SPARSE_BUFFER_PAGE_SIZE, false);
+            cur_sem = buffer_commit_single(screen, res, &mem_bind, 1, cur_sem);
             if (!cur_sem) {
                ok = false;
                goto out;
@@ -872,22 +944,32 @@ out:
 }
 
 static VkSemaphore
-texture_commit_single(struct zink_screen *screen, struct zink_resource *res, VkSparseImageMemoryBind *ibind, unsigned num_binds, bool commit, VkSemaphore wait)
+texture_commit_single(struct zink_screen *screen, struct zink_resource *res, const VkSparseImageMemoryBind *ibind, const VkSparseMemoryBind *mbind, unsigned num_binds, VkSemaphore wait)
 {
    VkSemaphore sem = get_semaphore(screen);
    VkBindSparseInfo sparse = {0};
    sparse.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
-   sparse.imageBindCount = 1;
    sparse.waitSemaphoreCount = !!wait;
    sparse.pWaitSemaphores = &wait;
    sparse.signalSemaphoreCount = 1;
    sparse.pSignalSemaphores = &sem;
 
+   /* the miptail has no image coordinates, it's bound by opaque offset */
    VkSparseImageMemoryBindInfo sparse_ibind;
-   sparse_ibind.image = res->obj->image;
-   sparse_ibind.bindCount = num_binds;
-   sparse_ibind.pBinds = ibind;
-   sparse.pImageBinds = &sparse_ibind;
+   VkSparseImageOpaqueMemoryBindInfo sparse_bind;
+   if (ibind) {
+      sparse_ibind.image = res->obj->image;
+      sparse_ibind.bindCount = num_binds;
+      sparse_ibind.pBinds = ibind;
+      sparse.imageBindCount = 1;
+      sparse.pImageBinds = &sparse_ibind;
+   } else {
+      sparse_bind.image = res->obj->image;
+      sparse_bind.bindCount = num_binds;
+      sparse_bind.pBinds = mbind;
+      sparse.imageOpaqueBindCount = 1;
+      sparse.pImageOpaqueBinds = &sparse_bind;
+   }
 
    VkResult ret = VKSCR(QueueBindSparse)(screen->queue_sparse, 1, &sparse, VK_NULL_HANDLE);
    if (zink_screen_handle_vkresult(screen, ret))
@@ -896,36 +978,64 @@ texture_commit_single(struct zink_screen *screen, struct zink_resource *res, VkS
    return VK_NULL_HANDLE;
 }
 
-static VkSemaphore
-texture_commit_miptail(struct zink_screen *screen, struct zink_resource *res, struct zink_bo *bo, uint32_t bo_offset, uint32_t offset, bool commit, VkSemaphore wait)
+static void
+texture_miptail_bind_init(VkSparseMemoryBind *mem_bind, struct zink_resource *res, struct zink_bo *bo, uint32_t bo_offset, uint32_t offset, bool commit)
 {
-   VkSemaphore sem = get_semaphore(screen);
-   VkBindSparseInfo sparse = {0};
-   sparse.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
-   sparse.imageOpaqueBindCount = 1;
-   sparse.waitSemaphoreCount = !!wait;
-   sparse.pWaitSemaphores = &wait;
-   sparse.signalSemaphoreCount = 1;
-   sparse.pSignalSemaphores = &sem;
+   mem_bind->resourceOffset = offset;
+   mem_bind->size = MIN2(ZINK_SPARSE_BUFFER_PAGE_SIZE, res->sparse.imageMipTailSize - offset);
+   mem_bind->memory = commit ? (bo->mem ? bo->mem : bo->u.slab.real->mem) : VK_NULL_HANDLE;
+   mem_bind->memoryOffset = bo_offset * ZINK_SPARSE_BUFFER_PAGE_SIZE + (commit ? (bo->mem ? 0 : bo->offset) : 0);
+   mem_bind->flags = 0;
+}
 
-   VkSparseImageOpaqueMemoryBindInfo sparse_bind;
-   sparse_bind.image = res->obj->image;
-   sparse_bind.bindCount = 1;
-   sparse.pImageOpaqueBinds = &sparse_bind;
-
-   VkSparseMemoryBind mem_bind;
-   mem_bind.resourceOffset = offset;
-   mem_bind.size = MIN2(ZINK_SPARSE_BUFFER_PAGE_SIZE, res->sparse.imageMipTailSize - offset);
-   mem_bind.memory = commit ? (bo->mem ? bo->mem : bo->u.slab.real->mem) : VK_NULL_HANDLE;
-   mem_bind.memoryOffset = bo_offset + (commit ? (bo->mem ? 0 : bo->offset) : 0);
-   mem_bind.flags = 0;
-   sparse_bind.pBinds = &mem_bind;
+struct texture_commit_batch {
+   VkSparseImageMemoryBind ibind[NUM_BATCHED_BINDS];
+   VkSparseMemoryBind mbind[NUM_BATCHED_BINDS];
+   struct zink_sparse_backing *backing[NUM_BATCHED_BINDS];
+   uint32_t va_page[NUM_BATCHED_BINDS];
+   uint32_t backing_start[NUM_BATCHED_BINDS];
+   uint32_t backing_size[NUM_BATCHED_BINDS];
+   unsigned num_binds;
+};
 
-   VkResult ret = VKSCR(QueueBindSparse)(screen->queue_sparse, 1, &sparse, VK_NULL_HANDLE);
-   if (zink_screen_handle_vkresult(screen, ret))
-      return sem;
-   VKSCR(DestroySemaphore)(screen->dev, sem, NULL);
-   return VK_NULL_HANDLE;
+/* submit the pending binds and settle the page tracking: a successful
+ * decommit frees its pages, a failed commit or decommit is undone
+ */
+static bool
+texture_commit_flush(struct zink_screen *screen, struct zink_resource *res, struct texture_commit_batch *batch, bool miptail, bool commit, VkSemaphore *sem)
+{
+   struct zink_bo *bo = res->obj->bo;
+   struct zink_sparse_commitment *comm = bo->u.sparse.commitments;
+
+   if (!batch->num_binds)
+      return true;
+
+   VkSemaphore new_sem = texture_commit_single(screen, res, miptail ? NULL : batch->ibind, miptail ? batch->mbind : NULL,
+                                               batch->num_binds, *sem);
+   for (unsigned i = 0; i < batch->num_binds; i++) {
+      if (new_sem && commit)
+         continue;
+      if (!new_sem && !commit) {
+         for (unsigned p = 0; p < batch->backing_size[i]; p++) {
+            comm[batch->va_page[i] + p].backing = batch->backing[i];
+            comm[batch->va_page[i] + p].page = batch->backing_start[i] + p;
+         }
+         continue;
+      }
+      if (!new_sem) {
+         for (unsigned p = 0; p < batch->backing_size[i]; p++)
+            comm[batch->va_page[i] + p].backing = NULL;
+      }
+      if (!sparse_backing_free(screen, bo, batch->backing[i], batch->backing_start[i], batch->backing_size[i])) {
+         /* Couldn't allocate tracking data structures, so we have to leak */
+         fprintf(stderr, "zink: leaking sparse backing memory\n");
+      }
+   }
+   batch->num_binds = 0;
+   if (!new_sem)
+      return false;
+   *sem = new_sem;
+   return true;
 }
 
 bool
@@ -941,7 +1051,7 @@ zink_bo_commit(struct zink_screen *screen, struct zink_resource *res, unsigned l
    simple_mtx_lock(&screen->queue_lock);
    simple_mtx_lock(&bo->lock);
    if (res->base.b.target == PIPE_BUFFER) {
-      ok = buffer_bo_commit(screen, res, box->x, box->width, commit, sem);
+      ok = buffer_bo_commit(screen, res, box->x, box->width, commit, &cur_sem);
       goto out;
    }
 
@@ -961,12 +1071,9 @@ zink_bo_commit(struct zink_screen *screen, struct zink_resource *res, unsigned l
 			   (box->height % gheight) ? box->height % gheight : gheight,
 			   (box->depth % gdepth) ? box->depth % gdepth : gdepth
    };
-#define NUM_BATCHED_BINDS 50
-   VkSparseImageMemoryBind ibind[NUM_BATCHED_BINDS];
-   uint32_t backing_start[NUM_BATCHED_BINDS], backing_size[NUM_BATCHED_BINDS];
-   struct zink_sparse_backing *backing[NUM_BATCHED_BINDS];
-   unsigned i = 0;
-   bool commits_pending = false;
+   const bool miptail = level >= res->sparse.imageMipTailFirstLod;
+   struct texture_commit_batch batch;
+   batch.num_binds = 0;
    uint32_t va_page_offset = 0;
    for (unsigned l = 0; l < level; l++) {
       unsigned mipwidth = DIV_ROUND_UP(MAX2(res->base.b.width0 >> l, 1), gwidth);
@@ -974,28 +1081,31 @@ zink_bo_commit(struct zink_screen *screen, struct zink_resource *res, unsigned l
       unsigned mipdepth = DIV_ROUND_UP(res->base.b.array_size > 1 ? res->base.b.array_size : MAX2(res->base.b.depth0 >> l, 1), gdepth);
       va_page_offset += mipwidth * mipheight * mipdepth;
    }
-   for (unsigned d = 0; d < ndepth; d++) {
-      for (unsigned h = 0; h < nheight; h++) {
-         for (unsigned w = 0; w < nwidth; w++) {
-            ibind[i].subresource = subresource;
-            ibind[i].flags = 0;
+   for (unsigned d = 0; d < ndepth && ok; d++) {
+      for (unsigned h = 0; h < nheight && ok; h++) {
+         for (unsigned w = 0; w < nwidth && ok; w++) {
+            unsigned i = batch.num_binds;
+            VkSparseImageMemoryBind *ibind = &batch.ibind[i];
+            ibind->subresource = subresource;
+            ibind->flags = 0;
             // Offset
-            ibind[i].offset.x = w * gwidth;
-            ibind[i].offset.y = h * gheight;
+            ibind->offset.x = w * gwidth;
+            ibind->offset.y = h * gheight;
             if (res->base.b.array_size > 1) {
-               ibind[i].subresource.arrayLayer = d * gdepth;
-               ibind[i].offset.z = 0;
+               ibind->subresource.arrayLayer = d * gdepth;
+               ibind->offset.z = 0;
             } else {
-               ibind[i].offset.z = d * gdepth;
+               ibind->offset.z = d * gdepth;
             }
             // Size of the page
-            ibind[i].extent.width = (w == nwidth - 1) ? lastBlockExtent.width : gwidth;
-            ibind[i].extent.height = (h == nheight - 1) ? lastBlockExtent.height : gheight;
-            ibind[i].extent.depth = (d == ndepth - 1 && res->base.b.target != PIPE_TEXTURE_CUBE) ? lastBlockExtent.depth : gdepth;
+            ibind->extent.width = (w == nwidth - 1) ? lastBlockExtent.width : gwidth;
+            ibind->extent.height = (h == nheight - 1) ? lastBlockExtent.height : gheight;
+            ibind->extent.depth = (d == ndepth - 1 && res->base.b.target != PIPE_TEXTURE_CUBE) ? lastBlockExtent.depth : gdepth;
             uint32_t va_page = va_page_offset +
                               (d + (box->z / gdepth)) * ((MAX2(res->base.b.width0 >> level, 1) / gwidth) * (MAX2(res->base.b.height0 >> level, 1) / gheight)) +
                               (h + (box->y / gheight)) * (MAX2(res->base.b.width0 >> level, 1) / gwidth) +
                               (w + (box->x / gwidth));
+            uint32_t miptail_offset = res->sparse.imageMipTailOffset + d * res->sparse.imageMipTailStride;
 
             uint32_t end_va_page = va_page + 1;
 
@@ -1016,37 +1126,40 @@ zink_bo_commit(struct zink_screen *screen, struct zink_resource *res, unsigned l
 
                   /* Fill the uncommitted span with chunks of backing memory. */
                   while (span_va_page < va_page) {
-                     backing_size[i] = va_page - span_va_page;
-                     backing[i] = sparse_backing_alloc(screen, bo, &backing_start[i], &backing_size[i]);
-                     if (!backing[i]) {
+                     struct zink_sparse_backing *backing;
+                     uint32_t backing_start, backing_size;
+
+                     backing_size = va_page - span_va_page;
+                     backing = sparse_backing_alloc(screen, bo, &backing_start, &backing_size);
+                     if (!backing) {
                         ok = false;
-                        goto out;
+                        break;
                      }
-                     if (level >= res->sparse.imageMipTailFirstLod) {
-                        uint32_t offset = res->sparse.imageMipTailOffset + d * res->sparse.imageMipTailStride;
-                        cur_sem = texture_commit_miptail(screen, res, backing[i]->bo, backing_start[i], offset, commit, cur_sem);
-                        if (!cur_sem)
-                           goto out;
+                     if (miptail) {
+                        texture_miptail_bind_init(&batch.mbind[i], res, backing->bo, backing_start, miptail_offset, true);
                      } else {
-                        ibind[i].memory = backing[i]->bo->mem ? backing[i]->bo->mem : backing[i]->bo->u.slab.real->mem;
-                        ibind[i].memoryOffset = backing_start[i] * ZINK_SPARSE_BUFFER_PAGE_SIZE +
-                                                (backing[i]->bo->mem ? 0 : backing[i]->bo->offset);
-                        commits_pending = true;
+                        ibind->memory = backing->bo->mem ? backing->bo->mem : backing->bo->u.slab.real->mem;
+                        ibind->memoryOffset = backing_start * ZINK_SPARSE_BUFFER_PAGE_SIZE +
+                                              (backing->bo->mem ? 0 : backing->bo->offset);
                      }
-
-                     while (backing_size[i]) {
-                        comm[span_va_page].backing = backing[i];
-                        comm[span_va_page].page = backing_start[i];
+                     batch.backing[i] = backing;
+                     batch.va_page[i] = span_va_page;
+                     batch.backing_start[i] = backing_start;
+                     batch.backing_size[i] = backing_size;
+                     batch.num_binds++;
+
+                     while (backing_size) {
+                        comm[span_va_page].backing = backing;
+                        comm[span_va_page].page = backing_start;
                         span_va_page++;
-                        backing_start[i]++;
-                        backing_size[i]--;
+                        backing_start++;
+                        backing_size--;
                      }
-                     i++;
                   }
                }
             } else {
-               ibind[i].memory = VK_NULL_HANDLE;
-               ibind[i].memoryOffset = 0;
+               ibind->memory = VK_NULL_HANDLE;
+               ibind->memoryOffset = 0;
 
                while (va_page < end_va_page) {
                   /* Skip pages that are already uncommitted. */
@@ -1056,63 +1169,37 @@ zink_bo_commit(struct zink_screen *screen, struct zink_resource *res, unsigned l
                   }
 
                   /* Group contiguous spans of pages. */
-                  backing[i] = comm[va_page].backing;
-                  backing_start[i] = comm[va_page].page;
+                  struct zink_sparse_backing *backing = comm[va_page].backing;
+                  uint32_t backing_start = comm[va_page].page;
+                  uint32_t backing_size = 1;
+                  batch.va_page[i] = va_page;
                   comm[va_page].backing = NULL;
-
-                  backing_size[i] = 1;
                   va_page++;
 
                   while (va_page < end_va_page &&
-                         comm[va_page].backing == backing[i] &&
-                         comm[va_page].page == backing_start[i] + backing_size[i]) {
+                         comm[va_page].backing == backing &&
+                         comm[va_page].page == backing_start + backing_size) {
                      comm[va_page].backing = NULL;
                      va_page++;
-                     backing_size[i]++;
-                  }
-                  if (level >= res->sparse.imageMipTailFirstLod) {
-                     uint32_t offset = res->sparse.imageMipTailOffset + d * res->sparse.imageMipTailStride;
-                     cur_sem = texture_commit_miptail(screen, res, NULL, 0, offset, commit, cur_sem);
-                     if (!cur_sem)
-                        goto out;
-                  } else {
-                     commits_pending = true;
-                  }
-                  i++;
-               }
-            }
-            if (i == ARRAY_SIZE(ibind)) {
-               cur_sem = texture_commit_single(screen, res, ibind, ARRAY_SIZE(ibind), commit, cur_sem);
-               if (!cur_sem) {
-                  for (unsigned s = 0; s < i; s++) {
-                     ok = sparse_backing_free(screen, backing[s]->bo, backing[s], backing_start[s], backing_size[s]);
-                     if (!ok) {
-                        /* Couldn't allocate tracking data structures, so we have to leak */
-                        fprintf(stderr, "zink: leaking sparse backing memory\n");
-                     }
+                     backing_size++;
                   }
-                  ok = false;
-                  goto out;
+                  if (miptail)
+                     texture_miptail_bind_init(&batch.mbind[i], res, NULL, 0, miptail_offset, false);
+                  batch.backing[i] = backing;
+                  batch.backing_start[i] = backing_start;
+                  batch.backing_size[i] = backing_size;
+                  batch.num_binds++;
                }
-               commits_pending = false;
-               i = 0;
             }
+            if (batch.num_binds == NUM_BATCHED_BINDS &&
+                !texture_commit_flush(screen, res, &batch, miptail, commit, &cur_sem))
+               ok = false;
          }
       }
    }
-   if (commits_pending) {
-      cur_sem = texture_commit_single(screen, res, ibind, i, commit, cur_sem);
-      if (!cur_sem) {
-         for (unsigned s = 0; s < i; s++) {
-            ok = sparse_backing_free(screen, backing[s]->bo, backing[s], backing_start[s], backing_size[s]);
-            if (!ok) {
-               /* Couldn't allocate tracking data structures, so we have to leak */
-               fprintf(stderr, "zink: leaking sparse backing memory\n");
-            }
-         }
-      }
+   /* whatever was tracked before a failure still has to be bound */
+   if (!texture_commit_flush(screen, res, &batch, miptail, commit, &cur_sem))
       ok = false;
-   }
 out:
 
    simple_mtx_unlock(&bo->lock);
@@ -1264,9 +1351,53 @@ bo_slab_alloc_normal(void *priv, unsigned heap, unsigned entry_size, unsigned gr
    return bo_slab_alloc(priv, heap, entry_size, group_index, false);
 }
 
+uint64_t
+zink_bo_cached_size(struct zink_screen *screen)
+{
+   simple_mtx_lock(&screen->pb.bo_cache.mutex);
+   uint64_t size = screen->pb.bo_cache.cache_size;
+   simple_mtx_unlock(&screen->pb.bo_cache.mutex);
+   return size;
+}
+
+void
+zink_mem_stats_dump(struct zink_screen *screen)
+{
+   static const char *names[] = {
+      [ZINK_MEM_BUFFER] = "buffer",
+      [ZINK_MEM_IMAGE] = "image",
+      [ZINK_MEM_STAGING] = "staging",
+   };
+   STATIC_ASSERT(ARRAY_SIZE(names) == ZINK_MEM_COUNT);
+
+   mesa_logi("ZINK_MEM_STATS frame %u: %" PRIu64 " kb allocated, %" PRIu64 " kb cached",
+             p_atomic_read(&screen->mem_stats.frame),
+             p_atomic_read(&screen->mem_stats.allocated) / 1024,
+             zink_bo_cached_size(screen) / 1024);
+   for (unsigned i = 0; i < ZINK_MEM_COUNT; i++) {
+      uint32_t count = p_atomic_read(&screen->mem_stats.count[i]);
+      if (count)
+         mesa_logi("%12s: %6u objects, %9" PRIu64 " kb", names[i], count,
+                   p_atomic_read(&screen->mem_stats.size[i]) / 1024);
+   }
+}
+
+void
+zink_mem_stats_frame(struct zink_screen *screen)
+{
+   if (likely(!screen->mem_stats.dump_period))
+      return;
+   if (p_atomic_inc_return(&screen->mem_stats.frame) % screen->mem_stats.dump_period == 0)
+      zink_mem_stats_dump(screen);
+}
+
 bool
 zink_bo_init(struct zink_screen *screen)
 {
+   const char *mem_stats = os_get_option("ZINK_MEM_STATS");
+   screen->mem_stats.dump = mem_stats != NULL;
+   screen->mem_stats.dump_period = mem_stats ? strtoul(mem_stats, NULL, 0) : 0;
+
    uint64_t total_mem = 0;
    for (uint32_t i = 0; i < screen->info.mem_props.memoryHeapCount; ++i)
       total_mem += screen->info.mem_props.memoryHeaps[i].size;
@@ -183,6 +183,17 @@ zink_bo_init(struct zink_screen *screen);
 void
 zink_bo_deinit(struct zink_screen *screen);
 
+/* idle memory held by the bo cache */
+uint64_t
+zink_bo_cached_size(struct zink_screen *screen);
+
+void
+zink_mem_stats_dump(struct zink_screen *screen);
+
+/* counts a frame for ZINK_MEM_STATS=<n> */
+void
+zink_mem_stats_frame(struct zink_screen *screen);
+
 struct pb_buffer *
 zink_bo_create(struct zink_screen *screen, uint64_t size, unsigned alignment, enum zink_heap heap, enum zink_alloc_flag flags, const void *pNext);
 
@@ -126,10 +126,26 @@ add_new_clear(struct zink_framebuffer_clear *fb_clear)
    return zink_fb_clear_element(fb_clear, zink_fb_clear_count(fb_clear) - 1);
 }
 
+/* zs_bits: the PIPE_CLEAR_DEPTHSTENCIL bits being cleared, or 0 for color attachments */
 static struct zink_framebuffer_clear_data *
-get_clear_data(struct zink_context *ctx, struct zink_framebuffer_clear *fb_clear, const struct pipe_scissor_state *scissor_state)
+get_clear_data(struct zink_context *ctx, struct zink_framebuffer_clear *fb_clear, const struct pipe_scissor_state *scissor_state,
+               unsigned zs_bits)
 {
    unsigned num_clears = zink_fb_clear_count(fb_clear);
+   if (num_clears > 1 && !scissor_state && !ctx->render_condition_active) {
+      /* an unconditional full clear overwrites everything queued before it, as long as it
+       * covers every aspect those clears touched: keep a single clear so it can be a loadOp
+       */
+      bool covers = true;
+      if (zs_bits) {
+         for (unsigned i = 0; i < num_clears; i++)
+            covers &= !(zink_fb_clear_element(fb_clear, i)->zs.bits & ~zs_bits);
+      }
+      if (covers) {
+         util_dynarray_resize(&fb_clear->clears, struct zink_framebuffer_clear_data, 1);
+         return zink_fb_clear_element(fb_clear, 0);
+      }
+   }
    if (num_clears) {
       struct zink_framebuffer_clear_data *last_clear = zink_fb_clear_element(fb_clear, num_clears - 1);
       /* if we're completely overwriting the previous clear, merge this into the previous clear */
@@ -262,8 +278,11 @@ zink_clear(struct pipe_context *pctx,
                    */
                   add_new_clear(fb_clear);
                   struct zink_framebuffer_clear_data *clear = fb_clear->clears.data;
-                  memcpy(clear + 1, clear, num_clears);
+                  memmove(clear + 1, clear, num_clears * sizeof(*clear));
                   memcpy(&clear->color, &color, sizeof(color));
+                  /* the void clear covers the whole attachment */
+                  clear->has_scissor = false;
+                  clear->conditional = false;
                } else {
                   /* no void clear needed */
                }
@@ -281,7 +300,7 @@ zink_clear(struct pipe_context *pctx,
             struct pipe_surface *psurf = fb->cbufs[i];
             const struct util_format_description *desc = util_format_description(psurf->format);
             struct zink_framebuffer_clear *fb_clear = &ctx->fb_clears[i];
-            struct zink_framebuffer_clear_data *clear = get_clear_data(ctx, fb_clear, needs_rp ? scissor_state : NULL);
+            struct zink_framebuffer_clear_data *clear = get_clear_data(ctx, fb_clear, needs_rp ? scissor_state : NULL, 0);
 
             ctx->clears_enabled |= PIPE_CLEAR_COLOR0 << i;
             clear->conditional = ctx->render_condition_active;
@@ -300,7 +319,8 @@ zink_clear(struct pipe_context *pctx,
 
    if (buffers & PIPE_CLEAR_DEPTHSTENCIL && fb->zsbuf) {
       struct zink_framebuffer_clear *fb_clear = &ctx->fb_clears[PIPE_MAX_COLOR_BUFS];
-      struct zink_framebuffer_clear_data *clear = get_clear_data(ctx, fb_clear, needs_rp ? scissor_state : NULL);
+      struct zink_framebuffer_clear_data *clear = get_clear_data(ctx, fb_clear, needs_rp ? scissor_state : NULL,
+                                                                  buffers & PIPE_CLEAR_DEPTHSTENCIL);
       ctx->clears_enabled |= PIPE_CLEAR_DEPTHSTENCIL;
       clear->conditional = ctx->render_condition_active;
       clear->has_scissor = needs_rp;
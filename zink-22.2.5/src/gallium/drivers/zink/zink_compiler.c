@@ -358,6 +358,7 @@ zink_screen_init_compiler(struct zink_screen *screen)
       .has_fsub = true,
       .has_isub = true,
       .has_txs = true,
+      .has_cs_global_id = true,
       .lower_mul_2x32_64 = true,
       .support_16bit_alu = true, /* not quite what it sounds like */
    };
@@ -3012,6 +3013,41 @@ split_bitfields(nir_shader *shader)
    return nir_shader_instructions_pass(shader, split_bitfields_instr, nir_metadata_dominance, NULL);
 }
 
+/* A workgroup smaller than a subgroup leaves lanes idle in every wave it
+ * occupies: this is common with GL compute shaders ported from D3D, which
+ * often use 8x8x1 or smaller groups.  If the shader can't observe its
+ * workgroup, neighbouring groups are merged into a single larger one, which
+ * covers exactly the same gl_GlobalInvocationID range.
+ */
+static unsigned
+compute_retile_factor(struct zink_screen *screen, const nir_shader *nir)
+{
+   const shader_info *info = &nir->info;
+   unsigned size = info->workgroup_size[0] * info->workgroup_size[1] * info->workgroup_size[2];
+   unsigned target = screen->info.props11.subgroupSize;
+
+   if (zink_debug & ZINK_DEBUG_NORETILE)
+      return 0;
+   if (!size || !util_is_power_of_two_nonzero(size) ||
+       !util_is_power_of_two_nonzero(target) || size >= target)
+      return 0;
+   if (info->workgroup_size_variable || info->cs.derivative_group ||
+       info->uses_control_barrier || info->uses_wide_subgroup_intrinsics ||
+       info->shared_size)
+      return 0;
+   nir_foreach_variable_with_modes(var, nir, nir_var_mem_shared)
+      return 0;
+
+   /* the global id is all the shader may know of where it runs */
+   BITSET_DECLARE(sysvals, SYSTEM_VALUE_MAX);
+   BITSET_COPY(sysvals, info->system_values_read);
+   BITSET_CLEAR(sysvals, SYSTEM_VALUE_GLOBAL_INVOCATION_ID);
+   if (BITSET_COUNT(sysvals))
+      return 0;
+
+   return target / size;
+}
+
 struct zink_shader *
 zink_shader_create(struct zink_screen *screen, struct nir_shader *nir,
                    const struct pipe_stream_output_info *so_info)
@@ -3185,6 +3221,14 @@ zink_shader_create(struct zink_screen *screen, struct nir_shader *nir,
    NIR_PASS_V(nir, match_tex_dests);
 
    ret->nir = nir;
+   if (nir->info.stage == MESA_SHADER_COMPUTE) {
+      ret->retile_factor = compute_retile_factor(screen, nir);
+      /* the size is chosen per dispatch, through the spec constants of a
+       * variable size shader
+       */
+      if (ret->retile_factor)
+         memset(nir->info.workgroup_size, 0, sizeof(nir->info.workgroup_size));
+   }
    nir_foreach_shader_out_variable(var, nir)
       var->data.explicit_xfb_buffer = 0;
    if (so_info && so_info->num_outputs)
@@ -3259,6 +3303,8 @@ zink_shader_free(struct zink_context *ctx, struct zink_shader *shader)
          struct zink_gfx_program *prog = (void*)entry->key;
          enum pipe_shader_type pstage = pipe_shader_type_from_mesa(shader->nir->info.stage);
          assert(pstage < ZINK_SHADER_COUNT);
+         /* the precompile job reads the program's shaders */
+         util_queue_fence_wait(&prog->precompile_fence);
          if (!prog->base.removed && (shader->nir->info.stage != MESA_SHADER_TESS_CTRL || !shader->is_generated)) {
             unsigned stages_present = prog->stages_present;
             if (prog->shaders[PIPE_SHADER_TESS_CTRL] && prog->shaders[PIPE_SHADER_TESS_CTRL]->is_generated)
@@ -96,6 +96,10 @@ struct zink_shader {
    uint32_t ssbos_used; // bitfield of which ssbo indices are used
    bool bindless;
    bool can_inline;
+   /* compute only: up to this many workgroups of a dispatch can be merged
+    * into one, see zink_program_retile_compute()
+    */
+   unsigned retile_factor;
    struct spirv_shader *spirv;
 
    simple_mtx_t lock;
@@ -49,7 +49,9 @@
 #include "util/u_thread.h"
 #include "util/u_cpu_detect.h"
 #include "util/strndup.h"
+#include "util/perf/cpu_trace.h"
 #include "nir.h"
+#include "tgsi/tgsi_from_mesa.h"
 
 #include "driver_trace/tr_context.h"
 
@@ -165,7 +167,22 @@ zink_context_destroy(struct pipe_context *pctx)
    hash_table_foreach(ctx->render_pass_cache, he)
       zink_destroy_render_pass(screen, he->data);
 
+   for (unsigned i = 0; i < ARRAY_SIZE(ctx->query_accumulate_cs); i++) {
+      if (ctx->query_accumulate_cs[i])
+         pctx->delete_compute_state(pctx, ctx->query_accumulate_cs[i]);
+   }
    zink_context_destroy_query_pools(ctx);
+   /* background optimized compiles may still be linking these */
+   if (util_queue_is_initialized(&screen->optimize_thread))
+      util_queue_finish(&screen->optimize_thread);
+   set_foreach(&ctx->gfx_inputs, he) {
+      struct zink_gfx_input_key *ikey = (void*)he->key;
+      VKSCR(DestroyPipeline)(screen->dev, ikey->pipeline, NULL);
+   }
+   set_foreach(&ctx->gfx_outputs, he) {
+      struct zink_gfx_output_key *okey = (void*)he->key;
+      VKSCR(DestroyPipeline)(screen->dev, okey->pipeline, NULL);
+   }
    u_upload_destroy(pctx->stream_uploader);
    u_upload_destroy(pctx->const_uploader);
    slab_destroy_child(&ctx->transfer_pool);
@@ -556,6 +573,12 @@ update_descriptor_state_ubo(struct zink_context *ctx, enum pipe_shader_type shad
       ctx->di.ubos[shader][slot].range = VK_WHOLE_SIZE;
    }
    if (!slot) {
+      VkDescriptorBufferInfo *push = &ctx->di.push_ubos[shader];
+      if (push->buffer != ctx->di.ubos[shader][0].buffer || push->range != ctx->di.ubos[shader][0].range)
+         ctx->dd->push_set_dirty[shader == PIPE_SHADER_COMPUTE] = true;
+      push->buffer = ctx->di.ubos[shader][0].buffer;
+      push->range = ctx->di.ubos[shader][0].range;
+      ctx->di.push_ubo_offsets[tgsi_processor_to_shader_stage(shader)] = res ? ctx->di.ubos[shader][0].offset : 0;
       if (res)
          ctx->di.push_valid |= BITFIELD64_BIT(shader);
       else
@@ -2141,6 +2164,7 @@ zink_update_fbfetch(struct zink_context *ctx)
       ctx->di.fbfetch.imageView = zink_screen(ctx->base.screen)->info.rb2_feats.nullDescriptor ?
                                   VK_NULL_HANDLE :
                                   zink_csurface(ctx->dummy_surface[0])->image_view;
+      ctx->dd->push_set_dirty[0] = true;
       zink_screen(ctx->base.screen)->context_invalidate_descriptor_state(ctx, PIPE_SHADER_FRAGMENT, ZINK_DESCRIPTOR_TYPE_UBO, 0, 1);
       return;
    }
@@ -2160,6 +2184,7 @@ zink_update_fbfetch(struct zink_context *ctx)
    }
    ctx->di.fbfetch.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
    if (changed) {
+      ctx->dd->push_set_dirty[0] = true;
       zink_screen(ctx->base.screen)->context_invalidate_descriptor_state(ctx, PIPE_SHADER_FRAGMENT, ZINK_DESCRIPTOR_TYPE_UBO, 0, 1);
       if (!had_fbfetch) {
          ctx->rp_changed = true;
@@ -2634,9 +2659,7 @@ zink_update_descriptor_refs(struct zink_context *ctx, bool compute)
    } else {
       for (unsigned i = 0; i < ZINK_SHADER_COUNT; i++)
          update_resource_refs_for_stage(ctx, i);
-      unsigned vertex_buffers_enabled_mask = ctx->gfx_pipeline_state.vertex_buffers_enabled_mask;
-      unsigned last_vbo = util_last_bit(vertex_buffers_enabled_mask);
-      for (unsigned i = 0; i < last_vbo + 1; i++) {
+      u_foreach_bit(i, ctx->gfx_pipeline_state.vertex_buffers_enabled_mask) {
          struct zink_resource *res = zink_resource(ctx->vertex_buffers[i].buffer.resource);
          if (res) {
             zink_batch_resource_usage_set(batch, res, false);
@@ -2688,6 +2711,12 @@ static void
 flush_batch(struct zink_context *ctx, bool sync)
 {
    struct zink_batch *batch = &ctx->batch;
+
+   MESA_TRACE_FUNC();
+
+   if (ctx->oom_flush)
+      ctx->stats[ZINK_STAT_OOM_FLUSHES]++;
+
    if (ctx->clears_enabled)
       /* start rp to do all the clears */
       zink_batch_rp(ctx);
@@ -2939,7 +2968,7 @@ zink_set_framebuffer_state(struct pipe_context *pctx,
       ctx->rast_state_changed = true;
    rebind_fb_state(ctx, NULL, true);
    ctx->fb_state.samples = MAX2(samples, 1);
-   zink_update_framebuffer_state(ctx);
+   zink_invalidate_framebuffer(ctx);
    if (ctx->fb_state.width != w || ctx->fb_state.height != h)
       ctx->scissor_changed = true;
 
@@ -3236,6 +3265,99 @@ resource_check_defer_image_barrier(struct zink_context *ctx, struct zink_resourc
       _mesa_set_add(ctx->need_barriers[is_compute], res);
 }
 
+static struct zink_pending_barriers *
+pending_barriers(struct zink_context *ctx, VkCommandBuffer cmdbuf)
+{
+   struct zink_pending_barriers *pending =
+      &ctx->barriers.pending[cmdbuf == ctx->batch.state->barrier_cmdbuf];
+   assert(!pending->cmdbuf || pending->cmdbuf == cmdbuf);
+   pending->cmdbuf = cmdbuf;
+   ctx->stats[ZINK_STAT_BARRIERS_BATCHED]++;
+   return pending;
+}
+
+static void
+defer_memory_barrier(struct zink_context *ctx, VkCommandBuffer cmdbuf,
+                     VkPipelineStageFlags src_stage, VkAccessFlags src_access,
+                     VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+   struct zink_pending_barriers *pending = pending_barriers(ctx, cmdbuf);
+   pending->src_stage |= src_stage;
+   pending->src_access |= src_access;
+   pending->dst_stage |= dst_stage;
+   pending->dst_access |= dst_access;
+   pending->has_memory_barrier = true;
+}
+
+/* Nothing is recorded between deferred barriers, so a second transition of
+ * the same image can go straight from the first one's source state to its
+ * own destination, skipping the intermediate layout.
+ */
+static void
+defer_image_barrier(struct zink_context *ctx, VkCommandBuffer cmdbuf, const VkImageMemoryBarrier *imb,
+                    VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage)
+{
+   struct zink_pending_barriers *pending = pending_barriers(ctx, cmdbuf);
+   pending->src_stage |= src_stage;
+   pending->dst_stage |= dst_stage;
+   util_dynarray_foreach(&pending->images, VkImageMemoryBarrier, prev) {
+      if (prev->image != imb->image)
+         continue;
+      assert(prev->newLayout == imb->oldLayout);
+      prev->newLayout = imb->newLayout;
+      prev->dstAccessMask = imb->dstAccessMask;
+      if (imb->pNext)
+         prev->pNext = imb->pNext;
+      return;
+   }
+   util_dynarray_append(&pending->images, VkImageMemoryBarrier, *imb);
+}
+
+static void
+flush_pending_barriers(struct zink_context *ctx, struct zink_pending_barriers *pending)
+{
+   VkMemoryBarrier mb = {
+      VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      NULL,
+      pending->src_access,
+      pending->dst_access
+   };
+   VKCTX(CmdPipelineBarrier)(
+      pending->cmdbuf,
+      pending->src_stage,
+      pending->dst_stage,
+      0,
+      pending->has_memory_barrier, &mb,
+      0, NULL,
+      util_dynarray_num_elements(&pending->images, VkImageMemoryBarrier),
+      pending->images.data
+   );
+   ctx->stats[ZINK_STAT_PIPELINE_BARRIERS]++;
+
+   util_dynarray_clear(&pending->images);
+   pending->cmdbuf = VK_NULL_HANDLE;
+   pending->src_stage = pending->dst_stage = 0;
+   pending->src_access = pending->dst_access = 0;
+   pending->has_memory_barrier = false;
+}
+
+void
+zink_flush_barriers(struct zink_context *ctx)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(ctx->barriers.pending); i++) {
+      if (ctx->barriers.pending[i].cmdbuf)
+         flush_pending_barriers(ctx, &ctx->barriers.pending[i]);
+   }
+}
+
+void
+zink_barriers_end(struct zink_context *ctx)
+{
+   assert(ctx->barriers.depth);
+   if (!--ctx->barriers.depth)
+      zink_flush_barriers(ctx);
+}
+
 void
 zink_resource_image_barrier(struct zink_context *ctx, struct zink_resource *res,
                       VkImageLayout new_layout, VkAccessFlags flags, VkPipelineStageFlags pipeline)
@@ -3260,15 +3382,21 @@ zink_resource_image_barrier(struct zink_context *ctx, struct zink_resource *res,
       imb.dstQueueFamilyIndex = zink_screen(ctx->base.screen)->gfx_queue;
       res->dmabuf_acquire = false;
    }
-   VKCTX(CmdPipelineBarrier)(
-      cmdbuf,
-      res->obj->access_stage ? res->obj->access_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-      pipeline,
-      0,
-      0, NULL,
-      0, NULL,
-      1, &imb
-   );
+   VkPipelineStageFlags src_stage = res->obj->access_stage ? res->obj->access_stage : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+   if (ctx->barriers.depth) {
+      defer_image_barrier(ctx, cmdbuf, &imb, src_stage, pipeline);
+   } else {
+      VKCTX(CmdPipelineBarrier)(
+         cmdbuf,
+         src_stage,
+         pipeline,
+         0,
+         0, NULL,
+         0, NULL,
+         1, &imb
+      );
+      ctx->stats[ZINK_STAT_PIPELINE_BARRIERS]++;
+   }
 
    resource_check_defer_image_barrier(ctx, res, new_layout, pipeline);
 
@@ -3348,15 +3476,21 @@ zink_resource_buffer_barrier(struct zink_context *ctx, struct zink_resource *res
    bool is_write = zink_resource_access_is_write(flags);
    VkCommandBuffer cmdbuf = is_write ? zink_get_cmdbuf(ctx, NULL, res) : zink_get_cmdbuf(ctx, res, NULL);
    /* only barrier if we're changing layout or doing something besides read -> read */
-   VKCTX(CmdPipelineBarrier)(
-      cmdbuf,
-      res->obj->access_stage ? res->obj->access_stage : pipeline_access_stage(res->obj->access),
-      pipeline,
-      0,
-      1, &bmb,
-      0, NULL,
-      0, NULL
-   );
+   VkPipelineStageFlags src_stage = res->obj->access_stage ? res->obj->access_stage : pipeline_access_stage(res->obj->access);
+   if (ctx->barriers.depth) {
+      defer_memory_barrier(ctx, cmdbuf, src_stage, bmb.srcAccessMask, pipeline, flags);
+   } else {
+      VKCTX(CmdPipelineBarrier)(
+         cmdbuf,
+         src_stage,
+         pipeline,
+         0,
+         1, &bmb,
+         0, NULL,
+         0, NULL
+      );
+      ctx->stats[ZINK_STAT_PIPELINE_BARRIERS]++;
+   }
 
    resource_check_defer_buffer_barrier(ctx, res, pipeline);
 
@@ -3399,6 +3533,8 @@ zink_flush(struct pipe_context *pctx,
    struct zink_screen *screen = zink_screen(ctx->base.screen);
    unsigned submit_count = 0;
 
+   MESA_TRACE_FUNC();
+
    /* triggering clears will force has_work */
    if (!deferred && ctx->clears_enabled) {
       /* if fbfetch outputs are active, disable them when flushing clears */
@@ -3413,6 +3549,8 @@ zink_flush(struct pipe_context *pctx,
       ctx->rp_changed |= fbfetch_outputs > 0;
    }
 
+   if (flags & PIPE_FLUSH_END_OF_FRAME)
+      zink_mem_stats_frame(screen);
    if (ctx->needs_present && (flags & PIPE_FLUSH_END_OF_FRAME)) {
       if (ctx->needs_present->obj->image)
          zink_resource_image_barrier(ctx, ctx->needs_present, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
@@ -3529,7 +3667,7 @@ zink_texture_barrier(struct pipe_context *pctx, unsigned flags)
                        VK_ACCESS_INPUT_ATTACHMENT_READ_BIT :
                        VK_ACCESS_SHADER_READ_BIT;
 
-   if (!ctx->framebuffer || !ctx->framebuffer->state.num_attachments)
+   if (!ctx->fb_state.nr_cbufs && !ctx->fb_state.zsbuf)
       return;
 
    /* if this is a fb barrier, flush all pending clears */
@@ -3777,7 +3915,7 @@ zink_set_stream_output_targets(struct pipe_context *pctx,
 void
 zink_rebind_framebuffer(struct zink_context *ctx, struct zink_resource *res)
 {
-   if (!ctx->framebuffer)
+   if (!ctx->fb_state.nr_cbufs && !ctx->fb_state.zsbuf)
       return;
    bool did_rebind = false;
    if (res->aspect & VK_IMAGE_ASPECT_COLOR_BIT) {
@@ -3801,9 +3939,7 @@ zink_rebind_framebuffer(struct zink_context *ctx, struct zink_resource *res)
       return;
 
    zink_batch_no_rp(ctx);
-   struct zink_framebuffer *fb = zink_get_framebuffer(ctx);
-   ctx->fb_changed |= ctx->framebuffer != fb;
-   ctx->framebuffer = fb;
+   zink_invalidate_framebuffer(ctx);
 }
 
 ALWAYS_INLINE static struct zink_resource *
@@ -4017,13 +4153,17 @@ zink_copy_image_buffer(struct zink_context *ctx, struct zink_resource *dst, stru
          if (!zink_kopper_acquire(ctx, img, UINT64_MAX))
             return;
       }
+      zink_barriers_begin(ctx);
       zink_resource_image_barrier(ctx, img, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, 0);
       zink_resource_buffer_barrier(ctx, buf, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+      zink_barriers_end(ctx);
    } else {
       if (zink_is_swapchain(img))
          needs_present_readback = zink_kopper_acquire_readback(ctx, img);
+      zink_barriers_begin(ctx);
       zink_resource_image_barrier(ctx, img, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, 0, 0);
       zink_resource_buffer_barrier(ctx, buf, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+      zink_barriers_end(ctx);
       util_range_add(&dst->base.b, &dst->valid_buffer_range, dstx, dstx + src_box->width);
    }
 
@@ -4493,6 +4633,7 @@ zink_context_create(struct pipe_screen *pscreen, void *priv, unsigned flags)
    ctx->base.resource_commit = zink_resource_commit;
    ctx->base.resource_copy_region = zink_resource_copy_region;
    ctx->base.blit = zink_blit;
+   ctx->base.generate_mipmap = zink_generate_mipmap;
    ctx->base.create_stream_output_target = zink_create_stream_output_target;
    ctx->base.stream_output_target_destroy = zink_stream_output_target_destroy;
 
@@ -4526,6 +4667,8 @@ zink_context_create(struct pipe_screen *pscreen, void *priv, unsigned flags)
    ctx->base.const_uploader = u_upload_create_default(&ctx->base);
    for (int i = 0; i < ARRAY_SIZE(ctx->fb_clears); i++)
       util_dynarray_init(&ctx->fb_clears[i].clears, ctx);
+   for (int i = 0; i < ARRAY_SIZE(ctx->barriers.pending); i++)
+      util_dynarray_init(&ctx->barriers.pending[i].images, ctx);
 
    if (!is_copy_only) {
       ctx->blitter = util_blitter_create(&ctx->base);
@@ -4642,13 +4785,10 @@ zink_context_create(struct pipe_screen *pscreen, void *priv, unsigned flags)
     */
    if (screen->info.dynamic_state2_feats.extendedDynamicState2PatchControlPoints)
       VKCTX(CmdSetPatchControlPointsEXT)(ctx->batch.state->cmdbuf, 1);
-  
-   const char *zink_context_threaded_value = getenv("ZINK_CONTEXT_THREADED");
 
    flags &= ~PIPE_CONTEXT_PREFER_THREADED;
-   if (zink_context_threaded_value && (strcmp(zink_context_threaded_value, "true") == 0 || strcmp(zink_context_threaded_value, "1") == 0)) {
+   if (screen->driconf.context_threaded)
       flags |= PIPE_CONTEXT_PREFER_THREADED;
-   }  
 
    if (!(flags & PIPE_CONTEXT_PREFER_THREADED) || flags & PIPE_CONTEXT_COMPUTE_ONLY) {
       return &ctx->base;
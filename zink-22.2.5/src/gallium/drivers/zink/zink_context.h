@@ -73,6 +73,27 @@ struct zink_rasterizer_state;
 struct zink_resource;
 struct zink_vertex_elements_state;
 
+/* software counters exposed as driver-specific queries (GALLIUM_HUD) */
+enum zink_stat {
+   ZINK_STAT_DESCRIPTOR_SETS_ALLOCATED,
+   ZINK_STAT_DESCRIPTOR_SET_UPDATES,
+   ZINK_STAT_PIPELINE_MISSES,
+   ZINK_STAT_PIPELINE_COMPILE_TIME, //ns
+   ZINK_STAT_OOM_FLUSHES,
+   ZINK_STAT_BATCH_STALL_TIME, //ns
+   ZINK_STAT_TC_SYNCS,
+   ZINK_STAT_STAGING_BYTES_MAPPED,
+   ZINK_STAT_PIPELINE_BARRIERS, //vkCmdPipelineBarrier calls
+   ZINK_STAT_BARRIERS_BATCHED, //barriers deferred into a zink_barriers_begin() group
+   /* screen-wide memory usage (bytes), reported as is rather than as deltas */
+   ZINK_STAT_MEM_BUFFERS,
+   ZINK_STAT_MEM_IMAGES,
+   ZINK_STAT_MEM_STAGING,
+   ZINK_STAT_MEM_ALLOCATED,
+   ZINK_STAT_MEM_CACHED,
+   ZINK_STAT_COUNT,
+};
+
 enum zink_blit_flags {
    ZINK_BLIT_NORMAL = 1 << 0,
    ZINK_BLIT_SAVE_FS = 1 << 1,
@@ -197,6 +218,25 @@ typedef enum {
    ZINK_DYNAMIC_VERTEX_INPUT,
 } zink_dynamic_state;
 
+/* barriers deferred for one cmdbuf; all buffer barriers are merged into a
+ * single memory barrier, and the stage masks are shared by the image
+ * barriers too
+ */
+struct zink_pending_barriers {
+   VkCommandBuffer cmdbuf;
+   VkPipelineStageFlags src_stage;
+   VkPipelineStageFlags dst_stage;
+   VkAccessFlags src_access;
+   VkAccessFlags dst_access;
+   bool has_memory_barrier;
+   struct util_dynarray images; //VkImageMemoryBarrier
+};
+
+struct zink_barrier_batch {
+   unsigned depth; //zink_barriers_begin() nesting
+   struct zink_pending_barriers pending[2]; //cmdbuf, barrier_cmdbuf
+};
+
 struct zink_context {
    struct pipe_context base;
    struct threaded_context *tc;
@@ -219,6 +259,7 @@ struct zink_context {
    struct util_dynarray free_batch_states; //unused batch states
    bool oom_flush;
    bool oom_stall;
+   uint64_t stats[ZINK_STAT_COUNT]; //indexed by enum zink_stat
    struct zink_batch batch;
 
    unsigned shader_has_inlinable_uniforms_mask;
@@ -250,6 +291,9 @@ struct zink_context {
     * thus only 3 stages need to be considered, giving 2^3 = 8 program caches.
     */
    struct hash_table program_cache[8];
+   /* vertex input and fragment output pipeline libraries, shared between programs */
+   struct set gfx_inputs;
+   struct set gfx_outputs;
    uint32_t gfx_hash;
    struct zink_gfx_program *curr_program;
 
@@ -262,6 +306,7 @@ struct zink_context {
 
    unsigned shader_stages : ZINK_SHADER_COUNT; /* mask of bound gfx shader stages */
    unsigned dirty_shader_stages : 6; /* mask of changed shader stages */
+   unsigned inline_pending_stages : 6; /* gfx stages whose uniform values aren't yet known to be stable */
    bool last_vertex_stage_dirty;
 
    struct {
@@ -290,6 +335,8 @@ struct zink_context {
 
    struct pipe_vertex_buffer vertex_buffers[PIPE_MAX_ATTRIBS];
    bool vertex_buffers_dirty;
+   /* the vertex input last set by CmdSetVertexInputEXT in the current cmdbuf */
+   const struct zink_vertex_elements_hw_state *vertex_input;
 
    struct zink_sampler_state *sampler_states[PIPE_SHADER_TYPES][PIPE_MAX_SAMPLERS];
    struct pipe_sampler_view *sampler_views[PIPE_SHADER_TYPES][PIPE_MAX_SAMPLERS];
@@ -328,6 +375,8 @@ struct zink_context {
       bool inverted;
       bool active; //this is the internal vk state
    } render_condition;
+   /* sums multiple query results into a 32/64bit value on the gpu */
+   void *query_accumulate_cs[2];
 
    struct pipe_resource *dummy_vertex_buffer;
    struct pipe_resource *dummy_xfb_buffer;
@@ -340,6 +389,9 @@ struct zink_context {
    struct {
       /* descriptor info */
       VkDescriptorBufferInfo ubos[PIPE_SHADER_TYPES][PIPE_MAX_CONSTANT_BUFFERS];
+      /* ubo0 for the dynamic push set: offset is always 0, with the real offset in push_ubo_offsets */
+      VkDescriptorBufferInfo push_ubos[PIPE_SHADER_TYPES];
+      uint32_t push_ubo_offsets[MESA_SHADER_STAGES]; //indexed by binding
       uint32_t push_valid;
       uint8_t num_ubos[PIPE_SHADER_TYPES];
 
@@ -383,6 +435,7 @@ struct zink_context {
    struct set update_barriers[2][2]; //[gfx, compute][current, next]
    uint8_t barrier_set_idx[2];
    unsigned memory_barrier;
+   struct zink_barrier_batch barriers;
 
    uint32_t num_so_targets;
    struct pipe_stream_output_target *so_targets[PIPE_MAX_SO_OUTPUTS];
@@ -441,6 +494,20 @@ void
 zink_resource_image_barrier(struct zink_context *ctx, struct zink_resource *res,
                       VkImageLayout new_layout, VkAccessFlags flags, VkPipelineStageFlags pipeline);
 
+/* Barriers issued until the matching zink_barriers_end() are gathered and
+ * recorded together, as one vkCmdPipelineBarrier per cmdbuf.  Only barriers
+ * may be recorded into the batch's cmdbufs in between.
+ */
+static inline void
+zink_barriers_begin(struct zink_context *ctx)
+{
+   ctx->barriers.depth++;
+}
+void
+zink_barriers_end(struct zink_context *ctx);
+void
+zink_flush_barriers(struct zink_context *ctx);
+
 bool
 zink_resource_needs_barrier(struct zink_resource *res, VkImageLayout layout, VkAccessFlags flags, VkPipelineStageFlags pipeline);
 void
@@ -517,6 +584,15 @@ void
 zink_blit(struct pipe_context *pctx,
           const struct pipe_blit_info *info);
 
+bool
+zink_generate_mipmap(struct pipe_context *pctx,
+                     struct pipe_resource *pres,
+                     enum pipe_format format,
+                     unsigned base_level,
+                     unsigned last_level,
+                     unsigned first_layer,
+                     unsigned last_layer);
+
 bool
 zink_blit_region_fills(struct u_rect region, unsigned width, unsigned height);
 
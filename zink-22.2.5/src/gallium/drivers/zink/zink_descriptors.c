@@ -523,13 +523,22 @@ init_push_binding(VkDescriptorSetLayoutBinding *binding, unsigned i, VkDescripto
    binding->pImmutableSamplers = NULL;
 }
 
+/* unless push descriptors are used, the push set uses dynamic ubos so that rebinding
+ * a constant buffer at a new offset only needs new dynamic offsets instead of a new set
+ */
+bool
+zink_descriptor_push_set_is_dynamic(struct zink_screen *screen)
+{
+   return zink_descriptor_mode != ZINK_DESCRIPTOR_MODE_LAZY || !screen->info.have_KHR_push_descriptor;
+}
+
 static VkDescriptorType
 get_push_types(struct zink_screen *screen, enum zink_descriptor_type *dsl_type)
 {
    *dsl_type = zink_descriptor_mode == ZINK_DESCRIPTOR_MODE_LAZY &&
                screen->info.have_KHR_push_descriptor ? ZINK_DESCRIPTOR_TYPES : ZINK_DESCRIPTOR_TYPE_UBO;
-   return zink_descriptor_mode == ZINK_DESCRIPTOR_MODE_LAZY ?
-          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+   return zink_descriptor_push_set_is_dynamic(screen) ?
+          VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 }
 
 static struct zink_descriptor_layout *
@@ -652,6 +661,7 @@ allocate_desc_set(struct zink_context *ctx, struct zink_program *pg, enum zink_d
    VkDescriptorSet *desc_set = alloca(sizeof(*desc_set) * bucket_size);
    if (!zink_descriptor_util_alloc_sets(screen, push_set ? ctx->dd->push_dsl[is_compute]->layout : pg->dsl[type + 1], pool->descpool, desc_set, bucket_size))
       return VK_NULL_HANDLE;
+   ctx->stats[ZINK_STAT_DESCRIPTOR_SETS_ALLOCATED] += bucket_size;
 
    struct zink_descriptor_set *alloc = ralloc_array(pool, struct zink_descriptor_set, bucket_size);
    assert(alloc);
@@ -1333,8 +1343,10 @@ update_push_ubo_descriptors(struct zink_context *ctx, struct zink_descriptor_set
       fbfetch = true;
    }
 
-   if (!cache_hit)
+   if (!cache_hit) {
       VKSCR(UpdateDescriptorSets)(screen->dev, num_stages + !!fbfetch, wds, 0, NULL);
+      ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES]++;
+   }
    return num_stages;
 }
 
@@ -1458,8 +1470,10 @@ update_descriptors_internal(struct zink_context *ctx, enum zink_descriptor_type
          }
       }
    }
-   if (num_wds)
+   if (num_wds) {
       VKSCR(UpdateDescriptorSets)(screen->dev, num_wds, wds, 0, NULL);
+      ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES]++;
+   }
 }
 
 static void
@@ -1999,26 +2013,37 @@ void
 zink_descriptors_update_bindless(struct zink_context *ctx)
 {
    struct zink_screen *screen = zink_screen(ctx->base.screen);
+   /* batch the writes: making many handles resident at once is common */
+   VkWriteDescriptorSet wds[64];
+   unsigned num_wds = 0;
    for (unsigned i = 0; i < 2; i++) {
       if (!ctx->di.bindless_dirty[i])
          continue;
       while (util_dynarray_contains(&ctx->di.bindless[i].updates, uint32_t)) {
          uint32_t handle = util_dynarray_pop(&ctx->di.bindless[i].updates, uint32_t);
          bool is_buffer = ZINK_BINDLESS_IS_BUFFER(handle);
-         VkWriteDescriptorSet wd;
-         wd.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-         wd.pNext = NULL;
-         wd.dstSet = ctx->dd->bindless_set;
-         wd.dstBinding = is_buffer ? i * 2 + 1: i * 2;
-         wd.dstArrayElement = is_buffer ? handle - ZINK_MAX_BINDLESS_HANDLES : handle;
-         wd.descriptorCount = 1;
-         wd.descriptorType = type_from_bindless_index(wd.dstBinding);
+         VkWriteDescriptorSet *wd = &wds[num_wds++];
+         wd->sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+         wd->pNext = NULL;
+         wd->dstSet = ctx->dd->bindless_set;
+         wd->dstBinding = is_buffer ? i * 2 + 1: i * 2;
+         wd->dstArrayElement = is_buffer ? handle - ZINK_MAX_BINDLESS_HANDLES : handle;
+         wd->descriptorCount = 1;
+         wd->descriptorType = type_from_bindless_index(wd->dstBinding);
          if (is_buffer)
-            wd.pTexelBufferView = &ctx->di.bindless[i].buffer_infos[wd.dstArrayElement];
+            wd->pTexelBufferView = &ctx->di.bindless[i].buffer_infos[wd->dstArrayElement];
          else
-            wd.pImageInfo = &ctx->di.bindless[i].img_infos[handle];
-         VKSCR(UpdateDescriptorSets)(screen->dev, 1, &wd, 0, NULL);
+            wd->pImageInfo = &ctx->di.bindless[i].img_infos[handle];
+         if (num_wds == ARRAY_SIZE(wds)) {
+            VKSCR(UpdateDescriptorSets)(screen->dev, num_wds, wds, 0, NULL);
+            ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES] += num_wds;
+            num_wds = 0;
+         }
       }
    }
+   if (num_wds)
+      VKSCR(UpdateDescriptorSets)(screen->dev, num_wds, wds, 0, NULL);
+   /* bindless handles are written one descriptor at a time */
+   ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES] += num_wds;
    ctx->di.any_bindless_dirty = 0;
 }
@@ -152,6 +152,7 @@ struct zink_descriptor_data {
 
    bool changed[2][ZINK_DESCRIPTOR_TYPES + 1];
    bool has_fbfetch;
+   bool push_set_dirty[2]; //gfx, compute; push set needs rewriting, not just new dynamic offsets
    struct zink_program *pg[2]; //gfx, compute
 };
 
@@ -256,6 +257,8 @@ zink_get_sampler_view_hash(struct zink_context *ctx, struct zink_sampler_view *s
 uint32_t
 zink_get_image_view_hash(struct zink_context *ctx, struct zink_image_view *image_view, bool is_buffer);
 bool
+zink_descriptor_push_set_is_dynamic(struct zink_screen *screen);
+bool
 zink_descriptor_util_alloc_sets(struct zink_screen *screen, VkDescriptorSetLayout dsl, VkDescriptorPool pool, VkDescriptorSet *sets, unsigned num_sets);
 struct zink_descriptor_layout *
 zink_descriptor_util_layout_get(struct zink_context *ctx, enum zink_descriptor_type type,
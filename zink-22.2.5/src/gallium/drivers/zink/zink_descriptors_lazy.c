@@ -405,6 +405,7 @@ check_pool_alloc(struct zink_context *ctx, struct zink_descriptor_pool *pool, st
                                            pool->pool, &pool->sets[pool->sets_alloc], sets_to_alloc))
          return NULL;
       pool->sets_alloc += sets_to_alloc;
+      ctx->stats[ZINK_STAT_DESCRIPTOR_SETS_ALLOCATED] += sets_to_alloc;
    }
    return pool;
 }
@@ -414,7 +415,7 @@ create_push_pool(struct zink_screen *screen, struct zink_batch_descriptor_data_l
 {
    struct zink_descriptor_pool *pool = rzalloc(bdd, struct zink_descriptor_pool);
    VkDescriptorPoolSize sizes[2];
-   sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+   sizes[0].type = zink_descriptor_push_set_is_dynamic(screen) ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
    if (is_compute)
       sizes[0].descriptorCount = MAX_LAZY_DESCRIPTORS;
    else {
@@ -446,6 +447,7 @@ check_push_pool_alloc(struct zink_context *ctx, struct zink_descriptor_pool *poo
          return NULL;
       }
       pool->sets_alloc += sets_to_alloc;
+      ctx->stats[ZINK_STAT_DESCRIPTOR_SETS_ALLOCATED] += sets_to_alloc;
    }
    return pool;
 }
@@ -505,6 +507,7 @@ zink_descriptor_set_update_lazy(struct zink_context *ctx, struct zink_program *p
 {
    struct zink_screen *screen = zink_screen(ctx->base.screen);
    VKCTX(UpdateDescriptorSetWithTemplate)(screen->dev, set, pg->dd->templates[type + 1], ctx);
+   ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES]++;
 }
 
 void
@@ -525,26 +528,30 @@ zink_descriptors_update_lazy_masked(struct zink_context *ctx, bool is_compute, u
    /* no flushing allowed */
    assert(ctx->batch.state == bs);
 
+   unsigned bind_mask = 0;
    u_foreach_bit(type, changed_sets) {
       assert(type + 1 < pg->num_dsl);
       if (pg->dd->pool_key[type]) {
          VKSCR(UpdateDescriptorSetWithTemplate)(screen->dev, desc_sets[type], pg->dd->templates[type + 1], ctx);
-         VKSCR(CmdBindDescriptorSets)(bs->cmdbuf,
-                                 is_compute ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 /* set index incremented by 1 to account for push set */
-                                 pg->layout, type + 1, 1, &desc_sets[type],
-                                 0, NULL);
+         ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES]++;
          bdd->sets[is_compute][type + 1] = desc_sets[type];
+         bind_mask |= BITFIELD_BIT(type);
       }
    }
    u_foreach_bit(type, bind_sets & ~changed_sets) {
       if (!pg->dd->pool_key[type])
          continue;
       assert(bdd->sets[is_compute][type + 1]);
+      bind_mask |= BITFIELD_BIT(type);
+   }
+   /* bind each run of consecutive sets with a single call */
+   while (bind_mask) {
+      int start, count;
+      u_bit_scan_consecutive_range(&bind_mask, &start, &count);
       VKSCR(CmdBindDescriptorSets)(bs->cmdbuf,
                               is_compute ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS,
                               /* set index incremented by 1 to account for push set */
-                              pg->layout, type + 1, 1, &bdd->sets[is_compute][type + 1],
+                              pg->layout, start + 1, count, &bdd->sets[is_compute][start + 1],
                               0, NULL);
    }
 }
@@ -603,8 +610,12 @@ zink_descriptors_update_lazy(struct zink_context *ctx, bool is_compute)
    uint8_t changed_sets = pg->dd->binding_usage & dd_lazy(ctx)->state_changed[is_compute];
    bool need_push = pg->dd->push_usage &&
                     (dd_lazy(ctx)->push_state_changed[is_compute] || batch_changed);
+   /* ubo0 offsets are dynamic without push descriptors: only buffer/range/fbfetch changes need a new set */
+   bool need_push_set = need_push && !have_KHR_push_descriptor &&
+                        (ctx->dd->push_set_dirty[is_compute] || batch_changed ||
+                         ctx->dd->has_fbfetch != bdd->has_fbfetch);
    VkDescriptorSet push_set = VK_NULL_HANDLE;
-   if (need_push && !have_KHR_push_descriptor) {
+   if (need_push_set) {
       struct zink_descriptor_pool *pool = check_push_pool_alloc(ctx, bdd->push_pool[pg->is_compute], bdd, pg->is_compute);
       push_set = get_descriptor_set_lazy(pool);
       if (!push_set) {
@@ -625,15 +636,19 @@ zink_descriptors_update_lazy(struct zink_context *ctx, bool is_compute)
             VKCTX(CmdPushDescriptorSetWithTemplateKHR)(bs->cmdbuf, pg->dd->templates[0],
                                                         pg->layout, 0, ctx);
       } else {
-         if (dd_lazy(ctx)->push_state_changed[is_compute]) {
+         if (push_set) {
             VKCTX(UpdateDescriptorSetWithTemplate)(screen->dev, push_set, pg->dd->templates[0], ctx);
+            ctx->stats[ZINK_STAT_DESCRIPTOR_SET_UPDATES]++;
             bdd->sets[is_compute][0] = push_set;
+            ctx->dd->push_set_dirty[is_compute] = false;
          }
-         assert(push_set || bdd->sets[is_compute][0]);
+         assert(bdd->sets[is_compute][0]);
+         /* dynamic offsets are ordered by binding, which is the mesa stage */
          VKCTX(CmdBindDescriptorSets)(bs->cmdbuf,
                                  is_compute ? VK_PIPELINE_BIND_POINT_COMPUTE : VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                 pg->layout, 0, 1, push_set ? &push_set : &bdd->sets[is_compute][0],
-                                 0, NULL);
+                                 pg->layout, 0, 1, &bdd->sets[is_compute][0],
+                                 is_compute ? 1 : ZINK_SHADER_COUNT,
+                                 &ctx->di.push_ubo_offsets[is_compute ? MESA_SHADER_COMPUTE : 0]);
       }
    }
    dd_lazy(ctx)->push_state_changed[is_compute] = false;
@@ -741,12 +756,18 @@ zink_batch_descriptor_init_lazy(struct zink_screen *screen, struct zink_batch_st
 }
 
 static void
-init_push_template_entry(VkDescriptorUpdateTemplateEntry *entry, unsigned i)
+init_push_template_entry(struct zink_screen *screen, VkDescriptorUpdateTemplateEntry *entry, unsigned i)
 {
    entry->dstBinding = tgsi_processor_to_shader_stage(i);
    entry->descriptorCount = 1;
-   entry->descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-   entry->offset = offsetof(struct zink_context, di.ubos[i][0]);
+   if (zink_descriptor_push_set_is_dynamic(screen)) {
+      /* the real buffer offset is passed as a dynamic offset at bind time */
+      entry->descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+      entry->offset = offsetof(struct zink_context, di.push_ubos[i]);
+   } else {
+      entry->descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+      entry->offset = offsetof(struct zink_context, di.ubos[i][0]);
+   }
    entry->stride = sizeof(VkDescriptorBufferInfo);
 }
 
@@ -763,9 +784,9 @@ zink_descriptors_init_lazy(struct zink_context *ctx)
    else if (screen->info.have_KHR_descriptor_update_template) {
       for (unsigned i = 0; i < ZINK_SHADER_COUNT; i++) {
          VkDescriptorUpdateTemplateEntry *entry = &dd_lazy(ctx)->push_entries[i];
-         init_push_template_entry(entry, i);
+         init_push_template_entry(screen, entry, i);
       }
-      init_push_template_entry(&dd_lazy(ctx)->compute_push_entry, PIPE_SHADER_COMPUTE);
+      init_push_template_entry(screen, &dd_lazy(ctx)->compute_push_entry, PIPE_SHADER_COMPUTE);
       VkDescriptorUpdateTemplateEntry *entry = &dd_lazy(ctx)->push_entries[ZINK_SHADER_COUNT]; //fbfetch
       entry->dstBinding = ZINK_FBFETCH_BINDING;
       entry->descriptorCount = 1;
@@ -74,6 +74,9 @@ EXTENSIONS = [
     Extension("VK_KHR_external_memory_win32"),
     Extension("VK_KHR_external_semaphore_win32"),
     Extension("VK_EXT_external_memory_dma_buf"),
+    Extension("VK_EXT_external_memory_host",
+              alias="ext_host_mem",
+              properties=True),
     Extension("VK_EXT_queue_family_foreign"),
     Extension("VK_KHR_swapchain_mutable_format"),
     Extension("VK_EXT_provoking_vertex",
@@ -206,6 +209,7 @@ EXTENSIONS = [
         features=True,
         conditions=["$feats.scalarBlockLayout"]),
     Extension("VK_KHR_swapchain"),
+    Extension("VK_KHR_incremental_present"),
     Extension("VK_KHR_shader_float16_int8",
               alias="shader_float16_int8",
               features=True),
@@ -217,6 +221,12 @@ EXTENSIONS = [
     Extension("VK_EXT_primitives_generated_query",
               alias="primgen",
 	             features=True),
+    Extension("VK_KHR_pipeline_library"),
+    Extension("VK_EXT_graphics_pipeline_library",
+        alias="gpl",
+        features=True,
+        properties=True,
+        conditions=["$feats.graphicsPipelineLibrary"]),
     Extension("VK_KHR_push_descriptor",
         alias="push",
         properties=True),
@@ -113,6 +113,7 @@ zink_bind_vertex_buffers(struct zink_batch *batch, struct zink_context *ctx)
    VkDeviceSize buffer_strides[PIPE_MAX_ATTRIBS];
    struct zink_vertex_elements_state *elems = ctx->element_state;
    struct zink_screen *screen = zink_screen(ctx->base.screen);
+   bool vertex_input_changed = ctx->vertex_input != &elems->hw_state;
 
    if (!elems->hw_state.num_bindings)
       return;
@@ -126,14 +127,18 @@ zink_bind_vertex_buffers(struct zink_batch *batch, struct zink_context *ctx)
          buffers[i] = res->obj->buffer;
          buffer_offsets[i] = vb->buffer_offset;
          buffer_strides[i] = vb->stride;
-         if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT)
+         if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT) {
+            vertex_input_changed |= elems->hw_state.dynbindings[i].stride != vb->stride;
             elems->hw_state.dynbindings[i].stride = vb->stride;
+         }
       } else {
          buffers[i] = zink_resource(ctx->dummy_vertex_buffer)->obj->buffer;
          buffer_offsets[i] = 0;
          buffer_strides[i] = 0;
-         if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT)
+         if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT) {
+            vertex_input_changed |= elems->hw_state.dynbindings[i].stride != 0;
             elems->hw_state.dynbindings[i].stride = 0;
+         }
       }
    }
 
@@ -146,10 +151,16 @@ zink_bind_vertex_buffers(struct zink_batch *batch, struct zink_context *ctx)
                              elems->hw_state.num_bindings,
                              buffers, buffer_offsets);
 
-   if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT)
+   /* the attribute descriptions are baked into the CSO, so only the strides
+    * can change underneath the same elements: rebinding buffers alone
+    * doesn't need a new vertex input
+    */
+   if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT && vertex_input_changed) {
       VKCTX(CmdSetVertexInputEXT)(batch->state->cmdbuf,
                                       elems->hw_state.num_bindings, elems->hw_state.dynbindings,
                                       elems->hw_state.num_attribs, elems->hw_state.dynattribs);
+      ctx->vertex_input = &elems->hw_state;
+   }
 
    ctx->vertex_buffers_dirty = false;
 }
@@ -167,6 +178,7 @@ zink_bind_vertex_state(struct zink_batch *batch, struct zink_context *ctx,
    struct zink_resource *res = zink_resource(vstate->input.vbuffer.buffer.resource);
    zink_batch_resource_usage_set(&ctx->batch, res, false);
    VkDeviceSize offset = vstate->input.vbuffer.buffer_offset;
+   ctx->vertex_input = NULL;
    VKCTX(CmdBindVertexBuffers)(batch->state->cmdbuf, 0,
                                hw_state->num_bindings,
                                &res->obj->buffer, &offset);
@@ -196,6 +208,8 @@ update_gfx_program(struct zink_context *ctx)
       struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(ht, hash, ctx->gfx_stages);
       if (entry) {
          prog = (struct zink_gfx_program*)entry->data;
+         /* programs created at link time may still be compiling their default variants */
+         util_queue_fence_wait(&prog->precompile_fence);
          u_foreach_bit(stage, prog->stages_present & ~ctx->dirty_shader_stages)
             ctx->gfx_pipeline_state.modules[stage] = prog->modules[stage]->shader;
          /* ensure variants are always updated if keys have changed since last use */
@@ -221,6 +235,8 @@ update_gfx_program(struct zink_context *ctx)
       ctx->gfx_pipeline_state.final_hash ^= ctx->curr_program->last_variant_hash;
    }
    ctx->dirty_shader_stages &= ~bits;
+   ctx->dirty_shader_stages |= ctx->inline_pending_stages;
+   ctx->inline_pending_stages = 0;
 }
 
 ALWAYS_INLINE static void
@@ -473,6 +489,9 @@ zink_draw(struct pipe_context *pctx,
       assert(index_size != 1 || screen->info.have_EXT_index_type_uint8);
    }
 
+   /* everything up to the draw's own commands is barriers */
+   zink_barriers_begin(ctx);
+
    bool have_streamout = !!ctx->num_so_targets;
    if (have_streamout) {
       zink_emit_xfb_counter_barrier(ctx);
@@ -507,8 +526,11 @@ zink_draw(struct pipe_context *pctx,
                                    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
       res->obj->unordered_read = false;
    }
+   zink_barriers_end(ctx);
 
-   zink_query_update_gs_states(ctx, dinfo->was_line_loop);
+   /* only emulated primgen and line loop vertex queries track per-draw state */
+   if (unlikely(!list_is_empty(&ctx->primitives_generated_queries) || ctx->vertices_query))
+      zink_query_update_gs_states(ctx, dinfo->was_line_loop);
 
    if (unlikely(zink_debug & ZINK_DEBUG_SYNC)) {
       zink_batch_no_rp(ctx);
@@ -738,7 +760,13 @@ zink_draw(struct pipe_context *pctx,
    if (DRAW_STATE)
       zink_bind_vertex_state(batch, ctx, vstate, partial_velem_mask);
    else if (BATCH_CHANGED || ctx->vertex_buffers_dirty) {
-      if (DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT || ctx->gfx_pipeline_state.uses_dynamic_stride)
+      if (BATCH_CHANGED)
+         ctx->vertex_input = NULL;
+      /* strides are only ever dynamic with extended dynamic state, so the stride check is
+       * resolved at compile time for both the no-dynamic-state and vertex input variants
+       */
+      if (DYNAMIC_STATE == ZINK_NO_DYNAMIC_STATE || DYNAMIC_STATE == ZINK_DYNAMIC_VERTEX_INPUT ||
+          ctx->gfx_pipeline_state.uses_dynamic_stride)
          zink_bind_vertex_buffers<DYNAMIC_STATE>(batch, ctx);
       else
          zink_bind_vertex_buffers<ZINK_NO_DYNAMIC_STATE>(batch, ctx);
@@ -931,6 +959,7 @@ zink_launch_grid(struct pipe_context *pctx, const struct pipe_grid_info *info)
    if (ctx->render_condition_active)
       zink_start_conditional_render(ctx);
 
+   zink_barriers_begin(ctx);
    if (info->indirect) {
       /*
          VK_ACCESS_INDIRECT_COMMAND_READ_BIT specifies read access to indirect command data read as
@@ -943,6 +972,7 @@ zink_launch_grid(struct pipe_context *pctx, const struct pipe_grid_info *info)
    }
 
    update_barriers(ctx, true, NULL, info->indirect, NULL);
+   zink_barriers_end(ctx);
    if (ctx->memory_barrier)
       zink_flush_memory_barrier(ctx, true);
 
@@ -964,7 +994,11 @@ zink_launch_grid(struct pipe_context *pctx, const struct pipe_grid_info *info)
    if (ctx->di.any_bindless_dirty && ctx->curr_compute->base.dd->bindless)
       zink_descriptors_update_bindless(ctx);
 
-   zink_program_update_compute_pipeline_state(ctx, ctx->curr_compute, info->block);
+   uint32_t block[3] = {info->block[0], info->block[1], info->block[2]};
+   uint32_t grid[3] = {info->grid[0], info->grid[1], info->grid[2]};
+   if (ctx->curr_compute->shader->retile_factor && !info->indirect)
+      zink_program_retile_compute(screen, ctx->curr_compute, block, grid);
+   zink_program_update_compute_pipeline_state(ctx, ctx->curr_compute, block);
    VkPipeline prev_pipeline = ctx->compute_pipeline_state.pipeline;
 
    if (BATCH_CHANGED) {
@@ -972,9 +1006,9 @@ zink_launch_grid(struct pipe_context *pctx, const struct pipe_grid_info *info)
       zink_batch_reference_program(&ctx->batch, &ctx->curr_compute->base);
    }
    if (ctx->dirty_shader_stages & BITFIELD_BIT(PIPE_SHADER_COMPUTE)) {
-      /* update inlinable constants */
-      zink_update_compute_program(ctx);
+      /* update inlinable constants, this may leave the program dirty */
       ctx->dirty_shader_stages &= ~BITFIELD_BIT(PIPE_SHADER_COMPUTE);
+      zink_update_compute_program(ctx);
    }
 
    VkPipeline pipeline = zink_get_compute_pipeline(screen, ctx->curr_compute,
@@ -998,7 +1032,7 @@ zink_launch_grid(struct pipe_context *pctx, const struct pipe_grid_info *info)
       VKCTX(CmdDispatchIndirect)(batch->state->cmdbuf, zink_resource(info->indirect)->obj->buffer, info->indirect_offset);
       zink_batch_reference_resource_rw(batch, zink_resource(info->indirect), false);
    } else
-      VKCTX(CmdDispatch)(batch->state->cmdbuf, info->grid[0], info->grid[1], info->grid[2]);
+      VKCTX(CmdDispatch)(batch->state->cmdbuf, grid[0], grid[1], grid[2]);
    batch->has_work = true;
    batch->last_was_compute = true;
    /* flush if there's >100k computes */
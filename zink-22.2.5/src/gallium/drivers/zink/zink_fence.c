@@ -29,6 +29,8 @@
 #include "zink_screen.h"
 
 #include "util/os_file.h"
+#include "util/perf/cpu_trace.h"
+#include "util/perf/u_stall.h"
 #include "util/set.h"
 #include "util/u_memory.h"
 
@@ -130,7 +132,12 @@ fence_wait(struct zink_screen *screen, struct zink_fence *fence, uint64_t timeou
    assert(fence->batch_id);
    assert(fence->submitted);
 
+   MESA_TRACE_FUNC();
+
+   U_STALL_SITE(wait_site, "zink fence finish");
+   bool stall = timeout_ns && u_stall_begin(&wait_site, "timeline semaphore");
    bool success = zink_screen_timeline_wait(screen, fence->batch_id, timeout_ns);
+   u_stall_end(stall);
 
    if (success) {
       p_atomic_set(&fence->completed, true);
@@ -220,6 +220,22 @@ zink_update_framebuffer_state(struct zink_context *ctx)
    ctx->framebuffer = fb;
 }
 
+void
+zink_invalidate_framebuffer(struct zink_context *ctx)
+{
+   /* the framebuffer object is only needed to begin a real renderpass:
+    * with dynamic rendering, defer the lookup to setup_framebuffer() so
+    * that fb switches which never hit the renderpass fallback don't hash
+    * the attachment infos at all
+    */
+   if (zink_screen(ctx->base.screen)->info.have_KHR_dynamic_rendering) {
+      ctx->framebuffer = NULL;
+      ctx->fb_changed = true;
+   } else {
+      zink_update_framebuffer_state(ctx);
+   }
+}
+
 /* same as u_framebuffer_get_num_layers, but clamp to lowest layer count */
 unsigned
 zink_framebuffer_get_num_layers(const struct pipe_framebuffer_state *fb)
@@ -87,6 +87,9 @@ zink_get_framebuffer(struct zink_context *ctx);
 
 void
 zink_update_framebuffer_state(struct zink_context *ctx);
+
+void
+zink_invalidate_framebuffer(struct zink_context *ctx);
 unsigned
 zink_framebuffer_get_num_layers(const struct pipe_framebuffer_state *fb);
 #endif
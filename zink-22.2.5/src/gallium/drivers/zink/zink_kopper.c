@@ -23,6 +23,8 @@
  */
 
 
+#include "util/perf/u_stall.h"
+
 #include "zink_context.h"
 #include "zink_screen.h"
 #include "zink_resource.h"
@@ -141,14 +143,16 @@ destroy_swapchain(struct zink_screen *screen, struct kopper_swapchain *cswap)
       VKSCR(DestroySemaphore)(screen->dev, cswap->images[i].acquire, NULL);
    }
    free(cswap->images);
-   hash_table_foreach(cswap->presents, he) {
-      struct util_dynarray *arr = he->data;
-      while (util_dynarray_contains(arr, VkSemaphore))
-         VKSCR(DestroySemaphore)(screen->dev, util_dynarray_pop(arr, VkSemaphore), NULL);
-      util_dynarray_fini(arr);
-      free(arr);
-   }
-   _mesa_hash_table_destroy(cswap->presents, NULL);
+   if (cswap->presents) {
+      hash_table_foreach(cswap->presents, he) {
+         struct util_dynarray *arr = he->data;
+         while (util_dynarray_contains(arr, VkSemaphore))
+            VKSCR(DestroySemaphore)(screen->dev, util_dynarray_pop(arr, VkSemaphore), NULL);
+         util_dynarray_fini(arr);
+         free(arr);
+      }
+      _mesa_hash_table_destroy(cswap->presents, NULL);
+   }
    VKSCR(DestroySwapchainKHR)(screen->dev, cswap->swapchain, NULL);
    free(cswap);
 }
@@ -206,6 +210,11 @@ zink_kopper_deinit_displaytarget(struct zink_screen *screen, struct kopper_displ
    cdt = he->data;
    _mesa_hash_table_remove(&screen->dts, he);
    simple_mtx_unlock(&screen->dt_lock);
+   /* a replacement may still be in the works on the flush queue */
+   if (util_queue_is_initialized(&screen->flush_queue))
+      util_queue_fence_wait(&cdt->present_fence);
+   destroy_swapchain(screen, cdt->pending_swapchain);
+   cdt->pending_swapchain = NULL;
    destroy_swapchain(screen, cdt->swapchain);
    prune_old_swapchains(screen, cdt, true);
    VKSCR(DestroySurfaceKHR)(screen->instance, cdt->surface, NULL);
@@ -214,8 +223,13 @@ zink_kopper_deinit_displaytarget(struct zink_screen *screen, struct kopper_displ
    util_queue_fence_destroy(&cdt->present_fence);
 }
 
+/* async is set when called from the flush queue, which must not wait for its
+ * own jobs.
+ */
 static struct kopper_swapchain *
-kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt, unsigned w, unsigned h, VkResult *result)
+kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt,
+                       const VkSurfaceCapabilitiesKHR *caps, unsigned w, unsigned h,
+                       bool async, VkResult *result)
 {
    VkResult error = VK_SUCCESS;
    struct kopper_swapchain *cswap = CALLOC_STRUCT(kopper_swapchain);
@@ -223,7 +237,7 @@ kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *
       return NULL;
    cswap->last_present_prune = 1;
 
-   bool has_alpha = cdt->info.has_alpha && (cdt->caps.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR);
+   bool has_alpha = cdt->info.has_alpha && (caps->supportedCompositeAlpha & VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR);
    if (cdt->swapchain) {
       cswap->scci = cdt->swapchain->scci;
       cswap->scci.oldSwapchain = cdt->swapchain->swapchain;
@@ -247,8 +261,8 @@ kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *
       cswap->scci.clipped = VK_TRUE;
    }
    cswap->scci.presentMode = cdt->present_mode;
-   cswap->scci.minImageCount = cdt->caps.minImageCount;
-   cswap->scci.preTransform = cdt->caps.currentTransform;
+   cswap->scci.minImageCount = caps->minImageCount;
+   cswap->scci.preTransform = caps->currentTransform;
    if (cdt->formats[1])
       cswap->scci.pNext = &cdt->format_list;
 
@@ -261,8 +275,8 @@ kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *
        * Due to above restrictions, it is only possible to create a new swapchain on this
        * platform with imageExtent being equal to the current size of the window.
        */
-      cswap->scci.imageExtent.width = cdt->caps.currentExtent.width;
-      cswap->scci.imageExtent.height = cdt->caps.currentExtent.height;
+      cswap->scci.imageExtent.width = caps->currentExtent.width;
+      cswap->scci.imageExtent.height = caps->currentExtent.height;
       break;
    case KOPPER_WAYLAND:
       /* On Wayland, currentExtent is the special value (0xFFFFFFFF, 0xFFFFFFFF), indicating that the
@@ -279,7 +293,7 @@ kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *
 
    error = VKSCR(CreateSwapchainKHR)(screen->dev, &cswap->scci, NULL,
                                 &cswap->swapchain);
-   if (error == VK_ERROR_NATIVE_WINDOW_IN_USE_KHR) {
+   if (error == VK_ERROR_NATIVE_WINDOW_IN_USE_KHR && !async) {
       if (util_queue_is_initialized(&screen->flush_queue))
          util_queue_finish(&screen->flush_queue);
       VkResult result = VKSCR(QueueWaitIdle)(screen->queue);
@@ -295,7 +309,7 @@ kopper_CreateSwapchain(struct zink_screen *screen, struct kopper_displaytarget *
        *result = error;
        return NULL;
    }
-   cswap->max_acquires = cswap->scci.minImageCount - cdt->caps.minImageCount;
+   cswap->max_acquires = cswap->scci.minImageCount - caps->minImageCount;
    cswap->last_present = UINT32_MAX;
 
    *result = VK_SUCCESS;
@@ -329,23 +343,104 @@ update_caps(struct zink_screen *screen, struct kopper_displaytarget *cdt)
    return error;
 }
 
-static VkResult
-update_swapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt, unsigned w, unsigned h)
+/* retires the current swapchain to the end of the old swapchain list */
+static void
+replace_swapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt, struct kopper_swapchain *cswap)
 {
-   VkResult error = update_caps(screen, cdt);
-   if (error != VK_SUCCESS)
-      return error;
-   struct kopper_swapchain *cswap = kopper_CreateSwapchain(screen, cdt, w, h, &error);
-   if (!cswap)
-      return error;
    prune_old_swapchains(screen, cdt, false);
    struct kopper_swapchain **pswap = &cdt->old_swapchain;
    while (*pswap)
-      *pswap = (*pswap)->next;
+      pswap = &(*pswap)->next;
    *pswap = cdt->swapchain;
    cdt->swapchain = cswap;
+}
+
+/* switch to the swapchain created by the flush queue, if there is one */
+static bool
+adopt_pending_swapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt)
+{
+   if (!p_atomic_read_relaxed(&cdt->pending_swapchain))
+      return false;
 
-   return kopper_GetSwapchainImages(screen, cdt->swapchain);
+   simple_mtx_lock(&cdt->swapchain_lock);
+   struct kopper_swapchain *cswap = cdt->pending_swapchain;
+   if (cswap) {
+      cdt->pending_swapchain = NULL;
+      cdt->caps = cdt->pending_caps;
+      replace_swapchain(screen, cdt, cswap);
+   }
+   simple_mtx_unlock(&cdt->swapchain_lock);
+   return cswap != NULL;
+}
+
+static VkResult
+update_swapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt, unsigned w, unsigned h)
+{
+   /* wait out a replacement being created by the flush queue, the
+    * current swapchain can't be retired twice
+    */
+   simple_mtx_lock(&cdt->swapchain_lock);
+   while (cdt->swapchain_busy) {
+      simple_mtx_unlock(&cdt->swapchain_lock);
+      util_queue_fence_wait(&cdt->present_fence);
+      simple_mtx_lock(&cdt->swapchain_lock);
+   }
+   cdt->swapchain_busy = true;
+   simple_mtx_unlock(&cdt->swapchain_lock);
+
+   adopt_pending_swapchain(screen, cdt);
+
+   VkResult error = update_caps(screen, cdt);
+   struct kopper_swapchain *cswap = NULL;
+   if (error == VK_SUCCESS)
+      cswap = kopper_CreateSwapchain(screen, cdt, &cdt->caps, w, h, false, &error);
+   if (cswap) {
+      error = kopper_GetSwapchainImages(screen, cswap);
+      replace_swapchain(screen, cdt, cswap);
+   }
+
+   simple_mtx_lock(&cdt->swapchain_lock);
+   cdt->swapchain_busy = false;
+   simple_mtx_unlock(&cdt->swapchain_lock);
+
+   return error;
+}
+
+/* called from the flush queue after a suboptimal present: this creates the
+ * replacement without stalling the application thread, which keeps
+ * presenting to the old swapchain until the next acquire picks it up
+ *
+ * returns false if the swapchain has to be recreated synchronously instead
+ */
+static bool
+create_pending_swapchain(struct zink_screen *screen, struct kopper_displaytarget *cdt,
+                         struct kopper_swapchain *swapchain)
+{
+   simple_mtx_lock(&cdt->swapchain_lock);
+   if (cdt->swapchain != swapchain || cdt->pending_swapchain || cdt->swapchain_busy) {
+      simple_mtx_unlock(&cdt->swapchain_lock);
+      return true;
+   }
+   cdt->swapchain_busy = true;
+   simple_mtx_unlock(&cdt->swapchain_lock);
+
+   VkResult error = VKSCR(GetPhysicalDeviceSurfaceCapabilitiesKHR)(screen->pdev, cdt->surface, &cdt->pending_caps);
+   struct kopper_swapchain *cswap = NULL;
+   if (error == VK_SUCCESS)
+      cswap = kopper_CreateSwapchain(screen, cdt, &cdt->pending_caps,
+                                     swapchain->scci.imageExtent.width,
+                                     swapchain->scci.imageExtent.height,
+                                     true, &error);
+   if (cswap && kopper_GetSwapchainImages(screen, cswap) != VK_SUCCESS) {
+      destroy_swapchain(screen, cswap);
+      cswap = NULL;
+   }
+
+   simple_mtx_lock(&cdt->swapchain_lock);
+   cdt->pending_swapchain = cswap;
+   cdt->swapchain_busy = false;
+   simple_mtx_unlock(&cdt->swapchain_lock);
+   return cswap != NULL;
 }
 
 struct kopper_displaytarget *
@@ -395,6 +490,7 @@ zink_kopper_displaytarget_create(struct zink_screen *screen, unsigned tex_usage,
    cdt->loader_private = (void*)loader_private;
    cdt->info = *info;
    util_queue_fence_init(&cdt->present_fence);
+   simple_mtx_init(&cdt->swapchain_lock, mtx_plain);
 
    enum pipe_format srgb = PIPE_FORMAT_NONE;
    if (screen->info.have_KHR_swapchain_mutable_format) {
@@ -456,6 +552,7 @@ zink_kopper_displaytarget_destroy(struct zink_screen *screen, struct kopper_disp
    if (!p_atomic_dec_zero(&cdt->refcount))
       return;
    zink_kopper_deinit_displaytarget(screen, cdt);
+   simple_mtx_destroy(&cdt->swapchain_lock);
    FREE(cdt);
 }
 
@@ -477,6 +574,14 @@ kopper_acquire(struct zink_screen *screen, struct zink_resource *res, uint64_t t
    VkSemaphore acquire = VK_NULL_HANDLE;
 
    while (true) {
+      if (adopt_pending_swapchain(screen, cdt)) {
+         res->layout = VK_IMAGE_LAYOUT_UNDEFINED;
+         res->obj->access = 0;
+         res->obj->access_stage = 0;
+         /* the replacement was made for the current window size */
+         if (cdt->type == KOPPER_X11)
+            res->obj->new_dt = false;
+      }
       if (res->obj->new_dt) {
          VkResult error = update_swapchain(screen, cdt, res->base.b.width0, res->base.b.height0);
          zink_screen_handle_vkresult(screen, error);
@@ -621,10 +726,15 @@ zink_kopper_present(struct zink_screen *screen, struct zink_resource *res)
 
 struct kopper_present_info {
    VkPresentInfoKHR info;
+   VkPresentRegionsKHR rinfo;
+   VkPresentRegionKHR region;
+   VkRectLayerKHR rect;
    uint32_t image;
    struct kopper_swapchain *swapchain;
    struct zink_resource *res;
    VkSemaphore sem;
+   /* acquire semaphore waited on by a batchless submit, if any */
+   VkSemaphore acquire;
    bool indefinite_acquire;
 };
 
@@ -673,7 +783,8 @@ kopper_present(void *data, void *gdata, int thread_idx)
    swapchain->last_present = cpi->image;
    if (cpi->indefinite_acquire)
       p_atomic_dec(&swapchain->num_acquires);
-   if (error2 == VK_SUBOPTIMAL_KHR && cdt->swapchain == swapchain)
+   if (error2 == VK_SUBOPTIMAL_KHR && cdt->swapchain == swapchain &&
+       (thread_idx == -1 || !create_pending_swapchain(screen, cdt, swapchain)))
       cpi->res->obj->new_dt = true;
 
    /* it's illegal to destroy semaphores if they're in use by a cmdbuf.
@@ -712,14 +823,17 @@ kopper_present(void *data, void *gdata, int thread_idx)
       _mesa_hash_table_insert(swapchain->presents, (void*)(uintptr_t)next, arr);
    }
    util_dynarray_append(arr, VkSemaphore, cpi->sem);
+   if (cpi->acquire)
+      util_dynarray_append(arr, VkSemaphore, cpi->acquire);
 out:
    if (thread_idx != -1)
       p_atomic_dec(&swapchain->async_presents);
    free(cpi);
 }
 
-void
-zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res)
+static void
+kopper_present_queue(struct zink_screen *screen, struct zink_resource *res, const struct pipe_box *damage,
+                     VkSemaphore acquire)
 {
    assert(res->obj->dt);
    struct kopper_displaytarget *cdt = res->obj->dt;
@@ -727,6 +841,7 @@ zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res)
    assert(res->obj->present);
    struct kopper_present_info *cpi = malloc(sizeof(struct kopper_present_info));
    cpi->sem = res->obj->present;
+   cpi->acquire = acquire;
    cpi->res = res;
    cpi->swapchain = cdt->swapchain;
    cpi->indefinite_acquire = res->obj->indefinite_acquire;
@@ -739,6 +854,24 @@ zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res)
    cpi->info.pSwapchains = &cdt->swapchain->swapchain;
    cpi->info.pImageIndices = &cpi->image;
    cpi->info.pResults = NULL;
+   /* present regions are only a hint: the rest of the image still has to be valid */
+   if (damage && screen->info.have_KHR_incremental_present) {
+      const VkExtent2D *extent = &cdt->swapchain->scci.imageExtent;
+      int x = CLAMP(damage->x, 0, (int)extent->width);
+      int y = CLAMP(damage->y, 0, (int)extent->height);
+      cpi->rect.offset.x = x;
+      cpi->rect.offset.y = y;
+      cpi->rect.extent.width = CLAMP(damage->x + damage->width, x, (int)extent->width) - x;
+      cpi->rect.extent.height = CLAMP(damage->y + damage->height, y, (int)extent->height) - y;
+      cpi->rect.layer = 0;
+      cpi->region.rectangleCount = 1;
+      cpi->region.pRectangles = &cpi->rect;
+      cpi->rinfo.sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR;
+      cpi->rinfo.pNext = NULL;
+      cpi->rinfo.swapchainCount = 1;
+      cpi->rinfo.pRegions = &cpi->region;
+      cpi->info.pNext = &cpi->rinfo;
+   }
    res->obj->present = VK_NULL_HANDLE;
    /* Ex GLX_EXT_buffer_age:
     *
@@ -768,6 +901,12 @@ zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res)
    res->obj->dt_idx = UINT32_MAX;
 }
 
+void
+zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res, const struct pipe_box *damage)
+{
+   kopper_present_queue(screen, res, damage, VK_NULL_HANDLE);
+}
+
 bool
 zink_kopper_acquire_readback(struct zink_context *ctx, struct zink_resource *res)
 {
@@ -817,18 +956,27 @@ zink_kopper_present_readback(struct zink_context *ctx, struct zink_resource *res
    si.pWaitDstStageMask = &mask;
    VkSemaphore acquire = zink_kopper_acquire_submit(screen, res);
    VkSemaphore present = res->obj->present ? res->obj->present : zink_kopper_present(screen, res);
-   if (screen->threaded)
-      util_queue_finish(&screen->flush_queue);
+   /* only the flush carrying the layout transition has to reach the queue first */
+   if (screen->threaded && ctx->last_fence) {
+      U_STALL_SITE(wait_site, "zink present readback");
+      bool stall = u_stall_begin(&wait_site, "submit thread");
+      util_queue_fence_wait(&zink_batch_state(ctx->last_fence)->flush_completed);
+      u_stall_end(stall);
+   }
    si.waitSemaphoreCount = !!acquire;
    si.pWaitSemaphores = &acquire;
    si.pSignalSemaphores = &present;
+   simple_mtx_lock(&screen->queue_lock);
    VkResult error = VKSCR(QueueSubmit)(screen->queue, 1, &si, VK_NULL_HANDLE);
+   simple_mtx_unlock(&screen->queue_lock);
    if (!zink_screen_handle_vkresult(screen, error))
       return false;
 
-   zink_kopper_present_queue(screen, res);
-   error = VKSCR(QueueWaitIdle)(screen->queue);
-   return zink_screen_handle_vkresult(screen, error);
+   /* rather than idling the queue until the acquire semaphore is done with,
+    * let it be destroyed along with the present semaphore
+    */
+   kopper_present_queue(screen, res, NULL, acquire);
+   return true;
 }
 
 bool
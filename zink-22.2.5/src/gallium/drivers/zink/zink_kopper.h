@@ -28,6 +28,7 @@
 #define ZINK_KOPPER_H
 
 #include "kopper_interface.h"
+#include "util/simple_mtx.h"
 
 struct kopper_swapchain_image {
    bool init;
@@ -73,6 +74,16 @@ struct kopper_displaytarget
    struct kopper_swapchain *swapchain;
    struct kopper_swapchain *old_swapchain;
 
+   /* A swapchain that returned VK_SUBOPTIMAL_KHR from a threaded present is
+    * replaced from the flush queue while the old one keeps being used, the
+    * replacement is picked up by the next acquire.  Whoever sets
+    * swapchain_busy owns the right to create a swapchain from cdt->swapchain.
+    */
+   simple_mtx_t swapchain_lock;
+   struct kopper_swapchain *pending_swapchain;
+   VkSurfaceCapabilitiesKHR pending_caps;
+   bool swapchain_busy;
+
    struct kopper_loader_info info;
    struct util_queue_fence present_fence;
 
@@ -83,6 +94,7 @@ struct kopper_displaytarget
    VkPresentModeKHR present_mode;
 };
 
+struct pipe_box;
 struct zink_context;
 struct zink_screen;
 struct zink_resource;
@@ -121,7 +133,7 @@ zink_kopper_acquire_submit(struct zink_screen *screen, struct zink_resource *res
 VkSemaphore
 zink_kopper_present(struct zink_screen *screen, struct zink_resource *res); 
 void
-zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res);
+zink_kopper_present_queue(struct zink_screen *screen, struct zink_resource *res, const struct pipe_box *damage);
 bool
 zink_kopper_acquire_readback(struct zink_context *ctx, struct zink_resource *res);
 bool
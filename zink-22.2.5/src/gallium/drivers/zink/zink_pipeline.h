@@ -96,10 +96,38 @@ struct zink_gfx_pipeline_state {
    VkFormat rendering_formats[PIPE_MAX_COLOR_BUFS];
    VkPipelineRenderingCreateInfo rendering_info;
    VkPipeline pipeline;
+   void *optimal_pending; //GPL: cache entry whose optimized pipeline is still being built
    unsigned idx : 8;
    enum pipe_prim_type gfx_prim_mode; //pending mode
 };
 
+/* graphics pipeline library keys: the state which gets baked into each partial pipeline */
+struct zink_gfx_library_key {
+   uint32_t hw_rast_state; //zink_rasterizer_hw_state
+   VkShaderModule modules[PIPE_SHADER_TYPES - 1];
+   VkPipeline pipeline;
+};
+
+struct zink_gfx_input_key {
+   uint8_t idx; //topology class
+   bool uses_dynamic_stride;
+   bool dynamic_vertex_input;
+   uint32_t element_hash; //unused with dynamic vertex input
+   uint32_t vertex_buffers_enabled_mask; //only without dynamic stride
+   uint32_t vertex_strides[PIPE_MAX_ATTRIBS];
+   VkPipeline pipeline;
+};
+
+struct zink_gfx_output_key {
+   uint32_t rast_samples;
+   uint32_t void_alpha_attachments;
+   VkSampleMask sample_mask;
+   unsigned rp_state;
+   uint32_t blend_id;
+   bool sample_locations_enabled;
+   VkPipeline pipeline;
+};
+
 struct zink_compute_pipeline_state {
    /* Pre-hashed value for table lookup, invalid when zero.
     * Members after this point are not included in pipeline state hash key */
@@ -127,4 +155,19 @@ zink_create_gfx_pipeline(struct zink_screen *screen,
 
 VkPipeline
 zink_create_compute_pipeline(struct zink_screen *screen, struct zink_compute_program *comp, struct zink_compute_pipeline_state *state);
+
+VkPipeline
+zink_create_gfx_pipeline_input(struct zink_screen *screen,
+                               struct zink_gfx_pipeline_state *state,
+                               const uint8_t *binding_map,
+                               VkPrimitiveTopology primitive_topology);
+VkPipeline
+zink_create_gfx_pipeline_library(struct zink_screen *screen, struct zink_gfx_program *prog,
+                                 struct zink_gfx_pipeline_state *state);
+VkPipeline
+zink_create_gfx_pipeline_output(struct zink_screen *screen, struct zink_gfx_pipeline_state *state);
+VkPipeline
+zink_create_gfx_pipeline_combined(struct zink_screen *screen, struct zink_gfx_program *prog,
+                                  VkPipeline input, VkPipeline library, VkPipeline output,
+                                  bool optimized);
 #endif
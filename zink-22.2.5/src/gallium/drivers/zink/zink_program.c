@@ -34,6 +34,7 @@
 #include "zink_inlines.h"
 
 #include "util/hash_table.h"
+#include "util/os_time.h"
 #include "util/set.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
@@ -47,6 +48,13 @@
 struct gfx_pipeline_cache_entry {
    struct zink_gfx_pipeline_state state;
    VkPipeline pipeline;
+   /* GPL only */
+   struct util_queue_fence fence;
+   struct zink_gfx_input_key *ikey;
+   struct zink_gfx_library_key *gkey;
+   struct zink_gfx_output_key *okey;
+   struct zink_gfx_program *prog;
+   VkPipeline unoptimized_pipeline;
 };
 
 struct compute_pipeline_cache_entry {
@@ -88,6 +96,46 @@ shader_module_hash(const struct zink_shader_module *zm)
    return _mesa_hash_data(zm->key, key_size);
 }
 
+/* Uniform values that change from one draw to the next would each spawn a
+ * variant that is used once, so only values that stay the same across
+ * ZINK_INLINE_STABLE_USES updates are worth compiling a variant for.
+ * Until then, a variant that already exists for them is still used.
+ */
+static bool
+inline_values_stable(uint32_t *hash, uint8_t *uses, const uint32_t *values, unsigned num_values)
+{
+   uint32_t h = _mesa_hash_data(values, num_values * sizeof(uint32_t));
+   if (h != *hash) {
+      *hash = h;
+      *uses = 0;
+   }
+   if (*uses < ZINK_INLINE_STABLE_USES)
+      (*uses)++;
+   return *uses == ZINK_INLINE_STABLE_USES;
+}
+
+/* remember a key that took a variant compile, for load_variant_manifest() */
+static void
+record_variant(struct zink_gfx_program *prog, enum pipe_shader_type pstage,
+               const struct zink_shader_key *key)
+{
+   struct zink_variant_record rec;
+   memset(&rec, 0, sizeof(rec));
+   rec.stage = pstage;
+   rec.key_size = key->size;
+   rec.nonseamless_cube_mask = key->base.nonseamless_cube_mask;
+   memcpy(rec.key, &key->key, key->size);
+
+   if (prog->num_used_variants == ZINK_VARIANT_MANIFEST_MAX)
+      return;
+   for (unsigned i = 0; i < prog->num_used_variants; i++) {
+      if (!memcmp(&prog->used_variants[i], &rec, sizeof(rec)))
+         return;
+   }
+   prog->used_variants[prog->num_used_variants++] = rec;
+   prog->used_variants_dirty = true;
+}
+
 static struct zink_shader_module *
 get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen,
                             struct zink_shader *zs, struct zink_gfx_program *prog,
@@ -104,17 +152,25 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
       /* non-generated tcs won't use the shader key */
       ignore_key_size = true;
    }
+   bool inline_pending = false;
    if (ctx && zs->nir->info.num_inlinable_uniforms &&
        ctx->inlinable_uniforms_valid_mask & BITFIELD64_BIT(pstage)) {
-      if (zs->can_inline && (screen->is_cpu || prog->inlined_variant_count[pstage] < ZINK_MAX_INLINED_VARIANTS))
+      if (zs->can_inline && (screen->is_cpu || prog->inlined_variant_count[pstage] < ZINK_MAX_INLINED_VARIANTS)) {
          inline_size = zs->nir->info.num_inlinable_uniforms;
-      else
+         key->inline_uniforms = true;
+         inline_pending = !inline_values_stable(&prog->inline_values_hash[pstage],
+                                                &prog->inline_values_uses[pstage],
+                                                key->base.inlined_uniform_values,
+                                                inline_size);
+      } else {
          key->inline_uniforms = false;
+      }
    }
    if (key->base.nonseamless_cube_mask)
       nonseamless_size = sizeof(uint32_t);
 
    struct zink_shader_module *iter, *next;
+lookup:
    LIST_FOR_EACH_ENTRY_SAFE(iter, next, &prog->shader_cache[pstage][!!nonseamless_size][!!inline_size], list) {
       if (!shader_key_matches(iter, ignore_key_size, key, inline_size))
          continue;
@@ -123,6 +179,15 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
       break;
    }
 
+   if (!zm && inline_pending) {
+      /* use the uninlined variant and check the values again next draw */
+      key->inline_uniforms = false;
+      inline_size = 0;
+      inline_pending = false;
+      ctx->inline_pending_stages |= BITFIELD_BIT(pstage);
+      goto lookup;
+   }
+
    if (!zm) {
       zm = malloc(sizeof(struct zink_shader_module) + key->size + nonseamless_size + inline_size * sizeof(uint32_t));
       if (!zm) {
@@ -163,6 +228,9 @@ get_shader_module_for_stage(struct zink_context *ctx, struct zink_screen *screen
       zm->default_variant = !inline_size && list_is_empty(&prog->shader_cache[pstage][0][0]);
       if (inline_size)
          prog->inlined_variant_count[pstage]++;
+      /* inlined values and tcs patch sizes are too volatile to be worth precompiling */
+      else if (ctx && !zm->default_variant && pstage != PIPE_SHADER_TESS_CTRL)
+         record_variant(prog, pstage, key);
    }
    list_add(&zm->list, &prog->shader_cache[pstage][!!nonseamless_size][!!inline_size]);
    return zm;
@@ -279,6 +347,42 @@ equals_gfx_pipeline_state(const void *a, const void *b)
           !memcmp(a, b, offsetof(struct zink_gfx_pipeline_state, hash));
 }
 
+static uint32_t
+hash_gfx_library(const void *key)
+{
+   return _mesa_hash_data(key, offsetof(struct zink_gfx_library_key, pipeline));
+}
+
+static bool
+equals_gfx_library(const void *a, const void *b)
+{
+   return !memcmp(a, b, offsetof(struct zink_gfx_library_key, pipeline));
+}
+
+static uint32_t
+hash_gfx_input(const void *key)
+{
+   return _mesa_hash_data(key, offsetof(struct zink_gfx_input_key, pipeline));
+}
+
+static bool
+equals_gfx_input(const void *a, const void *b)
+{
+   return !memcmp(a, b, offsetof(struct zink_gfx_input_key, pipeline));
+}
+
+static uint32_t
+hash_gfx_output(const void *key)
+{
+   return _mesa_hash_data(key, offsetof(struct zink_gfx_output_key, pipeline));
+}
+
+static bool
+equals_gfx_output(const void *a, const void *b)
+{
+   return !memcmp(a, b, offsetof(struct zink_gfx_output_key, pipeline));
+}
+
 void
 zink_update_gfx_program(struct zink_context *ctx, struct zink_gfx_program *prog)
 {
@@ -295,16 +399,22 @@ update_cs_shader_module(struct zink_context *ctx, struct zink_compute_program *c
    unsigned inline_size = 0, nonseamless_size = 0;
    struct zink_shader_key *key = &ctx->compute_pipeline_state.key;
 
+   bool inline_pending = false;
    if (ctx && zs->nir->info.num_inlinable_uniforms &&
        ctx->inlinable_uniforms_valid_mask & BITFIELD64_BIT(PIPE_SHADER_COMPUTE)) {
-      if (screen->is_cpu || comp->inlined_variant_count < ZINK_MAX_INLINED_VARIANTS)
+      if (screen->is_cpu || comp->inlined_variant_count < ZINK_MAX_INLINED_VARIANTS) {
          inline_size = zs->nir->info.num_inlinable_uniforms;
-      else
+         key->inline_uniforms = true;
+         inline_pending = !inline_values_stable(&comp->inline_values_hash, &comp->inline_values_uses,
+                                                key->base.inlined_uniform_values, inline_size);
+      } else {
          key->inline_uniforms = false;
+      }
    }
    if (key->base.nonseamless_cube_mask)
       nonseamless_size = sizeof(uint32_t);
 
+lookup:
    if (inline_size || nonseamless_size) {
       struct zink_shader_module *iter, *next;
       LIST_FOR_EACH_ENTRY_SAFE(iter, next, &comp->shader_cache[!!nonseamless_size], list) {
@@ -318,6 +428,15 @@ update_cs_shader_module(struct zink_context *ctx, struct zink_compute_program *c
       zm = comp->module;
    }
 
+   if (!zm && inline_pending) {
+      /* use the uninlined variant and check the values again next dispatch */
+      key->inline_uniforms = false;
+      inline_size = 0;
+      inline_pending = false;
+      ctx->dirty_shader_stages |= BITFIELD_BIT(PIPE_SHADER_COMPUTE);
+      goto lookup;
+   }
+
    if (!zm) {
       zm = malloc(sizeof(struct zink_shader_module) + nonseamless_size + inline_size * sizeof(uint32_t));
       if (!zm) {
@@ -350,6 +469,7 @@ update_cs_shader_module(struct zink_context *ctx, struct zink_compute_program *c
    ctx->compute_pipeline_state.final_hash ^= ctx->compute_pipeline_state.module_hash;
    comp->curr = zm;
    ctx->compute_pipeline_state.module_hash = zm->hash;
+   ctx->compute_pipeline_state.module = zm->shader;
    ctx->compute_pipeline_state.final_hash ^= ctx->compute_pipeline_state.module_hash;
    ctx->compute_pipeline_state.module_changed = true;
 }
@@ -438,6 +558,8 @@ zink_create_gfx_program(struct zink_context *ctx,
 
    pipe_reference_init(&prog->base.reference, 1);
    util_queue_fence_init(&prog->base.cache_fence);
+   util_queue_fence_init(&prog->precompile_fence);
+   simple_mtx_init(&prog->base.pipeline_cache_lock, mtx_plain);
 
    for (int i = 0; i < ZINK_SHADER_COUNT; ++i) {
       list_inithead(&prog->shader_cache[i][0][0]);
@@ -472,6 +594,7 @@ zink_create_gfx_program(struct zink_context *ctx,
           i == (prog->last_vertex_stage->nir->info.stage == MESA_SHADER_TESS_EVAL ? 4 : 3))
          break;
    }
+   _mesa_set_init(&prog->libs, prog, hash_gfx_library, equals_gfx_library);
 
    struct mesa_sha1 sctx;
    _mesa_sha1_init(&sctx);
@@ -531,6 +654,25 @@ zink_program_update_compute_pipeline_state(struct zink_context *ctx, struct zink
       ctx->compute_pipeline_state.local_size[2] = 0;
 }
 
+/* Merges up to retile_factor workgroups of a direct dispatch, along x first
+ * and then y, as far as the grid divides evenly.
+ */
+void
+zink_program_retile_compute(struct zink_screen *screen, const struct zink_compute_program *comp, uint32_t block[3], uint32_t grid[3])
+{
+   const uint32_t *max_size = screen->info.props.limits.maxComputeWorkGroupSize;
+   unsigned factor = comp->shader->retile_factor;
+
+   for (unsigned i = 0; i < 2 && factor > 1; i++) {
+      unsigned f = factor;
+      while (f > 1 && (grid[i] % f || block[i] * f > max_size[i]))
+         f /= 2;
+      block[i] *= f;
+      grid[i] /= f;
+      factor /= f;
+   }
+}
+
 static bool
 equals_compute_pipeline_state(const void *a, const void *b)
 {
@@ -550,6 +692,7 @@ zink_create_compute_program(struct zink_context *ctx, struct zink_shader *shader
 
    pipe_reference_init(&comp->base.reference, 1);
    util_queue_fence_init(&comp->base.cache_fence);
+   simple_mtx_init(&comp->base.pipeline_cache_lock, mtx_plain);
    comp->base.is_compute = true;
 
    comp->curr = comp->module = CALLOC_STRUCT(zink_shader_module);
@@ -685,6 +828,9 @@ zink_destroy_gfx_program(struct zink_context *ctx,
 {
    struct zink_screen *screen = zink_screen(ctx->base.screen);
    util_queue_fence_wait(&prog->base.cache_fence);
+   util_queue_fence_wait(&prog->precompile_fence);
+   /* after the precompile job is done with the manifest */
+   save_variant_manifest(screen, prog);
    if (prog->base.layout)
       VKSCR(DestroyPipelineLayout)(screen->dev, prog->base.layout, NULL);
 
@@ -716,12 +862,20 @@ zink_destroy_gfx_program(struct zink_context *ctx,
       hash_table_foreach(&prog->pipelines[i], entry) {
          struct gfx_pipeline_cache_entry *pc_entry = entry->data;
 
+         util_queue_fence_wait(&pc_entry->fence);
+         util_queue_fence_destroy(&pc_entry->fence);
          VKSCR(DestroyPipeline)(screen->dev, pc_entry->pipeline, NULL);
+         VKSCR(DestroyPipeline)(screen->dev, pc_entry->unoptimized_pipeline, NULL);
          free(pc_entry);
       }
    }
+   set_foreach(&prog->libs, he) {
+      struct zink_gfx_library_key *gkey = (void*)he->key;
+      VKSCR(DestroyPipeline)(screen->dev, gkey->pipeline, NULL);
+   }
    if (prog->base.pipeline_cache)
       VKSCR(DestroyPipelineCache)(screen->dev, prog->base.pipeline_cache, NULL);
+   simple_mtx_destroy(&prog->base.pipeline_cache_lock);
    screen->descriptor_program_deinit(ctx, &prog->base);
 
    ralloc_free(prog);
@@ -752,6 +906,7 @@ zink_destroy_compute_program(struct zink_context *ctx,
    free(comp->module);
    if (comp->base.pipeline_cache)
       VKSCR(DestroyPipelineCache)(screen->dev, comp->base.pipeline_cache, NULL);
+   simple_mtx_destroy(&comp->base.pipeline_cache_lock);
    screen->descriptor_program_deinit(ctx, &comp->base);
 
    ralloc_free(comp);
@@ -803,6 +958,109 @@ check_vertex_strides(struct zink_context *ctx)
    return true;
 }
 
+/* pre-rasterization + fragment shader libraries: one per set of shader variants and baked rasterizer state */
+static struct zink_gfx_library_key *
+find_or_create_lib(struct zink_screen *screen, struct zink_gfx_program *prog, struct zink_gfx_pipeline_state *state)
+{
+   struct zink_gfx_library_key key;
+   memset(&key, 0, sizeof(key));
+   key.hw_rast_state = state->rast_state;
+   for (unsigned i = 0; i < ZINK_SHADER_COUNT; i++)
+      key.modules[i] = prog->modules[i] ? prog->modules[i]->shader : VK_NULL_HANDLE;
+   uint32_t hash = hash_gfx_library(&key);
+   struct set_entry *he = _mesa_set_search_pre_hashed(&prog->libs, hash, &key);
+   if (he)
+      return (struct zink_gfx_library_key *)he->key;
+
+   VkPipeline pipeline = zink_create_gfx_pipeline_library(screen, prog, state);
+   if (pipeline == VK_NULL_HANDLE)
+      return NULL;
+   struct zink_gfx_library_key *gkey = ralloc(prog, struct zink_gfx_library_key);
+   memcpy(gkey, &key, sizeof(key));
+   gkey->pipeline = pipeline;
+   _mesa_set_add_pre_hashed(&prog->libs, hash, gkey);
+   return gkey;
+}
+
+/* vertex input libraries: only the topology class is needed with dynamic vertex input */
+static struct zink_gfx_input_key *
+find_or_create_input(struct zink_context *ctx, unsigned idx, VkPrimitiveTopology vkmode)
+{
+   struct zink_screen *screen = zink_screen(ctx->base.screen);
+   struct zink_gfx_pipeline_state *state = &ctx->gfx_pipeline_state;
+   struct zink_gfx_input_key key;
+   memset(&key, 0, sizeof(key));
+   key.idx = idx;
+   key.uses_dynamic_stride = state->uses_dynamic_stride;
+   key.dynamic_vertex_input = screen->info.have_EXT_vertex_input_dynamic_state &&
+                              state->element_state->num_attribs && state->uses_dynamic_stride;
+   if (!key.dynamic_vertex_input) {
+      key.element_hash = state->element_state->hash;
+      if (!state->uses_dynamic_stride) {
+         key.vertex_buffers_enabled_mask = state->vertex_buffers_enabled_mask;
+         for (unsigned i = 0; i < state->element_state->num_bindings; i++) {
+            const unsigned buffer_id = ctx->element_state->binding_map[i];
+            key.vertex_strides[buffer_id] = state->vertex_strides[buffer_id];
+         }
+      }
+   }
+   uint32_t hash = hash_gfx_input(&key);
+   struct set_entry *he = _mesa_set_search_pre_hashed(&ctx->gfx_inputs, hash, &key);
+   if (he)
+      return (struct zink_gfx_input_key *)he->key;
+
+   VkPipeline pipeline = zink_create_gfx_pipeline_input(screen, state, ctx->element_state->binding_map, vkmode);
+   if (pipeline == VK_NULL_HANDLE)
+      return NULL;
+   struct zink_gfx_input_key *ikey = ralloc(ctx, struct zink_gfx_input_key);
+   memcpy(ikey, &key, sizeof(key));
+   ikey->pipeline = pipeline;
+   _mesa_set_add_pre_hashed(&ctx->gfx_inputs, hash, ikey);
+   return ikey;
+}
+
+/* fragment output libraries: blend, multisample and attachment formats */
+static struct zink_gfx_output_key *
+find_or_create_output(struct zink_context *ctx)
+{
+   struct zink_gfx_pipeline_state *state = &ctx->gfx_pipeline_state;
+   struct zink_gfx_output_key key;
+   memset(&key, 0, sizeof(key));
+   key.rast_samples = state->rast_samples;
+   key.void_alpha_attachments = state->void_alpha_attachments;
+   key.sample_mask = state->sample_mask;
+   key.rp_state = state->rp_state;
+   key.blend_id = state->blend_id;
+   key.sample_locations_enabled = state->sample_locations_enabled;
+   uint32_t hash = hash_gfx_output(&key);
+   struct set_entry *he = _mesa_set_search_pre_hashed(&ctx->gfx_outputs, hash, &key);
+   if (he)
+      return (struct zink_gfx_output_key *)he->key;
+
+   VkPipeline pipeline = zink_create_gfx_pipeline_output(zink_screen(ctx->base.screen), state);
+   if (pipeline == VK_NULL_HANDLE)
+      return NULL;
+   struct zink_gfx_output_key *okey = ralloc(ctx, struct zink_gfx_output_key);
+   memcpy(okey, &key, sizeof(key));
+   okey->pipeline = pipeline;
+   _mesa_set_add_pre_hashed(&ctx->gfx_outputs, hash, okey);
+   return okey;
+}
+
+static void
+optimized_compile_job(void *data, void *gdata, int thread_index)
+{
+   struct gfx_pipeline_cache_entry *pc_entry = data;
+   struct zink_screen *screen = gdata;
+   VkPipeline pipeline = zink_create_gfx_pipeline_combined(screen, pc_entry->prog, pc_entry->ikey->pipeline,
+                                                           pc_entry->gkey->pipeline, pc_entry->okey->pipeline, true);
+   if (pipeline) {
+      /* the fast-linked pipeline may still be in use, so it lives as long as the entry */
+      pc_entry->unoptimized_pipeline = pc_entry->pipeline;
+      pc_entry->pipeline = pipeline;
+   }
+}
+
 VkPipeline
 zink_get_gfx_pipeline(struct zink_context *ctx,
                       struct zink_gfx_program *prog,
@@ -819,8 +1077,17 @@ zink_get_gfx_pipeline(struct zink_context *ctx,
    assert(idx <= ARRAY_SIZE(prog->pipelines));
    if (!state->dirty && !state->modules_changed &&
        (have_EXT_vertex_input_dynamic_state || !ctx->vertex_state_changed) &&
-       idx == state->idx)
+       idx == state->idx) {
+      if (unlikely(state->optimal_pending)) {
+         struct gfx_pipeline_cache_entry *pc_entry = state->optimal_pending;
+         /* switch to the optimized pipeline as soon as it's ready without waiting for a state change */
+         if (util_queue_fence_is_signalled(&pc_entry->fence)) {
+            state->pipeline = pc_entry->pipeline;
+            state->optimal_pending = NULL;
+         }
+      }
       return state->pipeline;
+   }
 
    struct hash_entry *entry = NULL;
 
@@ -861,26 +1128,57 @@ zink_get_gfx_pipeline(struct zink_context *ctx,
 
    if (!entry) {
       util_queue_fence_wait(&prog->base.cache_fence);
-      VkPipeline pipeline = zink_create_gfx_pipeline(screen, prog, state,
-                                                     ctx->element_state->binding_map,
-                                                     vkmode);
-      if (pipeline == VK_NULL_HANDLE)
-         return VK_NULL_HANDLE;
-
-      zink_screen_update_pipeline_cache(screen, &prog->base);
+      ctx->stats[ZINK_STAT_PIPELINE_MISSES]++;
+      int64_t compile_start = os_time_get_nano();
       struct gfx_pipeline_cache_entry *pc_entry = CALLOC_STRUCT(gfx_pipeline_cache_entry);
       if (!pc_entry)
          return VK_NULL_HANDLE;
 
       memcpy(&pc_entry->state, state, sizeof(*state));
+      pc_entry->prog = prog;
+      util_queue_fence_init(&pc_entry->fence);
+
+      VkPipeline pipeline = VK_NULL_HANDLE;
+      bool use_libs = screen->info.have_EXT_graphics_pipeline_library && zink_can_use_pipeline_libs(ctx);
+      if (use_libs) {
+         /* this is the graphics pipeline library path: find/construct all partial pipelines,
+          * then link them without optimizing to avoid stuttering
+          */
+         pc_entry->gkey = find_or_create_lib(screen, prog, state);
+         pc_entry->ikey = find_or_create_input(ctx, idx, vkmode);
+         pc_entry->okey = find_or_create_output(ctx);
+         use_libs = pc_entry->gkey && pc_entry->ikey && pc_entry->okey;
+         if (use_libs)
+            pipeline = zink_create_gfx_pipeline_combined(screen, prog, pc_entry->ikey->pipeline,
+                                                         pc_entry->gkey->pipeline, pc_entry->okey->pipeline,
+                                                         false);
+      }
+      if (pipeline == VK_NULL_HANDLE) {
+         use_libs = false;
+         pipeline = zink_create_gfx_pipeline(screen, prog, state,
+                                             ctx->element_state->binding_map,
+                                             vkmode);
+      }
+      ctx->stats[ZINK_STAT_PIPELINE_COMPILE_TIME] += os_time_get_nano() - compile_start;
+      if (pipeline == VK_NULL_HANDLE) {
+         util_queue_fence_destroy(&pc_entry->fence);
+         free(pc_entry);
+         return VK_NULL_HANDLE;
+      }
+
+      zink_screen_update_pipeline_cache(screen, &prog->base);
       pc_entry->pipeline = pipeline;
 
       entry = _mesa_hash_table_insert_pre_hashed(&prog->pipelines[idx], state->final_hash, pc_entry, pc_entry);
       assert(entry);
+      /* the optimized pipeline replaces the fast-linked one in the entry once it's built */
+      if (use_libs)
+         util_queue_add_job(&screen->optimize_thread, pc_entry, &pc_entry->fence, optimized_compile_job, NULL, 0);
    }
 
    struct gfx_pipeline_cache_entry *cache_entry = entry->data;
    state->pipeline = cache_entry->pipeline;
+   state->optimal_pending = util_queue_fence_is_signalled(&cache_entry->fence) ? NULL : cache_entry;
    state->idx = idx;
    return state->pipeline;
 }
@@ -894,6 +1192,10 @@ zink_get_compute_pipeline(struct zink_screen *screen,
 
    if (!state->dirty && !state->module_changed)
       return state->pipeline;
+   /* the lookup result is kept in state->pipeline: until the next state or
+    * module change, dispatches return it without hashing or searching
+    */
+   state->module_changed = false;
    if (state->dirty) {
       if (state->pipeline) //avoid on first hash
          state->final_hash ^= state->hash;
@@ -907,12 +1209,17 @@ zink_get_compute_pipeline(struct zink_screen *screen,
       util_queue_fence_wait(&comp->base.cache_fence);
       VkPipeline pipeline = zink_create_compute_pipeline(screen, comp, state);
 
-      if (pipeline == VK_NULL_HANDLE)
+      if (pipeline == VK_NULL_HANDLE) {
+         /* retry on the next dispatch */
+         state->module_changed = true;
          return VK_NULL_HANDLE;
+      }
 
       struct compute_pipeline_cache_entry *pc_entry = CALLOC_STRUCT(compute_pipeline_cache_entry);
-      if (!pc_entry)
+      if (!pc_entry) {
+         state->module_changed = true;
          return VK_NULL_HANDLE;
+      }
 
       memcpy(&pc_entry->state, state, sizeof(*state));
       pc_entry->pipeline = pipeline;
@@ -941,7 +1248,8 @@ bind_stage(struct zink_context *ctx, enum pipe_shader_type stage,
          ctx->compute_pipeline_state.module = VK_NULL_HANDLE;
          ctx->compute_pipeline_state.module_hash = 0;
       }
-      if (shader && shader != ctx->compute_stage) {
+      /* the previous module hash was removed above, even when rebinding the same shader */
+      if (shader) {
          struct hash_entry *entry = _mesa_hash_table_search(&ctx->compute_program_cache, shader);
          if (entry) {
             ctx->compute_pipeline_state.dirty = true;
@@ -1144,6 +1452,131 @@ zink_bind_cs_state(struct pipe_context *pctx,
    bind_stage(zink_context(pctx), PIPE_SHADER_COMPUTE, cso);
 }
 
+static void
+variant_manifest_key(struct zink_screen *screen, struct zink_gfx_program *prog, cache_key key)
+{
+   static const char tag[] = "zink_variant_manifest";
+   struct mesa_sha1 sctx;
+   unsigned char sha1[20];
+
+   _mesa_sha1_init(&sctx);
+   _mesa_sha1_update(&sctx, tag, sizeof(tag));
+   _mesa_sha1_update(&sctx, prog->base.sha1, sizeof(prog->base.sha1));
+   _mesa_sha1_final(&sctx, sha1);
+   disk_cache_compute_key(screen->disk_cache, sha1, sizeof(sha1), key);
+}
+
+/* The keys the program needed variants for last time, i.e. rasterizer or
+ * framebuffer state the app keeps drawing with.  Loaded in the
+ * precompile job so those variants are ready before the first draw.
+ */
+static void
+load_variant_manifest(struct zink_screen *screen, struct zink_gfx_program *prog)
+{
+   if (!screen->disk_cache)
+      return;
+
+   cache_key key;
+   size_t size;
+   variant_manifest_key(screen, prog, key);
+   struct zink_variant_record *data = disk_cache_get(screen->disk_cache, key, &size);
+   if (!data)
+      return;
+   unsigned count = MIN2(size / sizeof(struct zink_variant_record), ZINK_VARIANT_MANIFEST_MAX);
+   for (unsigned i = 0; i < count; i++) {
+      /* skip anything that doesn't fit this program */
+      if (data[i].stage >= PIPE_SHADER_COMPUTE || !prog->shaders[data[i].stage] ||
+          data[i].key_size > sizeof(data[i].key))
+         continue;
+      prog->used_variants[prog->num_used_variants++] = data[i];
+   }
+   free(data);
+}
+
+static void
+save_variant_manifest(struct zink_screen *screen, struct zink_gfx_program *prog)
+{
+   if (!screen->disk_cache || !prog->used_variants_dirty)
+      return;
+
+   cache_key key;
+   variant_manifest_key(screen, prog, key);
+   disk_cache_put(screen->disk_cache, key, prog->used_variants,
+                  prog->num_used_variants * sizeof(struct zink_variant_record), NULL);
+}
+
+static void
+precompile_variants(struct zink_screen *screen, struct zink_gfx_program *prog,
+                    const struct zink_gfx_pipeline_state *default_state)
+{
+   struct zink_gfx_pipeline_state state;
+   for (unsigned v = 0; v < prog->num_used_variants; v++) {
+      const struct zink_variant_record *rec = &prog->used_variants[v];
+      memcpy(&state, default_state, sizeof(state));
+      struct zink_shader_key *key = &state.shader_keys.key[rec->stage];
+      memcpy(&key->key, rec->key, rec->key_size);
+      key->size = rec->key_size;
+      key->base.nonseamless_cube_mask = rec->nonseamless_cube_mask;
+      /* looks up the module cache first, so defaults aren't compiled twice */
+      get_shader_module_for_stage(NULL, screen, prog->shaders[rec->stage], prog, &state);
+   }
+}
+
+static void
+precompile_job(void *data, void *gdata, int thread_index)
+{
+   struct zink_gfx_program *prog = data;
+   struct zink_screen *screen = gdata;
+   struct zink_gfx_pipeline_state state;
+
+   /* use the keys a new context starts with: this is the most likely variant for the first draw */
+   memset(&state, 0, sizeof(state));
+   state.shader_keys.key[PIPE_SHADER_TESS_CTRL].key.tcs.patch_vertices = 1;
+   state.shader_keys.key[PIPE_SHADER_VERTEX].size = sizeof(struct zink_vs_key_base);
+   state.shader_keys.key[PIPE_SHADER_TESS_EVAL].size = sizeof(struct zink_vs_key_base);
+   state.shader_keys.key[PIPE_SHADER_TESS_CTRL].size = sizeof(struct zink_tcs_key);
+   state.shader_keys.key[PIPE_SHADER_GEOMETRY].size = sizeof(struct zink_vs_key_base);
+   state.shader_keys.key[PIPE_SHADER_FRAGMENT].size = sizeof(struct zink_fs_key);
+   enum pipe_shader_type pstage = pipe_shader_type_from_mesa(prog->last_vertex_stage->nir->info.stage);
+   state.shader_keys.key[pstage].key.vs_base.last_vertex_stage = true;
+   update_gfx_shader_modules(NULL, screen, prog, prog->stages_present, &state);
+   load_variant_manifest(screen, prog);
+   precompile_variants(screen, prog, &state);
+}
+
+static void
+zink_link_gfx_shader(struct pipe_context *pctx, void **shaders)
+{
+   struct zink_context *ctx = zink_context(pctx);
+   struct zink_shader **zshaders = (struct zink_shader **)shaders;
+   if (shaders[PIPE_SHADER_COMPUTE])
+      return;
+   /* can't precompile fixedfunc */
+   if (!shaders[PIPE_SHADER_VERTEX] || !shaders[PIPE_SHADER_FRAGMENT])
+      return;
+   /* generated tcs variants depend on the patch size set at draw time */
+   if (shaders[PIPE_SHADER_TESS_EVAL] && !shaders[PIPE_SHADER_TESS_CTRL])
+      return;
+   unsigned hash = 0;
+   unsigned shader_stages = 0;
+   for (unsigned i = 0; i < ZINK_SHADER_COUNT; i++) {
+      if (zshaders[i]) {
+         hash ^= zshaders[i]->hash;
+         shader_stages |= BITFIELD_BIT(i);
+      }
+   }
+   struct hash_table *ht = &ctx->program_cache[shader_stages >> 2];
+   if (_mesa_hash_table_search_pre_hashed(ht, hash, zshaders))
+      return;
+   struct zink_gfx_program *prog = zink_create_gfx_program(ctx, zshaders, 3);
+   if (!prog)
+      return;
+   _mesa_hash_table_insert_pre_hashed(ht, hash, prog->shaders, prog);
+   /* the first draw waits on this instead of compiling the default variants itself */
+   util_queue_add_job(&zink_screen(pctx->screen)->optimize_thread, prog, &prog->precompile_fence,
+                      precompile_job, NULL, 0);
+}
+
 void
 zink_delete_shader_state(struct pipe_context *pctx, void *cso)
 {
@@ -1203,6 +1636,11 @@ zink_program_init(struct zink_context *ctx)
    ctx->base.create_compute_state = zink_create_cs_state;
    ctx->base.bind_compute_state = zink_bind_cs_state;
    ctx->base.delete_compute_state = zink_delete_shader_state;
+
+   ctx->base.link_shader = zink_link_gfx_shader;
+
+   _mesa_set_init(&ctx->gfx_inputs, ctx, hash_gfx_input, equals_gfx_input);
+   _mesa_set_init(&ctx->gfx_outputs, ctx, hash_gfx_output, equals_gfx_output);
 }
 
 bool
@@ -79,6 +79,7 @@ struct zink_program {
    unsigned char sha1[20];
    struct util_queue_fence cache_fence;
    VkPipelineCache pipeline_cache;
+   simple_mtx_t pipeline_cache_lock; //pipelines may be created on background threads
    size_t pipeline_cache_size;
    struct zink_batch_usage *batch_uses;
    bool is_compute;
@@ -94,6 +95,22 @@ struct zink_program {
 };
 
 #define ZINK_MAX_INLINED_VARIANTS 5
+/* number of consecutive updates with the same inlinable uniform values before
+ * an inlined variant is compiled for them
+ */
+#define ZINK_INLINE_STABLE_USES 3
+
+/* shader keys remembered per program across runs */
+#define ZINK_VARIANT_MANIFEST_MAX 16
+
+/* a stage's shader key that needed a variant compiled at draw time */
+struct zink_variant_record {
+   uint8_t stage;
+   uint8_t key_size;
+   uint16_t pad;
+   uint32_t nonseamless_cube_mask;
+   uint8_t key[sizeof(((struct zink_shader_key *)NULL)->key)];
+};
 
 struct zink_gfx_program {
    struct zink_program base;
@@ -107,11 +124,24 @@ struct zink_gfx_program {
 
    struct list_head shader_cache[ZINK_SHADER_COUNT][2][2]; //normal, nonseamless cubes, inline uniforms
    unsigned inlined_variant_count[ZINK_SHADER_COUNT];
+   /* last inlinable uniform values seen for each stage, and how often in a row */
+   uint32_t inline_values_hash[ZINK_SHADER_COUNT];
+   uint8_t inline_values_uses[ZINK_SHADER_COUNT];
 
    struct zink_shader *shaders[ZINK_SHADER_COUNT];
    struct hash_table pipelines[11]; // number of draw modes we support
+   struct set libs; //zink_gfx_library_key -> VkPipeline
    uint32_t default_variant_hash;
    uint32_t last_variant_hash;
+
+   struct util_queue_fence precompile_fence; //default variants compiled at link time
+
+   /* keys that needed a variant compiled for this program, saved to the disk
+    * cache on destruction so the next run can precompile them
+    */
+   struct zink_variant_record used_variants[ZINK_VARIANT_MANIFEST_MAX];
+   uint8_t num_used_variants;
+   bool used_variants_dirty;
 };
 
 struct zink_compute_program {
@@ -122,6 +152,8 @@ struct zink_compute_program {
    struct zink_shader_module *module; //base
    struct list_head shader_cache[2]; //nonseamless cubes, inline uniforms
    unsigned inlined_variant_count;
+   uint32_t inline_values_hash;
+   uint8_t inline_values_uses;
 
    struct zink_shader *shader;
    struct hash_table *pipelines;
@@ -296,6 +328,8 @@ zink_pipeline_layout_create(struct zink_screen *screen, struct zink_program *pg,
 void
 zink_program_update_compute_pipeline_state(struct zink_context *ctx, struct zink_compute_program *comp, const uint block[3]);
 void
+zink_program_retile_compute(struct zink_screen *screen, const struct zink_compute_program *comp, uint32_t block[3], uint32_t grid[3]);
+void
 zink_update_compute_program(struct zink_context *ctx);
 VkPipeline
 zink_get_compute_pipeline(struct zink_screen *screen,
@@ -380,6 +414,18 @@ zink_set_fs_point_coord_key(struct zink_context *ctx)
    }
 }
 
+static inline bool
+zink_can_use_pipeline_libs(const struct zink_context *ctx)
+{
+   const struct zink_rasterizer_hw_state *hw_rast_state = (const struct zink_rasterizer_hw_state *)&ctx->gfx_pipeline_state;
+   return
+          /* input attachments need a render pass */
+          !ctx->gfx_pipeline_state.render_pass &&
+          /* sample shading needs multisample state in the fragment shader part */
+          !ctx->gfx_stages[PIPE_SHADER_FRAGMENT]->nir->info.fs.uses_sample_shading &&
+          !hw_rast_state->force_persample_interp;
+}
+
 bool
 zink_set_rasterizer_discard(struct zink_context *ctx, bool disable);
 
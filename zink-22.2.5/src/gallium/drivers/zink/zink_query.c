@@ -6,11 +6,13 @@
 #include "zink_resource.h"
 #include "zink_screen.h"
 
+#include "nir_builder.h"
 #include "util/hash_table.h"
 #include "util/set.h"
 #include "util/u_dump.h"
 #include "util/u_inlines.h"
 #include "util/u_memory.h"
+#include "util/u_upload_mgr.h"
 
 #if defined(PIPE_ARCH_X86_64) || defined(PIPE_ARCH_PPC_64) || defined(PIPE_ARCH_AARCH64) || defined(PIPE_ARCH_MIPS64)
 #define NUM_QUERIES 5000
@@ -84,6 +86,10 @@ struct zink_query {
 
    struct zink_resource *predicate;
    bool predicate_dirty;
+
+   /* driver-specific (software) queries */
+   uint64_t driver_begin;
+   uint64_t driver_result;
 };
 
 static inline int
@@ -95,6 +101,42 @@ get_num_starts(struct zink_query *q)
 static void
 update_query_id(struct zink_context *ctx, struct zink_query *q);
 
+static inline bool
+is_driver_query(struct zink_query *q)
+{
+   return q->type >= PIPE_QUERY_DRIVER_SPECIFIC;
+}
+
+/* memory stats are levels, not counters */
+static inline bool
+is_driver_stat_level(enum zink_stat stat)
+{
+   return stat >= ZINK_STAT_MEM_BUFFERS;
+}
+
+static uint64_t
+read_driver_stat(struct zink_context *ctx, enum zink_stat stat)
+{
+   struct zink_screen *screen = zink_screen(ctx->base.screen);
+
+   switch (stat) {
+   case ZINK_STAT_TC_SYNCS:
+      return ctx->tc ? p_atomic_read(&ctx->tc->num_syncs) : 0;
+   case ZINK_STAT_MEM_BUFFERS:
+      return p_atomic_read(&screen->mem_stats.size[ZINK_MEM_BUFFER]);
+   case ZINK_STAT_MEM_IMAGES:
+      return p_atomic_read(&screen->mem_stats.size[ZINK_MEM_IMAGE]);
+   case ZINK_STAT_MEM_STAGING:
+      return p_atomic_read(&screen->mem_stats.size[ZINK_MEM_STAGING]);
+   case ZINK_STAT_MEM_ALLOCATED:
+      return p_atomic_read(&screen->mem_stats.allocated);
+   case ZINK_STAT_MEM_CACHED:
+      return zink_bo_cached_size(screen);
+   default:
+      return p_atomic_read(&ctx->stats[stat]);
+   }
+}
+
 static void
 begin_vk_query_indexed(struct zink_context *ctx, struct zink_vk_query *vkq, int index,
                        VkQueryControlFlags flags)
@@ -454,6 +496,13 @@ zink_create_query(struct pipe_context *pctx,
    query->type = query_type;
    if (query->type == PIPE_QUERY_GPU_FINISHED)
       return (struct pipe_query *)query;
+   if (is_driver_query(query)) {
+      if (query_type - PIPE_QUERY_DRIVER_SPECIFIC >= ZINK_STAT_COUNT) {
+         FREE(query);
+         return NULL;
+      }
+      return (struct pipe_query *)query;
+   }
    query->vkqtype = convert_query_type(screen, query_type, &query->precise);
    if (query->vkqtype == -1)
       return NULL;
@@ -744,6 +793,160 @@ copy_results_to_buffer(struct zink_context *ctx, struct zink_query *query, struc
    copy_pool_results_to_buffer(ctx, query, start->vkq[0]->pool->query_pool, start->vkq[0]->query_id, res, offset, num_results, flags);
 }
 
+/* params:
+ *  uint32_t count, stride, dst_offset, is_bool
+ *  uint64_t limit
+ */
+static void *
+create_accumulate_cs(struct zink_context *ctx, bool is_64bit)
+{
+   struct zink_screen *screen = zink_screen(ctx->base.screen);
+   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE, &screen->nir_options,
+                                                  "accumulate_query_results_%s", is_64bit ? "64" : "32");
+   b.shader->info.workgroup_size[0] = 1;
+   b.shader->info.workgroup_size[1] = 1;
+   b.shader->info.workgroup_size[2] = 1;
+   b.shader->info.num_ssbos = 3;
+
+   nir_ssa_def *zero = nir_imm_int(&b, 0);
+   nir_ssa_def *params = nir_load_ssbo(&b, 4, 32, nir_imm_int(&b, 2), zero, .align_mul = 8);
+   nir_ssa_def *count = nir_channel(&b, params, 0);
+   nir_ssa_def *stride = nir_channel(&b, params, 1);
+   nir_ssa_def *dst_offset = nir_channel(&b, params, 2);
+   nir_ssa_def *is_bool = nir_ine_imm(&b, nir_channel(&b, params, 3), 0);
+   nir_ssa_def *limit = nir_load_ssbo(&b, 1, 64, nir_imm_int(&b, 2), nir_imm_int(&b, 16), .align_mul = 8);
+
+   nir_variable *sum = nir_local_variable_create(b.impl, glsl_uint64_t_type(), "sum");
+   nir_variable *idx = nir_local_variable_create(b.impl, glsl_uint_type(), "idx");
+   nir_store_var(&b, sum, nir_imm_int64(&b, 0), 0x1);
+   nir_store_var(&b, idx, zero, 0x1);
+
+   nir_push_loop(&b);
+   {
+      nir_ssa_def *i = nir_load_var(&b, idx);
+      nir_push_if(&b, nir_uge(&b, i, count));
+      nir_jump(&b, nir_jump_break);
+      nir_pop_if(&b, NULL);
+
+      nir_ssa_def *val = nir_load_ssbo(&b, 1, 64, zero, nir_imul(&b, i, stride), .align_mul = 8);
+      val = nir_bcsel(&b, is_bool, nir_b2i64(&b, nir_ine_imm(&b, val, 0)), val);
+      nir_store_var(&b, sum, nir_iadd(&b, nir_load_var(&b, sum), val), 0x1);
+      nir_store_var(&b, idx, nir_iadd_imm(&b, i, 1), 0x1);
+   }
+   nir_pop_loop(&b, NULL);
+
+   nir_ssa_def *result = nir_load_var(&b, sum);
+   result = nir_bcsel(&b, is_bool, nir_umin(&b, result, nir_imm_int64(&b, 1)), result);
+   result = nir_umin(&b, result, limit);
+   if (!is_64bit)
+      result = nir_u2u32(&b, result);
+   nir_store_ssbo(&b, result, nir_imm_int(&b, 1), dst_offset, .write_mask = 0x1, .align_mul = is_64bit ? 8 : 4);
+
+   struct pipe_compute_state state = {0};
+   state.ir_type = PIPE_SHADER_IR_NIR;
+   state.prog = b.shader;
+   return ctx->base.create_compute_state(&ctx->base, &state);
+}
+
+/* sum the results of all the (single result) starts of a query into res on the gpu */
+static bool
+accumulate_results_to_buffer(struct zink_context *ctx, struct zink_query *query, enum pipe_query_value_type result_type,
+                             struct zink_resource *res, unsigned offset)
+{
+   struct pipe_context *pctx = &ctx->base;
+   struct zink_screen *screen = zink_screen(pctx->screen);
+
+   switch (query->type) {
+   case PIPE_QUERY_OCCLUSION_COUNTER:
+   case PIPE_QUERY_OCCLUSION_PREDICATE:
+   case PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE:
+   case PIPE_QUERY_PRIMITIVES_EMITTED:
+      break;
+   case PIPE_QUERY_PRIMITIVES_GENERATED:
+      /* the emulated version picks between results based on the draw */
+      if (is_emulated_primgen(query))
+         return false;
+      break;
+   case PIPE_QUERY_PIPELINE_STATISTICS_SINGLE:
+      /* line loop vertex counts are adjusted per start */
+      if (query->index == PIPE_STAT_QUERY_IA_VERTICES)
+         return false;
+      break;
+   default:
+      return false;
+   }
+   if (query->needs_update)
+      update_qbo(ctx, query);
+   /* results are only contiguous within a single qbo */
+   if (!list_is_singular(&query->buffers) || !query->curr_qbo->num_results)
+      return false;
+
+   bool is_64bit = result_type > PIPE_QUERY_TYPE_U32;
+   if (!ctx->query_accumulate_cs[is_64bit])
+      ctx->query_accumulate_cs[is_64bit] = create_accumulate_cs(ctx, is_64bit);
+   if (!ctx->query_accumulate_cs[is_64bit])
+      return false;
+
+   struct {
+      uint32_t count;
+      uint32_t stride;
+      uint32_t dst_offset;
+      uint32_t is_bool;
+      uint64_t limit;
+   } params;
+   unsigned ssbo_align = screen->info.props.limits.minStorageBufferOffsetAlignment;
+   unsigned result_size = is_64bit ? sizeof(uint64_t) : sizeof(uint32_t);
+   params.count = query->curr_qbo->num_results;
+   params.stride = get_num_results(query) * sizeof(uint64_t);
+   params.dst_offset = offset % ssbo_align;
+   params.is_bool = is_bool_query(query);
+   if (result_type == PIPE_QUERY_TYPE_I32)
+      params.limit = INT_MAX;
+   else if (result_type == PIPE_QUERY_TYPE_U32)
+      params.limit = UINT_MAX;
+   else
+      params.limit = UINT64_MAX;
+
+   struct pipe_shader_buffer buffers[3] = {0};
+   u_upload_data(pctx->stream_uploader, 0, sizeof(params), ssbo_align, &params,
+                 &buffers[2].buffer_offset, &buffers[2].buffer);
+   if (!buffers[2].buffer)
+      return false;
+   buffers[2].buffer_size = sizeof(params);
+   buffers[0].buffer = query->curr_qbo->buffers[0];
+   buffers[0].buffer_size = params.count * params.stride;
+   buffers[1].buffer = &res->base.b;
+   buffers[1].buffer_offset = offset - params.dst_offset;
+   buffers[1].buffer_size = params.dst_offset + result_size;
+
+   /* this is an internal dispatch: it must not be affected by or clobber app state */
+   struct zink_shader *saved_cs = ctx->compute_stage;
+   struct pipe_shader_buffer saved_ssbos[3] = {0};
+   unsigned saved_writable = ctx->writable_ssbos[PIPE_SHADER_COMPUTE] & BITFIELD_MASK(3);
+   for (unsigned i = 0; i < 3; i++)
+      util_copy_shader_buffer(&saved_ssbos[i], &ctx->ssbos[PIPE_SHADER_COMPUTE][i]);
+   bool render_condition_active = ctx->render_condition_active;
+   if (ctx->render_condition.active)
+      zink_stop_conditional_render(ctx);
+   ctx->render_condition_active = false;
+
+   struct pipe_grid_info info = {0};
+   info.work_dim = 1;
+   info.block[0] = info.block[1] = info.block[2] = 1;
+   info.grid[0] = info.grid[1] = info.grid[2] = 1;
+   pctx->bind_compute_state(pctx, ctx->query_accumulate_cs[is_64bit]);
+   pctx->set_shader_buffers(pctx, PIPE_SHADER_COMPUTE, 0, 3, buffers, BITFIELD_BIT(1));
+   pctx->launch_grid(pctx, &info);
+
+   pctx->set_shader_buffers(pctx, PIPE_SHADER_COMPUTE, 0, 3, saved_ssbos, saved_writable);
+   pctx->bind_compute_state(pctx, saved_cs);
+   ctx->render_condition_active = render_condition_active;
+   for (unsigned i = 0; i < 3; i++)
+      pipe_resource_reference(&saved_ssbos[i].buffer, NULL);
+   pipe_resource_reference(&buffers[2].buffer, NULL);
+   return true;
+}
+
 
 static void
 reset_query_range(struct zink_context *ctx, struct zink_query *q)
@@ -882,6 +1085,11 @@ zink_begin_query(struct pipe_context *pctx,
    struct zink_context *ctx = zink_context(pctx);
    struct zink_batch *batch = &ctx->batch;
 
+   if (is_driver_query(query)) {
+      query->driver_begin = read_driver_stat(ctx, query->type - PIPE_QUERY_DRIVER_SPECIFIC);
+      return true;
+   }
+
    /* drop all past results */
    reset_qbo(query);
 
@@ -976,6 +1184,14 @@ zink_end_query(struct pipe_context *pctx,
       return true;
    }
 
+   if (is_driver_query(query)) {
+      enum zink_stat stat = query->type - PIPE_QUERY_DRIVER_SPECIFIC;
+      query->driver_result = read_driver_stat(ctx, stat);
+      if (!is_driver_stat_level(stat))
+         query->driver_result -= query->driver_begin;
+      return true;
+   }
+
    /* FIXME: this can be called from a thread, but it needs to write to the cmdbuf */
    threaded_context_unwrap_sync(pctx);
    zink_batch_no_rp(ctx);
@@ -1016,6 +1232,20 @@ zink_get_query_result(struct pipe_context *pctx,
       return result->b;
    }
 
+   if (is_driver_query(query)) {
+      switch (query->type - PIPE_QUERY_DRIVER_SPECIFIC) {
+      case ZINK_STAT_PIPELINE_COMPILE_TIME:
+      case ZINK_STAT_BATCH_STALL_TIME:
+         /* counted in ns, reported in us */
+         result->u64 = query->driver_result / 1000;
+         break;
+      default:
+         result->u64 = query->driver_result;
+         break;
+      }
+      return true;
+   }
+
    if (query->needs_update)
       update_qbo(ctx, query);
 
@@ -1298,12 +1528,12 @@ zink_get_query_result_resource(struct pipe_context *pctx,
       }
    }
 
-   /* TODO: use CS to aggregate results */
-
-   /* unfortunately, there's no way to accumulate results from multiple queries on the gpu without either
-    * clobbering all but the last result or writing the results sequentially, so we have to manually write the result
+   /* unfortunately, there's no way to accumulate results from multiple queries with transfer ops without either
+    * clobbering all but the last result or writing the results sequentially, so sum them in a compute shader
+    * when the results can simply be added up, and manually write the result otherwise
     */
-   force_cpu_read(ctx, pquery, result_type, pres, offset);
+   if (!accumulate_results_to_buffer(ctx, query, result_type, res, offset))
+      force_cpu_read(ctx, pquery, result_type, pres, offset);
 }
 
 uint64_t
@@ -1335,6 +1565,47 @@ zink_get_timestamp(struct pipe_screen *pscreen)
    return timestamp;
 }
 
+#define ZQ(_name, _stat, _type, _result_type) {                                \
+      .name = _name, .query_type = PIPE_QUERY_DRIVER_SPECIFIC + ZINK_STAT_##_stat, \
+      .type = PIPE_DRIVER_QUERY_TYPE_##_type,                                  \
+      .result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_##_result_type,             \
+      .group_id = ~(unsigned)0,                                                \
+   }
+
+static const struct pipe_driver_query_info driver_query_list[] = {
+   ZQ("descriptor-sets-allocated", DESCRIPTOR_SETS_ALLOCATED, UINT64, AVERAGE),
+   ZQ("descriptor-set-updates", DESCRIPTOR_SET_UPDATES, UINT64, AVERAGE),
+   ZQ("pipeline-misses", PIPELINE_MISSES, UINT64, AVERAGE),
+   ZQ("pipeline-compile-time", PIPELINE_COMPILE_TIME, MICROSECONDS, AVERAGE),
+   ZQ("oom-flushes", OOM_FLUSHES, UINT64, AVERAGE),
+   ZQ("batch-stall-time", BATCH_STALL_TIME, MICROSECONDS, AVERAGE),
+   ZQ("tc-syncs", TC_SYNCS, UINT64, AVERAGE),
+   ZQ("staging-bytes-mapped", STAGING_BYTES_MAPPED, BYTES, AVERAGE),
+   ZQ("pipeline-barriers", PIPELINE_BARRIERS, UINT64, AVERAGE),
+   ZQ("barriers-batched", BARRIERS_BATCHED, UINT64, AVERAGE),
+   ZQ("mem-buffers", MEM_BUFFERS, BYTES, AVERAGE),
+   ZQ("mem-images", MEM_IMAGES, BYTES, AVERAGE),
+   ZQ("mem-staging", MEM_STAGING, BYTES, AVERAGE),
+   ZQ("mem-allocated", MEM_ALLOCATED, BYTES, AVERAGE),
+   ZQ("mem-cached", MEM_CACHED, BYTES, AVERAGE),
+};
+
+int
+zink_get_driver_query_info(struct pipe_screen *pscreen, unsigned index,
+                           struct pipe_driver_query_info *info)
+{
+   STATIC_ASSERT(ARRAY_SIZE(driver_query_list) == ZINK_STAT_COUNT);
+
+   if (!info)
+      return ARRAY_SIZE(driver_query_list);
+
+   if (index >= ARRAY_SIZE(driver_query_list))
+      return 0;
+
+   *info = driver_query_list[index];
+   return 1;
+}
+
 void
 zink_context_query_init(struct pipe_context *pctx)
 {
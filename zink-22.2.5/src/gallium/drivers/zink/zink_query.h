@@ -34,6 +34,7 @@ struct zink_fence;
 struct zink_query;
 struct zink_screen;
 struct pipe_screen;
+struct pipe_driver_query_info;
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -63,6 +64,9 @@ void
 zink_context_destroy_query_pools(struct zink_context *ctx);
 uint64_t
 zink_get_timestamp(struct pipe_screen *pscreen);
+int
+zink_get_driver_query_info(struct pipe_screen *pscreen, unsigned index,
+                           struct pipe_driver_query_info *info);
 #ifdef __cplusplus
 }
 #endif
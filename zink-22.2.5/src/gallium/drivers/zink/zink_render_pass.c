@@ -33,6 +33,8 @@
 #include "util/u_string.h"
 #include "util/u_blitter.h"
 
+#include "vk_format.h"
+
 static VkAttachmentLoadOp
 get_rt_loadop(const struct zink_rt_attrib *rt, bool clear)
 {
@@ -138,6 +140,18 @@ create_render_pass2(struct zink_screen *screen, struct zink_render_pass_state *s
       //attachments[num_attachments].stencilStoreOp = rt->resolve ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
       attachments[num_attachments].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
       attachments[num_attachments].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+      /* never load or store an aspect the format doesn't have: tilers would
+       * otherwise spend bandwidth on it, and a stray LOAD forces depth_read
+       */
+      VkImageAspectFlags aspects = vk_format_aspects(rt->format);
+      if (!(aspects & VK_IMAGE_ASPECT_DEPTH_BIT)) {
+         attachments[num_attachments].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+         attachments[num_attachments].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      }
+      if (!(aspects & VK_IMAGE_ASPECT_STENCIL_BIT)) {
+         attachments[num_attachments].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+         attachments[num_attachments].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      }
       /* if layout changes are ever handled here, need VkAttachmentSampleLocationsEXT */
       attachments[num_attachments].initialLayout = layout;
       attachments[num_attachments].finalLayout = layout;
@@ -709,6 +723,9 @@ zink_begin_render_pass(struct zink_context *ctx)
          pipe_sampler_view_reference(&src_view, NULL);
          csurf->transient_init = true;
       }
+      /* restoring the fb state for the blits may have deferred the lookup */
+      if (!ctx->framebuffer)
+         zink_update_framebuffer_state(ctx);
       ctx->rp_layout_changed = ctx->rp_loadop_changed = false;
       ctx->fb_changed = ctx->rp_changed = false;
       ctx->gfx_pipeline_state.rp_state = rp_state;
@@ -96,9 +96,33 @@ debug_describe_zink_resource_object(char *buf, const struct zink_resource_object
    sprintf(buf, "zink_resource_object");
 }
 
+static void
+mem_stats_add(struct zink_screen *screen, struct zink_resource_object *obj, const struct pipe_resource *templ)
+{
+   if (templ->target != PIPE_BUFFER)
+      obj->mem_category = ZINK_MEM_IMAGE;
+   else if (templ->usage == PIPE_USAGE_STAGING)
+      obj->mem_category = ZINK_MEM_STAGING;
+   else
+      obj->mem_category = ZINK_MEM_BUFFER;
+   obj->mem_tracked = true;
+   p_atomic_add(&screen->mem_stats.size[obj->mem_category], obj->size);
+   p_atomic_inc(&screen->mem_stats.count[obj->mem_category]);
+}
+
+static void
+mem_stats_del(struct zink_screen *screen, struct zink_resource_object *obj)
+{
+   if (!obj->mem_tracked)
+      return;
+   p_atomic_add(&screen->mem_stats.size[obj->mem_category], -(int64_t)obj->size);
+   p_atomic_dec(&screen->mem_stats.count[obj->mem_category]);
+}
+
 void
 zink_destroy_resource_object(struct zink_screen *screen, struct zink_resource_object *obj)
 {
+   mem_stats_del(screen, obj);
    if (obj->is_buffer) {
       VKSCR(DestroyBuffer)(screen->dev, obj->buffer, NULL);
       VKSCR(DestroyBuffer)(screen->dev, obj->storage_buffer, NULL);
@@ -127,6 +151,8 @@ zink_resource_destroy(struct pipe_screen *pscreen,
    struct zink_screen *screen = zink_screen(pscreen);
    struct zink_resource *res = zink_resource(pres);
    if (pres->target == PIPE_BUFFER) {
+      for (unsigned i = 0; i < res->num_recycled_objs; i++)
+         zink_resource_object_reference(screen, &res->recycled_objs[i], NULL);
       util_range_destroy(&res->valid_buffer_range);
       util_idalloc_mt_free(&screen->buffer_ids, res->base.buffer_id_unique);
       assert(!_mesa_hash_table_num_entries(&res->bufferview_cache));
@@ -134,8 +160,13 @@ zink_resource_destroy(struct pipe_screen *pscreen,
       ralloc_free(res->bufferview_cache.table);
    } else {
       assert(!_mesa_hash_table_num_entries(&res->surface_cache));
+      for (unsigned i = 0; i < ARRAY_SIZE(res->surfaces); i++)
+         assert(!res->surfaces[i]);
       simple_mtx_destroy(&res->surface_mtx);
       ralloc_free(res->surface_cache.table);
+      pipe_resource_reference(&res->dt_import, NULL);
+      for (unsigned i = 0; i < ARRAY_SIZE(res->dt_readback); i++)
+         pipe_resource_reference(&res->dt_readback[i], NULL);
    }
    /* no need to do anything for the caches, these objects own the resource lifetimes */
 
@@ -549,7 +580,7 @@ retry:
 
 static struct zink_resource_object *
 resource_object_create(struct zink_screen *screen, const struct pipe_resource *templ, struct winsys_handle *whandle, bool *optimal_tiling,
-                       const uint64_t *modifiers, int modifiers_count, const void *loader_private)
+                       const uint64_t *modifiers, int modifiers_count, const void *loader_private, const void *user_mem)
 {
    struct zink_resource_object *obj = CALLOC_STRUCT(zink_resource_object);
    if (!obj)
@@ -615,6 +646,13 @@ resource_object_create(struct zink_screen *screen, const struct pipe_resource *t
       return obj;
    } else if (templ->target == PIPE_BUFFER) {
       VkBufferCreateInfo bci = create_bci(screen, templ, templ->bind);
+      VkExternalMemoryBufferCreateInfo embci = {
+         VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+         NULL,
+         VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+      };
+      if (user_mem)
+         bci.pNext = &embci;
 
       if (VKSCR(CreateBuffer)(screen->dev, &bci, NULL, &obj->buffer) != VK_SUCCESS) {
          mesa_loge("ZINK: vkCreateBuffer failed");
@@ -638,6 +676,17 @@ resource_object_create(struct zink_screen *screen, const struct pipe_resource *t
          flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
       else
          flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+      if (user_mem) {
+         /* the import covers exactly the caller's range, so the buffer can't need more */
+         VkMemoryHostPointerPropertiesEXT hpp = {VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT};
+         if (reqs.size > templ->width0 ||
+             VKSCR(GetMemoryHostPointerPropertiesEXT)(screen->dev, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+                                                      user_mem, &hpp) != VK_SUCCESS)
+            goto fail2;
+         reqs.memoryTypeBits &= hpp.memoryTypeBits;
+         reqs.size = templ->width0;
+         flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+      }
       obj->is_buffer = true;
       obj->transfer_dst = true;
    } else {
@@ -916,6 +965,8 @@ resource_object_create(struct zink_screen *screen, const struct pipe_resource *t
    mai.allocationSize = reqs.size;
    enum zink_heap heap = zink_heap_from_domain_flags(flags, aflags);
    mai.memoryTypeIndex = screen->heap_map[heap];
+   if (user_mem && !(reqs.memoryTypeBits & BITFIELD_BIT(mai.memoryTypeIndex)))
+      goto fail2;
    if (unlikely(!(reqs.memoryTypeBits & BITFIELD_BIT(mai.memoryTypeIndex)))) {
       /* not valid based on reqs; demote to more compatible type */
       switch (heap) {
@@ -954,6 +1005,17 @@ resource_object_create(struct zink_screen *screen, const struct pipe_resource *t
       obj->exportable = true;
    }
 
+   VkImportMemoryHostPointerInfoEXT imhpi = {
+      VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+      NULL,
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+      (void*)user_mem
+   };
+   if (user_mem) {
+      imhpi.pNext = mai.pNext;
+      mai.pNext = &imhpi;
+   }
+
 #ifdef ZINK_USE_DMABUF
 
 #if !defined(_WIN32)
@@ -1069,6 +1131,7 @@ retry:
             }
       }
    }
+   mem_stats_add(screen, obj, templ);
    return obj;
 
 fail3:
@@ -1091,7 +1154,7 @@ resource_create(struct pipe_screen *pscreen,
                 struct winsys_handle *whandle,
                 unsigned external_usage,
                 const uint64_t *modifiers, int modifiers_count,
-                const void *loader_private)
+                const void *loader_private, const void *user_mem)
 {
    struct zink_screen *screen = zink_screen(pscreen);
    struct zink_resource *res = CALLOC_STRUCT_CL(zink_resource);
@@ -1120,7 +1183,7 @@ resource_create(struct pipe_screen *pscreen,
       templ2.flags &= ~PIPE_RESOURCE_FLAG_SPARSE;
       res->base.b.flags &= ~PIPE_RESOURCE_FLAG_SPARSE;
    }
-   res->obj = resource_object_create(screen, &templ2, whandle, &optimal_tiling, modifiers, modifiers_count, loader_private);
+   res->obj = resource_object_create(screen, &templ2, whandle, &optimal_tiling, modifiers, modifiers_count, loader_private, user_mem);
    if (!res->obj) {
       free(res->modifiers);
       FREE_CL(res);
@@ -1220,14 +1283,14 @@ static struct pipe_resource *
 zink_resource_create(struct pipe_screen *pscreen,
                      const struct pipe_resource *templ)
 {
-   return resource_create(pscreen, templ, NULL, 0, NULL, 0, NULL);
+   return resource_create(pscreen, templ, NULL, 0, NULL, 0, NULL, NULL);
 }
 
 static struct pipe_resource *
 zink_resource_create_with_modifiers(struct pipe_screen *pscreen, const struct pipe_resource *templ,
                                     const uint64_t *modifiers, int modifiers_count)
 {
-   return resource_create(pscreen, templ, NULL, 0, modifiers, modifiers_count, NULL);
+   return resource_create(pscreen, templ, NULL, 0, modifiers, modifiers_count, NULL, NULL);
 }
 
 static struct pipe_resource *
@@ -1235,7 +1298,21 @@ zink_resource_create_drawable(struct pipe_screen *pscreen,
                               const struct pipe_resource *templ,
                               const void *loader_private)
 {
-   return resource_create(pscreen, templ, NULL, 0, NULL, 0, loader_private);
+   return resource_create(pscreen, templ, NULL, 0, NULL, 0, loader_private, NULL);
+}
+
+static struct pipe_resource *
+zink_resource_from_user_memory(struct pipe_screen *pscreen,
+                               const struct pipe_resource *templ,
+                               void *user_memory)
+{
+   struct zink_screen *screen = zink_screen(pscreen);
+   VkDeviceSize alignment = screen->info.ext_host_mem_props.minImportedHostPointerAlignment;
+
+   if (templ->target != PIPE_BUFFER ||
+       (uintptr_t)user_memory % alignment || templ->width0 % alignment)
+      return NULL;
+   return resource_create(pscreen, templ, NULL, 0, NULL, 0, NULL, user_memory);
 }
 
 static bool
@@ -1252,7 +1329,7 @@ add_resource_bind(struct zink_context *ctx, struct zink_resource *res, unsigned
       for (unsigned i = 0; i < screen->modifier_props[res->base.b.format].drmFormatModifierCount; i++)
          res->modifiers[i] = screen->modifier_props[res->base.b.format].pDrmFormatModifierProperties[i].drmFormatModifier;
    }
-   struct zink_resource_object *new_obj = resource_object_create(screen, &res->base.b, NULL, &res->optimal_tiling, res->modifiers, res->modifiers_count, NULL);
+   struct zink_resource_object *new_obj = resource_object_create(screen, &res->base.b, NULL, &res->optimal_tiling, res->modifiers, res->modifiers_count, NULL, NULL);
    if (!new_obj) {
       debug_printf("new backing resource alloc failed!");
       res->base.b.bind &= ~bind;
@@ -1504,7 +1581,7 @@ zink_resource_from_handle(struct pipe_screen *pscreen,
       modifier = whandle->modifier;
       modifier_count = 1;
    }
-   struct pipe_resource *pres = resource_create(pscreen, &templ2, whandle, usage, &modifier, modifier_count, NULL);
+   struct pipe_resource *pres = resource_create(pscreen, &templ2, whandle, usage, &modifier, modifier_count, NULL, NULL);
    if (pres) {
       struct zink_resource *res = zink_resource(pres);
       res->drm_format = whandle->format;
@@ -1572,12 +1649,51 @@ zink_resource_from_memobj(struct pipe_screen *pscreen,
 {
    struct zink_memory_object *memobj = (struct zink_memory_object *)pmemobj;
 
-   struct pipe_resource *pres = resource_create(pscreen, templ, &memobj->whandle, 0, NULL, 0, NULL);
+   struct pipe_resource *pres = resource_create(pscreen, templ, &memobj->whandle, 0, NULL, 0, NULL, NULL);
    if (pres && pres->target != PIPE_BUFFER)
       zink_resource(pres)->valid = true;
    return pres;
 }
 
+/* orphaning the same buffer every frame would otherwise create and bind a new
+ * VkBuffer each time: hand back a previously replaced object once it's idle
+ */
+static struct zink_resource_object *
+get_recycled_buffer_obj(struct zink_screen *screen, struct zink_resource *res)
+{
+   for (unsigned i = 0; i < res->num_recycled_objs; i++) {
+      struct zink_resource_object *obj = res->recycled_objs[i];
+      if (obj->persistent_maps || !zink_bo_usage_check_completion(screen, obj->bo, ZINK_RESOURCE_ACCESS_RW))
+         continue;
+      res->num_recycled_objs--;
+      memmove(&res->recycled_objs[i], &res->recycled_objs[i + 1],
+              (res->num_recycled_objs - i) * sizeof(res->recycled_objs[0]));
+      /* the object is idle, so it starts over like a new one */
+      obj->access = 0;
+      obj->access_stage = 0;
+      obj->unordered_read = false;
+      obj->unordered_write = false;
+      /* this is the caller's ref */
+      return obj;
+   }
+   return NULL;
+}
+
+static void
+recycle_buffer_obj(struct zink_screen *screen, struct zink_resource *res, struct zink_resource_object *obj)
+{
+   if (res->base.is_shared || res->base.is_user_ptr || obj->exportable)
+      return;
+   if (res->num_recycled_objs == ZINK_MAX_RECYCLED_BUFFER_OBJS) {
+      zink_resource_object_reference(screen, &res->recycled_objs[0], NULL);
+      res->num_recycled_objs--;
+      memmove(&res->recycled_objs[0], &res->recycled_objs[1],
+              res->num_recycled_objs * sizeof(res->recycled_objs[0]));
+   }
+   res->recycled_objs[res->num_recycled_objs] = NULL;
+   zink_resource_object_reference(screen, &res->recycled_objs[res->num_recycled_objs++], obj);
+}
+
 static bool
 invalidate_buffer(struct zink_context *ctx, struct zink_resource *res)
 {
@@ -1601,11 +1717,14 @@ invalidate_buffer(struct zink_context *ctx, struct zink_resource *res)
       return false;
 
    struct zink_resource_object *old_obj = res->obj;
-   struct zink_resource_object *new_obj = resource_object_create(screen, &res->base.b, NULL, NULL, NULL, 0, NULL);
+   struct zink_resource_object *new_obj = get_recycled_buffer_obj(screen, res);
+   if (!new_obj)
+      new_obj = resource_object_create(screen, &res->base.b, NULL, NULL, NULL, 0, NULL, NULL);
    if (!new_obj) {
       debug_printf("new backing resource alloc failed!");
       return false;
    }
+   recycle_buffer_obj(screen, res, old_obj);
    /* this ref must be transferred before rebind or else BOOM */
    zink_batch_reference_resource_move(&ctx->batch, res);
    res->obj = new_obj;
@@ -1817,6 +1936,7 @@ zink_buffer_map(struct pipe_context *pctx,
          res = zink_resource(trans->staging_res);
          trans->offset = offset;
          usage |= PIPE_MAP_UNSYNCHRONIZED;
+         p_atomic_add(&ctx->stats[ZINK_STAT_STAGING_BYTES_MAPPED], box->width);
          ptr = ((uint8_t *)ptr);
       } else {
          /* At this point, the buffer is always idle (we checked it above). */
@@ -1837,6 +1957,7 @@ zink_buffer_map(struct pipe_context *pctx,
          trans->staging_res = pipe_buffer_create(&screen->base, PIPE_BIND_LINEAR, PIPE_USAGE_STAGING, box->width + trans->offset);
          if (!trans->staging_res)
             goto fail;
+         p_atomic_add(&ctx->stats[ZINK_STAT_STAGING_BYTES_MAPPED], box->width);
          struct zink_resource *staging_res = zink_resource(trans->staging_res);
          zink_copy_buffer(ctx, staging_res, res, trans->offset, box->x, box->width);
          res = staging_res;
@@ -1848,6 +1969,7 @@ zink_buffer_map(struct pipe_context *pctx,
       trans->staging_res = pipe_buffer_create(&screen->base, PIPE_BIND_LINEAR, PIPE_USAGE_STAGING, box->width + trans->offset);
       if (!trans->staging_res)
          goto fail;
+      p_atomic_add(&ctx->stats[ZINK_STAT_STAGING_BYTES_MAPPED], box->width);
       struct zink_resource *staging_res = zink_resource(trans->staging_res);
       res = staging_res;
       map_offset = trans->offset;
@@ -2210,6 +2332,7 @@ zink_resource_setup_transfer_layouts(struct zink_context *ctx, struct zink_resou
                                   VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
                                   VK_PIPELINE_STAGE_TRANSFER_BIT);
    } else {
+      zink_barriers_begin(ctx);
       zink_resource_image_barrier(ctx, src,
                                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
                                   VK_ACCESS_TRANSFER_READ_BIT,
@@ -2219,6 +2342,7 @@ zink_resource_setup_transfer_layouts(struct zink_context *ctx, struct zink_resou
                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                                   VK_ACCESS_TRANSFER_WRITE_BIT,
                                   VK_PIPELINE_STAGE_TRANSFER_BIT);
+      zink_barriers_end(ctx);
    }
 }
 
@@ -2287,6 +2411,8 @@ zink_screen_resource_init(struct pipe_screen *pscreen)
       pscreen->memobj_destroy = zink_memobj_destroy;
       pscreen->resource_from_memobj = zink_resource_from_memobj;
    }
+   if (screen->info.have_EXT_external_memory_host)
+      pscreen->resource_from_user_memory = zink_resource_from_user_memory;
    pscreen->resource_get_param = zink_resource_get_param;
    return true;
 }
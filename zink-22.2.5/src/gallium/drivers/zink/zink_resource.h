@@ -47,6 +47,15 @@ struct zink_bo;
 #define ZINK_BIND_TRANSIENT (1u << 30) //transient fb attachment
 #define ZINK_BIND_VIDEO (1u << 31)
 
+/* sw_winsys presents read back through a ring this deep */
+#define ZINK_DT_READBACK_COUNT 3
+
+/* backing objects kept around per buffer for reuse on invalidation */
+#define ZINK_MAX_RECYCLED_BUFFER_OBJS 3
+
+/* surfaces cached per image without going through the hash table */
+#define ZINK_SURFACE_CACHE_INLINE 4
+
 struct mem_key {
    unsigned seen_count;
    struct {
@@ -57,6 +66,7 @@ struct mem_key {
 
 struct zink_resource_object {
    struct pipe_reference reference;
+   uint64_t batch_gen; //zink_batch_state::gen of the last batch that referenced this object
 
    VkPipelineStageFlagBits access_stage;
    VkAccessFlags access;
@@ -109,6 +119,9 @@ struct zink_resource_object {
    bool host_visible;
    bool coherent;
    bool is_aux;
+
+   bool mem_tracked; //counted in zink_screen::mem_stats
+   uint8_t mem_category; //enum zink_mem_category
 };
 
 struct zink_resource {
@@ -128,6 +141,9 @@ struct zink_resource {
          bool so_valid;
          uint32_t ubo_bind_mask[PIPE_SHADER_TYPES];
          uint32_t ssbo_bind_mask[PIPE_SHADER_TYPES];
+         /* objects replaced by invalidate_buffer, oldest first */
+         struct zink_resource_object *recycled_objs[ZINK_MAX_RECYCLED_BUFFER_OBJS];
+         uint8_t num_recycled_objs;
       };
       struct {
          VkSparseImageMemoryRequirements sparse;
@@ -162,6 +178,8 @@ struct zink_resource {
       struct {
          struct hash_table surface_cache;
          simple_mtx_t surface_mtx;
+         /* the first surfaces with a compact key skip surface_cache */
+         struct zink_surface *surfaces[ZINK_SURFACE_CACHE_INLINE];
       };
    };
 
@@ -170,6 +188,11 @@ struct zink_resource {
    bool dmabuf_acquire;
    bool dmabuf;
    unsigned dt_stride;
+   struct pipe_resource *dt_import; //buffer aliasing the displaytarget map
+   void *dt_import_map;
+   struct pipe_resource *dt_readback[ZINK_DT_READBACK_COUNT];
+   uint8_t dt_readback_idx; //next slot to fill
+   uint8_t dt_readback_count; //filled slots
 
    uint8_t modifiers_count;
    uint64_t *modifiers;
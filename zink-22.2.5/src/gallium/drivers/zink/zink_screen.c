@@ -48,6 +48,7 @@
 #include "util/u_memory.h"
 #include "util/u_screen.h"
 #include "util/u_string.h"
+#include "util/perf/cpu_trace.h"
 #include "util/u_transfer_helper.h"
 #include "util/xmlconfig.h"
 
@@ -81,6 +82,7 @@ zink_debug_options[] = {
    { "sync", ZINK_DEBUG_SYNC, "Force synchronization before draws/dispatches" },
    { "compact", ZINK_DEBUG_COMPACT, "Use only 4 descriptor sets" },
    { "noreorder", ZINK_DEBUG_NOREORDER, "Do not reorder command streams" },
+   { "noretile", ZINK_DEBUG_NORETILE, "Do not merge small compute workgroups" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -190,13 +192,17 @@ disk_cache_init(struct zink_screen *screen)
    static char buf[1000];
    snprintf(buf, sizeof(buf), "zink_%x04x", screen->info.props.vendorID);
 
-   screen->disk_cache = disk_cache_create(buf, screen->info.props.deviceName, 0);
+   /* one pipeline cache blob per program adds up to thousands of small files: keep them in a single database */
+   screen->disk_cache = disk_cache_create_single_file(buf, screen->info.props.deviceName, 0);
    if (!screen->disk_cache)
       return true;
 
-   if (!util_queue_init(&screen->cache_put_thread, "zcq", 8, 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen) ||
+   if (!util_queue_init(&screen->cache_put_thread, "zcq", 8, 1,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_PREFER_LITTLE_CORES, screen) ||
       !util_queue_init(&screen->cache_get_thread, "zcfq", 8, 4,
-         UTIL_QUEUE_INIT_RESIZE_IF_FULL | UTIL_QUEUE_INIT_SCALE_THREADS, screen)) {
+         UTIL_QUEUE_INIT_RESIZE_IF_FULL | UTIL_QUEUE_INIT_SCALE_THREADS |
+         UTIL_QUEUE_INIT_PREFER_BIG_CORES, screen)) {
       mesa_loge("zink: Failed to create disk cache queue\n");
 
       disk_cache_destroy(screen->disk_cache);
@@ -219,17 +225,24 @@ cache_put_job(void *data, void *gdata, int thread_index)
    struct zink_program *pg = data;
    struct zink_screen *screen = gdata;
    size_t size = 0;
+   simple_mtx_lock(&pg->pipeline_cache_lock);
    VkResult result = VKSCR(GetPipelineCacheData)(screen->dev, pg->pipeline_cache, &size, NULL);
    if (result != VK_SUCCESS) {
+      simple_mtx_unlock(&pg->pipeline_cache_lock);
       mesa_loge("ZINK: vkGetPipelineCacheData failed (%s)", vk_Result_to_str(result));
       return;
    }
-   if (pg->pipeline_cache_size == size)
+   if (pg->pipeline_cache_size == size) {
+      simple_mtx_unlock(&pg->pipeline_cache_lock);
       return;
+   }
    void *pipeline_data = malloc(size);
-   if (!pipeline_data)
+   if (!pipeline_data) {
+      simple_mtx_unlock(&pg->pipeline_cache_lock);
       return;
+   }
    result = VKSCR(GetPipelineCacheData)(screen->dev, pg->pipeline_cache, &size, pipeline_data);
+   simple_mtx_unlock(&pg->pipeline_cache_lock);
    if (result == VK_SUCCESS) {
       pg->pipeline_cache_size = size;
 
@@ -643,8 +656,6 @@ zink_get_param(struct pipe_screen *pscreen, enum pipe_cap param)
    case PIPE_CAP_TEXTURE_TRANSFER_MODES: {
       enum pipe_texture_transfer_mode mode = PIPE_TEXTURE_TRANSFER_BLIT;
       if (!screen->is_cpu &&
-          /* this needs substantial perf tuning */
-          screen->info.driver_props.driverID != VK_DRIVER_ID_MESA_TURNIP &&
           screen->info.have_KHR_8bit_storage &&
           screen->info.have_KHR_16bit_storage &&
           screen->info.have_KHR_shader_float16_int8)
@@ -1105,11 +1116,19 @@ zink_is_compute_copy_faster(struct pipe_screen *pscreen,
                             unsigned depth,
                             bool cpu)
 {
-   if (cpu)
+   struct zink_screen *screen = zink_screen(pscreen);
+
+   if (cpu) {
+      /* on tilers, the compute dispatch and the barriers around it cost a
+       * lot more relative to small copies, so only use it for larger ones
+       */
+      if (screen->info.driver_props.driverID == VK_DRIVER_ID_MESA_TURNIP)
+         return width * height * depth > 256 * 256;
       /* very basic for now, probably even worse for some cases,
        * but fixes lots of others
        */
       return width * height * depth > 64 * 64;
+   }
    return false;
 }
 
@@ -1257,6 +1276,9 @@ zink_destroy_screen(struct pipe_screen *pscreen)
 {
    struct zink_screen *screen = zink_screen(pscreen);
 
+   if (screen->mem_stats.dump)
+      zink_mem_stats_dump(screen);
+
    hash_table_foreach(&screen->dts, entry)
       zink_kopper_deinit_displaytarget(screen, entry->data);
    simple_mtx_destroy(&screen->dt_lock);
@@ -1280,6 +1302,10 @@ zink_destroy_screen(struct pipe_screen *pscreen)
       util_queue_destroy(&screen->cache_get_thread);
    }
 #endif
+   if (util_queue_is_initialized(&screen->optimize_thread)) {
+      util_queue_finish(&screen->optimize_thread);
+      util_queue_destroy(&screen->optimize_thread);
+   }
    disk_cache_destroy(screen->disk_cache);
    zink_bo_deinit(screen);
    util_live_shader_cache_deinit(&screen->shaders);
@@ -1443,17 +1469,82 @@ zink_flush_frontbuffer(struct pipe_screen *pscreen,
    struct sw_winsys *winsys = screen->winsys;
 
    if (winsys && res->dt) {
+      pctx = &screen->copy_context->base;
+      unsigned width = u_minify(pres->width0, level);
+      unsigned height = u_minify(pres->height0, level);
+      unsigned stride = util_format_get_stride(pres->format, width);
+      unsigned idx = res->dt_readback_idx;
+
+      unsigned size = stride * util_format_get_nblocksy(pres->format, height);
+      struct pipe_box box;
+      u_box_3d(0, 0, layer, width, height, 1, &box);
       void *map = winsys->displaytarget_map(winsys, res->dt, 0);
 
-      if (map) {
+      /* if the displaytarget memory itself can be imported, copy straight into it */
+      if (map && map != res->dt_import_map && res->dt_stride == stride && pscreen->resource_from_user_memory) {
+         struct pipe_resource templ = {0};
+         templ.target = PIPE_BUFFER;
+         templ.format = PIPE_FORMAT_R8_UNORM;
+         templ.width0 = size;
+         templ.height0 = templ.depth0 = templ.array_size = 1;
+         templ.usage = PIPE_USAGE_STAGING;
+         templ.flags = PIPE_RESOURCE_FLAG_MAP_COHERENT;
+         pipe_resource_reference(&res->dt_import, NULL);
+         res->dt_import = pscreen->resource_from_user_memory(pscreen, &templ, map);
+         /* don't retry a failed import every frame */
+         res->dt_import_map = map;
+      }
+      if (!res->dt_import && !res->dt_readback[idx])
+         res->dt_readback[idx] = pipe_buffer_create(pscreen, 0, PIPE_USAGE_STAGING, size);
+
+      if (map && res->dt_import && map == res->dt_import_map) {
+         struct pipe_fence_handle *fence = NULL;
+         /* the displaytarget keeps everything outside the damage from the last
+          * present, so only the damaged rows need to come back; full rows keep
+          * the copy tightly packed
+          */
+         unsigned offset = 0;
+         if (sub_box) {
+            unsigned y0 = CLAMP(sub_box->y, 0, (int)height);
+            unsigned y1 = CLAMP(sub_box->y + sub_box->height, (int)y0, (int)height);
+            box.y = y0;
+            box.height = y1 - y0;
+            offset = y0 * stride;
+         }
+         if (box.height)
+            zink_copy_image_buffer(screen->copy_context, zink_resource(res->dt_import), res,
+                                   0, offset, 0, 0, level, &box, 0);
+         pctx->flush(pctx, &fence, 0);
+         if (fence) {
+            pscreen->fence_finish(pscreen, pctx, fence, PIPE_TIMEOUT_INFINITE);
+            pscreen->fence_reference(pscreen, &fence, NULL);
+         }
+         winsys->displaytarget_unmap(winsys, res->dt);
+      } else if (map && res->dt_readback[idx]) {
+         /* queue this frame's readback and display the oldest one in the ring:
+          * by the time frame N is presented, the copy for frame N-2 has almost
+          * always landed, so the map below doesn't drain the gpu every swap
+          */
+         struct pipe_transfer *transfer = NULL;
+         zink_copy_image_buffer(screen->copy_context, zink_resource(res->dt_readback[idx]), res,
+                                0, 0, 0, 0, level, &box, 0);
+         pctx->flush(pctx, NULL, 0);
+         res->dt_readback_idx = (idx + 1) % ZINK_DT_READBACK_COUNT;
+         res->dt_readback_count = MIN2(res->dt_readback_count + 1, ZINK_DT_READBACK_COUNT);
+         unsigned oldest = (idx + ZINK_DT_READBACK_COUNT + 1 - res->dt_readback_count) % ZINK_DT_READBACK_COUNT;
+
+         void *res_map = pipe_buffer_map(pctx, res->dt_readback[oldest], PIPE_MAP_READ, &transfer);
+         if (res_map) {
+            util_copy_rect((ubyte*)map, pres->format, res->dt_stride, 0, 0,
+                           width, height, (const ubyte*)res_map, stride, 0, 0);
+            pipe_buffer_unmap(pctx, transfer);
+         }
+         winsys->displaytarget_unmap(winsys, res->dt);
+      } else if (map) {
          struct pipe_transfer *transfer = NULL;
-	  
-	     pctx = &screen->copy_context->base;
-	  
+
          void *res_map = pipe_texture_map(pctx, pres, level, layer, PIPE_MAP_READ, 0, 0,
-                                          u_minify(pres->width0, level),
-                                          u_minify(pres->height0, level),
-                                          &transfer);
+                                          width, height, &transfer);
          if (res_map) {
             util_copy_rect((ubyte*)map, pres->format, res->dt_stride, 0, 0,
                            transfer->box.width, transfer->box.height,
@@ -1482,7 +1573,7 @@ zink_flush_frontbuffer(struct pipe_screen *pscreen,
       }
 
       if (zink_kopper_acquired(res->obj->dt, res->obj->dt_idx))
-         zink_kopper_present_queue(screen, res);
+         zink_kopper_present_queue(screen, res, sub_box);
       else {
          assert(res->obj->last_dt_idx != UINT32_MAX);
          if (!zink_kopper_last_present_eq(res->obj->dt, res->obj->last_dt_idx)) {
@@ -1816,6 +1907,20 @@ zink_screen_timeline_wait(struct zink_screen *screen, uint64_t batch_id, uint64_
    if (zink_screen_check_last_finished(screen, batch_id))
       return true;
 
+   if (!timeout) {
+      /* polling: reading the counter avoids a wait ioctl and retires every
+       * batch that has completed so far instead of only this one
+       */
+      uint64_t value;
+      if (screen->device_lost)
+         return true;
+      VkResult ret = VKSCR(GetSemaphoreCounterValue)(screen->dev, screen->sem, &value);
+      if (!zink_screen_handle_vkresult(screen, ret))
+         return false;
+      zink_screen_update_last_finished(screen, value);
+      return zink_screen_check_last_finished(screen, batch_id);
+   }
+
    wi.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
    wi.semaphoreCount = 1;
    wi.pSemaphores = &screen->sem;
@@ -1853,6 +1958,26 @@ zink_get_loader_version(struct zink_screen *screen)
    return loader_version;
 }
 
+/* whether allocating 'size' more bytes from the heap would exceed the budget
+ * the implementation currently grants this process
+ */
+bool
+zink_screen_heap_over_budget(struct zink_screen *screen, unsigned heap_idx, uint64_t size)
+{
+   if (!screen->info.have_EXT_memory_budget || !VKSCR(GetPhysicalDeviceMemoryProperties2))
+      return false;
+
+   VkPhysicalDeviceMemoryProperties2 mem = {0};
+   mem.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+
+   VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {0};
+   budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+   mem.pNext = &budget;
+   VKSCR(GetPhysicalDeviceMemoryProperties2)(screen->pdev, &mem);
+
+   return budget.heapUsage[heap_idx] + size > budget.heapBudget[heap_idx];
+}
+
 static void
 zink_query_memory_info(struct pipe_screen *pscreen, struct pipe_memory_info *info)
 {
@@ -2176,6 +2301,8 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
       abort();
    }
 
+   util_cpu_trace_init();
+
    screen->loader_lib = util_dl_open(VK_LIBNAME);
    if (!screen->loader_lib)
       goto fail;
@@ -2194,8 +2321,12 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
       screen->driconf.dual_color_blend_by_location = driQueryOptionb(config->options, "dual_color_blend_by_location");
       //screen->driconf.inline_uniforms = driQueryOptionb(config->options, "radeonsi_inline_uniforms");
       screen->instance_info.disable_xcb_surface = driQueryOptionb(config->options, "disable_xcb_surface");
+      screen->driconf.context_threaded = driQueryOptionb(config->options, "zink_context_threaded");
    }
 #endif
+   /* the environment overrides the application profile */
+   screen->driconf.context_threaded =
+      debug_get_bool_option("ZINK_CONTEXT_THREADED", screen->driconf.context_threaded);
 
    if (!zink_create_instance(screen))
       goto fail;
@@ -2231,7 +2362,9 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
       goto fail;
    }
 
-   if (screen->threaded && !util_queue_init(&screen->flush_queue, "zfq", 8, 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL, screen)) {
+   if (screen->threaded && !util_queue_init(&screen->flush_queue, "zfq", 8, 1,
+                                            UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                                            UTIL_QUEUE_INIT_PREFER_BIG_CORES, screen)) {
       mesa_loge("zink: Failed to create flush queue.\n");
       goto fail;
    }
@@ -2244,6 +2377,17 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
 
    init_driver_workarounds(screen);
 
+   /* pipeline libraries are only useful if everything which differs between draws of a
+    * program is either dynamic or in the vertex input/fragment output parts
+    */
+   if (screen->info.have_EXT_graphics_pipeline_library)
+      screen->info.have_EXT_graphics_pipeline_library = screen->info.have_KHR_pipeline_library &&
+                                                        screen->info.have_EXT_extended_dynamic_state &&
+                                                        screen->info.have_EXT_extended_dynamic_state2 &&
+                                                        screen->info.dynamic_state2_feats.extendedDynamicState2PatchControlPoints &&
+                                                        screen->info.have_KHR_dynamic_rendering &&
+                                                        screen->info.gpl_props.graphicsPipelineLibraryFastLinking;
+
    screen->dev = zink_create_logical_device(screen);
    if (!screen->dev)
       goto fail;
@@ -2311,6 +2455,7 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
    screen->base.get_device_vendor = zink_get_device_vendor;
    screen->base.get_compute_param = zink_get_compute_param;
    screen->base.get_timestamp = zink_get_timestamp;
+   screen->base.get_driver_query_info = zink_get_driver_query_info;
    screen->base.query_memory_info = zink_query_memory_info;
    screen->base.get_param = zink_get_param;
    screen->base.get_paramf = zink_get_paramf;
@@ -2354,6 +2499,11 @@ zink_internal_create_screen(const struct pipe_screen_config *config)
    zink_screen_init_compiler(screen);
    if (!disk_cache_init(screen))
       goto fail;
+   if (!util_queue_init(&screen->optimize_thread, "zopt", 64, MAX2(util_get_cpu_caps()->nr_cpus / 2, 1),
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL | UTIL_QUEUE_INIT_SCALE_THREADS, screen)) {
+      mesa_loge("zink: Failed to create background compile queue\n");
+      goto fail;
+   }
    populate_format_props(screen);
    pre_hash_descriptor_states(screen);
 
@@ -70,6 +70,7 @@ enum zink_debug {
    ZINK_DEBUG_SYNC = (1<<4),
    ZINK_DEBUG_COMPACT = (1<<5),
    ZINK_DEBUG_NOREORDER = (1<<6),
+   ZINK_DEBUG_NORETILE = (1<<7),
 };
 
 #define NUM_SLAB_ALLOCATORS 3
@@ -90,6 +91,14 @@ extern enum zink_descriptor_mode zink_descriptor_mode;
 //keep in sync with zink_descriptor_type since headers can't be cross-included
 #define ZINK_MAX_DESCRIPTOR_SETS 6
 
+/* what a resource object's memory is used for, see zink_screen::mem_stats */
+enum zink_mem_category {
+   ZINK_MEM_BUFFER,
+   ZINK_MEM_IMAGE,
+   ZINK_MEM_STAGING,
+   ZINK_MEM_COUNT,
+};
+
 struct zink_modifier_prop {
     uint32_t                             drmFormatModifierCount;
     VkDrmFormatModifierPropertiesEXT*    pDrmFormatModifierProperties;
@@ -106,6 +115,7 @@ struct zink_screen {
    bool is_cpu;
    bool abort_on_hang;
    uint64_t curr_batch; //the current batch id
+   uint64_t batch_gen; //source of zink_batch_state::gen
    uint32_t last_finished;
    VkSemaphore sem;
    VkFence fence;
@@ -129,6 +139,7 @@ struct zink_screen {
    struct disk_cache *disk_cache;
    struct util_queue cache_put_thread;
    struct util_queue cache_get_thread;
+   struct util_queue optimize_thread; //link-time shader precompiles and GPL optimized pipeline links
 
    struct util_live_shader_cache shaders;
 
@@ -138,6 +149,15 @@ struct zink_screen {
       unsigned min_alloc_size;
       uint32_t next_bo_unique_id;
    } pb;
+   /* always-on memory accounting, dumped with ZINK_MEM_STATS=<frames> */
+   struct {
+      uint64_t size[ZINK_MEM_COUNT]; //resource objects
+      uint32_t count[ZINK_MEM_COUNT];
+      uint64_t allocated; //VkDeviceMemory, including slabs and cached bos
+      bool dump;
+      unsigned dump_period;
+      unsigned frame;
+   } mem_stats;
    uint8_t heap_map[VK_MAX_MEMORY_TYPES];
    VkMemoryPropertyFlags heap_flags[VK_MAX_MEMORY_TYPES];
    bool resizable_bar;
@@ -197,6 +217,7 @@ struct zink_screen {
    struct {
       bool dual_color_blend_by_location;
       bool inline_uniforms;
+      bool context_threaded;
    } driconf;
 
    VkFormatProperties format_props[PIPE_FORMAT_COUNT];
@@ -299,6 +320,9 @@ zink_get_format(struct zink_screen *screen, enum pipe_format format);
 bool
 zink_screen_timeline_wait(struct zink_screen *screen, uint64_t batch_id, uint64_t timeout);
 
+bool
+zink_screen_heap_over_budget(struct zink_screen *screen, unsigned heap_idx, uint64_t size);
+
 bool
 zink_is_depth_format_supported(struct zink_screen *screen, VkFormat format);
 
@@ -234,6 +234,9 @@ static void
 zink_delete_vertex_elements_state(struct pipe_context *pctx,
                                   void *ves)
 {
+   struct zink_context *ctx = zink_context(pctx);
+   if (ctx->vertex_input == &((struct zink_vertex_elements_state *)ves)->hw_state)
+      ctx->vertex_input = NULL;
    FREE(ves);
 }
 
@@ -716,7 +719,8 @@ zink_create_vertex_state(struct pipe_screen *pscreen,
          elems->hw_state.dynbindings[i].stride = buffer->stride;
    }
    zstate->velems = *elems;
-   zink_delete_vertex_elements_state(&ctx.base, elems);
+   /* not through zink_delete_vertex_elements_state(): ctx is only a stub */
+   FREE(elems);
 
    return &zstate->b;
 }
@@ -197,13 +197,114 @@ hash_ivci(const void *key)
    return _mesa_hash_data((char*)key + offsetof(VkImageViewCreateInfo, flags), sizeof(VkImageViewCreateInfo) - offsetof(VkImageViewCreateInfo, flags));
 }
 
+/* pack everything equals_ivci() compares except the image into 64 bits:
+ *
+ *  0-15  format (extension formats compacted)
+ * 16-18  viewType
+ * 19-30  swizzles
+ * 31-33  aspects
+ * 34-41  base level, level count - 1
+ * 42-63  base layer, layer count - 1
+ *
+ * returns 0 for views that don't fit, which then only use the hash table
+ */
+static uint64_t
+surface_key(const VkImageViewCreateInfo *ivci)
+{
+   const VkImageSubresourceRange *range = &ivci->subresourceRange;
+   uint32_t format = ivci->format;
+
+   /* extension enums are 1000000000 + (extension - 1) * 1000 + offset */
+   if (format >= 1000000000) {
+      uint32_t ext = (format - 1000000000) / 1000;
+      uint32_t offset = format % 1000;
+      if (ext >= 512 || offset >= 64)
+         return 0;
+      format = 0x8000 | ext << 6 | offset;
+   } else if (format >= 0x8000) {
+      return 0;
+   }
+
+   if (ivci->flags || ivci->viewType > 7 ||
+       range->aspectMask & ~(VK_IMAGE_ASPECT_COLOR_BIT |
+                             VK_IMAGE_ASPECT_DEPTH_BIT |
+                             VK_IMAGE_ASPECT_STENCIL_BIT) ||
+       range->baseMipLevel >= 16 || range->levelCount - 1 >= 16 ||
+       range->baseArrayLayer >= 2048 || range->layerCount - 1 >= 2048)
+      return 0;
+
+   const VkComponentSwizzle *swizzle = (const VkComponentSwizzle *)&ivci->components;
+   uint64_t key = format | (uint64_t)ivci->viewType << 16;
+   for (unsigned i = 0; i < 4; i++) {
+      if (swizzle[i] > 7)
+         return 0;
+      key |= (uint64_t)swizzle[i] << (19 + i * 3);
+   }
+   key |= (uint64_t)range->aspectMask << 31;
+   key |= (uint64_t)range->baseMipLevel << 34;
+   key |= (uint64_t)(range->levelCount - 1) << 38;
+   key |= (uint64_t)range->baseArrayLayer << 42;
+   key |= (uint64_t)(range->layerCount - 1) << 53;
+   return key;
+}
+
+/* the surface cache functions need res->surface_mtx held */
 static struct zink_surface *
-do_create_surface(struct pipe_context *pctx, struct pipe_resource *pres, const struct pipe_surface *templ, VkImageViewCreateInfo *ivci, uint32_t hash, bool actually)
+surface_cache_search(struct zink_resource *res, const VkImageViewCreateInfo *ivci, uint64_t key)
+{
+   if (key) {
+      for (unsigned i = 0; i < ARRAY_SIZE(res->surfaces); i++) {
+         struct zink_surface *surface = res->surfaces[i];
+         if (surface && surface->key == key && surface->ivci.image == ivci->image)
+            return surface;
+      }
+   }
+   if (!_mesa_hash_table_num_entries(&res->surface_cache))
+      return NULL;
+   struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(&res->surface_cache, hash_ivci(ivci), ivci);
+   return entry ? entry->data : NULL;
+}
+
+static bool
+surface_cache_insert(struct zink_resource *res, struct zink_surface *surface)
+{
+   if (surface->key) {
+      for (unsigned i = 0; i < ARRAY_SIZE(res->surfaces); i++) {
+         if (!res->surfaces[i]) {
+            res->surfaces[i] = surface;
+            return true;
+         }
+      }
+   }
+   return _mesa_hash_table_insert_pre_hashed(&res->surface_cache, surface->hash, &surface->ivci, surface) != NULL;
+}
+
+static void
+surface_cache_remove(struct zink_resource *res, struct zink_surface *surface)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(res->surfaces); i++) {
+      if (res->surfaces[i] == surface) {
+         res->surfaces[i] = NULL;
+         return;
+      }
+   }
+   struct hash_entry *he = _mesa_hash_table_search_pre_hashed(&res->surface_cache, surface->hash, &surface->ivci);
+   assert(he);
+   assert(he->data == surface);
+   _mesa_hash_table_remove(&res->surface_cache, he);
+}
+
+static struct zink_surface *
+do_create_surface(struct pipe_context *pctx, struct pipe_resource *pres, const struct pipe_surface *templ, VkImageViewCreateInfo *ivci, uint64_t key, bool actually)
 {
    /* create a new surface */
    struct zink_surface *surface = create_surface(pctx, pres, templ, ivci, actually);
+   if (!surface)
+      return NULL;
    surface->base.nr_samples = 0;
-   surface->hash = hash;
+   /* the hash is also what descriptor caching identifies the view by */
+   surface->hash = hash_ivci(ivci);
+   surface->key = key;
    surface->ivci = *ivci;
    return surface;
 }
@@ -216,23 +317,19 @@ zink_get_surface(struct zink_context *ctx,
 {
    struct zink_surface *surface = NULL;
    struct zink_resource *res = zink_resource(pres);
-   uint32_t hash = hash_ivci(ivci);
+   uint64_t key = surface_key(ivci);
 
    simple_mtx_lock(&res->surface_mtx);
-   struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(&res->surface_cache, hash, ivci);
+   surface = surface_cache_search(res, ivci, key);
 
-   if (!entry) {
+   if (!surface) {
       /* create a new surface */
-      surface = do_create_surface(&ctx->base, pres, templ, ivci, hash, true);
-      entry = _mesa_hash_table_insert_pre_hashed(&res->surface_cache, hash, &surface->ivci, surface);
-      if (!entry) {
+      surface = do_create_surface(&ctx->base, pres, templ, ivci, key, true);
+      if (!surface || !surface_cache_insert(res, surface)) {
          simple_mtx_unlock(&res->surface_mtx);
          return NULL;
       }
-
-      surface = entry->data;
    } else {
-      surface = entry->data;
       p_atomic_inc(&surface->base.reference.count);
    }
    simple_mtx_unlock(&res->surface_mtx);
@@ -311,10 +408,7 @@ zink_destroy_surface(struct zink_screen *screen, struct pipe_surface *psurface)
          simple_mtx_unlock(&res->surface_mtx);
          return;
       }
-      struct hash_entry *he = _mesa_hash_table_search_pre_hashed(&res->surface_cache, surface->hash, &surface->ivci);
-      assert(he);
-      assert(he->data == surface);
-      _mesa_hash_table_remove(&res->surface_cache, he);
+      surface_cache_remove(res, surface);
       simple_mtx_unlock(&res->surface_mtx);
    }
    zink_descriptor_set_refs_clear(&surface->desc_set_refs, surface);
@@ -353,24 +447,19 @@ zink_rebind_surface(struct zink_context *ctx, struct pipe_surface **psurface)
    assert(!res->obj->dt);
    VkImageViewCreateInfo ivci = surface->ivci;
    ivci.image = res->obj->image;
-   uint32_t hash = hash_ivci(&ivci);
 
    simple_mtx_lock(&res->surface_mtx);
-   struct hash_entry *new_entry = _mesa_hash_table_search_pre_hashed(&res->surface_cache, hash, &ivci);
+   struct zink_surface *new_surface = surface_cache_search(res, &ivci, surface->key);
    if (zink_batch_usage_exists(surface->batch_uses))
       zink_batch_reference_surface(&ctx->batch, surface);
    zink_descriptor_set_refs_clear(&surface->desc_set_refs, surface);
-   if (new_entry) {
+   if (new_surface) {
       /* reuse existing surface; old one will be cleaned up naturally */
-      struct zink_surface *new_surface = new_entry->data;
       simple_mtx_unlock(&res->surface_mtx);
       zink_batch_usage_set(&new_surface->batch_uses, ctx->batch.state);
       zink_surface_reference(screen, (struct zink_surface**)psurface, new_surface);
       return true;
    }
-   struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(&res->surface_cache, surface->hash, &surface->ivci);
-   assert(entry);
-   _mesa_hash_table_remove(&res->surface_cache, entry);
    VkImageView image_view;
    VkResult result = VKSCR(CreateImageView)(screen->dev, &ivci, NULL, &image_view);
    if (result != VK_SUCCESS) {
@@ -378,10 +467,12 @@ zink_rebind_surface(struct zink_context *ctx, struct pipe_surface **psurface)
       simple_mtx_unlock(&res->surface_mtx);
       return false;
    }
-   surface->hash = hash;
+   /* the key doesn't depend on the image, but the hash does */
+   surface_cache_remove(res, surface);
+   surface->hash = hash_ivci(&ivci);
    surface->ivci = ivci;
-   entry = _mesa_hash_table_insert_pre_hashed(&res->surface_cache, surface->hash, &surface->ivci, surface);
-   assert(entry);
+   ASSERTED bool inserted = surface_cache_insert(res, surface);
+   assert(inserted);
    surface->simage_view = surface->image_view;
    surface->image_view = image_view;
    surface->obj = zink_resource(surface->base.texture)->obj;
@@ -53,6 +53,7 @@ struct zink_surface {
    unsigned old_swapchain_size;
    VkImageView simage_view;//old iview after storage replacement/rebind
    void *obj; //backing resource object
+   uint64_t key; //for surface caching, 0 if the ivci doesn't fit
    uint32_t hash;
    struct zink_batch_usage *batch_uses;
    struct zink_descriptor_refs desc_set_refs;
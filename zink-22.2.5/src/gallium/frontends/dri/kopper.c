@@ -700,9 +700,10 @@ kopper_present_texture(struct pipe_context *pipe, __DRIdrawable *dPriv,
 static inline void
 kopper_copy_to_front(struct pipe_context *pipe,
                     __DRIdrawable * dPriv,
-                    struct pipe_resource *ptex)
+                    struct pipe_resource *ptex,
+                    struct pipe_box *sub_box)
 {
-   kopper_present_texture(pipe, dPriv, ptex, NULL);
+   kopper_present_texture(pipe, dPriv, ptex, sub_box);
 
    kopper_invalidate_drawable(dPriv);
 }
@@ -752,7 +753,7 @@ kopper_flush_frontbuffer(struct dri_context *ctx,
          screen->fence_reference(screen, &drawable->throttle_fence, NULL);
       }
       drawable->throttle_fence = new_fence;
-      kopper_copy_to_front(st->pipe, ctx->dPriv, ptex);
+      kopper_copy_to_front(st->pipe, ctx->dPriv, ptex, NULL);
    }
 
    return true;
@@ -898,12 +899,13 @@ kopper_create_buffer(__DRIscreen * sPriv,
 }
 
 static int64_t
-kopperSwapBuffers(__DRIdrawable *dPriv)
+kopperSwapBuffersWithDamage(__DRIdrawable *dPriv, int nrects, const int *rects)
 {
    struct dri_context *ctx = dri_get_current(dPriv->driScreenPriv);
    struct dri_drawable *drawable = dri_drawable(dPriv);
    struct kopper_drawable *kdraw = (struct kopper_drawable *)drawable;
    struct pipe_resource *ptex;
+   struct pipe_box damage;
 
    if (!ctx)
       return 0;
@@ -914,7 +916,23 @@ kopperSwapBuffers(__DRIdrawable *dPriv)
 
    drawable->texture_stamp = dPriv->lastStamp - 1;
    dri_flush(ctx->cPriv, dPriv, __DRI2_FLUSH_DRAWABLE | __DRI2_FLUSH_CONTEXT, __DRI2_THROTTLE_SWAPBUFFER);
-   kopper_copy_to_front(ctx->st->pipe, dPriv, ptex);
+   /* the presentation engine takes a hint for the damaged area: pass it
+    * the bounding box, converted from the bottom-left origin of the rects
+    */
+   if (nrects > 0) {
+      int x0 = rects[0], y0 = dPriv->h - rects[1] - rects[3];
+      int x1 = rects[0] + rects[2], y1 = dPriv->h - rects[1];
+      for (int i = 1; i < nrects; i++) {
+         const int *rect = &rects[i * 4];
+         x0 = MIN2(x0, rect[0]);
+         y0 = MIN2(y0, dPriv->h - rect[1] - rect[3]);
+         x1 = MAX2(x1, rect[0] + rect[2]);
+         y1 = MAX2(y1, dPriv->h - rect[1]);
+      }
+      u_box_2d(x0, y0, x1 - x0, y1 - y0, &damage);
+   }
+
+   kopper_copy_to_front(ctx->st->pipe, dPriv, ptex, nrects > 0 ? &damage : NULL);
    if (kdraw->is_window && !zink_kopper_check(ptex))
       return -1;
    if (!drawable->textures[ST_ATTACHMENT_FRONT_LEFT]) {
@@ -928,6 +946,12 @@ kopperSwapBuffers(__DRIdrawable *dPriv)
    return 0;
 }
 
+static int64_t
+kopperSwapBuffers(__DRIdrawable *dPriv)
+{
+   return kopperSwapBuffersWithDamage(dPriv, 0, NULL);
+}
+
 static void
 kopper_swap_buffers(__DRIdrawable *dPriv)
 {
@@ -1005,11 +1029,12 @@ kopperQueryBufferAge(__DRIdrawable *dPriv)
 }
 
 const __DRIkopperExtension driKopperExtension = {
-   .base = { __DRI_KOPPER, 1 },
+   .base = { __DRI_KOPPER, 2 },
    .createNewDrawable          = kopperCreateNewDrawable,
    .swapBuffers                = kopperSwapBuffers,
    .setSwapInterval            = kopperSetSwapInterval,
    .queryBufferAge             = kopperQueryBufferAge,
+   .swapBuffersWithDamage      = kopperSwapBuffersWithDamage,
 };
 
 const struct __DriverAPIRec galliumvk_driver_api = {
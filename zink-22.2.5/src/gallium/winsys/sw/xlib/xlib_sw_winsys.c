@@ -32,6 +32,7 @@
  *   Brian Paul
  */
 
+#include "c11/threads.h"
 #include "pipe/p_format.h"
 #include "pipe/p_context.h"
 #include "util/u_inlines.h"
@@ -48,8 +49,12 @@
 #include <sys/ipc.h>
 #include <sys/shm.h>
 #include <X11/extensions/XShm.h>
+#include <string.h>
 
 DEBUG_GET_ONCE_BOOL_OPTION(xlib_no_shm, "XLIB_NO_SHM", false)
+DEBUG_GET_ONCE_BOOL_OPTION(xlib_sync_display, "XLIB_SYNC_DISPLAY", false)
+
+struct xlib_display_worker;
 
 /**
  * Display target for Xlib winsys.
@@ -77,6 +82,18 @@ struct xlib_displaytarget
 
    XShmSegmentInfo shminfo;
    Bool shm;  /** Using shared memory images? */
+
+   /* Copy of the last displayed contents that the display worker puts
+    * from, and its X resources on the worker's connection.  Only touched
+    * while no job is in flight.
+    */
+   struct xlib_display_worker *worker;
+   void *present_data;
+   XImage *present_image;
+   GC present_gc;
+   Drawable present_drawable;
+   XShmSegmentInfo present_shminfo;
+   Bool present_shm;
 };
 
 
@@ -87,6 +104,7 @@ struct xlib_sw_winsys
 {
    struct sw_winsys base;
    Display *display;
+   struct xlib_display_worker *worker;
 };
 
 
@@ -118,6 +136,310 @@ handle_xerror(Display *dpy, XErrorEvent *event)
 }
 
 
+/**
+ * Display worker.
+ *
+ * Images are put by a thread on a private connection to the same server,
+ * so the app's Display doesn't need to be thread-safe.  The GL thread only
+ * copies the displayed box into the display target's present buffer and
+ * returns; the worker puts that buffer and waits for the server to have
+ * read it before accepting the next job.
+ */
+struct xlib_display_worker
+{
+   Display *display;
+   thrd_t thread;
+   mtx_t mutex;
+   cnd_t cond;
+   unsigned refcount;
+   bool quit;
+   bool error;
+
+   /* The job in flight, NULL when the worker is idle. */
+   struct xlib_displaytarget *dt;
+   struct xlib_drawable drawable;
+   struct pipe_box box;
+};
+
+static mtx_t worker_mutex = _MTX_INITIALIZER_NP;
+static struct xlib_display_worker *worker;
+static int (*worker_old_handler)(Display *, XErrorEvent *);
+
+static int
+handle_worker_xerror(Display *dpy, XErrorEvent *event)
+{
+   /* Errors on the worker's own connection, e.g. for a window that went
+    * away while its image was queued, are not fatal.
+    */
+   if (worker && dpy == worker->display) {
+      worker->error = true;
+      return 0;
+   }
+
+   return worker_old_handler ? worker_old_handler(dpy, event) : 0;
+}
+
+static void
+worker_put(struct xlib_display_worker *w, struct xlib_displaytarget *xlib_dt,
+           const struct xlib_drawable *drawable, const struct pipe_box *box)
+{
+   Display *display = w->display;
+
+   if (xlib_dt->present_drawable != drawable->drawable) {
+      if (xlib_dt->present_gc)
+         XFreeGC(display, xlib_dt->present_gc);
+      if (xlib_dt->present_image) {
+         xlib_dt->present_image->data = NULL;
+         XDestroyImage(xlib_dt->present_image);
+         xlib_dt->present_image = NULL;
+      }
+
+      xlib_dt->present_gc = XCreateGC(display, drawable->drawable, 0, NULL);
+      XSetFunction(display, xlib_dt->present_gc, GXcopy);
+      xlib_dt->present_drawable = drawable->drawable;
+   }
+
+   if (xlib_dt->present_image == NULL) {
+      unsigned width =
+         xlib_dt->stride / util_format_get_blocksize(xlib_dt->format);
+
+      if (xlib_dt->present_shm) {
+         xlib_dt->present_image =
+            XShmCreateImage(display, drawable->visual, drawable->depth,
+                            ZPixmap, xlib_dt->present_data,
+                            &xlib_dt->present_shminfo,
+                            width, xlib_dt->height);
+      } else {
+         xlib_dt->present_image =
+            XCreateImage(display, drawable->visual, drawable->depth,
+                         ZPixmap, 0, xlib_dt->present_data,
+                         width, xlib_dt->height, 8, xlib_dt->stride);
+      }
+      if (!xlib_dt->present_image)
+         return;
+   }
+
+   if (xlib_dt->present_shm) {
+      XShmPutImage(display, drawable->drawable, xlib_dt->present_gc,
+                   xlib_dt->present_image, box->x, box->y, box->x, box->y,
+                   box->width, box->height, False);
+   } else {
+      XPutImage(display, drawable->drawable, xlib_dt->present_gc,
+                xlib_dt->present_image, box->x, box->y, box->x, box->y,
+                box->width, box->height);
+   }
+
+   /* The present buffer can be reused once the server has read it. */
+   XSync(display, False);
+}
+
+static int
+worker_thread(void *data)
+{
+   struct xlib_display_worker *w = data;
+
+   mtx_lock(&w->mutex);
+   while (true) {
+      while (!w->dt && !w->quit)
+         cnd_wait(&w->cond, &w->mutex);
+      if (!w->dt)
+         break;
+
+      struct xlib_displaytarget *xlib_dt = w->dt;
+      struct xlib_drawable drawable = w->drawable;
+      struct pipe_box box = w->box;
+      mtx_unlock(&w->mutex);
+
+      worker_put(w, xlib_dt, &drawable, &box);
+
+      mtx_lock(&w->mutex);
+      w->dt = NULL;
+      cnd_broadcast(&w->cond);
+   }
+   mtx_unlock(&w->mutex);
+
+   return 0;
+}
+
+static struct xlib_display_worker *
+worker_get(Display *display)
+{
+   struct xlib_display_worker *w = NULL;
+
+   if (debug_get_option_xlib_sync_display())
+      return NULL;
+
+   mtx_lock(&worker_mutex);
+
+   if (worker) {
+      /* Only one worker connection, other servers display synchronously. */
+      if (!strcmp(DisplayString(worker->display), DisplayString(display))) {
+         worker->refcount++;
+         w = worker;
+      }
+      goto out;
+   }
+
+   w = CALLOC_STRUCT(xlib_display_worker);
+   if (!w)
+      goto out;
+
+   w->display = XOpenDisplay(DisplayString(display));
+   if (!w->display)
+      goto fail;
+
+   mtx_init(&w->mutex, mtx_plain);
+   cnd_init(&w->cond);
+   if (thrd_create(&w->thread, worker_thread, w) != thrd_success) {
+      cnd_destroy(&w->cond);
+      mtx_destroy(&w->mutex);
+      XCloseDisplay(w->display);
+      goto fail;
+   }
+
+   w->refcount = 1;
+   worker = w;
+   worker_old_handler = XSetErrorHandler(handle_worker_xerror);
+   goto out;
+
+fail:
+   FREE(w);
+   w = NULL;
+out:
+   mtx_unlock(&worker_mutex);
+   return w;
+}
+
+static void
+worker_put_ref(struct xlib_display_worker *w)
+{
+   mtx_lock(&worker_mutex);
+
+   if (--w->refcount == 0) {
+      mtx_lock(&w->mutex);
+      w->quit = true;
+      cnd_broadcast(&w->cond);
+      mtx_unlock(&w->mutex);
+      thrd_join(w->thread, NULL);
+
+      worker = NULL;
+      XCloseDisplay(w->display);
+      cnd_destroy(&w->cond);
+      mtx_destroy(&w->mutex);
+      FREE(w);
+   }
+
+   mtx_unlock(&worker_mutex);
+}
+
+static bool
+alloc_present_buffer(struct xlib_display_worker *w,
+                     struct xlib_displaytarget *xlib_dt)
+{
+   XShmSegmentInfo *const shminfo = &xlib_dt->present_shminfo;
+   unsigned size = xlib_dt->stride *
+                   util_format_get_nblocksy(xlib_dt->format, xlib_dt->height);
+
+   shminfo->shmid = -1;
+   shminfo->shmaddr = (char *) -1;
+
+   if (xlib_dt->shm) {
+      shminfo->shmid = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+      if (shminfo->shmid >= 0)
+         shminfo->shmaddr = (char *) shmat(shminfo->shmid, 0, 0);
+
+      if (shminfo->shmaddr != (char *) -1) {
+         int (*old_handler)(Display *, XErrorEvent *);
+
+         shminfo->readOnly = False;
+         w->error = false;
+         old_handler = XSetErrorHandler(handle_worker_xerror);
+         XShmAttach(w->display, shminfo);
+         XSync(w->display, False);
+         (void) XSetErrorHandler(old_handler);
+
+         if (!w->error) {
+            xlib_dt->present_data = shminfo->shmaddr;
+            xlib_dt->present_shm = True;
+         } else {
+            shmdt(shminfo->shmaddr);
+            shminfo->shmaddr = (char *) -1;
+         }
+      }
+
+      if (shminfo->shmid >= 0)
+         shmctl(shminfo->shmid, IPC_RMID, 0);
+   }
+
+   if (!xlib_dt->present_data)
+      xlib_dt->present_data = align_malloc(size, 64);
+
+   return xlib_dt->present_data != NULL;
+}
+
+static void
+free_present_buffer(struct xlib_display_worker *w,
+                    struct xlib_displaytarget *xlib_dt)
+{
+   mtx_lock(&w->mutex);
+   while (w->dt)
+      cnd_wait(&w->cond, &w->mutex);
+
+   if (xlib_dt->present_image) {
+      xlib_dt->present_image->data = NULL;
+      XDestroyImage(xlib_dt->present_image);
+   }
+   if (xlib_dt->present_gc)
+      XFreeGC(w->display, xlib_dt->present_gc);
+
+   if (xlib_dt->present_shm) {
+      XShmDetach(w->display, &xlib_dt->present_shminfo);
+      shmdt(xlib_dt->present_shminfo.shmaddr);
+   } else {
+      align_free(xlib_dt->present_data);
+   }
+   XFlush(w->display);
+
+   mtx_unlock(&w->mutex);
+}
+
+/**
+ * Hand the box off to the display worker.  Only waits if the previous
+ * job hasn't completed yet.
+ */
+static bool
+xlib_sw_display_async(struct xlib_drawable *xlib_drawable,
+                      struct xlib_displaytarget *xlib_dt,
+                      const struct pipe_box *box)
+{
+   struct xlib_display_worker *w = xlib_dt->worker;
+   unsigned cpp = util_format_get_blocksize(xlib_dt->format);
+
+   mtx_lock(&w->mutex);
+   while (w->dt)
+      cnd_wait(&w->cond, &w->mutex);
+
+   if (!xlib_dt->present_data && !alloc_present_buffer(w, xlib_dt)) {
+      mtx_unlock(&w->mutex);
+      return false;
+   }
+
+   for (int y = box->y; y < box->y + box->height; y++) {
+      unsigned offset = y * xlib_dt->stride + box->x * cpp;
+      memcpy((char *) xlib_dt->present_data + offset,
+             (char *) xlib_dt->data + offset, box->width * cpp);
+   }
+
+   w->dt = xlib_dt;
+   w->drawable = *xlib_drawable;
+   w->box = *box;
+   cnd_broadcast(&w->cond);
+   mtx_unlock(&w->mutex);
+
+   return true;
+}
+
+
 static char *
 alloc_shm(struct xlib_displaytarget *buf, unsigned size)
 {
@@ -261,6 +583,9 @@ xlib_displaytarget_destroy(struct sw_winsys *ws,
 {
    struct xlib_displaytarget *xlib_dt = xlib_displaytarget(dt);
 
+   if (xlib_dt->present_data)
+      free_present_buffer(xlib_dt->worker, xlib_dt);
+
    if (xlib_dt->data) {
       if (xlib_dt->shminfo.shmid >= 0) {
          shmdt(xlib_dt->shminfo.shmaddr);
@@ -324,6 +649,9 @@ xlib_sw_display(struct xlib_drawable *xlib_drawable,
       box = &_box;
    }
 
+   if (xlib_dt->worker && xlib_sw_display_async(xlib_drawable, xlib_dt, box))
+      return;
+
    if (xlib_dt->drawable != xlib_drawable->drawable) {
       if (xlib_dt->gc) {
          XFreeGC(display, xlib_dt->gc);
@@ -419,6 +747,7 @@ xlib_displaytarget_create(struct sw_winsys *winsys,
       goto no_xlib_dt;
 
    xlib_dt->display = ((struct xlib_sw_winsys *)winsys)->display;
+   xlib_dt->worker = ((struct xlib_sw_winsys *)winsys)->worker;
    xlib_dt->format = format;
    xlib_dt->width = width;
    xlib_dt->height = height;
@@ -475,6 +804,11 @@ xlib_displaytarget_get_handle(struct sw_winsys *winsys,
 static void
 xlib_destroy(struct sw_winsys *ws)
 {
+   struct xlib_sw_winsys *xlib_ws = (struct xlib_sw_winsys *)ws;
+
+   if (xlib_ws->worker)
+      worker_put_ref(xlib_ws->worker);
+
    FREE(ws);
 }
 
@@ -489,6 +823,7 @@ xlib_create_sw_winsys(Display *display)
       return NULL;
 
    ws->display = display;
+   ws->worker = worker_get(display);
    ws->base.destroy = xlib_destroy;
 
    ws->base.is_displaytarget_format_supported = xlib_is_displaytarget_format_supported;
@@ -179,6 +179,16 @@ struct disk_cache *
 disk_cache_create(const char *gpu_name, const char *timestamp,
                   uint64_t driver_flags);
 
+/**
+ * Like disk_cache_create(), but defaults to the single-file (fossilize)
+ * backend, which keeps all entries in one database file instead of one file
+ * per entry.  Meant for users that store many small items.
+ * MESA_DISK_CACHE_SINGLE_FILE=false selects the multi-file cache.
+ */
+struct disk_cache *
+disk_cache_create_single_file(const char *gpu_name, const char *timestamp,
+                              uint64_t driver_flags);
+
 /**
  * Destroy a cache object, (freeing all associated resources).
  */
@@ -288,6 +298,13 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+static inline struct disk_cache *
+disk_cache_create_single_file(const char *gpu_name, const char *timestamp,
+                              uint64_t driver_flags)
+{
+   return NULL;
+}
+
 static inline void
 disk_cache_destroy(struct disk_cache *cache) {
    return;
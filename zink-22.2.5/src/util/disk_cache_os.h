@@ -48,6 +48,9 @@ struct disk_cache {
    char *path;
    bool path_init_failed;
 
+   /* Entries are kept in a single fossilize database instead of one file each */
+   bool single_file;
+
    /* Thread queue for compressing and writing cache entries to disk */
    struct util_queue cache_queue;
 
@@ -95,7 +98,7 @@ struct disk_cache_put_job {
 
 char *
 disk_cache_generate_cache_dir(void *mem_ctx, const char *gpu_name,
-                              const char *driver_id);
+                              const char *driver_id, bool single_file);
 
 void
 disk_cache_evict_lru_item(struct disk_cache *cache);
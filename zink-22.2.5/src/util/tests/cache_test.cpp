@@ -573,3 +573,42 @@ TEST_F(Cache, SingleFile)
    EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
 #endif
 }
+
+TEST_F(Cache, SingleFileByDefault)
+{
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   struct disk_cache *cache;
+   int err;
+
+   unsetenv("MESA_DISK_CACHE_SINGLE_FILE");
+   setenv("MESA_SHADER_CACHE_DIR", CACHE_TEST_TMP "/mesa-shader-cache-dir", 1);
+
+   err = mkdir(CACHE_TEST_TMP, 0755);
+   if (err != 0) {
+      fprintf(stderr, "Error creating %s: %s\n", CACHE_TEST_TMP, strerror(errno));
+      GTEST_FAIL();
+   }
+
+   cache = disk_cache_create_single_file("test", "make_check", 0);
+   EXPECT_TRUE(cache_exists(cache)) << "disk_cache_create_single_file with no backend selected";
+   check_directories_created(mem_ctx,
+                             CACHE_TEST_TMP "/mesa-shader-cache-dir/" CACHE_DIR_NAME_SF "/make_check/test");
+   disk_cache_destroy(cache);
+
+   /* Explicitly disabling the single file cache still selects the multi-file cache. */
+   setenv("MESA_DISK_CACHE_SINGLE_FILE", "false", 1);
+
+   cache = disk_cache_create_single_file("test", "make_check", 0);
+   EXPECT_TRUE(cache_exists(cache)) << "disk_cache_create_single_file with MESA_DISK_CACHE_SINGLE_FILE=false";
+   check_directories_created(mem_ctx,
+                             CACHE_TEST_TMP "/mesa-shader-cache-dir/" CACHE_DIR_NAME);
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_SHADER_CACHE_DIR");
+
+   err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
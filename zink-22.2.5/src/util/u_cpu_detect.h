@@ -130,6 +130,14 @@ struct util_cpu_caps_t {
    uint16_t cpu_to_L3[UTIL_MAX_CPUS];
    /* Affinity masks for each L3 cache. */
    util_affinity_mask *L3_affinity_mask;
+
+   /* Set when the CPUs don't all have the same maximum frequency, as on
+    * big.LITTLE systems.  little_cpu_mask then holds the CPUs with the
+    * lowest maximum frequency, and big_cpu_mask all the others.
+    */
+   bool has_big_little;
+   util_affinity_mask big_cpu_mask;
+   util_affinity_mask little_cpu_mask;
 };
 
 #define U_CPU_INVALID_L3 0xffff
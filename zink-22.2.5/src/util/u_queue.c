@@ -263,6 +263,17 @@ util_queue_thread_func(void *input)
                                        util_get_cpu_caps()->num_cpu_mask_bits);
    }
 
+   if (util_get_cpu_caps()->has_big_little &&
+       (queue->flags & (UTIL_QUEUE_INIT_PREFER_BIG_CORES |
+                        UTIL_QUEUE_INIT_PREFER_LITTLE_CORES))) {
+      const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+      util_set_current_thread_affinity(
+         queue->flags & UTIL_QUEUE_INIT_PREFER_BIG_CORES ?
+            caps->big_cpu_mask : caps->little_cpu_mask,
+         NULL, caps->num_cpu_mask_bits);
+   }
+
 #if defined(__linux__)
    if (queue->flags & UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY) {
       /* The nice() function can only set a maximum of 19. */